@@ -15,5 +15,6 @@
 
 void kernel_neon_begin(void);
 void kernel_neon_end(void);
+bool kernel_neon_cond_yield(struct user_fpsimd_state *state);
 
 #endif /* ! __ASM_NEON_H */
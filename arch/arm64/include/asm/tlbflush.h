@@ -12,6 +12,8 @@
 
 #include <linux/mm_types.h>
 #include <linux/sched.h>
+#include <linux/sizes.h>
+#include <asm/cpufeature.h>
 #include <asm/cputype.h>
 #include <asm/mmu.h>
 
@@ -50,6 +52,31 @@
 		__tlbi(op, (arg) | USER_ASID_FLAG);				\
 } while (0)
 
+/*
+ * ARMv8.4 TLB range operations, emitted through their SYS encoding so that
+ * they can be built with assemblers lacking ARMv8.4 support. Only to be
+ * used when system_supports_tlb_range(). __tlbi_range(vae1is, arg) issues
+ * TLBI RVAE1IS, and so on.
+ */
+#define __TLBI_R_vae1is		"sys #0, c8, c2, #1"
+#define __TLBI_R_vaae1is	"sys #0, c8, c2, #3"
+#define __TLBI_R_vale1is	"sys #0, c8, c2, #5"
+#define __TLBI_R_vaale1is	"sys #0, c8, c2, #7"
+
+#define __TLBI_RANGE(insn, arg) asm (insn ", %0\n"				       \
+		   ALTERNATIVE("nop\n			nop",		       \
+			       "dsb ish\n		" insn ", %0",	       \
+			       ARM64_WORKAROUND_REPEAT_TLBI,		       \
+			       CONFIG_ARM64_WORKAROUND_REPEAT_TLBI)	       \
+			    : : "r" (arg))
+
+#define __tlbi_range(op, arg)	__TLBI_RANGE(__TLBI_R_##op, arg)
+
+#define __tlbi_user_range(op, arg) do {					\
+	if (arm64_kernel_unmapped_at_el0())					\
+		__tlbi_range(op, (arg) | USER_ASID_FLAG);			\
+} while (0)
+
 /* This macro creates a properly formatted VA operand for the TLBI */
 #define __TLBI_VADDR(addr, asid)				\
 	({							\
@@ -59,6 +86,62 @@
 		__ta;						\
 	})
 
+#define TLBI_TG_4K	1
+#define TLBI_TG_16K	2
+#define TLBI_TG_64K	3
+
+static inline unsigned long get_trans_granule(void)
+{
+	switch (PAGE_SIZE) {
+	case SZ_4K:
+		return TLBI_TG_4K;
+	case SZ_16K:
+		return TLBI_TG_16K;
+	case SZ_64K:
+		return TLBI_TG_64K;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * This macro creates a properly formatted VA operand for the TLBI range
+ * operations. The value bit assignments are:
+ *
+ * +----------+------+-------+-------+-------+----------------------+
+ * |   ASID   |  TG  | SCALE |  NUM  |  TTL  |        BADDR         |
+ * +-----------------+-------+-------+-------+----------------------+
+ * |63      48|47  46|45   44|43   39|38   37|36                   0|
+ *
+ * The address range is determined by below formula:
+ * [BADDR, BADDR + (NUM + 1) * 2^(5*SCALE + 1) * PAGESIZE)
+ *
+ * TTL is left as 0, i.e. no level hint.
+ */
+#define __TLBI_VADDR_RANGE(addr, asid, scale, num)		\
+	({							\
+		unsigned long __ta = (addr) >> PAGE_SHIFT;	\
+		__ta &= GENMASK_ULL(36, 0);			\
+		__ta |= (unsigned long)(num) << 39;		\
+		__ta |= (unsigned long)(scale) << 44;		\
+		__ta |= get_trans_granule() << 46;		\
+		__ta |= (unsigned long)(asid) << 48;		\
+		__ta;						\
+	})
+
+/* Number of pages covered by one range operation */
+#define __TLBI_RANGE_PAGES(num, scale)	\
+	((unsigned long)((num) + 1) << (5 * (scale) + 1))
+#define MAX_TLBI_RANGE_PAGES		__TLBI_RANGE_PAGES(31, 3)
+
+/*
+ * Generate 'num' values from -1 to 30, -1 meaning that no range operation
+ * is needed at this 'scale'; see __flush_tlb_range_op().
+ */
+#define TLBI_RANGE_MASK			GENMASK_ULL(4, 0)
+#define __TLBI_RANGE_NUM(pages, scale)	\
+	((((pages) >> (5 * (scale) + 1)) & TLBI_RANGE_MASK) - 1)
+
 /*
  *	TLB Invalidation
  *	================
@@ -121,7 +204,9 @@
  *		CPUs for the user address space corresponding to 'vma->mm'.
  *		The invalidation operations are issued at a granularity
  *		determined by 'stride' and only affect any walk-cache entries
- *		if 'last_level' is equal to false.
+ *		if 'last_level' is equal to false. CPUs implementing the
+ *		ARMv8.4 TLB range operations cover the range with a handful
+ *		of them instead.
  *
  *
  *	Finally, take a look at asm/tlb.h to see how tlb_flush() is implemented
@@ -177,37 +262,80 @@ static inline void flush_tlb_page(struct vm_area_struct *vma,
  */
 #define MAX_TLBI_OPS	PTRS_PER_PTE
 
+/*
+ * Issue the TLBIs for 'pages' pages from 'start', at a granularity of
+ * 'stride'. Without TLB range operations, this is one TLBI per 'stride'.
+ * Otherwise:
+ *
+ * 1. If 'pages' is odd, flush the first page with a non-range operation;
+ *
+ * 2. For the remaining pages, the range granularity is decided by 'scale',
+ *    so several range operations may be needed. Start from scale = 0,
+ *    flush (num + 1) * 2^(5 * scale + 1) pages from 'start', then increase
+ *    'scale' until no pages are left.
+ *
+ * Some ranges can be represented either by num = 31 and scale or by
+ * num = 0 and scale + 1. The loop favours the latter, since
+ * __TLBI_RANGE_NUM() limits num to 30.
+ */
+#define __flush_tlb_range_op(op, start, pages, stride, asid, tlbi_user)	\
+do {									\
+	int __num, __scale = 0;						\
+	unsigned long __addr;						\
+									\
+	while (pages > 0) {						\
+		if (!system_supports_tlb_range() || pages % 2 == 1) {	\
+			__addr = __TLBI_VADDR(start, asid);		\
+			__tlbi(op, __addr);				\
+			if (tlbi_user)					\
+				__tlbi_user(op, __addr);		\
+			start += stride;				\
+			pages -= stride >> PAGE_SHIFT;			\
+			continue;					\
+		}							\
+									\
+		__num = __TLBI_RANGE_NUM(pages, __scale);		\
+		if (__num >= 0) {					\
+			__addr = __TLBI_VADDR_RANGE(start, asid,	\
+						    __scale, __num);	\
+			__tlbi_range(op, __addr);			\
+			if (tlbi_user)					\
+				__tlbi_user_range(op, __addr);		\
+			start += __TLBI_RANGE_PAGES(__num, __scale) << PAGE_SHIFT; \
+			pages -= __TLBI_RANGE_PAGES(__num, __scale);	\
+		}							\
+		__scale++;						\
+	}								\
+} while (0)
+
 static inline void __flush_tlb_range(struct vm_area_struct *vma,
 				     unsigned long start, unsigned long end,
 				     unsigned long stride, bool last_level)
 {
 	unsigned long asid = ASID(vma->vm_mm);
-	unsigned long addr;
+	unsigned long pages;
 
 	start = round_down(start, stride);
 	end = round_up(end, stride);
+	pages = (end - start) >> PAGE_SHIFT;
 
-	if ((end - start) >= (MAX_TLBI_OPS * stride)) {
+	/*
+	 * Without TLB range operations we can handle up to
+	 * (MAX_TLBI_OPS - 1) TLBIs, with them up to
+	 * (MAX_TLBI_RANGE_PAGES - 1) pages.
+	 */
+	if ((!system_supports_tlb_range() &&
+	     (end - start) >= (MAX_TLBI_OPS * stride)) ||
+	    pages >= MAX_TLBI_RANGE_PAGES) {
 		flush_tlb_mm(vma->vm_mm);
 		return;
 	}
 
-	/* Convert the stride into units of 4k */
-	stride >>= 12;
-
-	start = __TLBI_VADDR(start, asid);
-	end = __TLBI_VADDR(end, asid);
-
 	dsb(ishst);
-	for (addr = start; addr < end; addr += stride) {
-		if (last_level) {
-			__tlbi(vale1is, addr);
-			__tlbi_user(vale1is, addr);
-		} else {
-			__tlbi(vae1is, addr);
-			__tlbi_user(vae1is, addr);
-		}
-	}
+	if (last_level)
+		__flush_tlb_range_op(vale1is, start, pages, stride, asid, true);
+	else
+		__flush_tlb_range_op(vae1is, start, pages, stride, asid, true);
 	dsb(ish);
 }
 
@@ -223,19 +351,21 @@ static inline void flush_tlb_range(struct vm_area_struct *vma,
 
 static inline void flush_tlb_kernel_range(unsigned long start, unsigned long end)
 {
-	unsigned long addr;
+	unsigned long pages;
 
-	if ((end - start) > (MAX_TLBI_OPS * PAGE_SIZE)) {
+	start = round_down(start, PAGE_SIZE);
+	end = round_up(end, PAGE_SIZE);
+	pages = (end - start) >> PAGE_SHIFT;
+
+	if ((!system_supports_tlb_range() &&
+	     (end - start) > (MAX_TLBI_OPS * PAGE_SIZE)) ||
+	    pages >= MAX_TLBI_RANGE_PAGES) {
 		flush_tlb_all();
 		return;
 	}
 
-	start = __TLBI_VADDR(start, 0);
-	end = __TLBI_VADDR(end, 0);
-
 	dsb(ishst);
-	for (addr = start; addr < end; addr += 1 << (PAGE_SHIFT - 12))
-		__tlbi(vaale1is, addr);
+	__flush_tlb_range_op(vaale1is, start, pages, PAGE_SIZE, 0, false);
 	dsb(ish);
 	isb();
 }
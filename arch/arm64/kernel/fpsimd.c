@@ -127,6 +127,13 @@ static int get_sve_default_vl(void)
 	return READ_ONCE(__sve_default_vl);
 }
 
+/*
+ * Number of syscalls a task keeps TIF_SVE across after an SVE access
+ * trap, before going back to trapping on first use (0: drop it on the
+ * first syscall, as before):
+ */
+static unsigned int sve_keep_syscalls;
+
 #ifdef CONFIG_ARM64_SVE
 
 static void set_sve_default_vl(int val)
@@ -248,7 +255,11 @@ static void sve_free(struct task_struct *task)
  *    sve_state_size(task) bytes in size.
  *
  *    During any syscall, the kernel may optionally clear TIF_SVE and
- *    discard the vector state except for the FPSIMD subset.
+ *    discard the vector state except for the FPSIMD subset. It only
+ *    does so once task->thread.sve_keep, reloaded on each SVE access
+ *    trap, has counted down to zero: a task that keeps using SVE then
+ *    takes one trap every abi.sve_keep_syscalls syscalls instead of
+ *    one after every syscall.
  *
  *  * TIF_SVE clear:
  *
@@ -376,19 +387,26 @@ static int sve_proc_do_default_vl(struct ctl_table *table, int write,
 	return 0;
 }
 
-static struct ctl_table sve_default_vl_table[] = {
+static struct ctl_table sve_sysctl_table[] = {
 	{
 		.procname	= "sve_default_vector_length",
 		.mode		= 0644,
 		.proc_handler	= sve_proc_do_default_vl,
 	},
+	{
+		.procname	= "sve_keep_syscalls",
+		.data		= &sve_keep_syscalls,
+		.maxlen		= sizeof(sve_keep_syscalls),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec,
+	},
 	{ }
 };
 
 static int __init sve_sysctl_init(void)
 {
 	if (system_supports_sve())
-		if (!register_sysctl("abi", sve_default_vl_table))
+		if (!register_sysctl("abi", sve_sysctl_table))
 			return -EINVAL;
 
 	return 0;
@@ -953,6 +971,9 @@ void do_sve_acc(unsigned int esr, struct pt_regs *regs)
 	if (test_and_set_thread_flag(TIF_SVE))
 		WARN_ON(1); /* SVE access shouldn't have trapped */
 
+	/* Don't trap again on the next few syscalls: */
+	current->thread.sve_keep = READ_ONCE(sve_keep_syscalls);
+
 	put_cpu_fpsimd_context();
 }
 
@@ -1032,6 +1053,7 @@ void fpsimd_flush_thread(void)
 
 	if (system_supports_sve()) {
 		clear_thread_flag(TIF_SVE);
+		current->thread.sve_keep = 0;
 		sve_free(current);
 
 		/*
@@ -1298,6 +1320,50 @@ void kernel_neon_end(void)
 }
 EXPORT_SYMBOL(kernel_neon_end);
 
+/*
+ * kernel_neon_cond_yield(): voluntary preemption point for long-running
+ * kernel mode NEON code
+ *
+ * Must be called from a context in which kernel_neon_begin() was previously
+ * called, with no call to kernel_neon_end() in the meantime. If a reschedule
+ * is pending and the caller is not nested inside another non-preemptible
+ * section (softirq, spinlock, ...), the NEON section is ended, the CPU is
+ * given up and a new section is begun.
+ *
+ * If state is non-NULL, the caller's FPSIMD registers are saved there
+ * before yielding and reloaded afterwards, so that the caller can carry on
+ * as if no yield had happened. Otherwise, their contents are lost whenever
+ * true is returned.
+ *
+ * This allows callers to process a whole request in one NEON section
+ * instead of bracketing each small chunk with kernel_neon_begin() and
+ * kernel_neon_end(), without holding off the scheduler for too long.
+ *
+ * Returns true if the CPU was yielded.
+ */
+bool kernel_neon_cond_yield(struct user_fpsimd_state *state)
+{
+	if (!system_supports_fpsimd())
+		return false;
+
+	/* Only our own preempt_disable(): anything else makes it pointless */
+	if (preempt_count() != PREEMPT_DISABLE_OFFSET || !need_resched())
+		return false;
+
+	if (state)
+		fpsimd_save_state(state);
+
+	kernel_neon_end();
+	cond_resched();
+	kernel_neon_begin();
+
+	if (state)
+		fpsimd_load_state(state);
+
+	return true;
+}
+EXPORT_SYMBOL(kernel_neon_cond_yield);
+
 #ifdef CONFIG_EFI
 
 static DEFINE_PER_CPU(struct user_fpsimd_state, efi_fpsimd_state);
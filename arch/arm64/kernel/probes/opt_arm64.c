@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * arch/arm64/kernel/probes/opt_arm64.c
+ *
+ * Kernel Probes Jump Optimization (Optprobes) for arm64, based on the
+ * arm implementation.
+ */
+
+#include <linux/kprobes.h>
+#include <linux/sizes.h>
+#include <linux/vmalloc.h>
+#include <asm/cacheflush.h>
+#include <asm/insn.h>
+#include <asm/kprobes.h>
+#include <asm/module.h>
+#include <asm/sections.h>
+
+#define TMPL_IDX(sym)	((sym) - optprobe_template_entry)
+#define TMPL_CALL_IDX	TMPL_IDX(optprobe_template_call)
+#define TMPL_RESTORE_ORIG_INSN_IDX \
+	TMPL_IDX(optprobe_template_restore_orig_insn)
+#define TMPL_RESTORE_END_IDX	TMPL_IDX(optprobe_template_restore_end)
+#define TMPL_VAL_IDX	TMPL_IDX(optprobe_template_val)
+#define TMPL_PLT_IDX	TMPL_IDX(optprobe_template_plt)
+
+/*
+ * The detour buffer is entered and left through B instructions, which
+ * only reach +/-128M. Allocate it from the module region so that it is
+ * within range of module text and, unless the module region is fully
+ * randomized, of the kernel image too.
+ */
+void *alloc_optinsn_page(void)
+{
+	return __vmalloc_node_range(PAGE_SIZE, 1, module_alloc_base,
+			module_alloc_base + MODULES_VSIZE,
+			GFP_KERNEL | __GFP_NOWARN, PAGE_KERNEL_ROX,
+			VM_FLUSH_RESET_PERMS, NUMA_NO_NODE,
+			__builtin_return_address(0));
+}
+
+static bool in_branch_range(unsigned long pc, unsigned long addr)
+{
+	long offset = (long)addr - (long)pc;
+
+	return offset >= -SZ_128M && offset < SZ_128M;
+}
+
+int arch_prepared_optinsn(struct arch_optimized_insn *optinsn)
+{
+	return optinsn->insn != NULL;
+}
+
+/*
+ * arm64 optprobes always replace exactly one instruction, so another
+ * kprobe can never sit inside the replaced range.
+ */
+int arch_check_optimized_kprobe(struct optimized_kprobe *op)
+{
+	return 0;
+}
+
+/*
+ * Only instructions that can be stepped out of line are copied into the
+ * detour buffer and executed there. Simulated instructions depend on the
+ * PC, or change it, and returning to an arbitrary PC without clobbering
+ * a register is not possible.
+ */
+static bool can_optimize(struct kprobe *p)
+{
+	return p->ainsn.api.insn != NULL;
+}
+
+static void
+__arch_remove_optimized_kprobe(struct optimized_kprobe *op, int dirty)
+{
+	if (op->optinsn.insn) {
+		free_optinsn_slot(op->optinsn.insn, dirty);
+		op->optinsn.insn = NULL;
+	}
+}
+
+static void
+optimized_callback(struct optimized_kprobe *op, struct pt_regs *regs)
+{
+	struct kprobe_ctlblk *kcb;
+	unsigned long flags;
+
+	/* Fill in what the detour buffer could not save */
+	instruction_pointer_set(regs, (unsigned long)op->kp.addr);
+	regs->orig_x0 = regs->regs[0];
+
+	local_irq_save(flags);
+	kcb = get_kprobe_ctlblk();
+
+	if (kprobe_running()) {
+		kprobes_inc_nmissed_count(&op->kp);
+	} else {
+		__this_cpu_write(current_kprobe, &op->kp);
+		kcb->kprobe_status = KPROBE_HIT_ACTIVE;
+		opt_pre_handler(&op->kp, regs);
+		__this_cpu_write(current_kprobe, NULL);
+	}
+
+	local_irq_restore(flags);
+}
+NOKPROBE_SYMBOL(optimized_callback)
+
+/*
+ * The slot is mapped read-only, so it is filled through the text patching
+ * helpers. They take the instruction in CPU order and store it little
+ * endian, hence the conversion of words that are copied verbatim.
+ */
+static int optprobe_write(kprobe_opcode_t *code, int idx, u32 insn)
+{
+	return aarch64_insn_patch_text_nosync(code + idx, insn);
+}
+
+static int optprobe_write_data(kprobe_opcode_t *code, int idx,
+			       const void *data, size_t size)
+{
+	const __le32 *words = data;
+	int i, ret;
+
+	for (i = 0; i < size / sizeof(*words); i++) {
+		ret = optprobe_write(code, idx + i, le32_to_cpu(words[i]));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Branch to optimized_callback(), going through the PLT at the end of the
+ * detour buffer when the module region is too far from the kernel image
+ * for a direct BL.
+ */
+static u32 optprobe_gen_call(kprobe_opcode_t *code)
+{
+	unsigned long pc = (unsigned long)&code[TMPL_CALL_IDX];
+	unsigned long dst = (unsigned long)optimized_callback;
+	struct plt_entry plt;
+	void *plt_addr;
+
+	if (!in_branch_range(pc, dst)) {
+		if (!IS_ENABLED(CONFIG_ARM64_MODULE_PLTS))
+			return AARCH64_BREAK_FAULT;
+
+		plt_addr = &code[TMPL_PLT_IDX];
+		if (is_forbidden_offset_for_adrp(plt_addr))
+			return AARCH64_BREAK_FAULT;
+
+		plt = get_plt_entry(dst, plt_addr);
+		if (optprobe_write_data(code, TMPL_PLT_IDX, &plt, sizeof(plt)))
+			return AARCH64_BREAK_FAULT;
+		dst = (unsigned long)plt_addr;
+	}
+
+	return aarch64_insn_gen_branch_imm(pc, dst, AARCH64_INSN_BRANCH_LINK);
+}
+
+int arch_prepare_optimized_kprobe(struct optimized_kprobe *op,
+				  struct kprobe *orig)
+{
+	unsigned long addr = (unsigned long)orig->addr;
+	unsigned long val = (unsigned long)op;
+	kprobe_opcode_t *code;
+	u32 insn;
+	int ret;
+
+	if (!can_optimize(orig))
+		return -EILSEQ;
+
+	code = get_optinsn_slot();
+	if (!code)
+		return -ENOMEM;
+
+	if (!in_branch_range(addr, (unsigned long)code) ||
+	    !in_branch_range((unsigned long)&code[TMPL_RESTORE_END_IDX],
+			     addr + AARCH64_INSN_SIZE)) {
+		ret = -ERANGE;
+		goto err;
+	}
+
+	/* Copy arch-dep-instance from template. */
+	ret = optprobe_write_data(code, 0, optprobe_template_entry,
+				  MAX_OPTINSN_SIZE * sizeof(kprobe_opcode_t));
+	if (ret)
+		goto err;
+
+	ret = optprobe_write_data(code, TMPL_VAL_IDX, &val, sizeof(val));
+	if (ret)
+		goto err;
+
+	insn = optprobe_gen_call(code);
+	if (insn == AARCH64_BREAK_FAULT) {
+		ret = -ERANGE;
+		goto err;
+	}
+	ret = optprobe_write(code, TMPL_CALL_IDX, insn);
+	if (ret)
+		goto err;
+
+	/* The probed instruction, then jump back to the next one */
+	ret = optprobe_write(code, TMPL_RESTORE_ORIG_INSN_IDX, orig->opcode);
+	if (ret)
+		goto err;
+
+	insn = aarch64_insn_gen_branch_imm(
+			(unsigned long)&code[TMPL_RESTORE_END_IDX],
+			addr + AARCH64_INSN_SIZE, AARCH64_INSN_BRANCH_NOLINK);
+	ret = optprobe_write(code, TMPL_RESTORE_END_IDX, insn);
+	if (ret)
+		goto err;
+
+	/* Set op->optinsn.insn means prepared. */
+	op->optinsn.insn = code;
+	return 0;
+
+err:
+	/*
+	 * Nothing in op refers to the buffer yet, so free it directly
+	 * rather than through __arch_remove_optimized_kprobe().
+	 */
+	free_optinsn_slot(code, 0);
+	return ret;
+}
+
+void __kprobes arch_optimize_kprobes(struct list_head *oplist)
+{
+	struct optimized_kprobe *op, *tmp;
+
+	list_for_each_entry_safe(op, tmp, oplist, list) {
+		void *addrs[1];
+		u32 insns[1];
+
+		WARN_ON(kprobe_disabled(&op->kp));
+
+		addrs[0] = op->kp.addr;
+		insns[0] = aarch64_insn_gen_branch_imm(
+				(unsigned long)op->kp.addr,
+				(unsigned long)op->optinsn.insn,
+				AARCH64_INSN_BRANCH_NOLINK);
+		BUG_ON(insns[0] == AARCH64_BREAK_FAULT);
+
+		/*
+		 * Like arch_disarm_kprobe(), replace the breakpoint under
+		 * stop_machine so that no CPU is stepping it meanwhile.
+		 */
+		aarch64_insn_patch_text(addrs, insns, 1);
+
+		list_del_init(&op->list);
+	}
+}
+
+void arch_unoptimize_kprobe(struct optimized_kprobe *op)
+{
+	arch_arm_kprobe(&op->kp);
+}
+
+/*
+ * Recover original instructions and breakpoints from relative jumps.
+ * Caller must call with locking kprobe_mutex.
+ */
+void arch_unoptimize_kprobes(struct list_head *oplist,
+			     struct list_head *done_list)
+{
+	struct optimized_kprobe *op, *tmp;
+
+	list_for_each_entry_safe(op, tmp, oplist, list) {
+		arch_unoptimize_kprobe(op);
+		list_move(&op->list, done_list);
+	}
+}
+
+int arch_within_optimized_kprobe(struct optimized_kprobe *op,
+				 unsigned long addr)
+{
+	return ((unsigned long)op->kp.addr <= addr &&
+		(unsigned long)op->kp.addr + MAX_OPTIMIZED_LENGTH > addr);
+}
+
+void arch_remove_optimized_kprobe(struct optimized_kprobe *op)
+{
+	__arch_remove_optimized_kprobe(op, 1);
+}
@@ -177,6 +177,16 @@ static inline void sve_user_discard(void)
 	if (!system_supports_sve())
 		return;
 
+	/*
+	 * Recent SVE users keep their SVE state across the syscall, so as
+	 * not to take an access trap right after it. Bits above 128 of
+	 * Z0-Z31, P0-P15 and FFR are unspecified after a syscall anyway.
+	 */
+	if (current->thread.sve_keep && test_thread_flag(TIF_SVE)) {
+		current->thread.sve_keep--;
+		return;
+	}
+
 	clear_thread_flag(TIF_SVE);
 
 	/*
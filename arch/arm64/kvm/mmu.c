@@ -1826,6 +1826,71 @@ transparent_hugepage_adjust(struct kvm_memory_slot *memslot,
 	return PAGE_SIZE;
 }
 
+/*
+ * Number of pages around a stage-2 translation fault which are mapped
+ * together with the faulting page, as long as the host already has them
+ * mapped writable. This cuts down on the number of faults, and therefore
+ * on mmu_lock round trips, while a guest first touches its memory.
+ * 0 or 1 disables fault-around.
+ */
+static unsigned int stage2_fault_around_pages;
+module_param(stage2_fault_around_pages, uint, 0644);
+
+/*
+ * Map the pages around fault_ipa, within a naturally aligned group of
+ * stage2_fault_around_pages pages. The faulting page has just been mapped
+ * at PAGE_SIZE, so the last level table covering the group exists and
+ * nothing needs allocating. Called with mmu_lock held, and after the
+ * mmu_notifier_retry() check, so the host mappings can't go away under
+ * our feet without us being told.
+ */
+static void stage2_fault_around(struct kvm *kvm,
+				struct kvm_mmu_memory_cache *memcache,
+				struct kvm_memory_slot *memslot,
+				phys_addr_t fault_ipa)
+{
+	unsigned int nr = READ_ONCE(stage2_fault_around_pages);
+	gfn_t fault_gfn = fault_ipa >> PAGE_SHIFT;
+	gfn_t gfn, start, end;
+
+	if (nr < 2)
+		return;
+
+	nr = min_t(unsigned int, rounddown_pow_of_two(nr), PTRS_PER_PTE);
+	start = round_down(fault_gfn, nr);
+	end = min(start + nr, memslot->base_gfn + memslot->npages);
+	start = max(start, memslot->base_gfn);
+
+	for (gfn = start; gfn < end; gfn++) {
+		phys_addr_t ipa = gfn << PAGE_SHIFT;
+		pud_t *pudp;
+		pmd_t *pmdp;
+		pte_t *ptep, new_pte;
+		kvm_pfn_t pfn;
+
+		if (gfn == fault_gfn ||
+		    stage2_get_leaf_entry(kvm, ipa, &pudp, &pmdp, &ptep))
+			continue;
+
+		/* Doesn't sleep, and fails unless already mapped writable */
+		pfn = gfn_to_pfn_memslot_atomic(memslot, gfn);
+		if (is_error_noslot_pfn(pfn))
+			continue;
+
+		if (!kvm_is_device_pfn(pfn)) {
+			clean_dcache_guest_page(pfn, PAGE_SIZE);
+
+			new_pte = kvm_s2pte_mkwrite(kvm_pfn_pte(pfn, PAGE_S2));
+			kvm_set_pfn_dirty(pfn);
+			mark_page_dirty(kvm, gfn);
+			stage2_set_pte(kvm, memcache, ipa, &new_pte, 0);
+			kvm_set_pfn_accessed(pfn);
+		}
+
+		kvm_release_pfn_clean(pfn);
+	}
+}
+
 static int user_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t fault_ipa,
 			  struct kvm_memory_slot *memslot, unsigned long hva,
 			  unsigned long fault_status)
@@ -1950,11 +2015,25 @@ static int user_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t fault_ipa,
 	if (writable)
 		kvm_set_pfn_dirty(pfn);
 
-	if (fault_status != FSC_PERM && !is_iomap(flags))
-		clean_dcache_guest_page(pfn, vma_pagesize);
+	/*
+	 * Cleaning a 2MB or 1GB block to PoC takes a long time, and faults
+	 * from all vCPUs would serialise on it behind mmu_lock. We hold a
+	 * reference on the page, so do the maintenance unlocked, and check
+	 * again afterwards whether we raced with an invalidation.
+	 */
+	if ((fault_status != FSC_PERM && !is_iomap(flags)) || exec_fault) {
+		spin_unlock(&kvm->mmu_lock);
+
+		if (fault_status != FSC_PERM && !is_iomap(flags))
+			clean_dcache_guest_page(pfn, vma_pagesize);
+
+		if (exec_fault)
+			invalidate_icache_guest_page(pfn, vma_pagesize);
 
-	if (exec_fault)
-		invalidate_icache_guest_page(pfn, vma_pagesize);
+		spin_lock(&kvm->mmu_lock);
+		if (mmu_notifier_retry(kvm, mmu_seq))
+			goto out_unlock;
+	}
 
 	/*
 	 * If we took an execution fault we have made the
@@ -2008,6 +2087,8 @@ static int user_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t fault_ipa,
 			new_pte = kvm_s2pte_mkexec(new_pte);
 
 		ret = stage2_set_pte(kvm, memcache, fault_ipa, &new_pte, flags);
+		if (!ret && !flags && fault_status != FSC_PERM)
+			stage2_fault_around(kvm, memcache, memslot, fault_ipa);
 	}
 
 out_unlock:
@@ -10,6 +10,7 @@
 #include <linux/kvm.h>
 #include <linux/kvm_host.h>
 #include <linux/interrupt.h>
+#include <linux/jhash.h>
 #include <linux/list.h>
 #include <linux/uaccess.h>
 #include <linux/list_sort.h>
@@ -153,6 +154,16 @@ struct vgic_translation_cache_entry {
 	struct vgic_irq		*irq;
 };
 
+/*
+ * A translation only ever lives in the set its (db, devid, eventid) hashes
+ * to, so lookups only serialise against other MSIs landing in the same set
+ * rather than on the VM-wide lpi_list_lock.
+ */
+struct vgic_translation_cache_set {
+	raw_spinlock_t		lock;
+	struct list_head	lru;
+};
+
 /**
  * struct vgic_its_abi - ITS abi ops and settings
  * @cte_esz: collection table entry size
@@ -545,13 +556,24 @@ static unsigned long vgic_mmio_read_its_idregs(struct kvm *kvm,
 	return 0;
 }
 
-static struct vgic_irq *__vgic_its_check_cache(struct vgic_dist *dist,
-					       phys_addr_t db,
-					       u32 devid, u32 eventid)
+static struct vgic_translation_cache_set *
+vgic_its_cache_set(struct vgic_dist *dist, phys_addr_t db, u32 devid,
+		   u32 eventid)
+{
+	u32 hash = jhash_3words(lower_32_bits(db), devid, eventid, 0);
+
+	return &dist->lpi_translation_cache[hash &
+					    (dist->lpi_translation_cache_sets - 1)];
+}
+
+/* Must be called with set->lock held */
+static struct vgic_irq *
+__vgic_its_check_cache(struct vgic_translation_cache_set *set, phys_addr_t db,
+		       u32 devid, u32 eventid)
 {
 	struct vgic_translation_cache_entry *cte;
 
-	list_for_each_entry(cte, &dist->lpi_translation_cache, entry) {
+	list_for_each_entry(cte, &set->lru, entry) {
 		/*
 		 * If we hit a NULL entry, there is nothing after this
 		 * point.
@@ -567,8 +589,8 @@ static struct vgic_irq *__vgic_its_check_cache(struct vgic_dist *dist,
 		 * Move this entry to the head, as it is the most
 		 * recently used.
 		 */
-		if (!list_is_first(&cte->entry, &dist->lpi_translation_cache))
-			list_move(&cte->entry, &dist->lpi_translation_cache);
+		if (!list_is_first(&cte->entry, &set->lru))
+			list_move(&cte->entry, &set->lru);
 
 		return cte->irq;
 	}
@@ -576,25 +598,12 @@ static struct vgic_irq *__vgic_its_check_cache(struct vgic_dist *dist,
 	return NULL;
 }
 
-static struct vgic_irq *vgic_its_check_cache(struct kvm *kvm, phys_addr_t db,
-					     u32 devid, u32 eventid)
-{
-	struct vgic_dist *dist = &kvm->arch.vgic;
-	struct vgic_irq *irq;
-	unsigned long flags;
-
-	raw_spin_lock_irqsave(&dist->lpi_list_lock, flags);
-	irq = __vgic_its_check_cache(dist, db, devid, eventid);
-	raw_spin_unlock_irqrestore(&dist->lpi_list_lock, flags);
-
-	return irq;
-}
-
 static void vgic_its_cache_translation(struct kvm *kvm, struct vgic_its *its,
 				       u32 devid, u32 eventid,
 				       struct vgic_irq *irq)
 {
 	struct vgic_dist *dist = &kvm->arch.vgic;
+	struct vgic_translation_cache_set *set;
 	struct vgic_translation_cache_entry *cte;
 	unsigned long flags;
 	phys_addr_t db;
@@ -603,9 +612,15 @@ static void vgic_its_cache_translation(struct kvm *kvm, struct vgic_its *its,
 	if (irq->hw)
 		return;
 
-	raw_spin_lock_irqsave(&dist->lpi_list_lock, flags);
+	if (unlikely(!dist->lpi_translation_cache))
+		return;
+
+	db = its->vgic_its_base + GITS_TRANSLATER;
+	set = vgic_its_cache_set(dist, db, devid, eventid);
+
+	raw_spin_lock_irqsave(&set->lock, flags);
 
-	if (unlikely(list_empty(&dist->lpi_translation_cache)))
+	if (unlikely(list_empty(&set->lru)))
 		goto out;
 
 	/*
@@ -613,21 +628,22 @@ static void vgic_its_cache_translation(struct kvm *kvm, struct vgic_its *its,
 	 * translation behind our back, so let's check it is not in
 	 * already
 	 */
-	db = its->vgic_its_base + GITS_TRANSLATER;
-	if (__vgic_its_check_cache(dist, db, devid, eventid))
+	if (__vgic_its_check_cache(set, db, devid, eventid))
 		goto out;
 
 	/* Always reuse the last entry (LRU policy) */
-	cte = list_last_entry(&dist->lpi_translation_cache,
-			      typeof(*cte), entry);
+	cte = list_last_entry(&set->lru, typeof(*cte), entry);
 
 	/*
 	 * Caching the translation implies having an extra reference
 	 * to the interrupt, so drop the potential reference on what
 	 * was in the cache, and increment it on the new interrupt.
 	 */
-	if (cte->irq)
+	if (cte->irq) {
+		raw_spin_lock(&dist->lpi_list_lock);
 		__vgic_put_lpi_locked(kvm, cte->irq);
+		raw_spin_unlock(&dist->lpi_list_lock);
+	}
 
 	vgic_get_irq_kref(irq);
 
@@ -637,10 +653,10 @@ static void vgic_its_cache_translation(struct kvm *kvm, struct vgic_its *its,
 	cte->irq	= irq;
 
 	/* Move the new translation to the head of the list */
-	list_move(&cte->entry, &dist->lpi_translation_cache);
+	list_move(&cte->entry, &set->lru);
 
 out:
-	raw_spin_unlock_irqrestore(&dist->lpi_list_lock, flags);
+	raw_spin_unlock_irqrestore(&set->lock, flags);
 }
 
 void vgic_its_invalidate_cache(struct kvm *kvm)
@@ -648,22 +664,31 @@ void vgic_its_invalidate_cache(struct kvm *kvm)
 	struct vgic_dist *dist = &kvm->arch.vgic;
 	struct vgic_translation_cache_entry *cte;
 	unsigned long flags;
+	int i;
 
-	raw_spin_lock_irqsave(&dist->lpi_list_lock, flags);
+	for (i = 0; dist->lpi_translation_cache &&
+		    i < dist->lpi_translation_cache_sets; i++) {
+		struct vgic_translation_cache_set *set;
 
-	list_for_each_entry(cte, &dist->lpi_translation_cache, entry) {
-		/*
-		 * If we hit a NULL entry, there is nothing after this
-		 * point.
-		 */
-		if (!cte->irq)
-			break;
+		set = &dist->lpi_translation_cache[i];
+		raw_spin_lock_irqsave(&set->lock, flags);
+		raw_spin_lock(&dist->lpi_list_lock);
 
-		__vgic_put_lpi_locked(kvm, cte->irq);
-		cte->irq = NULL;
-	}
+		list_for_each_entry(cte, &set->lru, entry) {
+			/*
+			 * If we hit a NULL entry, there is nothing after this
+			 * point.
+			 */
+			if (!cte->irq)
+				break;
 
-	raw_spin_unlock_irqrestore(&dist->lpi_list_lock, flags);
+			__vgic_put_lpi_locked(kvm, cte->irq);
+			cte->irq = NULL;
+		}
+
+		raw_spin_unlock(&dist->lpi_list_lock);
+		raw_spin_unlock_irqrestore(&set->lock, flags);
+	}
 }
 
 int vgic_its_resolve_lpi(struct kvm *kvm, struct vgic_its *its,
@@ -751,19 +776,35 @@ static int vgic_its_trigger_msi(struct kvm *kvm, struct vgic_its *its,
 
 int vgic_its_inject_cached_translation(struct kvm *kvm, struct kvm_msi *msi)
 {
+	struct vgic_dist *dist = &kvm->arch.vgic;
+	struct vgic_translation_cache_set *set;
 	struct vgic_irq *irq;
-	unsigned long flags;
+	unsigned long flags, irq_flags;
 	phys_addr_t db;
 
+	/* Pairs with the release in vgic_lpi_translation_cache_init() */
+	if (unlikely(!smp_load_acquire(&dist->lpi_translation_cache)))
+		return -1;
+
 	db = (u64)msi->address_hi << 32 | msi->address_lo;
-	irq = vgic_its_check_cache(kvm, db, msi->devid, msi->data);
+	set = vgic_its_cache_set(dist, db, msi->devid, msi->data);
 
-	if (!irq)
+	/*
+	 * The cache's reference on the interrupt can only be dropped with
+	 * set->lock held, so inject under that lock rather than taking a
+	 * reference of our own, which would need the lpi_list_lock.
+	 */
+	raw_spin_lock_irqsave(&set->lock, flags);
+	irq = __vgic_its_check_cache(set, db, msi->devid, msi->data);
+	if (!irq) {
+		raw_spin_unlock_irqrestore(&set->lock, flags);
 		return -1;
+	}
 
-	raw_spin_lock_irqsave(&irq->irq_lock, flags);
+	raw_spin_lock_irqsave(&irq->irq_lock, irq_flags);
 	irq->pending_latch = true;
-	vgic_queue_irq_unlock(kvm, irq, flags);
+	vgic_queue_irq_unlock(kvm, irq, irq_flags);
+	raw_spin_unlock_irqrestore(&set->lock, flags);
 
 	return 0;
 }
@@ -1830,45 +1871,71 @@ static int vgic_register_its_iodev(struct kvm *kvm, struct vgic_its *its,
 	return ret;
 }
 
-/* Default is 16 cached LPIs per vcpu */
-#define LPI_DEFAULT_PCPU_CACHE_SIZE	16
+/* Default is 64 cached LPIs per vcpu, in sets of 8 */
+#define LPI_DEFAULT_PCPU_CACHE_SIZE	64
+#define LPI_CACHE_SET_WAYS		8
 
 void vgic_lpi_translation_cache_init(struct kvm *kvm)
 {
 	struct vgic_dist *dist = &kvm->arch.vgic;
-	unsigned int sz;
-	int i;
+	struct vgic_translation_cache_set *sets;
+	unsigned int sz, nr_sets;
+	int i, j;
 
-	if (!list_empty(&dist->lpi_translation_cache))
+	if (dist->lpi_translation_cache)
 		return;
 
 	sz = atomic_read(&kvm->online_vcpus) * LPI_DEFAULT_PCPU_CACHE_SIZE;
+	nr_sets = roundup_pow_of_two(max(sz / LPI_CACHE_SET_WAYS, 1U));
 
-	for (i = 0; i < sz; i++) {
-		struct vgic_translation_cache_entry *cte;
+	/* An allocation failure is not fatal */
+	sets = kcalloc(nr_sets, sizeof(*sets), GFP_KERNEL);
+	if (WARN_ON(!sets))
+		return;
 
-		/* An allocation failure is not fatal */
-		cte = kzalloc(sizeof(*cte), GFP_KERNEL);
-		if (WARN_ON(!cte))
-			break;
+	for (i = 0; i < nr_sets; i++) {
+		raw_spin_lock_init(&sets[i].lock);
+		INIT_LIST_HEAD(&sets[i].lru);
+
+		for (j = 0; j < LPI_CACHE_SET_WAYS; j++) {
+			struct vgic_translation_cache_entry *cte;
+
+			cte = kzalloc(sizeof(*cte), GFP_KERNEL);
+			if (WARN_ON(!cte))
+				break;
 
-		INIT_LIST_HEAD(&cte->entry);
-		list_add(&cte->entry, &dist->lpi_translation_cache);
+			INIT_LIST_HEAD(&cte->entry);
+			list_add(&cte->entry, &sets[i].lru);
+		}
 	}
+
+	dist->lpi_translation_cache_sets = nr_sets;
+	smp_store_release(&dist->lpi_translation_cache, sets);
 }
 
 void vgic_lpi_translation_cache_destroy(struct kvm *kvm)
 {
 	struct vgic_dist *dist = &kvm->arch.vgic;
 	struct vgic_translation_cache_entry *cte, *tmp;
+	int i;
+
+	if (!dist->lpi_translation_cache)
+		return;
 
 	vgic_its_invalidate_cache(kvm);
 
-	list_for_each_entry_safe(cte, tmp,
-				 &dist->lpi_translation_cache, entry) {
-		list_del(&cte->entry);
-		kfree(cte);
+	for (i = 0; i < dist->lpi_translation_cache_sets; i++) {
+		list_for_each_entry_safe(cte, tmp,
+					 &dist->lpi_translation_cache[i].lru,
+					 entry) {
+			list_del(&cte->entry);
+			kfree(cte);
+		}
 	}
+
+	kfree(dist->lpi_translation_cache);
+	dist->lpi_translation_cache = NULL;
+	dist->lpi_translation_cache_sets = 0;
 }
 
 #define INITIAL_BASER_VALUE						  \
@@ -26,9 +26,10 @@ struct vgic_global kvm_vgic_global_state __ro_after_init = {
  * kvm->lock (mutex)
  *   its->cmd_lock (mutex)
  *     its->its_lock (mutex)
- *       vgic_cpu->ap_list_lock		must be taken with IRQs disabled
- *         kvm->lpi_list_lock		must be taken with IRQs disabled
- *           vgic_irq->irq_lock		must be taken with IRQs disabled
+ *       translation cache set->lock	must be taken with IRQs disabled
+ *         vgic_cpu->ap_list_lock	must be taken with IRQs disabled
+ *           kvm->lpi_list_lock		must be taken with IRQs disabled
+ *             vgic_irq->irq_lock	must be taken with IRQs disabled
  *
  * As the ap_list_lock might be taken from the timer interrupt handler,
  * we have to disable IRQs before taking this lock and everything lower
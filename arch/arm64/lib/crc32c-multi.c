@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * CRC32C of several independent buffers using the ARMv8 CRC32 instructions
+ *
+ * CRC32CX has a latency of several cycles but can usually issue every
+ * cycle, so a single stream leaves most of the CRC unit idle. Feeding it
+ * three streams in turn keeps it busy.
+ */
+
+#include <linux/crc32.h>
+#include <linux/types.h>
+#include <asm/cpufeature.h>
+#include <asm/unaligned.h>
+
+void __crc32c_le_multi_base(u32 *crc, unsigned char const * const *p,
+			    size_t len, unsigned int nr);
+
+static __always_inline u32 crc32cx(u32 crc, u64 value)
+{
+	asm(".arch_extension crc\n"
+	    "crc32cx	%w0, %w0, %x1" : "+r" (crc) : "r" (value));
+	return crc;
+}
+
+static __always_inline u32 crc32cb(u32 crc, u8 value)
+{
+	asm(".arch_extension crc\n"
+	    "crc32cb	%w0, %w0, %w1" : "+r" (crc) : "r" (value));
+	return crc;
+}
+
+static void crc32c_x3(u32 *crc, unsigned char const * const *p, size_t len)
+{
+	unsigned char const *p0 = p[0], *p1 = p[1], *p2 = p[2];
+	u32 c0 = crc[0], c1 = crc[1], c2 = crc[2];
+
+	for (; len >= 8; len -= 8, p0 += 8, p1 += 8, p2 += 8) {
+		c0 = crc32cx(c0, get_unaligned_le64(p0));
+		c1 = crc32cx(c1, get_unaligned_le64(p1));
+		c2 = crc32cx(c2, get_unaligned_le64(p2));
+	}
+
+	for (; len; len--) {
+		c0 = crc32cb(c0, *p0++);
+		c1 = crc32cb(c1, *p1++);
+		c2 = crc32cb(c2, *p2++);
+	}
+
+	crc[0] = c0;
+	crc[1] = c1;
+	crc[2] = c2;
+}
+
+/* Overrides, and is exported by, the generic version in lib/crc32.c */
+void __crc32c_le_multi(u32 *crc, unsigned char const * const *p,
+		       size_t len, unsigned int nr)
+{
+	unsigned int i;
+
+	if (!cpus_have_const_cap(ARM64_HAS_CRC32)) {
+		__crc32c_le_multi_base(crc, p, len, nr);
+		return;
+	}
+
+	for (i = 0; i + 3 <= nr; i += 3)
+		crc32c_x3(crc + i, p + i, len);
+	for (; i < nr; i++)
+		crc[i] = __crc32c_le(crc[i], p[i], len);
+}
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Contiguous PTE mappings of user memory, see contpte_try_fold() in
+ * asm/pgtable.h.
+ */
+
+#include <linux/mm.h>
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+static inline pgprot_t contpte_pgprot(pte_t pte)
+{
+	return __pgprot(pte_val(pte_mknoncont(pte)) & ~PTE_ADDR_MASK);
+}
+
+/*
+ * Changing the contiguous bit of valid entries requires us to follow a
+ * Break-Before-Make approach, breaking the whole run before writing it
+ * back. See ARM DDI 0487A.k_iss10775, "Misprogramming of the Contiguous
+ * bit", page D4-1762.
+ */
+static void contpte_clear_flush(struct mm_struct *mm, unsigned long start,
+				pte_t *ptep)
+{
+	struct vm_area_struct vma = TLB_FLUSH_VMA(mm, 0);
+	int i;
+
+	for (i = 0; i < CONT_PTES; i++)
+		__pte_clear(mm, start + i * PAGE_SIZE, ptep + i);
+
+	__flush_tlb_range(&vma, start, start + CONT_PTE_SIZE, PAGE_SIZE, true);
+}
+
+/*
+ * Called with the page table lock held, right after set_pte_at() wrote
+ * 'pte' to 'ptep'. Fold the run around it if every pte in the run maps the
+ * next page with the same attributes.
+ */
+void __contpte_try_fold(struct mm_struct *mm, unsigned long addr,
+			pte_t *ptep, pte_t pte)
+{
+	unsigned long idx = (addr >> PAGE_SHIFT) & (CONT_PTES - 1);
+	unsigned long start = addr & CONT_PTE_MASK;
+	unsigned long pfn = pte_pfn(pte) - idx;
+	pgprot_t prot = contpte_pgprot(pte);
+	int i;
+
+	ptep -= idx;
+	for (i = 0; i < CONT_PTES; i++)
+		if (!pte_same(READ_ONCE(ptep[i]), pfn_pte(pfn + i, prot)))
+			return;
+
+	contpte_clear_flush(mm, start, ptep);
+
+	for (i = 0; i < CONT_PTES; i++)
+		set_pte(ptep + i, pte_mkcont(pfn_pte(pfn + i, prot)));
+}
+
+/*
+ * Called with the page table lock held. A folded run is never modified in
+ * place and the hardware does not update it, so it can be rebuilt from
+ * its first pte.
+ */
+void __contpte_unfold(struct mm_struct *mm, unsigned long addr, pte_t *ptep)
+{
+	unsigned long idx = (addr >> PAGE_SHIFT) & (CONT_PTES - 1);
+	unsigned long start = addr & CONT_PTE_MASK;
+	unsigned long pfn;
+	pgprot_t prot;
+	pte_t pte;
+	int i;
+
+	ptep -= idx;
+	pte = READ_ONCE(*ptep);
+	pfn = pte_pfn(pte);
+	prot = contpte_pgprot(pte);
+
+	contpte_clear_flush(mm, start, ptep);
+
+	for (i = 0; i < CONT_PTES; i++)
+		set_pte(ptep + i, pfn_pte(pfn + i, prot));
+}
@@ -2216,6 +2216,19 @@ static bool bfq_bio_merge(struct blk_mq_hw_ctx *hctx, struct bio *bio,
 	struct request_queue *q = hctx->queue;
 	struct bfq_data *bfqd = q->elevator->elevator_data;
 	struct request *free = NULL;
+	struct bfq_io_cq *bic;
+	bool ret;
+
+	/*
+	 * Only requests queued in some bfq_queue can be merged into,
+	 * and every such queue is busy. So, if no queue is busy,
+	 * there is nothing to look for, and we can avoid both the
+	 * queue_lock and the bfqd->lock. Racing with an insertion
+	 * can at most make us miss a merge.
+	 */
+	if (!bfq_tot_busy_queues(bfqd))
+		return false;
+
 	/*
 	 * bfq_bic_lookup grabs the queue_lock: invoke it now and
 	 * store its return value for later use, to avoid nesting
@@ -2223,8 +2236,7 @@ static bool bfq_bio_merge(struct blk_mq_hw_ctx *hctx, struct bio *bio,
 	 * returned by bfq_bic_lookup does not go away before
 	 * bfqd->lock is taken.
 	 */
-	struct bfq_io_cq *bic = bfq_bic_lookup(bfqd, current->io_context, q);
-	bool ret;
+	bic = bfq_bic_lookup(bfqd, current->io_context, q);
 
 	spin_lock_irq(&bfqd->lock);
 
@@ -5486,30 +5498,25 @@ static inline void bfq_update_insert_stats(struct request_queue *q,
 					   unsigned int cmd_flags) {}
 #endif /* CONFIG_BFQ_CGROUP_DEBUG */
 
-static void bfq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
-			       bool at_head)
+/*
+ * Insert rq into the scheduler. Must be called with bfqd->lock held.
+ * Returns the bfq_queue rq ended up in, if any, for the benefit of the
+ * insert stats.
+ */
+static struct bfq_queue *bfq_insert_request(struct request_queue *q,
+					    struct request *rq, bool at_head,
+					    bool *idle_timer_disabled)
 {
-	struct request_queue *q = hctx->queue;
 	struct bfq_data *bfqd = q->elevator->elevator_data;
 	struct bfq_queue *bfqq;
-	bool idle_timer_disabled = false;
-	unsigned int cmd_flags;
 
-#ifdef CONFIG_BFQ_GROUP_IOSCHED
-	if (!cgroup_subsys_on_dfl(io_cgrp_subsys) && rq->bio)
-		bfqg_stats_update_legacy_io(q, rq);
-#endif
-	spin_lock_irq(&bfqd->lock);
-	if (blk_mq_sched_try_insert_merge(q, rq)) {
-		spin_unlock_irq(&bfqd->lock);
-		return;
-	}
+	*idle_timer_disabled = false;
 
-	spin_unlock_irq(&bfqd->lock);
+	if (blk_mq_sched_try_insert_merge(q, rq))
+		return NULL;
 
 	blk_mq_sched_request_inserted(rq);
 
-	spin_lock_irq(&bfqd->lock);
 	bfqq = bfq_init_rq(rq);
 	if (!bfqq || at_head || blk_rq_is_passthrough(rq)) {
 		if (at_head)
@@ -5517,7 +5524,7 @@ static void bfq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		else
 			list_add_tail(&rq->queuelist, &bfqd->dispatch);
 	} else {
-		idle_timer_disabled = __bfq_insert_request(bfqd, rq);
+		*idle_timer_disabled = __bfq_insert_request(bfqd, rq);
 		/*
 		 * Update bfqq, because, if a queue merge has occurred
 		 * in __bfq_insert_request, then rq has been
@@ -5532,29 +5539,59 @@ static void bfq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		}
 	}
 
-	/*
-	 * Cache cmd_flags before releasing scheduler lock, because rq
-	 * may disappear afterwards (for example, because of a request
-	 * merge).
-	 */
-	cmd_flags = rq->cmd_flags;
-
-	spin_unlock_irq(&bfqd->lock);
-
-	bfq_update_insert_stats(q, bfqq, idle_timer_disabled,
-				cmd_flags);
+	return bfqq;
 }
 
 static void bfq_insert_requests(struct blk_mq_hw_ctx *hctx,
 				struct list_head *list, bool at_head)
 {
+	struct request_queue *q = hctx->queue;
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	struct request *rq;
+
+#ifdef CONFIG_BFQ_GROUP_IOSCHED
+	if (!cgroup_subsys_on_dfl(io_cgrp_subsys))
+		list_for_each_entry(rq, list, queuelist)
+			if (rq->bio)
+				bfqg_stats_update_legacy_io(q, rq);
+#endif
+
+	/*
+	 * Take bfqd->lock once for the whole batch, instead of twice
+	 * per request, so that a plug flush doesn't bounce the lock
+	 * once per request with the dispatchers.
+	 */
+	spin_lock_irq(&bfqd->lock);
 	while (!list_empty(list)) {
-		struct request *rq;
+		struct bfq_queue *bfqq;
+		bool idle_timer_disabled;
+		unsigned int cmd_flags;
 
 		rq = list_first_entry(list, struct request, queuelist);
 		list_del_init(&rq->queuelist);
-		bfq_insert_request(hctx, rq, at_head);
+
+		/*
+		 * Cache cmd_flags before possibly releasing the
+		 * scheduler lock, because rq may disappear afterwards
+		 * (for example, because of a request merge).
+		 */
+		cmd_flags = rq->cmd_flags;
+		bfqq = bfq_insert_request(q, rq, at_head,
+					  &idle_timer_disabled);
+
+		/*
+		 * The insert stats nest queue_lock, which must not be
+		 * taken inside bfqd->lock. They only exist for
+		 * debugging, so just bounce the lock for them.
+		 */
+		if (IS_ENABLED(CONFIG_BFQ_CGROUP_DEBUG) && bfqq) {
+			spin_unlock_irq(&bfqd->lock);
+			bfq_update_insert_stats(q, bfqq, idle_timer_disabled,
+						cmd_flags);
+			spin_lock_irq(&bfqd->lock);
+		}
 	}
+	spin_unlock_irq(&bfqd->lock);
 }
 
 static void bfq_update_hw_tag(struct bfq_data *bfqd)
@@ -19,6 +19,7 @@
 #include <linux/highmem.h>
 #include <linux/sched/sysctl.h>
 #include <linux/blk-crypto.h>
+#include <linux/cpuhotplug.h>
 
 #include <trace/events/block.h>
 #include "blk.h"
@@ -243,23 +244,115 @@ void bio_uninit(struct bio *bio)
 }
 EXPORT_SYMBOL(bio_uninit);
 
+/*
+ * Per-cpu cache of free bios for bio_sets created with %BIOSET_PERCPU_CACHE.
+ * Bios freed from task context go on @free_list, which is only touched with
+ * preemption disabled. Bios freed from interrupt context, which is where
+ * most IO completes, go on @free_list_irq, which is touched with interrupts
+ * disabled and spliced into @free_list when that runs dry.
+ */
+#define ALLOC_CACHE_THRESHOLD	16
+#define ALLOC_CACHE_MAX		256
+
+struct bio_alloc_cache {
+	struct bio		*free_list;
+	struct bio		*free_list_irq;
+	unsigned int		nr;
+	unsigned int		nr_irq;
+};
+
+static void bio_free_to_pool(struct bio *bio, struct bio_set *bs)
+{
+	void *p = bio;
+
+	/*
+	 * If we have front padding, adjust the bio pointer before freeing
+	 */
+	p -= bs->front_pad;
+	mempool_free(p, &bs->bio_pool);
+}
+
+static bool bio_put_percpu_cache(struct bio *bio, struct bio_set *bs)
+{
+	struct bio_alloc_cache *cache;
+	unsigned long flags;
+
+	cache = per_cpu_ptr(bs->cache, get_cpu());
+	if (cache->nr + READ_ONCE(cache->nr_irq) >= ALLOC_CACHE_MAX) {
+		put_cpu();
+		return false;
+	}
+
+	if (in_task()) {
+		bio->bi_next = cache->free_list;
+		cache->free_list = bio;
+		cache->nr++;
+	} else {
+		local_irq_save(flags);
+		bio->bi_next = cache->free_list_irq;
+		cache->free_list_irq = bio;
+		cache->nr_irq++;
+		local_irq_restore(flags);
+	}
+	put_cpu();
+
+	return true;
+}
+
+static void bio_alloc_cache_prune(struct bio_alloc_cache *cache,
+				  struct bio_set *bs)
+{
+	struct bio *bio;
+
+	while ((bio = cache->free_list)) {
+		cache->free_list = bio->bi_next;
+		cache->nr--;
+		bio_free_to_pool(bio, bs);
+	}
+	while ((bio = cache->free_list_irq)) {
+		cache->free_list_irq = bio->bi_next;
+		cache->nr_irq--;
+		bio_free_to_pool(bio, bs);
+	}
+}
+
+static int bio_cpu_dead(unsigned int cpu, struct hlist_node *node)
+{
+	struct bio_set *bs = hlist_entry_safe(node, struct bio_set, cpuhp_dead);
+
+	if (bs->cache)
+		bio_alloc_cache_prune(per_cpu_ptr(bs->cache, cpu), bs);
+
+	return 0;
+}
+
+static void bio_alloc_cache_destroy(struct bio_set *bs)
+{
+	int cpu;
+
+	if (!bs->cache)
+		return;
+
+	cpuhp_state_remove_instance_nocalls(CPUHP_BIO_DEAD, &bs->cpuhp_dead);
+	for_each_possible_cpu(cpu)
+		bio_alloc_cache_prune(per_cpu_ptr(bs->cache, cpu), bs);
+	free_percpu(bs->cache);
+	bs->cache = NULL;
+}
+
 static void bio_free(struct bio *bio)
 {
 	struct bio_set *bs = bio->bi_pool;
-	void *p;
 
 	bio_uninit(bio);
 
+	if (bs && bs->cache && (bio->bi_opf & REQ_ALLOC_CACHE) &&
+	    bio_put_percpu_cache(bio, bs))
+		return;
+
 	if (bs) {
 		bvec_free(&bs->bvec_pool, bio->bi_io_vec, BVEC_POOL_IDX(bio));
-
-		/*
-		 * If we have front padding, adjust the bio pointer before freeing
-		 */
-		p = bio;
-		p -= bs->front_pad;
-
-		mempool_free(p, &bs->bio_pool);
+		bio_free_to_pool(bio, bs);
 	} else {
 		/* Bio was allocated by bio_kmalloc() */
 		kfree(bio);
@@ -527,6 +620,64 @@ struct bio *bio_alloc_bioset(gfp_t gfp_mask, unsigned int nr_iovecs,
 }
 EXPORT_SYMBOL(bio_alloc_bioset);
 
+/**
+ * bio_alloc_kiocb - Allocate a bio from a bio_set for a kiocb
+ * @kiocb:	kiocb describing the IO
+ * @nr_iovecs:	number of iovecs to pre-allocate
+ * @bs:		bio_set to allocate from
+ *
+ * Description:
+ *    Like bio_alloc_bioset(), but if the kiocb has %IOCB_ALLOC_CACHE set and
+ *    @bs was created with %BIOSET_PERCPU_CACHE, small bios are recycled
+ *    through a per-cpu cache instead of going through the mempool and slab
+ *    on every IO. The bio is marked with %REQ_ALLOC_CACHE, so callers must
+ *    add to ->bi_opf rather than overwrite it for the bio to be recycled.
+ *
+ *    Always allocates with GFP_KERNEL, so must be called from a context
+ *    where that is allowed.
+ */
+struct bio *bio_alloc_kiocb(struct kiocb *kiocb, unsigned int nr_iovecs,
+			    struct bio_set *bs)
+{
+	struct bio_alloc_cache *cache;
+	unsigned long flags;
+	struct bio *bio;
+
+	if (!(kiocb->ki_flags & IOCB_ALLOC_CACHE) || !bs->cache ||
+	    nr_iovecs > BIO_INLINE_VECS)
+		return bio_alloc_bioset(GFP_KERNEL, nr_iovecs, bs);
+
+	cache = per_cpu_ptr(bs->cache, get_cpu());
+	if (!cache->free_list &&
+	    READ_ONCE(cache->nr_irq) >= ALLOC_CACHE_THRESHOLD) {
+		local_irq_save(flags);
+		cache->free_list = cache->free_list_irq;
+		cache->free_list_irq = NULL;
+		cache->nr += cache->nr_irq;
+		cache->nr_irq = 0;
+		local_irq_restore(flags);
+	}
+
+	bio = cache->free_list;
+	if (bio) {
+		cache->free_list = bio->bi_next;
+		cache->nr--;
+		put_cpu();
+		bio_init(bio, nr_iovecs ? bio->bi_inline_vecs : NULL,
+			 nr_iovecs);
+		bio->bi_pool = bs;
+	} else {
+		put_cpu();
+		bio = bio_alloc_bioset(GFP_KERNEL, nr_iovecs, bs);
+		if (!bio)
+			return NULL;
+	}
+
+	bio->bi_opf |= REQ_ALLOC_CACHE;
+	return bio;
+}
+EXPORT_SYMBOL_GPL(bio_alloc_kiocb);
+
 void zero_fill_bio_iter(struct bio *bio, struct bvec_iter start)
 {
 	unsigned long flags;
@@ -1419,6 +1570,9 @@ void bio_endio(struct bio *bio)
 	if (!bio_integrity_endio(bio))
 		return;
 
+	if (bio->bi_opf & REQ_ZONE_WPLUG)
+		blk_zone_write_plug_bio_endio(bio);
+
 	if (bio->bi_disk)
 		rq_qos_done_bio(bio->bi_disk->queue, bio);
 
@@ -1536,6 +1690,7 @@ int biovec_init_pool(mempool_t *pool, int pool_entries)
  */
 void bioset_exit(struct bio_set *bs)
 {
+	bio_alloc_cache_destroy(bs);
 	if (bs->rescue_workqueue)
 		destroy_workqueue(bs->rescue_workqueue);
 	bs->rescue_workqueue = NULL;
@@ -1555,8 +1710,8 @@ EXPORT_SYMBOL(bioset_exit);
  * @bs:		pool to initialize
  * @pool_size:	Number of bio and bio_vecs to cache in the mempool
  * @front_pad:	Number of bytes to allocate in front of the returned bio
- * @flags:	Flags to modify behavior, currently %BIOSET_NEED_BVECS
- *              and %BIOSET_NEED_RESCUER
+ * @flags:	Flags to modify behavior, currently %BIOSET_NEED_BVECS,
+ *              %BIOSET_NEED_RESCUER and %BIOSET_PERCPU_CACHE
  *
  * Description:
  *    Set up a bio_set to be used with @bio_alloc_bioset. Allows the caller
@@ -1569,6 +1724,8 @@ EXPORT_SYMBOL(bioset_exit);
  *    for allocating iovecs.  This pool is not needed e.g. for bio_clone_fast().
  *    If %BIOSET_NEED_RESCUER is set, a workqueue is created which can be used to
  *    dispatch queued requests when the mempool runs out of space.
+ *    If %BIOSET_PERCPU_CACHE is set, bios allocated with bio_alloc_kiocb()
+ *    are recycled through a per-cpu cache of free bios.
  *
  */
 int bioset_init(struct bio_set *bs,
@@ -1595,12 +1752,20 @@ int bioset_init(struct bio_set *bs,
 	    biovec_init_pool(&bs->bvec_pool, pool_size))
 		goto bad;
 
-	if (!(flags & BIOSET_NEED_RESCUER))
-		return 0;
+	if (flags & BIOSET_NEED_RESCUER) {
+		bs->rescue_workqueue = alloc_workqueue("bioset",
+						       WQ_MEM_RECLAIM, 0);
+		if (!bs->rescue_workqueue)
+			goto bad;
+	}
 
-	bs->rescue_workqueue = alloc_workqueue("bioset", WQ_MEM_RECLAIM, 0);
-	if (!bs->rescue_workqueue)
-		goto bad;
+	if (flags & BIOSET_PERCPU_CACHE) {
+		bs->cache = alloc_percpu(struct bio_alloc_cache);
+		if (!bs->cache)
+			goto bad;
+		cpuhp_state_add_instance_nocalls(CPUHP_BIO_DEAD,
+						 &bs->cpuhp_dead);
+	}
 
 	return 0;
 bad:
@@ -1622,6 +1787,8 @@ int bioset_init_from_src(struct bio_set *bs, struct bio_set *src)
 		flags |= BIOSET_NEED_BVECS;
 	if (src->rescue_workqueue)
 		flags |= BIOSET_NEED_RESCUER;
+	if (src->cache)
+		flags |= BIOSET_PERCPU_CACHE;
 
 	return bioset_init(bs, src->bio_pool.min_nr, src->front_pad, flags);
 }
@@ -1796,7 +1963,11 @@ static int __init init_bio(void)
 	bio_integrity_init();
 	biovec_init_slabs();
 
-	if (bioset_init(&fs_bio_set, BIO_POOL_SIZE, 0, BIOSET_NEED_BVECS))
+	cpuhp_setup_state_multi(CPUHP_BIO_DEAD, "block/bio:dead", NULL,
+				bio_cpu_dead);
+
+	if (bioset_init(&fs_bio_set, BIO_POOL_SIZE, 0,
+			BIOSET_NEED_BVECS | BIOSET_PERCPU_CACHE))
 		panic("bio: can't allocate bios\n");
 
 	if (bioset_integrity_create(&fs_bio_set, BIO_POOL_SIZE))
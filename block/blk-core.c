@@ -254,6 +254,14 @@ static void req_bio_endio(struct request *rq, struct bio *bio,
 			bio->bi_status = BLK_STS_IOERR;
 		else
 			bio->bi_iter.bi_sector = rq->__sector;
+	} else if ((bio->bi_opf & REQ_ZONE_WPLUG) && !bio->bi_iter.bi_size) {
+		/*
+		 * Zone write plugging needs the BIO sector to find its zone on
+		 * completion, and for an emulated zone append this is also
+		 * where the data was written. The request sector is still the
+		 * start of the request here and requests never cross zones.
+		 */
+		bio->bi_iter.bi_sector = rq->__sector;
 	}
 
 	/* don't actually finish bio if it's part of flush sequence */
@@ -1787,6 +1795,20 @@ EXPORT_SYMBOL(kblockd_mod_delayed_work_on);
  *   this kind of deadlock.
  */
 void blk_start_plug(struct blk_plug *plug)
+{
+	blk_start_plug_nr_ios(plug, 1);
+}
+EXPORT_SYMBOL(blk_start_plug);
+
+/**
+ * blk_start_plug_nr_ios - start a plug for an expected number of I/Os
+ * @plug:	The &struct blk_plug that needs to be initialized
+ * @nr_ios:	Number of I/Os the caller is about to submit
+ *
+ * Like blk_start_plug(), but lets blk-mq allocate requests for up to
+ * @nr_ios I/Os in one batch when the first one is submitted.
+ */
+void blk_start_plug_nr_ios(struct blk_plug *plug, unsigned short nr_ios)
 {
 	struct task_struct *tsk = current;
 
@@ -1798,7 +1820,9 @@ void blk_start_plug(struct blk_plug *plug)
 
 	INIT_LIST_HEAD(&plug->mq_list);
 	INIT_LIST_HEAD(&plug->cb_list);
+	INIT_LIST_HEAD(&plug->cached_rqs);
 	plug->rq_count = 0;
+	plug->nr_ios = min_t(unsigned short, nr_ios, BLK_MAX_REQUEST_COUNT);
 	plug->multiple_queues = false;
 
 	/*
@@ -1807,7 +1831,7 @@ void blk_start_plug(struct blk_plug *plug)
 	 */
 	tsk->plug = plug;
 }
-EXPORT_SYMBOL(blk_start_plug);
+EXPORT_SYMBOL(blk_start_plug_nr_ios);
 
 static void flush_plug_callbacks(struct blk_plug *plug, bool from_schedule)
 {
@@ -1857,6 +1881,13 @@ void blk_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 
 	if (!list_empty(&plug->mq_list))
 		blk_mq_flush_plug_list(plug, from_schedule);
+
+	/*
+	 * Unused cached requests pin tags, don't hold on to them across a
+	 * sleep or past the end of the plug.
+	 */
+	if (unlikely(!list_empty(&plug->cached_rqs)))
+		blk_mq_free_plug_rqs(plug);
 }
 
 /**
@@ -183,29 +183,6 @@ static struct bio *blk_crypto_clone_bio(struct bio *bio_src)
 	return bio;
 }
 
-static bool blk_crypto_alloc_cipher_req(struct blk_ksm_keyslot *slot,
-					struct skcipher_request **ciph_req_ret,
-					struct crypto_wait *wait)
-{
-	struct skcipher_request *ciph_req;
-	const struct blk_crypto_keyslot *slotp;
-	int keyslot_idx = blk_ksm_get_slot_idx(slot);
-
-	slotp = &blk_crypto_keyslots[keyslot_idx];
-	ciph_req = skcipher_request_alloc(slotp->tfms[slotp->crypto_mode],
-					  GFP_NOIO);
-	if (!ciph_req)
-		return false;
-
-	skcipher_request_set_callback(ciph_req,
-				      CRYPTO_TFM_REQ_MAY_BACKLOG |
-				      CRYPTO_TFM_REQ_MAY_SLEEP,
-				      crypto_req_done, wait);
-	*ciph_req_ret = ciph_req;
-
-	return true;
-}
-
 static bool blk_crypto_split_bio_if_needed(struct bio **bio_ptr)
 {
 	struct bio *bio = *bio_ptr;
@@ -249,6 +226,151 @@ static void blk_crypto_dun_to_iv(const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
 		iv->dun[i] = cpu_to_le64(dun[i]);
 }
 
+/*
+ * Number of data units we keep in flight at once. Asynchronous skcipher
+ * implementations (crypto engines, cryptd, pcrypt) can then work on a whole
+ * bio's worth of data units in parallel, rather than us waiting for each
+ * data unit in turn.
+ */
+#define BLK_CRYPTO_FALLBACK_BATCH	16
+
+struct blk_crypto_fallback_unit {
+	struct skcipher_request *req;
+	struct scatterlist src;
+	struct scatterlist dst;
+	union blk_crypto_iv iv;
+};
+
+struct blk_crypto_fallback_batch {
+	unsigned int reqsize;		/* stride of reqs[] */
+	unsigned int nr;		/* units queued since the last flush */
+	atomic_t pending;
+	int err;
+	struct completion done;
+	struct blk_crypto_fallback_unit units[BLK_CRYPTO_FALLBACK_BATCH];
+	u8 reqs[] CRYPTO_MINALIGN_ATTR;
+};
+
+/*
+ * One batch is cached per CPU, so the common case doesn't have to allocate
+ * and set up skcipher requests for each bio.
+ */
+static DEFINE_PER_CPU(struct blk_crypto_fallback_batch *,
+		      blk_crypto_batch_cache);
+
+static void blk_crypto_fallback_unit_done(struct blk_crypto_fallback_batch *batch,
+					  int err)
+{
+	if (err)
+		WRITE_ONCE(batch->err, err);
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+static void blk_crypto_fallback_req_done(struct crypto_async_request *areq,
+					 int err)
+{
+	/* backlogged request that has now been started */
+	if (err == -EINPROGRESS)
+		return;
+	blk_crypto_fallback_unit_done(areq->data, err);
+}
+
+static struct blk_crypto_fallback_batch *
+blk_crypto_fallback_get_batch(struct blk_ksm_keyslot *slot)
+{
+	const struct blk_crypto_keyslot *slotp =
+		&blk_crypto_keyslots[blk_ksm_get_slot_idx(slot)];
+	struct crypto_skcipher *tfm = slotp->tfms[slotp->crypto_mode];
+	unsigned int reqsize = ALIGN(sizeof(struct skcipher_request) +
+				     crypto_skcipher_reqsize(tfm),
+				     CRYPTO_MINALIGN);
+	struct blk_crypto_fallback_batch *batch;
+	unsigned int i;
+
+	batch = this_cpu_xchg(blk_crypto_batch_cache, NULL);
+	if (batch && batch->reqsize < reqsize) {
+		kfree(batch);
+		batch = NULL;
+	}
+	if (!batch) {
+		batch = kmalloc(struct_size(batch, reqs,
+				BLK_CRYPTO_FALLBACK_BATCH * reqsize), GFP_NOIO);
+		if (!batch)
+			return NULL;
+		batch->reqsize = reqsize;
+	}
+
+	batch->nr = 0;
+	batch->err = 0;
+	atomic_set(&batch->pending, 1);
+	init_completion(&batch->done);
+
+	for (i = 0; i < BLK_CRYPTO_FALLBACK_BATCH; i++) {
+		struct blk_crypto_fallback_unit *unit = &batch->units[i];
+
+		unit->req = (void *)&batch->reqs[i * batch->reqsize];
+		skcipher_request_set_tfm(unit->req, tfm);
+		skcipher_request_set_callback(unit->req,
+					      CRYPTO_TFM_REQ_MAY_BACKLOG |
+					      CRYPTO_TFM_REQ_MAY_SLEEP,
+					      blk_crypto_fallback_req_done,
+					      batch);
+		sg_init_table(&unit->src, 1);
+		sg_init_table(&unit->dst, 1);
+	}
+
+	return batch;
+}
+
+static void blk_crypto_fallback_put_batch(struct blk_crypto_fallback_batch *batch)
+{
+	/* Don't leave IVs or request contexts lying around in the cache */
+	memzero_explicit(batch->units, sizeof(batch->units));
+	memzero_explicit(batch->reqs, BLK_CRYPTO_FALLBACK_BATCH * batch->reqsize);
+
+	batch = this_cpu_xchg(blk_crypto_batch_cache, batch);
+	kfree(batch);
+}
+
+/*
+ * Wait for all units queued on @batch to finish. Returns the first error any
+ * of them hit since the batch was handed out.
+ */
+static int blk_crypto_fallback_flush(struct blk_crypto_fallback_batch *batch)
+{
+	if (!atomic_dec_and_test(&batch->pending))
+		wait_for_completion(&batch->done);
+	reinit_completion(&batch->done);
+	atomic_set(&batch->pending, 1);
+	batch->nr = 0;
+
+	return READ_ONCE(batch->err);
+}
+
+/*
+ * Start en/decrypting the next unit of @batch, which the caller has set up.
+ * Once the batch is full, wait for it to drain.
+ */
+static int blk_crypto_fallback_queue(struct blk_crypto_fallback_batch *batch,
+				     bool encrypt)
+{
+	struct skcipher_request *req = batch->units[batch->nr++].req;
+	int err;
+
+	atomic_inc(&batch->pending);
+	if (encrypt)
+		err = crypto_skcipher_encrypt(req);
+	else
+		err = crypto_skcipher_decrypt(req);
+	if (err != -EINPROGRESS && err != -EBUSY)
+		blk_crypto_fallback_unit_done(batch, err);
+
+	if (batch->nr == BLK_CRYPTO_FALLBACK_BATCH)
+		return blk_crypto_fallback_flush(batch);
+	return READ_ONCE(batch->err);
+}
+
 /*
  * The crypto API fallback's encryption routine.
  * Allocate a bounce bio for encryption, encrypt the input bio using crypto API,
@@ -262,11 +384,8 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 	struct bio_crypt_ctx *bc;
 	struct blk_ksm_keyslot *slot;
 	int data_unit_size;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
+	struct blk_crypto_fallback_batch *batch;
 	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	struct scatterlist src, dst;
-	union blk_crypto_iv iv;
 	unsigned int i, j;
 	bool ret = false;
 	blk_status_t blk_st;
@@ -296,18 +415,14 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 		goto out_put_enc_bio;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	if (!blk_crypto_alloc_cipher_req(slot, &ciph_req, &wait)) {
+	/* and then grab a batch of skcipher_requests for it */
+	batch = blk_crypto_fallback_get_batch(slot);
+	if (!batch) {
 		src_bio->bi_status = BLK_STS_RESOURCE;
 		goto out_release_keyslot;
 	}
 
 	memcpy(curr_dun, bc->bc_dun, sizeof(curr_dun));
-	sg_init_table(&src, 1);
-	sg_init_table(&dst, 1);
-
-	skcipher_request_set_crypt(ciph_req, &src, &dst, data_unit_size,
-				   iv.bytes);
 
 	/* Encrypt each page in the bounce bio */
 	for (i = 0; i < enc_bio->bi_vcnt; i++) {
@@ -323,40 +438,49 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 			goto out_free_bounce_pages;
 		}
 
-		sg_set_page(&src, plaintext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-		sg_set_page(&dst, ciphertext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-
-		/* Encrypt each data unit in this page */
+		/* Queue up each data unit in this page */
 		for (j = 0; j < enc_bvec->bv_len; j += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			if (crypto_wait_req(crypto_skcipher_encrypt(ciph_req),
-					    &wait)) {
+			struct blk_crypto_fallback_unit *unit =
+				&batch->units[batch->nr];
+
+			sg_set_page(&unit->src, plaintext_page, data_unit_size,
+				    enc_bvec->bv_offset + j);
+			sg_set_page(&unit->dst, ciphertext_page, data_unit_size,
+				    enc_bvec->bv_offset + j);
+			blk_crypto_dun_to_iv(curr_dun, &unit->iv);
+			skcipher_request_set_crypt(unit->req, &unit->src,
+						   &unit->dst, data_unit_size,
+						   unit->iv.bytes);
+			if (blk_crypto_fallback_queue(batch, true)) {
 				i++;
 				src_bio->bi_status = BLK_STS_IOERR;
 				goto out_free_bounce_pages;
 			}
 			bio_crypt_dun_increment(curr_dun, 1);
-			src.offset += data_unit_size;
-			dst.offset += data_unit_size;
 		}
 	}
 
+	if (blk_crypto_fallback_flush(batch)) {
+		src_bio->bi_status = BLK_STS_IOERR;
+		goto out_free_bounce_pages;
+	}
+
 	enc_bio->bi_private = src_bio;
 	enc_bio->bi_end_io = blk_crypto_fallback_encrypt_endio;
 	*bio_ptr = enc_bio;
 	ret = true;
 
 	enc_bio = NULL;
-	goto out_free_ciph_req;
+	goto out_put_batch;
 
 out_free_bounce_pages:
+	/* Nothing may still be writing to the bounce pages */
+	blk_crypto_fallback_flush(batch);
 	while (i > 0)
 		mempool_free(enc_bio->bi_io_vec[--i].bv_page,
 			     blk_crypto_bounce_page_pool);
-out_free_ciph_req:
-	skcipher_request_free(ciph_req);
+out_put_batch:
+	blk_crypto_fallback_put_batch(batch);
 out_release_keyslot:
 	blk_ksm_put_slot(slot);
 out_put_enc_bio:
@@ -377,11 +501,8 @@ static void blk_crypto_fallback_decrypt_bio(struct work_struct *work)
 	struct bio *bio = f_ctx->bio;
 	struct bio_crypt_ctx *bc = &f_ctx->crypt_ctx;
 	struct blk_ksm_keyslot *slot;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
+	struct blk_crypto_fallback_batch *batch;
 	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	union blk_crypto_iv iv;
-	struct scatterlist sg;
 	struct bio_vec bv;
 	struct bvec_iter iter;
 	const int data_unit_size = bc->bc_key->crypto_cfg.data_unit_size;
@@ -398,38 +519,41 @@ static void blk_crypto_fallback_decrypt_bio(struct work_struct *work)
 		goto out_no_keyslot;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	if (!blk_crypto_alloc_cipher_req(slot, &ciph_req, &wait)) {
+	/* and then grab a batch of skcipher_requests for it */
+	batch = blk_crypto_fallback_get_batch(slot);
+	if (!batch) {
 		bio->bi_status = BLK_STS_RESOURCE;
-		goto out;
+		goto out_release_keyslot;
 	}
 
 	memcpy(curr_dun, bc->bc_dun, sizeof(curr_dun));
-	sg_init_table(&sg, 1);
-	skcipher_request_set_crypt(ciph_req, &sg, &sg, data_unit_size,
-				   iv.bytes);
 
 	/* Decrypt each segment in the bio */
 	__bio_for_each_segment(bv, bio, iter, f_ctx->crypt_iter) {
 		struct page *page = bv.bv_page;
 
-		sg_set_page(&sg, page, data_unit_size, bv.bv_offset);
-
-		/* Decrypt each data unit in the segment */
+		/* Queue up each data unit in the segment */
 		for (i = 0; i < bv.bv_len; i += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			if (crypto_wait_req(crypto_skcipher_decrypt(ciph_req),
-					    &wait)) {
-				bio->bi_status = BLK_STS_IOERR;
+			struct blk_crypto_fallback_unit *unit =
+				&batch->units[batch->nr];
+
+			sg_set_page(&unit->src, page, data_unit_size,
+				    bv.bv_offset + i);
+			blk_crypto_dun_to_iv(curr_dun, &unit->iv);
+			skcipher_request_set_crypt(unit->req, &unit->src,
+						   &unit->src, data_unit_size,
+						   unit->iv.bytes);
+			if (blk_crypto_fallback_queue(batch, false))
 				goto out;
-			}
 			bio_crypt_dun_increment(curr_dun, 1);
-			sg.offset += data_unit_size;
 		}
 	}
 
 out:
-	skcipher_request_free(ciph_req);
+	if (blk_crypto_fallback_flush(batch))
+		bio->bi_status = BLK_STS_IOERR;
+	blk_crypto_fallback_put_batch(batch);
+out_release_keyslot:
 	blk_ksm_put_slot(slot);
 out_no_keyslot:
 	mempool_free(f_ctx, bio_fallback_crypt_ctx_pool);
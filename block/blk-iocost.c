@@ -289,6 +289,21 @@ enum {
 	/* switch iff the conditions are met for longer than this */
 	AUTOP_CYCLE_NSEC	= 10LLU * NSEC_PER_SEC,
 
+	/*
+	 * Cost model learning.  A saturated period is used as a sample for
+	 * a coefficient if one direction accounts for at least
+	 * LEARN_DOMINANT_PCT of the completed IOs and, within it, one IO
+	 * type does too.  A learned coefficient replaces the builtin one
+	 * after LEARN_MIN_SAMPLES samples and is re-applied when it drifts
+	 * by more than 1/LEARN_APPLY_DIV.
+	 */
+	LEARN_DOMINANT_PCT	= 80,
+	LEARN_SMALL_IO_PAGES	= 2,
+	LEARN_LARGE_IO_PAGES	= 32,
+	LEARN_EWMA_SHIFT	= 3,
+	LEARN_MIN_SAMPLES	= 8,
+	LEARN_APPLY_DIV		= 16,
+
 	/*
 	 * Count IO size in 4k pages.  The 12bit shift helps keeping
 	 * size-proportional components of cost calculation in closer
@@ -379,11 +394,28 @@ struct ioc_missed {
 	u32				last_missed;
 };
 
+/* completion counters for cost model learning, indexed by [rw][is_rand] */
+struct ioc_learn_stat {
+	u64				nr_ios[2][2];
+	u64				nr_pages[2];
+	u64				last_nr_ios[2][2];
+	u64				last_nr_pages[2];
+	sector_t			cursor[2];
+};
+
 struct ioc_pcpu_stat {
 	struct ioc_missed		missed[2];
 
 	u64				rq_wait_ns;
 	u64				last_rq_wait_ns;
+
+	struct ioc_learn_stat		learn;
+};
+
+struct ioc_learn {
+	u64				i_lcoefs[NR_I_LCOEFS];
+	u32				nr_samples[NR_I_LCOEFS];
+	u64				applied[NR_I_LCOEFS];
 };
 
 /* per device */
@@ -422,6 +454,9 @@ struct ioc {
 	int				autop_idx;
 	bool				user_qos_params:1;
 	bool				user_cost_model:1;
+	bool				learn_cost_model:1;
+
+	struct ioc_learn		learn;
 };
 
 /* per device-cgroup pair */
@@ -811,6 +846,42 @@ static void ioc_refresh_lcoefs(struct ioc *ioc)
 		    &c[LCOEF_WPAGE], &c[LCOEF_WSEQIO], &c[LCOEF_WRANDIO]);
 }
 
+/* has any usable learned coefficient drifted enough to be re-applied? */
+static bool ioc_learned_lcoefs_changed(struct ioc *ioc)
+{
+	struct ioc_learn *learn = &ioc->learn;
+	int i;
+
+	for (i = 0; i < NR_I_LCOEFS; i++) {
+		if (learn->nr_samples[i] < LEARN_MIN_SAMPLES)
+			continue;
+
+		if (abs((s64)(learn->i_lcoefs[i] - learn->applied[i])) >
+		    div64_u64(learn->applied[i], LEARN_APPLY_DIV))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Override the builtin coefficients with the learned ones which have
+ * collected enough samples.
+ */
+static void ioc_apply_learned_lcoefs(struct ioc *ioc)
+{
+	struct ioc_learn *learn = &ioc->learn;
+	int i;
+
+	for (i = 0; i < NR_I_LCOEFS; i++) {
+		if (learn->nr_samples[i] < LEARN_MIN_SAMPLES)
+			continue;
+
+		ioc->params.i_lcoefs[i] = learn->i_lcoefs[i];
+		learn->applied[i] = learn->i_lcoefs[i];
+	}
+}
+
 static bool ioc_refresh_params(struct ioc *ioc, bool force)
 {
 	const struct ioc_params *p;
@@ -835,6 +906,8 @@ static bool ioc_refresh_params(struct ioc *ioc, bool force)
 		memcpy(ioc->params.qos, p->qos, sizeof(p->qos));
 	if (!ioc->user_cost_model)
 		memcpy(ioc->params.i_lcoefs, p->i_lcoefs, sizeof(p->i_lcoefs));
+	if (ioc->learn_cost_model)
+		ioc_apply_learned_lcoefs(ioc);
 
 	ioc_refresh_period_us(ioc);
 	ioc_refresh_lcoefs(ioc);
@@ -1306,6 +1379,104 @@ static void ioc_lat_stat(struct ioc *ioc, u32 *missed_ppm_ar, u32 *rq_wait_pct_p
 				   ioc->period_us * NSEC_PER_USEC);
 }
 
+static void ioc_learn_sample(struct ioc_learn *learn, int idx, u64 v)
+{
+	u64 *est = &learn->i_lcoefs[idx];
+
+	if (!v)
+		return;
+
+	if (!learn->nr_samples[idx])
+		*est = v;
+	else
+		*est = *est - (*est >> LEARN_EWMA_SHIFT) + (v >> LEARN_EWMA_SHIFT);
+
+	if (learn->nr_samples[idx] < UINT_MAX)
+		learn->nr_samples[idx]++;
+}
+
+/*
+ * Learn the linear model coefficients from completions.
+ *
+ * If the device was saturated during the period, what completed is
+ * roughly what the device can do in a period for that IO mix.  A mixed
+ * period only tells how far off the model is as a whole, which vrate
+ * already takes care of, so only periods dominated by one kind of IO
+ * are used; those approximate the 4k random, 4k sequential and large
+ * sequential runs which would otherwise be benchmarked to build the
+ * model by hand.  In such a period, the rate of the dominant kind is
+ * scaled up by its share of the IOs to estimate its standalone rate.
+ */
+static void ioc_learn_lcoefs(struct ioc *ioc, bool saturated, u32 period_us)
+{
+	static const int lcoef_idx[2][3] = {
+		{ I_LCOEF_RBPS, I_LCOEF_RSEQIOPS, I_LCOEF_RRANDIOPS },
+		{ I_LCOEF_WBPS, I_LCOEF_WSEQIOPS, I_LCOEF_WRANDIOPS },
+	};
+	u64 nr_ios[2][2] = { }, nr_pages[2] = { };
+	u64 dir_ios[2], total_ios;
+	int cpu, rw, rand;
+
+	for_each_online_cpu(cpu) {
+		struct ioc_learn_stat *stat =
+			&per_cpu_ptr(ioc->pcpu_stat, cpu)->learn;
+
+		for (rw = READ; rw <= WRITE; rw++) {
+			u64 this_pages = READ_ONCE(stat->nr_pages[rw]);
+
+			for (rand = 0; rand <= 1; rand++) {
+				u64 this_ios = READ_ONCE(stat->nr_ios[rw][rand]);
+
+				nr_ios[rw][rand] += this_ios -
+					stat->last_nr_ios[rw][rand];
+				stat->last_nr_ios[rw][rand] = this_ios;
+			}
+			nr_pages[rw] += this_pages - stat->last_nr_pages[rw];
+			stat->last_nr_pages[rw] = this_pages;
+		}
+	}
+
+	if (!saturated || !period_us)
+		return;
+
+	dir_ios[READ] = nr_ios[READ][0] + nr_ios[READ][1];
+	dir_ios[WRITE] = nr_ios[WRITE][0] + nr_ios[WRITE][1];
+	total_ios = dir_ios[READ] + dir_ios[WRITE];
+
+	for (rw = READ; rw <= WRITE; rw++) {
+		u64 ios = dir_ios[rw], pages_per_io;
+
+		if (!ios || ios * 100 < total_ios * LEARN_DOMINANT_PCT)
+			continue;
+
+		pages_per_io = div64_u64(nr_pages[rw], ios);
+
+		for (rand = 0; rand <= 1; rand++) {
+			u64 n = nr_ios[rw][rand], v;
+			int idx;
+
+			if (n * 100 < ios * LEARN_DOMINANT_PCT)
+				continue;
+
+			if (pages_per_io >= LEARN_LARGE_IO_PAGES && !rand) {
+				/* large sequential, bytes per second */
+				v = div64_u64(nr_pages[rw] * IOC_PAGE_SIZE *
+					      USEC_PER_SEC, period_us);
+				idx = lcoef_idx[rw][0];
+			} else if (pages_per_io <= LEARN_SMALL_IO_PAGES) {
+				/* small seq or rand, IOs per second */
+				v = div64_u64(n * USEC_PER_SEC, period_us);
+				idx = lcoef_idx[rw][1 + rand];
+			} else {
+				continue;
+			}
+
+			ioc_learn_sample(&ioc->learn, idx,
+					 div64_u64(v * total_ios, n));
+		}
+	}
+}
+
 /* was iocg idle this period? */
 static bool iocg_is_idle(struct ioc_gq *iocg)
 {
@@ -1348,6 +1519,7 @@ static void ioc_timer_fn(struct timer_list *timer)
 	u32 missed_ppm[2], rq_wait_pct;
 	u64 period_vtime;
 	int prev_busy_level, i;
+	bool force_refresh = false;
 
 	/* how were the latencies during the period? */
 	ioc_lat_stat(ioc, missed_ppm, &rq_wait_pct);
@@ -1577,6 +1749,12 @@ static void ioc_timer_fn(struct timer_list *timer)
 
 	ioc->busy_level = clamp(ioc->busy_level, -1000, 1000);
 
+	if (ioc->learn_cost_model) {
+		ioc_learn_lcoefs(ioc, ioc->busy_level > 0,
+				 now.now - ioc->period_at);
+		force_refresh = ioc_learned_lcoefs_changed(ioc);
+	}
+
 	if (ioc->busy_level > 0 || (ioc->busy_level < 0 && !nr_lagging)) {
 		u64 vrate = atomic64_read(&ioc->vtime_rate);
 		u64 vrate_min = ioc->vrate_min, vrate_max = ioc->vrate_max;
@@ -1625,7 +1803,7 @@ static void ioc_timer_fn(struct timer_list *timer)
 					   nr_shortages, nr_surpluses);
 	}
 
-	ioc_refresh_params(ioc, false);
+	ioc_refresh_params(ioc, force_refresh);
 
 	/*
 	 * This period is done.  Move onto the next one.  If nothing's
@@ -1906,6 +2084,23 @@ static void ioc_rqos_done_bio(struct rq_qos *rqos, struct bio *bio)
 		atomic64_add(bio->bi_iocost_cost, &iocg->done_vtime);
 }
 
+static void ioc_learn_account(struct ioc *ioc, struct request *rq, int rw)
+{
+	struct ioc_learn_stat *stat = &get_cpu_ptr(ioc->pcpu_stat)->learn;
+	sector_t pos = blk_rq_pos(rq);
+	u64 seek_pages;
+	bool rand;
+
+	seek_pages = abs((s64)(pos - stat->cursor[rw])) >> IOC_SECT_TO_PAGE_SHIFT;
+	rand = seek_pages > LCOEF_RANDIO_PAGES;
+	stat->cursor[rw] = pos + blk_rq_stats_sectors(rq);
+
+	stat->nr_ios[rw][rand]++;
+	stat->nr_pages[rw] += max_t(u64, blk_rq_stats_sectors(rq) >>
+				    IOC_SECT_TO_PAGE_SHIFT, 1);
+	put_cpu_ptr(ioc->pcpu_stat);
+}
+
 static void ioc_rqos_done(struct rq_qos *rqos, struct request *rq)
 {
 	struct ioc *ioc = rqos_to_ioc(rqos);
@@ -1928,6 +2123,9 @@ static void ioc_rqos_done(struct rq_qos *rqos, struct request *rq)
 		return;
 	}
 
+	if (ioc->learn_cost_model)
+		ioc_learn_account(ioc, rq, rw);
+
 	on_q_ns = ktime_get_ns() - rq->alloc_time_ns;
 	rq_wait_ns = rq->start_time_ns - rq->alloc_time_ns;
 	size_nsec = div64_u64(calc_size_vtime_cost(rq, ioc), VTIME_PER_NSEC);
@@ -2381,7 +2579,8 @@ static u64 ioc_cost_model_prfill(struct seq_file *sf,
 	seq_printf(sf, "%s ctrl=%s model=linear "
 		   "rbps=%llu rseqiops=%llu rrandiops=%llu "
 		   "wbps=%llu wseqiops=%llu wrandiops=%llu\n",
-		   dname, ioc->user_cost_model ? "user" : "auto",
+		   dname, ioc->user_cost_model ? "user" :
+		   ioc->learn_cost_model ? "learn" : "auto",
 		   u[I_LCOEF_RBPS], u[I_LCOEF_RSEQIOPS], u[I_LCOEF_RRANDIOPS],
 		   u[I_LCOEF_WBPS], u[I_LCOEF_WSEQIOPS], u[I_LCOEF_WRANDIOPS]);
 	return 0;
@@ -2418,7 +2617,7 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	struct gendisk *disk;
 	struct ioc *ioc;
 	u64 u[NR_I_LCOEFS];
-	bool user;
+	bool user, learn;
 	char *p;
 	int ret;
 
@@ -2437,6 +2636,7 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	spin_lock_irq(&ioc->lock);
 	memcpy(u, ioc->params.i_lcoefs, sizeof(u));
 	user = ioc->user_cost_model;
+	learn = ioc->learn_cost_model;
 	spin_unlock_irq(&ioc->lock);
 
 	while ((p = strsep(&input, " \t\n"))) {
@@ -2451,12 +2651,18 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 		switch (match_token(p, cost_ctrl_tokens, args)) {
 		case COST_CTRL:
 			match_strlcpy(buf, &args[0], sizeof(buf));
-			if (!strcmp(buf, "auto"))
+			if (!strcmp(buf, "auto")) {
 				user = false;
-			else if (!strcmp(buf, "user"))
+				learn = false;
+			} else if (!strcmp(buf, "user")) {
 				user = true;
-			else
+				learn = false;
+			} else if (!strcmp(buf, "learn")) {
+				user = false;
+				learn = true;
+			} else {
 				goto einval;
+			}
 			continue;
 		case COST_MODEL:
 			match_strlcpy(buf, &args[0], sizeof(buf));
@@ -2472,6 +2678,7 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 			goto einval;
 		u[tok] = v;
 		user = true;
+		learn = false;
 	}
 
 	spin_lock_irq(&ioc->lock);
@@ -2481,6 +2688,10 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	} else {
 		ioc->user_cost_model = false;
 	}
+	/* (re)entering learn mode starts from the builtin parameters */
+	if (learn && !ioc->learn_cost_model)
+		memset(&ioc->learn, 0, sizeof(ioc->learn));
+	ioc->learn_cost_model = learn;
 	ioc_refresh_params(ioc, true);
 	spin_unlock_irq(&ioc->lock);
 
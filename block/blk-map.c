@@ -611,12 +611,13 @@ static int __blk_rq_map_user_iov(struct request *rq,
  * @q:		request queue where request should be inserted
  * @rq:		request to map data to
  * @map_data:   pointer to the rq_map_data holding pages (if necessary)
- * @iter:	iovec iterator
+ * @iter:	iovec or bvec iterator
  * @gfp_mask:	memory allocation flags
  *
  * Description:
  *    Data will be mapped directly for zero copy I/O, if possible. Otherwise
- *    a kernel bounce buffer is used.
+ *    a kernel bounce buffer is used. Bvec iterators can only be mapped
+ *    directly.
  *
  *    A matching blk_rq_unmap_user() must be issued at the end of I/O, while
  *    still in process context.
@@ -637,7 +638,7 @@ int blk_rq_map_user_iov(struct request_queue *q, struct request *rq,
 	struct iov_iter i;
 	int ret = -EINVAL;
 
-	if (!iter_is_iovec(iter))
+	if (!iter_is_iovec(iter) && !iov_iter_is_bvec(iter))
 		goto fail;
 
 	if (map_data)
@@ -647,6 +648,13 @@ int blk_rq_map_user_iov(struct request_queue *q, struct request *rq,
 	else if (queue_virt_boundary(q))
 		copy = queue_virt_boundary(q) & iov_iter_gap_alignment(iter);
 
+	/*
+	 * Kernel pages (e.g. io_uring registered buffers) can be mapped
+	 * directly, but the bounce copy path only knows about user iovecs.
+	 */
+	if (copy && iov_iter_is_bvec(iter))
+		goto fail;
+
 	i = *iter;
 	do {
 		ret =__blk_rq_map_user_iov(rq, map_data, &i, gfp_mask, copy);
@@ -191,6 +191,41 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 	return tag + tag_offset;
 }
 
+/*
+ * Grab up to @nr_tags driver tags in one go for a plug request cache. Only
+ * for plain allocations: no scheduler, reserved or shallow depth limits and
+ * no tag sharing, whose fairness accounting works one tag at a time.
+ *
+ * Returns the mask of allocated tags relative to *@offset, or 0.
+ */
+unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
+			      unsigned int *offset)
+{
+	struct blk_mq_tags *tags = blk_mq_tags_from_data(data);
+	unsigned long ret;
+
+	if (data->flags & (BLK_MQ_REQ_INTERNAL | BLK_MQ_REQ_RESERVED) ||
+	    data->shallow_depth || data->hctx->flags & BLK_MQ_F_TAG_SHARED)
+		return 0;
+
+	ret = __sbitmap_queue_get_batch(&tags->bitmap_tags, nr_tags, offset);
+	if (!ret)
+		return 0;
+
+	if (unlikely(test_bit(BLK_MQ_S_INACTIVE, &data->hctx->state))) {
+		unsigned long mask = ret;
+		int i;
+
+		for_each_set_bit(i, &mask, BITS_PER_LONG)
+			sbitmap_queue_clear(&tags->bitmap_tags, *offset + i,
+					    data->ctx->cpu);
+		return 0;
+	}
+
+	*offset += tags->nr_reserved_tags;
+	return ret;
+}
+
 bool __blk_mq_get_driver_tag(struct request *rq)
 {
 	struct sbitmap_queue *bt = &rq->mq_hctx->tags->bitmap_tags;
@@ -232,6 +267,13 @@ void blk_mq_put_tag(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
 	}
 }
 
+/* Free a batch of non-reserved driver tags */
+void blk_mq_put_tags(struct blk_mq_tags *tags, int *tag_array, int nr_tags)
+{
+	sbitmap_queue_clear_batch(&tags->bitmap_tags, tags->nr_reserved_tags,
+				  tag_array, nr_tags);
+}
+
 struct bt_iter_data {
 	struct blk_mq_hw_ctx *hctx;
 	busy_iter_fn *fn;
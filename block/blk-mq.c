@@ -347,6 +347,35 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 	return rq;
 }
 
+/*
+ * Allocate data->nr_tags requests with a single tag bitmap operation. The
+ * first one is returned, the others go to data->cached_rqs. Each request
+ * holds its own q_usage_counter reference, as if allocated separately.
+ */
+static struct request *
+__blk_mq_alloc_requests_batch(struct blk_mq_alloc_data *data, u64 alloc_time_ns)
+{
+	struct request *rq, *first = NULL;
+	unsigned int tag_offset;
+	unsigned long tag_mask;
+	int i;
+
+	tag_mask = blk_mq_get_tags(data, data->nr_tags, &tag_offset);
+	if (unlikely(!tag_mask))
+		return NULL;
+
+	percpu_ref_get_many(&data->q->q_usage_counter, hweight_long(tag_mask) - 1);
+
+	for_each_set_bit(i, &tag_mask, BITS_PER_LONG) {
+		rq = blk_mq_rq_ctx_init(data, tag_offset + i, alloc_time_ns);
+		if (!first)
+			first = rq;
+		else
+			list_add_tail(&rq->queuelist, data->cached_rqs);
+	}
+	return first;
+}
+
 static struct request *__blk_mq_alloc_request(struct blk_mq_alloc_data *data)
 {
 	struct request_queue *q = data->q;
@@ -381,6 +410,15 @@ static struct request *__blk_mq_alloc_request(struct blk_mq_alloc_data *data)
 	if (!(data->flags & BLK_MQ_REQ_INTERNAL))
 		blk_mq_tag_busy(data->hctx);
 
+	if (data->nr_tags > 1) {
+		struct request *rq;
+
+		rq = __blk_mq_alloc_requests_batch(data, alloc_time_ns);
+		if (rq)
+			return rq;
+		data->nr_tags = 1;
+	}
+
 	/*
 	 * Waiting allocations only fail because of an inactive hctx.  In that
 	 * case just retry the hctx assignment and tag allocation as CPU hotplug
@@ -592,11 +630,33 @@ static void __blk_mq_complete_request_remote(void *data)
  * completion routine after they've reclaimed timed out requests to bypass
  * potentially subsequent fake timeouts.
  */
+static bool blk_mq_complete_need_ipi(struct request *rq, int cpu)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+	struct request_queue *q = rq->q;
+
+	/*
+	 * For a polled request, always complete locallly, it's pointless
+	 * to redirect the completion.
+	 */
+	if ((rq->cmd_flags & REQ_HIPRI) ||
+	    !test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags))
+		return false;
+
+	if (cpu == ctx->cpu || !cpu_online(ctx->cpu))
+		return false;
+
+	if (!test_bit(QUEUE_FLAG_SAME_FORCE, &q->queue_flags) &&
+	    cpus_share_cache(cpu, ctx->cpu))
+		return false;
+
+	return true;
+}
+
 void blk_mq_force_complete_rq(struct request *rq)
 {
 	struct blk_mq_ctx *ctx = rq->mq_ctx;
 	struct request_queue *q = rq->q;
-	bool shared = false;
 	int cpu;
 
 	WRITE_ONCE(rq->state, MQ_RQ_COMPLETE);
@@ -614,21 +674,8 @@ void blk_mq_force_complete_rq(struct request *rq)
 		return;
 	}
 
-	/*
-	 * For a polled request, always complete locallly, it's pointless
-	 * to redirect the completion.
-	 */
-	if ((rq->cmd_flags & REQ_HIPRI) ||
-	    !test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags)) {
-		q->mq_ops->complete(rq);
-		return;
-	}
-
 	cpu = get_cpu();
-	if (!test_bit(QUEUE_FLAG_SAME_FORCE, &q->queue_flags))
-		shared = cpus_share_cache(cpu, ctx->cpu);
-
-	if (cpu != ctx->cpu && !shared && cpu_online(ctx->cpu)) {
+	if (blk_mq_complete_need_ipi(rq, cpu)) {
 		rq->csd.func = __blk_mq_complete_request_remote;
 		rq->csd.info = rq;
 		rq->csd.flags = 0;
@@ -660,6 +707,119 @@ static void hctx_lock(struct blk_mq_hw_ctx *hctx, int *srcu_idx)
 		*srcu_idx = srcu_read_lock(hctx->srcu);
 }
 
+/**
+ * blk_mq_add_to_batch - queue a successfully completed request on a batch
+ * @rq:		the request the device completed without error
+ * @iob:	batch to add @rq to
+ * @complete:	driver callback that will finish the batch
+ *
+ * Description:
+ *	Replaces blk_mq_complete_request() for requests that can be ended by
+ *	blk_mq_end_request_batch(): no I/O scheduler, no ->end_io, no
+ *	reserved tag, and a completion that would run on this CPU anyway.
+ *	Returns false if @rq must be completed the regular way instead.
+ **/
+bool blk_mq_add_to_batch(struct request *rq, struct io_comp_batch *iob,
+			 void (*complete)(struct io_comp_batch *))
+{
+	struct request_queue *q = rq->q;
+
+	if (!iob || rq->end_io || (rq->rq_flags & RQF_ELVPRIV) ||
+	    rq->internal_tag != BLK_MQ_NO_TAG || q->nr_hw_queues == 1 ||
+	    test_bit(QUEUE_FLAG_FAIL_IO, &q->queue_flags) ||
+	    blk_mq_tag_is_reserved(rq->mq_hctx->tags, rq->tag) ||
+	    blk_mq_complete_need_ipi(rq, raw_smp_processor_id()))
+		return false;
+
+	if (iob->complete && iob->complete != complete)
+		return false;
+	iob->complete = complete;
+
+	WRITE_ONCE(rq->state, MQ_RQ_COMPLETE);
+	if (blk_mq_need_time_stamp(rq))
+		iob->need_ts = true;
+	list_add_tail(&rq->queuelist, &iob->req_list);
+	return true;
+}
+EXPORT_SYMBOL_GPL(blk_mq_add_to_batch);
+
+#define TAG_COMP_BATCH		32
+
+static void blk_mq_flush_tag_batch(struct blk_mq_hw_ctx *hctx, int *tag_array,
+				   int nr_tags)
+{
+	struct request_queue *q = hctx->queue;
+
+	blk_mq_put_tags(hctx->tags, tag_array, nr_tags);
+	blk_mq_sched_restart(hctx);
+	percpu_ref_put_many(&q->q_usage_counter, nr_tags);
+}
+
+/**
+ * blk_mq_end_request_batch - end I/O on a batch of requests
+ * @iob:	batch built with blk_mq_add_to_batch()
+ *
+ * Description:
+ *	Like blk_mq_end_request(rq, BLK_STS_OK) for every request of @iob,
+ *	but takes at most one timestamp and returns the tags and queue
+ *	references of consecutive requests of the same hctx in one go.
+ **/
+void blk_mq_end_request_batch(struct io_comp_batch *iob)
+{
+	int tags[TAG_COMP_BATCH], nr_tags = 0;
+	struct blk_mq_hw_ctx *cur_hctx = NULL;
+	struct request *rq, *next;
+	u64 now = 0;
+
+	if (iob->need_ts)
+		now = ktime_get_ns();
+
+	list_for_each_entry_safe(rq, next, &iob->req_list, queuelist) {
+		struct blk_mq_hw_ctx *hctx = rq->mq_hctx;
+
+		list_del_init(&rq->queuelist);
+
+		if (blk_update_request(rq, BLK_STS_OK, blk_rq_bytes(rq)))
+			BUG();
+
+		if (rq->rq_flags & RQF_STATS) {
+			blk_mq_poll_stats_start(rq->q);
+			blk_stat_add(rq, now);
+		}
+		blk_account_io_done(rq, now);
+
+		rq->mq_ctx->rq_completed[rq_is_sync(rq)]++;
+		if (rq->rq_flags & RQF_MQ_INFLIGHT)
+			atomic_dec(&hctx->nr_active);
+		if (unlikely(laptop_mode && !blk_rq_is_passthrough(rq)))
+			laptop_io_completion(rq->q->backing_dev_info);
+		rq_qos_done(rq->q, rq);
+
+		WRITE_ONCE(rq->state, MQ_RQ_IDLE);
+		if (!refcount_dec_and_test(&rq->ref))
+			continue;
+
+		blk_crypto_free_request(rq);
+		blk_pm_mark_last_busy(rq);
+		rq->mq_hctx = NULL;
+
+		if (nr_tags == TAG_COMP_BATCH || cur_hctx != hctx) {
+			if (cur_hctx)
+				blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags);
+			nr_tags = 0;
+			cur_hctx = hctx;
+		}
+		tags[nr_tags++] = rq->tag;
+	}
+
+	if (nr_tags)
+		blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags);
+
+	iob->need_ts = false;
+	iob->complete = NULL;
+}
+EXPORT_SYMBOL_GPL(blk_mq_end_request_batch);
+
 /**
  * blk_mq_complete_request - end I/O on a request
  * @rq:		the request being processed
@@ -1789,6 +1949,16 @@ static int plug_rq_cmp(void *priv, struct list_head *a, struct list_head *b)
 	return blk_rq_pos(rqa) > blk_rq_pos(rqb);
 }
 
+void blk_mq_free_plug_rqs(struct blk_plug *plug)
+{
+	struct request *rq, *next;
+
+	list_for_each_entry_safe(rq, next, &plug->cached_rqs, queuelist) {
+		list_del_init(&rq->queuelist);
+		blk_mq_free_request(rq);
+	}
+}
+
 void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 {
 	LIST_HEAD(list);
@@ -2014,6 +2184,30 @@ static void blk_add_rq_to_plug(struct blk_plug *plug, struct request *rq)
 	}
 }
 
+/*
+ * Take a request preallocated in the plug by __blk_mq_alloc_requests_batch(),
+ * if it was set up for the hardware queue this bio maps to.
+ */
+static struct request *blk_mq_get_cached_request(struct request_queue *q,
+		struct blk_plug *plug, struct bio *bio)
+{
+	struct request *rq;
+
+	if (!plug || list_empty(&plug->cached_rqs))
+		return NULL;
+
+	rq = list_first_entry(&plug->cached_rqs, struct request, queuelist);
+	if (rq->q != q || op_is_flush(bio->bi_opf) ||
+	    blk_mq_map_queue(q, bio->bi_opf, rq->mq_ctx) != rq->mq_hctx)
+		return NULL;
+
+	list_del_init(&rq->queuelist);
+	rq->cmd_flags = bio->bi_opf;
+	if (blk_mq_need_time_stamp(rq))
+		rq->start_time_ns = ktime_get_ns();
+	return rq;
+}
+
 /**
  * blk_mq_make_request - Create and send a request to block device.
  * @q: Request queue pointer.
@@ -2047,6 +2241,14 @@ blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	blk_queue_bounce(q, &bio);
 	__blk_queue_split(q, &bio, &nr_segs);
 
+	/*
+	 * Writes to sequential zones go through the zone write plug, which
+	 * may hold on to the BIO (and its queue reference) until earlier
+	 * writes to the zone complete.
+	 */
+	if (blk_zone_plug_bio(q, bio))
+		return BLK_QC_T_NONE;
+
 	if (!bio_integrity_prep(bio))
 		goto queue_exit;
 
@@ -2059,13 +2261,26 @@ blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 
 	rq_qos_throttle(q, bio);
 
-	data.cmd_flags = bio->bi_opf;
-	rq = __blk_mq_alloc_request(&data);
-	if (unlikely(!rq)) {
-		rq_qos_cleanup(q, bio);
-		if (bio->bi_opf & REQ_NOWAIT)
-			bio_wouldblock_error(bio);
-		goto queue_exit;
+	plug = blk_mq_plug(q, bio);
+	rq = blk_mq_get_cached_request(q, plug, bio);
+	if (rq) {
+		/* The cached request already holds a queue reference */
+		blk_queue_exit(q);
+		data.hctx = rq->mq_hctx;
+	} else {
+		data.cmd_flags = bio->bi_opf;
+		if (plug && plug->nr_ios > 1 && !is_flush_fua) {
+			data.nr_tags = plug->nr_ios;
+			data.cached_rqs = &plug->cached_rqs;
+			plug->nr_ios = 1;
+		}
+		rq = __blk_mq_alloc_request(&data);
+		if (unlikely(!rq)) {
+			rq_qos_cleanup(q, bio);
+			if (bio->bi_opf & REQ_NOWAIT)
+				bio_wouldblock_error(bio);
+			goto queue_exit;
+		}
 	}
 
 	trace_block_getrq(q, bio, bio->bi_opf);
@@ -2084,7 +2299,6 @@ blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 		return BLK_QC_T_NONE;
 	}
 
-	plug = blk_mq_plug(q, bio);
 	if (unlikely(is_flush_fua)) {
 		/* Bypass scheduler for flush requests */
 		blk_insert_flush(rq);
@@ -3586,9 +3800,31 @@ static void blk_mq_poll_stats_fn(struct blk_stat_callback *cb)
 	}
 }
 
+/*
+ * Estimate the @pct percentile of the completion time described by @stat.
+ *
+ * blk_rq_stat only tracks min, mean and max, so model the distribution as
+ * two linear segments: min..mean covers the lower half of the samples and
+ * mean..max the upper half. This keeps a long tail (which drags the mean
+ * and max out) from inflating the lower percentiles, which are the ones
+ * hybrid polling wants to sleep for.
+ */
+static u64 blk_mq_poll_stat_percentile(const struct blk_rq_stat *stat,
+				       unsigned int pct)
+{
+	u64 min = min(stat->min, stat->mean);
+	u64 max = max(stat->max, stat->mean);
+
+	if (pct <= 50)
+		return min + div_u64((stat->mean - min) * pct, 50);
+
+	return stat->mean + div_u64((max - stat->mean) * (pct - 50), 50);
+}
+
 static unsigned long blk_mq_poll_nsecs(struct request_queue *q,
 				       struct request *rq)
 {
+	unsigned int pct = READ_ONCE(q->poll_percentile);
 	unsigned long ret = 0;
 	int bucket;
 
@@ -3612,7 +3848,17 @@ static unsigned long blk_mq_poll_nsecs(struct request_queue *q,
 	if (bucket < 0)
 		return ret;
 
-	if (q->poll_stat[bucket].nr_samples)
+	if (!q->poll_stat[bucket].nr_samples)
+		return ret;
+
+	/*
+	 * With a target percentile set, sleep for roughly the time by which
+	 * that fraction of requests of this size would have completed, and
+	 * spin for the rest.
+	 */
+	if (pct)
+		ret = blk_mq_poll_stat_percentile(&q->poll_stat[bucket], pct);
+	else
 		ret = (q->poll_stat[bucket].mean + 1) / 2;
 
 	return ret;
@@ -3632,7 +3878,7 @@ static bool blk_mq_poll_hybrid_sleep(struct request_queue *q,
 	/*
 	 * If we get here, hybrid polling is enabled. Hence poll_nsec can be:
 	 *
-	 *  0:	use half of prev avg
+	 *  0:	use half of prev avg, or the io_poll_percentile estimate
 	 * >0:	use this specific value
 	 */
 	if (q->poll_nsec > 0)
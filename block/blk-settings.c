@@ -239,6 +239,9 @@ void blk_queue_max_zone_append_sectors(struct request_queue *q,
 	max_sectors = min(q->limits.max_hw_sectors, max_zone_append_sectors);
 	max_sectors = min(q->limits.chunk_sectors, max_sectors);
 
+	/* The driver handles zone append itself, stop emulating it */
+	blk_queue_flag_clear(QUEUE_FLAG_ZONE_APPEND_EMU, q);
+
 	/*
 	 * Signal eventual driver bugs resulting in the max_zone_append sectors limit
 	 * being 0 due to a 0 argument, the chunk_sectors limit (zone size) not set,
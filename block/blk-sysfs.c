@@ -397,6 +397,31 @@ static ssize_t queue_poll_delay_store(struct request_queue *q, const char *page,
 	return count;
 }
 
+static ssize_t queue_poll_percentile_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(q->poll_percentile, page);
+}
+
+static ssize_t queue_poll_percentile_store(struct request_queue *q,
+					   const char *page, size_t count)
+{
+	unsigned long val;
+	ssize_t ret;
+
+	if (!q->mq_ops || !q->mq_ops->poll)
+		return -EINVAL;
+
+	ret = queue_var_store(&val, page, count);
+	if (ret < 0)
+		return ret;
+
+	if (val > 99)
+		return -EINVAL;
+
+	WRITE_ONCE(q->poll_percentile, val);
+	return ret;
+}
+
 static ssize_t queue_poll_show(struct request_queue *q, char *page)
 {
 	return queue_var_show(test_bit(QUEUE_FLAG_POLL, &q->queue_flags), page);
@@ -496,6 +521,33 @@ static ssize_t queue_wb_lat_store(struct request_queue *q, const char *page,
 	return count;
 }
 
+static ssize_t queue_wb_noisy_pct_show(struct request_queue *q, char *page)
+{
+	if (!wbt_rq_qos(q))
+		return -EINVAL;
+
+	return queue_var_show(wbt_get_noisy_pct(q), page);
+}
+
+static ssize_t queue_wb_noisy_pct_store(struct request_queue *q,
+					const char *page, size_t count)
+{
+	unsigned long val;
+	ssize_t ret;
+
+	if (!wbt_rq_qos(q))
+		return -EINVAL;
+
+	ret = queue_var_store(&val, page, count);
+	if (ret < 0)
+		return ret;
+	if (val > 100)
+		return -EINVAL;
+
+	wbt_set_noisy_pct(q, val);
+	return ret;
+}
+
 static ssize_t queue_wc_show(struct request_queue *q, char *page)
 {
 	if (test_bit(QUEUE_FLAG_WC, &q->queue_flags))
@@ -703,6 +755,12 @@ static struct queue_sysfs_entry queue_poll_delay_entry = {
 	.store = queue_poll_delay_store,
 };
 
+static struct queue_sysfs_entry queue_poll_percentile_entry = {
+	.attr = {.name = "io_poll_percentile", .mode = 0644 },
+	.show = queue_poll_percentile_show,
+	.store = queue_poll_percentile_store,
+};
+
 static struct queue_sysfs_entry queue_wc_entry = {
 	.attr = {.name = "write_cache", .mode = 0644 },
 	.show = queue_wc_show,
@@ -731,6 +789,12 @@ static struct queue_sysfs_entry queue_wb_lat_entry = {
 	.store = queue_wb_lat_store,
 };
 
+static struct queue_sysfs_entry queue_wb_noisy_pct_entry = {
+	.attr = {.name = "wbt_noisy_pct", .mode = 0644 },
+	.show = queue_wb_noisy_pct_show,
+	.store = queue_wb_noisy_pct_store,
+};
+
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
 static struct queue_sysfs_entry throtl_sample_time_entry = {
 	.attr = {.name = "throttle_sample_time", .mode = 0644 },
@@ -774,7 +838,9 @@ static struct attribute *queue_attrs[] = {
 	&queue_fua_entry.attr,
 	&queue_dax_entry.attr,
 	&queue_wb_lat_entry.attr,
+	&queue_wb_noisy_pct_entry.attr,
 	&queue_poll_delay_entry.attr,
+	&queue_poll_percentile_entry.attr,
 	&queue_io_timeout_entry.attr,
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
 	&throtl_sample_time_entry.attr,
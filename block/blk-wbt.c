@@ -15,6 +15,10 @@
  *   scaling step of 0 if reads show up or the heavy writers finish. Unlike
  *   positive scaling steps where we shrink the monitoring window, a negative
  *   scaling step retains the default step==0 window size.
+ * - With cgroups, count the tracked writes each blkg issues per window. When
+ *   we are scaled down, only blkgs that issued a large share of the writes
+ *   in the last window get the reduced depths. Everybody else keeps the
+ *   step==0 limits, so one noisy writer doesn't throttle its neighbours.
  *
  * Copyright (C) 2016 Jens Axboe
  *
@@ -24,6 +28,7 @@
 #include <linux/slab.h>
 #include <linux/backing-dev.h>
 #include <linux/swap.h>
+#include <linux/blk-cgroup.h>
 
 #include "blk-wbt.h"
 #include "blk-rq-qos.h"
@@ -73,6 +78,12 @@ enum {
 	 * information to scale up or down, scale up.
 	 */
 	RWB_UNKNOWN_BUMP	= 5,
+
+	/*
+	 * Default share of a window's tracked writes, in percent, a blkg
+	 * must have issued to be throttled when we're scaled down.
+	 */
+	RWB_DEF_NOISY_PCT	= 25,
 };
 
 static inline bool rwb_enabled(struct rq_wb *rwb)
@@ -304,6 +315,12 @@ static void calc_wb_limits(struct rq_wb *rwb)
 		rwb->wb_normal = (rwb->rq_depth.max_depth + 1) / 2;
 		rwb->wb_background = (rwb->rq_depth.max_depth + 3) / 4;
 	}
+
+	if (rwb->rq_depth.scale_step == 0) {
+		rwb->wb_max_base = rwb->rq_depth.max_depth;
+		rwb->wb_background_base = rwb->wb_background;
+		rwb->wb_normal_base = rwb->wb_normal;
+	}
 }
 
 static void scale_up(struct rq_wb *rwb)
@@ -349,6 +366,72 @@ static void rwb_arm_timer(struct rq_wb *rwb)
 	blk_stat_activate_nsecs(rwb->cb, rwb->cur_win_nsec);
 }
 
+#ifdef CONFIG_BLK_CGROUP
+/*
+ * Re-classify the blkgs on this queue based on the tracked writes they
+ * issued in the window that just ended. A window with too few writes to
+ * tell keeps the previous classification.
+ */
+static void wbt_update_noisy(struct rq_wb *rwb)
+{
+	struct request_queue *q = rwb->rqos.q;
+	struct cgroup_subsys_state *pos_css;
+	struct blkcg_gq *blkg;
+	unsigned int total, nr, nr_noisy = 0;
+	bool noisy;
+
+	total = atomic_xchg(&rwb->window_ios, 0);
+	if (!q->root_blkg)
+		return;
+
+	rcu_read_lock();
+	blkg_for_each_descendant_pre(blkg, pos_css, q->root_blkg) {
+		nr = atomic_xchg(&blkg->wbt_nr_ios, 0);
+		if (total >= RWB_MIN_WRITE_SAMPLES)
+			noisy = (u64)nr * 100 >= (u64)total * rwb->noisy_pct;
+		else
+			noisy = READ_ONCE(blkg->wbt_noisy);
+		WRITE_ONCE(blkg->wbt_noisy, noisy);
+		nr_noisy += noisy;
+	}
+	rcu_read_unlock();
+
+	rwb->nr_noisy = nr_noisy;
+}
+
+static void wbt_account_bio(struct rq_wb *rwb, struct bio *bio)
+{
+	if (!rwb->noisy_pct || !bio->bi_blkg)
+		return;
+	atomic_inc(&bio->bi_blkg->wbt_nr_ios);
+	atomic_inc(&rwb->window_ios);
+}
+
+/*
+ * Should @bio be subject to the scaled down depths? Without a noisy
+ * threshold, or without knowing who issued it, everybody is.
+ */
+static bool wbt_bio_noisy(struct rq_wb *rwb, struct bio *bio)
+{
+	if (!rwb->noisy_pct || !bio->bi_blkg)
+		return true;
+	return READ_ONCE(bio->bi_blkg->wbt_noisy);
+}
+#else
+static inline void wbt_update_noisy(struct rq_wb *rwb)
+{
+}
+
+static inline void wbt_account_bio(struct rq_wb *rwb, struct bio *bio)
+{
+}
+
+static inline bool wbt_bio_noisy(struct rq_wb *rwb, struct bio *bio)
+{
+	return true;
+}
+#endif
+
 static void wb_timer_fn(struct blk_stat_callback *cb)
 {
 	struct rq_wb *rwb = cb->data;
@@ -357,6 +440,7 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 	int status;
 
 	status = latency_exceeded(rwb, cb->stat);
+	wbt_update_noisy(rwb);
 
 	trace_wbt_timer(rwb->rqos.q->backing_dev_info, status, rqd->scale_step,
 			inflight);
@@ -436,6 +520,23 @@ void wbt_set_min_lat(struct request_queue *q, u64 val)
 	wbt_update_limits(RQWB(rqos));
 }
 
+unsigned int wbt_get_noisy_pct(struct request_queue *q)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+	if (!rqos)
+		return 0;
+	return RQWB(rqos)->noisy_pct;
+}
+
+void wbt_set_noisy_pct(struct request_queue *q, unsigned int val)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+	if (!rqos)
+		return;
+	RQWB(rqos)->noisy_pct = val;
+	rwb_wake_all(RQWB(rqos));
+}
+
 
 static bool close_io(struct rq_wb *rwb)
 {
@@ -447,7 +548,8 @@ static bool close_io(struct rq_wb *rwb)
 
 #define REQ_HIPRIO	(REQ_SYNC | REQ_META | REQ_PRIO)
 
-static inline unsigned int get_limit(struct rq_wb *rwb, unsigned long rw)
+static inline unsigned int get_limit(struct rq_wb *rwb, unsigned long rw,
+				     bool noisy)
 {
 	unsigned int limit;
 
@@ -461,6 +563,19 @@ static inline unsigned int get_limit(struct rq_wb *rwb, unsigned long rw)
 	if ((rw & REQ_OP_MASK) == REQ_OP_DISCARD)
 		return rwb->wb_background;
 
+	/*
+	 * If we're scaled down but this writer isn't one of the ones
+	 * flooding the queue, don't make it pay for the others.
+	 */
+	if (!noisy && rwb->rq_depth.scale_step > 0) {
+		if ((rw & REQ_HIPRIO) || wb_recent_wait(rwb) ||
+		    current_is_kswapd())
+			return rwb->wb_max_base;
+		else if ((rw & REQ_BACKGROUND) || close_io(rwb))
+			return rwb->wb_background_base;
+		return rwb->wb_normal_base;
+	}
+
 	/*
 	 * At this point we know it's a buffered write. If this is
 	 * kswapd trying to free memory, or REQ_SYNC is set, then
@@ -487,12 +602,14 @@ struct wbt_wait_data {
 	struct rq_wb *rwb;
 	enum wbt_flags wb_acct;
 	unsigned long rw;
+	bool noisy;
 };
 
 static bool wbt_inflight_cb(struct rq_wait *rqw, void *private_data)
 {
 	struct wbt_wait_data *data = private_data;
-	return rq_wait_inc_below(rqw, get_limit(data->rwb, data->rw));
+	return rq_wait_inc_below(rqw, get_limit(data->rwb, data->rw,
+						data->noisy));
 }
 
 static void wbt_cleanup_cb(struct rq_wait *rqw, void *private_data)
@@ -506,15 +623,23 @@ static void wbt_cleanup_cb(struct rq_wait *rqw, void *private_data)
  * the timer to kick off queuing again.
  */
 static void __wbt_wait(struct rq_wb *rwb, enum wbt_flags wb_acct,
-		       unsigned long rw)
+		       struct bio *bio)
 {
 	struct rq_wait *rqw = get_rq_wait(rwb, wb_acct);
 	struct wbt_wait_data data = {
 		.rwb = rwb,
 		.wb_acct = wb_acct,
-		.rw = rw,
+		.rw = bio->bi_opf,
+		.noisy = wbt_bio_noisy(rwb, bio),
 	};
 
+	/*
+	 * Writers that aren't being throttled shouldn't queue up behind
+	 * the sleepers that are, try and grab a slot directly.
+	 */
+	if (!data.noisy && wbt_inflight_cb(rqw, &data))
+		return;
+
 	rq_qos_wait(rqw, &data, wbt_inflight_cb, wbt_cleanup_cb);
 }
 
@@ -580,7 +705,10 @@ static void wbt_wait(struct rq_qos *rqos, struct bio *bio)
 		return;
 	}
 
-	__wbt_wait(rwb, flags, bio->bi_opf);
+	if (!(flags & WBT_DISCARD))
+		wbt_account_bio(rwb, bio);
+
+	__wbt_wait(rwb, flags, bio);
 
 	if (!blk_stat_is_active(rwb->cb))
 		rwb_arm_timer(rwb);
@@ -782,6 +910,15 @@ static int wbt_background_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+static int wbt_nr_noisy_show(void *data, struct seq_file *m)
+{
+	struct rq_qos *rqos = data;
+	struct rq_wb *rwb = RQWB(rqos);
+
+	seq_printf(m, "%u\n", rwb->nr_noisy);
+	return 0;
+}
+
 static const struct blk_mq_debugfs_attr wbt_debugfs_attrs[] = {
 	{"curr_win_nsec", 0400, wbt_curr_win_nsec_show},
 	{"enabled", 0400, wbt_enabled_show},
@@ -791,6 +928,7 @@ static const struct blk_mq_debugfs_attr wbt_debugfs_attrs[] = {
 	{"unknown_cnt", 0400, wbt_unknown_cnt_show},
 	{"wb_normal", 0400, wbt_normal_show},
 	{"wb_background", 0400, wbt_background_show},
+	{"nr_noisy", 0400, wbt_nr_noisy_show},
 	{},
 };
 #endif
@@ -834,6 +972,7 @@ int wbt_init(struct request_queue *q)
 	rwb->win_nsec = RWB_WINDOW_NSEC;
 	rwb->enable_state = WBT_STATE_ON_DEFAULT;
 	rwb->wc = 1;
+	rwb->noisy_pct = RWB_DEF_NOISY_PCT;
 	rwb->rq_depth.default_depth = RWB_DEF_DEPTH;
 	wbt_update_limits(rwb);
 
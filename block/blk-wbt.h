@@ -43,6 +43,22 @@ struct rq_wb {
 	unsigned int wb_background;		/* background writeback */
 	unsigned int wb_normal;			/* normal writeback */
 
+	/*
+	 * Unscaled (scale_step == 0) limits, handed to cgroups that are
+	 * not responsible for the bulk of the writeback in the window.
+	 */
+	unsigned int wb_max_base;
+	unsigned int wb_background_base;
+	unsigned int wb_normal_base;
+
+	/*
+	 * Tracked writes issued in the current window, and the share (in
+	 * percent) of those a cgroup must have issued to be throttled.
+	 */
+	atomic_t window_ios;
+	unsigned int noisy_pct;
+	unsigned int nr_noisy;
+
 	short enable_state;			/* WBT_STATE_* */
 
 	/*
@@ -94,6 +110,9 @@ void wbt_enable_default(struct request_queue *);
 u64 wbt_get_min_lat(struct request_queue *q);
 void wbt_set_min_lat(struct request_queue *q, u64 val);
 
+unsigned int wbt_get_noisy_pct(struct request_queue *q);
+void wbt_set_noisy_pct(struct request_queue *q, unsigned int val);
+
 void wbt_set_write_cache(struct request_queue *, bool);
 
 u64 wbt_default_latency_nsec(struct request_queue *);
@@ -123,6 +142,13 @@ static inline u64 wbt_get_min_lat(struct request_queue *q)
 static inline void wbt_set_min_lat(struct request_queue *q, u64 val)
 {
 }
+static inline unsigned int wbt_get_noisy_pct(struct request_queue *q)
+{
+	return 0;
+}
+static inline void wbt_set_noisy_pct(struct request_queue *q, unsigned int val)
+{
+}
 static inline u64 wbt_default_latency_nsec(struct request_queue *q)
 {
 	return 0;
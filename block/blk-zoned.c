@@ -14,9 +14,11 @@
 #include <linux/rbtree.h>
 #include <linux/blkdev.h>
 #include <linux/blk-mq.h>
+#include <linux/elevator.h>
 #include <linux/mm.h>
 #include <linux/vmalloc.h>
 #include <linux/sched/mm.h>
+#include <linux/workqueue.h>
 
 #include "blk.h"
 
@@ -369,6 +371,448 @@ int blkdev_zone_mgmt_ioctl(struct block_device *bdev, fmode_t mode,
 				GFP_KERNEL);
 }
 
+/*
+ * Zone write plugging.
+ *
+ * Writes to a sequential zone must be issued in write pointer order. A zone
+ * write plug tracks the write pointer of its zone as seen by the submitter
+ * side and checks every write against it before a request is allocated.
+ * Writes which arrive while the zone has writes in flight are held in the
+ * plug and submitted, in order, from a work item once the in-flight ones
+ * complete.
+ *
+ * With a scheduler that does zone write locking (mq-deadline), the
+ * scheduler keeps writes to a zone ordered at dispatch, so valid writes are
+ * not held and the plug only checks and tracks the write pointer. Held BIOs
+ * (after an error) are then submitted as one batch under a plug so that they
+ * can be merged. Otherwise, one write per zone is in flight at a time.
+ *
+ * Native zone appends only advance the plug write pointer.
+ *
+ * If the device does not support zone append natively, zone append BIOs
+ * are turned into regular writes at the plug write pointer. They report
+ * the written sector on completion, as a native zone append would. Their
+ * position is only decided at plug time, so emulated appends are never
+ * batched.
+ *
+ * Any write error marks the plug for a write pointer update. The next
+ * submission from the plug work then reads back the write pointer of the
+ * zone before issuing anything else.
+ */
+enum {
+	BLK_ZONE_WPLUG_NEED_WP_UPDATE	= (1U << 0),
+	BLK_ZONE_WPLUG_QUEUED		= (1U << 1),
+};
+
+/* write pointer offset of a zone which cannot be written */
+#define BLK_ZONE_WP_OFFSET_INVALID	UINT_MAX
+
+struct blk_zone_wplug {
+	spinlock_t		lock;
+	unsigned int		flags;
+	unsigned int		wp_offset;
+	unsigned int		nr_inflight;
+	struct bio_list		bio_list;
+	struct list_head	node;
+};
+
+struct blk_zone_wplugs {
+	struct gendisk		*disk;
+	struct work_struct	work;
+	spinlock_t		lock;		/* protects list */
+	struct list_head	list;		/* plugs with BIOs to submit */
+	unsigned int		nr_zones;
+	struct blk_zone_wplug	plugs[];
+};
+
+static void blk_zone_wplugs_work(struct work_struct *work);
+
+static unsigned int blk_zone_wp_offset(struct blk_zone *zone)
+{
+	switch (zone->cond) {
+	case BLK_ZONE_COND_IMP_OPEN:
+	case BLK_ZONE_COND_EXP_OPEN:
+	case BLK_ZONE_COND_CLOSED:
+		return zone->wp - zone->start;
+	case BLK_ZONE_COND_FULL:
+		return zone->len;
+	case BLK_ZONE_COND_EMPTY:
+		return 0;
+	case BLK_ZONE_COND_NOT_WP:
+	case BLK_ZONE_COND_OFFLINE:
+	case BLK_ZONE_COND_READONLY:
+	default:
+		return BLK_ZONE_WP_OFFSET_INVALID;
+	}
+}
+
+static bool blk_zone_wplug_can_batch(struct request_queue *q)
+{
+	if (test_bit(QUEUE_FLAG_ZONE_APPEND_EMU, &q->queue_flags))
+		return false;
+
+	return q->elevator &&
+		(q->elevator->type->elevator_features & ELEVATOR_F_ZBD_SEQ_WRITE);
+}
+
+static struct blk_zone_wplugs *blk_alloc_zone_wplugs(struct gendisk *disk,
+						     unsigned int nr_zones)
+{
+	struct blk_zone_wplugs *wplugs;
+	unsigned int i;
+
+	wplugs = kvzalloc_node(struct_size(wplugs, plugs, nr_zones),
+			       GFP_NOIO, disk->queue->node);
+	if (!wplugs)
+		return NULL;
+
+	wplugs->disk = disk;
+	wplugs->nr_zones = nr_zones;
+	spin_lock_init(&wplugs->lock);
+	INIT_LIST_HEAD(&wplugs->list);
+	INIT_WORK(&wplugs->work, blk_zone_wplugs_work);
+	for (i = 0; i < nr_zones; i++) {
+		struct blk_zone_wplug *zwplug = &wplugs->plugs[i];
+
+		spin_lock_init(&zwplug->lock);
+		bio_list_init(&zwplug->bio_list);
+		INIT_LIST_HEAD(&zwplug->node);
+	}
+
+	return wplugs;
+}
+
+static void blk_free_zone_wplugs(struct blk_zone_wplugs *wplugs)
+{
+	if (!wplugs)
+		return;
+
+	cancel_work_sync(&wplugs->work);
+	kvfree(wplugs);
+}
+
+/* Called with zwplug->lock held, when the zone has no write in flight. */
+static void blk_zone_wplug_kick(struct blk_zone_wplugs *wplugs,
+				struct blk_zone_wplug *zwplug)
+{
+	if (zwplug->flags & BLK_ZONE_WPLUG_QUEUED)
+		return;
+
+	zwplug->flags |= BLK_ZONE_WPLUG_QUEUED;
+	spin_lock(&wplugs->lock);
+	list_add_tail(&zwplug->node, &wplugs->list);
+	spin_unlock(&wplugs->lock);
+	kblockd_schedule_work(&wplugs->work);
+}
+
+/*
+ * Check @bio against the plug write pointer and account it as in flight.
+ * Emulated zone appends are turned into a write at the write pointer here.
+ * Called with zwplug->lock held.
+ */
+static bool blk_zone_wplug_prepare_bio(struct request_queue *q,
+				       struct blk_zone_wplug *zwplug,
+				       struct bio *bio)
+{
+	sector_t zone_sectors = blk_queue_zone_sectors(q);
+	unsigned int nr_sectors = bio_sectors(bio);
+
+	if (zwplug->wp_offset >= zone_sectors ||
+	    zwplug->wp_offset + nr_sectors > zone_sectors)
+		return false;
+
+	if (bio_op(bio) == REQ_OP_ZONE_APPEND) {
+		if (test_bit(QUEUE_FLAG_ZONE_APPEND_EMU, &q->queue_flags)) {
+			bio->bi_opf &= ~REQ_OP_MASK;
+			bio->bi_opf |= REQ_OP_WRITE | REQ_NOMERGE |
+				       REQ_ZONE_APPEND_EMU;
+			bio->bi_iter.bi_sector += zwplug->wp_offset;
+		}
+	} else if ((bio->bi_iter.bi_sector & (zone_sectors - 1)) !=
+		   zwplug->wp_offset) {
+		/* unaligned write, it would fail on the device anyway */
+		return false;
+	}
+
+	zwplug->wp_offset += nr_sectors;
+	zwplug->nr_inflight++;
+	bio->bi_opf |= REQ_ZONE_WPLUG;
+
+	return true;
+}
+
+/* fail all the BIOs held by a plug, called with zwplug->lock held */
+static void blk_zone_wplug_abort(struct request_queue *q,
+				 struct blk_zone_wplug *zwplug)
+{
+	struct bio *bio;
+
+	while ((bio = bio_list_pop(&zwplug->bio_list))) {
+		bio_io_error(bio);
+		blk_queue_exit(q);
+	}
+}
+
+static void blk_zone_wplug_set_wp_offset(struct request_queue *q,
+					 struct blk_zone_wplug *zwplug,
+					 unsigned int wp_offset)
+{
+	unsigned long flags;
+
+	/*
+	 * Resetting or finishing a zone with writes still queued makes these
+	 * writes fail anyway, so fail the ones we hold right away.
+	 */
+	spin_lock_irqsave(&zwplug->lock, flags);
+	zwplug->wp_offset = wp_offset;
+	zwplug->flags &= ~BLK_ZONE_WPLUG_NEED_WP_UPDATE;
+	blk_zone_wplug_abort(q, zwplug);
+	spin_unlock_irqrestore(&zwplug->lock, flags);
+}
+
+static bool blk_zone_wplug_handle_write(struct request_queue *q,
+					struct blk_zone_wplugs *wplugs,
+					struct bio *bio)
+{
+	sector_t sector = bio->bi_iter.bi_sector;
+	bool native_append = bio_op(bio) == REQ_OP_ZONE_APPEND &&
+		!test_bit(QUEUE_FLAG_ZONE_APPEND_EMU, &q->queue_flags);
+	struct blk_zone_wplug *zwplug;
+	unsigned long flags;
+
+	if (!blk_queue_zone_is_seq(q, sector))
+		return false;
+
+	zwplug = &wplugs->plugs[blk_queue_zone_no(q, sector)];
+
+	/*
+	 * Native zone appends only need the write pointer to be accounted,
+	 * they can be in flight together with anything else.
+	 */
+	spin_lock_irqsave(&zwplug->lock, flags);
+	if ((zwplug->flags & BLK_ZONE_WPLUG_NEED_WP_UPDATE) ||
+	    !bio_list_empty(&zwplug->bio_list) ||
+	    (zwplug->nr_inflight && !native_append &&
+	     (bio_op(bio) == REQ_OP_ZONE_APPEND ||
+	      !blk_zone_wplug_can_batch(q)))) {
+		/* the BIO keeps its queue reference while it is held */
+		bio_list_add(&zwplug->bio_list, bio);
+		if (!zwplug->nr_inflight)
+			blk_zone_wplug_kick(wplugs, zwplug);
+		spin_unlock_irqrestore(&zwplug->lock, flags);
+		return true;
+	}
+
+	if (!blk_zone_wplug_prepare_bio(q, zwplug, bio)) {
+		spin_unlock_irqrestore(&zwplug->lock, flags);
+		bio_io_error(bio);
+		blk_queue_exit(q);
+		return true;
+	}
+	spin_unlock_irqrestore(&zwplug->lock, flags);
+
+	return false;
+}
+
+/**
+ * blk_zone_plug_bio - Handle a BIO with the zone write plugs of its queue
+ * @q:		the BIO request queue
+ * @bio:	the BIO being submitted, already split
+ *
+ * Called from blk_mq_make_request() with a reference on the queue usage
+ * counter. Returns false if the BIO should be issued as usual. Returns
+ * true if the BIO was consumed, either held in a plug, in which case it
+ * keeps the queue reference, or failed, in which case the reference is
+ * dropped.
+ */
+bool blk_zone_plug_bio(struct request_queue *q, struct bio *bio)
+{
+	struct blk_zone_wplugs *wplugs = q->zone_wplugs;
+	sector_t sector = bio->bi_iter.bi_sector;
+	unsigned int i;
+
+	if (!wplugs)
+		return false;
+
+	/* resubmitted from a plug, already accounted */
+	if (bio->bi_opf & REQ_ZONE_WPLUG)
+		return false;
+
+	switch (bio_op(bio)) {
+	case REQ_OP_ZONE_APPEND:
+	case REQ_OP_WRITE:
+	case REQ_OP_WRITE_ZEROES:
+		return blk_zone_wplug_handle_write(q, wplugs, bio);
+	case REQ_OP_ZONE_RESET:
+		if (blk_queue_zone_is_seq(q, sector))
+			blk_zone_wplug_set_wp_offset(q,
+				&wplugs->plugs[blk_queue_zone_no(q, sector)], 0);
+		return false;
+	case REQ_OP_ZONE_FINISH:
+		if (blk_queue_zone_is_seq(q, sector))
+			blk_zone_wplug_set_wp_offset(q,
+				&wplugs->plugs[blk_queue_zone_no(q, sector)],
+				blk_queue_zone_sectors(q));
+		return false;
+	case REQ_OP_ZONE_RESET_ALL:
+		for (i = 0; i < wplugs->nr_zones; i++)
+			blk_zone_wplug_set_wp_offset(q, &wplugs->plugs[i], 0);
+		return false;
+	default:
+		return false;
+	}
+}
+
+/**
+ * blk_zone_write_plug_bio_endio - Release the zone write plug of a BIO
+ * @bio:	completed BIO, with REQ_ZONE_WPLUG set
+ *
+ * Called from bio_endio(). The BIO sector is the start of the write (see
+ * req_bio_endio()).
+ */
+void blk_zone_write_plug_bio_endio(struct bio *bio)
+{
+	struct request_queue *q = bio->bi_disk->queue;
+	struct blk_zone_wplugs *wplugs = q->zone_wplugs;
+	struct blk_zone_wplug *zwplug;
+	unsigned long flags;
+
+	bio->bi_opf &= ~REQ_ZONE_WPLUG;
+	if (bio->bi_opf & REQ_ZONE_APPEND_EMU) {
+		bio->bi_opf &= ~(REQ_OP_MASK | REQ_ZONE_APPEND_EMU);
+		bio->bi_opf |= REQ_OP_ZONE_APPEND;
+	}
+
+	if (WARN_ON_ONCE(!wplugs))
+		return;
+
+	zwplug = &wplugs->plugs[blk_queue_zone_no(q, bio->bi_iter.bi_sector)];
+
+	spin_lock_irqsave(&zwplug->lock, flags);
+	if (bio->bi_status != BLK_STS_OK)
+		zwplug->flags |= BLK_ZONE_WPLUG_NEED_WP_UPDATE;
+	if (!WARN_ON_ONCE(!zwplug->nr_inflight))
+		zwplug->nr_inflight--;
+	if (!zwplug->nr_inflight &&
+	    (!bio_list_empty(&zwplug->bio_list) ||
+	     (zwplug->flags & BLK_ZONE_WPLUG_NEED_WP_UPDATE)))
+		blk_zone_wplug_kick(wplugs, zwplug);
+	spin_unlock_irqrestore(&zwplug->lock, flags);
+}
+
+static int blk_zone_wplug_report_zone_cb(struct blk_zone *zone,
+					 unsigned int idx, void *data)
+{
+	unsigned int *wp_offset = data;
+
+	*wp_offset = blk_zone_wp_offset(zone);
+	return 0;
+}
+
+static unsigned int blk_zone_wplug_read_wp_offset(struct gendisk *disk,
+						  unsigned int zno)
+{
+	struct request_queue *q = disk->queue;
+	unsigned int wp_offset = BLK_ZONE_WP_OFFSET_INVALID;
+	unsigned int noio_flag;
+	int ret;
+
+	noio_flag = memalloc_noio_save();
+	ret = disk->fops->report_zones(disk,
+			(sector_t)zno << ilog2(blk_queue_zone_sectors(q)), 1,
+			blk_zone_wplug_report_zone_cb, &wp_offset);
+	memalloc_noio_restore(noio_flag);
+
+	if (ret != 1) {
+		pr_warn_ratelimited("%s: failed to read back write pointer of zone %u\n",
+				    disk->disk_name, zno);
+		return BLK_ZONE_WP_OFFSET_INVALID;
+	}
+
+	return wp_offset;
+}
+
+static void blk_zone_wplug_submit(struct blk_zone_wplugs *wplugs,
+				  struct blk_zone_wplug *zwplug)
+{
+	struct request_queue *q = wplugs->disk->queue;
+	unsigned int zno = zwplug - wplugs->plugs;
+	bool batch = blk_zone_wplug_can_batch(q);
+	struct blk_plug plug;
+	unsigned long flags;
+	struct bio *bio;
+
+	spin_lock_irqsave(&zwplug->lock, flags);
+	if (zwplug->nr_inflight)
+		goto unlock;
+
+	if (zwplug->flags & BLK_ZONE_WPLUG_NEED_WP_UPDATE) {
+		unsigned int wp_offset;
+
+		/* new writes are held until the flag is cleared */
+		spin_unlock_irqrestore(&zwplug->lock, flags);
+		wp_offset = blk_zone_wplug_read_wp_offset(wplugs->disk, zno);
+		spin_lock_irqsave(&zwplug->lock, flags);
+
+		if (zwplug->flags & BLK_ZONE_WPLUG_NEED_WP_UPDATE) {
+			zwplug->wp_offset = wp_offset;
+			zwplug->flags &= ~BLK_ZONE_WPLUG_NEED_WP_UPDATE;
+		}
+	}
+
+	blk_start_plug(&plug);
+	while ((bio = bio_list_pop(&zwplug->bio_list))) {
+		bool emulated;
+
+		if (!blk_zone_wplug_prepare_bio(q, zwplug, bio)) {
+			bio_io_error(bio);
+			blk_queue_exit(q);
+			continue;
+		}
+		emulated = bio->bi_opf & REQ_ZONE_APPEND_EMU;
+		spin_unlock_irqrestore(&zwplug->lock, flags);
+
+		/* the BIO still holds the queue reference it was plugged with */
+		blk_mq_make_request(q, bio);
+
+		spin_lock_irqsave(&zwplug->lock, flags);
+		if (!batch || emulated)
+			break;
+	}
+	spin_unlock_irqrestore(&zwplug->lock, flags);
+	blk_finish_plug(&plug);
+	return;
+
+unlock:
+	spin_unlock_irqrestore(&zwplug->lock, flags);
+}
+
+static void blk_zone_wplugs_work(struct work_struct *work)
+{
+	struct blk_zone_wplugs *wplugs =
+		container_of(work, struct blk_zone_wplugs, work);
+	struct blk_zone_wplug *zwplug;
+	unsigned long flags;
+
+	for (;;) {
+		spin_lock_irqsave(&wplugs->lock, flags);
+		zwplug = list_first_entry_or_null(&wplugs->list,
+						  struct blk_zone_wplug, node);
+		if (zwplug)
+			list_del_init(&zwplug->node);
+		spin_unlock_irqrestore(&wplugs->lock, flags);
+		if (!zwplug)
+			break;
+
+		spin_lock_irqsave(&zwplug->lock, flags);
+		zwplug->flags &= ~BLK_ZONE_WPLUG_QUEUED;
+		spin_unlock_irqrestore(&zwplug->lock, flags);
+
+		blk_zone_wplug_submit(wplugs, zwplug);
+		cond_resched();
+	}
+}
+
 static inline unsigned long *blk_alloc_zone_bitmap(int node,
 						   unsigned int nr_zones)
 {
@@ -382,12 +826,17 @@ void blk_queue_free_zone_bitmaps(struct request_queue *q)
 	q->conv_zones_bitmap = NULL;
 	kfree(q->seq_zones_wlock);
 	q->seq_zones_wlock = NULL;
+	blk_free_zone_wplugs(q->zone_wplugs);
+	q->zone_wplugs = NULL;
+	if (test_and_clear_bit(QUEUE_FLAG_ZONE_APPEND_EMU, &q->queue_flags))
+		q->limits.max_zone_append_sectors = 0;
 }
 
 struct blk_revalidate_zone_args {
 	struct gendisk	*disk;
 	unsigned long	*conv_zones_bitmap;
 	unsigned long	*seq_zones_wlock;
+	struct blk_zone_wplugs *zone_wplugs;
 	unsigned int	nr_zones;
 	sector_t	zone_sectors;
 	sector_t	sector;
@@ -457,6 +906,14 @@ static int blk_revalidate_zone_cb(struct blk_zone *zone, unsigned int idx,
 			if (!args->seq_zones_wlock)
 				return -ENOMEM;
 		}
+		if (!args->zone_wplugs) {
+			args->zone_wplugs =
+				blk_alloc_zone_wplugs(disk, args->nr_zones);
+			if (!args->zone_wplugs)
+				return -ENOMEM;
+		}
+		args->zone_wplugs->plugs[idx].wp_offset =
+			blk_zone_wp_offset(zone);
 		break;
 	default:
 		pr_warn("%s: Invalid zone type 0x%x at sectors %llu\n",
@@ -520,6 +977,17 @@ int blk_revalidate_disk_zones(struct gendisk *disk,
 		q->nr_zones = args.nr_zones;
 		swap(q->seq_zones_wlock, args.seq_zones_wlock);
 		swap(q->conv_zones_bitmap, args.conv_zones_bitmap);
+		swap(q->zone_wplugs, args.zone_wplugs);
+		/*
+		 * Without native zone append support, emulate it with regular
+		 * writes through the zone write plugs.
+		 */
+		if (q->zone_wplugs && !q->limits.max_zone_append_sectors) {
+			q->limits.max_zone_append_sectors =
+				min_t(unsigned int, queue_max_hw_sectors(q),
+				      args.zone_sectors);
+			blk_queue_flag_set(QUEUE_FLAG_ZONE_APPEND_EMU, q);
+		}
 		if (update_driver_data)
 			update_driver_data(disk);
 		ret = 0;
@@ -531,6 +999,7 @@ int blk_revalidate_disk_zones(struct gendisk *disk,
 
 	kfree(args.seq_zones_wlock);
 	kfree(args.conv_zones_bitmap);
+	blk_free_zone_wplugs(args.zone_wplugs);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(blk_revalidate_disk_zones);
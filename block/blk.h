@@ -338,8 +338,15 @@ struct bio *blk_next_bio(struct bio *bio, unsigned int nr_pages, gfp_t gfp);
 
 #ifdef CONFIG_BLK_DEV_ZONED
 void blk_queue_free_zone_bitmaps(struct request_queue *q);
+bool blk_zone_plug_bio(struct request_queue *q, struct bio *bio);
+void blk_zone_write_plug_bio_endio(struct bio *bio);
 #else
 static inline void blk_queue_free_zone_bitmaps(struct request_queue *q) {}
+static inline bool blk_zone_plug_bio(struct request_queue *q, struct bio *bio)
+{
+	return false;
+}
+static inline void blk_zone_write_plug_bio_endio(struct bio *bio) {}
 #endif
 
 struct hd_struct *disk_map_sector_rcu(struct gendisk *disk, sector_t sector);
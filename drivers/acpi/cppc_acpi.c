@@ -1366,6 +1366,34 @@ int cppc_set_perf(int cpu, struct cppc_perf_ctrls *perf_ctrls)
 }
 EXPORT_SYMBOL_GPL(cppc_set_perf);
 
+/**
+ * cppc_allow_fast_switch - Check if a CPU's performance can be set atomically.
+ * @cpu: CPU to check.
+ *
+ * Writes to a desired performance register in system memory are a plain
+ * MMIO store on an address mapped at init time, so cppc_set_perf() may be
+ * called for it from scheduler context. PCC needs the mailbox and may sleep,
+ * and FFH/System I/O accesses are not guaranteed to be usable with
+ * interrupts disabled.
+ *
+ * Return: true if cppc_set_perf() can be used for fast frequency switching.
+ */
+bool cppc_allow_fast_switch(int cpu)
+{
+	struct cpc_desc *cpc_desc = per_cpu(cpc_desc_ptr, cpu);
+	struct cpc_register_resource *desired_reg;
+
+	if (!cpc_desc)
+		return false;
+
+	desired_reg = &cpc_desc->cpc_regs[DESIRED_PERF];
+
+	return desired_reg->type == ACPI_TYPE_BUFFER &&
+	       desired_reg->cpc_entry.reg.space_id == ACPI_ADR_SPACE_SYSTEM_MEMORY &&
+	       desired_reg->sys_mem_vaddr;
+}
+EXPORT_SYMBOL_GPL(cppc_allow_fast_switch);
+
 /**
  * cppc_get_transition_latency - returns frequency transition latency in ns
  *
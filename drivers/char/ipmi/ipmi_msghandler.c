@@ -4417,29 +4417,39 @@ static void handle_new_recv_msgs(struct ipmi_smi *intf)
 	unsigned long        flags = 0;
 	int                  rv;
 	int                  run_to_completion = intf->run_to_completion;
+	LIST_HEAD(msgs);
 
-	/* See if any waiting messages need to be processed. */
+	/*
+	 * See if any waiting messages need to be processed.  Take them
+	 * all at once, so the lock isn't bounced for every message while
+	 * the lower layer is queueing more.
+	 */
 	if (!run_to_completion)
 		spin_lock_irqsave(&intf->waiting_rcv_msgs_lock, flags);
-	while (!list_empty(&intf->waiting_rcv_msgs)) {
-		smi_msg = list_entry(intf->waiting_rcv_msgs.next,
-				     struct ipmi_smi_msg, link);
+	list_splice_init(&intf->waiting_rcv_msgs, &msgs);
+	if (!run_to_completion)
+		spin_unlock_irqrestore(&intf->waiting_rcv_msgs_lock, flags);
+
+	while (!list_empty(&msgs)) {
+		smi_msg = list_entry(msgs.next, struct ipmi_smi_msg, link);
 		list_del(&smi_msg->link);
-		if (!run_to_completion)
-			spin_unlock_irqrestore(&intf->waiting_rcv_msgs_lock,
-					       flags);
 		rv = handle_one_recv_msg(intf, smi_msg);
-		if (!run_to_completion)
-			spin_lock_irqsave(&intf->waiting_rcv_msgs_lock, flags);
 		if (rv > 0) {
 			/*
 			 * To preserve message order, quit if we
-			 * can't handle a message.  Add the message
-			 * back at the head, this is safe because this
-			 * tasklet is the only thing that pulls the
-			 * messages.
+			 * can't handle a message.  Put the message and
+			 * the ones after it back at the head, this is
+			 * safe because this tasklet is the only thing
+			 * that pulls the messages.
 			 */
-			list_add(&smi_msg->link, &intf->waiting_rcv_msgs);
+			list_add(&smi_msg->link, &msgs);
+			if (!run_to_completion)
+				spin_lock_irqsave(&intf->waiting_rcv_msgs_lock,
+						  flags);
+			list_splice(&msgs, &intf->waiting_rcv_msgs);
+			if (!run_to_completion)
+				spin_unlock_irqrestore(
+					&intf->waiting_rcv_msgs_lock, flags);
 			break;
 		} else {
 			if (rv == 0)
@@ -4448,8 +4458,6 @@ static void handle_new_recv_msgs(struct ipmi_smi *intf)
 			/* If rv < 0, fatal error, del but don't free. */
 		}
 	}
-	if (!run_to_completion)
-		spin_unlock_irqrestore(&intf->waiting_rcv_msgs_lock, flags);
 
 	/*
 	 * If the pretimout count is non-zero, decrement one from it and
@@ -8,6 +8,7 @@
 #include <linux/errno.h>
 #include <linux/io.h>
 #include <linux/ipmi_bmc.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/poll.h>
@@ -22,6 +23,13 @@
 
 #define KCS_ZERO_DATA     0
 
+/* Upper bound on bytes clocked in by a single event when polling */
+#define KCS_POLL_MAX_BYTES	64
+
+static unsigned int poll_us;
+module_param(poll_us, uint, 0644);
+MODULE_PARM_DESC(poll_us,
+		 "Time in us to busy-wait for the next host byte of a transfer before returning from the event handler (0 = one byte per event)");
 
 /* IPMI 2.0 - Table 9-1, KCS Interface Status Register Bits */
 #define KCS_STATUS_STATE(state) (state << 6)
@@ -209,8 +217,68 @@ static void kcs_bmc_handle_cmd(struct kcs_bmc *kcs_bmc)
 	}
 }
 
+static void kcs_bmc_handle_ibf(struct kcs_bmc *kcs_bmc, u8 status)
+{
+	if (!kcs_bmc->running)
+		kcs_force_abort(kcs_bmc);
+	else if (status & KCS_STATUS_CMD_DAT)
+		kcs_bmc_handle_cmd(kcs_bmc);
+	else
+		kcs_bmc_handle_data(kcs_bmc);
+}
+
+/*
+ * True while the host is in the middle of a transfer and will write the
+ * next byte without waiting on the BMC.
+ */
+static bool kcs_bmc_in_transfer(struct kcs_bmc *kcs_bmc)
+{
+	switch (kcs_bmc->phase) {
+	case KCS_PHASE_WRITE_START:
+	case KCS_PHASE_WRITE_DATA:
+	case KCS_PHASE_WRITE_END_CMD:
+	case KCS_PHASE_READ:
+	case KCS_PHASE_ABORT_ERROR1:
+	case KCS_PHASE_ABORT_ERROR2:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * The host writes the next byte of a message within a few microseconds of
+ * the BMC consuming the previous one. When poll_us is set, keep clocking
+ * bytes in from the event that started the transfer instead of taking one
+ * interrupt per byte, so a whole request or response moves in one go.
+ */
+static void kcs_bmc_poll_transfer(struct kcs_bmc *kcs_bmc, unsigned int us)
+{
+	int nbytes = 0;
+	ktime_t timeout;
+	u8 status;
+
+	timeout = ktime_add_us(ktime_get(), us);
+	while (kcs_bmc->running && kcs_bmc_in_transfer(kcs_bmc) &&
+	       nbytes < KCS_POLL_MAX_BYTES) {
+		status = read_status(kcs_bmc);
+		if (status & KCS_STATUS_IBF) {
+			kcs_bmc_handle_ibf(kcs_bmc, status);
+			timeout = ktime_add_us(ktime_get(), us);
+			nbytes++;
+			continue;
+		}
+
+		if (ktime_after(ktime_get(), timeout))
+			break;
+
+		cpu_relax();
+	}
+}
+
 int kcs_bmc_handle_event(struct kcs_bmc *kcs_bmc)
 {
+	unsigned int us = READ_ONCE(poll_us);
 	unsigned long flags;
 	int ret = -ENODATA;
 	u8 status;
@@ -219,12 +287,9 @@ int kcs_bmc_handle_event(struct kcs_bmc *kcs_bmc)
 
 	status = read_status(kcs_bmc);
 	if (status & KCS_STATUS_IBF) {
-		if (!kcs_bmc->running)
-			kcs_force_abort(kcs_bmc);
-		else if (status & KCS_STATUS_CMD_DAT)
-			kcs_bmc_handle_cmd(kcs_bmc);
-		else
-			kcs_bmc_handle_data(kcs_bmc);
+		kcs_bmc_handle_ibf(kcs_bmc, status);
+		if (us)
+			kcs_bmc_poll_transfer(kcs_bmc, us);
 
 		ret = 0;
 	}
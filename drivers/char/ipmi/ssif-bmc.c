@@ -58,6 +58,18 @@
 #define	SSIF_IPMI_RESPONSE			3
 #define	SSIF_IPMI_MULTI_PART_RESPONSE_MIDDLE	9
 
+/*
+ * Number of request/response slots. A depth of 1 keeps the historical
+ * one-message-at-a-time behaviour; larger depths let the host push the
+ * next request while userspace is still preparing the previous response.
+ */
+#define SSIF_BMC_QUEUE_DEPTH_MAX		16
+
+static unsigned int queue_depth = 1;
+module_param(queue_depth, uint, 0444);
+MODULE_PARM_DESC(queue_depth,
+		 "Number of in-flight SSIF request/response slots (1-16, default 1)");
+
 struct ssif_msg {
 	u8 len;
 	u8 netfn_lun;
@@ -75,10 +87,26 @@ struct ssif_bmc {
 	struct aspeed_i2c_bus	*i2c_bus;
 	struct miscdevice	miscdev;
 	u8			smbus_cmd;
+	/* Request being received from the host */
 	struct ssif_msg		request;
 	bool			request_available;
+	/* Received requests waiting for userspace, in arrival order */
+	struct ssif_msg		*req_queue;
+	unsigned int		req_head;
+	unsigned int		req_count;
+	/* Sequence of requests handed to userspace */
+	u32			req_seq;
+	u32			req_dropped;
+	/* Response being sent to the host */
 	struct ssif_msg		response;
 	bool			response_in_progress;
+	/* Responses written by userspace waiting for the host to read */
+	struct ssif_msg		*rsp_queue;
+	unsigned int		rsp_head;
+	unsigned int		rsp_count;
+	/* Sequence of responses accepted from userspace */
+	u32			rsp_seq;
+	unsigned int		queue_depth;
 	/* Response buffer for Multi-part Read command */
 	u8			response_buffer[MAX_PAYLOAD_PER_TRANSACTION];
 	/* Flag to identify the response is a multi-part */
@@ -289,13 +317,39 @@ static int receive_ssif_bmc_request(struct ssif_bmc *ssif_bmc, bool non_blocking
 		goto try_again;
 	}
 
-	memcpy(request, &ssif_bmc->request, sizeof(*request));
-	ssif_bmc->request_available = false;
+	memcpy(request, &ssif_bmc->req_queue[ssif_bmc->req_head],
+	       sizeof(*request));
+	ssif_bmc->req_head = (ssif_bmc->req_head + 1) % ssif_bmc->queue_depth;
+	ssif_bmc->req_count--;
+	ssif_bmc->req_seq++;
+	ssif_bmc->request_available = ssif_bmc->req_count != 0;
 	spin_unlock_irqrestore(&ssif_bmc->lock, flags);
 
 	return 0;
 }
 
+/* Called with ssif_bmc->lock held. */
+static void load_response(struct ssif_bmc *ssif_bmc, struct ssif_msg *response)
+{
+	memcpy(&ssif_bmc->response, response, sizeof(*response));
+	ssif_bmc->response_in_progress = true;
+
+	/* Check the response length to determine single or multi-part output */
+	if (ssif_msg_len(&ssif_bmc->response) >
+		(MAX_PAYLOAD_PER_TRANSACTION + 1)) { /* 1: byte of length */
+		ssif_bmc->is_multi_part = true;
+	} else {
+		ssif_bmc->is_multi_part = false;
+	}
+}
+
+/* Called with ssif_bmc->lock held. */
+static bool response_slot_available(struct ssif_bmc *ssif_bmc)
+{
+	return !ssif_bmc->response_in_progress ||
+		ssif_bmc->rsp_count < ssif_bmc->queue_depth - 1;
+}
+
 /*
  * Call in WRITE context
  */
@@ -308,28 +362,36 @@ static int send_ssif_bmc_response(struct ssif_bmc *ssif_bmc, bool non_blocking,
 	if (!non_blocking) {
 try_again:
 		res = wait_event_interruptible(ssif_bmc->wait_queue,
-					       !ssif_bmc->response_in_progress);
+					response_slot_available(ssif_bmc));
 		if (res)
 			return res;
 	}
 
 	spin_lock_irqsave(&ssif_bmc->lock, flags);
-	if (ssif_bmc->response_in_progress) {
+	if (!response_slot_available(ssif_bmc)) {
 		spin_unlock_irqrestore(&ssif_bmc->lock, flags);
 		if (non_blocking)
 			return -EAGAIN;
 		goto try_again;
 	}
 
-	memcpy(&ssif_bmc->response, response, sizeof(*response));
-	ssif_bmc->response_in_progress = true;
+	/* Every pipelined response must answer a request already read */
+	if (ssif_bmc->queue_depth > 1 &&
+	    ssif_bmc->rsp_seq == ssif_bmc->req_seq) {
+		spin_unlock_irqrestore(&ssif_bmc->lock, flags);
+		return -EINVAL;
+	}
+	ssif_bmc->rsp_seq++;
 
-	/* Check the response length to determine single or multi-part output */
-	if (ssif_msg_len(&ssif_bmc->response) >
-		(MAX_PAYLOAD_PER_TRANSACTION + 1)) { /* 1: byte of length */
-		ssif_bmc->is_multi_part = true;
+	if (!ssif_bmc->response_in_progress) {
+		load_response(ssif_bmc, response);
 	} else {
-		ssif_bmc->is_multi_part = false;
+		/* Queue behind the response the host is still reading */
+		unsigned int tail = (ssif_bmc->rsp_head + ssif_bmc->rsp_count) %
+				    ssif_bmc->queue_depth;
+
+		memcpy(&ssif_bmc->rsp_queue[tail], response, sizeof(*response));
+		ssif_bmc->rsp_count++;
 	}
 
 	spin_unlock_irqrestore(&ssif_bmc->lock, flags);
@@ -433,18 +495,39 @@ static const struct file_operations ssif_bmc_fops = {
 /* Called with ssif_bmc->lock held. */
 static int handle_request(struct ssif_bmc *ssif_bmc)
 {
+	unsigned int tail;
+
+	/* Queue full: drop the oldest request not yet read by userspace */
+	if (ssif_bmc->req_count == ssif_bmc->queue_depth) {
+		ssif_bmc->req_head = (ssif_bmc->req_head + 1) %
+				     ssif_bmc->queue_depth;
+		ssif_bmc->req_count--;
+		ssif_bmc->req_dropped++;
+		pr_debug(PFX "request queue full, %u requests dropped\n",
+			 ssif_bmc->req_dropped);
+	}
+
+	tail = (ssif_bmc->req_head + ssif_bmc->req_count) %
+	       ssif_bmc->queue_depth;
+	memcpy(&ssif_bmc->req_queue[tail], &ssif_bmc->request,
+	       sizeof(struct ssif_msg));
+	ssif_bmc->req_count++;
+
 	/* FIXME: Disable I2C Slave to prevent incoming interrupts
 	 * It should be called as soon as possible right after the request
-	 * is received.
+	 * is received. With a queue, only do so once every slot is busy.
 	 */
-	aspeed_i2c_disable_slave(ssif_bmc->i2c_bus);
+	if (ssif_bmc->req_count == ssif_bmc->queue_depth)
+		aspeed_i2c_disable_slave(ssif_bmc->i2c_bus);
 
 	/* Data request is available to process */
 	ssif_bmc->request_available = true;
 	/* This is the new READ request.
-	 * Clear the response buffer of previous transfer
+	 * Clear the response buffer of previous transfer, unless responses
+	 * are pipelined and the previous one is still owed to the host.
 	 */
-	memset(&ssif_bmc->response, 0, sizeof(struct ssif_msg));
+	if (ssif_bmc->queue_depth == 1)
+		memset(&ssif_bmc->response, 0, sizeof(struct ssif_msg));
 	wake_up_all(&ssif_bmc->wait_queue);
 	return 0;
 }
@@ -458,6 +541,16 @@ static int complete_response(struct ssif_bmc *ssif_bmc)
 	ssif_bmc->num_bytes_processed = 0;
 	ssif_bmc->remain_data_len = 0;
 	memset(&ssif_bmc->response_buffer, 0, MAX_PAYLOAD_PER_TRANSACTION);
+
+	/* Move the next queued response in place for the host */
+	if (ssif_bmc->rsp_count) {
+		load_response(ssif_bmc,
+			      &ssif_bmc->rsp_queue[ssif_bmc->rsp_head]);
+		ssif_bmc->rsp_head = (ssif_bmc->rsp_head + 1) %
+				     ssif_bmc->queue_depth;
+		ssif_bmc->rsp_count--;
+	}
+
 	wake_up_all(&ssif_bmc->wait_queue);
 	return 0;
 }
@@ -722,6 +815,15 @@ static int ssif_bmc_probe(struct i2c_client *client,
 	ssif_bmc->request_available = false;
 	ssif_bmc->response_in_progress = false;
 
+	ssif_bmc->queue_depth = clamp_val(queue_depth, 1,
+					  SSIF_BMC_QUEUE_DEPTH_MAX);
+	ssif_bmc->req_queue = devm_kcalloc(&client->dev, ssif_bmc->queue_depth,
+					   sizeof(struct ssif_msg), GFP_KERNEL);
+	ssif_bmc->rsp_queue = devm_kcalloc(&client->dev, ssif_bmc->queue_depth,
+					   sizeof(struct ssif_msg), GFP_KERNEL);
+	if (!ssif_bmc->req_queue || !ssif_bmc->rsp_queue)
+		return -ENOMEM;
+
 	mutex_init(&ssif_bmc->file_mutex);
 
 	/* Register misc device interface */
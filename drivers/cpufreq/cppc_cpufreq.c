@@ -222,6 +222,26 @@ static int cppc_cpufreq_set_target(struct cpufreq_policy *policy,
 	return ret;
 }
 
+static unsigned int cppc_cpufreq_fast_switch(struct cpufreq_policy *policy,
+					     unsigned int target_freq)
+{
+	struct cppc_cpudata *cpu = all_cpu_data[policy->cpu];
+	u32 desired_perf;
+	int ret;
+
+	desired_perf = cppc_cpufreq_khz_to_perf(cpu, target_freq);
+	cpu->perf_ctrls.desired_perf = desired_perf;
+	ret = cppc_set_perf(cpu->cpu, &cpu->perf_ctrls);
+
+	if (ret) {
+		pr_debug("Failed to set target on CPU:%d. ret:%d\n",
+				cpu->cpu, ret);
+		return 0;
+	}
+
+	return target_freq;
+}
+
 static int cppc_verify_policy(struct cpufreq_policy_data *policy)
 {
 	cpufreq_verify_within_cpu_limits(policy);
@@ -248,6 +268,20 @@ static void cppc_cpufreq_stop_cpu(struct cpufreq_policy *policy)
  * trasition requests), so ideally we need to use the PCC values as a fallback
  * if we don't have a platform specific transition_delay_us
  */
+static unsigned int cppc_cpufreq_pcc_delay_us(int cpu)
+{
+	unsigned int latency_ns = cppc_get_transition_latency(cpu);
+
+	/*
+	 * Desired performance outside PCC has no latency information; leave
+	 * the delay to the cpufreq core default rather than "eternal".
+	 */
+	if (latency_ns == CPUFREQ_ETERNAL)
+		return 0;
+
+	return latency_ns / NSEC_PER_USEC;
+}
+
 #ifdef CONFIG_ARM64
 #include <asm/cputype.h>
 
@@ -265,12 +299,12 @@ static unsigned int cppc_cpufreq_get_transition_delay_us(int cpu)
 			delay_us = 10000;
 			break;
 		default:
-			delay_us = cppc_get_transition_latency(cpu) / NSEC_PER_USEC;
+			delay_us = cppc_cpufreq_pcc_delay_us(cpu);
 			break;
 		}
 		break;
 	default:
-		delay_us = cppc_get_transition_latency(cpu) / NSEC_PER_USEC;
+		delay_us = cppc_cpufreq_pcc_delay_us(cpu);
 		break;
 	}
 
@@ -281,7 +315,7 @@ static unsigned int cppc_cpufreq_get_transition_delay_us(int cpu)
 
 static unsigned int cppc_cpufreq_get_transition_delay_us(int cpu)
 {
-	return cppc_get_transition_latency(cpu) / NSEC_PER_USEC;
+	return cppc_cpufreq_pcc_delay_us(cpu);
 }
 #endif
 
@@ -323,6 +357,7 @@ static int cppc_cpufreq_cpu_init(struct cpufreq_policy *policy)
 
 	policy->transition_delay_us = cppc_cpufreq_get_transition_delay_us(cpu_num);
 	policy->shared_type = cpu->shared_type;
+	policy->fast_switch_possible = cppc_allow_fast_switch(cpu_num);
 
 	if (policy->shared_type == CPUFREQ_SHARED_TYPE_ANY) {
 		int i;
@@ -448,6 +483,7 @@ static struct cpufreq_driver cppc_cpufreq_driver = {
 	.flags = CPUFREQ_CONST_LOOPS,
 	.verify = cppc_verify_policy,
 	.target = cppc_cpufreq_set_target,
+	.fast_switch = cppc_cpufreq_fast_switch,
 	.get = cppc_cpufreq_get_rate,
 	.init = cppc_cpufreq_cpu_init,
 	.stop_cpu = cppc_cpufreq_stop_cpu,
@@ -151,6 +151,35 @@ int fsi_device_write(struct fsi_device *dev, uint32_t addr, const void *val,
 }
 EXPORT_SYMBOL_GPL(fsi_device_write);
 
+/*
+ * fsi_device_read_fifo / fsi_device_write_fifo: transfer a sequence of
+ * 32-bit words through a single word-aligned FSI address, as used to drain
+ * or fill an engine's hardware FIFO. Masters that support it move all
+ * words with a single setup; for others this falls back to one
+ * fsi_device_read/fsi_device_write per word.
+ *
+ * count: number of words in val
+ */
+int fsi_device_read_fifo(struct fsi_device *dev, uint32_t addr, __be32 *val,
+		size_t count)
+{
+	if (addr > dev->size || addr > dev->size - sizeof(*val))
+		return -EINVAL;
+
+	return fsi_slave_read_fifo(dev->slave, dev->addr + addr, val, count);
+}
+EXPORT_SYMBOL_GPL(fsi_device_read_fifo);
+
+int fsi_device_write_fifo(struct fsi_device *dev, uint32_t addr,
+		const __be32 *val, size_t count)
+{
+	if (addr > dev->size || addr > dev->size - sizeof(*val))
+		return -EINVAL;
+
+	return fsi_slave_write_fifo(dev->slave, dev->addr + addr, val, count);
+}
+EXPORT_SYMBOL_GPL(fsi_device_write_fifo);
+
 int fsi_device_peek(struct fsi_device *dev, void *val)
 {
 	uint32_t addr = FSI_PEEK_BASE + ((dev->unit - 2) * sizeof(uint32_t));
@@ -392,6 +421,78 @@ int fsi_slave_write(struct fsi_slave *slave, uint32_t addr,
 }
 EXPORT_SYMBOL_GPL(fsi_slave_write);
 
+/*
+ * A FIFO transfer is not idempotent, since the words already moved have
+ * been consumed by the engine, so errors are handled but not retried.
+ */
+int fsi_slave_read_fifo(struct fsi_slave *slave, uint32_t addr,
+			__be32 *val, size_t count)
+{
+	struct fsi_master *master = slave->master;
+	uint8_t id = slave->id;
+	size_t i;
+	int rc;
+
+	if (addr & 0x3)
+		return -EINVAL;
+
+	if (!master->read_fifo) {
+		for (i = 0; i < count; i++) {
+			rc = fsi_slave_read(slave, addr, &val[i],
+					    sizeof(*val));
+			if (rc)
+				return rc;
+		}
+		return 0;
+	}
+
+	rc = fsi_slave_calc_addr(slave, &addr, &id);
+	if (rc)
+		return rc;
+
+	rc = master->read_fifo(master, slave->link, id, addr, val, count);
+	if (rc)
+		fsi_slave_handle_error(slave, false, addr,
+				       count * sizeof(*val));
+
+	return rc;
+}
+EXPORT_SYMBOL_GPL(fsi_slave_read_fifo);
+
+int fsi_slave_write_fifo(struct fsi_slave *slave, uint32_t addr,
+			 const __be32 *val, size_t count)
+{
+	struct fsi_master *master = slave->master;
+	uint8_t id = slave->id;
+	size_t i;
+	int rc;
+
+	if (addr & 0x3)
+		return -EINVAL;
+
+	if (!master->write_fifo) {
+		for (i = 0; i < count; i++) {
+			rc = fsi_slave_write(slave, addr, &val[i],
+					     sizeof(*val));
+			if (rc)
+				return rc;
+		}
+		return 0;
+	}
+
+	rc = fsi_slave_calc_addr(slave, &addr, &id);
+	if (rc)
+		return rc;
+
+	rc = master->write_fifo(master, slave->link, id, addr, val, count);
+	if (rc)
+		fsi_slave_handle_error(slave, true, addr,
+				       count * sizeof(*val));
+
+	return rc;
+}
+EXPORT_SYMBOL_GPL(fsi_slave_write_fifo);
+
 extern int fsi_slave_claim_range(struct fsi_slave *slave,
 		uint32_t addr, uint32_t size)
 {
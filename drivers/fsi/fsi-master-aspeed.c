@@ -127,6 +127,46 @@ static int __opb_write(struct fsi_master_aspeed *aspeed, u32 addr,
 	return 0;
 }
 
+/*
+ * Write count words to the same address. The command, size and address are
+ * only set up once; each word then costs just a data write and a trigger.
+ */
+static int __opb_write_fifo(struct fsi_master_aspeed *aspeed, u32 addr,
+			    const __be32 *val, size_t count)
+{
+	void __iomem *base = aspeed->base;
+	u32 reg, status;
+	size_t i;
+	int ret;
+
+	writel(CMD_WRITE, base + OPB0_RW);
+	writel(XFER_FULLWORD, base + OPB0_XFER_SIZE);
+	writel(addr, base + OPB0_FSI_ADDR);
+
+	for (i = 0; i < count; i++) {
+		writel((__force u32)val[i], base + OPB0_FSI_DATA_W);
+		writel(0x1, base + OPB_IRQ_CLEAR);
+		writel(0x1, base + OPB_TRIGGER);
+
+		ret = readl_poll_timeout(base + OPB_IRQ_STATUS, reg,
+					 (reg & OPB0_XFER_ACK_EN) != 0,
+					 0, OPB_POLL_TIMEOUT);
+
+		status = readl(base + OPB0_STATUS);
+
+		trace_fsi_master_aspeed_opb_write(addr, (__force u32)val[i],
+						  XFER_FULLWORD, status, reg);
+
+		if (ret)
+			return ret;
+
+		if (status & STATUS_ERR_ACK)
+			return -EIO;
+	}
+
+	return 0;
+}
+
 static int opb_writeb(struct fsi_master_aspeed *aspeed, u32 addr, u8 val)
 {
 	return __opb_write(aspeed, addr, val, XFER_BYTE);
@@ -195,6 +235,44 @@ static int __opb_read(struct fsi_master_aspeed *aspeed, uint32_t addr,
 	return 0;
 }
 
+static int __opb_read_fifo(struct fsi_master_aspeed *aspeed, u32 addr,
+			   __be32 *val, size_t count)
+{
+	void __iomem *base = aspeed->base;
+	u32 result, reg, status;
+	size_t i;
+	int ret;
+
+	writel(CMD_READ, base + OPB0_RW);
+	writel(XFER_FULLWORD, base + OPB0_XFER_SIZE);
+	writel(addr, base + OPB0_FSI_ADDR);
+
+	for (i = 0; i < count; i++) {
+		writel(0x1, base + OPB_IRQ_CLEAR);
+		writel(0x1, base + OPB_TRIGGER);
+
+		ret = readl_poll_timeout(base + OPB_IRQ_STATUS, reg,
+					 (reg & OPB0_XFER_ACK_EN) != 0,
+					 0, OPB_POLL_TIMEOUT);
+
+		status = readl(base + OPB0_STATUS);
+		result = readl(base + OPB0_FSI_DATA_R);
+
+		trace_fsi_master_aspeed_opb_read(addr, XFER_FULLWORD, result,
+						 status, reg);
+
+		if (ret)
+			return ret;
+
+		if (status & STATUS_ERR_ACK)
+			return -EIO;
+
+		val[i] = (__force __be32)result;
+	}
+
+	return 0;
+}
+
 static int opb_readl(struct fsi_master_aspeed *aspeed, uint32_t addr, __be32 *out)
 {
 	return __opb_read(aspeed, addr, XFER_FULLWORD, out);
@@ -314,6 +392,47 @@ static int aspeed_master_write(struct fsi_master *master, int link,
 	return ret;
 }
 
+static int aspeed_master_read_fifo(struct fsi_master *master, int link,
+			uint8_t id, uint32_t addr, __be32 *val, size_t count)
+{
+	struct fsi_master_aspeed *aspeed = to_fsi_master_aspeed(master);
+	int ret;
+
+	if (id > 0x3)
+		return -EINVAL;
+
+	addr |= id << 21;
+	addr += link * FSI_HUB_LINK_SIZE;
+
+	mutex_lock(&aspeed->lock);
+	ret = __opb_read_fifo(aspeed, fsi_base + addr, val, count);
+	ret = check_errors(aspeed, ret);
+	mutex_unlock(&aspeed->lock);
+
+	return ret;
+}
+
+static int aspeed_master_write_fifo(struct fsi_master *master, int link,
+			uint8_t id, uint32_t addr, const __be32 *val,
+			size_t count)
+{
+	struct fsi_master_aspeed *aspeed = to_fsi_master_aspeed(master);
+	int ret;
+
+	if (id > 0x3)
+		return -EINVAL;
+
+	addr |= id << 21;
+	addr += link * FSI_HUB_LINK_SIZE;
+
+	mutex_lock(&aspeed->lock);
+	ret = __opb_write_fifo(aspeed, fsi_base + addr, val, count);
+	ret = check_errors(aspeed, ret);
+	mutex_unlock(&aspeed->lock);
+
+	return ret;
+}
+
 static int aspeed_master_link_enable(struct fsi_master *master, int link,
 				     bool enable)
 {
@@ -602,6 +721,8 @@ static int fsi_master_aspeed_probe(struct platform_device *pdev)
 	aspeed->master.n_links = links;
 	aspeed->master.read = aspeed_master_read;
 	aspeed->master.write = aspeed_master_write;
+	aspeed->master.read_fifo = aspeed_master_read_fifo;
+	aspeed->master.write_fifo = aspeed_master_write_fifo;
 	aspeed->master.send_break = aspeed_master_break;
 	aspeed->master.term = aspeed_master_term;
 	aspeed->master.link_enable = aspeed_master_link_enable;
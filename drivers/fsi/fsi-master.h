@@ -128,6 +128,10 @@ struct fsi_master {
 				uint32_t addr, void *val, size_t size);
 	int		(*write)(struct fsi_master *, int link, uint8_t id,
 				uint32_t addr, const void *val, size_t size);
+	int		(*read_fifo)(struct fsi_master *, int link, uint8_t id,
+				uint32_t addr, __be32 *val, size_t count);
+	int		(*write_fifo)(struct fsi_master *, int link, uint8_t id,
+				uint32_t addr, const __be32 *val, size_t count);
 	int		(*term)(struct fsi_master *, int link, uint8_t id);
 	int		(*send_break)(struct fsi_master *, int link);
 	int		(*link_enable)(struct fsi_master *, int link,
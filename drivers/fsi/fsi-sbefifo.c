@@ -32,6 +32,8 @@
 #include <linux/vmalloc.h>
 #include <linux/mm.h>
 
+#include <uapi/linux/fsi.h>
+
 /*
  * The SBEFIFO is a pipe-like FSI device for communicating with
  * the self boot engine on POWER processors.
@@ -112,6 +114,7 @@ enum sbe_state
 
 /* Other constants */
 #define SBEFIFO_MAX_USER_CMD_LEN	(0x100000 + PAGE_SIZE)
+#define SBEFIFO_MAX_USER_MAP_LEN	(32 * 1024 * 1024)
 #define SBEFIFO_RESET_MAGIC		0x52534554 /* "RSET" */
 
 struct sbefifo {
@@ -132,6 +135,8 @@ struct sbefifo_user {
 	void			*cmd_page;
 	void			*pending_cmd;
 	size_t			pending_len;
+	void			*map;
+	size_t			map_len;
 };
 
 static DEFINE_MUTEX(sbefifo_ffdc_mutex);
@@ -309,19 +314,6 @@ static int sbefifo_check_sbe_state(struct sbefifo *sbefifo)
 	return 0;
 }
 
-/* Don't flip endianness of data to/from FIFO, just pass through. */
-static int sbefifo_down_read(struct sbefifo *sbefifo, __be32 *word)
-{
-	return fsi_device_read(sbefifo->fsi_dev, SBEFIFO_DOWN, word,
-			       sizeof(*word));
-}
-
-static int sbefifo_up_write(struct sbefifo *sbefifo, __be32 word)
-{
-	return fsi_device_write(sbefifo->fsi_dev, SBEFIFO_UP, &word,
-				sizeof(word));
-}
-
 static int sbefifo_request_reset(struct sbefifo *sbefifo)
 {
 	struct device *dev = &sbefifo->fsi_dev->dev;
@@ -476,7 +468,7 @@ static int sbefifo_send_command(struct sbefifo *sbefifo,
 				const __be32 *command, size_t cmd_len)
 {
 	struct device *dev = &sbefifo->fsi_dev->dev;
-	size_t len, chunk, vacant = 0, remaining = cmd_len;
+	size_t chunk, vacant = 0, remaining = cmd_len;
 	unsigned long timeout;
 	u32 status;
 	int rc;
@@ -494,19 +486,19 @@ static int sbefifo_send_command(struct sbefifo *sbefifo,
 		timeout = msecs_to_jiffies(SBEFIFO_TIMEOUT_IN_CMD);
 
 		vacant = sbefifo_vacant(status);
-		len = chunk = min(vacant, remaining);
+		chunk = min(vacant, remaining);
 
 		dev_vdbg(dev, "  status=%08x vacant=%zd chunk=%zd\n",
 			 status, vacant, chunk);
 
 		/* Write as much as we can */
-		while (len--) {
-			rc = sbefifo_up_write(sbefifo, *(command++));
-			if (rc) {
-				dev_err(dev, "FSI error %d writing UP FIFO\n", rc);
-				return rc;
-			}
+		rc = fsi_device_write_fifo(sbefifo->fsi_dev, SBEFIFO_UP,
+					   command, chunk);
+		if (rc) {
+			dev_err(dev, "FSI error %d writing UP FIFO\n", rc);
+			return rc;
 		}
+		command += chunk;
 		remaining -= chunk;
 		vacant -= chunk;
 	}
@@ -528,11 +520,12 @@ static int sbefifo_send_command(struct sbefifo *sbefifo,
 static int sbefifo_read_response(struct sbefifo *sbefifo, struct iov_iter *response)
 {
 	struct device *dev = &sbefifo->fsi_dev->dev;
+	__be32 words[SBEFIFO_FIFO_DEPTH];
 	u32 status, eot_set;
 	unsigned long timeout;
 	bool overflow = false;
+	size_t len, i;
 	__be32 data;
-	size_t len;
 	int rc;
 
 	dev_vdbg(dev, "reading response, buflen = %zd\n", iov_iter_count(response));
@@ -551,12 +544,22 @@ static int sbefifo_read_response(struct sbefifo *sbefifo, struct iov_iter *respo
 
 		dev_vdbg(dev, "  chunk size %zd eot_set=0x%x\n", len, eot_set);
 
+		/*
+		 * Read the chunk in one go, but don't read past the first
+		 * EOT (the MSB of eot_set flags the first word).
+		 */
+		len = min_t(size_t, len, SBEFIFO_FIFO_DEPTH);
+		i = len;
+		if (eot_set)
+			i = min_t(size_t, len, SBEFIFO_FIFO_DEPTH + 1 - fls(eot_set));
+		rc = fsi_device_read_fifo(sbefifo->fsi_dev, SBEFIFO_DOWN,
+					  words, i);
+		if (rc < 0)
+			return rc;
+
 		/* Go through the chunk */
-		while(len--) {
-			/* Read the data */
-			rc = sbefifo_down_read(sbefifo, &data);
-			if (rc < 0)
-				return rc;
+		for (i = 0; len--; i++) {
+			data = words[i];
 
 			/* Was it an EOT ? */
 			if (eot_set & 0x80) {
@@ -895,6 +898,116 @@ static ssize_t sbefifo_user_write(struct file *file, const char __user *buf,
 	return rc;
 }
 
+static int sbefifo_user_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct sbefifo_user *user = file->private_data;
+	size_t len = vma->vm_end - vma->vm_start;
+	void *map;
+	int rc;
+
+	if (!user)
+		return -EINVAL;
+	if (vma->vm_pgoff || len > SBEFIFO_MAX_USER_MAP_LEN)
+		return -EINVAL;
+
+	mutex_lock(&user->file_lock);
+
+	/* One buffer per open file, it lives until the file is released */
+	if (user->map) {
+		rc = -EBUSY;
+		goto bail;
+	}
+
+	map = vmalloc_user(len);
+	if (!map) {
+		rc = -ENOMEM;
+		goto bail;
+	}
+
+	rc = remap_vmalloc_range(vma, map, 0);
+	if (rc) {
+		vfree(map);
+		goto bail;
+	}
+
+	user->map = map;
+	user->map_len = len;
+ bail:
+	mutex_unlock(&user->file_lock);
+	return rc;
+}
+
+static bool sbefifo_map_range_ok(struct sbefifo_user *user, u32 offset,
+				 u32 len)
+{
+	return !(offset & 3) && !(len & 3) && offset <= user->map_len &&
+		len <= user->map_len - offset;
+}
+
+static long sbefifo_user_doorbell(struct sbefifo_user *user,
+				  struct sbefifo_doorbell __user *argp)
+{
+	struct sbefifo *sbefifo = user->sbefifo;
+	struct sbefifo_doorbell db;
+	struct iov_iter resp_iter;
+	struct kvec resp_iov;
+	long rc;
+
+	if (copy_from_user(&db, argp, sizeof(db)))
+		return -EFAULT;
+
+	if (db.cmd_len < 8 || db.cmd_len > SBEFIFO_MAX_USER_CMD_LEN)
+		return -EINVAL;
+
+	mutex_lock(&user->file_lock);
+
+	if (!user->map) {
+		rc = -ENXIO;
+		goto bail;
+	}
+	if (!sbefifo_map_range_ok(user, db.cmd_offset, db.cmd_len) ||
+	    !sbefifo_map_range_ok(user, db.resp_offset, db.resp_len)) {
+		rc = -EINVAL;
+		goto bail;
+	}
+
+	resp_iov.iov_base = user->map + db.resp_offset;
+	resp_iov.iov_len = db.resp_len;
+	iov_iter_kvec(&resp_iter, WRITE, &resp_iov, 1, db.resp_len);
+
+	/* Perform the command straight out of and into the mapping */
+	mutex_lock(&sbefifo->lock);
+	rc = __sbefifo_submit(sbefifo, user->map + db.cmd_offset,
+			      db.cmd_len >> 2, &resp_iter);
+	mutex_unlock(&sbefifo->lock);
+	if (rc < 0 && rc != -EOVERFLOW)
+		goto bail;
+
+	/* Report the response length, even if it was truncated */
+	db.resp_len -= iov_iter_count(&resp_iter);
+	if (copy_to_user(argp, &db, sizeof(db)))
+		rc = -EFAULT;
+ bail:
+	mutex_unlock(&user->file_lock);
+	return rc;
+}
+
+static long sbefifo_user_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg)
+{
+	struct sbefifo_user *user = file->private_data;
+
+	if (!user)
+		return -EINVAL;
+
+	switch (cmd) {
+	case FSI_SBEFIFO_DOORBELL:
+		return sbefifo_user_doorbell(user, (void __user *)arg);
+	}
+
+	return -ENOTTY;
+}
+
 static int sbefifo_user_release(struct inode *inode, struct file *file)
 {
 	struct sbefifo_user *user = file->private_data;
@@ -904,6 +1017,7 @@ static int sbefifo_user_release(struct inode *inode, struct file *file)
 
 	sbefifo_release_command(user);
 	free_page((unsigned long)user->cmd_page);
+	vfree(user->map);
 	kfree(user);
 
 	return 0;
@@ -914,6 +1028,8 @@ static const struct file_operations sbefifo_fops = {
 	.open		= sbefifo_user_open,
 	.read		= sbefifo_user_read,
 	.write		= sbefifo_user_write,
+	.mmap		= sbefifo_user_mmap,
+	.unlocked_ioctl	= sbefifo_user_ioctl,
 	.release	= sbefifo_user_release,
 };
 
@@ -19,6 +19,7 @@
 #include <linux/reset.h>
 #include <linux/sysfs.h>
 #include <linux/thermal.h>
+#include <linux/workqueue.h>
 
 /* ASPEED PWM & FAN Tach Register Definition */
 #define ASPEED_PTCR_CTRL		0x00
@@ -167,6 +168,16 @@
 
 #define MAX_CDEV_NAME_LEN 16
 
+/*
+ * Background sampling: default period over which every tach channel is
+ * measured once when a fan curve is present but no interval was given,
+ * and the weight of the newest sample in the running average (1/2^n).
+ */
+#define ASPEED_TACH_SAMPLE_DEFAULT_MS	1000
+#define ASPEED_TACH_AVG_SHIFT		2
+/* Temperature drop in mC below a step before the curve steps down again. */
+#define ASPEED_FAN_CURVE_HYST_MC	2000
+
 struct aspeed_cooling_device {
 	char name[16];
 	struct aspeed_pwm_tacho_data *priv;
@@ -175,6 +186,8 @@ struct aspeed_cooling_device {
 	u8 *cooling_levels;
 	u8 max_state;
 	u8 cur_state;
+	struct thermal_zone_device *curve_tz;
+	u32 *curve_temps;
 };
 
 struct aspeed_pwm_tacho_data {
@@ -194,6 +207,12 @@ struct aspeed_pwm_tacho_data {
 	u8 fan_tach_ch_source[16];
 	struct aspeed_cooling_device *cdev[8];
 	const struct attribute_group *groups[3];
+	/* background sampling, enabled when sample_interval is non-zero */
+	struct delayed_work sample_work;
+	unsigned long sample_interval;
+	u8 sample_ch;
+	bool has_curve;
+	int fan_tach_rpm[16];
 };
 
 enum type { TYPEM, TYPEN, TYPEO };
@@ -610,7 +629,10 @@ static ssize_t rpm_show(struct device *dev, struct device_attribute *attr,
 	int rpm;
 	struct aspeed_pwm_tacho_data *priv = dev_get_drvdata(dev);
 
-	rpm = aspeed_get_fan_tach_ch_rpm(priv, index);
+	if (priv->sample_interval)
+		rpm = READ_ONCE(priv->fan_tach_rpm[index]);
+	else
+		rpm = aspeed_get_fan_tach_ch_rpm(priv, index);
 	if (rpm < 0)
 		return rpm;
 
@@ -800,6 +822,139 @@ static const struct thermal_cooling_device_ops aspeed_pwm_cool_ops = {
 	.set_cur_state = aspeed_pwm_cz_set_cur_state,
 };
 
+/*
+ * Pick the highest cooling level whose temperature threshold has been
+ * reached, only stepping down once the zone has cooled below the current
+ * threshold by ASPEED_FAN_CURVE_HYST_MC.
+ */
+static void aspeed_apply_fan_curve(struct aspeed_cooling_device *cdev)
+{
+	unsigned long state = 0;
+	int temp, ret, i;
+
+	ret = thermal_zone_get_temp(cdev->curve_tz, &temp);
+	if (ret)
+		return;
+
+	for (i = 0; i <= cdev->max_state; i++)
+		if (temp >= cdev->curve_temps[i])
+			state = i;
+
+	if (state < cdev->cur_state &&
+	    temp + ASPEED_FAN_CURVE_HYST_MC >=
+	    cdev->curve_temps[cdev->cur_state])
+		return;
+
+	if (state != cdev->cur_state)
+		aspeed_pwm_cz_set_cur_state(cdev->tcdev, state);
+}
+
+static void aspeed_tach_sample_work(struct work_struct *work)
+{
+	struct aspeed_pwm_tacho_data *priv =
+		container_of(to_delayed_work(work), struct aspeed_pwm_tacho_data,
+			     sample_work);
+	u8 ch = priv->sample_ch;
+	u8 next = ch;
+	int rpm, avg, i;
+
+	if (priv->fan_tach_present[ch]) {
+		rpm = aspeed_get_fan_tach_ch_rpm(priv, ch);
+		avg = priv->fan_tach_rpm[ch];
+		if (rpm >= 0 && avg >= 0)
+			rpm = avg + ((rpm - avg) >> ASPEED_TACH_AVG_SHIFT);
+		WRITE_ONCE(priv->fan_tach_rpm[ch], rpm);
+	}
+
+	for (i = 1; i <= ARRAY_SIZE(priv->fan_tach_present); i++) {
+		next = (ch + i) % ARRAY_SIZE(priv->fan_tach_present);
+		if (priv->fan_tach_present[next])
+			break;
+	}
+	priv->sample_ch = next;
+
+	/* run the fan curves once per pass over the tach channels */
+	if (priv->has_curve && next <= ch) {
+		for (i = 0; i < ARRAY_SIZE(priv->cdev); i++)
+			if (priv->cdev[i] && priv->cdev[i]->curve_tz)
+				aspeed_apply_fan_curve(priv->cdev[i]);
+	}
+
+	schedule_delayed_work(&priv->sample_work, priv->sample_interval);
+}
+
+static void aspeed_tach_sample_stop(void *data)
+{
+	struct aspeed_pwm_tacho_data *priv = data;
+
+	cancel_delayed_work_sync(&priv->sample_work);
+}
+
+static int aspeed_tach_sample_start(struct device *dev,
+				    struct aspeed_pwm_tacho_data *priv)
+{
+	u32 interval_ms = 0;
+	int i, nr_ch = 0;
+
+	of_property_read_u32(dev->of_node, "aspeed,tach-sample-interval-ms",
+			     &interval_ms);
+	if (!interval_ms && priv->has_curve)
+		interval_ms = ASPEED_TACH_SAMPLE_DEFAULT_MS;
+	if (!interval_ms)
+		return 0;
+
+	priv->sample_ch = 0;
+	for (i = ARRAY_SIZE(priv->fan_tach_present) - 1; i >= 0; i--) {
+		priv->fan_tach_rpm[i] = -ENODATA;
+		if (priv->fan_tach_present[i]) {
+			priv->sample_ch = i;
+			nr_ch++;
+		}
+	}
+
+	/* spread the measurements evenly over the interval */
+	priv->sample_interval =
+		max(msecs_to_jiffies(interval_ms) / max(nr_ch, 1), 1UL);
+
+	INIT_DELAYED_WORK(&priv->sample_work, aspeed_tach_sample_work);
+	schedule_delayed_work(&priv->sample_work, 0);
+
+	return devm_add_action_or_reset(dev, aspeed_tach_sample_stop, priv);
+}
+
+static int aspeed_create_fan_curve(struct device *dev,
+				   struct device_node *child,
+				   struct aspeed_cooling_device *cdev,
+				   u8 num_levels)
+{
+	const char *zone;
+	int ret;
+
+	if (of_property_read_string(child, "aspeed,fan-curve-zone", &zone))
+		return 0;
+
+	cdev->curve_temps = devm_kcalloc(dev, num_levels,
+					 sizeof(*cdev->curve_temps),
+					 GFP_KERNEL);
+	if (!cdev->curve_temps)
+		return -ENOMEM;
+
+	ret = of_property_read_u32_array(child, "aspeed,fan-curve-temps",
+					 cdev->curve_temps, num_levels);
+	if (ret) {
+		dev_err(dev, "Property 'aspeed,fan-curve-temps' must have one entry per cooling level.\n");
+		return ret;
+	}
+
+	cdev->curve_tz = thermal_zone_get_zone_by_name(zone);
+	if (IS_ERR(cdev->curve_tz)) {
+		cdev->curve_tz = NULL;
+		return -EPROBE_DEFER;
+	}
+
+	return 0;
+}
+
 static int aspeed_create_pwm_cooling(struct device *dev,
 				     struct device_node *child,
 				     struct aspeed_pwm_tacho_data *priv,
@@ -835,6 +990,12 @@ static int aspeed_create_pwm_cooling(struct device *dev,
 	cdev->priv = priv;
 	cdev->pwm_port = pwm_port;
 
+	ret = aspeed_create_fan_curve(dev, child, cdev, num_levels);
+	if (ret)
+		return ret;
+	if (cdev->curve_tz)
+		priv->has_curve = true;
+
 	priv->cdev[pwm_port] = cdev;
 
 	return 0;
@@ -941,6 +1102,10 @@ static int aspeed_pwm_tacho_probe(struct platform_device *pdev)
 		}
 	}
 
+	ret = aspeed_tach_sample_start(dev, priv);
+	if (ret)
+		return ret;
+
 	priv->groups[0] = &pwm_dev_group;
 	priv->groups[1] = &fan_dev_group;
 	priv->groups[2] = NULL;
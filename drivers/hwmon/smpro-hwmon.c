@@ -20,9 +20,11 @@
 #include <linux/bitfield.h>
 #include <linux/hwmon.h>
 #include <linux/hwmon-sysfs.h>
+#include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/mod_devicetable.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/platform_device.h>
 #include <linux/property.h>
 #include <linux/regmap.h>
@@ -77,8 +79,26 @@
 /* Add for DIMM group */
 #define DIMM_GROUP_DUMMY_REG            0xFF
 
+/*
+ * Snapshot block: every sensor register from SOC_TDP_REG up to
+ * RCA_VRD_CURR_REG is fetched with a single bulk read and served from
+ * the cache until update_interval expires.
+ */
+#define SNAPSHOT_FIRST_REG              SOC_TDP_REG
+#define SNAPSHOT_LAST_REG               RCA_VRD_CURR_REG
+#define SNAPSHOT_NUM_REGS		(SNAPSHOT_LAST_REG - SNAPSHOT_FIRST_REG + 1)
+
+/* Snapshot staleness window in ms, 0 disables the snapshot cache */
+#define SNAPSHOT_DEFAULT_INTERVAL	0
+#define SNAPSHOT_MAX_INTERVAL		60000
+
 struct smpro_hwmon {
 	struct regmap *regmap;
+	struct mutex lock;		/* protects the snapshot cache */
+	unsigned long update_interval;	/* in ms, 0 = snapshot disabled */
+	unsigned long last_updated;	/* in jiffies */
+	bool valid;
+	u16 snapshot[SNAPSHOT_NUM_REGS];
 };
 
 static const u8 temp_regs[] = {
@@ -155,6 +175,45 @@ static const char * const label[] = {
 	"DIMM G1",
 };
 
+static int smpro_update_snapshot(struct smpro_hwmon *hwmon)
+{
+	int ret;
+
+	if (hwmon->valid &&
+	    time_before(jiffies, hwmon->last_updated +
+			msecs_to_jiffies(hwmon->update_interval)))
+		return 0;
+
+	ret = regmap_bulk_read(hwmon->regmap, SNAPSHOT_FIRST_REG,
+			       hwmon->snapshot, SNAPSHOT_NUM_REGS);
+	if (ret) {
+		hwmon->valid = false;
+		return ret;
+	}
+
+	hwmon->last_updated = jiffies;
+	hwmon->valid = true;
+	return 0;
+}
+
+static int smpro_reg_read(struct smpro_hwmon *hwmon, unsigned int reg,
+				unsigned int *val)
+{
+	int ret;
+
+	if (!hwmon->update_interval || reg < SNAPSHOT_FIRST_REG ||
+	    reg > SNAPSHOT_LAST_REG)
+		return regmap_read(hwmon->regmap, reg, val);
+
+	mutex_lock(&hwmon->lock);
+	ret = smpro_update_snapshot(hwmon);
+	if (!ret)
+		*val = hwmon->snapshot[reg - SNAPSHOT_FIRST_REG];
+	mutex_unlock(&hwmon->lock);
+
+	return ret;
+}
+
 static int smpro_read_temp(struct device *dev, u32 attr, int channel,
 				long *val)
 {
@@ -168,7 +227,7 @@ static int smpro_read_temp(struct device *dev, u32 attr, int channel,
 	case hwmon_temp_input:
 		if (temp_regs[channel] == DIMM_GROUP_DUMMY_REG) {
 			for (i = 1; i <= 4; i++) {
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						temp_regs[channel + i], &value);
 				if (ret)
 					return ret;
@@ -186,7 +245,7 @@ static int smpro_read_temp(struct device *dev, u32 attr, int channel,
 				return -1;
 			*val = (t_max & 0x1ff) * 1000;
 		} else {
-			ret = regmap_read(hwmon->regmap,
+			ret = smpro_reg_read(hwmon,
 					temp_regs[channel], &value);
 			if (ret)
 				return ret;
@@ -208,7 +267,7 @@ static int smpro_read_in(struct device *dev, u32 attr, int channel,
 
 	switch (attr) {
 	case hwmon_in_input:
-		ret = regmap_read(hwmon->regmap, volt_regs[channel], &value);
+		ret = smpro_reg_read(hwmon, volt_regs[channel], &value);
 		if (ret < 0)
 			return ret;
 		*val = value & 0x7fff;
@@ -227,7 +286,7 @@ static int smpro_read_curr(struct device *dev, u32 attr, int channel,
 
 	switch (attr) {
 	case hwmon_curr_input:
-		ret = regmap_read(hwmon->regmap, curr_regs[channel], &value);
+		ret = smpro_reg_read(hwmon, curr_regs[channel], &value);
 		if (ret < 0)
 			return ret;
 		*val = value & 0x7fff;
@@ -250,89 +309,89 @@ static int smpro_read_power(struct device *dev, u32 attr, int channel,
 		switch (channel) {
 		case PMD_VRD_PWR:
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						CORE_VRD_PWR_REG, &val);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						CORE_VRD_PWR_MW_REG, &val_mw);
 			if (ret)
 				return ret;
 			break;
 		case SOC_VRD_PWR:
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						SOC_VRD_PWR_REG, &val);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						SOC_VRD_PWR_MW_REG, &val_mw);
 			if (ret)
 				return ret;
 			break;
 		case DIMM_VRD1_PWR:
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						DIMM_VRD1_PWR_REG, &val);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						DIMM_VRD1_PWR_MW_REG, &val_mw);
 			if (ret)
 				return ret;
 			break;
 		case DIMM_VRD2_PWR:
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						DIMM_VRD2_PWR_REG, &val);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						DIMM_VRD2_PWR_MW_REG, &val_mw);
 			if (ret)
 				return ret;
 			break;
 		case RCA_VRD_PWR:
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						RCA_VRD_PWR_REG, &val);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						RCA_VRD_PWR_MW_REG, &val_mw);
 			if (ret)
 				return ret;
 			break;
 		case SOC_TDP_PWR:
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						SOC_TDP_REG, &val);
 			if (ret)
 				return ret;
 			break;
 		case CPU_VRD_PWR:
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						CORE_VRD_PWR_REG, &val);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						CORE_VRD_PWR_MW_REG, &val_mw);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						SOC_VRD_PWR_REG, &val2);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						SOC_VRD_PWR_MW_REG, &val2_mw);
 			if (ret)
 				return ret;
 			break;
 		case DIMM_VRD_PWR:
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						DIMM_VRD1_PWR_REG, &val);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						DIMM_VRD1_PWR_MW_REG, &val_mw);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						DIMM_VRD2_PWR_REG, &val2);
 			if (!ret)
-				ret = regmap_read(hwmon->regmap,
+				ret = smpro_reg_read(hwmon,
 						DIMM_VRD2_PWR_MW_REG, &val2_mw);
 			if (ret)
 				return ret;
@@ -353,10 +412,42 @@ static int smpro_read_power(struct device *dev, u32 attr, int channel,
 	}
 }
 
+static int smpro_read_chip(struct device *dev, u32 attr, long *val)
+{
+	struct smpro_hwmon *hwmon = dev_get_drvdata(dev);
+
+	switch (attr) {
+	case hwmon_chip_update_interval:
+		*val = hwmon->update_interval;
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int smpro_write_chip(struct device *dev, u32 attr, long val)
+{
+	struct smpro_hwmon *hwmon = dev_get_drvdata(dev);
+
+	switch (attr) {
+	case hwmon_chip_update_interval:
+		val = clamp_val(val, 0, SNAPSHOT_MAX_INTERVAL);
+		mutex_lock(&hwmon->lock);
+		hwmon->update_interval = val;
+		hwmon->valid = false;
+		mutex_unlock(&hwmon->lock);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static int smpro_read(struct device *dev, enum hwmon_sensor_types type,
 				u32 attr, int channel, long *val)
 {
 	switch (type) {
+	case hwmon_chip:
+		return smpro_read_chip(dev, attr, val);
 	case hwmon_temp:
 		return smpro_read_temp(dev, attr, channel, val);
 	case hwmon_in:
@@ -373,13 +464,21 @@ static int smpro_read(struct device *dev, enum hwmon_sensor_types type,
 static int smpro_write(struct device *dev, enum hwmon_sensor_types type,
 				u32 attr, int channel, long val)
 {
-	return -EOPNOTSUPP;
+	switch (type) {
+	case hwmon_chip:
+		return smpro_write_chip(dev, attr, val);
+	default:
+		return -EOPNOTSUPP;
+	}
 }
 
 static umode_t smpro_is_visible(const void *data,
 				enum hwmon_sensor_types type,
 				u32 attr, int channel)
 {
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval)
+		return 0644;
+
 	return 0444;
 }
 
@@ -391,6 +490,16 @@ static ssize_t show_label(struct device *dev, struct device_attribute *devattr,
 	return sprintf(buf, "%s\n", label[index]);
 }
 
+static const u32 smpro_chip_config[] = {
+	HWMON_C_UPDATE_INTERVAL,
+	0
+};
+
+static const struct hwmon_channel_info smpro_chip = {
+	.type = hwmon_chip,
+	.config = smpro_chip_config,
+};
+
 static const u32 smpro_temp_config[] = {
 	HWMON_T_INPUT,
 	HWMON_T_INPUT,
@@ -464,6 +573,7 @@ static const struct hwmon_channel_info smpro_power = {
 };
 
 static const struct hwmon_channel_info *smpro_info[] = {
+	&smpro_chip,
 	&smpro_temp,
 	&smpro_in,
 	&smpro_power,
@@ -583,6 +693,7 @@ static int smpro_hwmon_probe(struct platform_device *pdev)
 {
 	struct smpro_hwmon *hwmon;
 	struct device *hwmon_dev;
+	u32 interval;
 	int ret;
 
 	hwmon = devm_kzalloc(&pdev->dev, sizeof(struct smpro_hwmon),
@@ -594,6 +705,12 @@ static int smpro_hwmon_probe(struct platform_device *pdev)
 	if (!hwmon->regmap)
 		return -ENODEV;
 
+	/* Optional snapshot staleness window, defaults to direct reads */
+	mutex_init(&hwmon->lock);
+	interval = SNAPSHOT_DEFAULT_INTERVAL;
+	device_property_read_u32(&pdev->dev, "update-interval-ms", &interval);
+	hwmon->update_interval = min_t(u32, interval, SNAPSHOT_MAX_INTERVAL);
+
 	/* Check for valid ID */
 	ret = check_valid_id(hwmon->regmap);
 	if (ret)
@@ -7,8 +7,10 @@
  *  Copyright 2017 Google, Inc.
  */
 
+#include <linux/bitfield.h>
 #include <linux/clk.h>
 #include <linux/completion.h>
+#include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/i2c.h>
@@ -35,7 +37,10 @@
 #define ASPEED_I2C_INTR_STS_REG				0x10
 #define ASPEED_I2C_CMD_REG				0x14
 #define ASPEED_I2C_DEV_ADDR_REG				0x18
+#define ASPEED_I2C_BUF_CTRL_REG				0x1c
 #define ASPEED_I2C_BYTE_BUF_REG				0x20
+#define ASPEED_I2C_DMA_ADDR_REG				0x24
+#define ASPEED_I2C_DMA_LEN_REG				0x28
 
 /* Global Register Definition */
 /* 0x00 : I2C Interrupt Status Register  */
@@ -103,6 +108,10 @@
 #define ASPEED_I2CD_BUS_RECOVER_CMD			BIT(11)
 
 /* Command Bit */
+#define ASPEED_I2CD_RX_DMA_ENABLE			BIT(9)
+#define ASPEED_I2CD_TX_DMA_ENABLE			BIT(8)
+#define ASPEED_I2CD_RX_BUFF_ENABLE			BIT(7)
+#define ASPEED_I2CD_TX_BUFF_ENABLE			BIT(6)
 #define ASPEED_I2CD_M_STOP_CMD				BIT(5)
 #define ASPEED_I2CD_M_S_RX_CMD_LAST			BIT(4)
 #define ASPEED_I2CD_M_RX_CMD				BIT(3)
@@ -115,10 +124,29 @@
 		 ASPEED_I2CD_M_RX_CMD |					       \
 		 ASPEED_I2CD_M_TX_CMD |					       \
 		 ASPEED_I2CD_M_START_CMD)
+#define ASPEED_I2CD_BUF_DMA_CMDS_MASK					       \
+		(ASPEED_I2CD_RX_DMA_ENABLE |				       \
+		 ASPEED_I2CD_TX_DMA_ENABLE |				       \
+		 ASPEED_I2CD_RX_BUFF_ENABLE |				       \
+		 ASPEED_I2CD_TX_BUFF_ENABLE)
 
 /* 0x18 : I2CD Slave Device Address Register   */
 #define ASPEED_I2CD_DEV_ADDR_MASK			GENMASK(6, 0)
 
+/* 0x1c : I2CD Buffer Control Register */
+#define ASPEED_I2CD_BUF_RX_COUNT_MASK			GENMASK(29, 24)
+#define ASPEED_I2CD_BUF_RX_SIZE_MASK			GENMASK(21, 16)
+#define ASPEED_I2CD_BUF_TX_COUNT_MASK			GENMASK(13, 8)
+
+/* 0x28 : I2CD DMA Transfer Length Register */
+#define ASPEED_I2CD_DMA_LEN_MASK			GENMASK(11, 0)
+
+enum aspeed_i2c_xfer_mode {
+	ASPEED_I2C_BYTE_MODE,
+	ASPEED_I2C_BUFFER_MODE,
+	ASPEED_I2C_DMA_MODE,
+};
+
 enum aspeed_i2c_master_state {
 	ASPEED_I2C_MASTER_INACTIVE,
 	ASPEED_I2C_MASTER_PENDING,
@@ -156,6 +184,8 @@ struct aspeed_i2c_bus {
 	enum aspeed_i2c_master_state	master_state;
 	struct i2c_msg			*msgs;
 	size_t				buf_index;
+	/* Bytes in flight through the buffer or DMA, 0 in byte mode. */
+	size_t				xfer_len;
 	size_t				msgs_index;
 	size_t				msgs_count;
 	bool				send_stop;
@@ -164,6 +194,13 @@ struct aspeed_i2c_bus {
 	int				master_xfer_result;
 	/* Multi-master */
 	bool				multi_master;
+	/* Buffer and DMA transfer modes. */
+	enum aspeed_i2c_xfer_mode	xfer_mode;
+	void __iomem			*buf_base;
+	size_t				buf_size;
+	u8				*dma_buf;
+	dma_addr_t			dma_handle;
+	size_t				dma_buf_size;
 #if IS_ENABLED(CONFIG_I2C_SLAVE)
 	struct i2c_client		*slave;
 	enum aspeed_i2c_slave_state	slave_state;
@@ -241,10 +278,72 @@ static int aspeed_i2c_recover_bus(struct aspeed_i2c_bus *bus)
 }
 
 #if IS_ENABLED(CONFIG_I2C_SLAVE)
+/*
+ * In buffer and DMA modes the controller collects the data bytes of a slave
+ * write by itself and only raises RX_DONE once the buffer is full, or
+ * NORMAL_STOP/SLAVE_MATCH at the end of the write, instead of once per byte.
+ */
+/* precondition: bus.lock has been acquired. */
+static void aspeed_i2c_slave_rx_arm(struct aspeed_i2c_bus *bus)
+{
+	switch (bus->xfer_mode) {
+	case ASPEED_I2C_BUFFER_MODE:
+		writel(FIELD_PREP(ASPEED_I2CD_BUF_RX_SIZE_MASK,
+				  bus->buf_size - 1),
+		       bus->base + ASPEED_I2C_BUF_CTRL_REG);
+		writel(ASPEED_I2CD_RX_BUFF_ENABLE,
+		       bus->base + ASPEED_I2C_CMD_REG);
+		break;
+	case ASPEED_I2C_DMA_MODE:
+		writel(bus->dma_handle, bus->base + ASPEED_I2C_DMA_ADDR_REG);
+		writel(FIELD_PREP(ASPEED_I2CD_DMA_LEN_MASK, bus->dma_buf_size),
+		       bus->base + ASPEED_I2C_DMA_LEN_REG);
+		writel(ASPEED_I2CD_RX_DMA_ENABLE,
+		       bus->base + ASPEED_I2C_CMD_REG);
+		break;
+	default:
+		break;
+	}
+}
+
+/* precondition: bus.lock has been acquired. */
+static void aspeed_i2c_slave_rx_drain(struct aspeed_i2c_bus *bus)
+{
+	struct i2c_client *slave = bus->slave;
+	size_t count, i;
+	u8 value;
+
+	switch (bus->xfer_mode) {
+	case ASPEED_I2C_BUFFER_MODE:
+		count = FIELD_GET(ASPEED_I2CD_BUF_RX_COUNT_MASK,
+				  readl(bus->base + ASPEED_I2C_BUF_CTRL_REG));
+		count = min(count, bus->buf_size);
+		for (i = 0; i < count; i++) {
+			value = readb(bus->buf_base + i);
+			i2c_slave_event(slave, I2C_SLAVE_WRITE_RECEIVED, &value);
+		}
+		break;
+	case ASPEED_I2C_DMA_MODE:
+		/* The length register counts down as bytes are received. */
+		count = bus->dma_buf_size -
+			FIELD_GET(ASPEED_I2CD_DMA_LEN_MASK,
+				  readl(bus->base + ASPEED_I2C_DMA_LEN_REG));
+		count = min(count, bus->dma_buf_size);
+		for (i = 0; i < count; i++) {
+			value = bus->dma_buf[i];
+			i2c_slave_event(slave, I2C_SLAVE_WRITE_RECEIVED, &value);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
 static u32 aspeed_i2c_slave_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 {
 	u32 command, irq_handled = 0;
 	struct i2c_client *slave = bus->slave;
+	bool rx_drained = false;
 	u8 value;
 
 	if (!slave)
@@ -259,6 +358,10 @@ static u32 aspeed_i2c_slave_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 			irq_handled |= ASPEED_I2CD_INTR_TX_NAK;
 			i2c_slave_event(slave, I2C_SLAVE_STOP, &value);
 		}
+		/* Repeated start: hand over what the write left behind. */
+		if (bus->xfer_mode != ASPEED_I2C_BYTE_MODE &&
+		    bus->slave_state == ASPEED_I2C_SLAVE_WRITE_RECEIVED)
+			aspeed_i2c_slave_rx_drain(bus);
 		irq_handled |= ASPEED_I2CD_INTR_SLAVE_MATCH;
 		bus->slave_state = ASPEED_I2C_SLAVE_START;
 	}
@@ -270,8 +373,21 @@ static u32 aspeed_i2c_slave_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 	dev_dbg(bus->dev, "slave irq status 0x%08x, cmd 0x%08x\n",
 		irq_status, command);
 
+	/*
+	 * In buffer and DMA modes data bytes never go through the byte
+	 * buffer; collect them before a stop moves the state machine on.
+	 */
+	if (bus->xfer_mode != ASPEED_I2C_BYTE_MODE &&
+	    bus->slave_state == ASPEED_I2C_SLAVE_WRITE_RECEIVED &&
+	    irq_status & (ASPEED_I2CD_INTR_RX_DONE |
+			  ASPEED_I2CD_INTR_NORMAL_STOP)) {
+		aspeed_i2c_slave_rx_drain(bus);
+		irq_handled |= irq_status & ASPEED_I2CD_INTR_RX_DONE;
+		rx_drained = true;
+	}
+
 	/* Slave was sent something. */
-	if (irq_status & ASPEED_I2CD_INTR_RX_DONE) {
+	if (irq_status & ASPEED_I2CD_INTR_RX_DONE && !rx_drained) {
 		value = readl(bus->base + ASPEED_I2C_BYTE_BUF_REG) >> 8;
 		/* Handle address frame. */
 		if (bus->slave_state == ASPEED_I2C_SLAVE_START) {
@@ -319,9 +435,15 @@ static u32 aspeed_i2c_slave_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 	case ASPEED_I2C_SLAVE_WRITE_REQUESTED:
 		bus->slave_state = ASPEED_I2C_SLAVE_WRITE_RECEIVED;
 		i2c_slave_event(slave, I2C_SLAVE_WRITE_REQUESTED, &value);
+		aspeed_i2c_slave_rx_arm(bus);
 		break;
 	case ASPEED_I2C_SLAVE_WRITE_RECEIVED:
-		i2c_slave_event(slave, I2C_SLAVE_WRITE_RECEIVED, &value);
+		if (bus->xfer_mode == ASPEED_I2C_BYTE_MODE)
+			i2c_slave_event(slave, I2C_SLAVE_WRITE_RECEIVED,
+					&value);
+		else if (rx_drained)
+			/* Buffer was full and drained; keep receiving. */
+			aspeed_i2c_slave_rx_arm(bus);
 		break;
 	case ASPEED_I2C_SLAVE_STOP:
 		i2c_slave_event(slave, I2C_SLAVE_STOP, &value);
@@ -347,6 +469,83 @@ static u32 aspeed_i2c_slave_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 }
 #endif /* CONFIG_I2C_SLAVE */
 
+/* precondition: bus.lock has been acquired. */
+static size_t aspeed_i2c_xfer_max(struct aspeed_i2c_bus *bus)
+{
+	if (bus->xfer_mode == ASPEED_I2C_DMA_MODE)
+		return bus->dma_buf_size;
+	return bus->buf_size;
+}
+
+/*
+ * Queue the next chunk of a write through the buffer or DMA engine, so that
+ * the controller only interrupts once the whole chunk has been sent.
+ *
+ * precondition: bus.lock has been acquired.
+ */
+static u32 aspeed_i2c_master_tx_chunk(struct aspeed_i2c_bus *bus,
+				      struct i2c_msg *msg)
+{
+	size_t len = min(msg->len - bus->buf_index, aspeed_i2c_xfer_max(bus));
+	u8 *data = &msg->buf[bus->buf_index];
+
+	bus->xfer_len = len;
+	bus->buf_index += len;
+
+	if (bus->xfer_mode == ASPEED_I2C_DMA_MODE) {
+		memcpy(bus->dma_buf, data, len);
+		writel(bus->dma_handle, bus->base + ASPEED_I2C_DMA_ADDR_REG);
+		writel(FIELD_PREP(ASPEED_I2CD_DMA_LEN_MASK, len),
+		       bus->base + ASPEED_I2C_DMA_LEN_REG);
+		return ASPEED_I2CD_M_TX_CMD | ASPEED_I2CD_TX_DMA_ENABLE;
+	}
+
+	memcpy_toio(bus->buf_base, data, len);
+	writel(FIELD_PREP(ASPEED_I2CD_BUF_TX_COUNT_MASK, len - 1),
+	       bus->base + ASPEED_I2C_BUF_CTRL_REG);
+	return ASPEED_I2CD_M_TX_CMD | ASPEED_I2CD_TX_BUFF_ENABLE;
+}
+
+/* precondition: bus.lock has been acquired. */
+static u32 aspeed_i2c_master_rx_chunk(struct aspeed_i2c_bus *bus,
+				      struct i2c_msg *msg)
+{
+	size_t len = min(msg->len - bus->buf_index, aspeed_i2c_xfer_max(bus));
+	u32 command = ASPEED_I2CD_M_RX_CMD;
+
+	bus->xfer_len = len;
+
+	/* Need to let the hardware know to NACK the last byte of the msg. */
+	if (bus->buf_index + len == msg->len)
+		command |= ASPEED_I2CD_M_S_RX_CMD_LAST;
+
+	if (bus->xfer_mode == ASPEED_I2C_DMA_MODE) {
+		writel(bus->dma_handle, bus->base + ASPEED_I2C_DMA_ADDR_REG);
+		writel(FIELD_PREP(ASPEED_I2CD_DMA_LEN_MASK, len),
+		       bus->base + ASPEED_I2C_DMA_LEN_REG);
+		return command | ASPEED_I2CD_RX_DMA_ENABLE;
+	}
+
+	writel(FIELD_PREP(ASPEED_I2CD_BUF_RX_SIZE_MASK, len - 1),
+	       bus->base + ASPEED_I2C_BUF_CTRL_REG);
+	return command | ASPEED_I2CD_RX_BUFF_ENABLE;
+}
+
+/* precondition: bus.lock has been acquired. */
+static void aspeed_i2c_master_rx_collect(struct aspeed_i2c_bus *bus,
+					 struct i2c_msg *msg)
+{
+	u8 *data = &msg->buf[bus->buf_index];
+
+	if (bus->xfer_mode == ASPEED_I2C_DMA_MODE)
+		memcpy(data, bus->dma_buf, bus->xfer_len);
+	else
+		memcpy_fromio(data, bus->buf_base, bus->xfer_len);
+
+	bus->buf_index += bus->xfer_len;
+	bus->xfer_len = 0;
+}
+
 /* precondition: bus.lock has been acquired. */
 static void aspeed_i2c_do_start(struct aspeed_i2c_bus *bus)
 {
@@ -368,8 +567,21 @@ static void aspeed_i2c_do_start(struct aspeed_i2c_bus *bus)
 
 	bus->master_state = ASPEED_I2C_MASTER_START;
 	bus->buf_index = 0;
+	bus->xfer_len = 0;
 
-	if (msg->flags & I2C_M_RD) {
+	/*
+	 * In buffer and DMA modes the data phase is queued together with the
+	 * address so that short messages complete with a single interrupt.
+	 * The length byte of an SMBus block read still goes through the byte
+	 * buffer since the rest of the read cannot be sized without it.
+	 */
+	if (bus->xfer_mode != ASPEED_I2C_BYTE_MODE && msg->len &&
+	    !(msg->flags & I2C_M_RECV_LEN)) {
+		if (msg->flags & I2C_M_RD)
+			command |= aspeed_i2c_master_rx_chunk(bus, msg);
+		else
+			command |= aspeed_i2c_master_tx_chunk(bus, msg);
+	} else if (msg->flags & I2C_M_RD) {
 		command |= ASPEED_I2CD_M_RX_CMD;
 		/* Need to let the hardware know to NACK after RX. */
 		if (msg->len == 1 && !(msg->flags & I2C_M_RECV_LEN))
@@ -478,7 +690,8 @@ static u32 aspeed_i2c_master_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 		 */
 		if (unlikely(irq_status & ASPEED_I2CD_INTR_SLAVE_MATCH)) {
 			writel(readl(bus->base + ASPEED_I2C_CMD_REG) &
-				~ASPEED_I2CD_MASTER_CMDS_MASK,
+				~(ASPEED_I2CD_MASTER_CMDS_MASK |
+				  ASPEED_I2CD_BUF_DMA_CMDS_MASK),
 			       bus->base + ASPEED_I2C_CMD_REG);
 			bus->master_state = ASPEED_I2C_MASTER_PENDING;
 			dev_dbg(bus->dev,
@@ -505,6 +718,9 @@ static u32 aspeed_i2c_master_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 		}
 		if (msg->flags & I2C_M_RD)
 			bus->master_state = ASPEED_I2C_MASTER_RX_FIRST;
+		else if (bus->xfer_len)
+			/* The first chunk went out along with the address. */
+			bus->master_state = ASPEED_I2C_MASTER_TX;
 		else
 			bus->master_state = ASPEED_I2C_MASTER_TX_FIRST;
 	}
@@ -524,10 +740,14 @@ static u32 aspeed_i2c_master_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 	case ASPEED_I2C_MASTER_TX_FIRST:
 		if (bus->buf_index < msg->len) {
 			bus->master_state = ASPEED_I2C_MASTER_TX;
-			writel(msg->buf[bus->buf_index++],
-			       bus->base + ASPEED_I2C_BYTE_BUF_REG);
-			writel(ASPEED_I2CD_M_TX_CMD,
-			       bus->base + ASPEED_I2C_CMD_REG);
+			if (bus->xfer_mode != ASPEED_I2C_BYTE_MODE) {
+				command = aspeed_i2c_master_tx_chunk(bus, msg);
+			} else {
+				writel(msg->buf[bus->buf_index++],
+				       bus->base + ASPEED_I2C_BYTE_BUF_REG);
+				command = ASPEED_I2CD_M_TX_CMD;
+			}
+			writel(command, bus->base + ASPEED_I2C_CMD_REG);
 		} else {
 			aspeed_i2c_next_msg_or_stop(bus);
 		}
@@ -544,6 +764,18 @@ static u32 aspeed_i2c_master_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 		}
 		irq_handled |= ASPEED_I2CD_INTR_RX_DONE;
 
+		if (bus->xfer_len) {
+			aspeed_i2c_master_rx_collect(bus, msg);
+			if (bus->buf_index < msg->len) {
+				bus->master_state = ASPEED_I2C_MASTER_RX;
+				writel(aspeed_i2c_master_rx_chunk(bus, msg),
+				       bus->base + ASPEED_I2C_CMD_REG);
+			} else {
+				aspeed_i2c_next_msg_or_stop(bus);
+			}
+			goto out_no_complete;
+		}
+
 		recv_byte = readl(bus->base + ASPEED_I2C_BYTE_BUF_REG) >> 8;
 		msg->buf[bus->buf_index++] = recv_byte;
 
@@ -560,9 +792,13 @@ static u32 aspeed_i2c_master_irq(struct aspeed_i2c_bus *bus, u32 irq_status)
 
 		if (bus->buf_index < msg->len) {
 			bus->master_state = ASPEED_I2C_MASTER_RX;
-			command = ASPEED_I2CD_M_RX_CMD;
-			if (bus->buf_index + 1 == msg->len)
-				command |= ASPEED_I2CD_M_S_RX_CMD_LAST;
+			if (bus->xfer_mode != ASPEED_I2C_BYTE_MODE) {
+				command = aspeed_i2c_master_rx_chunk(bus, msg);
+			} else {
+				command = ASPEED_I2CD_M_RX_CMD;
+				if (bus->buf_index + 1 == msg->len)
+					command |= ASPEED_I2CD_M_S_RX_CMD_LAST;
+			}
 			writel(command, bus->base + ASPEED_I2C_CMD_REG);
 		} else {
 			aspeed_i2c_next_msg_or_stop(bus);
@@ -958,6 +1194,56 @@ static int aspeed_i2c_reset(struct aspeed_i2c_bus *bus)
 	return ret;
 }
 
+/*
+ * Buffer mode is selected by a second "reg" entry describing the bus's
+ * buffer SRAM, DMA mode by an "aspeed,dma-buf-size" property. Neither is
+ * available on the AST2400, whose shared buffer pool is not supported.
+ */
+static int aspeed_i2c_init_xfer_mode(struct aspeed_i2c_bus *bus,
+				     struct platform_device *pdev)
+{
+	struct device_node *np = pdev->dev.of_node;
+	struct resource *res;
+	u32 dma_buf_size;
+
+	bus->xfer_mode = ASPEED_I2C_BYTE_MODE;
+
+	if (of_device_is_compatible(np, "aspeed,ast2400-i2c-bus"))
+		return 0;
+
+	if (!of_property_read_u32(np, "aspeed,dma-buf-size", &dma_buf_size)) {
+		if (!dma_buf_size || dma_buf_size > ASPEED_I2CD_DMA_LEN_MASK) {
+			dev_err(&pdev->dev, "invalid aspeed,dma-buf-size %u\n",
+				dma_buf_size);
+			return -EINVAL;
+		}
+
+		bus->dma_buf = dmam_alloc_coherent(&pdev->dev, dma_buf_size,
+						   &bus->dma_handle,
+						   GFP_KERNEL);
+		if (!bus->dma_buf)
+			return -ENOMEM;
+
+		bus->dma_buf_size = dma_buf_size;
+		bus->xfer_mode = ASPEED_I2C_DMA_MODE;
+		return 0;
+	}
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 1);
+	if (!res)
+		return 0;
+
+	bus->buf_base = devm_ioremap_resource(&pdev->dev, res);
+	if (IS_ERR(bus->buf_base))
+		return PTR_ERR(bus->buf_base);
+
+	bus->buf_size = min_t(size_t, resource_size(res),
+			      FIELD_MAX(ASPEED_I2CD_BUF_RX_SIZE_MASK) + 1);
+	bus->xfer_mode = ASPEED_I2C_BUFFER_MODE;
+
+	return 0;
+}
+
 static const struct of_device_id aspeed_i2c_bus_of_table[] = {
 	{
 		.compatible = "aspeed,ast2400-i2c-bus",
@@ -1022,6 +1308,10 @@ static int aspeed_i2c_probe_bus(struct platform_device *pdev)
 		bus->get_clk_reg_val = (u32 (*)(struct device *, u32))
 				match->data;
 
+	ret = aspeed_i2c_init_xfer_mode(bus, pdev);
+	if (ret < 0)
+		return ret;
+
 	/* Initialize the I2C adapter */
 	spin_lock_init(&bus->lock);
 	init_completion(&bus->cmd_complete);
@@ -1058,8 +1348,11 @@ static int aspeed_i2c_probe_bus(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, bus);
 
-	dev_info(bus->dev, "i2c bus %d registered, irq %d\n",
-		 bus->adap.nr, irq);
+	dev_info(bus->dev, "i2c bus %d registered (%s mode), irq %d\n",
+		 bus->adap.nr,
+		 bus->xfer_mode == ASPEED_I2C_DMA_MODE ? "dma" :
+		 bus->xfer_mode == ASPEED_I2C_BUFFER_MODE ? "buffer" : "byte",
+		 irq);
 
 	return 0;
 }
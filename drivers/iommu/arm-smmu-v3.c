@@ -60,6 +60,7 @@
 #define IDR0_S2P			(1 << 0)
 
 #define ARM_SMMU_IDR1			0x4
+#define IDR1_ECMDQ			(1 << 31)
 #define IDR1_TABLES_PRESET		(1 << 30)
 #define IDR1_QUEUES_PRESET		(1 << 29)
 #define IDR1_REL			(1 << 28)
@@ -78,6 +79,10 @@
 #define IDR5_GRAN16K			(1 << 5)
 #define IDR5_GRAN4K			(1 << 4)
 #define IDR5_OAS			GENMASK(2, 0)
+
+#define ARM_SMMU_IDR6			0x190
+#define IDR6_LOG2NUMP			GENMASK(27, 24)
+#define IDR6_LOG2NUMQ			GENMASK(19, 16)
 #define IDR5_OAS_32_BIT			0
 #define IDR5_OAS_36_BIT			1
 #define IDR5_OAS_40_BIT			2
@@ -173,6 +178,21 @@
 
 #define ARM_SMMU_REG_SZ			0xe00
 
+/* Enhanced command queues (SMMUv3.3) */
+#define ARM_SMMU_ECMDQ_CP_BASE		0x4000
+#define ARM_SMMU_ECMDQ_CP_STRIDE	0x20
+#define ECMDQ_CP_ADDR			GENMASK_ULL(51, 16)
+
+#define ARM_SMMU_ECMDQ_STRIDE		0x20
+#define ARM_SMMU_ECMDQ_BASE		0x0
+#define ARM_SMMU_ECMDQ_PROD		0x8
+#define ARM_SMMU_ECMDQ_CONS		0xc
+#define ECMDQ_PROD_EN			(1U << 31)
+#define ECMDQ_PROD_ERRACK		(1 << 23)
+#define ECMDQ_CONS_ENACK		(1U << 31)
+#define ECMDQ_CONS_ERR			(1 << 23)
+#define ECMDQ_MAX_SZ_SHIFT		8
+
 /* Common MSI config fields */
 #define MSI_CFG0_ADDR_MASK		GENMASK_ULL(51, 2)
 #define MSI_CFG2_SH			GENMASK(5, 4)
@@ -353,6 +373,11 @@
 
 #define CMDQ_TLBI_0_NUM			GENMASK_ULL(16, 12)
 #define CMDQ_TLBI_RANGE_NUM_MAX		31
+/*
+ * Without range invalidation, past this many per-granule TLBI commands it
+ * is cheaper to invalidate the whole ASID/VMID than to flood the queue.
+ */
+#define CMDQ_TLBI_MAX_OPS		(CMDQ_BATCH_ENTRIES * 8)
 #define CMDQ_TLBI_0_SCALE		GENMASK_ULL(24, 20)
 #define CMDQ_TLBI_0_VMID		GENMASK_ULL(47, 32)
 #define CMDQ_TLBI_0_ASID		GENMASK_ULL(63, 48)
@@ -562,6 +587,13 @@ struct arm_smmu_cmdq {
 	atomic_t			lock;
 };
 
+struct arm_smmu_ecmdq {
+	struct arm_smmu_queue		q;
+	spinlock_t			lock;
+	u32				errack;
+	void __iomem			*base;
+};
+
 struct arm_smmu_cmdq_batch {
 	u64				cmds[CMDQ_BATCH_ENTRIES * CMDQ_ENT_DWORDS];
 	int				num;
@@ -629,6 +661,7 @@ struct arm_smmu_strtab_cfg {
 /* An SMMUv3 instance */
 struct arm_smmu_device {
 	struct device			*dev;
+	phys_addr_t			ioaddr;
 	void __iomem			*base;
 	void __iomem			*page1;
 
@@ -648,6 +681,7 @@ struct arm_smmu_device {
 #define ARM_SMMU_FEAT_STALL_FORCE	(1 << 13)
 #define ARM_SMMU_FEAT_VAX		(1 << 14)
 #define ARM_SMMU_FEAT_RANGE_INV		(1 << 15)
+#define ARM_SMMU_FEAT_ECMDQ		(1 << 16)
 	u32				features;
 
 #define ARM_SMMU_OPT_SKIP_PREFETCH	(1 << 0)
@@ -655,6 +689,9 @@ struct arm_smmu_device {
 	u32				options;
 
 	struct arm_smmu_cmdq		cmdq;
+	struct arm_smmu_ecmdq		*ecmdq;
+	struct arm_smmu_ecmdq * __percpu	*ecmdq_cpu;
+	unsigned int			nr_ecmdq;
 	struct arm_smmu_evtq		evtq;
 	struct arm_smmu_priq		priq;
 
@@ -1001,7 +1038,8 @@ static void arm_smmu_cmdq_build_sync_cmd(u64 *cmd, struct arm_smmu_device *smmu,
 	arm_smmu_cmdq_build_cmd(cmd, &ent);
 }
 
-static void arm_smmu_cmdq_skip_err(struct arm_smmu_device *smmu)
+static void __arm_smmu_cmdq_skip_err(struct arm_smmu_device *smmu,
+				     struct arm_smmu_queue *q)
 {
 	static const char *cerror_str[] = {
 		[CMDQ_ERR_CERROR_NONE_IDX]	= "No error",
@@ -1012,7 +1050,6 @@ static void arm_smmu_cmdq_skip_err(struct arm_smmu_device *smmu)
 
 	int i;
 	u64 cmd[CMDQ_ENT_DWORDS];
-	struct arm_smmu_queue *q = &smmu->cmdq.q;
 	u32 cons = readl_relaxed(q->cons_reg);
 	u32 idx = FIELD_GET(CMDQ_CONS_ERR, cons);
 	struct arm_smmu_cmdq_ent cmd_sync = {
@@ -1059,6 +1096,11 @@ static void arm_smmu_cmdq_skip_err(struct arm_smmu_device *smmu)
 	queue_write(Q_ENT(q, cons), cmd, q->ent_dwords);
 }
 
+static void arm_smmu_cmdq_skip_err(struct arm_smmu_device *smmu)
+{
+	__arm_smmu_cmdq_skip_err(smmu, &smmu->cmdq.q);
+}
+
 /*
  * Command queue locking.
  * This is a form of bastardised rwlock with the following major changes:
@@ -1339,12 +1381,12 @@ static int arm_smmu_cmdq_poll_until_sync(struct arm_smmu_device *smmu,
 	return __arm_smmu_cmdq_poll_until_consumed(smmu, llq);
 }
 
-static void arm_smmu_cmdq_write_entries(struct arm_smmu_cmdq *cmdq, u64 *cmds,
+static void arm_smmu_cmdq_write_entries(struct arm_smmu_queue *q, u64 *cmds,
 					u32 prod, int n)
 {
 	int i;
 	struct arm_smmu_ll_queue llq = {
-		.max_n_shift	= cmdq->q.llq.max_n_shift,
+		.max_n_shift	= q->llq.max_n_shift,
 		.prod		= prod,
 	};
 
@@ -1352,8 +1394,111 @@ static void arm_smmu_cmdq_write_entries(struct arm_smmu_cmdq *cmdq, u64 *cmds,
 		u64 *cmd = &cmds[i * CMDQ_ENT_DWORDS];
 
 		prod = queue_inc_prod_n(&llq, i);
-		queue_write(Q_ENT(&cmdq->q, prod), cmd, CMDQ_ENT_DWORDS);
+		queue_write(Q_ENT(q, prod), cmd, CMDQ_ENT_DWORDS);
+	}
+}
+
+/*
+ * Read the cons pointer of an ECMDQ, skipping over a command that has put
+ * the queue into an error state. The error is acknowledged by making
+ * PROD.ERRACK match CONS.ERR again. Called with ecmdq->lock held.
+ */
+static u32 arm_smmu_ecmdq_read_cons(struct arm_smmu_device *smmu,
+				    struct arm_smmu_ecmdq *ecmdq)
+{
+	struct arm_smmu_queue *q = &ecmdq->q;
+	u32 cons = readl_relaxed(q->cons_reg);
+
+	if ((cons & ECMDQ_CONS_ERR) != ecmdq->errack) {
+		__arm_smmu_cmdq_skip_err(smmu, q);
+		ecmdq->errack ^= ECMDQ_PROD_ERRACK;
+		writel(q->llq.prod | ECMDQ_PROD_EN | ecmdq->errack,
+		       q->prod_reg);
 	}
+
+	return cons;
+}
+
+/*
+ * Each ECMDQ is private to a CPU, or to a small group of neighbouring
+ * CPUs when there are fewer queues than CPUs, so insertion only needs a
+ * spinlock that is rarely contended instead of the cmdq scheme below, and
+ * the prod/cons cachelines stay local.
+ *
+ * A CMD_SYNC only completes the commands that precede it on the same
+ * queue, and a caller may migrate between issuing some commands and
+ * issuing the CMD_SYNC for them. So every list submitted here is
+ * terminated by its own CMD_SYNC and has completed by the time we return,
+ * which in turn makes a lone CMD_SYNC a no-op.
+ */
+static int arm_smmu_ecmdq_issue_cmdlist(struct arm_smmu_device *smmu,
+					u64 *cmds, int n)
+{
+	u64 cmd_sync[CMDQ_ENT_DWORDS];
+	u32 prod;
+	unsigned long flags;
+	struct arm_smmu_queue_poll qp;
+	struct arm_smmu_ecmdq *ecmdq;
+	struct arm_smmu_queue *q;
+	struct arm_smmu_ll_queue llq;
+	struct arm_smmu_cmdq_ent ent = {
+		.opcode = CMDQ_OP_CMD_SYNC,
+	};
+	int ret = 0;
+
+	if (!n)
+		return 0;
+
+	ecmdq = *raw_cpu_ptr(smmu->ecmdq_cpu);
+	q = &ecmdq->q;
+	llq.max_n_shift = q->llq.max_n_shift;
+
+	spin_lock_irqsave(&ecmdq->lock, flags);
+	llq.val = q->llq.val;
+
+	/* 1. Wait for space for our commands and the CMD_SYNC */
+	queue_poll_init(smmu, &qp);
+	while (!queue_has_space(&llq, n + 1)) {
+		llq.cons = arm_smmu_ecmdq_read_cons(smmu, ecmdq);
+		ret = queue_poll(&qp);
+		if (ret) {
+			dev_err_ratelimited(smmu->dev, "ECMDQ timeout\n");
+			goto out_unlock;
+		}
+	}
+
+	/* 2. Write the commands, then publish them to the SMMU */
+	arm_smmu_cmdq_write_entries(q, cmds, llq.prod, n);
+	prod = queue_inc_prod_n(&llq, n);
+	arm_smmu_cmdq_build_cmd(cmd_sync, &ent);
+	queue_write(Q_ENT(q, prod), cmd_sync, CMDQ_ENT_DWORDS);
+
+	llq.prod = queue_inc_prod_n(&llq, n + 1);
+	q->llq.prod = llq.prod;
+	dma_wmb();
+	writel_relaxed(llq.prod | ECMDQ_PROD_EN | ecmdq->errack, q->prod_reg);
+
+	/* 3. Wait for the CMD_SYNC to be consumed */
+	queue_poll_init(smmu, &qp);
+	do {
+		llq.cons = arm_smmu_ecmdq_read_cons(smmu, ecmdq);
+		if (queue_consumed(&llq, prod))
+			break;
+
+		ret = queue_poll(&qp);
+	} while (!ret);
+
+	if (ret) {
+		dev_err_ratelimited(smmu->dev,
+				    "ECMDQ CMD_SYNC timeout at 0x%08x [hwprod 0x%08x, hwcons 0x%08x]\n",
+				    prod, readl_relaxed(q->prod_reg),
+				    readl_relaxed(q->cons_reg));
+	}
+
+out_unlock:
+	q->llq.cons = llq.cons;
+	spin_unlock_irqrestore(&ecmdq->lock, flags);
+	return ret;
 }
 
 /*
@@ -1370,7 +1515,8 @@ static void arm_smmu_cmdq_write_entries(struct arm_smmu_cmdq *cmdq, u64 *cmds,
  *
  * - Command insertion is totally ordered, so if two CPUs each race to
  *   insert their own list of commands then all of the commands from one
- *   CPU will appear before any of the commands from the other CPU.
+ *   CPU will appear before any of the commands from the other CPU. This
+ *   does not hold when ECMDQs are in use, see above.
  */
 static int arm_smmu_cmdq_issue_cmdlist(struct arm_smmu_device *smmu,
 				       u64 *cmds, int n, bool sync)
@@ -1385,6 +1531,9 @@ static int arm_smmu_cmdq_issue_cmdlist(struct arm_smmu_device *smmu,
 	}, head = llq;
 	int ret = 0;
 
+	if (smmu->features & ARM_SMMU_FEAT_ECMDQ)
+		return arm_smmu_ecmdq_issue_cmdlist(smmu, cmds, n);
+
 	/* 1. Allocate some space in the queue */
 	local_irq_save(flags);
 	llq.val = READ_ONCE(cmdq->q.llq.val);
@@ -1416,7 +1565,7 @@ static int arm_smmu_cmdq_issue_cmdlist(struct arm_smmu_device *smmu,
 	 * 2. Write our commands into the queue
 	 * Dependency ordering from the cmpxchg() loop above.
 	 */
-	arm_smmu_cmdq_write_entries(cmdq, cmds, llq.prod, n);
+	arm_smmu_cmdq_write_entries(&cmdq->q, cmds, llq.prod, n);
 	if (sync) {
 		prod = queue_inc_prod_n(&llq, n);
 		arm_smmu_cmdq_build_sync_cmd(cmd_sync, smmu, prod);
@@ -2296,6 +2445,12 @@ static void arm_smmu_tlb_inv_range(unsigned long iova, size_t size,
 	if (!size)
 		return;
 
+	if (!(smmu->features & ARM_SMMU_FEAT_RANGE_INV) &&
+	    (size >> ilog2(granule)) > CMDQ_TLBI_MAX_OPS) {
+		arm_smmu_tlb_inv_context(smmu_domain);
+		return;
+	}
+
 	if (smmu_domain->stage == ARM_SMMU_DOMAIN_S1) {
 		cmd.opcode	= CMDQ_OP_TLBI_NH_VA;
 		cmd.tlbi.asid	= smmu_domain->s1_cfg.cd.asid;
@@ -3205,6 +3360,71 @@ static int arm_smmu_cmdq_init(struct arm_smmu_device *smmu)
 	return ret;
 }
 
+/*
+ * Carve up the ECMDQs between the possible CPUs. With fewer queues than
+ * CPUs, neighbouring CPUs (which usually share a cluster or a node) end
+ * up on the same queue.
+ */
+static int arm_smmu_ecmdq_init(struct arm_smmu_device *smmu)
+{
+	int cpu, i, ret;
+	u32 reg;
+	unsigned int nump, numq, ncpus = num_possible_cpus();
+	void __iomem *cp_regs, *cp_page = NULL;
+	struct arm_smmu_ecmdq *ecmdq;
+
+	reg = readl_relaxed(smmu->base + ARM_SMMU_IDR6);
+	nump = 1 << FIELD_GET(IDR6_LOG2NUMP, reg);
+	numq = 1 << FIELD_GET(IDR6_LOG2NUMQ, reg);
+	smmu->nr_ecmdq = min(nump * numq, ncpus);
+
+	smmu->ecmdq = devm_kcalloc(smmu->dev, smmu->nr_ecmdq,
+				   sizeof(*smmu->ecmdq), GFP_KERNEL);
+	smmu->ecmdq_cpu = devm_alloc_percpu(smmu->dev, struct arm_smmu_ecmdq *);
+	if (!smmu->ecmdq || !smmu->ecmdq_cpu)
+		return -ENOMEM;
+
+	cp_regs = devm_ioremap(smmu->dev, smmu->ioaddr + ARM_SMMU_ECMDQ_CP_BASE,
+			       nump * ARM_SMMU_ECMDQ_CP_STRIDE);
+	if (!cp_regs)
+		return -ENOMEM;
+
+	for (i = 0; i < smmu->nr_ecmdq; i++) {
+		ecmdq = &smmu->ecmdq[i];
+
+		if (i % numq == 0) {
+			u64 val = readq_relaxed(cp_regs + (i / numq) *
+						ARM_SMMU_ECMDQ_CP_STRIDE);
+
+			cp_page = devm_ioremap(smmu->dev, val & ECMDQ_CP_ADDR,
+					       SZ_64K);
+			if (!cp_page)
+				return -ENOMEM;
+		}
+
+		ecmdq->base = cp_page + (i % numq) * ARM_SMMU_ECMDQ_STRIDE;
+		ecmdq->q.llq.max_n_shift = min_t(u32, ECMDQ_MAX_SZ_SHIFT,
+						 smmu->cmdq.q.llq.max_n_shift);
+		ret = arm_smmu_init_one_queue(smmu, &ecmdq->q, 0, 0,
+					      CMDQ_ENT_DWORDS, "ecmdq");
+		if (ret)
+			return ret;
+
+		ecmdq->q.prod_reg = ecmdq->base + ARM_SMMU_ECMDQ_PROD;
+		ecmdq->q.cons_reg = ecmdq->base + ARM_SMMU_ECMDQ_CONS;
+		spin_lock_init(&ecmdq->lock);
+	}
+
+	i = 0;
+	for_each_possible_cpu(cpu)
+		*per_cpu_ptr(smmu->ecmdq_cpu, cpu) =
+			&smmu->ecmdq[i++ * smmu->nr_ecmdq / ncpus];
+
+	dev_info(smmu->dev, "using %u ECMDQs for %u CPUs\n",
+		 smmu->nr_ecmdq, ncpus);
+	return 0;
+}
+
 static int arm_smmu_init_queues(struct arm_smmu_device *smmu)
 {
 	int ret;
@@ -3220,6 +3440,11 @@ static int arm_smmu_init_queues(struct arm_smmu_device *smmu)
 	if (ret)
 		return ret;
 
+	if (smmu->features & ARM_SMMU_FEAT_ECMDQ && arm_smmu_ecmdq_init(smmu)) {
+		dev_warn(smmu->dev, "failed to set up ECMDQs, using the cmdq\n");
+		smmu->features &= ~ARM_SMMU_FEAT_ECMDQ;
+	}
+
 	/* evtq */
 	ret = arm_smmu_init_one_queue(smmu, &smmu->evtq.q, ARM_SMMU_EVTQ_PROD,
 				      ARM_SMMU_EVTQ_CONS, EVTQ_ENT_DWORDS,
@@ -3558,6 +3783,31 @@ static int arm_smmu_device_disable(struct arm_smmu_device *smmu)
 	return ret;
 }
 
+static int arm_smmu_ecmdq_enable(struct arm_smmu_device *smmu)
+{
+	int i, ret;
+	u32 reg;
+	struct arm_smmu_ecmdq *ecmdq;
+	struct arm_smmu_queue *q;
+
+	for (i = 0; i < smmu->nr_ecmdq; i++) {
+		ecmdq = &smmu->ecmdq[i];
+		q = &ecmdq->q;
+
+		writeq_relaxed(q->q_base, ecmdq->base + ARM_SMMU_ECMDQ_BASE);
+		writel_relaxed(q->llq.cons, q->cons_reg);
+		writel(q->llq.prod | ECMDQ_PROD_EN | ecmdq->errack, q->prod_reg);
+
+		ret = readl_relaxed_poll_timeout(q->cons_reg, reg,
+						 reg & ECMDQ_CONS_ENACK,
+						 1, ARM_SMMU_POLL_TIMEOUT_US);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 static int arm_smmu_device_reset(struct arm_smmu_device *smmu, bool bypass)
 {
 	int ret;
@@ -3608,6 +3858,11 @@ static int arm_smmu_device_reset(struct arm_smmu_device *smmu, bool bypass)
 		return ret;
 	}
 
+	if (smmu->features & ARM_SMMU_FEAT_ECMDQ && arm_smmu_ecmdq_enable(smmu)) {
+		dev_warn(smmu->dev, "failed to enable ECMDQs, using the cmdq\n");
+		smmu->features &= ~ARM_SMMU_FEAT_ECMDQ;
+	}
+
 	/* Invalidate any cached configuration */
 	cmd.opcode = CMDQ_OP_CFGI_ALL;
 	arm_smmu_cmdq_issue_cmd(smmu, &cmd);
@@ -3797,6 +4052,9 @@ static int arm_smmu_device_hw_probe(struct arm_smmu_device *smmu)
 		return -ENXIO;
 	}
 
+	if (reg & IDR1_ECMDQ)
+		smmu->features |= ARM_SMMU_FEAT_ECMDQ;
+
 	/* Queue sizes, capped to ensure natural alignment */
 	smmu->cmdq.q.llq.max_n_shift = min_t(u32, CMDQ_MAX_SZ_SHIFT,
 					     FIELD_GET(IDR1_CMDQS, reg));
@@ -4052,6 +4310,7 @@ static int arm_smmu_device_probe(struct platform_device *pdev)
 		return -EINVAL;
 	}
 	ioaddr = res->start;
+	smmu->ioaddr = ioaddr;
 
 	/*
 	 * Don't map the IMPLEMENTATION DEFINED regions, since they may contain
@@ -29,7 +29,7 @@ static struct kset *iommu_group_kset;
 static DEFINE_IDA(iommu_group_ida);
 
 static unsigned int iommu_def_domain_type __read_mostly;
-static bool iommu_dma_strict __read_mostly = true;
+static bool iommu_dma_strict __read_mostly = !IS_ENABLED(CONFIG_IOMMU_DEFAULT_LAZY);
 static u32 iommu_cmd_line __read_mostly;
 
 struct iommu_group {
@@ -876,12 +876,29 @@ static void init_iova_rcaches(struct iova_domain *iovad)
 		for_each_possible_cpu(cpu) {
 			cpu_rcache = per_cpu_ptr(rcache->cpu_rcaches, cpu);
 			spin_lock_init(&cpu_rcache->lock);
+			if (i >= IOVA_RANGE_CACHE_EAGER_SIZE)
+				continue;
 			cpu_rcache->loaded = iova_magazine_alloc(GFP_KERNEL);
 			cpu_rcache->prev = iova_magazine_alloc(GFP_KERNEL);
 		}
 	}
 }
 
+/*
+ * The larger size classes are only used by some devices, so their per-cpu
+ * magazines are allocated on first use rather than for every domain and
+ * CPU up front. This also covers failed allocations in init_iova_rcaches().
+ */
+static bool iova_cpu_rcache_populate(struct iova_cpu_rcache *cpu_rcache)
+{
+	if (!cpu_rcache->loaded)
+		cpu_rcache->loaded = iova_magazine_alloc(GFP_ATOMIC);
+	if (!cpu_rcache->prev)
+		cpu_rcache->prev = iova_magazine_alloc(GFP_ATOMIC);
+
+	return cpu_rcache->loaded && cpu_rcache->prev;
+}
+
 /*
  * Try inserting IOVA range starting with 'iova_pfn' into 'rcache', and
  * return true on success.  Can fail if rcache is full and we can't free
@@ -900,7 +917,9 @@ static bool __iova_rcache_insert(struct iova_domain *iovad,
 	cpu_rcache = raw_cpu_ptr(rcache->cpu_rcaches);
 	spin_lock_irqsave(&cpu_rcache->lock, flags);
 
-	if (!iova_magazine_full(cpu_rcache->loaded)) {
+	if (unlikely(!iova_cpu_rcache_populate(cpu_rcache))) {
+		/* Fall back to the rbtree */
+	} else if (!iova_magazine_full(cpu_rcache->loaded)) {
 		can_insert = true;
 	} else if (!iova_magazine_full(cpu_rcache->prev)) {
 		swap(cpu_rcache->prev, cpu_rcache->loaded);
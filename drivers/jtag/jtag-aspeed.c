@@ -7,6 +7,7 @@
 #include <linux/clk.h>
 #include <linux/device.h>
 #include <linux/interrupt.h>
+#include <linux/iopoll.h>
 #include <linux/jtag.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
@@ -97,6 +98,8 @@
 #define ASPEED_JTAG_TCK_WAIT		10
 #define ASPEED_JTAG_RESET_CNTR		10
 #define WAIT_ITERATIONS		75
+/* Busy-wait budget for one streamed chunk, far above 32 TCKs at min freq */
+#define ASPEED_JTAG_STREAM_TIMEOUT_US	1000
 
 /*#define USE_INTERRUPTS*/
 
@@ -696,6 +699,57 @@ static int aspeed_jtag_xfer_push_data(struct aspeed_jtag *aspeed_jtag,
 	return res;
 }
 
+/*
+ * Streaming variant of aspeed_jtag_xfer_push_data(): the pause status is
+ * busy-polled without sleeping so the next chunk is loaded as soon as the
+ * engine has shifted the previous one.
+ */
+static int aspeed_jtag_xfer_push_data_stream(struct aspeed_jtag *aspeed_jtag,
+					     enum jtag_xfer_type type,
+					     u32 bits_len)
+{
+	u32 ctrl, pause, status;
+	int res;
+
+	if (type == JTAG_SIR_XFER) {
+		ctrl = ASPEED_JTAG_IOUT_LEN(bits_len);
+		pause = ASPEED_JTAG_ISR_INST_PAUSE;
+		aspeed_jtag_write(aspeed_jtag, ctrl, ASPEED_JTAG_CTRL);
+		aspeed_jtag_write(aspeed_jtag, ctrl | ASPEED_JTAG_CTL_INST_EN,
+				  ASPEED_JTAG_CTRL);
+	} else {
+		ctrl = ASPEED_JTAG_DOUT_LEN(bits_len);
+		pause = ASPEED_JTAG_ISR_DATA_PAUSE;
+		aspeed_jtag_write(aspeed_jtag, ctrl, ASPEED_JTAG_CTRL);
+		aspeed_jtag_write(aspeed_jtag, ctrl | ASPEED_JTAG_CTL_DATA_EN,
+				  ASPEED_JTAG_CTRL);
+	}
+
+	res = readl_poll_timeout_atomic(aspeed_jtag->reg_base +
+					ASPEED_JTAG_ISR, status,
+					status & pause, 0,
+					ASPEED_JTAG_STREAM_TIMEOUT_US);
+	if (res) {
+		dev_err(aspeed_jtag->dev,
+			"aspeed_jtag driver timed out streaming chunk\n");
+		return -EFAULT;
+	}
+
+	aspeed_jtag_write(aspeed_jtag, pause | (status & 0xf),
+			  ASPEED_JTAG_ISR);
+	return 0;
+}
+
+static int aspeed_jtag_xfer_push_chunk(struct aspeed_jtag *aspeed_jtag,
+				       enum jtag_xfer_type type, u32 bits_len)
+{
+	if (aspeed_jtag->mode & JTAG_XFER_HW_STREAM_MODE)
+		return aspeed_jtag_xfer_push_data_stream(aspeed_jtag, type,
+							 bits_len);
+
+	return aspeed_jtag_xfer_push_data(aspeed_jtag, type, bits_len);
+}
+
 static int aspeed_jtag_xfer_push_data_last(struct aspeed_jtag *aspeed_jtag,
 					   enum jtag_xfer_type type,
 					   u32 shift_bits,
@@ -768,8 +822,8 @@ static int aspeed_jtag_xfer_hw(struct aspeed_jtag *aspeed_jtag,
 			 * Read bytes were not equals to column length
 			 * and continue in Shift IR/DR
 			 */
-			if (aspeed_jtag_xfer_push_data(aspeed_jtag, xfer->type,
-						       shift_bits) != 0) {
+			if (aspeed_jtag_xfer_push_chunk(aspeed_jtag, xfer->type,
+							shift_bits) != 0) {
 				return -EFAULT;
 			}
 		} else {
@@ -805,10 +859,10 @@ static int aspeed_jtag_xfer_hw(struct aspeed_jtag *aspeed_jtag,
 					xfer->length,
 					ASPEED_JTAG_DATA_CHUNK_SIZE,
 					remain_xfer);
-				if (aspeed_jtag_xfer_push_data(aspeed_jtag,
-							       xfer->type,
-							       shift_bits)
-							       != 0) {
+				if (aspeed_jtag_xfer_push_chunk(aspeed_jtag,
+								xfer->type,
+								shift_bits)
+								!= 0) {
 					return -EFAULT;
 				}
 			}
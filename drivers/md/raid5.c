@@ -622,9 +622,23 @@ static int has_failed(struct r5conf *conf)
 	return 0;
 }
 
-struct stripe_head *
-raid5_get_active_stripe(struct r5conf *conf, sector_t sector,
-			int previous, int noblock, int noquiesce)
+static void release_batch_last(struct stripe_head **batch_last)
+{
+	if (batch_last && *batch_last) {
+		raid5_release_stripe(*batch_last);
+		*batch_last = NULL;
+	}
+}
+
+/*
+ * batch_last, if non-NULL, points to a stripe_head the caller holds a
+ * reference on for batching purposes. It is dropped before waiting for a
+ * free stripe, as it might otherwise be the one that would be freed.
+ */
+static struct stripe_head *
+__raid5_get_active_stripe(struct r5conf *conf, sector_t sector,
+			  int previous, int noblock, int noquiesce,
+			  struct stripe_head **batch_last)
 {
 	struct stripe_head *sh;
 	int hash = stripe_hash_locks_hash(sector);
@@ -652,6 +666,12 @@ raid5_get_active_stripe(struct r5conf *conf, sector_t sector,
 
 			r5c_check_stripe_cache_usage(conf);
 			if (!sh) {
+				if (batch_last && *batch_last) {
+					spin_unlock_irq(conf->hash_locks + hash);
+					release_batch_last(batch_last);
+					spin_lock_irq(conf->hash_locks + hash);
+					continue;
+				}
 				set_bit(R5_INACTIVE_BLOCKED,
 					&conf->cache_state);
 				r5l_wake_reclaim(conf->log, 0);
@@ -696,6 +716,14 @@ raid5_get_active_stripe(struct r5conf *conf, sector_t sector,
 	return sh;
 }
 
+struct stripe_head *
+raid5_get_active_stripe(struct r5conf *conf, sector_t sector,
+			int previous, int noblock, int noquiesce)
+{
+	return __raid5_get_active_stripe(conf, sector, previous, noblock,
+					 noquiesce, NULL);
+}
+
 static bool is_full_stripe_write(struct stripe_head *sh)
 {
 	BUG_ON(sh->overwrite_disks > (sh->disks - sh->raid_conf->max_degraded));
@@ -735,8 +763,14 @@ static bool stripe_can_batch(struct stripe_head *sh)
 		is_full_stripe_write(sh);
 }
 
-/* we only do back search */
-static void stripe_add_to_batch_list(struct r5conf *conf, struct stripe_head *sh)
+/*
+ * we only do back search. last_sh is the stripe_head the caller added a
+ * bio to before this one, if it still holds a reference to it: when it
+ * is the stripe just before sh, it is used directly instead of being
+ * looked up again under the hash lock.
+ */
+static void stripe_add_to_batch_list(struct r5conf *conf, struct stripe_head *sh,
+				     struct stripe_head *last_sh)
 {
 	struct stripe_head *head;
 	sector_t head_sector, tmp_sec;
@@ -750,6 +784,13 @@ static void stripe_add_to_batch_list(struct r5conf *conf, struct stripe_head *sh
 		return;
 	head_sector = sh->sector - STRIPE_SECTORS;
 
+	if (last_sh && last_sh->sector == head_sector &&
+	    last_sh->generation == conf->generation) {
+		head = last_sh;
+		atomic_inc(&head->count);
+		goto found;
+	}
+
 	hash = stripe_hash_locks_hash(head_sector);
 	spin_lock_irq(conf->hash_locks + hash);
 	head = __find_stripe(conf, head_sector, conf->generation);
@@ -778,6 +819,7 @@ static void stripe_add_to_batch_list(struct r5conf *conf, struct stripe_head *sh
 
 	if (!head)
 		return;
+found:
 	if (!stripe_can_batch(head))
 		goto out;
 
@@ -3323,9 +3365,6 @@ static int add_stripe_bio(struct stripe_head *sh, struct bio *bi, int dd_idx,
 		}
 	}
 	spin_unlock_irq(&sh->stripe_lock);
-
-	if (stripe_can_batch(sh))
-		stripe_add_to_batch_list(conf, sh);
 	return 1;
 
  overlap:
@@ -5589,6 +5628,7 @@ static bool raid5_make_request(struct mddev *mddev, struct bio * bi)
 	sector_t new_sector;
 	sector_t logical_sector, last_sector;
 	struct stripe_head *sh;
+	struct stripe_head *batch_last = NULL;
 	const int rw = bio_data_dir(bi);
 	DEFINE_WAIT(w);
 	bool do_prepare;
@@ -5666,6 +5706,7 @@ static bool raid5_make_request(struct mddev *mddev, struct bio * bi)
 				    ? logical_sector < conf->reshape_safe
 				    : logical_sector >= conf->reshape_safe) {
 					spin_unlock_irq(&conf->device_lock);
+					release_batch_last(&batch_last);
 					schedule();
 					do_prepare = true;
 					goto retry;
@@ -5681,8 +5722,9 @@ static bool raid5_make_request(struct mddev *mddev, struct bio * bi)
 			(unsigned long long)new_sector,
 			(unsigned long long)logical_sector);
 
-		sh = raid5_get_active_stripe(conf, new_sector, previous,
-				       (bi->bi_opf & REQ_RAHEAD), 0);
+		sh = __raid5_get_active_stripe(conf, new_sector, previous,
+					       (bi->bi_opf & REQ_RAHEAD), 0,
+					       &batch_last);
 		if (sh) {
 			if (unlikely(previous)) {
 				/* expansion might have moved on while waiting for a
@@ -5703,6 +5745,7 @@ static bool raid5_make_request(struct mddev *mddev, struct bio * bi)
 				spin_unlock_irq(&conf->device_lock);
 				if (must_retry) {
 					raid5_release_stripe(sh);
+					release_batch_last(&batch_last);
 					schedule();
 					do_prepare = true;
 					goto retry;
@@ -5724,10 +5767,27 @@ static bool raid5_make_request(struct mddev *mddev, struct bio * bi)
 				 */
 				md_wakeup_thread(mddev->thread);
 				raid5_release_stripe(sh);
+				release_batch_last(&batch_last);
 				schedule();
 				do_prepare = true;
 				goto retry;
 			}
+
+			/*
+			 * Sequential full stripe writes are batched so that
+			 * their parity is computed and written out together.
+			 * Keep a reference to the last stripe so the next one
+			 * can join its batch without another hash lookup.
+			 * It must be dropped before sleeping, as the batch
+			 * cannot be handled while it is held.
+			 */
+			if (stripe_can_batch(sh)) {
+				stripe_add_to_batch_list(conf, sh, batch_last);
+				release_batch_last(&batch_last);
+				atomic_inc(&sh->count);
+				batch_last = sh;
+			}
+
 			if (do_flush) {
 				set_bit(STRIPE_R5C_PREFLUSH, &sh->state);
 				/* we only need flush for one stripe */
@@ -5749,6 +5809,7 @@ static bool raid5_make_request(struct mddev *mddev, struct bio * bi)
 		}
 	}
 	finish_wait(&conf->wait_for_overlap, &w);
+	release_batch_last(&batch_last);
 
 	if (rw == WRITE)
 		md_write_end(mddev);
@@ -54,6 +54,8 @@
 
 #define VE_MAX_SRC_BUFFER_SIZE		0x8ca000 /* 1920 * 1200, 32bpp */
 #define VE_JPEG_HEADER_SIZE		0x006000 /* 512 * 12 * 4 */
+#define VE_BCD_BUFF_SIZE		0x009000 /* (1920/8) * (1200/8) */
+#define VE_BCD_THRESHOLD		1
 
 #define VE_PROTECTION_KEY		0x000
 #define  VE_PROTECTION_KEY_UNLOCK	0x1a038aa8
@@ -132,6 +134,12 @@
 #define  VE_COMP_CTRL_HQ_DCT_CHR	GENMASK(26, 22)
 #define  VE_COMP_CTRL_HQ_DCT_LUM	GENMASK(31, 27)
 
+#define VE_BCD_CTRL			0x0e0
+#define  VE_BCD_CTRL_EN_BCD		BIT(0)
+#define  VE_BCD_CTRL_THR		GENMASK(23, 16)
+
+#define VE_CB_ADDR			0x0ec
+
 #define AST2400_VE_COMP_SIZE_READ_BACK	0x078
 #define AST2600_VE_COMP_SIZE_READ_BACK	0x084
 
@@ -233,6 +241,14 @@ struct aspeed_video {
 	unsigned int max_compressed_size;
 	struct aspeed_video_addr srcs[2];
 	struct aspeed_video_addr jpeg;
+	struct aspeed_video_addr bcd;
+
+	/*
+	 * In Aspeed JPEG format only the blocks that changed since the
+	 * previous frame are encoded, except for key frames.
+	 */
+	bool force_key_frame;
+	bool key_frame;
 
 	bool yuv420;
 	unsigned int frame_rate;
@@ -481,6 +497,18 @@ static int aspeed_video_start_frame(struct aspeed_video *video)
 	addr = vb2_dma_contig_plane_dma_addr(&buf->vb.vb2_buf, 0);
 	spin_unlock_irqrestore(&video->lock, flags);
 
+	if (video->pix_fmt.pixelformat == V4L2_PIX_FMT_AJPG) {
+		video->key_frame = video->force_key_frame;
+		video->force_key_frame = false;
+
+		if (video->key_frame)
+			aspeed_video_update(video, VE_BCD_CTRL,
+					    VE_BCD_CTRL_EN_BCD, 0);
+		else
+			aspeed_video_update(video, VE_BCD_CTRL, 0,
+					    VE_BCD_CTRL_EN_BCD);
+	}
+
 	aspeed_video_write(video, VE_COMP_PROC_OFFSET, 0);
 	aspeed_video_write(video, VE_COMP_OFFSET, 0);
 	aspeed_video_write(video, VE_COMP_ADDR, addr);
@@ -609,6 +637,11 @@ static irqreturn_t aspeed_video_irq(int irq, void *arg)
 				buf->vb.vb2_buf.timestamp = ktime_get_ns();
 				buf->vb.sequence = video->sequence++;
 				buf->vb.field = V4L2_FIELD_NONE;
+				if (video->pix_fmt.pixelformat ==
+				    V4L2_PIX_FMT_AJPG)
+					buf->vb.flags |= video->key_frame ?
+						V4L2_BUF_FLAG_KEYFRAME :
+						V4L2_BUF_FLAG_PFRAME;
 				vb2_buffer_done(&buf->vb.vb2_buf,
 						VB2_BUF_STATE_DONE);
 				list_del(&buf->link);
@@ -930,7 +963,11 @@ static void aspeed_video_init_regs(struct aspeed_video *video)
 		FIELD_PREP(VE_COMP_CTRL_DCT_LUM, video->jpeg_quality) |
 		FIELD_PREP(VE_COMP_CTRL_DCT_CHR, video->jpeg_quality | 0x10);
 	u32 ctrl = VE_CTRL_AUTO_OR_CURSOR;
-	u32 seq_ctrl = video->jpeg_mode;
+	u32 seq_ctrl = 0;
+
+	/* The Aspeed JPEG format is the engine's native, non-JFIF mode. */
+	if (video->pix_fmt.pixelformat == V4L2_PIX_FMT_JPEG)
+		seq_ctrl |= video->jpeg_mode;
 
 	if (video->frame_rate)
 		ctrl |= FIELD_PREP(VE_CTRL_FRC, video->frame_rate);
@@ -951,6 +988,13 @@ static void aspeed_video_init_regs(struct aspeed_video *video)
 
 	aspeed_video_write(video, VE_JPEG_ADDR, video->jpeg.dma);
 
+	/* Compare against a previous frame only after a key frame. */
+	aspeed_video_write(video, VE_BCD_CTRL,
+			   FIELD_PREP(VE_BCD_CTRL_THR, VE_BCD_THRESHOLD));
+	if (video->bcd.size)
+		aspeed_video_write(video, VE_CB_ADDR, video->bcd.dma);
+	video->force_key_frame = true;
+
 	/* Set control registers */
 	aspeed_video_write(video, VE_SEQ_CTRL, seq_ctrl);
 	aspeed_video_write(video, VE_CTRL, ctrl);
@@ -998,6 +1042,9 @@ static void aspeed_video_stop(struct aspeed_video *video)
 	if (video->srcs[1].size)
 		aspeed_video_free_buf(video, &video->srcs[1]);
 
+	if (video->bcd.size)
+		aspeed_video_free_buf(video, &video->bcd);
+
 	video->v4l2_input_status = V4L2_IN_ST_NO_SIGNAL;
 	video->flags = 0;
 }
@@ -1013,13 +1060,18 @@ static int aspeed_video_querycap(struct file *file, void *fh,
 	return 0;
 }
 
+static const u32 aspeed_video_formats[] = {
+	V4L2_PIX_FMT_JPEG,
+	V4L2_PIX_FMT_AJPG,
+};
+
 static int aspeed_video_enum_format(struct file *file, void *fh,
 				    struct v4l2_fmtdesc *f)
 {
-	if (f->index)
+	if (f->index >= ARRAY_SIZE(aspeed_video_formats))
 		return -EINVAL;
 
-	f->pixelformat = V4L2_PIX_FMT_JPEG;
+	f->pixelformat = aspeed_video_formats[f->index];
 
 	return 0;
 }
@@ -1034,6 +1086,43 @@ static int aspeed_video_get_format(struct file *file, void *fh,
 	return 0;
 }
 
+static int aspeed_video_try_format(struct file *file, void *fh,
+				   struct v4l2_format *f)
+{
+	struct aspeed_video *video = video_drvdata(file);
+	u32 pixelformat = f->fmt.pix.pixelformat;
+
+	f->fmt.pix = video->pix_fmt;
+	if (pixelformat == V4L2_PIX_FMT_JPEG ||
+	    pixelformat == V4L2_PIX_FMT_AJPG)
+		f->fmt.pix.pixelformat = pixelformat;
+
+	return 0;
+}
+
+static int aspeed_video_set_format(struct file *file, void *fh,
+				   struct v4l2_format *f)
+{
+	struct aspeed_video *video = video_drvdata(file);
+
+	aspeed_video_try_format(file, fh, f);
+
+	if (f->fmt.pix.pixelformat == video->pix_fmt.pixelformat)
+		return 0;
+
+	if (vb2_is_busy(&video->queue))
+		return -EBUSY;
+
+	video->pix_fmt.pixelformat = f->fmt.pix.pixelformat;
+
+	if (video->pix_fmt.pixelformat == V4L2_PIX_FMT_JPEG)
+		aspeed_video_update(video, VE_SEQ_CTRL, 0, video->jpeg_mode);
+	else
+		aspeed_video_update(video, VE_SEQ_CTRL, video->jpeg_mode, 0);
+
+	return 0;
+}
+
 static int aspeed_video_enum_input(struct file *file, void *fh,
 				   struct v4l2_input *inp)
 {
@@ -1248,8 +1337,8 @@ static const struct v4l2_ioctl_ops aspeed_video_ioctl_ops = {
 
 	.vidioc_enum_fmt_vid_cap = aspeed_video_enum_format,
 	.vidioc_g_fmt_vid_cap = aspeed_video_get_format,
-	.vidioc_s_fmt_vid_cap = aspeed_video_get_format,
-	.vidioc_try_fmt_vid_cap = aspeed_video_get_format,
+	.vidioc_s_fmt_vid_cap = aspeed_video_set_format,
+	.vidioc_try_fmt_vid_cap = aspeed_video_try_format,
 
 	.vidioc_reqbufs = vb2_ioctl_reqbufs,
 	.vidioc_querybuf = vb2_ioctl_querybuf,
@@ -1321,6 +1410,9 @@ static int aspeed_video_set_ctrl(struct v4l2_ctrl *ctrl)
 			aspeed_video_update_subsampling(video);
 		}
 		break;
+	case V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME:
+		video->force_key_frame = true;
+		break;
 	default:
 		return -EINVAL;
 	}
@@ -1455,6 +1547,22 @@ static int aspeed_video_start_streaming(struct vb2_queue *q,
 
 	video->sequence = 0;
 
+	if (video->pix_fmt.pixelformat == V4L2_PIX_FMT_AJPG) {
+		if (!video->bcd.size) {
+			if (!aspeed_video_alloc_buf(video, &video->bcd,
+						    VE_BCD_BUFF_SIZE)) {
+				aspeed_video_bufs_done(video,
+						       VB2_BUF_STATE_QUEUED);
+				return -ENOMEM;
+			}
+
+			aspeed_video_write(video, VE_CB_ADDR, video->bcd.dma);
+		}
+
+		/* Nothing to compare against yet. */
+		video->force_key_frame = true;
+	}
+
 	rc = aspeed_video_start_frame(video);
 	if (rc) {
 		aspeed_video_bufs_done(video, VB2_BUF_STATE_QUEUED);
@@ -1542,7 +1650,7 @@ static int aspeed_video_setup_video(struct aspeed_video *video)
 		return rc;
 	}
 
-	v4l2_ctrl_handler_init(&video->ctrl_handler, 2);
+	v4l2_ctrl_handler_init(&video->ctrl_handler, 3);
 	v4l2_ctrl_new_std(&video->ctrl_handler, &aspeed_video_ctrl_ops,
 			  V4L2_CID_JPEG_COMPRESSION_QUALITY, 0,
 			  ASPEED_VIDEO_JPEG_NUM_QUALITIES - 1, 1, 0);
@@ -1550,6 +1658,8 @@ static int aspeed_video_setup_video(struct aspeed_video *video)
 			       V4L2_CID_JPEG_CHROMA_SUBSAMPLING,
 			       V4L2_JPEG_CHROMA_SUBSAMPLING_420, mask,
 			       V4L2_JPEG_CHROMA_SUBSAMPLING_444);
+	v4l2_ctrl_new_std(&video->ctrl_handler, &aspeed_video_ctrl_ops,
+			  V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME, 0, 0, 0, 0);
 
 	if (video->ctrl_handler.error) {
 		v4l2_ctrl_handler_free(&video->ctrl_handler);
@@ -8,6 +8,10 @@
  *
  * Once the register map has been successfully initialised, any sub-devices
  * represented by child nodes in Device Tree will be subsequently registered.
+ *
+ * The Ampere SMpro additionally gets a second, "urgent" register map on the
+ * same client. Both maps share one bus lock that hands the bus to urgent
+ * users (RAS error monitoring) ahead of routine sensor polling.
  */
 
 #include <linux/i2c.h>
@@ -15,6 +19,7 @@
 #include <linux/module.h>
 #include <linux/of_platform.h>
 #include <linux/regmap.h>
+#include <linux/wait.h>
 
 static const struct regmap_config simple_regmap_config = {
 	.reg_bits = 8,
@@ -26,20 +31,111 @@ static const struct regmap_config simple_word_regmap_config = {
 	.val_bits = 16,
 };
 
+struct smpro_sched {
+	struct mutex lock;
+	atomic_t urgent_waiters;
+	wait_queue_head_t wait;
+};
+
+struct smpro_sched_client {
+	struct smpro_sched *sched;
+	bool urgent;
+};
+
+/*
+ * Urgent users queue directly on the mutex. Routine users first wait for
+ * every pending urgent user to be served, and back off again if one
+ * showed up while they were acquiring the mutex.
+ */
+static void smpro_sched_lock(void *arg)
+{
+	struct smpro_sched_client *client = arg;
+	struct smpro_sched *sched = client->sched;
+
+	if (client->urgent) {
+		atomic_inc(&sched->urgent_waiters);
+		mutex_lock(&sched->lock);
+		atomic_dec(&sched->urgent_waiters);
+		return;
+	}
+
+	for (;;) {
+		wait_event(sched->wait, !atomic_read(&sched->urgent_waiters));
+		mutex_lock(&sched->lock);
+		if (!atomic_read(&sched->urgent_waiters))
+			return;
+		mutex_unlock(&sched->lock);
+	}
+}
+
+static void smpro_sched_unlock(void *arg)
+{
+	struct smpro_sched_client *client = arg;
+	struct smpro_sched *sched = client->sched;
+
+	mutex_unlock(&sched->lock);
+	if (!atomic_read(&sched->urgent_waiters))
+		wake_up(&sched->wait);
+}
+
+static struct regmap *smpro_regmap_init(struct i2c_client *i2c)
+{
+	struct smpro_sched_client *clients;
+	struct regmap_config config;
+	struct smpro_sched *sched;
+	struct regmap *regmap;
+
+	sched = devm_kzalloc(&i2c->dev, sizeof(*sched), GFP_KERNEL);
+	clients = devm_kcalloc(&i2c->dev, 2, sizeof(*clients), GFP_KERNEL);
+	if (!sched || !clients)
+		return ERR_PTR(-ENOMEM);
+
+	mutex_init(&sched->lock);
+	atomic_set(&sched->urgent_waiters, 0);
+	init_waitqueue_head(&sched->wait);
+
+	config = simple_word_regmap_config;
+	config.lock = smpro_sched_lock;
+	config.unlock = smpro_sched_unlock;
+
+	/*
+	 * dev_get_regmap(dev, NULL) returns the most recently added map, so
+	 * the urgent map goes first and children that do not ask for it by
+	 * name keep getting the routine one.
+	 */
+	clients[0].sched = sched;
+	clients[0].urgent = true;
+	config.name = "urgent";
+	config.lock_arg = &clients[0];
+	regmap = devm_regmap_init_i2c(i2c, &config);
+	if (IS_ERR(regmap))
+		return regmap;
+
+	clients[1].sched = sched;
+	config.name = NULL;
+	config.lock_arg = &clients[1];
+
+	return devm_regmap_init_i2c(i2c, &config);
+}
+
 static int simple_mfd_i2c_probe(struct i2c_client *i2c)
 {
 	const struct regmap_config *config;
 	struct regmap *regmap;
 
 	config = device_get_match_data(&i2c->dev);
-	if (!config) {
-		if (of_device_is_compatible(i2c->dev.of_node,
-						"ampere,ac01-smpro"))
-			config = &simple_word_regmap_config;
-		else
-			config = &simple_regmap_config;
+	if (!config &&
+	    of_device_is_compatible(i2c->dev.of_node, "ampere,ac01-smpro")) {
+		regmap = smpro_regmap_init(i2c);
+		if (IS_ERR(regmap))
+			return PTR_ERR(regmap);
+
+		return devm_of_platform_populate(&i2c->dev);
 	}
 
+	if (!config)
+		config = &simple_regmap_config;
+
 	regmap = devm_regmap_init_i2c(i2c, config);
 	if (IS_ERR(regmap))
 		return PTR_ERR(regmap);
@@ -18,11 +18,24 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/fs.h>
 #include <linux/i2c.h>
+#include <linux/interrupt.h>
+#include <linux/kfifo.h>
+#include <linux/miscdevice.h>
 #include <linux/mod_devicetable.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/platform_device.h>
+#include <linux/poll.h>
 #include <linux/regmap.h>
+#include <linux/sched.h>
+#include <linux/smpro-errmon.h>
+#include <linux/timekeeping.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+
+#define DEVICE_NAME		"smpro-errmon"
 
 /* Identification Registers */
 #define MANUFACTURER_ID_REG	0x02
@@ -88,6 +101,15 @@
 #define RAS_SMPRO_ERRS		0
 #define RAS_PMPRO_ERRS		1
 
+/* Streaming interface: number of buffered records and poll period */
+#define ERRMON_FIFO_RECORDS	512
+#define ERRMON_POLL_DEFAULT_MS	1000
+
+static unsigned int poll_interval_ms = ERRMON_POLL_DEFAULT_MS;
+module_param(poll_interval_ms, uint, 0644);
+MODULE_PARM_DESC(poll_interval_ms,
+		 "Error queue poll period in ms while the stream device is open and no alert IRQ is wired (default 1000)");
+
 /* Bit masks */
 #define BIT_0			0x0001
 #define BIT_1			0x0002
@@ -173,6 +195,18 @@ struct smpro_int_error_hdr list_smpro_int_error_hdr[2] = {
 
 struct smpro_errmon {
 	struct regmap *regmap;
+	/* serialises draining of the SMpro error queues */
+	struct mutex lock;
+
+	/* streaming interface */
+	struct miscdevice miscdev;
+	DECLARE_KFIFO_PTR(fifo, struct smpro_errmon_record);
+	struct mutex read_lock;
+	wait_queue_head_t wq;
+	struct delayed_work poll_work;
+	atomic_t open_count;
+	unsigned int dropped;
+	int irq;
 };
 
 static int read_i2c_block_data(struct i2c_client *client,
@@ -269,9 +303,10 @@ static ssize_t smpro_error_data_read(struct device *dev,
 
 	memset(err_data, 0xff, MAX_READ_BLOCK_LENGTH + 2);
 
+	mutex_lock(&errmon->lock);
 	ret = regmap_read(errmon->regmap, err_info.err_count, &err_count);
 	if (ret || err_count <= 0)
-		goto done;
+		goto unlock;
 
 	if (err_count > MAX_READ_ERROR)
 		err_count = MAX_READ_ERROR;
@@ -302,10 +337,186 @@ static ssize_t smpro_error_data_read(struct device *dev,
 		/* add error message to buffer */
 		strncat(buf, msg, strlen(msg));
 	}
+unlock:
+	mutex_unlock(&errmon->lock);
 done:
 	return strlen(buf);
 }
 
+/* Queue one record, discarding the oldest one if the FIFO is full */
+static void errmon_put_record(struct smpro_errmon *errmon,
+			      struct smpro_errmon_record *rec)
+{
+	if (kfifo_is_full(&errmon->fifo)) {
+		kfifo_skip(&errmon->fifo);
+		errmon->dropped++;
+	}
+
+	rec->dropped = min_t(unsigned int, errmon->dropped, U16_MAX);
+	errmon->dropped = 0;
+	kfifo_put(&errmon->fifo, *rec);
+}
+
+/*
+ * Drain every 48-byte error queue into the stream FIFO. Returns the
+ * number of records queued.
+ */
+static int errmon_collect(struct smpro_errmon *errmon)
+{
+	unsigned char err_data[MAX_READ_BLOCK_LENGTH + 2];
+	struct smpro_errmon_record rec;
+	struct smpro_error_hdr err_info;
+	s32 err_count, err_length;
+	int channel, i, ret;
+	int queued = 0;
+
+	mutex_lock(&errmon->lock);
+	for (channel = 0; channel < NUM_48BYTES_ERR_TYPE; channel++) {
+		err_info = smpro_error_table[channel];
+
+		ret = regmap_read(errmon->regmap, err_info.err_count,
+				  &err_count);
+		if (ret || err_count <= 0)
+			continue;
+
+		if (err_count > MAX_READ_ERROR)
+			err_count = MAX_READ_ERROR;
+
+		for (i = 0; i < err_count; i++) {
+			ret = regmap_read(errmon->regmap, err_info.err_len,
+					  &err_length);
+			if (ret || err_length <= 0)
+				break;
+
+			if (err_length > MAX_READ_BLOCK_LENGTH)
+				err_length = MAX_READ_BLOCK_LENGTH;
+
+			ret = errmon_read_block(errmon->regmap,
+						err_info.err_data, err_length,
+						err_data);
+			if (ret < 0)
+				break;
+
+			memset(&rec, 0, sizeof(rec));
+			rec.timestamp = ktime_get_ns();
+			rec.type = channel;
+			rec.len = err_length;
+			memcpy(rec.data, err_data, err_length);
+			errmon_put_record(errmon, &rec);
+			queued++;
+
+			/* go to next error */
+			ret = regmap_write(errmon->regmap, err_info.err_count,
+					   0x100);
+			if (ret)
+				break;
+		}
+	}
+	mutex_unlock(&errmon->lock);
+
+	if (queued)
+		wake_up_interruptible(&errmon->wq);
+
+	return queued;
+}
+
+static void errmon_poll_work(struct work_struct *work)
+{
+	struct smpro_errmon *errmon = container_of(to_delayed_work(work),
+						   struct smpro_errmon,
+						   poll_work);
+
+	errmon_collect(errmon);
+
+	if (atomic_read(&errmon->open_count) && errmon->irq <= 0)
+		schedule_delayed_work(&errmon->poll_work,
+				msecs_to_jiffies(max(poll_interval_ms, 1U)));
+}
+
+static irqreturn_t errmon_irq_thread(int irq, void *arg)
+{
+	struct smpro_errmon *errmon = arg;
+
+	errmon_collect(errmon);
+
+	return IRQ_HANDLED;
+}
+
+static struct smpro_errmon *errmon_file_to_errmon(struct file *file)
+{
+	return container_of(file->private_data, struct smpro_errmon, miscdev);
+}
+
+static int errmon_file_open(struct inode *inode, struct file *file)
+{
+	struct smpro_errmon *errmon = errmon_file_to_errmon(file);
+
+	/* The first opener starts the background poller */
+	if (atomic_inc_return(&errmon->open_count) == 1)
+		schedule_delayed_work(&errmon->poll_work, 0);
+
+	return 0;
+}
+
+static int errmon_file_release(struct inode *inode, struct file *file)
+{
+	struct smpro_errmon *errmon = errmon_file_to_errmon(file);
+
+	if (atomic_dec_and_test(&errmon->open_count))
+		cancel_delayed_work_sync(&errmon->poll_work);
+
+	return 0;
+}
+
+static ssize_t errmon_file_read(struct file *file, char __user *buffer,
+				size_t count, loff_t *ppos)
+{
+	struct smpro_errmon *errmon = errmon_file_to_errmon(file);
+	unsigned int copied;
+	int ret;
+
+	if (count < sizeof(struct smpro_errmon_record))
+		return -EINVAL;
+
+	if (mutex_lock_interruptible(&errmon->read_lock))
+		return -EINTR;
+
+	while (kfifo_is_empty(&errmon->fifo)) {
+		mutex_unlock(&errmon->read_lock);
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(errmon->wq,
+				!kfifo_is_empty(&errmon->fifo));
+		if (ret == -ERESTARTSYS)
+			return -EINTR;
+		if (mutex_lock_interruptible(&errmon->read_lock))
+			return -EINTR;
+	}
+
+	ret = kfifo_to_user(&errmon->fifo, buffer, count, &copied);
+	mutex_unlock(&errmon->read_lock);
+
+	return ret ? ret : copied;
+}
+
+static __poll_t errmon_file_poll(struct file *file,
+				 struct poll_table_struct *pt)
+{
+	struct smpro_errmon *errmon = errmon_file_to_errmon(file);
+
+	poll_wait(file, &errmon->wq, pt);
+	return !kfifo_is_empty(&errmon->fifo) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+static const struct file_operations errmon_fops = {
+	.owner		= THIS_MODULE,
+	.open		= errmon_file_open,
+	.release	= errmon_file_release,
+	.read		= errmon_file_read,
+	.poll		= errmon_file_poll,
+	.llseek		= noop_llseek,
+};
+
 static s32 smpro_internal_err_get_info(struct regmap *regmap, u8 addr,
 	u8 addr1, u8 addr2, u8 addr3, u8 subtype, char *buf)
 {
@@ -314,21 +525,35 @@ static s32 smpro_internal_err_get_info(struct regmap *regmap, u8 addr,
 
 	snprintf(buf, MAX_MSG_LEN, "%s", "");
 
-	ret = regmap_read(regmap, addr, &retLo);
-	if (ret)
-		return ret;
+	/* The info and data words sit in consecutive registers */
+	if (addr1 == addr + 1 && addr2 == addr + 2 && addr3 == addr + 3) {
+		u16 val[4];
 
-	ret = regmap_read(regmap, addr1, &retHi);
-	if (ret)
-		return ret;
+		ret = regmap_bulk_read(regmap, addr, val, ARRAY_SIZE(val));
+		if (ret)
+			return ret;
 
-	if (addr2 != 0xff) {
-		ret = regmap_read(regmap, addr2, &dataLo);
+		retLo = val[0];
+		retHi = val[1];
+		dataLo = val[2];
+		dataHi = val[3];
+	} else {
+		ret = regmap_read(regmap, addr, &retLo);
 		if (ret)
 			return ret;
-		ret = regmap_read(regmap, addr3, &dataHi);
+
+		ret = regmap_read(regmap, addr1, &retHi);
 		if (ret)
 			return ret;
+
+		if (addr2 != 0xff) {
+			ret = regmap_read(regmap, addr2, &dataLo);
+			if (ret)
+				return ret;
+			ret = regmap_read(regmap, addr3, &dataHi);
+			if (ret)
+				return ret;
+		}
 	}
 	/*
 	 * Output format:
@@ -538,7 +763,10 @@ static int smpro_errmon_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, errmon);
 
-	errmon->regmap = dev_get_regmap(pdev->dev.parent, NULL);
+	/* Error data goes ahead of routine sensor polling when available */
+	errmon->regmap = dev_get_regmap(pdev->dev.parent, "urgent");
+	if (!errmon->regmap)
+		errmon->regmap = dev_get_regmap(pdev->dev.parent, NULL);
 	if (!errmon->regmap)
 		return -ENODEV;
 
@@ -547,6 +775,40 @@ static int smpro_errmon_probe(struct platform_device *pdev)
 	if (ret)
 		dev_warn(&pdev->dev, "Hmmh, SMPro not ready yet\n");
 
+	mutex_init(&errmon->lock);
+	mutex_init(&errmon->read_lock);
+	init_waitqueue_head(&errmon->wq);
+	INIT_DELAYED_WORK(&errmon->poll_work, errmon_poll_work);
+	atomic_set(&errmon->open_count, 0);
+
+	ret = kfifo_alloc(&errmon->fifo, ERRMON_FIFO_RECORDS, GFP_KERNEL);
+	if (ret)
+		return ret;
+
+	/* An optional SMpro alert line replaces the periodic poller */
+	errmon->irq = platform_get_irq_optional(pdev, 0);
+	if (errmon->irq > 0) {
+		ret = devm_request_threaded_irq(&pdev->dev, errmon->irq, NULL,
+						errmon_irq_thread, IRQF_ONESHOT,
+						DEVICE_NAME, errmon);
+		if (ret) {
+			dev_warn(&pdev->dev, "Unable to request IRQ %d\n",
+				 errmon->irq);
+			errmon->irq = 0;
+		}
+	}
+
+	errmon->miscdev.minor = MISC_DYNAMIC_MINOR;
+	errmon->miscdev.name = DEVICE_NAME;
+	errmon->miscdev.fops = &errmon_fops;
+	errmon->miscdev.parent = &pdev->dev;
+	ret = misc_register(&errmon->miscdev);
+	if (ret) {
+		dev_err(&pdev->dev, "Unable to register device\n");
+		kfifo_free(&errmon->fifo);
+		return ret;
+	}
+
 	ret = sysfs_create_group(&pdev->dev.kobj, &smpro_errmon_attr_group);
 	if (ret)
 		dev_err(&pdev->dev, "SMPro errmon sysfs registration failed\n");
@@ -556,6 +818,13 @@ static int smpro_errmon_probe(struct platform_device *pdev)
 
 static int smpro_errmon_remove(struct platform_device *pdev)
 {
+	struct smpro_errmon *errmon = platform_get_drvdata(pdev);
+
+	misc_deregister(&errmon->miscdev);
+	if (errmon->irq > 0)
+		devm_free_irq(&pdev->dev, errmon->irq, errmon);
+	cancel_delayed_work_sync(&errmon->poll_work);
+	kfifo_free(&errmon->fifo);
 	sysfs_remove_group(&pdev->dev.kobj, &smpro_errmon_attr_group);
 	pr_info("SMPro errmon sysfs entries removed");
 
@@ -1436,7 +1436,8 @@ int i40e_setup_rx_descriptors(struct i40e_ring *rx_ring)
 	/* XDP RX-queue info only needed for RX rings exposed to XDP */
 	if (rx_ring->vsi->type == I40E_VSI_MAIN) {
 		err = xdp_rxq_info_reg(&rx_ring->xdp_rxq, rx_ring->netdev,
-				       rx_ring->queue_index);
+				       rx_ring->queue_index,
+				       rx_ring->q_vector->napi.napi_id);
 		if (err < 0)
 			return err;
 	}
@@ -2322,6 +2323,7 @@ static int i40e_clean_rx_irq(struct i40e_ring *rx_ring, int budget)
 
 #if (PAGE_SIZE < 8192)
 	xdp.frame_sz = i40e_rx_frame_truesize(rx_ring, 0);
+	xdp.flags = 0;
 #endif
 	xdp.rxq = &rx_ring->xdp_rxq;
 
@@ -483,7 +483,8 @@ int ice_setup_rx_ring(struct ice_ring *rx_ring)
 	if (rx_ring->vsi->type == ICE_VSI_PF &&
 	    !xdp_rxq_info_is_reg(&rx_ring->xdp_rxq))
 		if (xdp_rxq_info_reg(&rx_ring->xdp_rxq, rx_ring->netdev,
-				     rx_ring->q_index))
+				     rx_ring->q_index,
+				     rx_ring->q_vector->napi.napi_id))
 			goto err;
 	return 0;
 
@@ -1097,6 +1098,7 @@ int ice_clean_rx_irq(struct ice_ring *rx_ring, int budget)
 	/* Frame size depend on rx_ring setup when PAGE_SIZE=4K */
 #if (PAGE_SIZE < 8192)
 	xdp.frame_sz = ice_rx_frame_truesize(rx_ring, 0);
+	xdp.flags = 0;
 #endif
 
 	/* start the loop to process Rx packets bounded by 'budget' */
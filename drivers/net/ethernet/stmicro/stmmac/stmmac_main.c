@@ -3802,8 +3802,8 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 					buf->page, 0, buf1_len,
 					priv->dma_buf_sz);
 
-			/* Data payload appended into SKB */
-			page_pool_release_page(rx_q->page_pool, buf->page);
+			/* Data payload appended into SKB, recycled on free */
+			skb_mark_for_recycle(skb);
 			buf->page = NULL;
 		}
 
@@ -3814,8 +3814,8 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 					buf->sec_page, 0, buf2_len,
 					priv->dma_buf_sz);
 
-			/* Data payload appended into SKB */
-			page_pool_release_page(rx_q->page_pool, buf->sec_page);
+			/* Data payload appended into SKB, recycled on free */
+			skb_mark_for_recycle(skb);
 			buf->sec_page = NULL;
 		}
 
@@ -710,6 +710,7 @@ static struct sk_buff *veth_xdp_rcv_skb(struct veth_rq *rq,
 
 	/* SKB "head" area always have tailroom for skb_shared_info */
 	xdp.frame_sz = (void *)skb_end_pointer(skb) - xdp.data_hard_start;
+	xdp.flags = 0;
 	xdp.frame_sz += SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
 
 	orig_data = xdp.data;
@@ -919,7 +920,8 @@ static int veth_enable_xdp(struct net_device *dev)
 		for (i = 0; i < dev->real_num_rx_queues; i++) {
 			struct veth_rq *rq = &priv->rq[i];
 
-			err = xdp_rxq_info_reg(&rq->xdp_rxq, dev, i);
+			err = xdp_rxq_info_reg(&rq->xdp_rxq, dev, i,
+					       rq->xdp_napi.napi_id);
 			if (err < 0)
 				goto err_rxq_reg;
 
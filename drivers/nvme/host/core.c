@@ -19,6 +19,7 @@
 #include <linux/pr.h>
 #include <linux/ptrace.h>
 #include <linux/nvme_ioctl.h>
+#include <linux/io_uring.h>
 #include <linux/pm_qos.h>
 #include <asm/unaligned.h>
 
@@ -294,6 +295,20 @@ void nvme_complete_rq(struct request *req)
 }
 EXPORT_SYMBOL_GPL(nvme_complete_rq);
 
+/*
+ * Per-request part of nvme_complete_rq() for requests that completed
+ * successfully and are ended in a batch by blk_mq_end_request_batch().
+ */
+void nvme_complete_batch_req(struct request *req)
+{
+	trace_nvme_complete_rq(req);
+	nvme_cleanup_cmd(req);
+	if (nvme_req(req)->ctrl->kas)
+		nvme_req(req)->ctrl->comp_seen = true;
+	nvme_trace_bio_complete(req, BLK_STS_OK);
+}
+EXPORT_SYMBOL_GPL(nvme_complete_batch_req);
+
 bool nvme_cancel_request(struct request *req, void *data, bool reserved)
 {
 	dev_dbg_ratelimited(((struct nvme_ctrl *) data)->device,
@@ -739,6 +754,8 @@ static inline blk_status_t nvme_setup_rw(struct nvme_ns *ns,
 
 void nvme_cleanup_cmd(struct request *req)
 {
+	nvme_mpath_end_request(req);
+
 	if (req->rq_flags & RQF_SPECIAL_PAYLOAD) {
 		struct nvme_ns *ns = req->rq_disk->private_data;
 		struct page *page = req->special_vec.bv_page;
@@ -784,6 +801,8 @@ blk_status_t nvme_setup_cmd(struct nvme_ns *ns, struct request *req,
 
 	cmd->common.command_id = req->tag;
 	trace_nvme_setup_cmd(req, cmd);
+	if (ret == BLK_STS_OK)
+		nvme_mpath_start_request(req);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(nvme_setup_cmd);
@@ -3139,12 +3158,228 @@ static long nvme_dev_ioctl(struct file *file, unsigned int cmd,
 	}
 }
 
+static struct nvme_ns *nvme_find_get_ns(struct nvme_ctrl *ctrl, unsigned nsid);
+
+/*
+ * Per-command state of an io_uring passthrough command, kept in the inline
+ * pdu of struct io_uring_cmd.
+ */
+struct nvme_uring_cmd_pdu {
+	union {
+		struct bio *bio;
+		struct request *req;
+	};
+	void *meta;
+	void __user *meta_buffer;
+	struct nvme_ns *ns;
+};
+
+static inline struct nvme_uring_cmd_pdu *nvme_uring_cmd_pdu(
+		struct io_uring_cmd *ioucmd)
+{
+	return (struct nvme_uring_cmd_pdu *)&ioucmd->pdu;
+}
+
+static void nvme_uring_task_cb(struct io_uring_cmd *ioucmd)
+{
+	struct nvme_uring_cmd_pdu *pdu = nvme_uring_cmd_pdu(ioucmd);
+	const struct nvme_uring_cmd *cmd = ioucmd->cmd;
+	struct nvme_uring_cmd __user *ucmd = ioucmd->ucmd;
+	struct request *req = pdu->req;
+	struct bio *bio = req->bio;
+	bool write = nvme_is_write(nvme_req(req)->cmd);
+	u64 result;
+	int status;
+
+	if (nvme_req(req)->flags & NVME_REQ_CANCELLED)
+		status = -EINTR;
+	else
+		status = nvme_req(req)->status;
+	result = le64_to_cpu(nvme_req(req)->result.u64);
+
+	if (pdu->meta) {
+		if (!status && !write &&
+		    copy_to_user(pdu->meta_buffer, pdu->meta, cmd->metadata_len))
+			status = -EFAULT;
+		kfree(pdu->meta);
+	}
+	if (bio)
+		blk_rq_unmap_user(bio);
+	kfree(nvme_req(req)->cmd);
+	blk_mq_free_request(req);
+	if (pdu->ns)
+		nvme_put_ns(pdu->ns);
+
+	if (status >= 0 && put_user(result, &ucmd->result))
+		status = -EFAULT;
+	io_uring_cmd_done(ioucmd, status);
+}
+
+static void nvme_uring_cmd_end_io(struct request *req, blk_status_t err)
+{
+	struct io_uring_cmd *ioucmd = req->end_io_data;
+	struct nvme_uring_cmd_pdu *pdu = nvme_uring_cmd_pdu(ioucmd);
+	/* the bio is gone from the request by now, but unmap needs it */
+	struct bio *bio = pdu->bio;
+
+	pdu->req = req;
+	req->bio = bio;
+	/* unmapping and copying out results needs process context */
+	io_uring_cmd_complete_in_task(ioucmd, nvme_uring_task_cb);
+}
+
+/*
+ * Admin commands that change controller or namespace state need IO frozen
+ * around them, which only the synchronous ioctl path knows how to do.
+ */
+static bool nvme_uring_cmd_has_effects(struct nvme_ctrl *ctrl, u8 opcode)
+{
+	u32 effects = nvme_known_admin_effects(opcode);
+
+	if (ctrl->effects)
+		effects |= le32_to_cpu(ctrl->effects->acs[opcode]);
+	return effects & ~NVME_CMD_EFFECTS_CSUPP;
+}
+
+static int nvme_uring_cmd_io(struct nvme_ctrl *ctrl, bool io_cmd,
+		struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+	struct nvme_uring_cmd_pdu *pdu = nvme_uring_cmd_pdu(ioucmd);
+	const struct nvme_uring_cmd *cmd = ioucmd->cmd;
+	struct request_queue *q = ctrl->admin_q;
+	blk_mq_req_flags_t rq_flags = 0;
+	struct gendisk *disk = NULL;
+	struct nvme_ns *ns = NULL;
+	struct nvme_command *c;
+	struct request *req;
+	struct bio *bio = NULL;
+	void *meta = NULL;
+	int ret;
+
+	BUILD_BUG_ON(sizeof(struct nvme_uring_cmd_pdu) > sizeof(ioucmd->pdu));
+	BUILD_BUG_ON(sizeof(struct nvme_uring_cmd) > IO_URING_CMD_MAX_LEN);
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EACCES;
+	if (ioucmd->cmd_len != sizeof(*cmd))
+		return -EINVAL;
+	if (cmd->flags)
+		return -EINVAL;
+	if (!io_cmd && nvme_uring_cmd_has_effects(ctrl, cmd->opcode))
+		return -EOPNOTSUPP;
+
+	/* the request refers to the command until it has been completed */
+	c = kzalloc(sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return -ENOMEM;
+	c->common.opcode = cmd->opcode;
+	c->common.flags = cmd->flags;
+	c->common.nsid = cpu_to_le32(cmd->nsid);
+	c->common.cdw2[0] = cpu_to_le32(cmd->cdw2);
+	c->common.cdw2[1] = cpu_to_le32(cmd->cdw3);
+	c->common.cdw10 = cpu_to_le32(cmd->cdw10);
+	c->common.cdw11 = cpu_to_le32(cmd->cdw11);
+	c->common.cdw12 = cpu_to_le32(cmd->cdw12);
+	c->common.cdw13 = cpu_to_le32(cmd->cdw13);
+	c->common.cdw14 = cpu_to_le32(cmd->cdw14);
+	c->common.cdw15 = cpu_to_le32(cmd->cdw15);
+
+	if (io_cmd) {
+		ret = -EINVAL;
+		ns = nvme_find_get_ns(ctrl, cmd->nsid);
+		if (!ns)
+			goto out_free_cmd;
+		q = ns->queue;
+		disk = ns->disk;
+	}
+
+	if (issue_flags & IO_URING_F_NONBLOCK)
+		rq_flags |= BLK_MQ_REQ_NOWAIT;
+
+	req = nvme_alloc_request(q, c, rq_flags, NVME_QID_ANY);
+	if (IS_ERR(req)) {
+		ret = PTR_ERR(req);
+		goto out_put_ns;
+	}
+
+	req->timeout = cmd->timeout_ms ? msecs_to_jiffies(cmd->timeout_ms) :
+			ADMIN_TIMEOUT;
+	nvme_req(req)->flags |= NVME_REQ_USERCMD;
+
+	if (cmd->addr && cmd->data_len) {
+		if (ioucmd->flags & IORING_URING_CMD_FIXED) {
+			struct iov_iter iter;
+
+			ret = io_uring_cmd_import_fixed(cmd->addr,
+					cmd->data_len, rq_data_dir(req), &iter,
+					ioucmd);
+			if (ret)
+				goto out_free_req;
+			ret = blk_rq_map_user_iov(q, req, NULL, &iter,
+					GFP_KERNEL);
+		} else {
+			ret = blk_rq_map_user(q, req, NULL,
+					nvme_to_user_ptr(cmd->addr),
+					cmd->data_len, GFP_KERNEL);
+		}
+		if (ret)
+			goto out_free_req;
+		bio = req->bio;
+		bio->bi_disk = disk;
+		if (disk && cmd->metadata && cmd->metadata_len) {
+			meta = nvme_add_user_metadata(bio,
+					nvme_to_user_ptr(cmd->metadata),
+					cmd->metadata_len, 0, nvme_is_write(c));
+			if (IS_ERR(meta)) {
+				ret = PTR_ERR(meta);
+				goto out_unmap;
+			}
+			req->cmd_flags |= REQ_INTEGRITY;
+		}
+	}
+
+	pdu->bio = bio;
+	pdu->meta = meta;
+	pdu->meta_buffer = nvme_to_user_ptr(cmd->metadata);
+	pdu->ns = ns;
+	req->end_io_data = ioucmd;
+	blk_execute_rq_nowait(q, disk, req, 0, nvme_uring_cmd_end_io);
+	return -EIOCBQUEUED;
+
+ out_unmap:
+	blk_rq_unmap_user(bio);
+ out_free_req:
+	blk_mq_free_request(req);
+ out_put_ns:
+	if (ns)
+		nvme_put_ns(ns);
+ out_free_cmd:
+	kfree(c);
+	return ret;
+}
+
+static int nvme_dev_uring_cmd(struct io_uring_cmd *ioucmd,
+		unsigned int issue_flags)
+{
+	struct nvme_ctrl *ctrl = ioucmd->file->private_data;
+
+	switch (ioucmd->cmd_op) {
+	case NVME_URING_CMD_ADMIN:
+		return nvme_uring_cmd_io(ctrl, false, ioucmd, issue_flags);
+	case NVME_URING_CMD_IO:
+		return nvme_uring_cmd_io(ctrl, true, ioucmd, issue_flags);
+	default:
+		return -ENOTTY;
+	}
+}
+
 static const struct file_operations nvme_dev_fops = {
 	.owner		= THIS_MODULE,
 	.open		= nvme_dev_open,
 	.release	= nvme_dev_release,
 	.unlocked_ioctl	= nvme_dev_ioctl,
 	.compat_ioctl	= compat_ptr_ioctl,
+	.uring_cmd	= nvme_dev_uring_cmd,
 };
 
 static ssize_t nvme_sysfs_reset(struct device *dev,
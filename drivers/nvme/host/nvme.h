@@ -159,6 +159,7 @@ struct nvme_request {
 enum {
 	NVME_REQ_CANCELLED		= (1 << 0),
 	NVME_REQ_USERCMD		= (1 << 1),
+	NVME_MPATH_CNT_ACTIVE		= (1 << 2),
 };
 
 static inline struct nvme_request *nvme_req(struct request *req)
@@ -283,6 +284,7 @@ struct nvme_ctrl {
 	size_t ana_log_size;
 	struct timer_list anatt_timer;
 	struct work_struct ana_work;
+	atomic_t nr_active;	/* queue-depth iopolicy */
 #endif
 
 	/* Power saving configuration */
@@ -312,6 +314,7 @@ struct nvme_ctrl {
 enum nvme_iopolicy {
 	NVME_IOPOLICY_NUMA,
 	NVME_IOPOLICY_RR,
+	NVME_IOPOLICY_QD,
 };
 
 struct nvme_subsystem {
@@ -481,8 +484,13 @@ static inline u32 nvme_bytes_to_numd(size_t len)
 	return (len >> 2) - 1;
 }
 
-static inline void nvme_end_request(struct request *req, __le16 status,
-		union nvme_result result)
+/*
+ * Successful completions are added to @iob when blk-mq allows it and then
+ * finished by @complete; everything else goes through ->complete as usual.
+ */
+static inline void nvme_end_request_batch(struct request *req, __le16 status,
+		union nvme_result result, struct io_comp_batch *iob,
+		void (*complete)(struct io_comp_batch *))
 {
 	struct nvme_request *rq = nvme_req(req);
 
@@ -490,7 +498,14 @@ static inline void nvme_end_request(struct request *req, __le16 status,
 	rq->result = result;
 	/* inject error when permitted by fault injection framework */
 	nvme_should_fail(req);
-	blk_mq_complete_request(req);
+	if (rq->status || !blk_mq_add_to_batch(req, iob, complete))
+		blk_mq_complete_request(req);
+}
+
+static inline void nvme_end_request(struct request *req, __le16 status,
+		union nvme_result result)
+{
+	nvme_end_request_batch(req, status, result, NULL, NULL);
 }
 
 static inline void nvme_get_ctrl(struct nvme_ctrl *ctrl)
@@ -509,6 +524,7 @@ static inline bool nvme_is_aen_req(u16 qid, __u16 command_id)
 }
 
 void nvme_complete_rq(struct request *req);
+void nvme_complete_batch_req(struct request *req);
 bool nvme_cancel_request(struct request *req, void *data, bool reserved);
 bool nvme_change_ctrl_state(struct nvme_ctrl *ctrl,
 		enum nvme_ctrl_state new_state);
@@ -621,6 +637,34 @@ static inline void nvme_mpath_update_disk_size(struct gendisk *disk)
 	}
 }
 
+/*
+ * Count multipath I/O outstanding on each controller so that the
+ * queue-depth iopolicy can steer new I/O to the least busy path.
+ */
+static inline void nvme_mpath_start_request(struct request *req)
+{
+	struct nvme_ns *ns = req->q->queuedata;
+
+	if (!(req->cmd_flags & REQ_NVME_MPATH) ||
+	    (nvme_req(req)->flags & NVME_MPATH_CNT_ACTIVE))
+		return;
+	if (READ_ONCE(ns->head->subsys->iopolicy) != NVME_IOPOLICY_QD)
+		return;
+
+	atomic_inc(&ns->ctrl->nr_active);
+	nvme_req(req)->flags |= NVME_MPATH_CNT_ACTIVE;
+}
+
+static inline void nvme_mpath_end_request(struct request *req)
+{
+	struct nvme_ns *ns = req->q->queuedata;
+
+	if (nvme_req(req)->flags & NVME_MPATH_CNT_ACTIVE) {
+		atomic_dec_if_positive(&ns->ctrl->nr_active);
+		nvme_req(req)->flags &= ~NVME_MPATH_CNT_ACTIVE;
+	}
+}
+
 extern struct device_attribute dev_attr_ana_grpid;
 extern struct device_attribute dev_attr_ana_state;
 extern struct device_attribute subsys_attr_iopolicy;
@@ -699,6 +743,12 @@ static inline void nvme_mpath_start_freeze(struct nvme_subsystem *subsys)
 static inline void nvme_mpath_update_disk_size(struct gendisk *disk)
 {
 }
+static inline void nvme_mpath_start_request(struct request *req)
+{
+}
+static inline void nvme_mpath_end_request(struct request *req)
+{
+}
 #endif /* CONFIG_NVME_MULTIPATH */
 
 #ifdef CONFIG_NVM
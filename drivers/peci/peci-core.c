@@ -1219,6 +1219,141 @@ int peci_command(struct peci_adapter *adapter, enum peci_cmd cmd, void *vmsg)
 }
 EXPORT_SYMBOL_GPL(peci_command);
 
+static int peci_check_request(struct peci_request *req)
+{
+	if (req->cmd >= PECI_CMD_MAX || req->cmd < PECI_CMD_XFER)
+		return -ENOTTY;
+
+	if (!peci_cmd_fn[req->cmd])
+		return -EINVAL;
+
+	return 0;
+}
+
+/* precondition: adapter->bus_lock has been acquired. */
+static void peci_run_request(struct peci_adapter *adapter,
+			     struct peci_request *req)
+{
+	dev_dbg(&adapter->dev, "%s, cmd=0x%02x\n", __func__, req->cmd);
+
+	req->status = peci_check_cmd_support(adapter, req->cmd);
+	if (!req->status)
+		req->status = peci_cmd_fn[req->cmd](adapter, req->vmsg);
+}
+
+static void peci_queue_work(struct work_struct *work)
+{
+	struct peci_adapter *adapter = container_of(work, struct peci_adapter,
+						    queue_work);
+	struct peci_request *req, *next;
+	LIST_HEAD(pending);
+	LIST_HEAD(done);
+
+	for (;;) {
+		spin_lock_irq(&adapter->queue_lock);
+		list_splice_tail_init(&adapter->queue, &pending);
+		spin_unlock_irq(&adapter->queue_lock);
+
+		if (list_empty(&pending))
+			break;
+
+		/*
+		 * Issue everything queued so far back-to-back under a single
+		 * hold of the bus lock, then complete the requests once the
+		 * bus is free again.
+		 */
+		mutex_lock(&adapter->bus_lock);
+		list_for_each_entry_safe(req, next, &pending, node) {
+			peci_run_request(adapter, req);
+			list_move_tail(&req->node, &done);
+		}
+		mutex_unlock(&adapter->bus_lock);
+
+		list_for_each_entry_safe(req, next, &done, node) {
+			list_del_init(&req->node);
+			req->complete(req);
+		}
+	}
+}
+
+/**
+ * peci_command_async - queue a PECI command for asynchronous transfer
+ * @adapter: pointer to peci_adapter
+ * @req: request describing the command; @req->complete must be set
+ * Context: any
+ *
+ * Requests are issued in submission order from a work item, together with
+ * any other requests queued on the adapter in the meantime, and completed
+ * through @req->complete.
+ *
+ * Return: zero if the request was queued, else a negative error code, in
+ * which case @req->complete will not be called.
+ */
+int peci_command_async(struct peci_adapter *adapter, struct peci_request *req)
+{
+	unsigned long flags;
+	int ret;
+
+	if (!req->complete)
+		return -EINVAL;
+
+	ret = peci_check_request(req);
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&adapter->queue_lock, flags);
+	list_add_tail(&req->node, &adapter->queue);
+	spin_unlock_irqrestore(&adapter->queue_lock, flags);
+
+	schedule_work(&adapter->queue_work);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(peci_command_async);
+
+/**
+ * peci_command_batch - transfer a set of PECI commands in one pass
+ * @adapter: pointer to peci_adapter
+ * @reqs: array of requests
+ * @num: number of requests in @reqs
+ * Context: can sleep
+ *
+ * This issues all requests back-to-back while holding the bus once, which is
+ * cheaper than a peci_command() call per request when a client refreshes
+ * many sensors at a time. The result of each command is stored in its
+ * request's status field, and its complete callback, if set, is called once
+ * the whole batch has been transferred.
+ *
+ * Return: zero if all commands succeeded, else the first negative error code.
+ */
+int peci_command_batch(struct peci_adapter *adapter,
+		       struct peci_request *reqs, uint num)
+{
+	int ret = 0;
+	uint i;
+
+	for (i = 0; i < num; i++) {
+		reqs[i].status = peci_check_request(&reqs[i]);
+		if (reqs[i].status)
+			return reqs[i].status;
+	}
+
+	mutex_lock(&adapter->bus_lock);
+	for (i = 0; i < num; i++)
+		peci_run_request(adapter, &reqs[i]);
+	mutex_unlock(&adapter->bus_lock);
+
+	for (i = 0; i < num; i++) {
+		if (!ret)
+			ret = reqs[i].status;
+		if (reqs[i].complete)
+			reqs[i].complete(&reqs[i]);
+	}
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(peci_command_batch);
+
 static int peci_detect(struct peci_adapter *adapter, u8 addr)
 {
 	struct peci_ping_msg msg;
@@ -1855,6 +1990,9 @@ static int peci_register_adapter(struct peci_adapter *adapter)
 	mutex_init(&adapter->bus_lock);
 	mutex_init(&adapter->userspace_clients_lock);
 	INIT_LIST_HEAD(&adapter->userspace_clients);
+	spin_lock_init(&adapter->queue_lock);
+	INIT_LIST_HEAD(&adapter->queue);
+	INIT_WORK(&adapter->queue_work, peci_queue_work);
 
 	dev_set_name(&adapter->dev, "peci-%d", adapter->nr);
 
@@ -1980,6 +2118,9 @@ void peci_del_adapter(struct peci_adapter *adapter)
 	 */
 	device_for_each_child(&adapter->dev, NULL, peci_unregister_client);
 
+	/* Let requests queued by the clients run to completion. */
+	flush_work(&adapter->queue_work);
+
 	/* device name is gone after device_unregister */
 	dev_dbg(&adapter->dev, "adapter [%s] unregistered\n", adapter->name);
 
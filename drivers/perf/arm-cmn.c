@@ -0,0 +1,1282 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Perf driver for the Arm CMN-600 Coherent Mesh Network PMU
+ *
+ * Every crosspoint (XP) of the mesh has a Debug/Trace Monitor (DTM) with
+ * four 16-bit local counters, which can count events from the XP itself,
+ * from its watchpoints, or from the device nodes attached to its ports.
+ * Each local counter is paired with one of the eight 32-bit global
+ * counters of a Debug/Trace Controller (DTC), which accumulates its
+ * overflows and raises the overflow interrupt.
+ */
+
+#include <linux/acpi.h>
+#include <linux/bitfield.h>
+#include <linux/bitops.h>
+#include <linux/cpuhotplug.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/io-64-nonatomic-lo-hi.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/perf_event.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+
+#define DRVNAME				"arm-cmn"
+
+/* Common register stuff */
+#define CMN_NODE_INFO			0x0000
+#define CMN_NI_NODE_TYPE		GENMASK_ULL(15, 0)
+#define CMN_NI_NODE_ID			GENMASK_ULL(31, 16)
+#define CMN_NI_LOGICAL_ID		GENMASK_ULL(47, 32)
+
+#define CMN_NODEID_DEVID(reg)		((reg) & 3)
+#define CMN_NODEID_PID(reg)		(((reg) >> 2) & 1)
+
+#define CMN_CHILD_INFO			0x0080
+#define CMN_CI_CHILD_COUNT		GENMASK_ULL(15, 0)
+#define CMN_CI_CHILD_PTR_OFFSET		GENMASK_ULL(31, 16)
+
+#define CMN_CHILD_NODE_ADDR		GENMASK(27, 0)
+#define CMN_CHILD_NODE_EXTERNAL		BIT(31)
+
+/* PMU registers occupy the 3rd 4KB page of each node's 16KB space */
+#define CMN_PMU_OFFSET			0x2000
+
+/* For most nodes, this is all there is */
+#define CMN_PMU_EVENT_SEL		0x000
+#define CMN_PMU_EVENTn_ID_SHIFT(n)	((n) * 8)
+#define CMN_PMU_EVENTn_ID(n)		(0xffULL << CMN_PMU_EVENTn_ID_SHIFT(n))
+/* HN-F occupancy events filter on an ID shared by all counters */
+#define CMN_HNF_PMU_OCCUP1_ID		GENMASK_ULL(34, 32)
+
+/* DTMs live in the PMU space of XP registers */
+#define CMN_DTM_WPn(n)			(0x1a0 + (n) * 0x18)
+#define CMN_DTM_WPn_CONFIG(n)		(CMN_DTM_WPn(n) + 0x00)
+#define CMN_DTM_WPn_CONFIG_WP_EXCLUSIVE	BIT_ULL(5)
+#define CMN_DTM_WPn_CONFIG_WP_GRP	BIT_ULL(4)
+#define CMN_DTM_WPn_CONFIG_WP_CHN_SEL	GENMASK_ULL(3, 1)
+#define CMN_DTM_WPn_CONFIG_WP_DEV_SEL	BIT_ULL(0)
+#define CMN_DTM_WPn_VAL(n)		(CMN_DTM_WPn(n) + 0x08)
+#define CMN_DTM_WPn_MASK(n)		(CMN_DTM_WPn(n) + 0x10)
+#define CMN_DTM_NUM_WPS			4
+
+#define CMN_DTM_PMU_CONFIG		0x210
+#define CMN__PMEVCNTn_INPUT_SEL_SHIFT(n)	(32 + (n) * 8)
+#define CMN__PMEVCNTn_INPUT_SEL(n)	(0x3fULL << CMN__PMEVCNTn_INPUT_SEL_SHIFT(n))
+#define CMN__PMEVCNT0_INPUT_SEL_WP	0x00
+#define CMN__PMEVCNT0_INPUT_SEL_XP	0x04
+#define CMN__PMEVCNT0_INPUT_SEL_DEV	0x10
+#define CMN__PMEVCNTn_GLOBAL_NUM_SHIFT(n)	(16 + (n) * 4)
+#define CMN__PMEVCNTn_GLOBAL_NUM(n)	(0x7ULL << CMN__PMEVCNTn_GLOBAL_NUM_SHIFT(n))
+#define CMN__PMEVCNT_PAIRED(n)		BIT_ULL(4 + (n))
+#define CMN_DTM_PMU_CONFIG_PMU_EN	BIT_ULL(0)
+
+#define CMN_DTM_PMEVCNT			0x220
+#define CMN_DTM_NUM_COUNTERS		4
+
+/* The DTC node is where the magic happens */
+#define CMN_DT_DTC_CTL			0x0a00
+#define CMN_DT_DTC_CTL_DT_EN		BIT(0)
+
+/* DTC counters are paired in 64-bit registers on a 16-byte stride */
+#define _CMN_DT_CNT_REG(n)		((((n) / 2) * 4 + (n) % 2) * 4)
+#define CMN_DT_PMEVCNT(n)		(CMN_PMU_OFFSET + _CMN_DT_CNT_REG(n))
+#define CMN_DT_PMCCNTR			(CMN_PMU_OFFSET + 0x40)
+
+#define CMN_DT_PMCR			(CMN_PMU_OFFSET + 0x100)
+#define CMN_DT_PMCR_PMU_EN		BIT(0)
+#define CMN_DT_PMCR_OVFL_INTR_EN	BIT(6)
+
+#define CMN_DT_PMOVSR			(CMN_PMU_OFFSET + 0x118)
+#define CMN_DT_PMOVSR_CLR		(CMN_PMU_OFFSET + 0x120)
+
+#define CMN_DT_NUM_COUNTERS		8
+#define CMN_DT_CYCLES_IDX		CMN_DT_NUM_COUNTERS
+
+/*
+ * Even in the worst case a DTC counter can't wrap in fewer than 2^47
+ * events, so throwing away one bit to make overflow handling easy is no
+ * big deal. Similarly for the 40-bit cycle counter.
+ */
+#define CMN_COUNTER_INIT		0x80000000
+#define CMN_CC_INIT			0x8000000000ULL
+
+/* Event attributes */
+#define CMN_CONFIG_TYPE			GENMASK_ULL(15, 0)
+#define CMN_CONFIG_EVENTID		GENMASK_ULL(23, 16)
+#define CMN_CONFIG_OCCUPID		GENMASK_ULL(27, 24)
+#define CMN_CONFIG_BYNODEID		BIT_ULL(31)
+#define CMN_CONFIG_NODEID		GENMASK_ULL(47, 32)
+#define CMN_CONFIG_WP_DEV_SEL		BIT_ULL(48)
+#define CMN_CONFIG_WP_CHN_SEL		GENMASK_ULL(51, 49)
+#define CMN_CONFIG_WP_GRP		BIT_ULL(52)
+#define CMN_CONFIG_WP_EXCLUSIVE		BIT_ULL(53)
+
+#define CMN_EVENT_TYPE(event)		FIELD_GET(CMN_CONFIG_TYPE, (event)->attr.config)
+#define CMN_EVENT_EVENTID(event)	FIELD_GET(CMN_CONFIG_EVENTID, (event)->attr.config)
+#define CMN_EVENT_OCCUPID(event)	FIELD_GET(CMN_CONFIG_OCCUPID, (event)->attr.config)
+#define CMN_EVENT_BYNODEID(event)	FIELD_GET(CMN_CONFIG_BYNODEID, (event)->attr.config)
+#define CMN_EVENT_NODEID(event)		FIELD_GET(CMN_CONFIG_NODEID, (event)->attr.config)
+#define CMN_EVENT_WP_VAL(event)		((event)->attr.config1)
+#define CMN_EVENT_WP_MASK(event)	((event)->attr.config2)
+
+/* Watchpoint eventid: which pair of watchpoints to use */
+#define CMN_WP_UP			0
+#define CMN_WP_DOWN			1
+
+enum cmn_node_type {
+	CMN_TYPE_INVALID,
+	CMN_TYPE_DVM,
+	CMN_TYPE_CFG,
+	CMN_TYPE_DTC,
+	CMN_TYPE_HNI,
+	CMN_TYPE_HNF,
+	CMN_TYPE_XP,
+	CMN_TYPE_SBSX,
+	CMN_TYPE_RNI = 0xa,
+	CMN_TYPE_RND = 0xd,
+	CMN_TYPE_RNSAM = 0xf,
+	CMN_TYPE_CXRA = 0x100,
+	CMN_TYPE_CXHA = 0x101,
+	CMN_TYPE_CXLA = 0x102,
+	/* Not a real node type */
+	CMN_TYPE_WP = 0x7770
+};
+
+struct arm_cmn_node {
+	void __iomem *pmu_base;
+	u16 id, logid;
+	enum cmn_node_type type;
+	/* The XP this node hangs off, or the node itself for XPs */
+	struct arm_cmn_node *xp;
+	/* Shadow of CMN_PMU_EVENT_SEL */
+	u64 event_sel;
+
+	/* XP only: shadow of CMN_DTM_PMU_CONFIG and resource usage */
+	u64 pmu_config;
+	u8 dtm_used;
+	u8 wp_used;
+};
+
+struct arm_cmn_dtc {
+	struct arm_cmn *cmn;
+	void __iomem *base;
+	int irq;
+};
+
+struct arm_cmn {
+	struct device *dev;
+	void __iomem *base;
+
+	int num_xps;
+	struct arm_cmn_node *xps;
+	/* Other nodes, sorted by type then node ID */
+	int num_dns;
+	struct arm_cmn_node *dns;
+
+	int num_dtcs;
+	struct arm_cmn_dtc *dtc;
+	/*
+	 * The same global counter index is claimed on every DTC, so there is
+	 * no need to know which DTC domain each XP belongs to.
+	 */
+	unsigned long dtc_used;
+	struct perf_event *dtc_events[CMN_DT_NUM_COUNTERS + 1];
+
+	int cpu;
+	struct hlist_node cpuhp_node;
+
+	struct pmu pmu;
+};
+
+#define to_cmn(p)	container_of(p, struct arm_cmn, pmu)
+
+static int arm_cmn_hp_state;
+
+/*
+ * Per-event state, allocated by event_init since an event counts on every
+ * node of its type unless it asks for a specific one.
+ */
+struct arm_cmn_hw_event {
+	struct arm_cmn_node *dn;
+	int num_dns;
+	int dtc_idx;
+	/* Per node: DTM counter, and watchpoint in the upper nibble */
+	u8 dtm_idx[];
+};
+
+#define CMN_HW_DTM(v)			((v) & 0xf)
+#define CMN_HW_WP(v)			((v) >> 4)
+
+static struct arm_cmn_hw_event *to_cmn_hw(struct perf_event *event)
+{
+	return event->pmu_private;
+}
+
+static bool arm_cmn_is_xp_type(enum cmn_node_type type)
+{
+	return type == CMN_TYPE_XP || type == CMN_TYPE_WP;
+}
+
+/* Find the nodes of a type, or the one with a given ID if nodeid is >= 0 */
+static struct arm_cmn_node *arm_cmn_find_nodes(struct arm_cmn *cmn,
+					       enum cmn_node_type type,
+					       int nodeid, int *num)
+{
+	struct arm_cmn_node *dn, *first = NULL;
+	int i, cnt, count = 0;
+
+	if (arm_cmn_is_xp_type(type)) {
+		dn = cmn->xps;
+		cnt = cmn->num_xps;
+		type = CMN_TYPE_XP;
+	} else {
+		dn = cmn->dns;
+		cnt = cmn->num_dns;
+	}
+
+	for (i = 0; i < cnt; i++, dn++) {
+		if (dn->type != type)
+			continue;
+		if (nodeid >= 0 && dn->id != nodeid)
+			continue;
+		if (!first)
+			first = dn;
+		count++;
+	}
+
+	*num = count;
+	return first;
+}
+
+struct arm_cmn_event_attr {
+	struct device_attribute attr;
+	enum cmn_node_type type;
+	u8 eventid;
+	u8 occupid;
+};
+
+static ssize_t arm_cmn_event_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct arm_cmn_event_attr *eattr;
+
+	eattr = container_of(attr, typeof(*eattr), attr);
+
+	if (eattr->type == CMN_TYPE_DTC)
+		return snprintf(buf, PAGE_SIZE, "type=0x%x\n", eattr->type);
+
+	if (eattr->type == CMN_TYPE_WP)
+		return snprintf(buf, PAGE_SIZE,
+				"type=0x%x,eventid=0x%x,wp_dev_sel=?,wp_chn_sel=?,wp_grp=?,wp_exclusive=?,wp_val=?,wp_mask=?\n",
+				eattr->type, eattr->eventid);
+
+	if (eattr->occupid)
+		return snprintf(buf, PAGE_SIZE,
+				"type=0x%x,eventid=0x%x,occupid=0x%x\n",
+				eattr->type, eattr->eventid, eattr->occupid);
+
+	return snprintf(buf, PAGE_SIZE, "type=0x%x,eventid=0x%x\n",
+			eattr->type, eattr->eventid);
+}
+
+static umode_t arm_cmn_event_attr_is_visible(struct kobject *kobj,
+					     struct attribute *attr,
+					     int unused)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct arm_cmn *cmn = to_cmn(dev_get_drvdata(dev));
+	struct arm_cmn_event_attr *eattr;
+	int num;
+
+	eattr = container_of(attr, typeof(*eattr), attr.attr);
+
+	arm_cmn_find_nodes(cmn, eattr->type, -1, &num);
+	return num ? attr->mode : 0;
+}
+
+#define _CMN_EVENT_ATTR(_name, _type, _eventid, _occupid)		\
+	(&((struct arm_cmn_event_attr[]) {{				\
+		.attr = __ATTR(_name, 0444, arm_cmn_event_show, NULL),	\
+		.type = _type,						\
+		.eventid = _eventid,					\
+		.occupid = _occupid,					\
+	}})[0].attr.attr)
+#define CMN_EVENT_ATTR(_name, _type, _eventid)				\
+	_CMN_EVENT_ATTR(_name, _type, _eventid, 0)
+
+#define CMN_EVENT_DTC(_name)						\
+	CMN_EVENT_ATTR(dtc_##_name, CMN_TYPE_DTC, 0)
+#define CMN_EVENT_HNF(_name, _event)					\
+	CMN_EVENT_ATTR(hnf_##_name, CMN_TYPE_HNF, _event)
+#define _CMN_EVENT_HNF(_name, _event, _occupid)				\
+	_CMN_EVENT_ATTR(hnf_##_name, CMN_TYPE_HNF, _event, _occupid)
+#define CMN_EVENT_RNID(_name, _event)					\
+	CMN_EVENT_ATTR(rnid_##_name, CMN_TYPE_RNI, _event)
+#define CMN_EVENT_WP(_name, _event)					\
+	CMN_EVENT_ATTR(watchpoint_##_name, CMN_TYPE_WP, _event)
+
+/*
+ * XP events select a port (E, W, N, S, device port 0 or 1) in bits [4:2]
+ * and a channel (REQ, RSP, SNP, DAT) in bits [7:5] of the event ID.
+ */
+#define __CMN_EVENT_XP(_name, _event)					\
+	CMN_EVENT_ATTR(mxp_##_name, CMN_TYPE_XP, _event)
+
+#define _CMN_EVENT_XP(_name, _event)					\
+	__CMN_EVENT_XP(e_##_name, (_event) | (0 << 2)),			\
+	__CMN_EVENT_XP(w_##_name, (_event) | (1 << 2)),			\
+	__CMN_EVENT_XP(n_##_name, (_event) | (2 << 2)),			\
+	__CMN_EVENT_XP(s_##_name, (_event) | (3 << 2)),			\
+	__CMN_EVENT_XP(p0_##_name, (_event) | (4 << 2)),		\
+	__CMN_EVENT_XP(p1_##_name, (_event) | (5 << 2))
+
+#define CMN_EVENT_XP(_name, _event)					\
+	_CMN_EVENT_XP(req_##_name, (_event) | (0 << 5)),		\
+	_CMN_EVENT_XP(rsp_##_name, (_event) | (1 << 5)),		\
+	_CMN_EVENT_XP(snp_##_name, (_event) | (2 << 5)),		\
+	_CMN_EVENT_XP(dat_##_name, (_event) | (3 << 5))
+
+static struct attribute *arm_cmn_event_attrs[] = {
+	CMN_EVENT_DTC(cycles),
+
+	CMN_EVENT_XP(txflit_valid,		0x01),
+	CMN_EVENT_XP(txflit_stall,		0x02),
+	CMN_EVENT_XP(partial_dat_flit,		0x03),
+
+	CMN_EVENT_WP(up,			CMN_WP_UP),
+	CMN_EVENT_WP(down,			CMN_WP_DOWN),
+
+	CMN_EVENT_HNF(cache_miss,		0x01),
+	CMN_EVENT_HNF(slc_sf_cache_access,	0x02),
+	CMN_EVENT_HNF(cache_fill,		0x03),
+	CMN_EVENT_HNF(pocq_retry,		0x04),
+	CMN_EVENT_HNF(pocq_reqs_recvd,		0x05),
+	CMN_EVENT_HNF(sf_hit,			0x06),
+	CMN_EVENT_HNF(sf_evictions,		0x07),
+	CMN_EVENT_HNF(dir_snoops_sent,		0x08),
+	CMN_EVENT_HNF(brd_snoops_sent,		0x09),
+	CMN_EVENT_HNF(slc_eviction,		0x0a),
+	CMN_EVENT_HNF(slc_fill_invalid_way,	0x0b),
+	CMN_EVENT_HNF(mc_retries,		0x0c),
+	CMN_EVENT_HNF(mc_reqs,			0x0d),
+	CMN_EVENT_HNF(qos_hh_retry,		0x0e),
+	_CMN_EVENT_HNF(qos_pocq_occupancy_all,	0x0f, 0),
+	_CMN_EVENT_HNF(qos_pocq_occupancy_read,	0x0f, 1),
+	_CMN_EVENT_HNF(qos_pocq_occupancy_write, 0x0f, 2),
+	_CMN_EVENT_HNF(qos_pocq_occupancy_atomic, 0x0f, 3),
+	_CMN_EVENT_HNF(qos_pocq_occupancy_stash, 0x0f, 4),
+	CMN_EVENT_HNF(pocq_addrhaz,		0x10),
+	CMN_EVENT_HNF(pocq_atomic_addrhaz,	0x11),
+	CMN_EVENT_HNF(ld_st_swp_adq_full,	0x12),
+	CMN_EVENT_HNF(cmp_adq_full,		0x13),
+	CMN_EVENT_HNF(txdat_stall,		0x14),
+	CMN_EVENT_HNF(txrsp_stall,		0x15),
+	CMN_EVENT_HNF(seq_full,			0x16),
+	CMN_EVENT_HNF(seq_hit,			0x17),
+	CMN_EVENT_HNF(snp_sent,			0x18),
+	CMN_EVENT_HNF(sfbi_dir_snp_sent,	0x19),
+	CMN_EVENT_HNF(sfbi_brd_snp_sent,	0x1a),
+	CMN_EVENT_HNF(snp_sent_untrk,		0x1b),
+	CMN_EVENT_HNF(intv_dirty,		0x1c),
+	CMN_EVENT_HNF(stash_snp_sent,		0x1d),
+	CMN_EVENT_HNF(stash_data_pull,		0x1e),
+	CMN_EVENT_HNF(snp_fwded,		0x1f),
+
+	CMN_EVENT_RNID(s0_rdata_beats,		0x01),
+	CMN_EVENT_RNID(s1_rdata_beats,		0x02),
+	CMN_EVENT_RNID(s2_rdata_beats,		0x03),
+	CMN_EVENT_RNID(rxdat_flits,		0x04),
+	CMN_EVENT_RNID(txdat_flits,		0x05),
+	CMN_EVENT_RNID(txreq_flits_total,	0x06),
+	CMN_EVENT_RNID(txreq_flits_retried,	0x07),
+	CMN_EVENT_RNID(rrt_occ_ovfl,		0x08),
+	CMN_EVENT_RNID(wrt_occ_ovfl,		0x09),
+	CMN_EVENT_RNID(txreq_flits_replayed,	0x0a),
+	CMN_EVENT_RNID(wrcancel_sent,		0x0b),
+	CMN_EVENT_RNID(s0_wdata_beats,		0x0c),
+	CMN_EVENT_RNID(s1_wdata_beats,		0x0d),
+	CMN_EVENT_RNID(s2_wdata_beats,		0x0e),
+	CMN_EVENT_RNID(rrt_alloc,		0x0f),
+	CMN_EVENT_RNID(wrt_alloc,		0x10),
+	CMN_EVENT_RNID(rdb_unord,		0x11),
+	CMN_EVENT_RNID(rdb_replay,		0x12),
+	CMN_EVENT_RNID(rdb_hybrid,		0x13),
+	CMN_EVENT_RNID(rdb_ord,			0x14),
+
+	NULL
+};
+
+static const struct attribute_group arm_cmn_event_attrs_group = {
+	.name = "events",
+	.attrs = arm_cmn_event_attrs,
+	.is_visible = arm_cmn_event_attr_is_visible,
+};
+
+PMU_FORMAT_ATTR(type,		"config:0-15");
+PMU_FORMAT_ATTR(eventid,	"config:16-23");
+PMU_FORMAT_ATTR(occupid,	"config:24-27");
+PMU_FORMAT_ATTR(bynodeid,	"config:31");
+PMU_FORMAT_ATTR(nodeid,		"config:32-47");
+PMU_FORMAT_ATTR(wp_dev_sel,	"config:48");
+PMU_FORMAT_ATTR(wp_chn_sel,	"config:49-51");
+PMU_FORMAT_ATTR(wp_grp,		"config:52");
+PMU_FORMAT_ATTR(wp_exclusive,	"config:53");
+PMU_FORMAT_ATTR(wp_val,		"config1:0-63");
+PMU_FORMAT_ATTR(wp_mask,	"config2:0-63");
+
+static struct attribute *arm_cmn_format_attrs[] = {
+	&format_attr_type.attr,
+	&format_attr_eventid.attr,
+	&format_attr_occupid.attr,
+	&format_attr_bynodeid.attr,
+	&format_attr_nodeid.attr,
+	&format_attr_wp_dev_sel.attr,
+	&format_attr_wp_chn_sel.attr,
+	&format_attr_wp_grp.attr,
+	&format_attr_wp_exclusive.attr,
+	&format_attr_wp_val.attr,
+	&format_attr_wp_mask.attr,
+	NULL
+};
+
+static const struct attribute_group arm_cmn_format_attrs_group = {
+	.name = "format",
+	.attrs = arm_cmn_format_attrs,
+};
+
+static ssize_t arm_cmn_cpumask_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct arm_cmn *cmn = to_cmn(dev_get_drvdata(dev));
+
+	return cpumap_print_to_pagebuf(true, buf, cpumask_of(cmn->cpu));
+}
+
+static struct device_attribute arm_cmn_cpumask_attr =
+		__ATTR(cpumask, 0444, arm_cmn_cpumask_show, NULL);
+
+static struct attribute *arm_cmn_cpumask_attrs[] = {
+	&arm_cmn_cpumask_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group arm_cmn_cpumask_attr_group = {
+	.attrs = arm_cmn_cpumask_attrs,
+};
+
+static const struct attribute_group *arm_cmn_attr_groups[] = {
+	&arm_cmn_event_attrs_group,
+	&arm_cmn_format_attrs_group,
+	&arm_cmn_cpumask_attr_group,
+	NULL
+};
+
+static u64 arm_cmn_read_dtm(struct arm_cmn_hw_event *hw)
+{
+	u64 val = 0;
+	int i;
+
+	for (i = 0; i < hw->num_dns; i++) {
+		struct arm_cmn_node *xp = hw->dn[i].xp;
+		int dtm = CMN_HW_DTM(hw->dtm_idx[i]);
+		u64 reg = readq_relaxed(xp->pmu_base + CMN_DTM_PMEVCNT);
+
+		val += (u16)(reg >> (dtm * 16));
+	}
+	return val;
+}
+
+static u64 arm_cmn_read_cc(struct arm_cmn_dtc *dtc)
+{
+	u64 val = readq_relaxed(dtc->base + CMN_DT_PMCCNTR);
+
+	writeq_relaxed(CMN_CC_INIT, dtc->base + CMN_DT_PMCCNTR);
+	return (val - CMN_CC_INIT) & ((CMN_CC_INIT << 1) - 1);
+}
+
+static u32 arm_cmn_read_counter(struct arm_cmn_dtc *dtc, int idx)
+{
+	u32 val, pmevcnt = CMN_DT_PMEVCNT(idx);
+
+	val = readl_relaxed(dtc->base + pmevcnt);
+	writel_relaxed(CMN_COUNTER_INIT, dtc->base + pmevcnt);
+	return val - CMN_COUNTER_INIT;
+}
+
+static void arm_cmn_event_read(struct perf_event *event)
+{
+	struct arm_cmn *cmn = to_cmn(event->pmu);
+	struct arm_cmn_hw_event *hw = to_cmn_hw(event);
+	u64 delta, new, prev;
+	int i;
+
+	if (hw->dtc_idx == CMN_DT_CYCLES_IDX) {
+		delta = arm_cmn_read_cc(&cmn->dtc[0]);
+		local64_add(delta, &event->count);
+		return;
+	}
+
+	/*
+	 * The DTM counters hold the low 16 bits, their DTC counter counts
+	 * how many times they wrapped.
+	 */
+	new = arm_cmn_read_dtm(hw);
+	prev = local64_xchg(&event->hw.prev_count, new);
+	delta = new - prev;
+
+	for (i = 0; i < cmn->num_dtcs; i++)
+		delta += (u64)arm_cmn_read_counter(&cmn->dtc[i],
+						   hw->dtc_idx) << 16;
+
+	local64_add(delta, &event->count);
+}
+
+static void arm_cmn_pmu_enable(struct pmu *pmu)
+{
+	struct arm_cmn *cmn = to_cmn(pmu);
+	int i;
+
+	for (i = 0; i < cmn->num_dtcs; i++)
+		writel_relaxed(CMN_DT_PMCR_PMU_EN | CMN_DT_PMCR_OVFL_INTR_EN,
+			       cmn->dtc[i].base + CMN_DT_PMCR);
+}
+
+static void arm_cmn_pmu_disable(struct pmu *pmu)
+{
+	struct arm_cmn *cmn = to_cmn(pmu);
+	int i;
+
+	for (i = 0; i < cmn->num_dtcs; i++)
+		writel_relaxed(CMN_DT_PMCR_OVFL_INTR_EN,
+			       cmn->dtc[i].base + CMN_DT_PMCR);
+}
+
+static void arm_cmn_set_wp(struct arm_cmn_node *xp, int wp, u64 config,
+			   u64 val, u64 mask)
+{
+	writeq_relaxed(config, xp->pmu_base + CMN_DTM_WPn_CONFIG(wp));
+	writeq_relaxed(val, xp->pmu_base + CMN_DTM_WPn_VAL(wp));
+	writeq_relaxed(mask, xp->pmu_base + CMN_DTM_WPn_MASK(wp));
+}
+
+/* A watchpoint with a zero mask against an all-ones value never matches */
+static void arm_cmn_clear_wp(struct arm_cmn_node *xp, int wp)
+{
+	arm_cmn_set_wp(xp, wp, 0, ~0ULL, 0);
+}
+
+static u64 arm_cmn_wp_config(struct perf_event *event)
+{
+	u64 config = event->attr.config;
+
+	return FIELD_PREP(CMN_DTM_WPn_CONFIG_WP_DEV_SEL,
+			  FIELD_GET(CMN_CONFIG_WP_DEV_SEL, config)) |
+	       FIELD_PREP(CMN_DTM_WPn_CONFIG_WP_CHN_SEL,
+			  FIELD_GET(CMN_CONFIG_WP_CHN_SEL, config)) |
+	       FIELD_PREP(CMN_DTM_WPn_CONFIG_WP_GRP,
+			  FIELD_GET(CMN_CONFIG_WP_GRP, config)) |
+	       FIELD_PREP(CMN_DTM_WPn_CONFIG_WP_EXCLUSIVE,
+			  FIELD_GET(CMN_CONFIG_WP_EXCLUSIVE, config));
+}
+
+static void arm_cmn_event_start(struct perf_event *event, int flags)
+{
+	struct arm_cmn *cmn = to_cmn(event->pmu);
+	struct arm_cmn_hw_event *hw = to_cmn_hw(event);
+	enum cmn_node_type type = CMN_EVENT_TYPE(event);
+	int i;
+
+	if (hw->dtc_idx == CMN_DT_CYCLES_IDX) {
+		writeq_relaxed(CMN_CC_INIT, cmn->dtc[0].base + CMN_DT_PMCCNTR);
+		event->hw.state = 0;
+		return;
+	}
+
+	for (i = 0; i < cmn->num_dtcs; i++)
+		writel_relaxed(CMN_COUNTER_INIT,
+			       cmn->dtc[i].base + CMN_DT_PMEVCNT(hw->dtc_idx));
+	local64_set(&event->hw.prev_count, arm_cmn_read_dtm(hw));
+
+	for (i = 0; i < hw->num_dns; i++) {
+		struct arm_cmn_node *dn = hw->dn + i;
+		int dtm = CMN_HW_DTM(hw->dtm_idx[i]);
+
+		if (type == CMN_TYPE_WP) {
+			arm_cmn_set_wp(dn, CMN_HW_WP(hw->dtm_idx[i]),
+				       arm_cmn_wp_config(event),
+				       CMN_EVENT_WP_VAL(event),
+				       CMN_EVENT_WP_MASK(event));
+			continue;
+		}
+
+		dn->event_sel &= ~CMN_PMU_EVENTn_ID(dtm);
+		dn->event_sel |= (u64)CMN_EVENT_EVENTID(event) <<
+				 CMN_PMU_EVENTn_ID_SHIFT(dtm);
+		if (type == CMN_TYPE_HNF)
+			u64p_replace_bits(&dn->event_sel,
+					  CMN_EVENT_OCCUPID(event),
+					  CMN_HNF_PMU_OCCUP1_ID);
+		writeq_relaxed(dn->event_sel, dn->pmu_base + CMN_PMU_EVENT_SEL);
+	}
+
+	event->hw.state = 0;
+}
+
+static void arm_cmn_event_stop(struct perf_event *event, int flags)
+{
+	struct arm_cmn_hw_event *hw = to_cmn_hw(event);
+	enum cmn_node_type type = CMN_EVENT_TYPE(event);
+	int i;
+
+	if (event->hw.state & PERF_HES_STOPPED)
+		return;
+
+	if (hw->dtc_idx != CMN_DT_CYCLES_IDX) {
+		for (i = 0; i < hw->num_dns; i++) {
+			struct arm_cmn_node *dn = hw->dn + i;
+			int dtm = CMN_HW_DTM(hw->dtm_idx[i]);
+
+			if (type == CMN_TYPE_WP) {
+				arm_cmn_clear_wp(dn, CMN_HW_WP(hw->dtm_idx[i]));
+				continue;
+			}
+
+			dn->event_sel &= ~CMN_PMU_EVENTn_ID(dtm);
+			writeq_relaxed(dn->event_sel,
+				       dn->pmu_base + CMN_PMU_EVENT_SEL);
+		}
+	}
+
+	event->hw.state |= PERF_HES_STOPPED;
+	if (flags & PERF_EF_UPDATE) {
+		arm_cmn_event_read(event);
+		event->hw.state |= PERF_HES_UPTODATE;
+	}
+}
+
+static void arm_cmn_config_dtm(struct arm_cmn_node *xp, int dtm,
+			       u64 input_sel, int dtc_idx)
+{
+	xp->pmu_config &= ~(CMN__PMEVCNTn_INPUT_SEL(dtm) |
+			    CMN__PMEVCNTn_GLOBAL_NUM(dtm) |
+			    CMN__PMEVCNT_PAIRED(dtm));
+	if (dtc_idx >= 0)
+		xp->pmu_config |= input_sel << CMN__PMEVCNTn_INPUT_SEL_SHIFT(dtm) |
+				  (u64)dtc_idx << CMN__PMEVCNTn_GLOBAL_NUM_SHIFT(dtm) |
+				  CMN__PMEVCNT_PAIRED(dtm);
+	writeq_relaxed(xp->pmu_config, xp->pmu_base + CMN_DTM_PMU_CONFIG);
+}
+
+static void arm_cmn_event_clear(struct perf_event *event, int num)
+{
+	struct arm_cmn_hw_event *hw = to_cmn_hw(event);
+	enum cmn_node_type type = CMN_EVENT_TYPE(event);
+	int i;
+
+	for (i = 0; i < num; i++) {
+		struct arm_cmn_node *xp = hw->dn[i].xp;
+		int dtm = CMN_HW_DTM(hw->dtm_idx[i]);
+
+		arm_cmn_config_dtm(xp, dtm, 0, -1);
+		xp->dtm_used &= ~BIT(dtm);
+		if (type == CMN_TYPE_WP)
+			xp->wp_used &= ~BIT(CMN_HW_WP(hw->dtm_idx[i]));
+	}
+}
+
+static int arm_cmn_event_add(struct perf_event *event, int flags)
+{
+	struct arm_cmn *cmn = to_cmn(event->pmu);
+	struct arm_cmn_hw_event *hw = to_cmn_hw(event);
+	enum cmn_node_type type = CMN_EVENT_TYPE(event);
+	int i, dtc_idx;
+
+	if (type == CMN_TYPE_DTC) {
+		if (cmn->dtc_events[CMN_DT_CYCLES_IDX])
+			return -ENOSPC;
+		dtc_idx = CMN_DT_CYCLES_IDX;
+		goto done;
+	}
+
+	dtc_idx = find_first_zero_bit(&cmn->dtc_used, CMN_DT_NUM_COUNTERS);
+	if (dtc_idx == CMN_DT_NUM_COUNTERS)
+		return -ENOSPC;
+
+	for (i = 0; i < hw->num_dns; i++) {
+		struct arm_cmn_node *dn = hw->dn + i;
+		struct arm_cmn_node *xp = dn->xp;
+		u64 input_sel;
+		int dtm, wp = 0;
+
+		dtm = ffz(xp->dtm_used);
+		if (dtm >= CMN_DTM_NUM_COUNTERS)
+			goto free_dtms;
+
+		if (type == CMN_TYPE_WP) {
+			/* Watchpoints 0-1 see uploads, 2-3 downloads */
+			wp = CMN_EVENT_EVENTID(event) == CMN_WP_DOWN ? 2 : 0;
+			if (xp->wp_used & BIT(wp))
+				wp++;
+			if (xp->wp_used & BIT(wp))
+				goto free_dtms;
+			xp->wp_used |= BIT(wp);
+			input_sel = CMN__PMEVCNT0_INPUT_SEL_WP + wp;
+		} else if (type == CMN_TYPE_XP) {
+			input_sel = CMN__PMEVCNT0_INPUT_SEL_XP + dtm;
+		} else {
+			input_sel = CMN__PMEVCNT0_INPUT_SEL_DEV + dtm +
+				    (CMN_NODEID_PID(dn->id) << 4) +
+				    (CMN_NODEID_DEVID(dn->id) << 2);
+		}
+
+		xp->dtm_used |= BIT(dtm);
+		hw->dtm_idx[i] = dtm | wp << 4;
+		arm_cmn_config_dtm(xp, dtm, input_sel, dtc_idx);
+	}
+
+	set_bit(dtc_idx, &cmn->dtc_used);
+done:
+	hw->dtc_idx = dtc_idx;
+	cmn->dtc_events[dtc_idx] = event;
+
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+	if (flags & PERF_EF_START)
+		arm_cmn_event_start(event, 0);
+
+	return 0;
+
+free_dtms:
+	arm_cmn_event_clear(event, i);
+	return -ENOSPC;
+}
+
+static void arm_cmn_event_del(struct perf_event *event, int flags)
+{
+	struct arm_cmn *cmn = to_cmn(event->pmu);
+	struct arm_cmn_hw_event *hw = to_cmn_hw(event);
+
+	arm_cmn_event_stop(event, PERF_EF_UPDATE);
+
+	if (hw->dtc_idx != CMN_DT_CYCLES_IDX) {
+		arm_cmn_event_clear(event, hw->num_dns);
+		clear_bit(hw->dtc_idx, &cmn->dtc_used);
+	}
+	cmn->dtc_events[hw->dtc_idx] = NULL;
+}
+
+static bool arm_cmn_validate_group(struct perf_event *event)
+{
+	struct perf_event *sibling, *leader = event->group_leader;
+	int counters = 0, cycles = 0;
+
+	if (leader == event)
+		return true;
+
+	if (leader->pmu != event->pmu && !is_software_event(leader))
+		return false;
+
+	/* Only the DTC counters are checked, DTMs are each XP's own */
+	for_each_sibling_event(sibling, leader) {
+		if (sibling->pmu != event->pmu)
+			continue;
+		if (CMN_EVENT_TYPE(sibling) == CMN_TYPE_DTC)
+			cycles++;
+		else
+			counters++;
+	}
+	if (leader->pmu == event->pmu) {
+		if (CMN_EVENT_TYPE(leader) == CMN_TYPE_DTC)
+			cycles++;
+		else
+			counters++;
+	}
+	if (CMN_EVENT_TYPE(event) == CMN_TYPE_DTC)
+		cycles++;
+	else
+		counters++;
+
+	return counters <= CMN_DT_NUM_COUNTERS && cycles <= 1;
+}
+
+static void arm_cmn_event_destroy(struct perf_event *event)
+{
+	kfree(event->pmu_private);
+}
+
+static int arm_cmn_event_init(struct perf_event *event)
+{
+	struct arm_cmn *cmn = to_cmn(event->pmu);
+	struct arm_cmn_hw_event *hw;
+	enum cmn_node_type type;
+	struct arm_cmn_node *dn;
+	int nodeid = -1, num;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+		return -EINVAL;
+
+	event->cpu = cmn->cpu;
+	if (event->cpu < 0)
+		return -EINVAL;
+
+	type = CMN_EVENT_TYPE(event);
+	if (type == CMN_TYPE_DTC) {
+		dn = NULL;
+		num = 0;
+	} else {
+		if (type == CMN_TYPE_WP &&
+		    CMN_EVENT_EVENTID(event) > CMN_WP_DOWN)
+			return -EINVAL;
+
+		if (CMN_EVENT_BYNODEID(event))
+			nodeid = CMN_EVENT_NODEID(event);
+
+		dn = arm_cmn_find_nodes(cmn, type, nodeid, &num);
+		if (!dn) {
+			dev_dbg(cmn->dev, "invalid node type 0x%x / id 0x%x\n",
+				type, nodeid);
+			return -EINVAL;
+		}
+	}
+
+	if (!arm_cmn_validate_group(event))
+		return -EINVAL;
+
+	hw = kzalloc(struct_size(hw, dtm_idx, num), GFP_KERNEL);
+	if (!hw)
+		return -ENOMEM;
+
+	hw->dn = dn;
+	hw->num_dns = num;
+	event->pmu_private = hw;
+	event->destroy = arm_cmn_event_destroy;
+
+	return 0;
+}
+
+static irqreturn_t arm_cmn_handle_irq(int irq, void *dev_id)
+{
+	struct arm_cmn_dtc *dtc = dev_id;
+	struct arm_cmn *cmn = dtc->cmn;
+	unsigned long status;
+	int i;
+
+	status = readl_relaxed(dtc->base + CMN_DT_PMOVSR);
+	if (!status)
+		return IRQ_NONE;
+
+	for_each_set_bit(i, &status, CMN_DT_NUM_COUNTERS + 1) {
+		struct perf_event *event = cmn->dtc_events[i];
+
+		if (event)
+			arm_cmn_event_read(event);
+	}
+
+	writel_relaxed(status, dtc->base + CMN_DT_PMOVSR_CLR);
+	return IRQ_HANDLED;
+}
+
+static void arm_cmn_migrate(struct arm_cmn *cmn, unsigned int cpu)
+{
+	int i;
+
+	perf_pmu_migrate_context(&cmn->pmu, cmn->cpu, cpu);
+	for (i = 0; i < cmn->num_dtcs; i++)
+		irq_set_affinity_hint(cmn->dtc[i].irq, cpumask_of(cpu));
+	cmn->cpu = cpu;
+}
+
+static int arm_cmn_pmu_offline_cpu(unsigned int cpu, struct hlist_node *node)
+{
+	struct arm_cmn *cmn;
+	unsigned int target;
+
+	cmn = hlist_entry_safe(node, struct arm_cmn, cpuhp_node);
+	if (cpu != cmn->cpu)
+		return 0;
+
+	target = cpumask_any_but(cpu_online_mask, cpu);
+	if (target < nr_cpu_ids)
+		arm_cmn_migrate(cmn, target);
+	return 0;
+}
+
+static void arm_cmn_init_node_info(struct arm_cmn *cmn, u32 offset,
+				   struct arm_cmn_node *node)
+{
+	u64 reg = readq_relaxed(cmn->base + offset + CMN_NODE_INFO);
+
+	node->type = FIELD_GET(CMN_NI_NODE_TYPE, reg);
+	node->id = FIELD_GET(CMN_NI_NODE_ID, reg);
+	node->logid = FIELD_GET(CMN_NI_LOGICAL_ID, reg);
+	node->pmu_base = cmn->base + offset + CMN_PMU_OFFSET;
+
+	dev_dbg(cmn->dev, "node type %04hx id %04hx logid %04hx at %08x\n",
+		node->type, node->id, node->logid, offset);
+}
+
+static void arm_cmn_init_dtm(struct arm_cmn_node *xp)
+{
+	int i;
+
+	for (i = 0; i < CMN_DTM_NUM_WPS; i++)
+		arm_cmn_clear_wp(xp, i);
+
+	xp->pmu_config = CMN_DTM_PMU_CONFIG_PMU_EN;
+	writeq_relaxed(xp->pmu_config, xp->pmu_base + CMN_DTM_PMU_CONFIG);
+}
+
+static int arm_cmn_node_cmp(const void *a, const void *b)
+{
+	const struct arm_cmn_node *dna = a, *dnb = b;
+
+	if (dna->type != dnb->type)
+		return dna->type - dnb->type;
+	return dna->id - dnb->id;
+}
+
+static int arm_cmn_discover(struct arm_cmn *cmn, unsigned int rgn_offset)
+{
+	void __iomem *cfg_region = cmn->base + rgn_offset;
+	struct arm_cmn_node cfg, *dn;
+	u16 child_count, child_poff;
+	int i, j, num_dns = 0;
+	u64 reg;
+
+	arm_cmn_init_node_info(cmn, rgn_offset, &cfg);
+	if (cfg.type != CMN_TYPE_CFG)
+		return -ENODEV;
+
+	reg = readq_relaxed(cfg_region + CMN_CHILD_INFO);
+	child_count = FIELD_GET(CMN_CI_CHILD_COUNT, reg);
+	child_poff = FIELD_GET(CMN_CI_CHILD_PTR_OFFSET, reg);
+
+	cmn->num_xps = child_count;
+	cmn->xps = devm_kcalloc(cmn->dev, cmn->num_xps, sizeof(*cmn->xps),
+				GFP_KERNEL);
+	if (!cmn->xps)
+		return -ENOMEM;
+
+	/* Pass 1: visit the XPs, enumerate their children */
+	for (i = 0; i < cmn->num_xps; i++) {
+		struct arm_cmn_node *xp = cmn->xps + i;
+		u32 xp_offset;
+
+		reg = readq_relaxed(cfg_region + child_poff + i * 8);
+		xp_offset = reg & CMN_CHILD_NODE_ADDR;
+
+		arm_cmn_init_node_info(cmn, xp_offset, xp);
+		if (xp->type != CMN_TYPE_XP)
+			return -ENODEV;
+		xp->xp = xp;
+		arm_cmn_init_dtm(xp);
+
+		reg = readq_relaxed(cmn->base + xp_offset + CMN_CHILD_INFO);
+		num_dns += FIELD_GET(CMN_CI_CHILD_COUNT, reg);
+	}
+
+	cmn->dns = devm_kcalloc(cmn->dev, num_dns, sizeof(*cmn->dns),
+				GFP_KERNEL);
+	if (!cmn->dns)
+		return -ENOMEM;
+
+	/* Pass 2: now we can actually populate the nodes */
+	dn = cmn->dns;
+	for (i = 0; i < cmn->num_xps; i++) {
+		struct arm_cmn_node *xp = cmn->xps + i;
+		void __iomem *xp_region = xp->pmu_base - CMN_PMU_OFFSET;
+
+		reg = readq_relaxed(xp_region + CMN_CHILD_INFO);
+		child_count = FIELD_GET(CMN_CI_CHILD_COUNT, reg);
+		child_poff = FIELD_GET(CMN_CI_CHILD_PTR_OFFSET, reg);
+
+		for (j = 0; j < child_count; j++) {
+			reg = readq_relaxed(xp_region + child_poff + j * 8);
+			/*
+			 * Don't even try to touch anything external, since in
+			 * general we haven't a clue how to power up arbitrary
+			 * CHI requesters.
+			 */
+			if (reg & CMN_CHILD_NODE_EXTERNAL) {
+				dev_dbg(cmn->dev, "ignoring external node %llx\n",
+					reg);
+				continue;
+			}
+
+			arm_cmn_init_node_info(cmn, reg & CMN_CHILD_NODE_ADDR, dn);
+			dn->xp = xp;
+
+			switch (dn->type) {
+			case CMN_TYPE_DTC:
+				cmn->num_dtcs++;
+				dn++;
+				break;
+			/* To the PMU, RN-Ds don't add anything over RN-Is */
+			case CMN_TYPE_RND:
+				dn->type = CMN_TYPE_RNI;
+				/* Fall through */
+			case CMN_TYPE_DVM:
+			case CMN_TYPE_HNI:
+			case CMN_TYPE_HNF:
+			case CMN_TYPE_SBSX:
+			case CMN_TYPE_RNI:
+			case CMN_TYPE_CXRA:
+			case CMN_TYPE_CXHA:
+				dn++;
+				break;
+			/* Nothing to see here */
+			default:
+				break;
+			}
+		}
+	}
+
+	/* Correct for any nodes we skipped */
+	cmn->num_dns = dn - cmn->dns;
+	sort(cmn->dns, cmn->num_dns, sizeof(*cmn->dns), arm_cmn_node_cmp,
+	     NULL);
+
+	dev_dbg(cmn->dev, "%d XPs, %d other nodes, %d DTCs\n",
+		cmn->num_xps, cmn->num_dns, cmn->num_dtcs);
+
+	return cmn->num_dtcs ? 0 : -ENODEV;
+}
+
+static int arm_cmn_init_dtcs(struct arm_cmn *cmn)
+{
+	struct platform_device *pdev = to_platform_device(cmn->dev);
+	struct arm_cmn_node *dn;
+	int i, err, num;
+
+	cmn->dtc = devm_kcalloc(cmn->dev, cmn->num_dtcs, sizeof(*cmn->dtc),
+				GFP_KERNEL);
+	if (!cmn->dtc)
+		return -ENOMEM;
+
+	dn = arm_cmn_find_nodes(cmn, CMN_TYPE_DTC, -1, &num);
+	for (i = 0; i < cmn->num_dtcs; i++) {
+		struct arm_cmn_dtc *dtc = cmn->dtc + i;
+
+		dtc->cmn = cmn;
+		dtc->base = dn[i].pmu_base - CMN_PMU_OFFSET;
+		dtc->irq = platform_get_irq(pdev, i);
+		if (dtc->irq < 0)
+			return dtc->irq;
+
+		writel_relaxed(0, dtc->base + CMN_DT_PMCR);
+		writel_relaxed(0x1ff, dtc->base + CMN_DT_PMOVSR_CLR);
+		writel_relaxed(CMN_DT_PMCR_OVFL_INTR_EN, dtc->base + CMN_DT_PMCR);
+		writel_relaxed(CMN_DT_DTC_CTL_DT_EN, dtc->base + CMN_DT_DTC_CTL);
+
+		err = devm_request_irq(cmn->dev, dtc->irq, arm_cmn_handle_irq,
+				       IRQF_NOBALANCING | IRQF_NO_THREAD |
+				       IRQF_SHARED, dev_name(cmn->dev), dtc);
+		if (err)
+			return err;
+
+		err = irq_set_affinity_hint(dtc->irq, cpumask_of(cmn->cpu));
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static void arm_cmn_clear_irq_affinity(struct arm_cmn *cmn)
+{
+	int i;
+
+	for (i = 0; i < cmn->num_dtcs; i++)
+		if (cmn->dtc[i].irq > 0)
+			irq_set_affinity_hint(cmn->dtc[i].irq, NULL);
+}
+
+static int arm_cmn_acpi_probe(struct platform_device *pdev,
+			      struct arm_cmn *cmn)
+{
+	struct resource *cfg, *root;
+
+	cfg = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	if (!cfg)
+		return -EINVAL;
+
+	root = platform_get_resource(pdev, IORESOURCE_MEM, 1);
+	if (!root)
+		return -EINVAL;
+
+	if (!resource_contains(cfg, root))
+		swap(cfg, root);
+	/*
+	 * The ACPI companion device has already claimed both regions, so
+	 * just map the whole of the configuration space.
+	 */
+	cmn->base = devm_ioremap(cmn->dev, cfg->start, resource_size(cfg));
+	if (!cmn->base)
+		return -ENOMEM;
+
+	return root->start - cfg->start;
+}
+
+static int arm_cmn_of_probe(struct platform_device *pdev, struct arm_cmn *cmn)
+{
+	struct device_node *np = pdev->dev.of_node;
+	u32 rootnode;
+	int ret;
+
+	cmn->base = devm_platform_ioremap_resource(pdev, 0);
+	if (IS_ERR(cmn->base))
+		return PTR_ERR(cmn->base);
+
+	ret = of_property_read_u32(np, "arm,root-node", &rootnode);
+	if (ret)
+		return ret;
+
+	return rootnode;
+}
+
+static int arm_cmn_probe(struct platform_device *pdev)
+{
+	static atomic_t id;
+	struct arm_cmn *cmn;
+	const char *name;
+	int err, rootnode;
+
+	cmn = devm_kzalloc(&pdev->dev, sizeof(*cmn), GFP_KERNEL);
+	if (!cmn)
+		return -ENOMEM;
+
+	cmn->dev = &pdev->dev;
+	platform_set_drvdata(pdev, cmn);
+
+	if (has_acpi_companion(cmn->dev))
+		rootnode = arm_cmn_acpi_probe(pdev, cmn);
+	else
+		rootnode = arm_cmn_of_probe(pdev, cmn);
+	if (rootnode < 0)
+		return rootnode;
+
+	err = arm_cmn_discover(cmn, rootnode);
+	if (err)
+		return err;
+
+	cmn->cpu = cpumask_local_spread(0, dev_to_node(cmn->dev));
+	err = arm_cmn_init_dtcs(cmn);
+	if (err)
+		goto out_clear_affinity;
+
+	cmn->pmu = (struct pmu) {
+		.module		= THIS_MODULE,
+		.attr_groups	= arm_cmn_attr_groups,
+		.capabilities	= PERF_PMU_CAP_NO_EXCLUDE,
+		.task_ctx_nr	= perf_invalid_context,
+		.pmu_enable	= arm_cmn_pmu_enable,
+		.pmu_disable	= arm_cmn_pmu_disable,
+		.event_init	= arm_cmn_event_init,
+		.add		= arm_cmn_event_add,
+		.del		= arm_cmn_event_del,
+		.start		= arm_cmn_event_start,
+		.stop		= arm_cmn_event_stop,
+		.read		= arm_cmn_event_read,
+	};
+
+	name = devm_kasprintf(cmn->dev, GFP_KERNEL, "arm_cmn_%d",
+			      atomic_fetch_inc(&id));
+	if (!name) {
+		err = -ENOMEM;
+		goto out_clear_affinity;
+	}
+
+	err = cpuhp_state_add_instance(arm_cmn_hp_state, &cmn->cpuhp_node);
+	if (err)
+		goto out_clear_affinity;
+
+	err = perf_pmu_register(&cmn->pmu, name, -1);
+	if (err) {
+		cpuhp_state_remove_instance(arm_cmn_hp_state, &cmn->cpuhp_node);
+		goto out_clear_affinity;
+	}
+
+	return 0;
+
+out_clear_affinity:
+	arm_cmn_clear_irq_affinity(cmn);
+	return err;
+}
+
+static int arm_cmn_remove(struct platform_device *pdev)
+{
+	struct arm_cmn *cmn = platform_get_drvdata(pdev);
+	int i;
+
+	perf_pmu_unregister(&cmn->pmu);
+	cpuhp_state_remove_instance(arm_cmn_hp_state, &cmn->cpuhp_node);
+	arm_cmn_clear_irq_affinity(cmn);
+
+	for (i = 0; i < cmn->num_dtcs; i++)
+		writel_relaxed(0, cmn->dtc[i].base + CMN_DT_DTC_CTL);
+
+	return 0;
+}
+
+#ifdef CONFIG_OF
+static const struct of_device_id arm_cmn_of_match[] = {
+	{ .compatible = "arm,cmn-600", },
+	{}
+};
+MODULE_DEVICE_TABLE(of, arm_cmn_of_match);
+#endif
+
+#ifdef CONFIG_ACPI
+static const struct acpi_device_id arm_cmn_acpi_match[] = {
+	{ "ARMHC600", },
+	{}
+};
+MODULE_DEVICE_TABLE(acpi, arm_cmn_acpi_match);
+#endif
+
+static struct platform_driver arm_cmn_driver = {
+	.driver = {
+		.name = DRVNAME,
+		.of_match_table = of_match_ptr(arm_cmn_of_match),
+		.acpi_match_table = ACPI_PTR(arm_cmn_acpi_match),
+		.suppress_bind_attrs = true,
+	},
+	.probe = arm_cmn_probe,
+	.remove = arm_cmn_remove,
+};
+
+static int __init arm_cmn_init(void)
+{
+	int ret;
+
+	ret = cpuhp_setup_state_multi(CPUHP_AP_ONLINE_DYN,
+				      "perf/arm/cmn:online", NULL,
+				      arm_cmn_pmu_offline_cpu);
+	if (ret < 0)
+		return ret;
+
+	arm_cmn_hp_state = ret;
+	ret = platform_driver_register(&arm_cmn_driver);
+	if (ret)
+		cpuhp_remove_multi_state(arm_cmn_hp_state);
+	return ret;
+}
+
+static void __exit arm_cmn_exit(void)
+{
+	platform_driver_unregister(&arm_cmn_driver);
+	cpuhp_remove_multi_state(arm_cmn_hp_state);
+}
+
+module_init(arm_cmn_init);
+module_exit(arm_cmn_exit);
+
+MODULE_DESCRIPTION("Arm CMN-600 PMU driver");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,602 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * ARM DMC-620 memory controller PMU driver
+ *
+ * Each DMC-620 has eight counters clocked at half the memory controller
+ * frequency (clkdiv2) and two clocked at the full frequency (clk). All of
+ * them are 32 bits wide and can raise an overflow interrupt, which is
+ * typically shared by all the controllers of one socket.
+ */
+
+#define DMC620_PMUNAME		"arm_dmc620"
+#define DMC620_DRVNAME		DMC620_PMUNAME "_pmu"
+#define pr_fmt(fmt)		DMC620_DRVNAME ": " fmt
+
+#include <linux/acpi.h>
+#include <linux/bitfield.h>
+#include <linux/bitops.h>
+#include <linux/cpuhotplug.h>
+#include <linux/cpumask.h>
+#include <linux/device.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/perf_event.h>
+#include <linux/platform_device.h>
+#include <linux/printk.h>
+
+#define DMC620_PA_SHIFT					12
+#define DMC620_CNT_INIT					0x80000000
+#define DMC620_CNT_MAX_PERIOD				0xffffffff
+#define DMC620_PMU_CLKDIV2_MAX_COUNTERS			8
+#define DMC620_PMU_CLK_MAX_COUNTERS			2
+#define DMC620_PMU_MAX_COUNTERS				\
+	(DMC620_PMU_CLKDIV2_MAX_COUNTERS + DMC620_PMU_CLK_MAX_COUNTERS)
+
+/*
+ * The PMU registers start at 0xA00 in the DMC-620 memory map, and these
+ * offsets are relative to that base.
+ *
+ * Each counter has a group of control/value registers, and the
+ * DMC620_PMU_COUNTERn offsets are within a counter group.
+ *
+ * The counter registers groups start at 0xA10.
+ */
+#define DMC620_PMU_OVERFLOW_STATUS_CLKDIV2		0x8
+#define DMC620_PMU_OVERFLOW_STATUS_CLK			0xC
+#define DMC620_PMU_COUNTERS_BASE			0x10
+#define DMC620_PMU_COUNTERn_MASK_31_00			0x0
+#define DMC620_PMU_COUNTERn_MASK_63_32			0x4
+#define DMC620_PMU_COUNTERn_MATCH_31_00			0x8
+#define DMC620_PMU_COUNTERn_MATCH_63_32			0xC
+#define DMC620_PMU_COUNTERn_CONTROL			0x10
+#define  DMC620_PMU_COUNTERn_CONTROL_ENABLE		BIT(0)
+#define  DMC620_PMU_COUNTERn_CONTROL_INVERT		BIT(1)
+#define  DMC620_PMU_COUNTERn_CONTROL_EVENT_MUX		GENMASK(6, 2)
+#define  DMC620_PMU_COUNTERn_CONTROL_INCR_MUX		GENMASK(8, 7)
+#define DMC620_PMU_COUNTERn_VALUE			0x20
+/* Offset of the registers for a given counter, relative to 0xA00 */
+#define DMC620_PMU_COUNTERn_OFFSET(n) \
+	(DMC620_PMU_COUNTERS_BASE + 0x28 * (n))
+
+/* Event attributes */
+#define DMC620_CONFIG_EVENT		GENMASK_ULL(4, 0)
+#define DMC620_CONFIG_CLKDIV2		BIT_ULL(5)
+#define DMC620_CONFIG_INVERT		BIT_ULL(6)
+#define DMC620_CONFIG_INCR		GENMASK_ULL(8, 7)
+#define DMC620_CONFIG_MASK_MATCH	GENMASK_ULL(44, 0)
+
+static int cpuhp_state_num;
+
+struct dmc620_pmu {
+	struct pmu pmu;
+
+	void __iomem *base;
+	int irq;
+	int cpu;
+	struct hlist_node node;
+
+	/*
+	 * We put all clkdiv2 and clk counters to a same array.
+	 * The first DMC620_PMU_CLKDIV2_MAX_COUNTERS bits belong to
+	 * clkdiv2 counters, the last DMC620_PMU_CLK_MAX_COUNTERS
+	 * belong to clk counters.
+	 */
+	DECLARE_BITMAP(used_mask, DMC620_PMU_MAX_COUNTERS);
+	struct perf_event *events[DMC620_PMU_MAX_COUNTERS];
+};
+
+#define to_dmc620_pmu(p) (container_of(p, struct dmc620_pmu, pmu))
+
+static ssize_t dmc620_pmu_event_show(struct device *dev,
+				     struct device_attribute *attr, char *page)
+{
+	struct dev_ext_attribute *eattr;
+
+	eattr = container_of(attr, typeof(*eattr), attr);
+
+	return sprintf(page, "%s\n", (char *)eattr->var);
+}
+
+#define DMC620_PMU_EVENT_ATTR(_name, _config)				\
+	(&((struct dev_ext_attribute[]) {				\
+		{ __ATTR(_name, 0444, dmc620_pmu_event_show, NULL),	\
+		  (void *)_config }					\
+	})[0].attr.attr)
+
+static struct attribute *dmc620_pmu_events_attrs[] = {
+	/* clkdiv2 events list */
+	DMC620_PMU_EVENT_ATTR(clkdiv2_cycle_count, "event=0x0,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_allocate, "event=0x1,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_queue_depth, "event=0x2,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_waiting_for_wr_data, "event=0x3,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_read_backlog, "event=0x4,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_waiting_for_mi, "event=0x5,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_hazard_resolution, "event=0x6,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_enqueue, "event=0x7,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_arbitrate, "event=0x8,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_lrank_turnaround_activate, "event=0x9,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_prank_turnaround_activate, "event=0xa,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_read_depth, "event=0xb,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_write_depth, "event=0xc,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_highigh_qos_depth, "event=0xd,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_high_qos_depth, "event=0xe,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_medium_qos_depth, "event=0xf,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_low_qos_depth, "event=0x10,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_activate, "event=0x11,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_rdwr, "event=0x12,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_refresh, "event=0x13,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_training_request, "event=0x14,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_t_mac_tracker, "event=0x15,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_bk_fsm_tracker, "event=0x16,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_bk_open_tracker, "event=0x17,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_ranks_in_pwr_down, "event=0x18,clkdiv2=1"),
+	DMC620_PMU_EVENT_ATTR(clkdiv2_ranks_in_sref, "event=0x19,clkdiv2=1"),
+
+	/* clk events list */
+	DMC620_PMU_EVENT_ATTR(clk_cycle_count, "event=0x0,clkdiv2=0"),
+	DMC620_PMU_EVENT_ATTR(clk_request, "event=0x1,clkdiv2=0"),
+	DMC620_PMU_EVENT_ATTR(clk_upload_stall, "event=0x2,clkdiv2=0"),
+	NULL,
+};
+
+static const struct attribute_group dmc620_pmu_events_attr_group = {
+	.name = "events",
+	.attrs = dmc620_pmu_events_attrs,
+};
+
+PMU_FORMAT_ATTR(event,		"config:0-4");
+PMU_FORMAT_ATTR(clkdiv2,	"config:5");
+PMU_FORMAT_ATTR(invert,		"config:6");
+PMU_FORMAT_ATTR(incr,		"config:7-8");
+PMU_FORMAT_ATTR(mask,		"config1:0-44");
+PMU_FORMAT_ATTR(match,		"config2:0-44");
+
+static struct attribute *dmc620_pmu_formats_attrs[] = {
+	&format_attr_event.attr,
+	&format_attr_clkdiv2.attr,
+	&format_attr_invert.attr,
+	&format_attr_incr.attr,
+	&format_attr_mask.attr,
+	&format_attr_match.attr,
+	NULL,
+};
+
+static const struct attribute_group dmc620_pmu_format_attr_group = {
+	.name	= "format",
+	.attrs	= dmc620_pmu_formats_attrs,
+};
+
+static ssize_t dmc620_pmu_cpumask_show(struct device *dev,
+				       struct device_attribute *attr, char *buf)
+{
+	struct dmc620_pmu *dmc620_pmu = to_dmc620_pmu(dev_get_drvdata(dev));
+
+	return cpumap_print_to_pagebuf(true, buf,
+				       cpumask_of(dmc620_pmu->cpu));
+}
+
+static struct device_attribute dmc620_pmu_cpumask_attr =
+	__ATTR(cpumask, 0444, dmc620_pmu_cpumask_show, NULL);
+
+static struct attribute *dmc620_pmu_cpumask_attrs[] = {
+	&dmc620_pmu_cpumask_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group dmc620_pmu_cpumask_attr_group = {
+	.attrs = dmc620_pmu_cpumask_attrs,
+};
+
+static const struct attribute_group *dmc620_pmu_attr_groups[] = {
+	&dmc620_pmu_events_attr_group,
+	&dmc620_pmu_format_attr_group,
+	&dmc620_pmu_cpumask_attr_group,
+	NULL,
+};
+
+static inline u32 dmc620_pmu_creg_read(struct dmc620_pmu *dmc620_pmu,
+				       unsigned int idx, unsigned int reg)
+{
+	return readl(dmc620_pmu->base + DMC620_PMU_COUNTERn_OFFSET(idx) + reg);
+}
+
+static inline void dmc620_pmu_creg_write(struct dmc620_pmu *dmc620_pmu,
+					 unsigned int idx, unsigned int reg,
+					 u32 val)
+{
+	writel(val, dmc620_pmu->base + DMC620_PMU_COUNTERn_OFFSET(idx) + reg);
+}
+
+static int dmc620_get_event_idx(struct perf_event *event)
+{
+	struct dmc620_pmu *dmc620_pmu = to_dmc620_pmu(event->pmu);
+	int idx, start_idx, end_idx;
+
+	if (FIELD_GET(DMC620_CONFIG_CLKDIV2, event->attr.config)) {
+		start_idx = 0;
+		end_idx = DMC620_PMU_CLKDIV2_MAX_COUNTERS;
+	} else {
+		start_idx = DMC620_PMU_CLKDIV2_MAX_COUNTERS;
+		end_idx = DMC620_PMU_MAX_COUNTERS;
+	}
+
+	for (idx = start_idx; idx < end_idx; ++idx) {
+		if (!test_and_set_bit(idx, dmc620_pmu->used_mask))
+			return idx;
+	}
+
+	/* The counters are all in use. */
+	return -EAGAIN;
+}
+
+static void dmc620_pmu_event_update(struct perf_event *event)
+{
+	struct dmc620_pmu *dmc620_pmu = to_dmc620_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	u64 delta, prev_count, new_count;
+
+	do {
+		/* We may also be called from the irq handler */
+		prev_count = local64_read(&hwc->prev_count);
+		new_count = dmc620_pmu_creg_read(dmc620_pmu, hwc->idx,
+						 DMC620_PMU_COUNTERn_VALUE);
+	} while (local64_cmpxchg(&hwc->prev_count,
+				 prev_count, new_count) != prev_count);
+	delta = (new_count - prev_count) & DMC620_CNT_MAX_PERIOD;
+	local64_add(delta, &event->count);
+}
+
+static void dmc620_pmu_event_set_period(struct perf_event *event)
+{
+	struct dmc620_pmu *dmc620_pmu = to_dmc620_pmu(event->pmu);
+
+	/*
+	 * Start from the middle so that an overflow is only ever seen after
+	 * 2^31 events, long before the handler could fall behind.
+	 */
+	local64_set(&event->hw.prev_count, DMC620_CNT_INIT);
+	dmc620_pmu_creg_write(dmc620_pmu, event->hw.idx,
+			      DMC620_PMU_COUNTERn_VALUE, DMC620_CNT_INIT);
+}
+
+static void dmc620_pmu_enable_counter(struct perf_event *event)
+{
+	struct dmc620_pmu *dmc620_pmu = to_dmc620_pmu(event->pmu);
+	u64 config = event->attr.config;
+	u32 reg;
+
+	reg = FIELD_PREP(DMC620_PMU_COUNTERn_CONTROL_EVENT_MUX,
+			 FIELD_GET(DMC620_CONFIG_EVENT, config)) |
+	      FIELD_PREP(DMC620_PMU_COUNTERn_CONTROL_INCR_MUX,
+			 FIELD_GET(DMC620_CONFIG_INCR, config)) |
+	      DMC620_PMU_COUNTERn_CONTROL_ENABLE;
+	if (FIELD_GET(DMC620_CONFIG_INVERT, config))
+		reg |= DMC620_PMU_COUNTERn_CONTROL_INVERT;
+
+	dmc620_pmu_creg_write(dmc620_pmu, event->hw.idx,
+			      DMC620_PMU_COUNTERn_CONTROL, reg);
+}
+
+static void dmc620_pmu_disable_counter(struct perf_event *event)
+{
+	struct dmc620_pmu *dmc620_pmu = to_dmc620_pmu(event->pmu);
+
+	dmc620_pmu_creg_write(dmc620_pmu, event->hw.idx,
+			      DMC620_PMU_COUNTERn_CONTROL, 0);
+}
+
+static irqreturn_t dmc620_pmu_handle_irq(int irq_num, void *data)
+{
+	struct dmc620_pmu *dmc620_pmu = data;
+	unsigned long status;
+	int idx;
+
+	status = readl(dmc620_pmu->base + DMC620_PMU_OVERFLOW_STATUS_CLK);
+	status <<= DMC620_PMU_CLKDIV2_MAX_COUNTERS;
+	status |= readl(dmc620_pmu->base + DMC620_PMU_OVERFLOW_STATUS_CLKDIV2);
+	status &= GENMASK(DMC620_PMU_MAX_COUNTERS - 1, 0);
+	if (!status)
+		return IRQ_NONE;
+
+	for_each_set_bit(idx, &status, DMC620_PMU_MAX_COUNTERS) {
+		struct perf_event *event = dmc620_pmu->events[idx];
+
+		if (!event)
+			continue;
+
+		dmc620_pmu_disable_counter(event);
+		dmc620_pmu_event_update(event);
+		dmc620_pmu_event_set_period(event);
+		dmc620_pmu_enable_counter(event);
+	}
+
+	if (status & GENMASK(DMC620_PMU_CLKDIV2_MAX_COUNTERS - 1, 0))
+		writel(0, dmc620_pmu->base + DMC620_PMU_OVERFLOW_STATUS_CLKDIV2);
+	if (status >> DMC620_PMU_CLKDIV2_MAX_COUNTERS)
+		writel(0, dmc620_pmu->base + DMC620_PMU_OVERFLOW_STATUS_CLK);
+
+	return IRQ_HANDLED;
+}
+
+static int dmc620_pmu_event_init(struct perf_event *event)
+{
+	struct dmc620_pmu *dmc620_pmu = to_dmc620_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	struct perf_event *sibling;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	/*
+	 * DMC 620 PMUs are shared across all cpus and cannot
+	 * support task bound and sampling events.
+	 */
+	if (is_sampling_event(event) ||
+		event->attach_state & PERF_ATTACH_TASK) {
+		dev_dbg(dmc620_pmu->pmu.dev,
+			"Can't support per-task counters\n");
+		return -EOPNOTSUPP;
+	}
+
+	/*
+	 * Many perf core operations (eg. events rotation) operate on a
+	 * single CPU context. This is obvious for CPU PMUs, where one
+	 * expects the same sets of events being observed on all CPUs,
+	 * but can lead to issues for off-core PMUs, where each
+	 * event could be theoretically assigned to a different CPU. To
+	 * mitigate this, we enforce CPU assignment to one, selected
+	 * processor.
+	 */
+	event->cpu = dmc620_pmu->cpu;
+	if (event->cpu < 0)
+		return -EINVAL;
+
+	/*
+	 * We can't atomically disable all HW counters so only one event allowed,
+	 * although software events are acceptable.
+	 */
+	if (event->group_leader != event &&
+			!is_software_event(event->group_leader))
+		return -EINVAL;
+
+	for_each_sibling_event(sibling, event->group_leader) {
+		if (sibling != event &&
+				!is_software_event(sibling))
+			return -EINVAL;
+	}
+
+	hwc->idx = -1;
+	return 0;
+}
+
+static void dmc620_pmu_read(struct perf_event *event)
+{
+	dmc620_pmu_event_update(event);
+}
+
+static void dmc620_pmu_start(struct perf_event *event, int flags)
+{
+	event->hw.state = 0;
+	dmc620_pmu_event_set_period(event);
+	dmc620_pmu_enable_counter(event);
+}
+
+static void dmc620_pmu_stop(struct perf_event *event, int flags)
+{
+	if (event->hw.state & PERF_HES_STOPPED)
+		return;
+
+	dmc620_pmu_disable_counter(event);
+	dmc620_pmu_event_update(event);
+	event->hw.state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int dmc620_pmu_add(struct perf_event *event, int flags)
+{
+	struct dmc620_pmu *dmc620_pmu = to_dmc620_pmu(event->pmu);
+	struct perf_event_attr *attr = &event->attr;
+	struct hw_perf_event *hwc = &event->hw;
+	int idx;
+	u64 reg;
+
+	idx = dmc620_get_event_idx(event);
+	if (idx < 0)
+		return idx;
+
+	hwc->idx = idx;
+	dmc620_pmu->events[idx] = event;
+	hwc->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	reg = attr->config1 & DMC620_CONFIG_MASK_MATCH;
+	dmc620_pmu_creg_write(dmc620_pmu, idx,
+			      DMC620_PMU_COUNTERn_MASK_31_00, lower_32_bits(reg));
+	dmc620_pmu_creg_write(dmc620_pmu, idx,
+			      DMC620_PMU_COUNTERn_MASK_63_32, upper_32_bits(reg));
+
+	reg = attr->config2 & DMC620_CONFIG_MASK_MATCH;
+	dmc620_pmu_creg_write(dmc620_pmu, idx,
+			      DMC620_PMU_COUNTERn_MATCH_31_00, lower_32_bits(reg));
+	dmc620_pmu_creg_write(dmc620_pmu, idx,
+			      DMC620_PMU_COUNTERn_MATCH_63_32, upper_32_bits(reg));
+
+	if (flags & PERF_EF_START)
+		dmc620_pmu_start(event, PERF_EF_RELOAD);
+
+	perf_event_update_userpage(event);
+	return 0;
+}
+
+static void dmc620_pmu_del(struct perf_event *event, int flags)
+{
+	struct dmc620_pmu *dmc620_pmu = to_dmc620_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	int idx = hwc->idx;
+
+	dmc620_pmu_stop(event, PERF_EF_UPDATE);
+	dmc620_pmu->events[idx] = NULL;
+	clear_bit(idx, dmc620_pmu->used_mask);
+	perf_event_update_userpage(event);
+}
+
+static int dmc620_pmu_cpu_teardown(unsigned int cpu, struct hlist_node *node)
+{
+	struct dmc620_pmu *dmc620_pmu;
+	unsigned int target;
+
+	dmc620_pmu = hlist_entry_safe(node, struct dmc620_pmu, node);
+	if (cpu != dmc620_pmu->cpu)
+		return 0;
+
+	target = cpumask_any_but(cpu_online_mask, cpu);
+	if (target >= nr_cpu_ids)
+		return 0;
+
+	perf_pmu_migrate_context(&dmc620_pmu->pmu, cpu, target);
+	irq_set_affinity_hint(dmc620_pmu->irq, cpumask_of(target));
+	dmc620_pmu->cpu = target;
+
+	return 0;
+}
+
+static int dmc620_pmu_device_probe(struct platform_device *pdev)
+{
+	struct dmc620_pmu *dmc620_pmu;
+	struct resource *res;
+	char *name;
+	int irq_num;
+	int i, ret;
+
+	dmc620_pmu = devm_kzalloc(&pdev->dev,
+			sizeof(struct dmc620_pmu), GFP_KERNEL);
+	if (!dmc620_pmu)
+		return -ENOMEM;
+
+	platform_set_drvdata(pdev, dmc620_pmu);
+
+	dmc620_pmu->pmu = (struct pmu) {
+		.module = THIS_MODULE,
+		.capabilities	= PERF_PMU_CAP_NO_EXCLUDE,
+		.task_ctx_nr	= perf_invalid_context,
+		.event_init	= dmc620_pmu_event_init,
+		.add		= dmc620_pmu_add,
+		.del		= dmc620_pmu_del,
+		.start		= dmc620_pmu_start,
+		.stop		= dmc620_pmu_stop,
+		.read		= dmc620_pmu_read,
+		.attr_groups	= dmc620_pmu_attr_groups,
+	};
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	dmc620_pmu->base = devm_ioremap_resource(&pdev->dev, res);
+	if (IS_ERR(dmc620_pmu->base))
+		return PTR_ERR(dmc620_pmu->base);
+
+	/* Make sure device is reset before enabling interrupt */
+	for (i = 0; i < DMC620_PMU_MAX_COUNTERS; i++)
+		dmc620_pmu_creg_write(dmc620_pmu, i, DMC620_PMU_COUNTERn_CONTROL, 0);
+	writel(0, dmc620_pmu->base + DMC620_PMU_OVERFLOW_STATUS_CLKDIV2);
+	writel(0, dmc620_pmu->base + DMC620_PMU_OVERFLOW_STATUS_CLK);
+
+	irq_num = platform_get_irq(pdev, 0);
+	if (irq_num < 0)
+		return irq_num;
+	dmc620_pmu->irq = irq_num;
+	dmc620_pmu->cpu = cpumask_local_spread(0, dev_to_node(&pdev->dev));
+
+	/* The interrupt is usually shared by all DMCs of a socket */
+	ret = devm_request_irq(&pdev->dev, irq_num, dmc620_pmu_handle_irq,
+			       IRQF_NOBALANCING | IRQF_NO_THREAD | IRQF_SHARED,
+			       dev_name(&pdev->dev), dmc620_pmu);
+	if (ret)
+		return ret;
+
+	ret = irq_set_affinity_hint(irq_num, cpumask_of(dmc620_pmu->cpu));
+	if (ret)
+		return ret;
+
+	ret = cpuhp_state_add_instance_nocalls(cpuhp_state_num,
+					       &dmc620_pmu->node);
+	if (ret)
+		goto out_clear_affinity;
+
+	/* Name the PMU after its physical page, to tell the channels apart */
+	name = devm_kasprintf(&pdev->dev, GFP_KERNEL,
+			      "%s_%llx", DMC620_PMUNAME,
+			      (u64)(res->start >> DMC620_PA_SHIFT));
+	if (!name) {
+		ret = -ENOMEM;
+		goto out_teardown_cpuhp;
+	}
+
+	ret = perf_pmu_register(&dmc620_pmu->pmu, name, -1);
+	if (ret)
+		goto out_teardown_cpuhp;
+
+	return 0;
+
+out_teardown_cpuhp:
+	cpuhp_state_remove_instance_nocalls(cpuhp_state_num,
+					    &dmc620_pmu->node);
+out_clear_affinity:
+	irq_set_affinity_hint(irq_num, NULL);
+	return ret;
+}
+
+static int dmc620_pmu_device_remove(struct platform_device *pdev)
+{
+	struct dmc620_pmu *dmc620_pmu = platform_get_drvdata(pdev);
+
+	perf_pmu_unregister(&dmc620_pmu->pmu);
+	cpuhp_state_remove_instance_nocalls(cpuhp_state_num,
+					    &dmc620_pmu->node);
+	irq_set_affinity_hint(dmc620_pmu->irq, NULL);
+
+	return 0;
+}
+
+static const struct acpi_device_id dmc620_acpi_match[] = {
+	{ "ARMHD620", 0},
+	{},
+};
+MODULE_DEVICE_TABLE(acpi, dmc620_acpi_match);
+static struct platform_driver dmc620_pmu_driver = {
+	.driver	= {
+		.name		= DMC620_DRVNAME,
+		.acpi_match_table = ACPI_PTR(dmc620_acpi_match),
+		.suppress_bind_attrs = true,
+	},
+	.probe	= dmc620_pmu_device_probe,
+	.remove	= dmc620_pmu_device_remove,
+};
+
+static int __init dmc620_pmu_init(void)
+{
+	int ret;
+
+	cpuhp_state_num = cpuhp_setup_state_multi(CPUHP_AP_ONLINE_DYN,
+						  DMC620_DRVNAME,
+						  NULL,
+						  dmc620_pmu_cpu_teardown);
+	if (cpuhp_state_num < 0)
+		return cpuhp_state_num;
+
+	ret = platform_driver_register(&dmc620_pmu_driver);
+	if (ret)
+		cpuhp_remove_multi_state(cpuhp_state_num);
+
+	return ret;
+}
+
+static void __exit dmc620_pmu_exit(void)
+{
+	platform_driver_unregister(&dmc620_pmu_driver);
+	cpuhp_remove_multi_state(cpuhp_state_num);
+}
+
+module_init(dmc620_pmu_init);
+module_exit(dmc620_pmu_exit);
+
+MODULE_DESCRIPTION("Perf driver for the ARM DMC-620 memory controller");
+MODULE_LICENSE("GPL v2");
@@ -30,6 +30,7 @@
 #include <linux/perf/arm_pmu.h>
 #include <linux/platform_device.h>
 #include <linux/printk.h>
+#include <linux/sched/numa_balancing.h>
 #include <linux/slab.h>
 #include <linux/smp.h>
 #include <linux/vmalloc.h>
@@ -38,6 +39,7 @@
 #include <asm/cpufeature.h>
 #include <asm/mmu.h>
 #include <asm/sysreg.h>
+#include <asm/unaligned.h>
 
 #define ARM_SPE_BUF_PAD_BYTE			0
 
@@ -70,8 +72,27 @@ struct arm_spe_pmu {
 	u16					max_record_sz;
 	u16					align;
 	struct perf_output_handle __percpu	*handle;
+
+	/*
+	 * NUMA sampling mode: the driver owns the profiling buffers and
+	 * feeds physical addresses of sampled loads and stores to the NUMA
+	 * balancing code instead of exposing them through perf. The two
+	 * modes are mutually exclusive, serialised by numa_lock.
+	 */
+	struct mutex				numa_lock;
+	u32					numa_interval;
+	int					nr_perf_events;
 };
 
+#define SPE_NUMA_BUF_ORDER			2
+
+struct arm_spe_numa_buf {
+	void					*base;
+	bool					active;
+};
+
+static DEFINE_PER_CPU(struct arm_spe_numa_buf, arm_spe_numa_bufs);
+
 #define to_spe_pmu(p) (container_of(p, struct arm_spe_pmu, pmu))
 
 /* Convert a free-running index from perf into an SPE buffer offset */
@@ -173,6 +194,9 @@ static struct attribute_group arm_spe_pmu_cap_group = {
 #define ATTR_CFG_FLD_store_filter_CFG		config	/* PMSFCR_EL1.ST */
 #define ATTR_CFG_FLD_store_filter_LO		34
 #define ATTR_CFG_FLD_store_filter_HI		34
+#define ATTR_CFG_FLD_compact_CFG		config	/* AUX compaction */
+#define ATTR_CFG_FLD_compact_LO			35
+#define ATTR_CFG_FLD_compact_HI			35
 
 #define ATTR_CFG_FLD_event_filter_CFG		config1	/* PMSEVFR_EL1 */
 #define ATTR_CFG_FLD_event_filter_LO		0
@@ -181,6 +205,12 @@ static struct attribute_group arm_spe_pmu_cap_group = {
 #define ATTR_CFG_FLD_min_latency_CFG		config2	/* PMSLATFR_EL1.MINLAT */
 #define ATTR_CFG_FLD_min_latency_LO		0
 #define ATTR_CFG_FLD_min_latency_HI		11
+#define ATTR_CFG_FLD_compact_lat_sel_CFG	config2	/* Counter packet index */
+#define ATTR_CFG_FLD_compact_lat_sel_LO		16
+#define ATTR_CFG_FLD_compact_lat_sel_HI		17
+#define ATTR_CFG_FLD_compact_min_lat_CFG	config2	/* Counter threshold */
+#define ATTR_CFG_FLD_compact_min_lat_LO		32
+#define ATTR_CFG_FLD_compact_min_lat_HI		47
 
 /* Why does everything I do descend into this? */
 #define __GEN_PMU_FORMAT_ATTR(cfg, lo, hi)				\
@@ -213,6 +243,9 @@ GEN_PMU_FORMAT_ATTR(load_filter);
 GEN_PMU_FORMAT_ATTR(store_filter);
 GEN_PMU_FORMAT_ATTR(event_filter);
 GEN_PMU_FORMAT_ATTR(min_latency);
+GEN_PMU_FORMAT_ATTR(compact);
+GEN_PMU_FORMAT_ATTR(compact_lat_sel);
+GEN_PMU_FORMAT_ATTR(compact_min_lat);
 
 static struct attribute *arm_spe_pmu_formats_attr[] = {
 	&format_attr_ts_enable.attr,
@@ -224,6 +257,9 @@ static struct attribute *arm_spe_pmu_formats_attr[] = {
 	&format_attr_store_filter.attr,
 	&format_attr_event_filter.attr,
 	&format_attr_min_latency.attr,
+	&format_attr_compact.attr,
+	&format_attr_compact_lat_sel.attr,
+	&format_attr_compact_min_lat.attr,
 	NULL,
 };
 
@@ -242,8 +278,47 @@ static ssize_t arm_spe_pmu_get_attr_cpumask(struct device *dev,
 }
 static DEVICE_ATTR(cpumask, S_IRUGO, arm_spe_pmu_get_attr_cpumask, NULL);
 
+#ifdef CONFIG_NUMA_BALANCING_HW_SAMPLING
+static int arm_spe_numa_enable(struct arm_spe_pmu *spe_pmu, u32 interval);
+static void arm_spe_numa_disable(struct arm_spe_pmu *spe_pmu);
+
+static ssize_t numa_sample_interval_show(struct device *dev,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	struct arm_spe_pmu *spe_pmu = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(spe_pmu->numa_interval));
+}
+
+static ssize_t numa_sample_interval_store(struct device *dev,
+					  struct device_attribute *attr,
+					  const char *buf, size_t count)
+{
+	struct arm_spe_pmu *spe_pmu = dev_get_drvdata(dev);
+	u32 interval;
+	int ret;
+
+	ret = kstrtou32(buf, 0, &interval);
+	if (ret)
+		return ret;
+
+	mutex_lock(&spe_pmu->numa_lock);
+	if (spe_pmu->numa_interval)
+		arm_spe_numa_disable(spe_pmu);
+	ret = interval ? arm_spe_numa_enable(spe_pmu, interval) : 0;
+	mutex_unlock(&spe_pmu->numa_lock);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(numa_sample_interval);
+#endif
+
 static struct attribute *arm_spe_pmu_attrs[] = {
 	&dev_attr_cpumask.attr,
+#ifdef CONFIG_NUMA_BALANCING_HW_SAMPLING
+	&dev_attr_numa_sample_interval.attr,
+#endif
 	NULL,
 };
 
@@ -503,16 +578,91 @@ static void arm_spe_perf_aux_output_begin(struct perf_output_handle *handle,
 	write_sysreg_s(limit, SYS_PMBLIMITR_EL1);
 }
 
+/*
+ * Just enough of the packet format to find record boundaries, the data
+ * physical address and the latency counters.
+ */
+#define SPE_PKT_PAD				0x00
+#define SPE_PKT_END				0x01
+#define SPE_PKT_TS				0x71
+#define SPE_PKT_EXT_MASK			0xfc
+#define SPE_PKT_EXT				0x20
+#define SPE_PKT_ADDR_MASK			0xf8
+#define SPE_PKT_ADDR				0xb0
+#define SPE_PKT_ADDR_IDX_PA			3
+#define SPE_PKT_CNT_MASK			0xf8
+#define SPE_PKT_CNT				0x98
+#define SPE_PKT_CNT_IDX_MAX			2
+#define SPE_PKT_LEN(hdr)			(1U << (((hdr) >> 4) & 0x3))
+
+/*
+ * Squeeze the records the hardware has just written, in place: padding
+ * is dropped, and so are the records whose selected latency counter is
+ * below the requested threshold, or missing. A record ends with either
+ * an End or a Timestamp packet; a trailing partial record is dropped.
+ * Returns the number of bytes left.
+ */
+static u64 arm_spe_pmu_compact(struct perf_event *event, u8 *start, u64 size)
+{
+	struct perf_event_attr *attr = &event->attr;
+	unsigned int sel = ATTR_CFG_GET_FLD(attr, compact_lat_sel);
+	u16 min_lat = ATTR_CFG_GET_FLD(attr, compact_min_lat);
+	u8 *buf = start, *end = start + size, *dst = start, *rec = start;
+	bool keep = !min_lat;
+
+	while (buf < end) {
+		u8 *pkt = buf;
+		unsigned int idx = 0;
+		u8 hdr = *buf++;
+
+		if (hdr == SPE_PKT_PAD)
+			continue;
+
+		if (hdr != SPE_PKT_END) {
+			if ((hdr & SPE_PKT_EXT_MASK) == SPE_PKT_EXT) {
+				if (buf >= end)
+					break;
+				idx = (hdr & 0x3) << 3;
+				hdr = *buf++;
+			}
+
+			if (buf + SPE_PKT_LEN(hdr) > end)
+				break;
+
+			if ((hdr & SPE_PKT_CNT_MASK) == SPE_PKT_CNT &&
+			    (idx | (hdr & 0x7)) == sel)
+				keep = get_unaligned_le16(buf) >= min_lat;
+
+			buf += SPE_PKT_LEN(hdr);
+		}
+
+		memmove(dst, pkt, buf - pkt);
+		dst += buf - pkt;
+
+		if (hdr == SPE_PKT_END || hdr == SPE_PKT_TS) {
+			if (!keep)
+				dst = rec;
+			rec = dst;
+			keep = !min_lat;
+		}
+	}
+
+	return rec - start;
+}
+
 static void arm_spe_perf_aux_output_end(struct perf_output_handle *handle)
 {
 	struct arm_spe_pmu_buf *buf = perf_get_aux(handle);
-	u64 offset, size;
+	u64 offset, size, head = PERF_IDX2OFF(handle->head, buf);
 
 	offset = read_sysreg_s(SYS_PMBPTR_EL1) - (u64)buf->base;
-	size = offset - PERF_IDX2OFF(handle->head, buf);
+	size = offset - head;
 
 	if (buf->snapshot)
 		handle->head = offset;
+	else if (ATTR_CFG_GET_FLD(&handle->event->attr, compact))
+		size = arm_spe_pmu_compact(handle->event, buf->base + head,
+					   size);
 
 	perf_aux_output_end(handle, size);
 }
@@ -603,12 +753,207 @@ arm_spe_pmu_buf_get_fault_act(struct perf_output_handle *handle)
 	return ret;
 }
 
+#ifdef CONFIG_NUMA_BALANCING_HW_SAMPLING
+static void arm_spe_numa_parse(const u8 *buf, const u8 *end)
+{
+	while (buf < end) {
+		unsigned int idx = 0, len;
+		u8 hdr = *buf++;
+
+		if (hdr == SPE_PKT_PAD || hdr == SPE_PKT_END)
+			continue;
+
+		if ((hdr & SPE_PKT_EXT_MASK) == SPE_PKT_EXT) {
+			if (buf >= end)
+				break;
+			idx = (hdr & 0x3) << 3;
+			hdr = *buf++;
+		}
+
+		len = SPE_PKT_LEN(hdr);
+		if (buf + len > end)
+			break;
+
+		if ((hdr & SPE_PKT_ADDR_MASK) == SPE_PKT_ADDR &&
+		    (idx | (hdr & 0x7)) == SPE_PKT_ADDR_IDX_PA)
+			numa_sample_add(get_unaligned_le64(buf) &
+					GENMASK_ULL(55, 0));
+
+		buf += len;
+	}
+}
+
+static void __arm_spe_numa_start_one(void *info)
+{
+	struct arm_spe_pmu *spe_pmu = info;
+	struct arm_spe_numa_buf *buf = this_cpu_ptr(&arm_spe_numa_bufs);
+	u64 base, reg = 0;
+
+	if (!buf->base)
+		return;
+
+	if (spe_pmu->features & SPE_PMU_FEAT_FILT_TYP)
+		reg = BIT(SYS_PMSFCR_EL1_FT_SHIFT) |
+		      BIT(SYS_PMSFCR_EL1_LD_SHIFT) |
+		      BIT(SYS_PMSFCR_EL1_ST_SHIFT);
+	write_sysreg_s(reg, SYS_PMSFCR_EL1);
+	write_sysreg_s(0, SYS_PMSEVFR_EL1);
+	write_sysreg_s(0, SYS_PMSLATFR_EL1);
+	write_sysreg_s(spe_pmu->numa_interval, SYS_PMSIRR_EL1);
+	isb();
+	write_sysreg_s(0, SYS_PMSICR_EL1);
+
+	base = (u64)buf->base;
+	write_sysreg_s(base, SYS_PMBPTR_EL1);
+	write_sysreg_s((base + (PAGE_SIZE << SPE_NUMA_BUF_ORDER)) |
+		       BIT(SYS_PMBLIMITR_EL1_E_SHIFT), SYS_PMBLIMITR_EL1);
+	buf->active = true;
+
+	/* User accesses only: that is the memory NUMA balancing moves */
+	isb();
+	write_sysreg_s(BIT(SYS_PMSCR_EL1_E0SPE_SHIFT) |
+		       BIT(SYS_PMSCR_EL1_PA_SHIFT), SYS_PMSCR_EL1);
+}
+
+static void __arm_spe_numa_stop_one(void *info)
+{
+	struct arm_spe_numa_buf *buf = this_cpu_ptr(&arm_spe_numa_bufs);
+
+	if (!buf->active)
+		return;
+
+	arm_spe_pmu_disable_and_drain_local();
+	write_sysreg_s(0, SYS_PMBSR_EL1);
+	isb();
+	buf->active = false;
+}
+
+static irqreturn_t arm_spe_numa_irq(struct arm_spe_numa_buf *buf)
+{
+	u64 pmbsr, ptr;
+
+	psb_csync();
+	dsb(nsh);
+	isb();
+
+	pmbsr = read_sysreg_s(SYS_PMBSR_EL1);
+	if (!(pmbsr & BIT(SYS_PMBSR_EL1_S_SHIFT)))
+		return IRQ_NONE;
+
+	if ((pmbsr & (SYS_PMBSR_EL1_EC_MASK << SYS_PMBSR_EL1_EC_SHIFT)) !=
+	    SYS_PMBSR_EL1_EC_BUF ||
+	    (pmbsr & (SYS_PMBSR_EL1_BUF_BSC_MASK <<
+		      SYS_PMBSR_EL1_BUF_BSC_SHIFT)) !=
+	    SYS_PMBSR_EL1_BUF_BSC_FULL) {
+		pr_err_ratelimited("NUMA sampling stopped on CPU %d [PMBSR=0x%016llx]\n",
+				   smp_processor_id(), pmbsr);
+		arm_spe_pmu_disable_and_drain_local();
+		write_sysreg_s(0, SYS_PMBSR_EL1);
+		buf->active = false;
+		return IRQ_HANDLED;
+	}
+
+	ptr = read_sysreg_s(SYS_PMBPTR_EL1);
+	arm_spe_numa_parse(buf->base, (const u8 *)ptr);
+
+	/* Start over at the beginning of the buffer */
+	write_sysreg_s((u64)buf->base, SYS_PMBPTR_EL1);
+	isb();
+	write_sysreg_s(0, SYS_PMBSR_EL1);
+	return IRQ_HANDLED;
+}
+
+static void arm_spe_numa_free_bufs(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct arm_spe_numa_buf *buf = per_cpu_ptr(&arm_spe_numa_bufs,
+							   cpu);
+
+		if (buf->base)
+			free_pages((unsigned long)buf->base,
+				   SPE_NUMA_BUF_ORDER);
+		buf->base = NULL;
+	}
+}
+
+/* Called with numa_lock held */
+static int arm_spe_numa_enable(struct arm_spe_pmu *spe_pmu, u32 interval)
+{
+	u64 max_interval = SYS_PMSIRR_EL1_INTERVAL_MASK
+			   << SYS_PMSIRR_EL1_INTERVAL_SHIFT;
+	int cpu;
+
+	if (spe_pmu->nr_perf_events)
+		return -EBUSY;
+
+	for_each_cpu(cpu, &spe_pmu->supported_cpus) {
+		struct page *page;
+
+		page = alloc_pages_node(cpu_to_node(cpu),
+					GFP_KERNEL | __GFP_ZERO,
+					SPE_NUMA_BUF_ORDER);
+		if (!page) {
+			arm_spe_numa_free_bufs();
+			return -ENOMEM;
+		}
+		per_cpu(arm_spe_numa_bufs, cpu).base = page_address(page);
+	}
+
+	interval = clamp_t(u64, interval, spe_pmu->min_period, max_interval);
+	spe_pmu->numa_interval = interval & max_interval;
+
+	numa_sample_source_register();
+
+	cpus_read_lock();
+	on_each_cpu_mask(&spe_pmu->supported_cpus, __arm_spe_numa_start_one,
+			 spe_pmu, 1);
+	cpus_read_unlock();
+	return 0;
+}
+
+/* Called with numa_lock held */
+static void arm_spe_numa_disable(struct arm_spe_pmu *spe_pmu)
+{
+	cpus_read_lock();
+	on_each_cpu_mask(&spe_pmu->supported_cpus, __arm_spe_numa_stop_one,
+			 NULL, 1);
+	spe_pmu->numa_interval = 0;
+	cpus_read_unlock();
+
+	numa_sample_source_unregister();
+	arm_spe_numa_free_bufs();
+}
+#else
+static void __arm_spe_numa_start_one(void *info)
+{
+}
+
+static void __arm_spe_numa_stop_one(void *info)
+{
+}
+
+static irqreturn_t arm_spe_numa_irq(struct arm_spe_numa_buf *buf)
+{
+	return IRQ_NONE;
+}
+
+static void arm_spe_numa_disable(struct arm_spe_pmu *spe_pmu)
+{
+}
+#endif /* CONFIG_NUMA_BALANCING_HW_SAMPLING */
+
 static irqreturn_t arm_spe_pmu_irq_handler(int irq, void *dev)
 {
 	struct perf_output_handle *handle = dev;
 	struct perf_event *event = handle->event;
+	struct arm_spe_numa_buf *numa_buf = this_cpu_ptr(&arm_spe_numa_bufs);
 	enum arm_spe_pmu_buf_fault_action act;
 
+	if (numa_buf->active)
+		return arm_spe_numa_irq(numa_buf);
+
 	if (!perf_get_aux(handle))
 		return IRQ_NONE;
 
@@ -656,6 +1001,15 @@ static irqreturn_t arm_spe_pmu_irq_handler(int irq, void *dev)
 }
 
 /* Perf callbacks */
+static void arm_spe_pmu_event_destroy(struct perf_event *event)
+{
+	struct arm_spe_pmu *spe_pmu = to_spe_pmu(event->pmu);
+
+	mutex_lock(&spe_pmu->numa_lock);
+	spe_pmu->nr_perf_events--;
+	mutex_unlock(&spe_pmu->numa_lock);
+}
+
 static int arm_spe_pmu_event_init(struct perf_event *event)
 {
 	u64 reg;
@@ -699,6 +1053,14 @@ static int arm_spe_pmu_event_init(struct perf_event *event)
 	    !(spe_pmu->features & SPE_PMU_FEAT_FILT_LAT))
 		return -EOPNOTSUPP;
 
+	if (!ATTR_CFG_GET_FLD(attr, compact) &&
+	    (ATTR_CFG_GET_FLD(attr, compact_lat_sel) ||
+	     ATTR_CFG_GET_FLD(attr, compact_min_lat)))
+		return -EINVAL;
+
+	if (ATTR_CFG_GET_FLD(attr, compact_lat_sel) > SPE_PKT_CNT_IDX_MAX)
+		return -EINVAL;
+
 	reg = arm_spe_event_to_pmscr(event);
 	if (!perfmon_capable() &&
 	    (reg & (BIT(SYS_PMSCR_EL1_PA_SHIFT) |
@@ -706,6 +1068,16 @@ static int arm_spe_pmu_event_init(struct perf_event *event)
 		    BIT(SYS_PMSCR_EL1_PCT_SHIFT))))
 		return -EACCES;
 
+	/* The profiling buffers are busy feeding NUMA balancing */
+	mutex_lock(&spe_pmu->numa_lock);
+	if (spe_pmu->numa_interval) {
+		mutex_unlock(&spe_pmu->numa_lock);
+		return -EBUSY;
+	}
+	spe_pmu->nr_perf_events++;
+	mutex_unlock(&spe_pmu->numa_lock);
+
+	event->destroy = arm_spe_pmu_event_destroy;
 	return 0;
 }
 
@@ -834,6 +1206,13 @@ static void *arm_spe_pmu_setup_aux(struct perf_event *event, void **pages,
 	if (snapshot && (nr_pages & 1))
 		return NULL;
 
+	/*
+	 * Snapshot mode overwrites old data and is parsed backwards from the
+	 * head, which doesn't mix with moving records around.
+	 */
+	if (snapshot && ATTR_CFG_GET_FLD(&event->attr, compact))
+		return NULL;
+
 	if (cpu == -1)
 		cpu = raw_smp_processor_id();
 
@@ -1077,6 +1456,8 @@ static int arm_spe_pmu_cpu_startup(unsigned int cpu, struct hlist_node *node)
 		return 0;
 
 	__arm_spe_pmu_setup_one(spe_pmu);
+	if (READ_ONCE(spe_pmu->numa_interval))
+		__arm_spe_numa_start_one(spe_pmu);
 	return 0;
 }
 
@@ -1088,6 +1469,7 @@ static int arm_spe_pmu_cpu_teardown(unsigned int cpu, struct hlist_node *node)
 	if (!cpumask_test_cpu(cpu, &spe_pmu->supported_cpus))
 		return 0;
 
+	__arm_spe_numa_stop_one(spe_pmu);
 	__arm_spe_pmu_stop_one(spe_pmu);
 	return 0;
 }
@@ -1188,6 +1570,7 @@ static int arm_spe_pmu_device_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	spe_pmu->pdev = pdev;
+	mutex_init(&spe_pmu->numa_lock);
 	platform_set_drvdata(pdev, spe_pmu);
 
 	ret = arm_spe_pmu_irq_probe(spe_pmu);
@@ -1215,6 +1598,11 @@ static int arm_spe_pmu_device_remove(struct platform_device *pdev)
 {
 	struct arm_spe_pmu *spe_pmu = platform_get_drvdata(pdev);
 
+	mutex_lock(&spe_pmu->numa_lock);
+	if (spe_pmu->numa_interval)
+		arm_spe_numa_disable(spe_pmu);
+	mutex_unlock(&spe_pmu->numa_lock);
+
 	arm_spe_pmu_perf_destroy(spe_pmu);
 	arm_spe_pmu_dev_teardown(spe_pmu);
 	free_percpu(spe_pmu->handle);
@@ -4,6 +4,7 @@
  */
 
 #include <linux/clk.h>
+#include <linux/io.h>
 #include <linux/log2.h>
 #include <linux/mfd/syscon.h>
 #include <linux/miscdevice.h>
@@ -13,6 +14,10 @@
 #include <linux/platform_device.h>
 #include <linux/poll.h>
 #include <linux/regmap.h>
+#include <linux/sched.h>
+#include <linux/sizes.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #include <linux/aspeed-lpc-ctrl.h>
 
@@ -28,6 +33,9 @@
 #define HICR7 0x8
 #define HICR8 0xc
 
+/* Flash is copied to memory in chunks of this size */
+#define PRELOAD_CHUNK	SZ_64K
+
 struct aspeed_lpc_ctrl {
 	struct miscdevice	miscdev;
 	struct regmap		*regmap;
@@ -37,6 +45,13 @@ struct aspeed_lpc_ctrl {
 	u32		pnor_size;
 	u32		pnor_base;
 	bool			fwh2ahb;
+	/* flash preload, protected by preload_wait.lock */
+	struct work_struct	preload_work;
+	wait_queue_head_t	preload_wait;
+	u32			preload_state;
+	int			preload_error;
+	u32			preload_size;
+	bool			preload_stop;
 };
 
 static struct aspeed_lpc_ctrl *file_aspeed_lpc_ctrl(struct file *file)
@@ -45,6 +60,99 @@ static struct aspeed_lpc_ctrl *file_aspeed_lpc_ctrl(struct file *file)
 			miscdev);
 }
 
+static void aspeed_lpc_ctrl_preload_work(struct work_struct *work)
+{
+	struct aspeed_lpc_ctrl *lpc_ctrl = container_of(work,
+			struct aspeed_lpc_ctrl, preload_work);
+	struct device *dev = lpc_ctrl->miscdev.parent;
+	u32 size = min_t(u32, lpc_ctrl->pnor_size, lpc_ctrl->mem_size);
+	void __iomem *flash;
+	void *mem;
+	u32 done;
+	int rc = 0;
+
+	flash = ioremap(lpc_ctrl->pnor_base, size);
+	mem = memremap(lpc_ctrl->mem_base, size, MEMREMAP_WC);
+	if (!flash || !mem) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	for (done = 0; done < size; done += PRELOAD_CHUNK) {
+		if (READ_ONCE(lpc_ctrl->preload_stop)) {
+			rc = -EINTR;
+			break;
+		}
+
+		memcpy_fromio(mem + done, flash + done,
+			      min_t(u32, size - done, PRELOAD_CHUNK));
+		WRITE_ONCE(lpc_ctrl->preload_size,
+			   min_t(u32, size, done + PRELOAD_CHUNK));
+		cond_resched();
+	}
+
+out:
+	if (mem)
+		memunmap(mem);
+	if (flash)
+		iounmap(flash);
+
+	spin_lock_irq(&lpc_ctrl->preload_wait.lock);
+	lpc_ctrl->preload_error = rc;
+	lpc_ctrl->preload_state = rc ? ASPEED_LPC_CTRL_PRELOAD_FAILED :
+				       ASPEED_LPC_CTRL_PRELOAD_DONE;
+	wake_up_locked_poll(&lpc_ctrl->preload_wait, EPOLLIN);
+	spin_unlock_irq(&lpc_ctrl->preload_wait.lock);
+
+	if (rc)
+		dev_err(dev, "Flash preload failed: %d\n", rc);
+	else
+		dev_info(dev, "Preloaded %u bytes of flash\n", size);
+}
+
+static bool aspeed_lpc_ctrl_preloaded(struct aspeed_lpc_ctrl *lpc_ctrl,
+		u32 offset, u32 size)
+{
+	bool ret;
+
+	spin_lock_irq(&lpc_ctrl->preload_wait.lock);
+	ret = lpc_ctrl->preload_state == ASPEED_LPC_CTRL_PRELOAD_DONE &&
+		offset + size <= lpc_ctrl->preload_size;
+	spin_unlock_irq(&lpc_ctrl->preload_wait.lock);
+
+	return ret;
+}
+
+static __poll_t aspeed_lpc_ctrl_poll(struct file *file, poll_table *wait)
+{
+	struct aspeed_lpc_ctrl *lpc_ctrl = file_aspeed_lpc_ctrl(file);
+	__poll_t mask = 0;
+
+	poll_wait(file, &lpc_ctrl->preload_wait, wait);
+
+	spin_lock_irq(&lpc_ctrl->preload_wait.lock);
+	if (lpc_ctrl->preload_state == ASPEED_LPC_CTRL_PRELOAD_DONE ||
+	    lpc_ctrl->preload_state == ASPEED_LPC_CTRL_PRELOAD_FAILED)
+		mask |= EPOLLIN;
+	spin_unlock_irq(&lpc_ctrl->preload_wait.lock);
+
+	return mask;
+}
+
+static long aspeed_lpc_ctrl_get_preload(struct aspeed_lpc_ctrl *lpc_ctrl,
+		void __user *p)
+{
+	struct aspeed_lpc_ctrl_preload preload = { };
+
+	spin_lock_irq(&lpc_ctrl->preload_wait.lock);
+	preload.state = lpc_ctrl->preload_state;
+	preload.error = lpc_ctrl->preload_error;
+	preload.size = lpc_ctrl->preload_size;
+	spin_unlock_irq(&lpc_ctrl->preload_wait.lock);
+
+	return copy_to_user(p, &preload, sizeof(preload)) ? -EFAULT : 0;
+}
+
 static int aspeed_lpc_ctrl_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	struct aspeed_lpc_ctrl *lpc_ctrl = file_aspeed_lpc_ctrl(file);
@@ -76,6 +184,9 @@ static long aspeed_lpc_ctrl_ioctl(struct file *file, unsigned int cmd,
 	u32 size;
 	long rc;
 
+	if (cmd == ASPEED_LPC_CTRL_IOCTL_GET_PRELOAD)
+		return aspeed_lpc_ctrl_get_preload(lpc_ctrl, p);
+
 	if (copy_from_user(&map, p, sizeof(map)))
 		return -EFAULT;
 
@@ -140,6 +251,16 @@ static long aspeed_lpc_ctrl_ioctl(struct file *file, unsigned int cmd,
 			}
 			addr = lpc_ctrl->pnor_base;
 			size = lpc_ctrl->pnor_size;
+
+			/*
+			 * Serve the host from the RAM copy once the flash has
+			 * been preloaded, the contents are identical and the
+			 * SPI controller is out of the read path.
+			 */
+			if (map.offset + map.size >= map.offset &&
+			    aspeed_lpc_ctrl_preloaded(lpc_ctrl, map.offset,
+						      map.size))
+				addr = lpc_ctrl->mem_base;
 		} else if (map.window_type == ASPEED_LPC_CTRL_WINDOW_MEMORY) {
 			/* If memory-region is not described in device tree */
 			if (!lpc_ctrl->mem_size) {
@@ -206,6 +327,7 @@ static long aspeed_lpc_ctrl_ioctl(struct file *file, unsigned int cmd,
 static const struct file_operations aspeed_lpc_ctrl_fops = {
 	.owner		= THIS_MODULE,
 	.mmap		= aspeed_lpc_ctrl_mmap,
+	.poll		= aspeed_lpc_ctrl_poll,
 	.unlocked_ioctl	= aspeed_lpc_ctrl_ioctl,
 };
 
@@ -291,6 +413,17 @@ static int aspeed_lpc_ctrl_probe(struct platform_device *pdev)
 	if (of_device_is_compatible(dev->of_node, "aspeed,ast2600-lpc-ctrl"))
 		lpc_ctrl->fwh2ahb = true;
 
+	init_waitqueue_head(&lpc_ctrl->preload_wait);
+	INIT_WORK(&lpc_ctrl->preload_work, aspeed_lpc_ctrl_preload_work);
+	if (of_property_read_bool(dev->of_node, "aspeed,flash-preload")) {
+		if (!lpc_ctrl->pnor_size || !lpc_ctrl->mem_size) {
+			dev_err(dev, "Flash preload needs both flash and memory-region\n");
+			rc = -EINVAL;
+			goto err;
+		}
+		lpc_ctrl->preload_state = ASPEED_LPC_CTRL_PRELOAD_RUNNING;
+	}
+
 	lpc_ctrl->miscdev.minor = MISC_DYNAMIC_MINOR;
 	lpc_ctrl->miscdev.name = DEVICE_NAME;
 	lpc_ctrl->miscdev.fops = &aspeed_lpc_ctrl_fops;
@@ -301,6 +434,9 @@ static int aspeed_lpc_ctrl_probe(struct platform_device *pdev)
 		goto err;
 	}
 
+	if (lpc_ctrl->preload_state == ASPEED_LPC_CTRL_PRELOAD_RUNNING)
+		schedule_work(&lpc_ctrl->preload_work);
+
 	return 0;
 
 err:
@@ -312,6 +448,8 @@ static int aspeed_lpc_ctrl_remove(struct platform_device *pdev)
 {
 	struct aspeed_lpc_ctrl *lpc_ctrl = dev_get_drvdata(&pdev->dev);
 
+	WRITE_ONCE(lpc_ctrl->preload_stop, true);
+	cancel_work_sync(&lpc_ctrl->preload_work);
 	misc_deregister(&lpc_ctrl->miscdev);
 	clk_disable_unprepare(lpc_ctrl->clk);
 
@@ -10,23 +10,35 @@
  * 0x80 writes made by the BIOS during the boot process.
  */
 
+#include <linux/aspeed-lpc-snoop.h>
 #include <linux/bitops.h>
 #include <linux/interrupt.h>
 #include <linux/fs.h>
 #include <linux/kfifo.h>
+#include <linux/log2.h>
 #include <linux/mfd/syscon.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/poll.h>
 #include <linux/regmap.h>
+#include <linux/timekeeping.h>
+#include <linux/vmalloc.h>
 
 #define DEVICE_NAME	"aspeed-lpc-snoop"
 
 #define NUM_SNOOP_CHANNELS 2
 #define SNOOP_FIFO_SIZE 2048
+#define SNOOP_RING_DEFAULT_RECORDS 4096
+#define SNOOP_RING_MAX_RECORDS 65536
+
+static unsigned int ring_records = SNOOP_RING_DEFAULT_RECORDS;
+module_param(ring_records, uint, 0444);
+MODULE_PARM_DESC(ring_records,
+		 "Timestamped POST code records per channel, rounded up to a power of two (default 4096)");
 
 #define HICR5	0x0
 #define HICR5_EN_SNP0W		BIT(0)
@@ -62,6 +74,9 @@ struct aspeed_lpc_snoop_channel {
 	struct kfifo		fifo;
 	wait_queue_head_t	wq;
 	struct miscdevice	miscdev;
+	/* Timestamped record ring shared with userspace through mmap */
+	struct aspeed_lpc_snoop_ring *ring;
+	size_t			ring_size;
 };
 
 struct aspeed_lpc_snoop {
@@ -106,20 +121,56 @@ static __poll_t snoop_file_poll(struct file *file,
 	return !kfifo_is_empty(&chan->fifo) ? EPOLLIN : 0;
 }
 
+static int snoop_file_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct aspeed_lpc_snoop_channel *chan = snoop_file_to_chan(file);
+
+	/* The ring is written by the kernel only */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	if (vma->vm_end - vma->vm_start > chan->ring_size)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, chan->ring, vma->vm_pgoff);
+}
+
 static const struct file_operations snoop_fops = {
 	.owner  = THIS_MODULE,
 	.read   = snoop_file_read,
 	.poll   = snoop_file_poll,
+	.mmap   = snoop_file_mmap,
 	.llseek = noop_llseek,
 };
 
+/* Append a timestamped record, overwriting the oldest one when full */
+static void put_ring_record(struct aspeed_lpc_snoop_channel *chan, u8 val)
+{
+	struct aspeed_lpc_snoop_ring *ring = chan->ring;
+	struct aspeed_lpc_snoop_record *rec;
+	u64 head = ring->head;
+
+	rec = &ring->records[head & (ring->nr_records - 1)];
+	rec->timestamp = ktime_get_ns();
+	rec->code = val;
+
+	/* Publish the record before the new head becomes visible */
+	smp_wmb();
+	WRITE_ONCE(ring->head, head + 1);
+}
+
 /* Save a byte to a FIFO and discard the oldest byte if FIFO is full */
 static void put_fifo_with_discard(struct aspeed_lpc_snoop_channel *chan, u8 val)
 {
 	if (!kfifo_initialized(&chan->fifo))
 		return;
-	if (kfifo_is_full(&chan->fifo))
+	put_ring_record(chan, val);
+	if (kfifo_is_full(&chan->fifo)) {
 		kfifo_skip(&chan->fifo);
+		WRITE_ONCE(chan->ring->fifo_dropped,
+			   chan->ring->fifo_dropped + 1);
+	}
 	kfifo_put(&chan->fifo, val);
 	wake_up_interruptible(&chan->wq);
 }
@@ -187,13 +238,30 @@ static int aspeed_lpc_enable_snoop(struct aspeed_lpc_snoop *lpc_snoop,
 	u32 hicr5_en, snpwadr_mask, snpwadr_shift, hicrb_en;
 	const struct aspeed_lpc_snoop_model_data *model_data =
 		of_device_get_match_data(dev);
+	struct aspeed_lpc_snoop_channel *chan = &lpc_snoop->chan[channel];
+	unsigned int nr_records;
 
 	init_waitqueue_head(&lpc_snoop->chan[channel].wq);
+
+	/* Create the timestamped record ring before the FIFO goes live */
+	nr_records = roundup_pow_of_two(clamp_val(ring_records, 1,
+						  SNOOP_RING_MAX_RECORDS));
+	chan->ring_size = PAGE_ALIGN(struct_size(chan->ring, records,
+						 nr_records));
+	chan->ring = vmalloc_user(chan->ring_size);
+	if (!chan->ring)
+		return -ENOMEM;
+	chan->ring->magic = ASPEED_LPC_SNOOP_RING_MAGIC;
+	chan->ring->nr_records = nr_records;
+
 	/* Create FIFO datastructure */
 	rc = kfifo_alloc(&lpc_snoop->chan[channel].fifo,
 			 SNOOP_FIFO_SIZE, GFP_KERNEL);
-	if (rc)
+	if (rc) {
+		vfree(chan->ring);
+		chan->ring = NULL;
 		return rc;
+	}
 
 	lpc_snoop->chan[channel].miscdev.minor = MISC_DYNAMIC_MINOR;
 	lpc_snoop->chan[channel].miscdev.name =
@@ -252,6 +320,8 @@ static void aspeed_lpc_disable_snoop(struct aspeed_lpc_snoop *lpc_snoop,
 
 	kfifo_free(&lpc_snoop->chan[channel].fifo);
 	misc_deregister(&lpc_snoop->chan[channel].miscdev);
+	vfree(lpc_snoop->chan[channel].ring);
+	lpc_snoop->chan[channel].ring = NULL;
 }
 
 static int aspeed_lpc_snoop_probe(struct platform_device *pdev)
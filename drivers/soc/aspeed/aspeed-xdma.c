@@ -7,6 +7,7 @@
 #include <linux/delay.h>
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
+#include <linux/eventfd.h>
 #include <linux/fs.h>
 #include <linux/genalloc.h>
 #include <linux/interrupt.h>
@@ -191,6 +192,8 @@ struct aspeed_xdma_chip {
 	u32 scu_misc_ctrl;
 	u32 scu_pcie_conf;
 	unsigned int queue_entry_size;
+	/* command bits requesting a BMC completion interrupt */
+	u64 cmd_irq_bits;
 	struct aspeed_xdma_regs regs;
 	struct aspeed_xdma_status_bits status_bits;
 	unsigned int (*set_cmd)(struct aspeed_xdma *ctx,
@@ -245,6 +248,7 @@ struct aspeed_xdma_client {
 
 	bool error;
 	bool in_progress;
+	struct eventfd_ctx *event;
 	void *virt;
 	dma_addr_t phys;
 	u32 size;
@@ -421,7 +425,7 @@ static unsigned int aspeed_xdma_ast2600_set_cmd(struct aspeed_xdma *ctx,
 }
 
 static int aspeed_xdma_start(struct aspeed_xdma *ctx, unsigned int num_cmds,
-			     struct aspeed_xdma_cmd cmds[2], bool upstream,
+			     struct aspeed_xdma_cmd *cmds, bool upstream,
 			     struct aspeed_xdma_client *client)
 {
 	unsigned int i;
@@ -472,6 +476,8 @@ static void aspeed_xdma_done(struct aspeed_xdma *ctx, bool error)
 	if (ctx->current_client) {
 		ctx->current_client->error = error;
 		ctx->current_client->in_progress = false;
+		if (ctx->current_client->event)
+			eventfd_signal(ctx->current_client->event, 1);
 		ctx->current_client = NULL;
 	}
 	spin_unlock_irqrestore(&ctx->client_lock, flags);
@@ -556,30 +562,15 @@ static irqreturn_t aspeed_xdma_pcie_irq(int irq, void *arg)
 	return IRQ_HANDLED;
 }
 
-static ssize_t aspeed_xdma_write(struct file *file, const char __user *buf,
-				 size_t len, loff_t *offset)
+static int aspeed_xdma_submit(struct file *file, unsigned int num_cmds,
+			      struct aspeed_xdma_cmd *cmds, bool upstream)
 {
 	int rc;
-	unsigned int num_cmds;
-	struct aspeed_xdma_op op;
-	struct aspeed_xdma_cmd cmds[2];
 	struct aspeed_xdma_client *client = file->private_data;
 	struct aspeed_xdma *ctx = client->ctx;
 
-	if (len != sizeof(op))
-		return -EINVAL;
-
-	if (copy_from_user(&op, buf, len))
-		return -EFAULT;
-
-	if (!op.len || op.len > client->size ||
-	    op.direction > ASPEED_XDMA_DIRECTION_UPSTREAM)
-		return -EINVAL;
-
-	num_cmds = ctx->chip->set_cmd(ctx, cmds, &op, client->phys);
 	do {
-		rc = aspeed_xdma_start(ctx, num_cmds, cmds, !!op.direction,
-				       client);
+		rc = aspeed_xdma_start(ctx, num_cmds, cmds, upstream, client);
 		if (!rc)
 			break;
 
@@ -603,9 +594,132 @@ static ssize_t aspeed_xdma_write(struct file *file, const char __user *buf,
 			return -EIO;
 	}
 
+	return 0;
+}
+
+static ssize_t aspeed_xdma_write(struct file *file, const char __user *buf,
+				 size_t len, loff_t *offset)
+{
+	int rc;
+	unsigned int num_cmds;
+	struct aspeed_xdma_op op;
+	struct aspeed_xdma_cmd cmds[2];
+	struct aspeed_xdma_client *client = file->private_data;
+	struct aspeed_xdma *ctx = client->ctx;
+
+	if (len != sizeof(op))
+		return -EINVAL;
+
+	if (copy_from_user(&op, buf, len))
+		return -EFAULT;
+
+	if (!op.len || op.len > client->size ||
+	    op.direction > ASPEED_XDMA_DIRECTION_UPSTREAM)
+		return -EINVAL;
+
+	num_cmds = ctx->chip->set_cmd(ctx, cmds, &op, client->phys);
+	rc = aspeed_xdma_submit(file, num_cmds, cmds, !!op.direction);
+	if (rc)
+		return rc;
+
 	return len;
 }
 
+static int aspeed_xdma_set_eventfd(struct aspeed_xdma_client *client,
+				   int fd)
+{
+	struct eventfd_ctx *event = NULL;
+	struct eventfd_ctx *old;
+	unsigned long flags;
+
+	if (fd >= 0) {
+		event = eventfd_ctx_fdget(fd);
+		if (IS_ERR(event))
+			return PTR_ERR(event);
+	}
+
+	spin_lock_irqsave(&client->ctx->client_lock, flags);
+	old = client->event;
+	client->event = event;
+	spin_unlock_irqrestore(&client->ctx->client_lock, flags);
+
+	if (old)
+		eventfd_ctx_put(old);
+
+	return 0;
+}
+
+static int aspeed_xdma_submit_batch(struct file *file,
+				    struct aspeed_xdma_batch __user *ubatch)
+{
+	int rc;
+	unsigned int i;
+	unsigned int num_cmds = 0;
+	struct aspeed_xdma_batch batch;
+	struct aspeed_xdma_segment *segs;
+	struct aspeed_xdma_cmd *cmds;
+	struct aspeed_xdma_client *client = file->private_data;
+	struct aspeed_xdma *ctx = client->ctx;
+
+	BUILD_BUG_ON(ASPEED_XDMA_MAX_SEGMENTS * 2 >= XDMA_NUM_CMDS);
+
+	if (copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+
+	if (!batch.num_segments ||
+	    batch.num_segments > ASPEED_XDMA_MAX_SEGMENTS ||
+	    batch.direction > ASPEED_XDMA_DIRECTION_UPSTREAM ||
+	    batch.reserved)
+		return -EINVAL;
+
+	segs = memdup_user(u64_to_user_ptr(batch.segments),
+			   batch.num_segments * sizeof(*segs));
+	if (IS_ERR(segs))
+		return PTR_ERR(segs);
+
+	/* Each segment may need a second command for the remainder */
+	cmds = kmalloc_array(batch.num_segments * 2, sizeof(*cmds),
+			     GFP_KERNEL);
+	if (!cmds) {
+		rc = -ENOMEM;
+		goto free_segs;
+	}
+
+	for (i = 0; i < batch.num_segments; ++i) {
+		struct aspeed_xdma_op op = {
+			.host_addr = segs[i].host_addr,
+			.len = segs[i].len,
+			.direction = batch.direction,
+		};
+
+		if (!op.len || segs[i].bmc_offset >= client->size ||
+		    op.len > client->size - segs[i].bmc_offset) {
+			rc = -EINVAL;
+			goto free_cmds;
+		}
+
+		num_cmds += ctx->chip->set_cmd(ctx, &cmds[num_cmds], &op,
+					       client->phys +
+					       segs[i].bmc_offset);
+	}
+
+	/* Only the last command of the batch raises a completion IRQ */
+	for (i = 0; i < num_cmds - 1; ++i)
+		cmds[i].cmd &= ~ctx->chip->cmd_irq_bits;
+
+	rc = aspeed_xdma_set_eventfd(client, batch.eventfd);
+	if (rc)
+		goto free_cmds;
+
+	rc = aspeed_xdma_submit(file, num_cmds, cmds, !!batch.direction);
+
+free_cmds:
+	kfree(cmds);
+free_segs:
+	kfree(segs);
+	return rc;
+}
+
 static __poll_t aspeed_xdma_poll(struct file *file,
 				 struct poll_table_struct *wait)
 {
@@ -661,6 +775,8 @@ static long aspeed_xdma_ioctl(struct file *file, unsigned int cmd,
 
 		aspeed_xdma_reset(ctx);
 		break;
+	case ASPEED_XDMA_IOCTL_SUBMIT:
+		return aspeed_xdma_submit_batch(file, (void __user *)param);
 	default:
 		return -EINVAL;
 	}
@@ -777,6 +893,9 @@ static int aspeed_xdma_release(struct inode *inode, struct file *file)
 		gen_pool_free(ctx->pool, (unsigned long)client->virt,
 			      client->size);
 
+	if (client->event)
+		eventfd_ctx_put(client->event);
+
 	kfree(client);
 	kobject_put(&ctx->kobj);
 	return 0;
@@ -1137,6 +1256,8 @@ static const struct aspeed_xdma_chip aspeed_ast2500_xdma_chip = {
 	.scu_misc_ctrl = 0,
 	.scu_pcie_conf = SCU_AST2500_PCIE_CONF,
 	.queue_entry_size = XDMA_AST2500_QUEUE_ENTRY_SIZE,
+	.cmd_irq_bits = XDMA_CMD_AST2500_CMD_IRQ_EN |
+		XDMA_CMD_AST2500_CMD_IRQ_BMC,
 	.regs = {
 		.bmc_cmdq_addr = XDMA_AST2500_BMC_CMDQ_ADDR,
 		.bmc_cmdq_endp = XDMA_AST2500_BMC_CMDQ_ENDP,
@@ -1160,6 +1281,7 @@ static const struct aspeed_xdma_chip aspeed_ast2600_xdma_chip = {
 	.scu_misc_ctrl = SCU_AST2600_MISC_CTRL,
 	.scu_pcie_conf = SCU_AST2600_PCIE_CONF,
 	.queue_entry_size = XDMA_AST2600_QUEUE_ENTRY_SIZE,
+	.cmd_irq_bits = XDMA_CMD_AST2600_CMD_IRQ_BMC,
 	.regs = {
 		.bmc_cmdq_addr = XDMA_AST2600_BMC_CMDQ_ADDR,
 		.bmc_cmdq_endp = XDMA_AST2600_BMC_CMDQ_ENDP,
@@ -17,6 +17,7 @@
 #include <linux/slab.h>
 #include <linux/sched/mm.h>
 #include <linux/log2.h>
+#include <linux/percpu.h>
 #include <crypto/hash.h>
 #include "misc.h"
 #include "ctree.h"
@@ -957,6 +958,8 @@ static void btrfs_init_workspace_manager(int type)
 	spin_lock_init(&wsm->ws_lock);
 	atomic_set(&wsm->total_ws, 0);
 	init_waitqueue_head(&wsm->ws_wait);
+	/* The per-CPU cache is an optimization, carry on without it */
+	wsm->pcpu_ws = alloc_percpu(struct list_head *);
 
 	/*
 	 * Preallocate one workspace for each compression type so we can
@@ -985,6 +988,59 @@ static void btrfs_cleanup_workspace_manager(int type)
 		free_workspace(type, ws);
 		atomic_dec(&wsman->total_ws);
 	}
+
+	if (wsman->pcpu_ws) {
+		int cpu;
+
+		for_each_possible_cpu(cpu) {
+			ws = *per_cpu_ptr(wsman->pcpu_ws, cpu);
+			if (ws) {
+				free_workspace(type, ws);
+				atomic_dec(&wsman->total_ws);
+			}
+		}
+		free_percpu(wsman->pcpu_ws);
+		wsman->pcpu_ws = NULL;
+	}
+}
+
+/*
+ * Take an idle workspace from the per-CPU cache, the local CPU first.
+ * Workspaces cached on other CPUs must be found before waiting, they would
+ * otherwise stay idle while we sleep.
+ */
+static struct list_head *get_cached_workspace(struct workspace_manager *wsm,
+					      bool any_cpu)
+{
+	struct list_head *ws;
+	int cpu;
+
+	if (!wsm->pcpu_ws)
+		return NULL;
+
+	ws = this_cpu_xchg(*wsm->pcpu_ws, NULL);
+	if (ws || !any_cpu)
+		return ws;
+
+	for_each_possible_cpu(cpu) {
+		ws = xchg(per_cpu_ptr(wsm->pcpu_ws, cpu), NULL);
+		if (ws)
+			return ws;
+	}
+	return NULL;
+}
+
+static bool have_cached_workspace(struct workspace_manager *wsm)
+{
+	int cpu;
+
+	if (!wsm->pcpu_ws)
+		return false;
+
+	for_each_possible_cpu(cpu)
+		if (READ_ONCE(*per_cpu_ptr(wsm->pcpu_ws, cpu)))
+			return true;
+	return false;
 }
 
 /*
@@ -1012,6 +1068,9 @@ struct list_head *btrfs_get_workspace(int type, unsigned int level)
 	ws_wait	 = &wsm->ws_wait;
 	free_ws	 = &wsm->free_ws;
 
+	workspace = get_cached_workspace(wsm, false);
+	if (workspace)
+		return workspace;
 again:
 	spin_lock(ws_lock);
 	if (!list_empty(idle_ws)) {
@@ -1026,8 +1085,12 @@ struct list_head *btrfs_get_workspace(int type, unsigned int level)
 		DEFINE_WAIT(wait);
 
 		spin_unlock(ws_lock);
+		workspace = get_cached_workspace(wsm, true);
+		if (workspace)
+			return workspace;
 		prepare_to_wait(ws_wait, &wait, TASK_UNINTERRUPTIBLE);
-		if (atomic_read(total_ws) > cpus && !*free_ws)
+		if (atomic_read(total_ws) > cpus && !*free_ws &&
+		    !have_cached_workspace(wsm))
 			schedule();
 		finish_wait(ws_wait, &wait);
 		goto again;
@@ -1108,6 +1171,10 @@ void btrfs_put_workspace(int type, struct list_head *ws)
 	ws_wait	 = &wsm->ws_wait;
 	free_ws	 = &wsm->free_ws;
 
+	/* Keep one workspace on this CPU, without touching ws_lock */
+	if (wsm->pcpu_ws && !this_cpu_cmpxchg(*wsm->pcpu_ws, NULL, ws))
+		goto wake;
+
 	spin_lock(ws_lock);
 	if (*free_ws <= num_online_cpus()) {
 		list_add(ws, idle_ws);
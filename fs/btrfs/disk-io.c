@@ -2172,6 +2172,21 @@ static void btrfs_init_qgroup(struct btrfs_fs_info *fs_info)
 	mutex_init(&fs_info->qgroup_rescan_lock);
 }
 
+/*
+ * Compression of delalloc ranges runs from the delalloc workers. Unless
+ * the thread pool was sized explicitly, let them scale up to all online
+ * CPUs instead of the default thread pool cap. The workers grow on demand
+ * as async chunks back up, and shrink again once they drain.
+ */
+static u32 btrfs_delalloc_max_active(struct btrfs_fs_info *fs_info)
+{
+	u32 max_active = fs_info->thread_pool_size;
+
+	if (max_active == min_t(unsigned long, num_online_cpus() + 2, 8))
+		max_active = max_t(u32, max_active, num_online_cpus());
+	return max_active;
+}
+
 static int btrfs_init_workqueues(struct btrfs_fs_info *fs_info,
 		struct btrfs_fs_devices *fs_devices)
 {
@@ -2183,8 +2198,8 @@ static int btrfs_init_workqueues(struct btrfs_fs_info *fs_info,
 				      flags | WQ_HIGHPRI, max_active, 16);
 
 	fs_info->delalloc_workers =
-		btrfs_alloc_workqueue(fs_info, "delalloc",
-				      flags, max_active, 2);
+		btrfs_alloc_workqueue(fs_info, "delalloc", flags,
+				      btrfs_delalloc_max_active(fs_info), 0);
 
 	fs_info->flush_workers =
 		btrfs_alloc_workqueue(fs_info, "flush_delalloc",
@@ -53,6 +53,9 @@ struct erofs_fs_context {
 
 	/* threshold for decompression synchronously */
 	unsigned int max_sync_decompress_pages;
+
+	/* max pclusters to decompress in a sleepable I/O completion context */
+	unsigned int max_endio_decompress_pclusters;
 #endif
 	unsigned int mount_opt;
 };
@@ -200,6 +200,7 @@ static void erofs_default_options(struct erofs_fs_context *ctx)
 #ifdef CONFIG_EROFS_FS_ZIP
 	ctx->cache_strategy = EROFS_ZIP_CACHE_READAROUND;
 	ctx->max_sync_decompress_pages = 3;
+	ctx->max_endio_decompress_pclusters = 1;
 #endif
 #ifdef CONFIG_EROFS_FS_XATTR
 	set_opt(ctx, XATTR_USER);
@@ -215,6 +216,7 @@ enum {
 	Opt_acl,
 	Opt_noacl,
 	Opt_cache_strategy,
+	Opt_sync_decompress,
 	Opt_err
 };
 
@@ -230,6 +232,7 @@ static const struct fs_parameter_spec erofs_fs_parameters[] = {
 	fsparam_flag_no("acl",		Opt_acl),
 	fsparam_enum("cache_strategy",	Opt_cache_strategy,
 		     erofs_param_cache_strategy),
+	fsparam_u32("sync_decompress",	Opt_sync_decompress),
 	{}
 };
 
@@ -270,6 +273,13 @@ static int erofs_fc_parse_param(struct fs_context *fc,
 		ctx->cache_strategy = result.uint_32;
 #else
 		errorfc(fc, "compression not supported, cache_strategy ignored");
+#endif
+		break;
+	case Opt_sync_decompress:
+#ifdef CONFIG_EROFS_FS_ZIP
+		ctx->max_endio_decompress_pclusters = result.uint_32;
+#else
+		errorfc(fc, "compression not supported, sync_decompress ignored");
 #endif
 		break;
 	default:
@@ -592,6 +602,8 @@ static int erofs_show_options(struct seq_file *seq, struct dentry *root)
 		seq_puts(seq, ",cache_strategy=readahead");
 	else if (ctx->cache_strategy == EROFS_ZIP_CACHE_READAROUND)
 		seq_puts(seq, ",cache_strategy=readaround");
+	seq_printf(seq, ",sync_decompress=%u",
+		   ctx->max_endio_decompress_pclusters);
 #endif
 	return 0;
 }
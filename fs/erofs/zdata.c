@@ -694,6 +694,22 @@ static int z_erofs_do_read_page(struct z_erofs_decompress_frontend *fe,
 	goto out;
 }
 
+static void z_erofs_decompressqueue_work(struct work_struct *work);
+
+/*
+ * Decompress right in the i/o completion context rather than bouncing to
+ * the workqueue if it can sleep (e.g. dm-verity and loop complete reads
+ * from process context) and the queue is small enough.
+ */
+static bool z_erofs_endio_decompress(struct z_erofs_decompressqueue *io)
+{
+	if (!IS_ENABLED(CONFIG_PREEMPT_COUNT) || in_atomic() || irqs_disabled())
+		return false;
+
+	return io->nr_pclusters <=
+		EROFS_SB(io->sb)->ctx.max_endio_decompress_pclusters;
+}
+
 static void z_erofs_decompress_kickoff(struct z_erofs_decompressqueue *io,
 				       bool sync, int bios)
 {
@@ -708,7 +724,12 @@ static void z_erofs_decompress_kickoff(struct z_erofs_decompressqueue *io,
 		return;
 	}
 
-	if (!atomic_add_return(bios, &io->pending_bios))
+	if (atomic_add_return(bios, &io->pending_bios))
+		return;
+
+	if (z_erofs_endio_decompress(io))
+		z_erofs_decompressqueue_work(&io->u.work);
+	else
 		queue_work(z_erofs_workqueue, &io->u.work);
 }
 
@@ -961,19 +982,83 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 	}
 }
 
-static void z_erofs_decompressqueue_work(struct work_struct *work)
+static void __z_erofs_decompressqueue_work(struct z_erofs_decompressqueue *bgq)
 {
-	struct z_erofs_decompressqueue *bgq =
-		container_of(work, struct z_erofs_decompressqueue, u.work);
 	LIST_HEAD(pagepool);
 
-	DBG_BUGON(bgq->head == Z_EROFS_PCLUSTER_TAIL_CLOSED);
 	z_erofs_decompress_queue(bgq, &pagepool);
 
 	put_pages_list(&pagepool);
 	kvfree(bgq);
 }
 
+static void z_erofs_decompressqueue_subwork(struct work_struct *work)
+{
+	__z_erofs_decompressqueue_work(container_of(work,
+			struct z_erofs_decompressqueue, u.work));
+}
+
+/*
+ * pclusters in a queue are independent of each other, so split a long
+ * queue into up to one chunk per online cpu and hand all but the first
+ * chunk to other workers.  Whatever can't be split off for lack of memory
+ * simply stays on the current queue.
+ */
+static void z_erofs_decompressqueue_split(struct z_erofs_decompressqueue *io)
+{
+	z_erofs_next_pcluster_t owned = io->head;
+	struct z_erofs_decompressqueue *q, *prev = NULL;
+	struct z_erofs_pcluster *pcl;
+	unsigned int nr = 0, per, i;
+
+	while (owned != Z_EROFS_PCLUSTER_TAIL_CLOSED) {
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+		++nr;
+	}
+
+	i = min(nr, num_online_cpus());
+	if (i <= 1)
+		return;
+	per = DIV_ROUND_UP(nr, i);
+
+	owned = io->head;
+	while (nr > per) {
+		/* find the last pcluster of the current chunk */
+		for (i = 0; i < per; ++i) {
+			pcl = container_of(owned, struct z_erofs_pcluster, next);
+			owned = READ_ONCE(pcl->next);
+		}
+
+		q = kvzalloc(sizeof(*q), GFP_NOIO | __GFP_NOWARN);
+		if (!q)
+			break;
+
+		/* close the current chunk, which can then be handed out */
+		WRITE_ONCE(pcl->next, Z_EROFS_PCLUSTER_TAIL_CLOSED);
+		if (prev)
+			queue_work(z_erofs_workqueue, &prev->u.work);
+
+		q->sb = io->sb;
+		q->head = owned;
+		INIT_WORK(&q->u.work, z_erofs_decompressqueue_subwork);
+		prev = q;
+		nr -= per;
+	}
+	if (prev)
+		queue_work(z_erofs_workqueue, &prev->u.work);
+}
+
+static void z_erofs_decompressqueue_work(struct work_struct *work)
+{
+	struct z_erofs_decompressqueue *bgq =
+		container_of(work, struct z_erofs_decompressqueue, u.work);
+
+	DBG_BUGON(bgq->head == Z_EROFS_PCLUSTER_TAIL_CLOSED);
+	z_erofs_decompressqueue_split(bgq);
+	__z_erofs_decompressqueue_work(bgq);
+}
+
 static struct page *pickup_page_for_submission(struct z_erofs_pcluster *pcl,
 					       unsigned int nr,
 					       struct list_head *pagepool,
@@ -1107,6 +1192,7 @@ jobqueue_init(struct super_block *sb,
 	}
 	q->sb = sb;
 	q->head = Z_EROFS_PCLUSTER_TAIL_CLOSED;
+	q->nr_pclusters = 0;
 	return q;
 }
 
@@ -1227,10 +1313,12 @@ static void z_erofs_submit_queue(struct super_block *sb,
 			bypass = false;
 		} while (++cur < end);
 
-		if (!bypass)
+		if (!bypass) {
 			qtail[JQ_SUBMIT] = &pcl->next;
-		else
+			++q[JQ_SUBMIT]->nr_pclusters;
+		} else {
 			move_to_bypass_jobqueue(pcl, qtail, owned_head);
+		}
 	} while (owned_head != Z_EROFS_PCLUSTER_TAIL);
 
 	if (bio)
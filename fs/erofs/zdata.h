@@ -88,6 +88,8 @@ struct z_erofs_decompressqueue {
 	struct super_block *sb;
 	atomic_t pending_bios;
 	z_erofs_next_pcluster_t head;
+	/* pclusters which need i/o, only counted for submission queues */
+	unsigned int nr_pclusters;
 
 	union {
 		wait_queue_head_t wait;
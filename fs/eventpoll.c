@@ -15,6 +15,9 @@
 #include <linux/errno.h>
 #include <linux/mm.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/bitmap.h>
+#include <linux/log2.h>
 #include <linux/poll.h>
 #include <linux/string.h>
 #include <linux/list.h>
@@ -157,6 +160,9 @@ struct epitem {
 	/* Number of active wait queue attached to poll operations */
 	int nwait;
 
+	/* Slot in the user ring items array, when the ep has one */
+	int bit;
+
 	/* List containing poll wait queues */
 	struct list_head pwqlist;
 
@@ -220,6 +226,19 @@ struct eventpoll {
 	/* used to optimize loop detection check */
 	u64 gen;
 
+	/*
+	 * Ring shared with userspace, see EPIOCSETUPRING.  Set once under
+	 * "mtx" while the ep has no items and never changed afterwards.
+	 */
+	struct epoll_uheader *user_header;
+	unsigned int *user_index;
+	unsigned int user_index_mask;
+	unsigned int user_max_items;
+
+	/* Item slots in use, and slots of removed items still in the ring */
+	unsigned long *items_bm;
+	unsigned long *removed_bm;
+
 #ifdef CONFIG_NET_RX_BUSY_POLL
 	/* used to track busy poll napi_id */
 	unsigned int napi_id;
@@ -364,6 +383,25 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
 	spin_lock_init(&ncalls->lock);
 }
 
+/* Limit on the number of items of the user ring */
+#define EP_USER_MAX_ITEMS (1U << 20)
+
+static inline bool ep_polled_by_user(struct eventpoll *ep)
+{
+	return !!READ_ONCE(ep->user_header);
+}
+
+/* Number of index ring entries userspace has not consumed yet */
+static inline int ep_uring_events_available(struct eventpoll *ep)
+{
+	struct epoll_uheader *header = ep->user_header;
+	unsigned int nr;
+
+	nr = READ_ONCE(header->tail) - READ_ONCE(header->head);
+
+	return min(nr, ep->user_index_mask + 1);
+}
+
 /**
  * ep_events_available - Checks if ready events might be available.
  *
@@ -374,6 +412,9 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
  */
 static inline int ep_events_available(struct eventpoll *ep)
 {
+	if (ep_polled_by_user(ep))
+		return ep_uring_events_available(ep);
+
 	return !list_empty_careful(&ep->rdllist) ||
 		READ_ONCE(ep->ovflist) != EP_UNACTIVE_PTR;
 }
@@ -397,7 +438,8 @@ static void ep_busy_loop(struct eventpoll *ep, int nonblock)
 	unsigned int napi_id = READ_ONCE(ep->napi_id);
 
 	if ((napi_id >= MIN_NAPI_ID) && net_busy_loop_on())
-		napi_busy_loop(napi_id, nonblock ? NULL : ep_busy_loop_end, ep);
+		napi_busy_loop(napi_id, nonblock ? NULL : ep_busy_loop_end, ep,
+			       false);
 }
 
 static inline void ep_reset_busy_poll_napi_id(struct eventpoll *ep)
@@ -760,6 +802,93 @@ static void epi_rcu_free(struct rcu_head *head)
 	kmem_cache_free(epi_cache, epi);
 }
 
+/*
+ * Finds a free slot in the user ring items array. Slots of removed items
+ * are only reused once userspace has consumed their last ring entry, which
+ * it signals by clearing ready_events. Must be called with "mtx" held.
+ */
+static int ep_alloc_user_item(struct eventpoll *ep)
+{
+	unsigned int max = ep->user_max_items;
+	unsigned int bit;
+
+	bit = find_first_zero_bit(ep->items_bm, max);
+	if (bit >= max) {
+		for_each_set_bit(bit, ep->removed_bm, max) {
+			if (READ_ONCE(ep->user_header->items[bit].ready_events))
+				continue;
+			__clear_bit(bit, ep->removed_bm);
+			__clear_bit(bit, ep->items_bm);
+		}
+		bit = find_first_zero_bit(ep->items_bm, max);
+		if (bit >= max)
+			return -ENOSPC;
+	}
+	__set_bit(bit, ep->items_bm);
+
+	return bit;
+}
+
+/*
+ * Marks the slot of a removed item. If it is still queued in the ring,
+ * userspace races with us for ready_events, so either it sees EPOLLREMOVED
+ * and the slot is reclaimed later, or it got the events first and the slot
+ * is free right away. Must be called with "mtx" held.
+ */
+static void ep_remove_user_item(struct eventpoll *ep, int bit)
+{
+	struct epoll_uitem *uitem = &ep->user_header->items[bit];
+	__poll_t old, ready = READ_ONCE(uitem->ready_events);
+
+	while (ready) {
+		old = cmpxchg(&uitem->ready_events, ready, EPOLLREMOVED);
+		if (old == ready) {
+			__set_bit(bit, ep->removed_bm);
+			return;
+		}
+		ready = old;
+	}
+	__clear_bit(bit, ep->items_bm);
+}
+
+/*
+ * Queues @epi into the user ring. Items are queued at most once, from the
+ * moment ready_events becomes non-zero until userspace takes them, so the
+ * index ring, being as large as the items array, can never overflow. The
+ * fully ordered tail increment pairs with the barrier in ep_poll(), which
+ * lets the callback skip ep->lock unless there is a waiter.
+ *
+ * Returns true if the item was queued, false if it was already queued or
+ * the events are not of interest.
+ */
+static bool ep_add_event_to_uring(struct epitem *epi, __poll_t pollflags)
+{
+	struct eventpoll *ep = epi->ep;
+	struct epoll_uheader *header = ep->user_header;
+	struct epoll_uitem *uitem = &header->items[epi->bit];
+	__poll_t events = READ_ONCE(epi->event.events);
+	unsigned int idx;
+
+	if (!(events & ~EP_PRIVATE_BITS))
+		return false;
+	if (pollflags && !(pollflags & events))
+		return false;
+	/* Keyless wakeups report all the events the item is interested in */
+	if (!pollflags)
+		pollflags = events;
+	pollflags &= events & ~EP_PRIVATE_BITS;
+
+	if (atomic_fetch_or((__force int)pollflags,
+			    (atomic_t *)&uitem->ready_events))
+		return false;
+
+	idx = atomic_fetch_inc((atomic_t *)&header->tail) & ep->user_index_mask;
+	/* Zero marks an entry not written yet, so store the slot plus one */
+	smp_store_release(&ep->user_index[idx], epi->bit + 1);
+
+	return true;
+}
+
 /*
  * Removes a "struct epitem" from the eventpoll RB tree and deallocates
  * all the associated resources. Must be called with "mtx" held.
@@ -775,6 +904,10 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 	 */
 	ep_unregister_pollwait(ep, epi);
 
+	/* No callback can hit the item anymore, release its ring slot */
+	if (ep_polled_by_user(ep))
+		ep_remove_user_item(ep, epi->bit);
+
 	/* Remove the current item from the list of epoll hooks */
 	spin_lock(&file->f_lock);
 	list_del_rcu(&epi->fllink);
@@ -851,6 +984,9 @@ static void ep_free(struct eventpoll *ep)
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	wakeup_source_unregister(ep->ws);
+	vfree(ep->user_header);
+	bitmap_free(ep->items_bm);
+	bitmap_free(ep->removed_bm);
 	kfree(ep);
 }
 
@@ -886,6 +1022,9 @@ static __poll_t ep_item_poll(const struct epitem *epi, poll_table *pt,
 
 	ep = epi->ffd.file->private_data;
 	poll_wait(epi->ffd.file, &ep->poll_wait, pt);
+	if (ep_polled_by_user(ep))
+		return ep_uring_events_available(ep) ?
+			(EPOLLIN | EPOLLRDNORM) & epi->event.events : 0;
 	locked = pt && (pt->_qproc == ep_ptable_queue_proc);
 
 	return ep_scan_ready_list(epi->ffd.file->private_data,
@@ -928,6 +1067,9 @@ static __poll_t ep_eventpoll_poll(struct file *file, poll_table *wait)
 	/* Insert inside our poll wait queue */
 	poll_wait(file, &ep->poll_wait, wait);
 
+	if (ep_polled_by_user(ep))
+		return ep_uring_events_available(ep) ? EPOLLIN | EPOLLRDNORM : 0;
+
 	/*
 	 * Proceed to find out if wanted events are really available inside
 	 * the ready list.
@@ -960,6 +1102,82 @@ static void ep_show_fdinfo(struct seq_file *m, struct file *f)
 }
 #endif
 
+static int ep_setup_user_ring(struct eventpoll *ep, u32 max_items)
+{
+	struct epoll_uheader *header;
+	unsigned long *items_bm, *removed_bm;
+	unsigned int header_length, index_length;
+	int error;
+
+	if (!max_items || max_items > EP_USER_MAX_ITEMS)
+		return -EINVAL;
+	max_items = roundup_pow_of_two(max_items);
+
+	header_length = PAGE_ALIGN(struct_size(header, items, max_items));
+	index_length = PAGE_ALIGN(max_items * sizeof(*ep->user_index));
+
+	items_bm = bitmap_zalloc(max_items, GFP_KERNEL);
+	removed_bm = bitmap_zalloc(max_items, GFP_KERNEL);
+	header = vmalloc_user(header_length + index_length);
+	error = -ENOMEM;
+	if (!items_bm || !removed_bm || !header)
+		goto out_free;
+
+	header->magic = EPOLL_USERPOLL_HEADER_MAGIC;
+	header->header_length = header_length;
+	header->index_length = index_length;
+	header->max_items_nr = max_items;
+
+	mutex_lock(&ep->mtx);
+	error = -EBUSY;
+	if (ep->user_header || !RB_EMPTY_ROOT(&ep->rbr.rb_root)) {
+		mutex_unlock(&ep->mtx);
+		goto out_free;
+	}
+	ep->user_index = (void *)header + header_length;
+	ep->user_index_mask = index_length / sizeof(*ep->user_index) - 1;
+	ep->user_max_items = max_items;
+	ep->items_bm = items_bm;
+	ep->removed_bm = removed_bm;
+	smp_store_release(&ep->user_header, header);
+	mutex_unlock(&ep->mtx);
+
+	return 0;
+
+out_free:
+	vfree(header);
+	bitmap_free(removed_bm);
+	bitmap_free(items_bm);
+	return error;
+}
+
+static long ep_eventpoll_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg)
+{
+	struct eventpoll *ep = file->private_data;
+	u32 max_items;
+
+	switch (cmd) {
+	case EPIOCSETUPRING:
+		if (get_user(max_items, (u32 __user *)arg))
+			return -EFAULT;
+		return ep_setup_user_ring(ep, max_items);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int ep_eventpoll_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct eventpoll *ep = file->private_data;
+	struct epoll_uheader *header = smp_load_acquire(&ep->user_header);
+
+	if (!header)
+		return -ENODEV;
+
+	return remap_vmalloc_range(vma, header, vma->vm_pgoff);
+}
+
 /* File callbacks that implement the eventpoll file behaviour */
 static const struct file_operations eventpoll_fops = {
 #ifdef CONFIG_PROC_FS
@@ -967,6 +1185,9 @@ static const struct file_operations eventpoll_fops = {
 #endif
 	.release	= ep_eventpoll_release,
 	.poll		= ep_eventpoll_poll,
+	.unlocked_ioctl	= ep_eventpoll_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
+	.mmap		= ep_eventpoll_mmap,
 	.llseek		= noop_llseek,
 };
 
@@ -1210,6 +1431,25 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	unsigned long flags;
 	int ewake = 0;
 
+	if (ep_polled_by_user(ep)) {
+		ep_set_busy_poll_napi_id(epi);
+		if (!ep_add_event_to_uring(epi, pollflags))
+			goto out;
+		/*
+		 * The ring needs no lock, ep->lock is only taken to serialize
+		 * the wakeup against waiters queueing themselves.
+		 */
+		ewake = 1;
+		if (waitqueue_active(&ep->wq)) {
+			read_lock_irqsave(&ep->lock, flags);
+			wake_up(&ep->wq);
+			read_unlock_irqrestore(&ep->lock, flags);
+		}
+		if (waitqueue_active(&ep->poll_wait))
+			pwake++;
+		goto out;
+	}
+
 	read_lock_irqsave(&ep->lock, flags);
 
 	ep_set_busy_poll_napi_id(epi);
@@ -1275,7 +1515,7 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 
 out_unlock:
 	read_unlock_irqrestore(&ep->lock, flags);
-
+out:
 	/* We have to call this outside the lock */
 	if (pwake)
 		ep_poll_safewake(ep, epi);
@@ -1490,7 +1730,7 @@ static noinline void ep_destroy_wakeup_source(struct epitem *epi)
 static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 		     struct file *tfile, int fd, int full_check)
 {
-	int error, pwake = 0;
+	int error, pwake = 0, bit = -1;
 	__poll_t revents;
 	long user_watches;
 	struct epitem *epi;
@@ -1498,11 +1738,24 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 
 	lockdep_assert_irqs_enabled();
 
+	/* The ring is edge triggered, nothing would requeue other items */
+	if (ep_polled_by_user(ep) &&
+	    (event->events & (EPOLLET | EPOLLONESHOT | EPOLLWAKEUP)) != EPOLLET)
+		return -EINVAL;
+
 	user_watches = atomic_long_read(&ep->user->epoll_watches);
 	if (unlikely(user_watches >= max_user_watches))
 		return -ENOSPC;
-	if (!(epi = kmem_cache_alloc(epi_cache, GFP_KERNEL)))
+	if (ep_polled_by_user(ep)) {
+		bit = ep_alloc_user_item(ep);
+		if (bit < 0)
+			return bit;
+	}
+	if (!(epi = kmem_cache_alloc(epi_cache, GFP_KERNEL))) {
+		if (bit >= 0)
+			__clear_bit(bit, ep->items_bm);
 		return -ENOMEM;
+	}
 
 	/* Item initialization follow here ... */
 	INIT_LIST_HEAD(&epi->rdllink);
@@ -1512,7 +1765,15 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 	ep_set_ffd(&epi->ffd, tfile, fd);
 	epi->event = *event;
 	epi->nwait = 0;
+	epi->bit = bit;
 	epi->next = EP_UNACTIVE_PTR;
+	if (ep_polled_by_user(ep)) {
+		struct epoll_uitem *uitem = &ep->user_header->items[bit];
+
+		WRITE_ONCE(uitem->ready_events, 0);
+		WRITE_ONCE(uitem->events, event->events);
+		WRITE_ONCE(uitem->data, event->data);
+	}
 	if (epi->event.events & EPOLLWAKEUP) {
 		error = ep_create_wakeup_source(epi);
 		if (error)
@@ -1566,7 +1827,14 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 	ep_set_busy_poll_napi_id(epi);
 
 	/* If the file is already "ready" we drop it inside the ready list */
-	if (revents && !ep_is_linked(epi)) {
+	if (ep_polled_by_user(ep)) {
+		if (revents && ep_add_event_to_uring(epi, revents)) {
+			if (waitqueue_active(&ep->wq))
+				wake_up(&ep->wq);
+			if (waitqueue_active(&ep->poll_wait))
+				pwake++;
+		}
+	} else if (revents && !ep_is_linked(epi)) {
 		list_add_tail(&epi->rdllink, &ep->rdllist);
 		ep_pm_stay_awake(epi);
 
@@ -1609,6 +1877,10 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 
+	/* The item may have been queued by a callback meanwhile */
+	if (bit >= 0)
+		ep_remove_user_item(ep, bit);
+
 error_create_wakeup_source:
 	kmem_cache_free(epi_cache, epi);
 
@@ -1623,10 +1895,15 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 		     const struct epoll_event *event)
 {
 	int pwake = 0;
+	__poll_t revents;
 	poll_table pt;
 
 	lockdep_assert_irqs_enabled();
 
+	if (ep_polled_by_user(ep) &&
+	    (event->events & (EPOLLET | EPOLLONESHOT | EPOLLWAKEUP)) != EPOLLET)
+		return -EINVAL;
+
 	init_poll_funcptr(&pt, NULL);
 
 	/*
@@ -1636,6 +1913,12 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	 */
 	epi->event.events = event->events; /* need barrier below */
 	epi->event.data = event->data; /* protected by mtx */
+	if (ep_polled_by_user(ep)) {
+		struct epoll_uitem *uitem = &ep->user_header->items[epi->bit];
+
+		WRITE_ONCE(uitem->events, event->events);
+		WRITE_ONCE(uitem->data, event->data);
+	}
 	if (epi->event.events & EPOLLWAKEUP) {
 		if (!ep_has_wakeup_source(epi))
 			ep_create_wakeup_source(epi);
@@ -1669,7 +1952,17 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	 * If the item is "hot" and it is not registered inside the ready
 	 * list, push it inside.
 	 */
-	if (ep_item_poll(epi, &pt, 1)) {
+	revents = ep_item_poll(epi, &pt, 1);
+	if (revents && ep_polled_by_user(ep)) {
+		if (ep_add_event_to_uring(epi, revents)) {
+			write_lock_irq(&ep->lock);
+			if (waitqueue_active(&ep->wq))
+				wake_up(&ep->wq);
+			if (waitqueue_active(&ep->poll_wait))
+				pwake++;
+			write_unlock_irq(&ep->lock);
+		}
+	} else if (revents) {
 		write_lock_irq(&ep->lock);
 		if (!ep_is_linked(epi)) {
 			list_add_tail(&epi->rdllink, &ep->rdllist);
@@ -1780,6 +2073,10 @@ static int ep_send_events(struct eventpoll *ep,
 {
 	struct ep_send_events_data esed;
 
+	/* Events are already in the ring, tell the caller how many */
+	if (ep_polled_by_user(ep))
+		return ep_uring_events_available(ep);
+
 	esed.maxevents = maxevents;
 	esed.events = events;
 
@@ -1886,6 +2183,16 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		 */
 		__set_current_state(TASK_INTERRUPTIBLE);
 
+		/*
+		 * The user ring is filled without ep->lock, so queue first
+		 * and check after a barrier pairing with the tail update in
+		 * ep_add_event_to_uring().
+		 */
+		if (ep_polled_by_user(ep)) {
+			__add_wait_queue_exclusive(&ep->wq, &wait);
+			smp_mb();
+		}
+
 		/*
 		 * Do the final check under the lock. ep_scan_ready_list()
 		 * plays with two lists (->rdllist and ->ovflist) and there
@@ -1897,7 +2204,7 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		if (!eavail) {
 			if (signal_pending(current))
 				res = -EINTR;
-			else
+			else if (!ep_polled_by_user(ep))
 				__add_wait_queue_exclusive(&ep->wq, &wait);
 		}
 		write_unlock_irq(&ep->lock);
@@ -2292,12 +2599,16 @@ static int do_epoll_wait(int epfd, struct epoll_event __user *events,
 	struct fd f;
 	struct eventpoll *ep;
 
-	/* The maximum number of event must be greater than zero */
-	if (maxevents <= 0 || maxevents > EP_MAX_EVENTS)
+	/*
+	 * The maximum number of event must be greater than zero, unless the
+	 * events are delivered through the user ring, see below.
+	 */
+	if (maxevents < 0 || maxevents > EP_MAX_EVENTS)
 		return -EINVAL;
 
 	/* Verify that the area passed by the user is writeable */
-	if (!access_ok(events, maxevents * sizeof(struct epoll_event)))
+	if (maxevents &&
+	    !access_ok(events, maxevents * sizeof(struct epoll_event)))
 		return -EFAULT;
 
 	/* Get the "struct file *" for the eventpoll file */
@@ -2319,6 +2630,10 @@ static int do_epoll_wait(int epfd, struct epoll_event __user *events,
 	 */
 	ep = f.file->private_data;
 
+	/* Without a user ring there is nowhere to deliver events to */
+	if (!maxevents && !ep_polled_by_user(ep))
+		goto error_fput;
+
 	/* Time to fish for events ... */
 	error = ep_poll(ep, events, maxevents, timeout);
 
@@ -948,6 +948,7 @@ do {									       \
 #endif /* defined(__KERNEL__) || defined(__linux__) */
 
 #include "extents_status.h"
+#include "fast_commit.h"
 
 /*
  * Lock subclasses for i_data_sem in the ext4_inode_info structure.
@@ -1042,6 +1043,14 @@ struct ext4_inode_info {
 	 * to occasionally drop it.
 	 */
 	struct rw_semaphore i_mmap_sem;
+	/*
+	 * i_dir_sem protects the directory layout against creates that only
+	 * hold the parent's i_rwsem shared (IOP_PAR_CREATE).  It is taken
+	 * shared to walk the htree and exclusive to change it; entries in a
+	 * single leaf are protected by the leaf locks in namei.c.  Ranks
+	 * below transaction start.
+	 */
+	struct rw_semaphore i_dir_sem;
 	struct inode vfs_inode;
 	struct jbd2_inode *jinode;
 
@@ -1061,6 +1070,7 @@ struct ext4_inode_info {
 	/* extents status tree */
 	struct ext4_es_tree i_es_tree;
 	rwlock_t i_es_lock;
+	seqcount_t i_es_seq;		/* bumped on every i_es_tree change */
 	struct list_head i_es_list;
 	unsigned int i_es_all_nr;	/* protected by i_es_lock */
 	unsigned int i_es_shk_nr;	/* protected by i_es_lock */
@@ -1109,6 +1119,10 @@ struct ext4_inode_info {
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
 
+	/* Fast commit queue entry and the transaction it was last queued in */
+	struct list_head i_fc_list;
+	tid_t i_fc_tid;
+
 #ifdef CONFIG_QUOTA
 	struct dquot *i_dquot[MAXQUOTAS];
 #endif
@@ -1193,6 +1207,7 @@ struct ext4_inode_info {
 						      file systems */
 #define EXT4_MOUNT2_DAX_NEVER		0x00000008 /* Do not allow Direct Access */
 #define EXT4_MOUNT2_DAX_INODE		0x00000010 /* For printing options only */
+#define EXT4_MOUNT2_JOURNAL_FAST_COMMIT	0x00000020 /* Journal fast commit */
 
 #define EXT4_MOUNT2_EXPLICIT_JOURNAL_CHECKSUM	0x00000008 /* User explicitly
 						specified journal checksum */
@@ -1590,6 +1605,15 @@ struct ext4_sb_info {
 	/* Record the errseq of the backing block device */
 	errseq_t s_bdev_wb_err;
 	spinlock_t s_bdev_wb_lock;
+
+	/* Ext4 fast commit stuff */
+	struct list_head s_fc_q;	/* inodes queued for fast commit */
+	spinlock_t s_fc_lock;
+	bool s_fc_ineligible;		/* s_fc_ineligible_tid can't be
+					   fast committed */
+	tid_t s_fc_ineligible_tid;
+	struct ext4_fc_stats s_fc_stats;
+	struct ext4_fc_replay_state s_fc_replay_state;
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -2617,6 +2641,18 @@ extern int ext4_check_all_de(struct inode *dir, struct buffer_head *bh,
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 
+/* fast_commit.c */
+void ext4_fc_mark_ineligible(struct super_block *sb, int reason,
+			     handle_t *handle);
+void ext4_fc_track_handle(struct super_block *sb, handle_t *handle, int type);
+void ext4_fc_track_inode(handle_t *handle, struct inode *inode);
+void ext4_fc_track_map(handle_t *handle, struct inode *inode, int flags);
+void ext4_fc_del(struct inode *inode);
+int ext4_fc_commit(journal_t *journal, tid_t tid);
+int ext4_fc_init(struct super_block *sb, journal_t *journal);
+void ext4_fc_init_journal(journal_t *journal);
+int ext4_fc_info_show(struct seq_file *seq, void *v);
+
 /* hash.c */
 extern int ext4fs_dirhash(const struct inode *dir, const char *name, int len,
 			  struct dx_hash_info *hinfo);
@@ -2778,6 +2814,8 @@ extern int ext4_generic_delete_entry(handle_t *handle,
 				     int buf_size,
 				     int csum_size);
 extern bool ext4_empty_dir(struct inode *inode);
+extern void ext4_dir_set_par_create(struct inode *dir);
+extern void __init ext4_init_dir_locks(void);
 
 /* resize.c */
 extern void ext4_kvfree_array_rcu(void *to_free);
@@ -160,6 +160,8 @@ static int __ext4_ext_dirty(const char *where, unsigned int line,
 
 	WARN_ON(!rwsem_is_locked(&EXT4_I(inode)->i_data_sem));
 	if (path->p_bh) {
+		ext4_fc_mark_ineligible(inode->i_sb,
+					EXT4_FC_REASON_EXTENT_TREE, handle);
 		ext4_extent_block_csum_set(inode, ext_block_hdr(path->p_bh));
 		/* path points to block */
 		err = __ext4_handle_dirty_metadata(where, line, handle,
@@ -230,6 +232,7 @@ ext4_ext_new_meta_block(handle_t *handle, struct inode *inode,
 {
 	ext4_fsblk_t goal, newblock;
 
+	ext4_fc_mark_ineligible(inode->i_sb, EXT4_FC_REASON_EXTENT_TREE, handle);
 	goal = ext4_ext_find_goal(inode, path, le32_to_cpu(ex->ee_block));
 	newblock = ext4_new_meta_blocks(handle, inode, goal, flags,
 					NULL, err);
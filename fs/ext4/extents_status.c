@@ -113,7 +113,13 @@
  *	next extent, adding a extent(a range of blocks) and removing a extent.
  *
  *   --	race on a extent status tree
- *	Extent status tree is protected by inode->i_es_lock.
+ *	Extent status tree is protected by inode->i_es_lock.  Every change
+ *	to the tree is also covered by inode->i_es_seq, which lets the
+ *	block mapping fast path in ext4_es_lookup_extent() walk the tree
+ *	under RCU without taking i_es_lock.  extent_status objects come
+ *	from a SLAB_TYPESAFE_BY_RCU cache, so a lockless reader may see a
+ *	freed or reused object but never unmapped memory; the sequence
+ *	check rejects anything it read from one.
  *
  *   --	memory consumption
  *      Fragmented extent tree will make extent status tree cost too much
@@ -156,8 +162,9 @@ static void __revise_pending(struct inode *inode, ext4_lblk_t lblk,
 int __init ext4_init_es(void)
 {
 	ext4_es_cachep = kmem_cache_create("ext4_extent_status",
-					   sizeof(struct extent_status),
-					   0, (SLAB_RECLAIM_ACCOUNT), NULL);
+					   sizeof(struct extent_status), 0,
+					   (SLAB_RECLAIM_ACCOUNT |
+					    SLAB_TYPESAFE_BY_RCU), NULL);
 	if (ext4_es_cachep == NULL)
 		return -ENOMEM;
 	return 0;
@@ -174,6 +181,19 @@ void ext4_es_init_tree(struct ext4_es_tree *tree)
 	tree->cache_es = NULL;
 }
 
+/* Lock the extent status tree for changes, see ext4_es_lookup_rcu() */
+static inline void ext4_es_lock_tree(struct ext4_inode_info *ei)
+{
+	write_lock(&ei->i_es_lock);
+	write_seqcount_begin(&ei->i_es_seq);
+}
+
+static inline void ext4_es_unlock_tree(struct ext4_inode_info *ei)
+{
+	write_seqcount_end(&ei->i_es_seq);
+	write_unlock(&ei->i_es_lock);
+}
+
 #ifdef ES_DEBUG__
 static void ext4_es_print_tree(struct inode *inode)
 {
@@ -789,7 +809,7 @@ static int __es_insert_extent(struct inode *inode, struct extent_status *newes)
 				  newes->es_pblk);
 	if (!es)
 		return -ENOMEM;
-	rb_link_node(&es->rb_node, parent, p);
+	rb_link_node_rcu(&es->rb_node, parent, p);
 	rb_insert_color(&es->rb_node, &tree->root);
 
 out:
@@ -835,7 +855,7 @@ int ext4_es_insert_extent(struct inode *inode, ext4_lblk_t lblk,
 
 	ext4_es_insert_extent_check(inode, &newes);
 
-	write_lock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_lock_tree(EXT4_I(inode));
 	err = __es_remove_extent(inode, lblk, end, NULL);
 	if (err != 0)
 		goto error;
@@ -853,7 +873,7 @@ int ext4_es_insert_extent(struct inode *inode, ext4_lblk_t lblk,
 		__revise_pending(inode, lblk, len);
 
 error:
-	write_unlock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_unlock_tree(EXT4_I(inode));
 
 	ext4_es_print_tree(inode);
 
@@ -883,12 +903,68 @@ void ext4_es_cache_extent(struct inode *inode, ext4_lblk_t lblk,
 
 	BUG_ON(end < lblk);
 
-	write_lock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_lock_tree(EXT4_I(inode));
 
 	es = __es_tree_search(&EXT4_I(inode)->i_es_tree.root, lblk);
 	if (!es || es->es_lblk > end)
 		__es_insert_extent(inode, &newes);
-	write_unlock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_unlock_tree(EXT4_I(inode));
+}
+
+/*
+ * Lockless version of the lookup below for the block mapping fast path.
+ * Anything read from the tree is only trusted if i_es_seq did not move, so
+ * the walk bails out as soon as a writer shows up.  Extents which still
+ * need their referenced bit set are left to the locked lookup, as that bit
+ * shares es_pblk with the block number.
+ */
+static bool ext4_es_lookup_rcu(struct ext4_inode_info *ei, ext4_lblk_t lblk,
+			       struct extent_status *es)
+{
+	struct extent_status *es1;
+	struct rb_node *node;
+	ext4_lblk_t start, len;
+	bool found = false;
+	unsigned int seq;
+
+	rcu_read_lock();
+	seq = raw_read_seqcount(&ei->i_es_seq);
+	if (seq & 1)
+		goto out;
+
+	es1 = READ_ONCE(ei->i_es_tree.cache_es);
+	if (es1) {
+		start = READ_ONCE(es1->es_lblk);
+		len = READ_ONCE(es1->es_len);
+		if (lblk - start < len)
+			goto found;
+	}
+
+	node = rcu_dereference_raw(ei->i_es_tree.root.rb_node);
+	while (node) {
+		if (read_seqcount_retry(&ei->i_es_seq, seq))
+			goto out;
+		es1 = rb_entry(node, struct extent_status, rb_node);
+		start = READ_ONCE(es1->es_lblk);
+		len = READ_ONCE(es1->es_len);
+		if (lblk < start)
+			node = rcu_dereference_raw(node->rb_left);
+		else if (lblk - start >= len)
+			node = rcu_dereference_raw(node->rb_right);
+		else
+			goto found;
+	}
+	goto out;
+
+found:
+	es->es_lblk = start;
+	es->es_len = len;
+	es->es_pblk = READ_ONCE(es1->es_pblk);
+	found = ext4_es_is_referenced(es) &&
+		!read_seqcount_retry(&ei->i_es_seq, seq);
+out:
+	rcu_read_unlock();
+	return found;
 }
 
 /*
@@ -911,6 +987,13 @@ int ext4_es_lookup_extent(struct inode *inode, ext4_lblk_t lblk,
 	trace_ext4_es_lookup_extent_enter(inode, lblk);
 	es_debug("lookup extent in block %u\n", lblk);
 
+	stats = &EXT4_SB(inode->i_sb)->s_es_stats;
+	if (!next_lblk && ext4_es_lookup_rcu(EXT4_I(inode), lblk, es)) {
+		percpu_counter_inc(&stats->es_stats_cache_hits);
+		found = 1;
+		goto out_trace;
+	}
+
 	tree = &EXT4_I(inode)->i_es_tree;
 	read_lock(&EXT4_I(inode)->i_es_lock);
 
@@ -940,7 +1023,6 @@ int ext4_es_lookup_extent(struct inode *inode, ext4_lblk_t lblk,
 	}
 
 out:
-	stats = &EXT4_SB(inode->i_sb)->s_es_stats;
 	if (found) {
 		BUG_ON(!es1);
 		es->es_lblk = es1->es_lblk;
@@ -964,6 +1046,7 @@ int ext4_es_lookup_extent(struct inode *inode, ext4_lblk_t lblk,
 
 	read_unlock(&EXT4_I(inode)->i_es_lock);
 
+out_trace:
 	trace_ext4_es_lookup_extent_exit(inode, es, found);
 	return found;
 }
@@ -1434,9 +1517,9 @@ int ext4_es_remove_extent(struct inode *inode, ext4_lblk_t lblk,
 	 * so that we are sure __es_shrink() is done with the inode before it
 	 * is reclaimed.
 	 */
-	write_lock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_lock_tree(EXT4_I(inode));
 	err = __es_remove_extent(inode, lblk, end, &reserved);
-	write_unlock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_unlock_tree(EXT4_I(inode));
 	ext4_es_print_tree(inode);
 	ext4_da_release_space(inode, reserved);
 	return err;
@@ -1489,7 +1572,11 @@ static int __es_shrink(struct ext4_sb_info *sbi, int nr_to_scan,
 		 */
 		spin_unlock(&sbi->s_es_lock);
 
+		/* We may be called with another inode's tree locked */
+		write_seqcount_begin_nested(&ei->i_es_seq,
+					    SINGLE_DEPTH_NESTING);
 		nr_shrunk += es_reclaim_extents(ei, &nr_to_scan);
+		write_seqcount_end(&ei->i_es_seq);
 		write_unlock(&ei->i_es_lock);
 
 		if (nr_to_scan <= 0)
@@ -1749,7 +1836,7 @@ void ext4_clear_inode_es(struct inode *inode)
 	struct ext4_es_tree *tree;
 	struct rb_node *node;
 
-	write_lock(&ei->i_es_lock);
+	ext4_es_lock_tree(ei);
 	tree = &EXT4_I(inode)->i_es_tree;
 	tree->cache_es = NULL;
 	node = rb_first(&tree->root);
@@ -1762,7 +1849,7 @@ void ext4_clear_inode_es(struct inode *inode)
 		}
 	}
 	ext4_clear_inode_state(inode, EXT4_STATE_EXT_PRECACHED);
-	write_unlock(&ei->i_es_lock);
+	ext4_es_unlock_tree(ei);
 }
 
 #ifdef ES_DEBUG__
@@ -1979,7 +2066,7 @@ int ext4_es_insert_delayed_block(struct inode *inode, ext4_lblk_t lblk,
 
 	ext4_es_insert_extent_check(inode, &newes);
 
-	write_lock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_lock_tree(EXT4_I(inode));
 
 	err = __es_remove_extent(inode, lblk, lblk, NULL);
 	if (err != 0)
@@ -1996,7 +2083,7 @@ int ext4_es_insert_delayed_block(struct inode *inode, ext4_lblk_t lblk,
 		__insert_pending(inode, lblk);
 
 error:
-	write_unlock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_unlock_tree(EXT4_I(inode));
 
 	ext4_es_print_tree(inode);
 	ext4_print_pending_tree(inode);
@@ -0,0 +1,702 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * fs/ext4/fast_commit.c
+ *
+ * Ext4 fast commits
+ *
+ * A fast commit makes fsync() durable without committing the running jbd2
+ * transaction.  Every inode dirtied in the running transaction is queued
+ * on the superblock; fsync() copies the raw on-disk image of all queued
+ * inodes into the fast commit area at the end of the journal, which takes
+ * as few as one or two block writes instead of a full commit with all its
+ * descriptor, metadata and commit blocks.
+ *
+ * Recovery replays the fast commit area on top of the last full commit:
+ * the raw inodes are written back to the inode table and, for inodes
+ * whose extents all live in the inode body, the blocks these extents
+ * point to are marked in use in the block bitmaps.
+ *
+ * That is only enough for transactions which change nothing but inode
+ * bodies and block allocations reachable from them.  Anything else
+ * (namespace and xattr changes, freed blocks, extent tree blocks, orphan
+ * list updates, ...) marks the whole transaction ineligible and fsync()
+ * falls back to a full commit.  Allocations must be made as unwritten
+ * extents (dioread_nolock), so a replayed extent never exposes stale
+ * data: it is converted in a later transaction once the data is on disk.
+ *
+ * The fast commit area is reset every time a full commit completes, so
+ * fast commits always apply on top of the transaction that follows the
+ * last one found in the log.
+ */
+#include <linux/crc32.h>
+#include <linux/seq_file.h>
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+
+static const char * const fc_ineligible_reasons[EXT4_FC_REASON_MAX] = {
+	[EXT4_FC_REASON_XATTR]		= "Extended attributes changed",
+	[EXT4_FC_REASON_NAMESPACE]	= "Namespace changed",
+	[EXT4_FC_REASON_INODE]		= "Inode allocated or freed",
+	[EXT4_FC_REASON_ORPHAN]		= "Orphan list changed",
+	[EXT4_FC_REASON_FREE_BLOCKS]	= "Blocks freed",
+	[EXT4_FC_REASON_GROUP_INIT]	= "Block group initialized",
+	[EXT4_FC_REASON_EXTENT_TREE]	= "Extent tree block changed",
+	[EXT4_FC_REASON_BLOCK_MAP]	= "Unsupported block mapping",
+	[EXT4_FC_REASON_SWAP]		= "Blocks swapped",
+	[EXT4_FC_REASON_SUPER]		= "Superblock changed",
+	[EXT4_FC_REASON_INODE_TYPE]	= "Unsupported inode",
+	[EXT4_FC_REASON_NOSPC]		= "Fast commit area full",
+};
+
+static inline int ext4_fc_records_per_block(struct super_block *sb)
+{
+	return (sb->s_blocksize - sizeof(struct ext4_fc_block_head)) /
+		(sizeof(struct ext4_fc_inode) + EXT4_INODE_SIZE(sb));
+}
+
+static bool ext4_fc_is_ineligible(struct super_block *sb, tid_t tid)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	bool ret;
+
+	spin_lock(&sbi->s_fc_lock);
+	ret = sbi->s_fc_ineligible && sbi->s_fc_ineligible_tid == tid;
+	spin_unlock(&sbi->s_fc_lock);
+	return ret;
+}
+
+static void __ext4_fc_mark_ineligible(struct super_block *sb, int reason,
+				      tid_t tid)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	if (READ_ONCE(sbi->s_fc_ineligible) &&
+	    READ_ONCE(sbi->s_fc_ineligible_tid) == tid)
+		return;
+
+	spin_lock(&sbi->s_fc_lock);
+	if (!sbi->s_fc_ineligible || sbi->s_fc_ineligible_tid != tid) {
+		sbi->s_fc_ineligible = true;
+		sbi->s_fc_ineligible_tid = tid;
+		sbi->s_fc_stats.fc_ineligible_reason_count[reason]++;
+	}
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+/*
+ * Mark the transaction of @handle as not eligible for fast commits.  This
+ * must be called before the operation modifies anything a fast commit
+ * could otherwise pick up half way.
+ */
+void ext4_fc_mark_ineligible(struct super_block *sb, int reason,
+			     handle_t *handle)
+{
+	if (!test_opt2(sb, JOURNAL_FAST_COMMIT) ||
+	    !ext4_handle_valid(handle) || !handle->h_transaction)
+		return;
+
+	WARN_ON_ONCE(reason >= EXT4_FC_REASON_MAX);
+	__ext4_fc_mark_ineligible(sb, reason, handle->h_transaction->t_tid);
+}
+
+/*
+ * Handles of these types only come from operations that can never be fast
+ * committed, so catch them before they get to modify anything.
+ */
+void ext4_fc_track_handle(struct super_block *sb, handle_t *handle, int type)
+{
+	int reason;
+
+	switch (type) {
+	case EXT4_HT_DIR:
+		reason = EXT4_FC_REASON_NAMESPACE;
+		break;
+	case EXT4_HT_XATTR:
+		reason = EXT4_FC_REASON_XATTR;
+		break;
+	case EXT4_HT_MIGRATE:
+		reason = EXT4_FC_REASON_BLOCK_MAP;
+		break;
+	case EXT4_HT_MOVE_EXTENTS:
+		reason = EXT4_FC_REASON_SWAP;
+		break;
+	case EXT4_HT_RESIZE:
+		reason = EXT4_FC_REASON_SUPER;
+		break;
+	default:
+		return;
+	}
+	ext4_fc_mark_ineligible(sb, reason, handle);
+}
+
+/*
+ * Queue @inode for the next fast commit of the transaction of @handle.
+ * Called whenever the raw inode has been updated.
+ */
+void ext4_fc_track_inode(handle_t *handle, struct inode *inode)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	tid_t tid;
+
+	if (!test_opt2(sb, JOURNAL_FAST_COMMIT) ||
+	    !ext4_handle_valid(handle) || !handle->h_transaction)
+		return;
+
+	if (ext4_should_journal_data(inode) || ext4_has_inline_data(inode) ||
+	    (inode->i_ino < EXT4_FIRST_INO(sb) &&
+	     inode->i_ino != EXT4_ROOT_INO)) {
+		ext4_fc_mark_ineligible(sb, EXT4_FC_REASON_INODE_TYPE, handle);
+		return;
+	}
+
+	tid = handle->h_transaction->t_tid;
+	if (READ_ONCE(ei->i_fc_tid) == tid &&
+	    !list_empty_careful(&ei->i_fc_list))
+		return;
+
+	spin_lock(&sbi->s_fc_lock);
+	ei->i_fc_tid = tid;
+	if (list_empty(&ei->i_fc_list))
+		list_add_tail(&ei->i_fc_list, &sbi->s_fc_q);
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+/*
+ * A block mapping is about to change.  Only unwritten allocations and
+ * conversions of extent mapped inodes can be fast committed, see the top
+ * of this file.
+ */
+void ext4_fc_track_map(handle_t *handle, struct inode *inode, int flags)
+{
+	if (!ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS)) {
+		ext4_fc_mark_ineligible(inode->i_sb, EXT4_FC_REASON_BLOCK_MAP,
+					handle);
+		return;
+	}
+	if ((flags & EXT4_GET_BLOCKS_CREATE) &&
+	    !(flags & EXT4_GET_BLOCKS_CONVERT_UNWRITTEN) &&
+	    (!(flags & EXT4_GET_BLOCKS_UNWRIT_EXT) ||
+	     (flags & EXT4_GET_BLOCKS_ZERO)))
+		ext4_fc_mark_ineligible(inode->i_sb, EXT4_FC_REASON_BLOCK_MAP,
+					handle);
+}
+
+/* The inode is going away, drop it from the fast commit queue. */
+void ext4_fc_del(struct inode *inode)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	struct ext4_inode_info *ei = EXT4_I(inode);
+
+	if (list_empty_careful(&ei->i_fc_list))
+		return;
+
+	spin_lock(&sbi->s_fc_lock);
+	list_del_init(&ei->i_fc_list);
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+/*
+ * Grab a reference to every inode queued for @tid.  Returns the number of
+ * inodes in *@inodesp, which the caller must iput and kvfree.
+ */
+static int ext4_fc_grab_inodes(struct super_block *sb, tid_t tid,
+			       struct inode ***inodesp)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode_info *ei;
+	struct inode **inodes;
+	int nr = 0, max = 0;
+
+	spin_lock(&sbi->s_fc_lock);
+	list_for_each_entry(ei, &sbi->s_fc_q, i_fc_list)
+		if (ei->i_fc_tid == tid)
+			max++;
+	spin_unlock(&sbi->s_fc_lock);
+
+	*inodesp = NULL;
+	if (!max)
+		return 0;
+
+	inodes = kvmalloc_array(max, sizeof(*inodes), GFP_NOFS);
+	if (!inodes)
+		return -ENOMEM;
+
+	spin_lock(&sbi->s_fc_lock);
+	list_for_each_entry(ei, &sbi->s_fc_q, i_fc_list) {
+		if (nr == max)
+			break;
+		if (ei->i_fc_tid != tid)
+			continue;
+		inodes[nr] = igrab(&ei->vfs_inode);
+		if (inodes[nr])
+			nr++;
+	}
+	spin_unlock(&sbi->s_fc_lock);
+
+	if (!nr)
+		kvfree(inodes);
+	else
+		*inodesp = inodes;
+	return nr;
+}
+
+static void ext4_fc_finish_block(struct super_block *sb,
+				 struct buffer_head *bh, tid_t tid, int seq,
+				 int count, bool tail)
+{
+	struct ext4_fc_block_head *head = (struct ext4_fc_block_head *)bh->b_data;
+
+	head->fb_magic = cpu_to_le32(EXT4_FC_MAGIC);
+	head->fb_tid = cpu_to_le32(tid);
+	head->fb_seq = cpu_to_le16(seq);
+	head->fb_count = cpu_to_le16(count);
+	head->fb_flags = cpu_to_le16(tail ? EXT4_FC_BLOCK_TAIL : 0);
+	head->fb_reserved = 0;
+	head->fb_crc = 0;
+	head->fb_crc = cpu_to_le32(crc32_le(~0, bh->b_data, sb->s_blocksize));
+}
+
+static void ext4_fc_submit_bh(struct buffer_head *bh, int op_flags)
+{
+	lock_buffer(bh);
+	set_buffer_uptodate(bh);
+	clear_buffer_dirty(bh);
+	get_bh(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	submit_bh(REQ_OP_WRITE, op_flags, bh);
+}
+
+/* Copy the raw on-disk image of @inode into @rec. */
+static int ext4_fc_copy_inode(struct inode *inode, struct ext4_fc_inode *rec)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	struct ext4_iloc iloc;
+	int ret;
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		return ret;
+
+	rec->fi_ino = cpu_to_le32(inode->i_ino);
+	spin_lock(&ei->i_raw_lock);
+	memcpy(rec->fi_raw_inode, ext4_raw_inode(&iloc),
+	       EXT4_INODE_SIZE(inode->i_sb));
+	spin_unlock(&ei->i_raw_lock);
+	brelse(iloc.bh);
+
+	return 0;
+}
+
+/*
+ * Write all inodes queued for @tid to the fast commit area.  Returns 0 if
+ * the fast commit is on disk, or a negative error (-EAGAIN if the
+ * transaction became ineligible meanwhile, -ENOENT if there was nothing
+ * to write) if the caller has to fall back to a full commit.
+ */
+static int ext4_fc_perform_commit(journal_t *journal, tid_t tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int per_blk = ext4_fc_records_per_block(sb);
+	int rec_size = sizeof(struct ext4_fc_inode) + EXT4_INODE_SIZE(sb);
+	int op_flags = REQ_SYNC;
+	struct inode **inodes;
+	struct buffer_head *bh;
+	int nr, nblks, blk, i = 0;
+	int ret = 0;
+
+	/*
+	 * The transaction changed something for the fsynced inode that is
+	 * not in any queued inode, let a full commit take care of it.
+	 */
+	nr = ext4_fc_grab_inodes(sb, tid, &inodes);
+	if (nr <= 0)
+		return nr ? nr : -ENOENT;
+
+	nblks = DIV_ROUND_UP(nr, per_blk);
+	for (blk = 0; blk < nblks; blk++) {
+		bool tail = blk == nblks - 1;
+		int count = 0;
+		char *pos;
+
+		ret = jbd2_fc_get_buf(journal, &bh);
+		if (ret) {
+			if (ret == -ENOSPC)
+				__ext4_fc_mark_ineligible(sb,
+						EXT4_FC_REASON_NOSPC, tid);
+			goto out;
+		}
+
+		memset(bh->b_data, 0, sb->s_blocksize);
+		pos = bh->b_data + sizeof(struct ext4_fc_block_head);
+		for (; count < per_blk && i < nr; count++, i++) {
+			ret = ext4_fc_copy_inode(inodes[i],
+						 (struct ext4_fc_inode *)pos);
+			if (ret)
+				goto out;
+			pos += rec_size;
+		}
+		ext4_fc_finish_block(sb, bh, tid,
+				     journal->j_fc_off - 1, count, tail);
+		if (tail)
+			break;
+		ext4_fc_submit_bh(bh, op_flags);
+	}
+
+	/*
+	 * An operation that cannot be fast committed may have started while
+	 * we were copying.  Its changes to the inodes might be in the copies
+	 * already, so the tail must not be written.
+	 */
+	if (ext4_fc_is_ineligible(sb, tid)) {
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	ret = jbd2_fc_wait_bufs(journal, nblks - 1);
+	if (ret)
+		goto out;
+
+	if (journal->j_flags & JBD2_BARRIER) {
+		/*
+		 * The data of the fsynced file already went out, get it to
+		 * stable storage along with the rest of the fast commit.
+		 */
+		if (journal->j_fs_dev != journal->j_dev) {
+			ret = blkdev_issue_flush(journal->j_fs_dev, GFP_NOFS);
+			if (ret)
+				goto out;
+		}
+		op_flags |= REQ_PREFLUSH | REQ_FUA;
+	}
+	ext4_fc_submit_bh(bh, op_flags);
+	ret = jbd2_fc_wait_bufs(journal, 1);
+
+	if (!ret) {
+		spin_lock(&sbi->s_fc_lock);
+		sbi->s_fc_stats.fc_num_commits++;
+		sbi->s_fc_stats.fc_numblks += nblks;
+		spin_unlock(&sbi->s_fc_lock);
+	}
+out:
+	if (ret) {
+		/*
+		 * Blocks written so far have no tail and are ignored by
+		 * recovery, but nothing may be appended to them: keep the
+		 * rest of this transaction away from the fast commit area.
+		 */
+		if (!ext4_fc_is_ineligible(sb, tid))
+			__ext4_fc_mark_ineligible(sb, EXT4_FC_REASON_NOSPC,
+						  tid);
+		jbd2_fc_wait_bufs(journal, journal->j_fc_off);
+	}
+	for (i = 0; i < nr; i++)
+		iput(inodes[i]);
+	kvfree(inodes);
+	return ret;
+}
+
+/*
+ * Make all changes to inodes in transaction @tid durable, using a fast
+ * commit if possible and a full commit otherwise.
+ */
+int ext4_fc_commit(journal_t *journal, tid_t tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int ret;
+
+	if (!test_opt2(sb, JOURNAL_FAST_COMMIT))
+		return jbd2_complete_transaction(journal, tid);
+
+restart_fc:
+	ret = jbd2_fc_begin_commit(journal, tid);
+	if (ret == -EALREADY) {
+		/* There was an ongoing commit, check if we need to restart */
+		read_lock(&journal->j_state_lock);
+		ret = tid_gt(tid, journal->j_commit_sequence);
+		read_unlock(&journal->j_state_lock);
+		if (ret)
+			goto restart_fc;
+		return 0;
+	} else if (ret) {
+		spin_lock(&sbi->s_fc_lock);
+		sbi->s_fc_stats.fc_ineligible_commits++;
+		spin_unlock(&sbi->s_fc_lock);
+		return jbd2_complete_transaction(journal, tid);
+	}
+
+	if (ext4_fc_is_ineligible(sb, tid))
+		goto fallback;
+
+	ret = ext4_fc_perform_commit(journal, tid);
+	if (ret)
+		goto fallback;
+
+	return jbd2_fc_end_commit(journal);
+
+fallback:
+	spin_lock(&sbi->s_fc_lock);
+	sbi->s_fc_stats.fc_ineligible_commits++;
+	spin_unlock(&sbi->s_fc_lock);
+	return jbd2_fc_end_commit_fallback(journal, tid);
+}
+
+/*
+ * Called once transaction @tid reached the log: inodes not dirtied since
+ * then no longer need fast committing.
+ */
+static void ext4_fc_cleanup(journal_t *journal, tid_t tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode_info *ei, *n;
+
+	spin_lock(&sbi->s_fc_lock);
+	list_for_each_entry_safe(ei, n, &sbi->s_fc_q, i_fc_list)
+		if (!tid_gt(ei->i_fc_tid, tid))
+			list_del_init(&ei->i_fc_list);
+	if (sbi->s_fc_ineligible && !tid_gt(sbi->s_fc_ineligible_tid, tid))
+		sbi->s_fc_ineligible = false;
+	spin_unlock(&sbi->s_fc_lock);
+}
+
+/* Mark the blocks of a replayed extent in use in the block bitmaps. */
+static int ext4_fc_replay_mark_used(struct super_block *sb,
+				    ext4_fsblk_t pblk, unsigned int len)
+{
+	struct ext4_super_block *es = EXT4_SB(sb)->s_es;
+	struct buffer_head *bitmap_bh, *gd_bh;
+	struct ext4_group_desc *gdp;
+	ext4_group_t group;
+	ext4_grpblk_t off;
+	unsigned int n, i, newly;
+
+	if (pblk < le32_to_cpu(es->s_first_data_block) ||
+	    pblk + len < pblk || pblk + len > ext4_blocks_count(es))
+		return -EFSCORRUPTED;
+
+	while (len) {
+		ext4_get_group_no_and_offset(sb, pblk, &group, &off);
+		n = min_t(unsigned int, len, EXT4_BLOCKS_PER_GROUP(sb) - off);
+
+		gdp = ext4_get_group_desc(sb, group, &gd_bh);
+		if (!gdp)
+			return -EFSCORRUPTED;
+		/* Initializing a group always makes a transaction ineligible */
+		if (ext4_has_group_desc_csum(sb) &&
+		    (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)))
+			return -EFSCORRUPTED;
+
+		bitmap_bh = sb_bread(sb, ext4_block_bitmap(sb, gdp));
+		if (!bitmap_bh)
+			return -EIO;
+
+		for (i = 0, newly = 0; i < n; i++)
+			if (!ext4_test_and_set_bit(off + i, bitmap_bh->b_data))
+				newly++;
+		if (newly) {
+			ext4_free_group_clusters_set(sb, gdp,
+				ext4_free_group_clusters(sb, gdp) - newly);
+			ext4_block_bitmap_csum_set(sb, group, gdp, bitmap_bh);
+			ext4_group_desc_csum_set(sb, group, gdp);
+			mark_buffer_dirty(bitmap_bh);
+			mark_buffer_dirty(gd_bh);
+		}
+		brelse(bitmap_bh);
+
+		pblk += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb,
+				struct ext4_fc_inode *rec)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode *raw = (struct ext4_inode *)rec->fi_raw_inode;
+	unsigned long ino = le32_to_cpu(rec->fi_ino);
+	struct ext4_extent_header *eh;
+	struct ext4_extent *ex;
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	ext4_group_t group;
+	unsigned long offset;
+	int i, ret;
+
+	if (!ext4_valid_inum(sb, ino))
+		return -EFSCORRUPTED;
+
+	group = (ino - 1) / EXT4_INODES_PER_GROUP(sb);
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) * EXT4_INODE_SIZE(sb);
+	gdp = ext4_get_group_desc(sb, group, NULL);
+	if (!gdp)
+		return -EFSCORRUPTED;
+
+	bh = sb_bread(sb, ext4_inode_table(sb, gdp) +
+		      (offset >> EXT4_BLOCK_SIZE_BITS(sb)));
+	if (!bh)
+		return -EIO;
+	memcpy(bh->b_data + (offset & (sb->s_blocksize - 1)), raw,
+	       EXT4_INODE_SIZE(sb));
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	sbi->s_fc_replay_state.fc_replayed_inodes++;
+
+	if (!(le32_to_cpu(raw->i_flags) & EXT4_EXTENTS_FL))
+		return 0;
+
+	/* Extent tree blocks changing within a transaction make it ineligible */
+	eh = (struct ext4_extent_header *)raw->i_block;
+	if (eh->eh_magic != EXT4_EXT_MAGIC || eh->eh_depth ||
+	    le16_to_cpu(eh->eh_entries) > le16_to_cpu(eh->eh_max) ||
+	    le16_to_cpu(eh->eh_max) > (sizeof(raw->i_block) -
+			sizeof(*eh)) / sizeof(*ex))
+		return 0;
+
+	ex = EXT_FIRST_EXTENT(eh);
+	for (i = 0; i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+		ret = ext4_fc_replay_mark_used(sb, ext4_ext_pblock(ex),
+					       ext4_ext_get_actual_len(ex));
+		if (ret)
+			return ret;
+		sbi->s_fc_replay_state.fc_replayed_blocks +=
+					ext4_ext_get_actual_len(ex);
+	}
+
+	return 0;
+}
+
+static bool ext4_fc_block_valid(struct super_block *sb,
+				struct buffer_head *bh, int off,
+				tid_t expected_tid)
+{
+	struct ext4_fc_block_head *head = (struct ext4_fc_block_head *)bh->b_data;
+	__le32 crc = head->fb_crc;
+	bool valid;
+
+	if (le32_to_cpu(head->fb_magic) != EXT4_FC_MAGIC ||
+	    le32_to_cpu(head->fb_tid) != expected_tid ||
+	    le16_to_cpu(head->fb_seq) != off ||
+	    le16_to_cpu(head->fb_count) > ext4_fc_records_per_block(sb))
+		return false;
+
+	head->fb_crc = 0;
+	valid = crc32_le(~0, bh->b_data, sb->s_blocksize) == le32_to_cpu(crc);
+	head->fb_crc = crc;
+
+	return valid;
+}
+
+/*
+ * jbd2 recovery callback, called for every block of the fast commit area
+ * after the regular log has been scanned respectively replayed.
+ */
+static int ext4_fc_replay(journal_t *journal, struct buffer_head *bh,
+			  enum passtype pass, int off, tid_t expected_tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_fc_replay_state *state = &EXT4_SB(sb)->s_fc_replay_state;
+	struct ext4_fc_block_head *head = (struct ext4_fc_block_head *)bh->b_data;
+	char *pos;
+	int i, ret;
+
+	if (pass == PASS_SCAN) {
+		if (off == 0)
+			memset(state, 0, sizeof(*state));
+		if (!ext4_fc_block_valid(sb, bh, off, expected_tid))
+			return JBD2_FC_REPLAY_STOP;
+		if (le16_to_cpu(head->fb_flags) & EXT4_FC_BLOCK_TAIL)
+			state->fc_valid_blocks = off + 1;
+		return JBD2_FC_REPLAY_CONTINUE;
+	}
+
+	if (pass != PASS_REPLAY || off >= state->fc_valid_blocks) {
+		if (pass == PASS_REPLAY && state->fc_replayed_inodes)
+			ext4_msg(sb, KERN_INFO, "fast commit replay: %d "
+				 "inodes, %d blocks", state->fc_replayed_inodes,
+				 state->fc_replayed_blocks);
+		return JBD2_FC_REPLAY_STOP;
+	}
+
+	pos = bh->b_data + sizeof(struct ext4_fc_block_head);
+	for (i = 0; i < le16_to_cpu(head->fb_count); i++) {
+		ret = ext4_fc_replay_inode(sb, (struct ext4_fc_inode *)pos);
+		if (ret) {
+			ext4_msg(sb, KERN_ERR, "fast commit replay failed "
+				 "in block %d: %d", off, ret);
+			return ret;
+		}
+		pos += sizeof(struct ext4_fc_inode) + EXT4_INODE_SIZE(sb);
+	}
+
+	return JBD2_FC_REPLAY_CONTINUE;
+}
+
+/* Set up fast commits on a freshly loaded journal. */
+int ext4_fc_init(struct super_block *sb, journal_t *journal)
+{
+	if (!test_opt2(sb, JOURNAL_FAST_COMMIT))
+		return 0;
+
+	if (test_opt(sb, DATA_FLAGS) == EXT4_MOUNT_JOURNAL_DATA) {
+		ext4_msg(sb, KERN_ERR, "can't mount with fast_commit "
+			 "in data=journal mode");
+		return -EINVAL;
+	}
+	if (ext4_has_feature_bigalloc(sb)) {
+		ext4_msg(sb, KERN_ERR, "can't mount with fast_commit "
+			 "and bigalloc");
+		return -EINVAL;
+	}
+	if (ext4_has_feature_quota(sb) || test_opt(sb, QUOTA)) {
+		ext4_msg(sb, KERN_ERR, "can't mount with fast_commit "
+			 "and quota");
+		return -EINVAL;
+	}
+	if (ext4_fc_records_per_block(sb) < 1) {
+		ext4_msg(sb, KERN_ERR, "can't mount with fast_commit, "
+			 "inode size too big for the block size");
+		return -EINVAL;
+	}
+	if (!jbd2_journal_set_features(journal, 0, 0,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT)) {
+		ext4_msg(sb, KERN_ERR, "failed to set up fast commit area "
+			 "in the journal");
+		return -EINVAL;
+	}
+	journal->j_fc_cleanup_callback = ext4_fc_cleanup;
+
+	return 0;
+}
+
+void ext4_fc_init_journal(journal_t *journal)
+{
+	journal->j_fc_replay_callback = ext4_fc_replay;
+}
+
+int ext4_fc_info_show(struct seq_file *seq, void *v)
+{
+	struct ext4_sb_info *sbi = EXT4_SB((struct super_block *)seq->private);
+	struct ext4_fc_stats *stats = &sbi->s_fc_stats;
+	int i;
+
+	if (v != SEQ_START_TOKEN)
+		return 0;
+
+	seq_printf(seq, "fc stats:\n%lu commits\n%lu ineligible\n"
+		   "%lu numblks\n", stats->fc_num_commits,
+		   stats->fc_ineligible_commits, stats->fc_numblks);
+	seq_puts(seq, "Ineligible reasons:\n");
+	for (i = 0; i < EXT4_FC_REASON_MAX; i++)
+		seq_printf(seq, "\"%s\":\t%lu\n", fc_ineligible_reasons[i],
+			   stats->fc_ineligible_reason_count[i]);
+
+	return 0;
+}
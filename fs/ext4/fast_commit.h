@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+#ifndef __FAST_COMMIT_H__
+#define __FAST_COMMIT_H__
+
+/*
+ * On-disk format of the fast commit area
+ *
+ * Every fast commit block starts with a struct ext4_fc_block_head followed
+ * by fb_count inode records.  A record is the inode number followed by a
+ * copy of the raw on-disk inode, EXT4_INODE_SIZE() bytes long.  Blocks are
+ * numbered from the start of the fast commit area by fb_seq; the last
+ * block of each fast commit carries EXT4_FC_BLOCK_TAIL and is only written
+ * once all others have reached the disk.
+ */
+#define EXT4_FC_MAGIC		0xfc01e4fc
+
+/* The last block of a fast commit */
+#define EXT4_FC_BLOCK_TAIL	0x0001
+
+struct ext4_fc_block_head {
+	__le32 fb_magic;
+	__le32 fb_tid;		/* transaction this fast commit belongs to */
+	__le16 fb_seq;		/* block index in the fast commit area */
+	__le16 fb_count;	/* number of inode records in this block */
+	__le16 fb_flags;
+	__le16 fb_reserved;
+	__le32 fb_crc;		/* crc32 of the block with fb_crc zeroed */
+};
+
+struct ext4_fc_inode {
+	__le32 fi_ino;
+	__u8 fi_raw_inode[];
+};
+
+/*
+ * Reasons for a transaction not being eligible for fast commits.  Any
+ * fsync in such a transaction falls back to a full jbd2 commit.
+ */
+enum {
+	EXT4_FC_REASON_XATTR = 0,
+	EXT4_FC_REASON_NAMESPACE,
+	EXT4_FC_REASON_INODE,
+	EXT4_FC_REASON_ORPHAN,
+	EXT4_FC_REASON_FREE_BLOCKS,
+	EXT4_FC_REASON_GROUP_INIT,
+	EXT4_FC_REASON_EXTENT_TREE,
+	EXT4_FC_REASON_BLOCK_MAP,
+	EXT4_FC_REASON_SWAP,
+	EXT4_FC_REASON_SUPER,
+	EXT4_FC_REASON_INODE_TYPE,
+	EXT4_FC_REASON_NOSPC,
+	EXT4_FC_REASON_MAX
+};
+
+struct ext4_fc_stats {
+	unsigned long fc_ineligible_reason_count[EXT4_FC_REASON_MAX];
+	unsigned long fc_num_commits;
+	unsigned long fc_ineligible_commits;
+	unsigned long fc_numblks;
+};
+
+/* Fast commit replay state, valid between the recovery passes */
+struct ext4_fc_replay_state {
+	int fc_valid_blocks;	/* blocks up to and including the last tail */
+	int fc_replayed_inodes;
+	int fc_replayed_blocks;
+};
+
+#endif /* __FAST_COMMIT_H__ */
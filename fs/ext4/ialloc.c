@@ -262,6 +262,7 @@ void ext4_free_inode(handle_t *handle, struct inode *inode)
 		return;
 	}
 	sbi = EXT4_SB(sb);
+	ext4_fc_mark_ineligible(sb, EXT4_FC_REASON_INODE, handle);
 
 	ino = inode->i_ino;
 	ext4_debug("freeing inode %lu\n", ino);
@@ -947,6 +948,7 @@ struct inode *__ext4_new_inode(handle_t *handle, struct inode *dir,
 				goto out;
 			}
 		}
+		ext4_fc_mark_ineligible(sb, EXT4_FC_REASON_INODE, handle);
 		BUFFER_TRACE(inode_bitmap_bh, "get_write_access");
 		err = ext4_journal_get_write_access(handle, inode_bitmap_bh);
 		if (err) {
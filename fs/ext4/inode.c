@@ -603,6 +603,8 @@ int ext4_map_blocks(handle_t *handle, struct inode *inode,
 		if (!(flags & EXT4_GET_BLOCKS_CONVERT_UNWRITTEN))
 			return retval;
 
+	ext4_fc_track_map(handle, inode, flags);
+
 	/*
 	 * Here we clear m_flags because after allocating an new extent,
 	 * it will be set again.
@@ -3241,6 +3243,18 @@ static void ext4_readahead(struct readahead_control *rac)
 	ext4_mpage_readpages(inode, rac, NULL);
 }
 
+static int ext4_readpage_thp(struct file *file, struct page *page)
+{
+	struct inode *inode = page->mapping->host;
+
+	/* Data that must be decrypted or verified needs ext4_mpage_readpages() */
+	if (ext4_has_inline_data(inode) || IS_ENCRYPTED(inode) ||
+	    fsverity_active(inode))
+		return -EOPNOTSUPP;
+
+	return iomap_readpage_thp(page, &ext4_iomap_ops);
+}
+
 static void ext4_invalidatepage(struct page *page, unsigned int offset,
 				unsigned int length)
 {
@@ -3604,6 +3618,7 @@ static int ext4_set_page_dirty(struct page *page)
 static const struct address_space_operations ext4_aops = {
 	.readpage		= ext4_readpage,
 	.readahead		= ext4_readahead,
+	.readpage_thp		= ext4_readpage_thp,
 	.writepage		= ext4_writepage,
 	.writepages		= ext4_writepages,
 	.write_begin		= ext4_write_begin,
@@ -3637,6 +3652,7 @@ static const struct address_space_operations ext4_journalled_aops = {
 static const struct address_space_operations ext4_da_aops = {
 	.readpage		= ext4_readpage,
 	.readahead		= ext4_readahead,
+	.readpage_thp		= ext4_readpage_thp,
 	.writepage		= ext4_writepage,
 	.writepages		= ext4_writepages,
 	.write_begin		= ext4_da_write_begin,
@@ -4786,6 +4802,7 @@ struct inode *__ext4_iget(struct super_block *sb, unsigned long ino,
 	} else if (S_ISDIR(inode->i_mode)) {
 		inode->i_op = &ext4_dir_inode_operations;
 		inode->i_fop = &ext4_dir_operations;
+		ext4_dir_set_par_create(inode);
 	} else if (S_ISLNK(inode->i_mode)) {
 		/* VFS does not allow setting these so must be corruption */
 		if (IS_APPEND(inode) || IS_IMMUTABLE(inode)) {
@@ -5621,6 +5638,8 @@ int ext4_mark_iloc_dirty(handle_t *handle,
 
 	/* ext4_do_update_inode() does jbd2_journal_dirty_metadata */
 	err = ext4_do_update_inode(handle, inode, iloc);
+	if (!err)
+		ext4_fc_track_inode(handle, inode);
 	put_bh(iloc->bh);
 	return err;
 }
@@ -36,6 +36,7 @@
 #include <linux/bio.h>
 #include <linux/iversion.h>
 #include <linux/unicode.h>
+#include <linux/hash.h>
 #include "ext4.h"
 #include "ext4_jbd2.h"
 
@@ -50,6 +51,48 @@
 #define NAMEI_RA_BLOCKS  4
 #define NAMEI_RA_SIZE	     (NAMEI_RA_CHUNKS * NAMEI_RA_BLOCKS)
 
+/*
+ * Creates in an indexed directory run with the parent's i_rwsem held shared
+ * (IOP_PAR_CREATE).  i_dir_sem keeps the htree index stable, and a hashed
+ * lock per (directory, leaf block) serializes the creates, lookups and
+ * readdirs touching the same leaf.  Only one leaf lock is held at a time.
+ */
+#define EXT4_DIR_LEAF_LOCK_BITS	8
+
+static struct rw_semaphore ext4_dir_leaf_locks[1 << EXT4_DIR_LEAF_LOCK_BITS];
+
+static struct rw_semaphore *ext4_dir_leaf_lock(struct inode *dir,
+					       ext4_lblk_t block)
+{
+	return &ext4_dir_leaf_locks[hash_64(((u64)dir->i_ino << 32) | block,
+					    EXT4_DIR_LEAF_LOCK_BITS)];
+}
+
+void __init ext4_init_dir_locks(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ext4_dir_leaf_locks); i++)
+		init_rwsem(&ext4_dir_leaf_locks[i]);
+}
+
+/*
+ * Let the VFS create in @dir with its i_rwsem held shared.  Only done for
+ * indexed directories: a linear directory is rewritten as a whole by
+ * ext4_add_entry() and ext4_readdir() cannot be made to wait for that.
+ * Encryption and casefolding can only be set on empty, hence unindexed,
+ * directories, so they never change once this is set.
+ */
+void ext4_dir_set_par_create(struct inode *dir)
+{
+	if (!is_dx(dir) || IS_ENCRYPTED(dir) ||
+	    (dir->i_opflags & IOP_PAR_CREATE))
+		return;
+	spin_lock(&dir->i_lock);
+	dir->i_opflags |= IOP_PAR_CREATE;
+	spin_unlock(&dir->i_lock);
+}
+
 static struct buffer_head *ext4_append(handle_t *handle,
 					struct inode *inode,
 					ext4_lblk_t *block)
@@ -297,7 +340,8 @@ static struct buffer_head * ext4_dx_find_entry(struct inode *dir,
 		struct ext4_filename *fname,
 		struct ext4_dir_entry_2 **res_dir);
 static int ext4_dx_add_entry(handle_t *handle, struct ext4_filename *fname,
-			     struct inode *dir, struct inode *inode);
+			     struct inode *dir, struct inode *inode,
+			     bool shared);
 
 /* checksumming functions */
 void ext4_initialize_dirent_tail(struct buffer_head *bh,
@@ -1084,8 +1128,8 @@ static int htree_dirblock_to_tree(struct file *dir_file,
  * This function returns the number of entries inserted into the tree,
  * or a negative error code.
  */
-int ext4_htree_fill_tree(struct file *dir_file, __u32 start_hash,
-			 __u32 start_minor_hash, __u32 *next_hash)
+static int __ext4_htree_fill_tree(struct file *dir_file, __u32 start_hash,
+				  __u32 start_minor_hash, __u32 *next_hash)
 {
 	struct dx_hash_info hinfo;
 	struct ext4_dir_entry_2 *de;
@@ -1158,8 +1202,10 @@ int ext4_htree_fill_tree(struct file *dir_file, __u32 start_hash,
 		}
 		cond_resched();
 		block = dx_get_block(frame->at);
+		down_read(ext4_dir_leaf_lock(dir, block));
 		ret = htree_dirblock_to_tree(dir_file, dir, block, &hinfo,
 					     start_hash, start_minor_hash);
+		up_read(ext4_dir_leaf_lock(dir, block));
 		if (ret < 0) {
 			err = ret;
 			goto errout;
@@ -1191,6 +1237,19 @@ int ext4_htree_fill_tree(struct file *dir_file, __u32 start_hash,
 	return (err);
 }
 
+int ext4_htree_fill_tree(struct file *dir_file, __u32 start_hash,
+			 __u32 start_minor_hash, __u32 *next_hash)
+{
+	struct inode *dir = file_inode(dir_file);
+	int ret;
+
+	down_read(&EXT4_I(dir)->i_dir_sem);
+	ret = __ext4_htree_fill_tree(dir_file, start_hash, start_minor_hash,
+				     next_hash);
+	up_read(&EXT4_I(dir)->i_dir_sem);
+	return ret;
+}
+
 static inline int search_dirblock(struct buffer_head *bh,
 				  struct inode *dir,
 				  struct ext4_filename *fname,
@@ -1644,13 +1703,17 @@ static struct buffer_head * ext4_dx_find_entry(struct inode *dir,
 		return (struct buffer_head *) frame;
 	do {
 		block = dx_get_block(frame->at);
+		down_read(ext4_dir_leaf_lock(dir, block));
 		bh = ext4_read_dirblock(dir, block, DIRENT_HTREE);
-		if (IS_ERR(bh))
+		if (IS_ERR(bh)) {
+			up_read(ext4_dir_leaf_lock(dir, block));
 			goto errout;
+		}
 
 		retval = search_dirblock(bh, dir, fname,
 					 block << EXT4_BLOCK_SIZE_BITS(sb),
 					 res_dir);
+		up_read(ext4_dir_leaf_lock(dir, block));
 		if (retval == 1)
 			goto success;
 		brelse(bh);
@@ -1684,17 +1747,23 @@ static struct dentry *ext4_lookup(struct inode *dir, struct dentry *dentry, unsi
 	struct inode *inode;
 	struct ext4_dir_entry_2 *de;
 	struct buffer_head *bh;
+	__u32 ino = 0;
 
 	if (dentry->d_name.len > EXT4_NAME_LEN)
 		return ERR_PTR(-ENAMETOOLONG);
 
+	/* A parallel create may split the leaf @de points into */
+	down_read(&EXT4_I(dir)->i_dir_sem);
 	bh = ext4_lookup_entry(dir, dentry, &de);
+	if (!IS_ERR_OR_NULL(bh)) {
+		ino = le32_to_cpu(de->inode);
+		brelse(bh);
+	}
+	up_read(&EXT4_I(dir)->i_dir_sem);
 	if (IS_ERR(bh))
 		return ERR_CAST(bh);
 	inode = NULL;
 	if (bh) {
-		__u32 ino = le32_to_cpu(de->inode);
-		brelse(bh);
 		if (!ext4_valid_inum(dir->i_sb, ino)) {
 			EXT4_ERROR_INODE(dir, "bad inode number: %u", ino);
 			return ERR_PTR(-EFSCORRUPTED);
@@ -1743,13 +1812,17 @@ struct dentry *ext4_get_parent(struct dentry *child)
 	struct ext4_dir_entry_2 * de;
 	struct buffer_head *bh;
 
+	down_read(&EXT4_I(d_inode(child))->i_dir_sem);
 	bh = ext4_find_entry(d_inode(child), &dotdot, &de, NULL);
+	if (!IS_ERR_OR_NULL(bh)) {
+		ino = le32_to_cpu(de->inode);
+		brelse(bh);
+	}
+	up_read(&EXT4_I(d_inode(child))->i_dir_sem);
 	if (IS_ERR(bh))
 		return ERR_CAST(bh);
 	if (!bh)
 		return ERR_PTR(-ENOENT);
-	ino = le32_to_cpu(de->inode);
-	brelse(bh);
 
 	if (!ext4_valid_inum(child->d_sb, ino)) {
 		EXT4_ERROR_INODE(d_inode(child),
@@ -2151,6 +2224,8 @@ static int make_indexed_dir(handle_t *handle, struct ext4_filename *fname,
 	}
 
 	retval = add_dirent_to_buf(handle, fname, dir, inode, de, bh2);
+	if (!retval)
+		ext4_dir_set_par_create(dir);
 out_frames:
 	/*
 	 * Even if the block split failed, we have to properly write
@@ -2210,32 +2285,50 @@ static int ext4_add_entry(handle_t *handle, struct dentry *dentry,
 	if (retval)
 		return retval;
 
+	/*
+	 * Most entries fit into their htree leaf, which only needs that leaf
+	 * locked against parallel creates.  Anything changing the layout of
+	 * the directory retries below with i_dir_sem held exclusive.
+	 */
+	if (is_dx(dir)) {
+		down_read(&EXT4_I(dir)->i_dir_sem);
+		if (is_dx(dir))
+			retval = ext4_dx_add_entry(handle, &fname, dir, inode,
+						   true);
+		else
+			retval = -EAGAIN;
+		up_read(&EXT4_I(dir)->i_dir_sem);
+		if (retval != -EAGAIN && retval != ERR_BAD_DX_DIR)
+			goto out;
+	}
+
+	down_write(&EXT4_I(dir)->i_dir_sem);
 	if (ext4_has_inline_data(dir)) {
 		retval = ext4_try_add_inline_entry(handle, &fname, dir, inode);
 		if (retval < 0)
-			goto out;
+			goto out_unlock;
 		if (retval == 1) {
 			retval = 0;
-			goto out;
+			goto out_unlock;
 		}
 	}
 
 	if (is_dx(dir)) {
-		retval = ext4_dx_add_entry(handle, &fname, dir, inode);
+		retval = ext4_dx_add_entry(handle, &fname, dir, inode, false);
 		if (!retval || (retval != ERR_BAD_DX_DIR))
-			goto out;
+			goto out_unlock;
 		/* Can we just ignore htree data? */
 		if (ext4_has_metadata_csum(sb)) {
 			EXT4_ERROR_INODE(dir,
 				"Directory has corrupted htree index.");
 			retval = -EFSCORRUPTED;
-			goto out;
+			goto out_unlock;
 		}
 		ext4_clear_inode_flag(dir, EXT4_INODE_INDEX);
 		dx_fallback++;
 		retval = ext4_mark_inode_dirty(handle, dir);
 		if (unlikely(retval))
-			goto out;
+			goto out_unlock;
 	}
 	blocks = dir->i_size >> sb->s_blocksize_bits;
 	for (block = 0; block < blocks; block++) {
@@ -2248,19 +2341,19 @@ static int ext4_add_entry(handle_t *handle, struct dentry *dentry,
 		if (IS_ERR(bh)) {
 			retval = PTR_ERR(bh);
 			bh = NULL;
-			goto out;
+			goto out_unlock;
 		}
 		retval = add_dirent_to_buf(handle, &fname, dir, inode,
 					   NULL, bh);
 		if (retval != -ENOSPC)
-			goto out;
+			goto out_unlock;
 
 		if (blocks == 1 && !dx_fallback &&
 		    ext4_has_feature_dir_index(sb)) {
 			retval = make_indexed_dir(handle, &fname, dir,
 						  inode, bh);
 			bh = NULL; /* make_indexed_dir releases bh */
-			goto out;
+			goto out_unlock;
 		}
 		brelse(bh);
 	}
@@ -2269,7 +2362,7 @@ static int ext4_add_entry(handle_t *handle, struct dentry *dentry,
 	if (IS_ERR(bh)) {
 		retval = PTR_ERR(bh);
 		bh = NULL;
-		goto out;
+		goto out_unlock;
 	}
 	de = (struct ext4_dir_entry_2 *) bh->b_data;
 	de->inode = 0;
@@ -2279,6 +2372,8 @@ static int ext4_add_entry(handle_t *handle, struct dentry *dentry,
 		ext4_initialize_dirent_tail(bh, blocksize);
 
 	retval = add_dirent_to_buf(handle, &fname, dir, inode, de, bh);
+out_unlock:
+	up_write(&EXT4_I(dir)->i_dir_sem);
 out:
 	ext4_fname_free_filename(&fname);
 	brelse(bh);
@@ -2288,16 +2383,19 @@ static int ext4_add_entry(handle_t *handle, struct dentry *dentry,
 }
 
 /*
- * Returns 0 for success, or a negative error value
+ * Returns 0 for success, or a negative error value.  With @shared the caller
+ * holds i_dir_sem shared and -EAGAIN means the leaf has to be split.
  */
 static int ext4_dx_add_entry(handle_t *handle, struct ext4_filename *fname,
-			     struct inode *dir, struct inode *inode)
+			     struct inode *dir, struct inode *inode,
+			     bool shared)
 {
 	struct dx_frame frames[EXT4_HTREE_LEVEL], *frame;
 	struct dx_entry *entries, *at;
 	struct buffer_head *bh;
 	struct super_block *sb = dir->i_sb;
 	struct ext4_dir_entry_2 *de;
+	struct rw_semaphore *leaf_lock = NULL;
 	int restart;
 	int err;
 
@@ -2308,6 +2406,10 @@ static int ext4_dx_add_entry(handle_t *handle, struct ext4_filename *fname,
 		return PTR_ERR(frame);
 	entries = frame->entries;
 	at = frame->at;
+	if (shared) {
+		leaf_lock = ext4_dir_leaf_lock(dir, dx_get_block(frame->at));
+		down_write(leaf_lock);
+	}
 	bh = ext4_read_dirblock(dir, dx_get_block(frame->at), DIRENT_HTREE);
 	if (IS_ERR(bh)) {
 		err = PTR_ERR(bh);
@@ -2323,6 +2425,10 @@ static int ext4_dx_add_entry(handle_t *handle, struct ext4_filename *fname,
 	err = add_dirent_to_buf(handle, fname, dir, inode, NULL, bh);
 	if (err != -ENOSPC)
 		goto cleanup;
+	if (shared) {
+		err = -EAGAIN;
+		goto cleanup;
+	}
 
 	err = 0;
 	/* Block full, should compress but for now just split */
@@ -2451,6 +2557,8 @@ static int ext4_dx_add_entry(handle_t *handle, struct ext4_filename *fname,
 journal_error:
 	ext4_std_error(dir->i_sb, err); /* this is a no-op if err == 0 */
 cleanup:
+	if (leaf_lock)
+		up_write(leaf_lock);
 	brelse(bh);
 	dx_release(frames);
 	/* @restart is true means htree-path has been changed, we need to
@@ -2956,6 +3064,8 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 	if (!list_empty(&EXT4_I(inode)->i_orphan))
 		return 0;
 
+	ext4_fc_mark_ineligible(sb, EXT4_FC_REASON_ORPHAN, handle);
+
 	/*
 	 * Orphan handling is only valid for files with data blocks
 	 * being truncated, or files being unlinked. Note that we either
@@ -3037,6 +3147,8 @@ int ext4_orphan_del(handle_t *handle, struct inode *inode)
 	if (list_empty(&ei->i_orphan))
 		return 0;
 
+	ext4_fc_mark_ineligible(inode->i_sb, EXT4_FC_REASON_ORPHAN, handle);
+
 	if (handle) {
 		/* Grab inode buffer early before taking global s_orphan_lock */
 		err = ext4_reserve_inode_write(handle, inode, &iloc);
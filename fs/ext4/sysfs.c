@@ -507,6 +507,8 @@ int ext4_register_sysfs(struct super_block *sb)
 	if (sbi->s_proc) {
 		proc_create_single_data("options", S_IRUGO, sbi->s_proc,
 				ext4_seq_options_show, sb);
+		proc_create_single_data("fc_info", 0444, sbi->s_proc,
+				ext4_fc_info_show, sb);
 		proc_create_single_data("es_shrinker_info", S_IRUGO,
 				sbi->s_proc, ext4_seq_es_shrinker_info_show,
 				sb);
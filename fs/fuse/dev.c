@@ -28,6 +28,8 @@ MODULE_ALIAS("devname:fuse");
 /* Ordinary requests have even IDs, while interrupts IDs are odd */
 #define FUSE_INT_REQ_BIT (1ULL << 0)
 #define FUSE_REQ_ID_STEP (1ULL << 1)
+/* Request ids of the main and the per-cpu input queues are interleaved */
+#define FUSE_REQ_ID_STRIDE (FUSE_REQ_ID_STEP * (nr_cpu_ids + 1))
 
 static struct kmem_cache *fuse_req_cachep;
 
@@ -190,7 +192,7 @@ EXPORT_SYMBOL_GPL(fuse_len_args);
 
 u64 fuse_get_unique(struct fuse_iqueue *fiq)
 {
-	fiq->reqctr += FUSE_REQ_ID_STEP;
+	fiq->reqctr += FUSE_REQ_ID_STRIDE;
 	return fiq->reqctr;
 }
 EXPORT_SYMBOL_GPL(fuse_get_unique);
@@ -226,9 +228,57 @@ __releases(fiq->lock)
 		fuse_len_args(req->args->in_numargs,
 			      (struct fuse_arg *) req->args->in_args);
 	list_add_tail(&req->list, &fiq->pending);
+	WRITE_ONCE(req->fiq, fiq);
 	fiq->ops->wake_pending_and_unlock(fiq);
 }
 
+/*
+ * Lock the input queue for a new request: the per-cpu queue of the
+ * submitting CPU if a device is bound to it, the main queue otherwise.
+ */
+static struct fuse_iqueue *fuse_lock_fiq(struct fuse_conn *fc)
+{
+	struct fuse_iqueue __percpu *mq = smp_load_acquire(&fc->mq);
+	struct fuse_iqueue *fiq;
+
+	if (mq) {
+		fiq = per_cpu_ptr(mq, raw_smp_processor_id());
+		if (READ_ONCE(fiq->nr_readers)) {
+			spin_lock(&fiq->lock);
+			if (fiq->nr_readers)
+				return fiq;
+			spin_unlock(&fiq->lock);
+		}
+	}
+
+	fiq = &fc->iq;
+	spin_lock(&fiq->lock);
+	return fiq;
+}
+
+/*
+ * Lock the input queue a request was queued on.  It can move from a
+ * per-cpu queue to the main queue when the last device bound to the
+ * former goes away.
+ */
+static struct fuse_iqueue *fuse_lock_req_fiq(struct fuse_req *req)
+{
+	struct fuse_iqueue *fiq;
+
+	for (;;) {
+		fiq = READ_ONCE(req->fiq);
+		spin_lock(&fiq->lock);
+		if (fiq == req->fiq)
+			return fiq;
+		spin_unlock(&fiq->lock);
+	}
+}
+
+static struct fuse_iqueue *fuse_dev_fiq(struct fuse_dev *fud)
+{
+	return fud->chan ?: &fud->fc->iq;
+}
+
 void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 		       u64 nodeid, u64 nlookup)
 {
@@ -250,7 +300,7 @@ void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 
 static void flush_bg_queue(struct fuse_conn *fc)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 
 	while (fc->active_background < fc->max_background &&
 	       !list_empty(&fc->bg_queue)) {
@@ -259,7 +309,7 @@ static void flush_bg_queue(struct fuse_conn *fc)
 		req = list_first_entry(&fc->bg_queue, struct fuse_req, list);
 		list_del(&req->list);
 		fc->active_background++;
-		spin_lock(&fiq->lock);
+		fiq = fuse_lock_fiq(fc);
 		req->in.h.unique = fuse_get_unique(fiq);
 		queue_request_and_unlock(fiq, req);
 	}
@@ -383,7 +433,7 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 		if (!err)
 			return;
 
-		spin_lock(&fiq->lock);
+		fiq = fuse_lock_req_fiq(req);
 		/* Request is not yet in userspace, bail out */
 		if (test_bit(FR_PENDING, &req->flags)) {
 			list_del(&req->list);
@@ -404,10 +454,10 @@ static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
 
 static void __fuse_request_send(struct fuse_conn *fc, struct fuse_req *req)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq;
 
 	BUG_ON(test_bit(FR_BACKGROUND, &req->flags));
-	spin_lock(&fiq->lock);
+	fiq = fuse_lock_fiq(fc);
 	if (!fiq->connected) {
 		spin_unlock(&fiq->lock);
 		req->out.h.error = -ENOTCONN;
@@ -1177,7 +1227,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 {
 	ssize_t err;
 	struct fuse_conn *fc = fud->fc;
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue *fiq = fuse_dev_fiq(fud);
 	struct fuse_pqueue *fpq = &fud->pq;
 	struct fuse_req *req;
 	struct fuse_args *args;
@@ -1284,7 +1334,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	/* matches barrier in request_wait_answer() */
 	smp_mb__after_atomic();
 	if (test_bit(FR_INTERRUPTED, &req->flags))
-		queue_interrupt(fiq, req);
+		queue_interrupt(&fc->iq, req);
 	fuse_put_request(fc, req);
 
 	return reqsize;
@@ -2031,7 +2081,7 @@ static __poll_t fuse_dev_poll(struct file *file, poll_table *wait)
 	if (!fud)
 		return EPOLLERR;
 
-	fiq = &fud->fc->iq;
+	fiq = fuse_dev_fiq(fud);
 	poll_wait(file, &fiq->waitq, wait);
 
 	spin_lock(&fiq->lock);
@@ -2090,16 +2140,32 @@ static void end_polls(struct fuse_conn *fc)
  * is OK, the request will in that case be removed from the list before we touch
  * it.
  */
-void fuse_abort_conn(struct fuse_conn *fc)
+static void fuse_iqueue_abort(struct fuse_iqueue *fiq,
+			      struct list_head *to_end)
 {
-	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_req *req;
 
+	spin_lock(&fiq->lock);
+	fiq->connected = 0;
+	list_for_each_entry(req, &fiq->pending, list)
+		clear_bit(FR_PENDING, &req->flags);
+	list_splice_tail_init(&fiq->pending, to_end);
+	while (forget_pending(fiq))
+		kfree(fuse_dequeue_forget(fiq, 1, NULL));
+	wake_up_all(&fiq->waitq);
+	spin_unlock(&fiq->lock);
+	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+}
+
+void fuse_abort_conn(struct fuse_conn *fc)
+{
 	spin_lock(&fc->lock);
 	if (fc->connected) {
 		struct fuse_dev *fud;
 		struct fuse_req *req, *next;
 		LIST_HEAD(to_end);
 		unsigned int i;
+		int cpu;
 
 		/* Background queuing checks fc->connected under bg_lock */
 		spin_lock(&fc->bg_lock);
@@ -2134,16 +2200,12 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		flush_bg_queue(fc);
 		spin_unlock(&fc->bg_lock);
 
-		spin_lock(&fiq->lock);
-		fiq->connected = 0;
-		list_for_each_entry(req, &fiq->pending, list)
-			clear_bit(FR_PENDING, &req->flags);
-		list_splice_tail_init(&fiq->pending, &to_end);
-		while (forget_pending(fiq))
-			kfree(fuse_dequeue_forget(fiq, 1, NULL));
-		wake_up_all(&fiq->waitq);
-		spin_unlock(&fiq->lock);
-		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+		fuse_iqueue_abort(&fc->iq, &to_end);
+		if (fc->mq) {
+			for_each_possible_cpu(cpu)
+				fuse_iqueue_abort(per_cpu_ptr(fc->mq, cpu),
+						  &to_end);
+		}
 		end_polls(fc);
 		wake_up_all(&fc->blocked_waitq);
 		spin_unlock(&fc->lock);
@@ -2162,6 +2224,78 @@ void fuse_wait_aborted(struct fuse_conn *fc)
 	wait_event(fc->blocked_waitq, atomic_read(&fc->num_waiting) == 0);
 }
 
+/*
+ * Drop a device from its per-cpu input queue.  Requests still pending there
+ * when the last bound device goes away are handed to the main queue.
+ */
+static void fuse_dev_unbind_queue(struct fuse_dev *fud)
+{
+	struct fuse_iqueue *chan = fud->chan;
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+	struct fuse_req *req;
+
+	spin_lock(&chan->lock);
+	if (!--chan->nr_readers && !list_empty(&chan->pending)) {
+		spin_lock(&fiq->lock);
+		if (fiq->connected) {
+			list_for_each_entry(req, &chan->pending, list)
+				WRITE_ONCE(req->fiq, fiq);
+			list_splice_tail_init(&chan->pending, &fiq->pending);
+			fiq->ops->wake_pending_and_unlock(fiq);
+		} else {
+			/* fuse_abort_conn() will collect them */
+			spin_unlock(&fiq->lock);
+		}
+	}
+	spin_unlock(&chan->lock);
+	fud->chan = NULL;
+}
+
+static int fuse_dev_bind_queue(struct fuse_dev *fud, u32 cpu)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_iqueue __percpu *mq = NULL;
+	struct fuse_iqueue *chan;
+	int err = 0;
+	int i;
+
+	if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	if (!smp_load_acquire(&fc->mq)) {
+		mq = alloc_percpu(struct fuse_iqueue);
+		if (!mq)
+			return -ENOMEM;
+		for_each_possible_cpu(i) {
+			chan = per_cpu_ptr(mq, i);
+			fuse_iqueue_init(chan, &fuse_dev_fiq_ops, NULL);
+			chan->reqctr = (i + 1) * FUSE_REQ_ID_STEP;
+		}
+	}
+
+	spin_lock(&fc->lock);
+	if (!fc->connected) {
+		err = -ENODEV;
+	} else if (fud->chan) {
+		err = -EBUSY;
+	} else {
+		if (!fc->mq) {
+			/* Pairs with smp_load_acquire() in fuse_lock_fiq() */
+			smp_store_release(&fc->mq, mq);
+			mq = NULL;
+		}
+		chan = per_cpu_ptr(fc->mq, cpu);
+		spin_lock(&chan->lock);
+		chan->nr_readers++;
+		spin_unlock(&chan->lock);
+		fud->chan = chan;
+	}
+	spin_unlock(&fc->lock);
+
+	free_percpu(mq);
+	return err;
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
 	struct fuse_dev *fud = fuse_get_dev(file);
@@ -2172,6 +2306,9 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 		LIST_HEAD(to_end);
 		unsigned int i;
 
+		if (fud->chan)
+			fuse_dev_unbind_queue(fud);
+
 		spin_lock(&fpq->lock);
 		WARN_ON(!list_empty(&fpq->io));
 		for (i = 0; i < FUSE_PQ_HASH_SIZE; i++)
@@ -2199,7 +2336,7 @@ static int fuse_dev_fasync(int fd, struct file *file, int on)
 		return -EPERM;
 
 	/* No locking - fasync_helper does its own locking */
-	return fasync_helper(fd, file, on, &fud->fc->iq.fasync);
+	return fasync_helper(fd, file, on, &fuse_dev_fiq(fud)->fasync);
 }
 
 static int fuse_device_clone(struct fuse_conn *fc, struct file *new)
@@ -2251,6 +2388,28 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 				fput(old);
 			}
 		}
+	} else if (cmd == FUSE_DEV_IOC_PASSTHROUGH_OPEN) {
+		struct fuse_passthrough_out pto;
+
+		err = -EFAULT;
+		if (!copy_from_user(&pto, (void __user *) arg, sizeof(pto))) {
+			struct fuse_dev *fud = fuse_get_dev(file);
+
+			err = -EINVAL;
+			if (fud)
+				err = fuse_passthrough_open(fud, &pto);
+		}
+	} else if (cmd == FUSE_DEV_IOC_BIND_QUEUE) {
+		u32 cpu;
+
+		err = -EFAULT;
+		if (!get_user(cpu, (__u32 __user *) arg)) {
+			struct fuse_dev *fud = fuse_get_dev(file);
+
+			err = -EINVAL;
+			if (fud)
+				err = fuse_dev_bind_queue(fud, cpu);
+		}
 	}
 	return err;
 }
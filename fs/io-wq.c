@@ -1154,3 +1154,45 @@ struct task_struct *io_wq_get_task(struct io_wq *wq)
 {
 	return wq->manager;
 }
+
+/*
+ * Set max number of bounded and unbounded workers per node, index 0 is
+ * bounded and 1 is unbounded. A value of 0 leaves that limit alone. The
+ * previous limits are returned in the same array. Workers above a lowered
+ * limit aren't killed, they just won't be replaced once they exit.
+ */
+int io_wq_max_workers(struct io_wq *wq, int *new_count)
+{
+	int prev[2] = { 0, 0 };
+	int i, node;
+
+	for (i = 0; i < 2; i++) {
+		if (new_count[i] < 0)
+			return -EINVAL;
+		if (new_count[i] > task_rlimit(current, RLIMIT_NPROC))
+			new_count[i] = task_rlimit(current, RLIMIT_NPROC);
+	}
+
+	/* unbounded workers are only allowed for rings with a user */
+	if (!wq->user)
+		new_count[IO_WQ_ACCT_UNBOUND] = 0;
+
+	for_each_node(node) {
+		struct io_wqe *wqe = wq->wqes[node];
+
+		spin_lock_irq(&wqe->lock);
+		for (i = 0; i < 2; i++) {
+			struct io_wqe_acct *acct = &wqe->acct[i];
+
+			prev[i] = max_t(int, acct->max_workers, prev[i]);
+			if (new_count[i])
+				acct->max_workers = new_count[i];
+		}
+		spin_unlock_irq(&wqe->lock);
+	}
+
+	for (i = 0; i < 2; i++)
+		new_count[i] = prev[i];
+
+	return 0;
+}
@@ -61,6 +61,7 @@
 #include <linux/blkdev.h>
 #include <linux/bvec.h>
 #include <linux/net.h>
+#include <linux/in.h>
 #include <net/sock.h>
 #include <net/af_unix.h>
 #include <net/scm.h>
@@ -71,6 +72,7 @@
 #include <linux/sizes.h>
 #include <linux/hugetlb.h>
 #include <linux/highmem.h>
+#include <linux/vmalloc.h>
 #include <linux/namei.h>
 #include <linux/fsnotify.h>
 #include <linux/fadvise.h>
@@ -78,6 +80,8 @@
 #include <linux/fs_struct.h>
 #include <linux/splice.h>
 #include <linux/task_work.h>
+#include <linux/pagemap.h>
+#include <linux/io_uring.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/io_uring.h>
@@ -218,6 +222,49 @@ struct io_buffer {
 	__u16 bid;
 };
 
+/*
+ * A provided buffer group backed by a ring shared with the application,
+ * registered through IORING_REGISTER_PBUF_RING. The application adds
+ * buffers by filling entries and bumping the tail; the kernel consumes
+ * them from ->head under the uring_lock.
+ */
+struct io_buffer_list {
+	struct io_uring_buf_ring	*buf_ring;
+	struct page			**pages;
+	int				nr_pages;
+	__u16				head;
+	__u16				mask;
+};
+
+/*
+ * An SQPOLL thread, shared by all the rings attached to it through
+ * IORING_SETUP_ATTACH_WQ.
+ */
+struct io_sq_data {
+	refcount_t		refs;
+	/* serializes parking the thread */
+	struct mutex		lock;
+
+	/* ctx's that are using this sqd */
+	struct list_head	ctx_list;
+	struct list_head	ctx_new_list;
+	struct mutex		ctx_lock;
+
+	struct task_struct	*thread;
+	struct wait_queue_head	wait;
+	unsigned		sq_thread_idle;
+};
+
+/*
+ * Completions posted inline by the task currently submitting, flushed to
+ * the CQ ring in one go.
+ */
+struct io_comp_state {
+	unsigned int		nr;
+	struct list_head	list;
+	struct task_struct	*task;
+};
+
 struct io_ring_ctx {
 	struct {
 		struct percpu_ref	refs;
@@ -263,9 +310,9 @@ struct io_ring_ctx {
 
 	/* IO offload */
 	struct io_wq		*io_wq;
-	struct task_struct	*sqo_thread;	/* if using sq thread polling */
+	struct io_sq_data	*sq_data;	/* if using sq thread polling */
+	struct list_head	sqd_list;
 	struct mm_struct	*sqo_mm;
-	wait_queue_head_t	sqo_wait;
 
 	/*
 	 * If used, fixed file set. Writers must ensure that ->refs is dead,
@@ -296,6 +343,7 @@ struct io_ring_ctx {
 #endif
 
 	struct idr		io_buffer_idr;
+	struct idr		io_buf_ring_idr;
 
 	struct idr		personality_idr;
 
@@ -313,6 +361,7 @@ struct io_ring_ctx {
 	struct {
 		struct mutex		uring_lock;
 		wait_queue_head_t	wait;
+		struct io_comp_state	submit_comp;
 	} ____cacheline_aligned_in_smp;
 
 	struct {
@@ -352,6 +401,7 @@ struct io_poll_iocb {
 	__poll_t			events;
 	bool				done;
 	bool				canceled;
+	bool				multishot;
 	struct wait_queue_entry		wait;
 };
 
@@ -373,6 +423,8 @@ struct io_accept {
 	struct sockaddr __user		*addr;
 	int __user			*addr_len;
 	int				flags;
+	bool				multishot;
+	u32				file_slot;
 	unsigned long			nofile;
 };
 
@@ -410,6 +462,23 @@ struct io_connect {
 	int				addr_len;
 };
 
+struct io_sendzc {
+	struct file			*file;
+	void __user			*buf;
+	size_t				len;
+	int				msg_flags;
+	struct io_kiocb			*notif;
+};
+
+/*
+ * The request behind a zero-copy send notification. Its CQE is posted once
+ * the network stack let go of the last skb referencing the buffer.
+ */
+struct io_notif {
+	struct file			*file;
+	struct ubuf_info		uarg;
+};
+
 struct io_sr_msg {
 	struct file			*file;
 	union {
@@ -419,12 +488,17 @@ struct io_sr_msg {
 	int				msg_flags;
 	int				bgid;
 	size_t				len;
-	struct io_buffer		*kbuf;
+	union {
+		struct io_buffer	*kbuf;
+		/* REQ_F_BUFFER_RING */
+		void __user		*ring_buf;
+	};
 };
 
 struct io_open {
 	struct file			*file;
 	int				dfd;
+	u32				file_slot;
 	struct filename			*filename;
 	struct open_how			how;
 	unsigned long			nofile;
@@ -503,6 +577,7 @@ struct io_async_rw {
 	struct iovec			*iov;
 	ssize_t				nr_segs;
 	ssize_t				size;
+	struct wait_page_queue		wpq;
 };
 
 struct io_async_ctx {
@@ -511,6 +586,7 @@ struct io_async_ctx {
 		struct io_async_msghdr	msg;
 		struct io_async_connect	connect;
 		struct io_timeout_data	timeout;
+		u8			uring_cmd[IO_URING_CMD_MAX_LEN];
 	};
 };
 
@@ -538,6 +614,7 @@ enum {
 	REQ_F_OVERFLOW_BIT,
 	REQ_F_POLLED_BIT,
 	REQ_F_BUFFER_SELECTED_BIT,
+	REQ_F_BUFFER_RING_BIT,
 	REQ_F_NO_FILE_TABLE_BIT,
 	REQ_F_QUEUE_TIMEOUT_BIT,
 	REQ_F_WORK_INITIALIZED_BIT,
@@ -593,6 +670,8 @@ enum {
 	REQ_F_POLLED		= BIT(REQ_F_POLLED_BIT),
 	/* buffer already selected */
 	REQ_F_BUFFER_SELECTED	= BIT(REQ_F_BUFFER_SELECTED_BIT),
+	/* selected buffer came from a ring mapped group, bid in buf_index */
+	REQ_F_BUFFER_RING	= BIT(REQ_F_BUFFER_RING_BIT),
 	/* doesn't need file table for this request */
 	REQ_F_NO_FILE_TABLE	= BIT(REQ_F_NO_FILE_TABLE_BIT),
 	/* needs to queue linked timeout */
@@ -626,6 +705,8 @@ struct io_kiocb {
 		struct io_timeout	timeout;
 		struct io_connect	connect;
 		struct io_sr_msg	sr_msg;
+		struct io_sendzc	sendzc;
+		struct io_notif		notif;
 		struct io_open		open;
 		struct io_close		close;
 		struct io_files_update	files_update;
@@ -635,6 +716,7 @@ struct io_kiocb {
 		struct io_splice	splice;
 		struct io_provide_buf	pbuf;
 		struct io_statx		statx;
+		struct io_uring_cmd	uring_cmd;
 	};
 
 	struct io_async_ctx		*io;
@@ -679,6 +761,7 @@ struct io_kiocb {
 
 #define IO_PLUG_THRESHOLD		2
 #define IO_IOPOLL_BATCH			8
+#define IO_COMPL_BATCH			32
 
 struct io_submit_state {
 	struct blk_plug		plug;
@@ -879,6 +962,15 @@ static const struct io_op_def io_op_defs[] = {
 		.hash_reg_file		= 1,
 		.unbound_nonreg_file	= 1,
 	},
+	[IORING_OP_SEND_ZC] = {
+		.needs_file		= 1,
+		.unbound_nonreg_file	= 1,
+		.pollout		= 1,
+	},
+	[IORING_OP_URING_CMD] = {
+		.async_ctx		= 1,
+		.needs_file		= 1,
+	},
 };
 
 static void io_wq_submit_work(struct io_wq_work **workptr);
@@ -890,6 +982,8 @@ static void io_queue_linked_timeout(struct io_kiocb *req);
 static int __io_sqe_files_update(struct io_ring_ctx *ctx,
 				 struct io_uring_files_update *ip,
 				 unsigned nr_args);
+static int io_install_fixed_file(struct io_kiocb *req, struct file *file,
+				 bool force_nonblock, u32 slot_index);
 static int io_grab_files(struct io_kiocb *req);
 static void io_complete_rw_common(struct kiocb *kiocb, long res);
 static void io_cleanup_req(struct io_kiocb *req);
@@ -897,6 +991,10 @@ static int io_file_get(struct io_submit_state *state, struct io_kiocb *req,
 		       int fd, struct file **out_file, bool fixed);
 static void __io_queue_sqe(struct io_kiocb *req,
 			   const struct io_uring_sqe *sqe);
+static int io_req_task_work_add(struct io_kiocb *req, struct callback_head *cb,
+				bool twa_signal_ok);
+static int io_sq_thread_acquire_mm(struct io_ring_ctx *ctx,
+				   struct io_kiocb *req);
 
 static struct kmem_cache *req_cachep;
 
@@ -990,18 +1088,20 @@ static struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
 		goto err;
 
 	ctx->flags = p->flags;
-	init_waitqueue_head(&ctx->sqo_wait);
+	INIT_LIST_HEAD(&ctx->sqd_list);
 	init_waitqueue_head(&ctx->cq_wait);
 	INIT_LIST_HEAD(&ctx->cq_overflow_list);
 	init_completion(&ctx->ref_comp);
 	init_completion(&ctx->sq_thread_comp);
 	idr_init(&ctx->io_buffer_idr);
+	idr_init(&ctx->io_buf_ring_idr);
 	idr_init(&ctx->personality_idr);
 	mutex_init(&ctx->uring_lock);
 	init_waitqueue_head(&ctx->wait);
 	spin_lock_init(&ctx->completion_lock);
 	INIT_LIST_HEAD(&ctx->poll_list);
 	INIT_LIST_HEAD(&ctx->defer_list);
+	INIT_LIST_HEAD(&ctx->submit_comp.list);
 	INIT_LIST_HEAD(&ctx->timeout_list);
 	init_waitqueue_head(&ctx->inflight_wait);
 	spin_lock_init(&ctx->inflight_lock);
@@ -1092,6 +1192,28 @@ static inline void io_req_work_drop_env(struct io_kiocb *req)
 	}
 }
 
+/*
+ * Buffered writes to a regular file serialize on the inode lock anyway, so
+ * they're hashed to run one at a time per inode. O_DIRECT writes only need
+ * the lock shared on most filesystems, so let those run in parallel; keeping
+ * overlapping ranges ordered is up to the application, as it is for sync IO.
+ */
+static bool io_should_hash_reg_file(struct io_kiocb *req,
+				    const struct io_op_def *def)
+{
+	if (!def->hash_reg_file)
+		return false;
+
+	switch (req->opcode) {
+	case IORING_OP_WRITEV:
+	case IORING_OP_WRITE_FIXED:
+	case IORING_OP_WRITE:
+		return !(req->rw.kiocb.ki_flags & IOCB_DIRECT);
+	default:
+		return true;
+	}
+}
+
 static inline void io_prep_async_work(struct io_kiocb *req,
 				      struct io_kiocb **link)
 {
@@ -1100,7 +1222,7 @@ static inline void io_prep_async_work(struct io_kiocb *req,
 	io_req_init_async(req);
 
 	if (req->flags & REQ_F_ISREG) {
-		if (def->hash_reg_file)
+		if (io_should_hash_reg_file(req, def))
 			io_wq_hash_work(&req->work, file_inode(req->file));
 	} else {
 		if (def->unbound_nonreg_file)
@@ -1223,8 +1345,8 @@ static void io_cqring_ev_posted(struct io_ring_ctx *ctx)
 {
 	if (waitqueue_active(&ctx->wait))
 		wake_up(&ctx->wait);
-	if (waitqueue_active(&ctx->sqo_wait))
-		wake_up(&ctx->sqo_wait);
+	if (ctx->sq_data && waitqueue_active(&ctx->sq_data->wait))
+		wake_up(&ctx->sq_data->wait);
 	if (io_should_trigger_evfd(ctx))
 		eventfd_signal(ctx->cq_ev_fd, 1);
 }
@@ -1329,6 +1451,49 @@ static void io_cqring_fill_event(struct io_kiocb *req, long res)
 	__io_cqring_fill_event(req, res, 0);
 }
 
+/*
+ * Post a CQE with IORING_CQE_F_MORE set for a multishot request that stays
+ * armed. A live request can't be parked on the overflow list, so this fails
+ * if the CQ ring is full or already overflowing. The caller must then
+ * terminate the request and post its final CQE the regular way.
+ */
+static bool io_cqring_fill_more(struct io_kiocb *req, long res)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_uring_cqe *cqe;
+
+	lockdep_assert_held(&ctx->completion_lock);
+
+	if (test_bit(0, &ctx->cq_check_overflow))
+		return false;
+	cqe = io_get_cqring(ctx);
+	if (!cqe)
+		return false;
+
+	trace_io_uring_complete(ctx, req->user_data, res);
+	WRITE_ONCE(cqe->user_data, req->user_data);
+	WRITE_ONCE(cqe->res, res);
+	WRITE_ONCE(cqe->flags, IORING_CQE_F_MORE);
+	return true;
+}
+
+static bool io_cqring_add_more(struct io_kiocb *req, long res)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	unsigned long flags;
+	bool posted;
+
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	posted = io_cqring_fill_more(req, res);
+	if (posted)
+		io_commit_cqring(ctx);
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+
+	if (posted)
+		io_cqring_ev_posted(ctx);
+	return posted;
+}
+
 static void __io_cqring_add_event(struct io_kiocb *req, long res, long cflags)
 {
 	struct io_ring_ctx *ctx = req->ctx;
@@ -1347,6 +1512,71 @@ static void io_cqring_add_event(struct io_kiocb *req, long res)
 	__io_cqring_add_event(req, res, 0);
 }
 
+/*
+ * Post all completions batched up by the submitter under a single
+ * completion_lock round trip, with one wakeup for the lot.
+ */
+static void io_submit_flush_completions(struct io_ring_ctx *ctx)
+{
+	struct io_comp_state *cs = &ctx->submit_comp;
+
+	if (!cs->nr)
+		return;
+
+	spin_lock_irq(&ctx->completion_lock);
+	while (!list_empty(&cs->list)) {
+		struct io_kiocb *req;
+
+		req = list_first_entry(&cs->list, struct io_kiocb, list);
+		list_del(&req->list);
+		__io_cqring_fill_event(req, req->result, req->cflags);
+		if (!(req->flags & REQ_F_LINK_HEAD)) {
+			req->flags |= REQ_F_COMP_LOCKED;
+			io_put_req(req);
+		} else {
+			/* linked requests may need the lock for their own CQEs */
+			spin_unlock_irq(&ctx->completion_lock);
+			io_put_req(req);
+			spin_lock_irq(&ctx->completion_lock);
+		}
+	}
+	io_commit_cqring(ctx);
+	spin_unlock_irq(&ctx->completion_lock);
+
+	io_cqring_ev_posted(ctx);
+	cs->nr = 0;
+}
+
+/*
+ * Complete a request and drop the completion reference. Completions run by
+ * the submitting task while inside io_submit_sqes() are batched rather than
+ * taking the completion_lock one by one. Anything else, e.g. io-wq workers
+ * or IRQ completions, posts directly.
+ */
+static void __io_req_complete(struct io_kiocb *req, long res,
+			      unsigned int cflags)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_comp_state *cs = &ctx->submit_comp;
+
+	if (in_interrupt() || READ_ONCE(cs->task) != current) {
+		__io_cqring_add_event(req, res, cflags);
+		io_put_req(req);
+		return;
+	}
+
+	req->result = res;
+	req->cflags = cflags;
+	list_add_tail(&req->list, &cs->list);
+	if (++cs->nr >= IO_COMPL_BATCH)
+		io_submit_flush_completions(ctx);
+}
+
+static void io_req_complete(struct io_kiocb *req, long res)
+{
+	__io_req_complete(req, res, 0);
+}
+
 static inline bool io_is_fallback_req(struct io_kiocb *req)
 {
 	return req == (struct io_kiocb *)
@@ -1638,7 +1868,7 @@ static void io_wq_assign_next(struct io_wq_work **workptr, struct io_kiocb *nxt)
 	struct io_kiocb *link;
 	const struct io_op_def *def = &io_op_defs[nxt->opcode];
 
-	if ((nxt->flags & REQ_F_ISREG) && def->hash_reg_file)
+	if ((nxt->flags & REQ_F_ISREG) && io_should_hash_reg_file(nxt, def))
 		io_wq_hash_work(&nxt->work, file_inode(nxt->file));
 
 	*workptr = &nxt->work;
@@ -1752,6 +1982,11 @@ static int io_put_kbuf(struct io_kiocb *req)
 	struct io_buffer *kbuf;
 	int cflags;
 
+	if (req->flags & REQ_F_BUFFER_RING) {
+		cflags = req->buf_index << IORING_CQE_BUFFER_SHIFT;
+		return cflags | IORING_CQE_F_BUFFER;
+	}
+
 	kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
 	cflags = kbuf->bid << IORING_CQE_BUFFER_SHIFT;
 	cflags |= IORING_CQE_F_BUFFER;
@@ -1998,10 +2233,10 @@ static inline void req_set_fail_links(struct io_kiocb *req)
 		req->flags |= REQ_F_FAIL_LINK;
 }
 
-static void io_complete_rw_common(struct kiocb *kiocb, long res)
+static unsigned int __io_complete_rw_common(struct kiocb *kiocb, long res)
 {
 	struct io_kiocb *req = container_of(kiocb, struct io_kiocb, rw.kiocb);
-	int cflags = 0;
+	unsigned int cflags = 0;
 
 	if (kiocb->ki_flags & IOCB_WRITE)
 		kiocb_end_write(req);
@@ -2010,15 +2245,21 @@ static void io_complete_rw_common(struct kiocb *kiocb, long res)
 		req_set_fail_links(req);
 	if (req->flags & REQ_F_BUFFER_SELECTED)
 		cflags = io_put_kbuf(req);
-	__io_cqring_add_event(req, res, cflags);
+	return cflags;
+}
+
+static void io_complete_rw_common(struct kiocb *kiocb, long res)
+{
+	struct io_kiocb *req = container_of(kiocb, struct io_kiocb, rw.kiocb);
+
+	__io_cqring_add_event(req, res, __io_complete_rw_common(kiocb, res));
 }
 
 static void io_complete_rw(struct kiocb *kiocb, long res, long res2)
 {
 	struct io_kiocb *req = container_of(kiocb, struct io_kiocb, rw.kiocb);
 
-	io_complete_rw_common(kiocb, res);
-	io_put_req(req);
+	__io_req_complete(req, res, __io_complete_rw_common(kiocb, res));
 }
 
 static void io_complete_rw_iopoll(struct kiocb *kiocb, long res, long res2)
@@ -2073,8 +2314,8 @@ static void io_iopoll_req_issued(struct io_kiocb *req)
 		list_add_tail(&req->list, &ctx->poll_list);
 
 	if ((ctx->flags & IORING_SETUP_SQPOLL) &&
-	    wq_has_sleeper(&ctx->sqo_wait))
-		wake_up(&ctx->sqo_wait);
+	    wq_has_sleeper(&ctx->sq_data->wait))
+		wake_up(&ctx->sq_data->wait);
 }
 
 static void __io_state_file_put(struct io_submit_state *state)
@@ -2187,6 +2428,9 @@ static int io_prep_rw(struct io_kiocb *req, const struct io_uring_sqe *sqe,
 	if (force_nonblock)
 		kiocb->ki_flags |= IOCB_NOWAIT;
 
+	/* io_uring owns the kiocb, direct IO may recycle its bios */
+	kiocb->ki_flags |= IOCB_ALLOC_CACHE;
+
 	if (ctx->flags & IORING_SETUP_IOPOLL) {
 		if (!(kiocb->ki_flags & IOCB_DIRECT) ||
 		    !kiocb->ki_filp->f_op->iopoll)
@@ -2241,27 +2485,23 @@ static void kiocb_done(struct kiocb *kiocb, ssize_t ret)
 		io_rw_done(kiocb, ret);
 }
 
-static ssize_t io_import_fixed(struct io_kiocb *req, int rw,
-			       struct iov_iter *iter)
+static ssize_t __io_import_fixed(struct io_ring_ctx *ctx, u16 buf_index,
+				 u64 buf_addr, size_t len, int rw,
+				 struct iov_iter *iter)
 {
-	struct io_ring_ctx *ctx = req->ctx;
-	size_t len = req->rw.len;
 	struct io_mapped_ubuf *imu;
-	u16 index, buf_index;
 	size_t offset;
-	u64 buf_addr;
+	u16 index;
 
 	/* attempt to use fixed buffers without having provided iovecs */
 	if (unlikely(!ctx->user_bufs))
 		return -EFAULT;
 
-	buf_index = req->buf_index;
 	if (unlikely(buf_index >= ctx->nr_user_bufs))
 		return -EFAULT;
 
 	index = array_index_nospec(buf_index, ctx->nr_user_bufs);
 	imu = &ctx->user_bufs[index];
-	buf_addr = req->rw.addr;
 
 	/* overflow */
 	if (buf_addr + len < buf_addr)
@@ -2315,6 +2555,13 @@ static ssize_t io_import_fixed(struct io_kiocb *req, int rw,
 	return len;
 }
 
+static ssize_t io_import_fixed(struct io_kiocb *req, int rw,
+			       struct iov_iter *iter)
+{
+	return __io_import_fixed(req->ctx, req->buf_index, req->rw.addr,
+				 req->rw.len, rw, iter);
+}
+
 static void io_ring_submit_unlock(struct io_ring_ctx *ctx, bool needs_lock)
 {
 	if (needs_lock)
@@ -2367,12 +2614,70 @@ static struct io_buffer *io_buffer_select(struct io_kiocb *req, size_t *len,
 	return kbuf;
 }
 
+/*
+ * Take the next buffer from a ring mapped group. Returns NULL if @bgid
+ * isn't such a group, so the caller can fall back to the classic lists.
+ */
+static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
+					  int bgid, bool needs_lock)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_buffer_list *bl;
+	void __user *ret = NULL;
+
+	io_ring_submit_lock(ctx, needs_lock);
+
+	lockdep_assert_held(&ctx->uring_lock);
+
+	bl = idr_find(&ctx->io_buf_ring_idr, bgid);
+	if (bl) {
+		struct io_uring_buf_ring *br = bl->buf_ring;
+		struct io_uring_buf *buf;
+		__u32 buf_len;
+
+		/* pairs with the application's release store of the tail */
+		if (smp_load_acquire(&br->tail) == bl->head) {
+			ret = ERR_PTR(-ENOBUFS);
+			goto out;
+		}
+
+		buf = &br->bufs[bl->head & bl->mask];
+		buf_len = READ_ONCE(buf->len);
+		if (*len > buf_len)
+			*len = buf_len;
+		req->buf_index = READ_ONCE(buf->bid);
+		req->flags |= REQ_F_BUFFER_SELECTED | REQ_F_BUFFER_RING;
+		ret = u64_to_user_ptr(READ_ONCE(buf->addr));
+		bl->head++;
+	}
+out:
+	io_ring_submit_unlock(ctx, needs_lock);
+	return ret;
+}
+
 static void __user *io_rw_buffer_select(struct io_kiocb *req, size_t *len,
 					bool needs_lock)
 {
 	struct io_buffer *kbuf;
+	void __user *buf;
 	u16 bgid;
 
+	if (req->flags & REQ_F_BUFFER_RING) {
+		*len = req->rw.len;
+		return u64_to_user_ptr(req->rw.addr);
+	}
+	if (!(req->flags & REQ_F_BUFFER_SELECTED)) {
+		buf = io_ring_buffer_select(req, len, req->buf_index,
+					    needs_lock);
+		if (buf) {
+			if (!IS_ERR(buf)) {
+				req->rw.addr = (u64) (unsigned long) buf;
+				req->rw.len = *len;
+			}
+			return buf;
+		}
+	}
+
 	kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
 	bgid = req->buf_index;
 	kbuf = io_buffer_select(req, len, bgid, kbuf, needs_lock);
@@ -2434,6 +2739,11 @@ static ssize_t __io_iov_buffer_select(struct io_kiocb *req, struct iovec *iov,
 static ssize_t io_iov_buffer_select(struct io_kiocb *req, struct iovec *iov,
 				    bool needs_lock)
 {
+	if (req->flags & REQ_F_BUFFER_RING) {
+		iov[0].iov_base = u64_to_user_ptr(req->rw.addr);
+		iov[0].iov_len = req->rw.len;
+		return 0;
+	}
 	if (req->flags & REQ_F_BUFFER_SELECTED) {
 		struct io_buffer *kbuf;
 
@@ -2657,6 +2967,150 @@ static int io_read_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe,
 	return 0;
 }
 
+static void io_req_task_cancel(struct callback_head *cb)
+{
+	struct io_kiocb *req = container_of(cb, struct io_kiocb, task_work);
+	struct io_ring_ctx *ctx = req->ctx;
+
+	spin_lock_irq(&ctx->completion_lock);
+	io_cqring_fill_event(req, -ECANCELED);
+	io_commit_cqring(ctx);
+	spin_unlock_irq(&ctx->completion_lock);
+	io_cqring_ev_posted(ctx);
+
+	req_set_fail_links(req);
+	io_double_put_req(req);
+	percpu_ref_put(&ctx->refs);
+}
+
+static void io_req_task_submit(struct callback_head *cb)
+{
+	struct io_kiocb *req = container_of(cb, struct io_kiocb, task_work);
+	struct io_ring_ctx *ctx = req->ctx;
+
+	if (io_sq_thread_acquire_mm(ctx, req)) {
+		io_cqring_add_event(req, -EFAULT);
+		req_set_fail_links(req);
+		io_double_put_req(req);
+	} else {
+		mutex_lock(&ctx->uring_lock);
+		__io_queue_sqe(req, NULL);
+		mutex_unlock(&ctx->uring_lock);
+	}
+	percpu_ref_put(&ctx->refs);
+}
+
+static int io_async_buf_func(struct wait_queue_entry *wait, unsigned mode,
+			     int sync, void *arg)
+{
+	struct wait_page_queue *wpq;
+	struct io_kiocb *req = wait->private;
+	struct wait_page_key *key = arg;
+	struct task_struct *tsk;
+	int ret;
+
+	wpq = container_of(wait, struct wait_page_queue, wait);
+
+	if (!wake_page_match(wpq, key))
+		return 0;
+
+	list_del_init(&wait->entry);
+
+	init_task_work(&req->task_work, io_req_task_submit);
+	percpu_ref_get(&req->ctx->refs);
+
+	/* submit ref gets dropped, acquire a new one */
+	refcount_inc(&req->refs);
+	ret = io_req_task_work_add(req, &req->task_work, true);
+	if (unlikely(ret)) {
+		/* queue just for cancelation */
+		init_task_work(&req->task_work, io_req_task_cancel);
+		tsk = io_wq_get_task(req->ctx->io_wq);
+		task_work_add(tsk, &req->task_work, 0);
+		wake_up_process(tsk);
+	}
+	return 1;
+}
+
+static inline int kiocb_wait_page_queue_init(struct kiocb *kiocb,
+					     struct wait_page_queue *wait,
+					     wait_queue_func_t func,
+					     void *data)
+{
+	/* Can't support async wakeup with polled IO */
+	if (kiocb->ki_flags & IOCB_HIPRI)
+		return -EINVAL;
+	if (!(kiocb->ki_filp->f_mode & FMODE_BUF_RASYNC))
+		return -EOPNOTSUPP;
+
+	wait->wait.func = func;
+	wait->wait.private = data;
+	wait->wait.flags = 0;
+	INIT_LIST_HEAD(&wait->wait.entry);
+	kiocb->ki_flags |= IOCB_WAITQ;
+	kiocb->ki_flags &= ~IOCB_NOWAIT;
+	kiocb->ki_waitq = wait;
+	return 0;
+}
+
+/*
+ * This controls whether a given IO request should be armed for async page
+ * based retry. If we return false here, the request is handed to the async
+ * worker threads for retry. If we're doing buffered reads on a regular file,
+ * we prepare a private wait_page_queue entry and retry the operation. This
+ * will either succeed because the page is now uptodate and unlocked, or it
+ * will register a callback when the page is unlocked at IO completion. Through
+ * that callback, io_uring uses task_work to setup a retry of the operation.
+ * That retry will attempt the buffered read again. The retry will generally
+ * succeed, or in rare cases where it fails, we then fall back to using the
+ * async worker threads for a blocking retry.
+ */
+static bool io_rw_should_retry(struct io_kiocb *req)
+{
+	struct kiocb *kiocb = &req->rw.kiocb;
+	int ret;
+
+	/* never retry for NOWAIT, we just complete with -EAGAIN */
+	if (req->flags & REQ_F_NOWAIT)
+		return false;
+
+	/* already tried, or we're doing O_DIRECT */
+	if (kiocb->ki_flags & (IOCB_DIRECT | IOCB_WAITQ))
+		return false;
+	/*
+	 * just use poll if we can, and don't attempt if the fs doesn't
+	 * support callback based unlocks
+	 */
+	if (file_can_poll(req->file) || !(req->file->f_mode & FMODE_BUF_RASYNC))
+		return false;
+
+	/*
+	 * If request type doesn't require req->io to defer in general,
+	 * we need to allocate it here
+	 */
+	if (!req->io && __io_alloc_async_ctx(req))
+		return false;
+
+	ret = kiocb_wait_page_queue_init(kiocb, &req->io->rw.wpq,
+						io_async_buf_func, req);
+	if (!ret) {
+		io_get_req_task(req);
+		return true;
+	}
+
+	return false;
+}
+
+static ssize_t io_iter_do_read(struct io_kiocb *req, struct iov_iter *iter)
+{
+	if (req->file->f_op->read_iter)
+		return call_read_iter(req->file, &req->rw.kiocb, iter);
+	else if (req->file->f_op->read)
+		return loop_rw_iter(READ, req->file, &req->rw.kiocb, iter);
+	else
+		return -EINVAL;
+}
+
 static int io_read(struct io_kiocb *req, bool force_nonblock)
 {
 	struct iovec inline_vecs[UIO_FASTIOV], *iovec = inline_vecs;
@@ -2669,9 +3123,9 @@ static int io_read(struct io_kiocb *req, bool force_nonblock)
 	if (ret < 0)
 		return ret;
 
-	/* Ensure we clear previously set non-block flag */
+	/* Ensure we clear previously set non-block and page wait flags */
 	if (!force_nonblock)
-		kiocb->ki_flags &= ~IOCB_NOWAIT;
+		kiocb->ki_flags &= ~(IOCB_NOWAIT | IOCB_WAITQ);
 
 	req->result = 0;
 	io_size = ret;
@@ -2690,12 +3144,7 @@ static int io_read(struct io_kiocb *req, bool force_nonblock)
 	if (!ret) {
 		ssize_t ret2;
 
-		if (req->file->f_op->read_iter)
-			ret2 = call_read_iter(req->file, kiocb, &iter);
-		else if (req->file->f_op->read)
-			ret2 = loop_rw_iter(READ, req->file, kiocb, &iter);
-		else
-			ret2 = -EINVAL;
+		ret2 = io_iter_do_read(req, &iter);
 
 		/* no retry on NONBLOCK marked file */
 		if (ret2 == -EAGAIN && (req->file->f_flags & O_NONBLOCK)) {
@@ -2713,6 +3162,19 @@ static int io_read(struct io_kiocb *req, bool force_nonblock)
 						inline_vecs, &iter);
 			if (ret)
 				goto out_free;
+			/* if we can retry, do so with the callbacks armed */
+			if (io_file_supports_async(req->file, READ) &&
+			    io_rw_should_retry(req)) {
+				ret2 = io_iter_do_read(req, &iter);
+				if (ret2 == -EIOCBQUEUED) {
+					ret = 0;
+					goto out_free;
+				} else if (ret2 != -EAGAIN) {
+					kiocb_done(kiocb, ret2);
+					goto out_free;
+				}
+			}
+			kiocb->ki_flags &= ~IOCB_WAITQ;
 			/* any defer here is final, must blocking retry */
 			if (!(req->flags & REQ_F_NOWAIT) &&
 			    !file_can_poll(req->file))
@@ -2918,10 +3380,9 @@ static int io_tee(struct io_kiocb *req, bool force_nonblock)
 	io_put_file(req, in, (sp->flags & SPLICE_F_FD_IN_FIXED));
 	req->flags &= ~REQ_F_NEED_CLEANUP;
 
-	io_cqring_add_event(req, ret);
 	if (ret != sp->len)
 		req_set_fail_links(req);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -2955,10 +3416,9 @@ static int io_splice(struct io_kiocb *req, bool force_nonblock)
 	io_put_file(req, in, (sp->flags & SPLICE_F_FD_IN_FIXED));
 	req->flags &= ~REQ_F_NEED_CLEANUP;
 
-	io_cqring_add_event(req, ret);
 	if (ret != sp->len)
 		req_set_fail_links(req);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -2972,8 +3432,7 @@ static int io_nop(struct io_kiocb *req)
 	if (unlikely(ctx->flags & IORING_SETUP_IOPOLL))
 		return -EINVAL;
 
-	io_cqring_add_event(req, 0);
-	io_put_req(req);
+	io_req_complete(req, 0);
 	return 0;
 }
 
@@ -3012,8 +3471,7 @@ static int io_fsync(struct io_kiocb *req, bool force_nonblock)
 				req->sync.flags & IORING_FSYNC_DATASYNC);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -3046,8 +3504,7 @@ static int io_fallocate(struct io_kiocb *req, bool force_nonblock)
 	current->signal->rlim[RLIMIT_FSIZE].rlim_cur = RLIM_INFINITY;
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -3065,6 +3522,10 @@ static int __io_openat_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe
 	if (!(req->open.how.flags & O_PATH) && force_o_largefile())
 		req->open.how.flags |= O_LARGEFILE;
 
+	req->open.file_slot = READ_ONCE(sqe->file_index);
+	if (req->open.file_slot && (req->open.how.flags & O_CLOEXEC))
+		return -EINVAL;
+
 	req->open.dfd = READ_ONCE(sqe->fd);
 	fname = u64_to_user_ptr(READ_ONCE(sqe->addr));
 	req->open.filename = getname(fname);
@@ -3117,6 +3578,7 @@ static int io_openat2_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 
 static int io_openat2(struct io_kiocb *req, bool force_nonblock)
 {
+	bool fixed = !!req->open.file_slot;
 	struct open_flags op;
 	struct file *file;
 	int ret;
@@ -3128,25 +3590,33 @@ static int io_openat2(struct io_kiocb *req, bool force_nonblock)
 	if (ret)
 		goto err;
 
-	ret = __get_unused_fd_flags(req->open.how.flags, req->open.nofile);
-	if (ret < 0)
-		goto err;
+	if (!fixed) {
+		ret = __get_unused_fd_flags(req->open.how.flags,
+					    req->open.nofile);
+		if (ret < 0)
+			goto err;
+	}
 
 	file = do_filp_open(req->open.dfd, req->open.filename, &op);
 	if (IS_ERR(file)) {
-		put_unused_fd(ret);
+		if (!fixed)
+			put_unused_fd(ret);
 		ret = PTR_ERR(file);
-	} else {
-		fsnotify_open(file);
-		fd_install(ret, file);
+		goto err;
 	}
+
+	fsnotify_open(file);
+	if (!fixed)
+		fd_install(ret, file);
+	else
+		ret = io_install_fixed_file(req, file, force_nonblock,
+					    req->open.file_slot - 1);
 err:
 	putname(req->open.filename);
 	req->flags &= ~REQ_F_NEED_CLEANUP;
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -3219,8 +3689,7 @@ static int io_remove_buffers(struct io_kiocb *req, bool force_nonblock)
 	io_ring_submit_lock(ctx, !force_nonblock);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -3289,6 +3758,12 @@ static int io_provide_buffers(struct io_kiocb *req, bool force_nonblock)
 
 	lockdep_assert_held(&ctx->uring_lock);
 
+	/* ring mapped groups are replenished through the ring only */
+	if (idr_find(&ctx->io_buf_ring_idr, p->bgid)) {
+		ret = -EEXIST;
+		goto out;
+	}
+
 	list = head = idr_find(&ctx->io_buffer_idr, p->bgid);
 
 	ret = io_add_buffers(p, &head);
@@ -3307,8 +3782,7 @@ static int io_provide_buffers(struct io_kiocb *req, bool force_nonblock)
 	io_ring_submit_unlock(ctx, !force_nonblock);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -3351,8 +3825,7 @@ static int io_epoll_ctl(struct io_kiocb *req, bool force_nonblock)
 
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 #else
 	return -EOPNOTSUPP;
@@ -3388,8 +3861,7 @@ static int io_madvise(struct io_kiocb *req, bool force_nonblock)
 	ret = do_madvise(ma->addr, ma->len, ma->advice);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 #else
 	return -EOPNOTSUPP;
@@ -3428,8 +3900,7 @@ static int io_fadvise(struct io_kiocb *req, bool force_nonblock)
 	ret = vfs_fadvise(req->file, fa->offset, fa->len, fa->advice);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -3468,8 +3939,7 @@ static int io_statx(struct io_kiocb *req, bool force_nonblock)
 
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -3560,8 +4030,112 @@ static int io_sync_file_range(struct io_kiocb *req, bool force_nonblock)
 				req->sync.flags);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
+	return 0;
+}
+
+static void io_uring_cmd_work(struct callback_head *cb)
+{
+	struct io_kiocb *req = container_of(cb, struct io_kiocb, task_work);
+
+	req->uring_cmd.task_work_cb(&req->uring_cmd);
+}
+
+void io_uring_cmd_complete_in_task(struct io_uring_cmd *ioucmd,
+			void (*task_work_cb)(struct io_uring_cmd *))
+{
+	struct io_kiocb *req = container_of(ioucmd, struct io_kiocb, uring_cmd);
+	struct task_struct *tsk;
+
+	ioucmd->task_work_cb = task_work_cb;
+	init_task_work(&req->task_work, io_uring_cmd_work);
+	if (unlikely(io_req_task_work_add(req, &req->task_work, true))) {
+		/* task is exiting, have the io-wq manager run it instead */
+		tsk = io_wq_get_task(req->ctx->io_wq);
+		task_work_add(tsk, &req->task_work, 0);
+		wake_up_process(tsk);
+	}
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_complete_in_task);
+
+/*
+ * Called by the driver once an -EIOCBQUEUED command has finished, posts
+ * the CQE and drops the submission reference.
+ */
+void io_uring_cmd_done(struct io_uring_cmd *ioucmd, ssize_t ret)
+{
+	struct io_kiocb *req = container_of(ioucmd, struct io_kiocb, uring_cmd);
+
+	if (ret < 0)
+		req_set_fail_links(req);
+	io_req_complete(req, ret);
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_done);
+
+int io_uring_cmd_import_fixed(u64 ubuf, unsigned long len, int rw,
+			      struct iov_iter *iter,
+			      struct io_uring_cmd *ioucmd)
+{
+	struct io_kiocb *req = container_of(ioucmd, struct io_kiocb, uring_cmd);
+	ssize_t ret;
+
+	if (!(ioucmd->flags & IORING_URING_CMD_FIXED))
+		return -EINVAL;
+
+	ret = __io_import_fixed(req->ctx, req->buf_index, ubuf, len, rw, iter);
+	return ret < 0 ? ret : 0;
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_import_fixed);
+
+static int io_uring_cmd_prep(struct io_kiocb *req,
+			     const struct io_uring_sqe *sqe)
+{
+	struct io_uring_cmd *ioucmd = &req->uring_cmd;
+	void __user *ucmd;
+
+	if (unlikely(req->ctx->flags & IORING_SETUP_IOPOLL))
+		return -EINVAL;
+	if (sqe->ioprio || sqe->__pad1)
+		return -EINVAL;
+
+	ioucmd->flags = READ_ONCE(sqe->uring_cmd_flags);
+	if (ioucmd->flags & ~IORING_URING_CMD_FIXED)
+		return -EINVAL;
+	if (ioucmd->flags & IORING_URING_CMD_FIXED)
+		req->buf_index = READ_ONCE(sqe->buf_index);
+
+	ioucmd->cmd_len = READ_ONCE(sqe->len);
+	if (!ioucmd->cmd_len || ioucmd->cmd_len > IO_URING_CMD_MAX_LEN)
+		return -EINVAL;
+
+	/* the driver may be issued from io-wq, so copy the command now */
+	if (!req->io && __io_alloc_async_ctx(req))
+		return -ENOMEM;
+	ucmd = u64_to_user_ptr(READ_ONCE(sqe->addr));
+	if (copy_from_user(req->io->uring_cmd, ucmd, ioucmd->cmd_len))
+		return -EFAULT;
+
+	ioucmd->cmd = req->io->uring_cmd;
+	ioucmd->ucmd = ucmd;
+	ioucmd->cmd_op = READ_ONCE(sqe->cmd_op);
+	return 0;
+}
+
+static int io_uring_cmd(struct io_kiocb *req, bool force_nonblock)
+{
+	struct io_uring_cmd *ioucmd = &req->uring_cmd;
+	struct file *file = req->file;
+	int ret;
+
+	if (!file->f_op->uring_cmd)
+		return -EOPNOTSUPP;
+
+	ret = file->f_op->uring_cmd(ioucmd,
+				    force_nonblock ? IO_URING_F_NONBLOCK : 0);
+	if (force_nonblock && ret == -EAGAIN)
+		return -EAGAIN;
+	if (ret != -EIOCBQUEUED)
+		io_uring_cmd_done(ioucmd, ret);
 	return 0;
 }
 
@@ -3661,10 +4235,9 @@ static int io_sendmsg(struct io_kiocb *req, bool force_nonblock)
 	if (kmsg && kmsg->iov != kmsg->fast_iov)
 		kfree(kmsg->iov);
 	req->flags &= ~REQ_F_NEED_CLEANUP;
-	io_cqring_add_event(req, ret);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -3689,6 +4262,7 @@ static int io_send(struct io_kiocb *req, bool force_nonblock)
 		msg.msg_control = NULL;
 		msg.msg_controllen = 0;
 		msg.msg_namelen = 0;
+		msg.msg_ubuf = NULL;
 
 		flags = req->sr_msg.msg_flags;
 		if (flags & MSG_DONTWAIT)
@@ -3704,9 +4278,143 @@ static int io_send(struct io_kiocb *req, bool force_nonblock)
 			ret = -EINTR;
 	}
 
-	io_cqring_add_event(req, ret);
 	if (ret < 0)
 		req_set_fail_links(req);
+	io_req_complete(req, ret);
+	return 0;
+}
+
+static void io_sendzc_notif_callback(struct ubuf_info *uarg, bool success)
+{
+	struct io_kiocb *notif = container_of(uarg, struct io_kiocb,
+					      notif.uarg);
+
+	__io_cqring_add_event(notif, success ? 0 : IORING_NOTIF_USAGE_ZC_COPIED,
+			      IORING_CQE_F_NOTIF);
+	io_put_req(notif);
+}
+
+static struct io_kiocb *io_alloc_notif(struct io_kiocb *req)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_kiocb *notif;
+	struct ubuf_info *uarg;
+
+	notif = io_alloc_req(ctx, NULL);
+	if (unlikely(!notif))
+		return NULL;
+
+	percpu_ref_get(&ctx->refs);
+	notif->opcode = IORING_OP_NOP;
+	notif->user_data = req->user_data;
+	notif->io = NULL;
+	notif->file = NULL;
+	notif->ctx = ctx;
+	notif->flags = 0;
+	refcount_set(&notif->refs, 1);
+	notif->task = req->task;
+	notif->result = 0;
+	INIT_LIST_HEAD(&notif->link_list);
+
+	uarg = &notif->notif.uarg;
+	uarg->callback = io_sendzc_notif_callback;
+	uarg->flags = UARG_REFCOUNTED;
+	uarg->zerocopy = 1;
+	uarg->mmp.user = NULL;
+	/* dropped once the send itself has completed */
+	refcount_set(&uarg->refcnt, 1);
+	return notif;
+}
+
+static int io_sendzc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
+{
+	struct io_sendzc *zc = &req->sendzc;
+
+	if (unlikely(req->ctx->flags & IORING_SETUP_IOPOLL))
+		return -EINVAL;
+	if (sqe->ioprio || sqe->off)
+		return -EINVAL;
+
+	zc->buf = u64_to_user_ptr(READ_ONCE(sqe->addr));
+	zc->len = READ_ONCE(sqe->len);
+	zc->msg_flags = READ_ONCE(sqe->msg_flags) & ~MSG_ZEROCOPY;
+	zc->notif = NULL;
+	req->buf_index = READ_ONCE(sqe->buf_index);
+	return 0;
+}
+
+static int io_sendzc(struct io_kiocb *req, bool force_nonblock)
+{
+	struct io_sendzc *zc = &req->sendzc;
+	struct io_kiocb *notif;
+	struct socket *sock;
+	struct msghdr msg;
+	unsigned flags;
+	int ret;
+
+	sock = sock_from_file(req->file, &ret);
+	if (unlikely(!sock))
+		goto done;
+
+	ret = __io_import_fixed(req->ctx, req->buf_index,
+				(u64) (unsigned long) zc->buf, zc->len, WRITE,
+				&msg.msg_iter);
+	if (unlikely(ret < 0))
+		goto done;
+
+	if (!zc->notif) {
+		zc->notif = io_alloc_notif(req);
+		if (unlikely(!zc->notif)) {
+			ret = -ENOMEM;
+			goto done;
+		}
+	}
+
+	msg.msg_name = NULL;
+	msg.msg_control = NULL;
+	msg.msg_controllen = 0;
+	msg.msg_namelen = 0;
+	msg.msg_iocb = NULL;
+	msg.msg_ubuf = NULL;
+
+	flags = zc->msg_flags;
+	if (flags & MSG_DONTWAIT)
+		req->flags |= REQ_F_NOWAIT;
+	else if (force_nonblock)
+		flags |= MSG_DONTWAIT;
+
+	/*
+	 * Only TCP attaches caller owned notifiers to its skbs, anything else
+	 * copies the data and the notification follows the send right away.
+	 */
+	if (sock->sk->sk_type == SOCK_STREAM &&
+	    sock->sk->sk_protocol == IPPROTO_TCP) {
+		msg.msg_ubuf = &zc->notif->notif.uarg;
+		flags |= MSG_ZEROCOPY;
+	}
+
+	msg.msg_flags = flags;
+	ret = sock_sendmsg(sock, &msg);
+	if (force_nonblock && ret == -EAGAIN) {
+		/* nothing references the notifier yet, keep it for the retry */
+		req->flags |= REQ_F_NEED_CLEANUP;
+		return -EAGAIN;
+	}
+	if (ret == -ERESTARTSYS)
+		ret = -EINTR;
+done:
+	if (ret < 0)
+		req_set_fail_links(req);
+	notif = zc->notif;
+	if (notif) {
+		zc->notif = NULL;
+		req->flags &= ~REQ_F_NEED_CLEANUP;
+		__io_cqring_add_event(req, ret, IORING_CQE_F_MORE);
+		/* the notification CQE follows when the skbs are gone */
+		sock_zerocopy_put(&notif->notif.uarg);
+	} else {
+		io_cqring_add_event(req, ret);
+	}
 	io_put_req(req);
 	return 0;
 }
@@ -3798,25 +4506,51 @@ static int io_recvmsg_copy_hdr(struct io_kiocb *req, struct io_async_ctx *io)
 	return __io_recvmsg_copy_hdr(req, io);
 }
 
-static struct io_buffer *io_recv_buffer_select(struct io_kiocb *req,
-					       int *cflags, bool needs_lock)
+static void __user *io_recv_buffer_select(struct io_kiocb *req,
+					  int *cflags, bool needs_lock)
 {
 	struct io_sr_msg *sr = &req->sr_msg;
 	struct io_buffer *kbuf;
+	void __user *buf;
 
 	if (!(req->flags & REQ_F_BUFFER_SELECT))
 		return NULL;
 
+	if (req->flags & REQ_F_BUFFER_RING)
+		goto ring;
+	if (!(req->flags & REQ_F_BUFFER_SELECTED)) {
+		buf = io_ring_buffer_select(req, &sr->len, sr->bgid,
+					    needs_lock);
+		if (IS_ERR(buf))
+			return buf;
+		if (buf) {
+			sr->ring_buf = buf;
+			goto ring;
+		}
+	}
+
 	kbuf = io_buffer_select(req, &sr->len, sr->bgid, sr->kbuf, needs_lock);
 	if (IS_ERR(kbuf))
-		return kbuf;
+		return ERR_CAST(kbuf);
 
 	sr->kbuf = kbuf;
 	req->flags |= REQ_F_BUFFER_SELECTED;
 
 	*cflags = kbuf->bid << IORING_CQE_BUFFER_SHIFT;
 	*cflags |= IORING_CQE_F_BUFFER;
-	return kbuf;
+	return u64_to_user_ptr(kbuf->addr);
+ring:
+	*cflags = req->buf_index << IORING_CQE_BUFFER_SHIFT;
+	*cflags |= IORING_CQE_F_BUFFER;
+	return sr->ring_buf;
+}
+
+/* ring mapped buffers belong to the application, there's nothing to free */
+static void io_recv_kbuf_free(struct io_kiocb *req)
+{
+	if ((req->flags & (REQ_F_BUFFER_SELECTED | REQ_F_BUFFER_RING)) ==
+	    REQ_F_BUFFER_SELECTED)
+		kfree(req->sr_msg.kbuf);
 }
 
 static int io_recvmsg_prep(struct io_kiocb *req,
@@ -3859,8 +4593,8 @@ static int io_recvmsg(struct io_kiocb *req, bool force_nonblock)
 
 	sock = sock_from_file(req->file, &ret);
 	if (sock) {
-		struct io_buffer *kbuf;
 		struct io_async_ctx io;
+		void __user *buf;
 		unsigned flags;
 
 		if (req->io) {
@@ -3879,11 +4613,11 @@ static int io_recvmsg(struct io_kiocb *req, bool force_nonblock)
 				return ret;
 		}
 
-		kbuf = io_recv_buffer_select(req, &cflags, !force_nonblock);
-		if (IS_ERR(kbuf)) {
-			return PTR_ERR(kbuf);
-		} else if (kbuf) {
-			kmsg->fast_iov[0].iov_base = u64_to_user_ptr(kbuf->addr);
+		buf = io_recv_buffer_select(req, &cflags, !force_nonblock);
+		if (IS_ERR(buf)) {
+			return PTR_ERR(buf);
+		} else if (buf) {
+			kmsg->fast_iov[0].iov_base = buf;
 			iov_iter_init(&kmsg->msg.msg_iter, READ, kmsg->iov,
 					1, req->sr_msg.len);
 		}
@@ -3899,28 +4633,25 @@ static int io_recvmsg(struct io_kiocb *req, bool force_nonblock)
 		if (force_nonblock && ret == -EAGAIN) {
 			ret = io_setup_async_msg(req, kmsg);
 			if (ret != -EAGAIN)
-				kfree(kbuf);
+				io_recv_kbuf_free(req);
 			return ret;
 		}
 		if (ret == -ERESTARTSYS)
 			ret = -EINTR;
-		if (kbuf)
-			kfree(kbuf);
+		io_recv_kbuf_free(req);
 	}
 
 	if (kmsg && kmsg->iov != kmsg->fast_iov)
 		kfree(kmsg->iov);
 	req->flags &= ~REQ_F_NEED_CLEANUP;
-	__io_cqring_add_event(req, ret, cflags);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_put_req(req);
+	__io_req_complete(req, ret, cflags);
 	return 0;
 }
 
 static int io_recv(struct io_kiocb *req, bool force_nonblock)
 {
-	struct io_buffer *kbuf = NULL;
 	struct socket *sock;
 	int ret, cflags = 0;
 
@@ -3928,20 +4659,21 @@ static int io_recv(struct io_kiocb *req, bool force_nonblock)
 	if (sock) {
 		struct io_sr_msg *sr = &req->sr_msg;
 		void __user *buf = sr->buf;
+		void __user *sel;
 		struct msghdr msg;
 		struct iovec iov;
 		unsigned flags;
 
-		kbuf = io_recv_buffer_select(req, &cflags, !force_nonblock);
-		if (IS_ERR(kbuf))
-			return PTR_ERR(kbuf);
-		else if (kbuf)
-			buf = u64_to_user_ptr(kbuf->addr);
+		sel = io_recv_buffer_select(req, &cflags, !force_nonblock);
+		if (IS_ERR(sel))
+			return PTR_ERR(sel);
+		else if (sel)
+			buf = sel;
 
 		ret = import_single_range(READ, buf, sr->len, &iov,
 						&msg.msg_iter);
 		if (ret) {
-			kfree(kbuf);
+			io_recv_kbuf_free(req);
 			return ret;
 		}
 
@@ -3966,12 +4698,11 @@ static int io_recv(struct io_kiocb *req, bool force_nonblock)
 			ret = -EINTR;
 	}
 
-	kfree(kbuf);
+	io_recv_kbuf_free(req);
 	req->flags &= ~REQ_F_NEED_CLEANUP;
-	__io_cqring_add_event(req, ret, cflags);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_put_req(req);
+	__io_req_complete(req, ret, cflags);
 	return 0;
 }
 
@@ -3979,15 +4710,37 @@ static int io_accept_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 {
 	struct io_accept *accept = &req->accept;
 
+	unsigned int ioprio;
+
 	if (unlikely(req->ctx->flags & (IORING_SETUP_IOPOLL|IORING_SETUP_SQPOLL)))
 		return -EINVAL;
-	if (sqe->ioprio || sqe->len || sqe->buf_index)
+	if (sqe->len || sqe->buf_index)
+		return -EINVAL;
+
+	ioprio = READ_ONCE(sqe->ioprio);
+	if (ioprio & ~IORING_ACCEPT_MULTISHOT)
+		return -EINVAL;
+	/* a request that keeps posting completions can't be part of a chain */
+	accept->multishot = ioprio & IORING_ACCEPT_MULTISHOT;
+	if (accept->multishot && (req->flags & (REQ_F_LINK | REQ_F_HARDLINK)))
 		return -EINVAL;
 
 	accept->addr = u64_to_user_ptr(READ_ONCE(sqe->addr));
 	accept->addr_len = u64_to_user_ptr(READ_ONCE(sqe->addr2));
 	accept->flags = READ_ONCE(sqe->accept_flags);
 	accept->nofile = rlimit(RLIMIT_NOFILE);
+
+	accept->file_slot = READ_ONCE(sqe->file_index);
+	if (accept->file_slot) {
+		/* every connection would land in the same slot */
+		if (accept->multishot)
+			return -EINVAL;
+		if (accept->flags & ~SOCK_NONBLOCK)
+			return -EINVAL;
+		if (SOCK_NONBLOCK != O_NONBLOCK &&
+		    (accept->flags & SOCK_NONBLOCK))
+			accept->flags = O_NONBLOCK;
+	}
 	return 0;
 }
 
@@ -3997,21 +4750,49 @@ static int io_accept(struct io_kiocb *req, bool force_nonblock)
 	unsigned int file_flags = force_nonblock ? O_NONBLOCK : 0;
 	int ret;
 
-	if (req->file->f_flags & O_NONBLOCK)
+	/* multishot waits for connections even on a nonblocking listener */
+	if ((req->file->f_flags & O_NONBLOCK) && !accept->multishot)
 		req->flags |= REQ_F_NOWAIT;
 
-	ret = __sys_accept4_file(req->file, file_flags, accept->addr,
-					accept->addr_len, accept->flags,
-					accept->nofile);
-	if (ret == -EAGAIN && force_nonblock)
+retry:
+	if (!accept->file_slot) {
+		ret = __sys_accept4_file(req->file, file_flags, accept->addr,
+						accept->addr_len, accept->flags,
+						accept->nofile);
+	} else {
+		struct file *file;
+
+		file = do_accept(req->file, file_flags, accept->addr,
+				 accept->addr_len, accept->flags);
+		if (IS_ERR(file))
+			ret = PTR_ERR(file);
+		else
+			ret = io_install_fixed_file(req, file, force_nonblock,
+						    accept->file_slot - 1);
+	}
+	if (ret == -EAGAIN && force_nonblock) {
+		/*
+		 * The poll handler is one-shot; allow a multishot accept
+		 * that already went through it to be armed again for the
+		 * next connection.
+		 */
+		if (accept->multishot)
+			req->flags &= ~REQ_F_POLLED;
 		return -EAGAIN;
+	}
+	/*
+	 * Multishot only stays armed on the nonblocking path. Once punted
+	 * to a worker, the accept completes as a normal one-shot request.
+	 */
+	if (ret >= 0 && accept->multishot && force_nonblock &&
+	    io_cqring_add_more(req, ret))
+		goto retry;
 	if (ret < 0) {
 		if (ret == -ERESTARTSYS)
 			ret = -EINTR;
 		req_set_fail_links(req);
 	}
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -4071,8 +4852,7 @@ static int io_connect(struct io_kiocb *req, bool force_nonblock)
 out:
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 #else /* !CONFIG_NET */
@@ -4091,6 +4871,16 @@ static int io_send(struct io_kiocb *req, bool force_nonblock)
 	return -EOPNOTSUPP;
 }
 
+static int io_sendzc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
+{
+	return -EOPNOTSUPP;
+}
+
+static int io_sendzc(struct io_kiocb *req, bool force_nonblock)
+{
+	return -EOPNOTSUPP;
+}
+
 static int io_recvmsg_prep(struct io_kiocb *req,
 			   const struct io_uring_sqe *sqe)
 {
@@ -4255,6 +5045,34 @@ static void io_poll_remove_double(struct io_kiocb *req)
 	}
 }
 
+/*
+ * The double entry of a multishot poll stays attached to the request when
+ * it fires; queue it again unless it wasn't the one that was woken.
+ */
+static void io_poll_rearm_double(struct io_kiocb *req)
+{
+	struct io_poll_iocb *poll = io_poll_get_double(req);
+
+	lockdep_assert_held(&req->ctx->completion_lock);
+
+	if (poll && poll->head) {
+		struct wait_queue_head *head = poll->head;
+
+		spin_lock(&head->lock);
+		if (list_empty(&poll->wait.entry))
+			__add_wait_queue(head, &poll->wait);
+		spin_unlock(&head->lock);
+	}
+}
+
+/* Put a multishot poll back on the waitqueue(s) after posting an event */
+static void io_poll_rearm(struct io_kiocb *req)
+{
+	req->result = 0;
+	add_wait_queue(req->poll.head, &req->poll.wait);
+	io_poll_rearm_double(req);
+}
+
 static void io_poll_complete(struct io_kiocb *req, __poll_t mask, int error)
 {
 	struct io_ring_ctx *ctx = req->ctx;
@@ -4270,7 +5088,18 @@ static void io_poll_task_handler(struct io_kiocb *req, struct io_kiocb **nxt)
 	struct io_ring_ctx *ctx = req->ctx;
 
 	if (io_poll_rewait(req, &req->poll)) {
+		if (req->poll.multishot)
+			io_poll_rearm_double(req);
+		spin_unlock_irq(&ctx->completion_lock);
+		return;
+	}
+
+	if (req->poll.multishot && !READ_ONCE(req->poll.canceled) &&
+	    io_cqring_fill_more(req, mangle_poll(req->result))) {
+		io_commit_cqring(ctx);
+		io_poll_rearm(req);
 		spin_unlock_irq(&ctx->completion_lock);
+		io_cqring_ev_posted(ctx);
 		return;
 	}
 
@@ -4305,6 +5134,7 @@ static int io_poll_double_wake(struct wait_queue_entry *wait, unsigned mode,
 	struct io_kiocb *req = wait->private;
 	struct io_poll_iocb *poll = io_poll_get_single(req);
 	__poll_t mask = key_to_poll(key);
+	bool multishot;
 
 	/* for instances that support it check for an event match first: */
 	if (mask && !(mask & poll->events))
@@ -4312,6 +5142,9 @@ static int io_poll_double_wake(struct wait_queue_entry *wait, unsigned mode,
 
 	list_del_init(&wait->entry);
 
+	/* multishot keeps the entry and its reference until completion */
+	multishot = req->opcode == IORING_OP_POLL_ADD && req->poll.multishot;
+
 	if (poll && poll->head) {
 		bool done;
 
@@ -4320,12 +5153,14 @@ static int io_poll_double_wake(struct wait_queue_entry *wait, unsigned mode,
 		if (!done)
 			list_del_init(&poll->wait.entry);
 		/* make sure double remove sees this as being gone */
-		wait->private = NULL;
+		if (!multishot)
+			wait->private = NULL;
 		spin_unlock(&poll->head->lock);
 		if (!done)
 			__io_async_wake(req, poll, mask, io_poll_task_func);
 	}
-	refcount_dec(&req->refs);
+	if (!multishot)
+		refcount_dec(&req->refs);
 	return 1;
 }
 
@@ -4382,7 +5217,7 @@ static void io_async_queue_proc(struct file *file, struct wait_queue_head *head,
 	__io_queue_proc(&apoll->poll, pt, head, &apoll->double_poll);
 }
 
-static void io_sq_thread_drop_mm(struct io_ring_ctx *ctx)
+static void io_sq_thread_drop_mm(void)
 {
 	struct mm_struct *mm = current->mm;
 
@@ -4700,10 +5535,9 @@ static int io_poll_remove(struct io_kiocb *req)
 	ret = io_poll_cancel(ctx, addr);
 	spin_unlock_irq(&ctx->completion_lock);
 
-	io_cqring_add_event(req, ret);
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -4727,15 +5561,24 @@ static void io_poll_queue_proc(struct file *file, struct wait_queue_head *head,
 static int io_poll_add_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 {
 	struct io_poll_iocb *poll = &req->poll;
+	u32 flags;
 	u16 events;
 
 	if (unlikely(req->ctx->flags & IORING_SETUP_IOPOLL))
 		return -EINVAL;
-	if (sqe->addr || sqe->ioprio || sqe->off || sqe->len || sqe->buf_index)
+	if (sqe->addr || sqe->ioprio || sqe->off || sqe->buf_index)
+		return -EINVAL;
+	flags = READ_ONCE(sqe->len);
+	if (flags & ~IORING_POLL_ADD_MULTI)
 		return -EINVAL;
 	if (!poll->file)
 		return -EBADF;
 
+	/* a request that keeps posting completions can't be part of a chain */
+	poll->multishot = flags & IORING_POLL_ADD_MULTI;
+	if (poll->multishot && (req->flags & (REQ_F_LINK | REQ_F_HARDLINK)))
+		return -EINVAL;
+
 	events = READ_ONCE(sqe->poll_events);
 	poll->events = demangle_poll(events) | EPOLLERR | EPOLLHUP;
 
@@ -4748,6 +5591,7 @@ static int io_poll_add(struct io_kiocb *req)
 	struct io_poll_iocb *poll = &req->poll;
 	struct io_ring_ctx *ctx = req->ctx;
 	struct io_poll_table ipt;
+	bool multi_posted = false;
 	__poll_t mask;
 
 	/* ->work is in union with hash_node and others */
@@ -4763,11 +5607,22 @@ static int io_poll_add(struct io_kiocb *req)
 
 	if (mask) { /* no async, we'd stolen it */
 		ipt.error = 0;
-		io_poll_complete(req, mask, 0);
+		if (poll->multishot && poll->head &&
+		    io_cqring_fill_more(req, mangle_poll(mask))) {
+			io_commit_cqring(ctx);
+			io_poll_req_insert(req);
+			io_poll_rearm(req);
+			multi_posted = true;
+			mask = 0;
+		} else {
+			io_poll_complete(req, mask, 0);
+		}
 	}
 	spin_unlock_irq(&ctx->completion_lock);
 
-	if (mask) {
+	if (multi_posted) {
+		io_cqring_ev_posted(ctx);
+	} else if (mask) {
 		io_cqring_ev_posted(ctx);
 		io_put_req(req);
 	}
@@ -5075,8 +5930,7 @@ static int io_files_update(struct io_kiocb *req, bool force_nonblock)
 
 	if (ret < 0)
 		req_set_fail_links(req);
-	io_cqring_add_event(req, ret);
-	io_put_req(req);
+	io_req_complete(req, ret);
 	return 0;
 }
 
@@ -5188,6 +6042,12 @@ static int io_req_defer_prep(struct io_kiocb *req,
 	case IORING_OP_TEE:
 		ret = io_tee_prep(req, sqe);
 		break;
+	case IORING_OP_SEND_ZC:
+		ret = io_sendzc_prep(req, sqe);
+		break;
+	case IORING_OP_URING_CMD:
+		ret = io_uring_cmd_prep(req, sqe);
+		break;
 	default:
 		printk_once(KERN_WARNING "io_uring: unhandled opcode %d\n",
 				req->opcode);
@@ -5235,7 +6095,8 @@ static void io_cleanup_req(struct io_kiocb *req)
 	case IORING_OP_READV:
 	case IORING_OP_READ_FIXED:
 	case IORING_OP_READ:
-		if (req->flags & REQ_F_BUFFER_SELECTED)
+		if ((req->flags & (REQ_F_BUFFER_SELECTED | REQ_F_BUFFER_RING)) ==
+		    REQ_F_BUFFER_SELECTED)
 			kfree((void *)(unsigned long)req->rw.addr);
 		/* fallthrough */
 	case IORING_OP_WRITEV:
@@ -5245,16 +6106,14 @@ static void io_cleanup_req(struct io_kiocb *req)
 			kfree(io->rw.iov);
 		break;
 	case IORING_OP_RECVMSG:
-		if (req->flags & REQ_F_BUFFER_SELECTED)
-			kfree(req->sr_msg.kbuf);
+		io_recv_kbuf_free(req);
 		/* fallthrough */
 	case IORING_OP_SENDMSG:
 		if (io->msg.iov != io->msg.fast_iov)
 			kfree(io->msg.iov);
 		break;
 	case IORING_OP_RECV:
-		if (req->flags & REQ_F_BUFFER_SELECTED)
-			kfree(req->sr_msg.kbuf);
+		io_recv_kbuf_free(req);
 		break;
 	case IORING_OP_OPENAT:
 	case IORING_OP_OPENAT2:
@@ -5266,6 +6125,11 @@ static void io_cleanup_req(struct io_kiocb *req)
 		io_put_file(req, req->splice.file_in,
 			    (req->splice.flags & SPLICE_F_FD_IN_FIXED));
 		break;
+	case IORING_OP_SEND_ZC:
+		/* never made it to the socket, free it without a CQE */
+		if (req->sendzc.notif)
+			io_put_req(req->sendzc.notif);
+		break;
 	}
 
 	req->flags &= ~REQ_F_NEED_CLEANUP;
@@ -5499,7 +6363,23 @@ static int io_issue_sqe(struct io_kiocb *req, const struct io_uring_sqe *sqe,
 			if (ret < 0)
 				break;
 		}
-		ret = io_tee(req, force_nonblock);
+		ret = io_tee(req, force_nonblock);
+		break;
+	case IORING_OP_SEND_ZC:
+		if (sqe) {
+			ret = io_sendzc_prep(req, sqe);
+			if (ret < 0)
+				break;
+		}
+		ret = io_sendzc(req, force_nonblock);
+		break;
+	case IORING_OP_URING_CMD:
+		if (sqe) {
+			ret = io_uring_cmd_prep(req, sqe);
+			if (ret < 0)
+				break;
+		}
+		ret = io_uring_cmd(req, force_nonblock);
 		break;
 	default:
 		ret = -EINVAL;
@@ -5941,7 +6821,7 @@ static void io_submit_state_end(struct io_submit_state *state)
 static void io_submit_state_start(struct io_submit_state *state,
 				  unsigned int max_ios)
 {
-	blk_start_plug(&state->plug);
+	blk_start_plug_nr_ios(&state->plug, max_ios);
 	state->free_reqs = 0;
 	state->file = NULL;
 	state->ios_left = max_ios;
@@ -6083,6 +6963,8 @@ static int io_submit_sqes(struct io_ring_ctx *ctx, unsigned int nr,
 
 	ctx->ring_fd = ring_fd;
 	ctx->ring_file = ring_file;
+	/* we hold the uring_lock, inline completions can be batched */
+	WRITE_ONCE(ctx->submit_comp.task, current);
 
 	for (i = 0; i < nr; i++) {
 		const struct io_uring_sqe *sqe;
@@ -6127,6 +7009,8 @@ static int io_submit_sqes(struct io_ring_ctx *ctx, unsigned int nr,
 	}
 	if (link)
 		io_queue_link_head(link);
+	io_submit_flush_completions(ctx);
+	WRITE_ONCE(ctx->submit_comp.task, NULL);
 	if (statep)
 		io_submit_state_end(&state);
 
@@ -6136,125 +7020,200 @@ static int io_submit_sqes(struct io_ring_ctx *ctx, unsigned int nr,
 	return submitted;
 }
 
-static int io_sq_thread(void *data)
+enum {
+	SQT_IDLE	= 0,
+	SQT_SPIN	= 1,	/* polled IO still in flight */
+	SQT_DID_WORK	= 2,	/* submitted something */
+};
+
+/*
+ * If we're handling multiple rings, cap submit size for fairness
+ */
+#define IORING_SQPOLL_CAP_ENTRIES	8
+
+static void io_ring_set_wakeup_flag(struct io_ring_ctx *ctx)
 {
-	struct io_ring_ctx *ctx = data;
-	const struct cred *old_cred;
-	DEFINE_WAIT(wait);
-	unsigned long timeout;
-	int ret = 0;
+	spin_lock_irq(&ctx->completion_lock);
+	ctx->rings->sq_flags |= IORING_SQ_NEED_WAKEUP;
+	spin_unlock_irq(&ctx->completion_lock);
+}
 
-	complete(&ctx->sq_thread_comp);
+static void io_ring_clear_wakeup_flag(struct io_ring_ctx *ctx)
+{
+	spin_lock_irq(&ctx->completion_lock);
+	ctx->rings->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
+	spin_unlock_irq(&ctx->completion_lock);
+}
 
-	old_cred = override_creds(ctx->creds);
+/*
+ * Would the SQ thread get anywhere with this ring right now? Submission
+ * fails with -EBUSY until the application reaps the CQ overflow, so such
+ * a ring has to wait for a wakeup from io_uring_enter().
+ */
+static bool io_sq_thread_has_work(struct io_ring_ctx *ctx)
+{
+	if (percpu_ref_is_dying(&ctx->refs))
+		return false;
+	if ((ctx->flags & IORING_SETUP_IOPOLL) &&
+	    !list_empty_careful(&ctx->poll_list))
+		return true;
+	if (!io_sqring_entries(ctx))
+		return false;
+	return !test_bit(0, &ctx->sq_check_overflow) ||
+		list_empty_careful(&ctx->cq_overflow_list);
+}
 
-	timeout = jiffies + ctx->sq_thread_idle;
-	while (!kthread_should_park()) {
-		unsigned int to_submit;
+static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
+{
+	unsigned int to_submit;
+	int ret = SQT_IDLE;
 
-		if (!list_empty(&ctx->poll_list)) {
-			unsigned nr_events = 0;
+	if (!list_empty(&ctx->poll_list)) {
+		unsigned nr_events = 0;
 
-			mutex_lock(&ctx->uring_lock);
-			if (!list_empty(&ctx->poll_list))
-				io_iopoll_getevents(ctx, &nr_events, 0);
-			else
-				timeout = jiffies + ctx->sq_thread_idle;
-			mutex_unlock(&ctx->uring_lock);
-		}
+		mutex_lock(&ctx->uring_lock);
+		if (!list_empty(&ctx->poll_list))
+			io_iopoll_getevents(ctx, &nr_events, 0);
+		if (!list_empty(&ctx->poll_list))
+			ret = SQT_SPIN;
+		mutex_unlock(&ctx->uring_lock);
+		if (nr_events)
+			ret |= SQT_DID_WORK;
+	}
+
+	to_submit = io_sqring_entries(ctx);
+	if (!to_submit)
+		return ret;
+
+	if (cap_entries && to_submit > IORING_SQPOLL_CAP_ENTRIES)
+		to_submit = IORING_SQPOLL_CAP_ENTRIES;
+
+	mutex_lock(&ctx->uring_lock);
+	if (likely(!percpu_ref_is_dying(&ctx->refs)) &&
+	    io_submit_sqes(ctx, to_submit, NULL, -1) > 0)
+		ret |= SQT_DID_WORK;
+	mutex_unlock(&ctx->uring_lock);
+
+	return ret;
+}
+
+static void io_sqd_init_new(struct io_sq_data *sqd)
+{
+	struct io_ring_ctx *ctx;
+
+	while (!list_empty(&sqd->ctx_new_list)) {
+		ctx = list_first_entry(&sqd->ctx_new_list, struct io_ring_ctx,
+				       sqd_list);
+		list_move_tail(&ctx->sqd_list, &sqd->ctx_list);
+		complete(&ctx->sq_thread_comp);
+	}
+}
+
+static int io_sq_thread(void *data)
+{
+	struct io_sq_data *sqd = data;
+	struct io_ring_ctx *ctx;
+	const struct cred *old_cred = NULL;
+	DEFINE_WAIT(wait);
+	unsigned long timeout = 0;
 
-		to_submit = io_sqring_entries(ctx);
+	while (!kthread_should_stop()) {
+		bool cap_entries, needs_sched;
+		int ret = SQT_IDLE;
 
 		/*
-		 * If submit got -EBUSY, flag us as needing the application
-		 * to enter the kernel to reap and flush events.
+		 * Any changes to the sqd lists are synchronized through the
+		 * kthread parking. This synchronizes the thread vs users,
+		 * the users are synchronized on the sqd->lock.
 		 */
-		if (!to_submit || ret == -EBUSY || need_resched()) {
-			/*
-			 * Drop cur_mm before scheduling, we can't hold it for
-			 * long periods (or over schedule()). Do this before
-			 * adding ourselves to the waitqueue, as the unuse/drop
-			 * may sleep.
-			 */
-			io_sq_thread_drop_mm(ctx);
+		if (kthread_should_park()) {
+			kthread_parkme();
+			continue;
+		}
 
-			/*
-			 * We're polling. If we're within the defined idle
-			 * period, then let us spin without work before going
-			 * to sleep. The exception is if we got EBUSY doing
-			 * more IO, we should wait for the application to
-			 * reap events and wake us up.
-			 */
-			if (!list_empty(&ctx->poll_list) || need_resched() ||
-			    (!time_after(jiffies, timeout) && ret != -EBUSY &&
-			    !percpu_ref_is_dying(&ctx->refs))) {
-				io_run_task_work();
-				cond_resched();
-				continue;
-			}
+		if (unlikely(!list_empty(&sqd->ctx_new_list))) {
+			io_sqd_init_new(sqd);
+			timeout = jiffies + sqd->sq_thread_idle;
+		}
 
-			prepare_to_wait(&ctx->sqo_wait, &wait,
-						TASK_INTERRUPTIBLE);
+		cap_entries = !list_is_singular(&sqd->ctx_list);
 
-			/*
-			 * While doing polled IO, before going to sleep, we need
-			 * to check if there are new reqs added to poll_list, it
-			 * is because reqs may have been punted to io worker and
-			 * will be added to poll_list later, hence check the
-			 * poll_list again.
-			 */
-			if ((ctx->flags & IORING_SETUP_IOPOLL) &&
-			    !list_empty_careful(&ctx->poll_list)) {
-				finish_wait(&ctx->sqo_wait, &wait);
-				continue;
+		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list) {
+			if (current->cred != ctx->creds) {
+				if (old_cred)
+					revert_creds(old_cred);
+				old_cred = override_creds(ctx->creds);
 			}
 
-			/* Tell userspace we may need a wakeup call */
-			spin_lock_irq(&ctx->completion_lock);
-			ctx->rings->sq_flags |= IORING_SQ_NEED_WAKEUP;
-			spin_unlock_irq(&ctx->completion_lock);
+			ret |= __io_sq_thread(ctx, cap_entries);
 
-			to_submit = io_sqring_entries(ctx);
-			if (!to_submit || ret == -EBUSY) {
-				if (kthread_should_park()) {
-					finish_wait(&ctx->sqo_wait, &wait);
-					break;
-				}
-				if (io_run_task_work()) {
-					finish_wait(&ctx->sqo_wait, &wait);
-					continue;
-				}
-				if (signal_pending(current))
-					flush_signals(current);
-				schedule();
-				finish_wait(&ctx->sqo_wait, &wait);
-
-				spin_lock_irq(&ctx->completion_lock);
-				ctx->rings->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
-				spin_unlock_irq(&ctx->completion_lock);
-				ret = 0;
+			/* the next ring may well belong to another mm */
+			if (cap_entries)
+				io_sq_thread_drop_mm();
+		}
+
+		if (ret & SQT_DID_WORK) {
+			timeout = jiffies + sqd->sq_thread_idle;
+			if (!need_resched())
 				continue;
+		}
+
+		/*
+		 * Drop cur_mm before scheduling, we can't hold it for
+		 * long periods (or over schedule()). Do this before
+		 * adding ourselves to the waitqueue, as the unuse/drop
+		 * may sleep.
+		 */
+		io_sq_thread_drop_mm();
+
+		/*
+		 * We're polling. If we're within the defined idle period,
+		 * then let us spin without work before going to sleep.
+		 */
+		if ((ret & SQT_SPIN) || need_resched() ||
+		    !time_after(jiffies, timeout)) {
+			io_run_task_work();
+			cond_resched();
+			continue;
+		}
+
+		prepare_to_wait(&sqd->wait, &wait, TASK_INTERRUPTIBLE);
+
+		/* Tell userspace we may need a wakeup call */
+		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list)
+			io_ring_set_wakeup_flag(ctx);
+
+		/*
+		 * Check again after setting the wakeup flags, and also
+		 * for polled requests that were punted to an io worker
+		 * and got added to the poll_list after we looked.
+		 */
+		needs_sched = true;
+		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list) {
+			if (io_sq_thread_has_work(ctx)) {
+				needs_sched = false;
+				break;
 			}
-			finish_wait(&ctx->sqo_wait, &wait);
+		}
 
-			spin_lock_irq(&ctx->completion_lock);
-			ctx->rings->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
-			spin_unlock_irq(&ctx->completion_lock);
+		if (needs_sched && !kthread_should_park() &&
+		    !kthread_should_stop() && !io_run_task_work()) {
+			if (signal_pending(current))
+				flush_signals(current);
+			schedule();
 		}
+		finish_wait(&sqd->wait, &wait);
 
-		mutex_lock(&ctx->uring_lock);
-		if (likely(!percpu_ref_is_dying(&ctx->refs)))
-			ret = io_submit_sqes(ctx, to_submit, NULL, -1);
-		mutex_unlock(&ctx->uring_lock);
-		timeout = jiffies + ctx->sq_thread_idle;
+		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list)
+			io_ring_clear_wakeup_flag(ctx);
+		timeout = jiffies + sqd->sq_thread_idle;
 	}
 
 	io_run_task_work();
 
-	io_sq_thread_drop_mm(ctx);
-	revert_creds(old_cred);
-
-	kthread_parkme();
+	io_sq_thread_drop_mm();
+	if (old_cred)
+		revert_creds(old_cred);
 
 	return 0;
 }
@@ -6427,21 +7386,60 @@ static int io_sqe_files_unregister(struct io_ring_ctx *ctx)
 	return 0;
 }
 
-static void io_sq_thread_stop(struct io_ring_ctx *ctx)
+static void io_sq_thread_park(struct io_sq_data *sqd)
+	__acquires(&sqd->lock)
 {
-	if (ctx->sqo_thread) {
-		wait_for_completion(&ctx->sq_thread_comp);
+	mutex_lock(&sqd->lock);
+	if (sqd->thread)
+		kthread_park(sqd->thread);
+}
+
+static void io_sq_thread_unpark(struct io_sq_data *sqd)
+	__releases(&sqd->lock)
+{
+	if (sqd->thread)
+		kthread_unpark(sqd->thread);
+	mutex_unlock(&sqd->lock);
+}
+
+static void io_put_sq_data(struct io_sq_data *sqd)
+{
+	if (refcount_dec_and_test(&sqd->refs)) {
 		/*
 		 * The park is a bit of a work-around, without it we get
 		 * warning spews on shutdown with SQPOLL set and affinity
 		 * set to a single CPU.
 		 */
-		kthread_park(ctx->sqo_thread);
-		kthread_stop(ctx->sqo_thread);
-		ctx->sqo_thread = NULL;
+		if (sqd->thread) {
+			kthread_park(sqd->thread);
+			kthread_stop(sqd->thread);
+		}
+
+		kfree(sqd);
 	}
 }
 
+static void io_sq_thread_stop(struct io_ring_ctx *ctx)
+{
+	struct io_sq_data *sqd = ctx->sq_data;
+
+	if (!sqd)
+		return;
+
+	/* make sure the thread has picked us up before taking us off */
+	if (sqd->thread)
+		wait_for_completion(&ctx->sq_thread_comp);
+
+	io_sq_thread_park(sqd);
+	mutex_lock(&sqd->ctx_lock);
+	list_del_init(&ctx->sqd_list);
+	mutex_unlock(&sqd->ctx_lock);
+	io_sq_thread_unpark(sqd);
+
+	io_put_sq_data(sqd);
+	ctx->sq_data = NULL;
+}
+
 static void io_finish_async(struct io_ring_ctx *ctx)
 {
 	io_sq_thread_stop(ctx);
@@ -6913,6 +7911,17 @@ static int io_queue_file_removal(struct fixed_file_data *data,
 	return 0;
 }
 
+static void io_sqe_files_switch_node(struct fixed_file_data *data,
+				     struct fixed_file_ref_node *ref_node)
+{
+	percpu_ref_kill(data->cur_refs);
+	spin_lock(&data->lock);
+	list_add(&ref_node->node, &data->ref_list);
+	data->cur_refs = &ref_node->refs;
+	spin_unlock(&data->lock);
+	percpu_ref_get(&data->refs);
+}
+
 static int __io_sqe_files_update(struct io_ring_ctx *ctx,
 				 struct io_uring_files_update *up,
 				 unsigned nr_args)
@@ -6988,19 +7997,77 @@ static int __io_sqe_files_update(struct io_ring_ctx *ctx,
 		up->offset++;
 	}
 
-	if (needs_switch) {
-		percpu_ref_kill(data->cur_refs);
-		spin_lock(&data->lock);
-		list_add(&ref_node->node, &data->ref_list);
-		data->cur_refs = &ref_node->refs;
-		spin_unlock(&data->lock);
-		percpu_ref_get(&ctx->file_data->refs);
-	} else
+	if (needs_switch)
+		io_sqe_files_switch_node(data, ref_node);
+	else
 		destroy_fixed_file_ref_node(ref_node);
 
 	return done ? done : err;
 }
 
+/*
+ * Install a file opened or accepted by a request directly into a fixed file
+ * slot, replacing whatever was there. The file reference is consumed, also
+ * on error.
+ */
+static int io_install_fixed_file(struct io_kiocb *req, struct file *file,
+				 bool force_nonblock, u32 slot_index)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct fixed_file_data *data = ctx->file_data;
+	struct fixed_file_ref_node *ref_node;
+	struct fixed_file_table *table;
+	bool needs_switch = false;
+	unsigned index;
+	int ret;
+
+	io_ring_submit_lock(ctx, !force_nonblock);
+
+	ret = -EBADF;
+	if (file->f_op == &io_uring_fops)
+		goto err;
+	ret = -ENXIO;
+	if (!data)
+		goto err;
+	ret = -EINVAL;
+	if (slot_index >= ctx->nr_user_files)
+		goto err;
+
+	ref_node = alloc_fixed_file_ref_node(ctx);
+	if (IS_ERR(ref_node)) {
+		ret = PTR_ERR(ref_node);
+		goto err;
+	}
+
+	slot_index = array_index_nospec(slot_index, ctx->nr_user_files);
+	table = &data->table[slot_index >> IORING_FILE_TABLE_SHIFT];
+	index = slot_index & IORING_FILE_TABLE_MASK;
+	if (table->files[index]) {
+		ret = io_queue_file_removal(data, table->files[index]);
+		if (ret) {
+			destroy_fixed_file_ref_node(ref_node);
+			goto err;
+		}
+		table->files[index] = NULL;
+		needs_switch = true;
+	}
+
+	table->files[index] = file;
+	ret = io_sqe_file_register(ctx, file, slot_index);
+	if (ret)
+		table->files[index] = NULL;
+
+	if (needs_switch)
+		io_sqe_files_switch_node(data, ref_node);
+	else
+		destroy_fixed_file_ref_node(ref_node);
+err:
+	io_ring_submit_unlock(ctx, !force_nonblock);
+	if (ret)
+		fput(file);
+	return ret;
+}
+
 static int io_sqe_files_update(struct io_ring_ctx *ctx, void __user *arg,
 			       unsigned nr_args)
 {
@@ -7073,9 +8140,52 @@ static int io_init_wq_offload(struct io_ring_ctx *ctx,
 	return ret;
 }
 
+/*
+ * With IORING_SETUP_ATTACH_WQ, share the SQ thread of the ring we attach
+ * to, if it has one. Otherwise, set up a new one.
+ */
+static struct io_sq_data *io_get_sq_data(struct io_uring_params *p)
+{
+	struct io_ring_ctx *ctx_attach;
+	struct io_sq_data *sqd;
+	struct fd f;
+
+	if (p->flags & IORING_SETUP_ATTACH_WQ) {
+		f = fdget(p->wq_fd);
+		if (!f.file)
+			return ERR_PTR(-EBADF);
+		if (f.file->f_op != &io_uring_fops) {
+			fdput(f);
+			return ERR_PTR(-EINVAL);
+		}
+
+		ctx_attach = f.file->private_data;
+		/* @sq_data is protected by holding the fd */
+		sqd = ctx_attach->sq_data;
+		if (sqd)
+			refcount_inc(&sqd->refs);
+		fdput(f);
+		if (sqd)
+			return sqd;
+	}
+
+	sqd = kzalloc(sizeof(*sqd), GFP_KERNEL);
+	if (!sqd)
+		return ERR_PTR(-ENOMEM);
+
+	refcount_set(&sqd->refs, 1);
+	INIT_LIST_HEAD(&sqd->ctx_list);
+	INIT_LIST_HEAD(&sqd->ctx_new_list);
+	mutex_init(&sqd->ctx_lock);
+	mutex_init(&sqd->lock);
+	init_waitqueue_head(&sqd->wait);
+	return sqd;
+}
+
 static int io_sq_offload_start(struct io_ring_ctx *ctx,
 			       struct io_uring_params *p)
 {
+	struct io_sq_data *sqd;
 	int ret;
 
 	mmgrab(current->mm);
@@ -7098,26 +8208,48 @@ static int io_sq_offload_start(struct io_ring_ctx *ctx,
 				goto err;
 			if (!cpu_online(cpu))
 				goto err;
+		}
+
+		sqd = io_get_sq_data(p);
+		if (IS_ERR(sqd)) {
+			ret = PTR_ERR(sqd);
+			goto err;
+		}
+
+		ctx->sq_data = sqd;
+		io_sq_thread_park(sqd);
+		mutex_lock(&sqd->ctx_lock);
+		list_add(&ctx->sqd_list, &sqd->ctx_new_list);
+		mutex_unlock(&sqd->ctx_lock);
+		sqd->sq_thread_idle = max(sqd->sq_thread_idle,
+					  ctx->sq_thread_idle);
+		io_sq_thread_unpark(sqd);
+
+		/* attached to an existing thread, it picks us up on unpark */
+		if (sqd->thread)
+			goto done;
 
-			ctx->sqo_thread = kthread_create_on_cpu(io_sq_thread,
-							ctx, cpu,
+		if (p->flags & IORING_SETUP_SQ_AFF) {
+			sqd->thread = kthread_create_on_cpu(io_sq_thread, sqd,
+							p->sq_thread_cpu,
 							"io_uring-sq");
 		} else {
-			ctx->sqo_thread = kthread_create(io_sq_thread, ctx,
+			sqd->thread = kthread_create(io_sq_thread, sqd,
 							"io_uring-sq");
 		}
-		if (IS_ERR(ctx->sqo_thread)) {
-			ret = PTR_ERR(ctx->sqo_thread);
-			ctx->sqo_thread = NULL;
+		if (IS_ERR(sqd->thread)) {
+			ret = PTR_ERR(sqd->thread);
+			sqd->thread = NULL;
 			goto err;
 		}
-		wake_up_process(ctx->sqo_thread);
+		wake_up_process(sqd->thread);
 	} else if (p->flags & IORING_SETUP_SQ_AFF) {
 		/* Can't have SQ_AFF without SQPOLL */
 		ret = -EINVAL;
 		goto err;
 	}
 
+done:
 	ret = io_init_wq_offload(ctx, p);
 	if (ret)
 		goto err;
@@ -7447,10 +8579,125 @@ static int __io_destroy_buffers(int id, void *p, void *data)
 	return 0;
 }
 
+static void io_free_buf_ring(struct io_ring_ctx *ctx,
+			     struct io_buffer_list *bl)
+{
+	vunmap(bl->buf_ring);
+	unpin_user_pages(bl->pages, bl->nr_pages);
+	if (ctx->account_mem)
+		io_unaccount_mem(ctx->user, bl->nr_pages);
+	kvfree(bl->pages);
+	kfree(bl);
+}
+
+static int __io_destroy_buf_ring(int id, void *p, void *data)
+{
+	io_free_buf_ring(data, p);
+	return 0;
+}
+
 static void io_destroy_buffers(struct io_ring_ctx *ctx)
 {
 	idr_for_each(&ctx->io_buffer_idr, __io_destroy_buffers, ctx);
 	idr_destroy(&ctx->io_buffer_idr);
+	idr_for_each(&ctx->io_buf_ring_idr, __io_destroy_buf_ring, ctx);
+	idr_destroy(&ctx->io_buf_ring_idr);
+}
+
+static int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
+{
+	struct io_uring_buf_reg reg;
+	struct io_buffer_list *bl;
+	unsigned long ring_size;
+	int nr_pages, pret, ret;
+
+	lockdep_assert_held(&ctx->uring_lock);
+
+	if (copy_from_user(&reg, arg, sizeof(reg)))
+		return -EFAULT;
+	if (reg.pad || reg.resv[0] || reg.resv[1] || reg.resv[2])
+		return -EINVAL;
+	if (!reg.ring_addr || !PAGE_ALIGNED(reg.ring_addr))
+		return -EINVAL;
+	/* the head and tail are 16 bits, so that's the ring limit */
+	if (!is_power_of_2(reg.ring_entries) || reg.ring_entries > 32768)
+		return -EINVAL;
+	if (idr_find(&ctx->io_buffer_idr, reg.bgid) ||
+	    idr_find(&ctx->io_buf_ring_idr, reg.bgid))
+		return -EEXIST;
+
+	bl = kzalloc(sizeof(*bl), GFP_KERNEL);
+	if (!bl)
+		return -ENOMEM;
+
+	ring_size = reg.ring_entries * sizeof(struct io_uring_buf);
+	nr_pages = PAGE_ALIGN(ring_size) >> PAGE_SHIFT;
+	if (ctx->account_mem) {
+		ret = io_account_mem(ctx->user, nr_pages);
+		if (ret)
+			goto err_free;
+	}
+
+	ret = -ENOMEM;
+	bl->pages = kvmalloc_array(nr_pages, sizeof(struct page *),
+					GFP_KERNEL);
+	if (!bl->pages)
+		goto err_unaccount;
+
+	pret = pin_user_pages_fast(reg.ring_addr, nr_pages,
+				   FOLL_WRITE | FOLL_LONGTERM, bl->pages);
+	if (pret != nr_pages) {
+		ret = pret < 0 ? pret : -EFAULT;
+		if (pret > 0)
+			unpin_user_pages(bl->pages, pret);
+		goto err_pages;
+	}
+	bl->nr_pages = nr_pages;
+
+	bl->buf_ring = vmap(bl->pages, nr_pages, VM_MAP, PAGE_KERNEL);
+	if (!bl->buf_ring) {
+		ret = -ENOMEM;
+		goto err_unpin;
+	}
+	bl->mask = reg.ring_entries - 1;
+
+	ret = idr_alloc(&ctx->io_buf_ring_idr, bl, reg.bgid, reg.bgid + 1,
+			GFP_KERNEL);
+	if (ret < 0) {
+		io_free_buf_ring(ctx, bl);
+		return ret;
+	}
+	return 0;
+err_unpin:
+	unpin_user_pages(bl->pages, nr_pages);
+err_pages:
+	kvfree(bl->pages);
+err_unaccount:
+	if (ctx->account_mem)
+		io_unaccount_mem(ctx->user, nr_pages);
+err_free:
+	kfree(bl);
+	return ret;
+}
+
+static int io_unregister_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
+{
+	struct io_uring_buf_reg reg;
+	struct io_buffer_list *bl;
+
+	lockdep_assert_held(&ctx->uring_lock);
+
+	if (copy_from_user(&reg, arg, sizeof(reg)))
+		return -EFAULT;
+	if (reg.pad || reg.resv[0] || reg.resv[1] || reg.resv[2])
+		return -EINVAL;
+
+	bl = idr_remove(&ctx->io_buf_ring_idr, reg.bgid);
+	if (!bl)
+		return -ENOENT;
+
+	io_free_buf_ring(ctx, bl);
+	return 0;
 }
 
 static void io_ring_ctx_free(struct io_ring_ctx *ctx)
@@ -7926,7 +9173,7 @@ SYSCALL_DEFINE6(io_uring_enter, unsigned int, fd, u32, to_submit,
 		if (!list_empty_careful(&ctx->cq_overflow_list))
 			io_cqring_overflow_flush(ctx, false);
 		if (flags & IORING_ENTER_SQ_WAKEUP)
-			wake_up(&ctx->sqo_wait);
+			wake_up(&ctx->sq_data->wait);
 		submitted = to_submit;
 	} else if (to_submit) {
 		mutex_lock(&ctx->uring_lock);
@@ -8372,6 +9619,26 @@ static int io_unregister_personality(struct io_ring_ctx *ctx, unsigned id)
 	return -EINVAL;
 }
 
+static int io_register_iowq_max_workers(struct io_ring_ctx *ctx,
+					void __user *arg)
+{
+	int new_count[2];
+	int ret;
+
+	if (!ctx->io_wq)
+		return -EINVAL;
+	if (copy_from_user(new_count, arg, sizeof(new_count)))
+		return -EFAULT;
+
+	ret = io_wq_max_workers(ctx->io_wq, new_count);
+	if (ret)
+		return ret;
+
+	if (copy_to_user(arg, new_count, sizeof(new_count)))
+		return -EFAULT;
+	return 0;
+}
+
 static bool io_register_op_must_quiesce(int op)
 {
 	switch (op) {
@@ -8380,6 +9647,9 @@ static bool io_register_op_must_quiesce(int op)
 	case IORING_REGISTER_PROBE:
 	case IORING_REGISTER_PERSONALITY:
 	case IORING_UNREGISTER_PERSONALITY:
+	case IORING_REGISTER_PBUF_RING:
+	case IORING_UNREGISTER_PBUF_RING:
+	case IORING_REGISTER_IOWQ_MAX_WORKERS:
 		return false;
 	default:
 		return true;
@@ -8481,6 +9751,24 @@ static int __io_uring_register(struct io_ring_ctx *ctx, unsigned opcode,
 			break;
 		ret = io_unregister_personality(ctx, nr_args);
 		break;
+	case IORING_REGISTER_PBUF_RING:
+		ret = -EINVAL;
+		if (!arg || nr_args != 1)
+			break;
+		ret = io_register_pbuf_ring(ctx, arg);
+		break;
+	case IORING_UNREGISTER_PBUF_RING:
+		ret = -EINVAL;
+		if (!arg || nr_args != 1)
+			break;
+		ret = io_unregister_pbuf_ring(ctx, arg);
+		break;
+	case IORING_REGISTER_IOWQ_MAX_WORKERS:
+		ret = -EINVAL;
+		if (!arg || nr_args != 2)
+			break;
+		ret = io_register_iowq_max_workers(ctx, arg);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -8559,6 +9847,9 @@ static int __init io_uring_init(void)
 	BUILD_BUG_SQE_ELEM(40, __u16,  buf_index);
 	BUILD_BUG_SQE_ELEM(42, __u16,  personality);
 	BUILD_BUG_SQE_ELEM(44, __s32,  splice_fd_in);
+	BUILD_BUG_SQE_ELEM(44, __u32,  file_index);
+	BUILD_BUG_SQE_ELEM(8,  __u32,  cmd_op);
+	BUILD_BUG_SQE_ELEM(28, __u32,  uring_cmd_flags);
 
 	BUILD_BUG_ON(ARRAY_SIZE(io_op_defs) != IORING_OP_LAST);
 	BUILD_BUG_ON(__REQ_F_LAST_BIT >= 8 * sizeof(int));
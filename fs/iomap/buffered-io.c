@@ -433,6 +433,142 @@ void iomap_readahead(struct readahead_control *rac, const struct iomap_ops *ops)
 }
 EXPORT_SYMBOL_GPL(iomap_readahead);
 
+/*
+ * A THP is read without an iomap_page: it is only ever read as a whole, and
+ * the pages that readahead allocates this way are never written to.
+ */
+struct iomap_thp_read {
+	struct page		*page;
+	struct bio		*bio;
+	atomic_t		pending;
+	bool			error;
+};
+
+static void
+iomap_thp_read_done(struct iomap_thp_read *r)
+{
+	struct page *page = r->page;
+
+	if (!atomic_dec_and_test(&r->pending))
+		return;
+
+	if (READ_ONCE(r->error))
+		SetPageError(page);
+	else
+		SetPageUptodate(page);
+	unlock_page(page);
+	kfree(r);
+}
+
+static void
+iomap_thp_read_end_io(struct bio *bio)
+{
+	struct iomap_thp_read *r = bio->bi_private;
+
+	if (bio->bi_status)
+		WRITE_ONCE(r->error, true);
+	bio_put(bio);
+	iomap_thp_read_done(r);
+}
+
+static void
+iomap_zero_thp_range(struct page *page, size_t off, size_t len)
+{
+	while (len) {
+		size_t n = min_t(size_t, len, PAGE_SIZE - offset_in_page(off));
+
+		zero_user(page + (off >> PAGE_SHIFT), offset_in_page(off), n);
+		off += n;
+		len -= n;
+	}
+}
+
+static loff_t
+iomap_readpage_thp_actor(struct inode *inode, loff_t pos, loff_t length,
+		void *data, struct iomap *iomap, struct iomap *srcmap)
+{
+	struct iomap_thp_read *r = data;
+	struct page *page = r->page;
+	size_t poff = pos - page_offset(page);
+	sector_t sector;
+
+	if (iomap->type == IOMAP_INLINE)
+		return -EIO;
+
+	if (iomap_block_needs_zeroing(inode, iomap, pos)) {
+		iomap_zero_thp_range(page, poff, length);
+		return length;
+	}
+
+	sector = iomap_sector(iomap, pos);
+	if (r->bio && (bio_end_sector(r->bio) != sector ||
+		       bio_full(r->bio, length))) {
+		submit_bio(r->bio);
+		r->bio = NULL;
+	}
+
+	if (!r->bio) {
+		r->bio = bio_alloc(GFP_NOFS, 4);
+		r->bio->bi_opf = REQ_OP_READ | REQ_RAHEAD;
+		r->bio->bi_iter.bi_sector = sector;
+		bio_set_dev(r->bio, iomap->bdev);
+		r->bio->bi_private = r;
+		r->bio->bi_end_io = iomap_thp_read_end_io;
+		atomic_inc(&r->pending);
+	}
+
+	/* The THP is physically contiguous, so this extends the last bvec */
+	bio_add_page(r->bio, page + (poff >> PAGE_SHIFT), length,
+		     offset_in_page(poff));
+	return length;
+}
+
+/**
+ * iomap_readpage_thp - read a locked THP for readahead
+ * @page: head page, locked and in the page cache
+ * @ops: iomap operations of the file system
+ *
+ * Returns 0 once the reads are in flight; the page is unlocked, and marked
+ * uptodate unless one of them failed, at completion. Returns a negative
+ * errno, with the page still locked, if no read could be started.
+ */
+int
+iomap_readpage_thp(struct page *page, const struct iomap_ops *ops)
+{
+	struct inode *inode = page->mapping->host;
+	size_t size = (size_t)hpage_nr_pages(page) << PAGE_SHIFT;
+	struct iomap_thp_read *r;
+	size_t poff;
+	loff_t ret;
+
+	r = kmalloc(sizeof(*r), GFP_NOFS);
+	if (!r)
+		return -ENOMEM;
+	r->page = page;
+	r->bio = NULL;
+	r->error = false;
+	atomic_set(&r->pending, 1);
+
+	for (poff = 0; poff < size; poff += ret) {
+		ret = iomap_apply(inode, page_offset(page) + poff, size - poff,
+				0, ops, r, iomap_readpage_thp_actor);
+		if (ret <= 0) {
+			if (!r->bio && atomic_read(&r->pending) == 1) {
+				kfree(r);
+				return ret ? ret : -EIO;
+			}
+			r->error = true;
+			break;
+		}
+	}
+
+	if (r->bio)
+		submit_bio(r->bio);
+	iomap_thp_read_done(r);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(iomap_readpage_thp);
+
 /*
  * iomap_is_partially_uptodate checks whether blocks within a page are
  * uptodate or not.
@@ -322,29 +322,72 @@ static void write_tag_block(journal_t *j, journal_block_tag_t *tag,
 		tag->t_blocknr_high = cpu_to_be32((block >> 31) >> 1);
 }
 
-static void jbd2_block_tag_csum_set(journal_t *j, journal_block_tag_t *tag,
-				    struct buffer_head *bh, __u32 sequence)
+/*
+ * Block tags wait here for their checksum so that the data blocks of
+ * several of them can be checksummed together.
+ */
+#define JBD2_TAG_CSUM_BATCH	4
+
+struct jbd2_tag_csum_batch {
+	journal_block_tag_t *tag[JBD2_TAG_CSUM_BATCH];
+	struct buffer_head *bh[JBD2_TAG_CSUM_BATCH];
+	int nr;
+};
+
+static void jbd2_block_tag_csum_flush(journal_t *j,
+				      struct jbd2_tag_csum_batch *batch,
+				      __u32 sequence)
 {
-	journal_block_tag3_t *tag3 = (journal_block_tag3_t *)tag;
-	struct page *page = bh->b_page;
-	__u8 *addr;
-	__u32 csum32;
+	const void *addr[JBD2_TAG_CSUM_BATCH];
+	__u32 csum32[JBD2_TAG_CSUM_BATCH];
+	__u32 seed;
 	__be32 seq;
+	int i;
 
-	if (!jbd2_journal_has_csum_v2or3(j))
+	if (!batch->nr)
 		return;
 
 	seq = cpu_to_be32(sequence);
-	addr = kmap_atomic(page);
-	csum32 = jbd2_chksum(j, j->j_csum_seed, (__u8 *)&seq, sizeof(seq));
-	csum32 = jbd2_chksum(j, csum32, addr + offset_in_page(bh->b_data),
-			     bh->b_size);
-	kunmap_atomic(addr);
+	seed = jbd2_chksum(j, j->j_csum_seed, (__u8 *)&seq, sizeof(seq));
+	for (i = 0; i < batch->nr; i++) {
+		struct buffer_head *bh = batch->bh[i];
 
-	if (jbd2_has_feature_csum3(j))
-		tag3->t_checksum = cpu_to_be32(csum32);
-	else
-		tag->t_checksum = cpu_to_be16(csum32);
+		addr[i] = kmap_atomic(bh->b_page) + offset_in_page(bh->b_data);
+		csum32[i] = seed;
+	}
+
+	jbd2_chksum_multi(j, csum32, addr, batch->bh[0]->b_size, batch->nr);
+
+	for (i = batch->nr - 1; i >= 0; i--)
+		kunmap_atomic((void *)addr[i]);
+
+	for (i = 0; i < batch->nr; i++) {
+		journal_block_tag_t *tag = batch->tag[i];
+		journal_block_tag3_t *tag3 = (journal_block_tag3_t *)tag;
+
+		if (jbd2_has_feature_csum3(j))
+			tag3->t_checksum = cpu_to_be32(csum32[i]);
+		else
+			tag->t_checksum = cpu_to_be16(csum32[i]);
+	}
+	batch->nr = 0;
+}
+
+static void jbd2_block_tag_csum_set(journal_t *j,
+				    struct jbd2_tag_csum_batch *batch,
+				    journal_block_tag_t *tag,
+				    struct buffer_head *bh, __u32 sequence)
+{
+	if (!jbd2_journal_has_csum_v2or3(j))
+		return;
+
+	if (batch->nr && bh->b_size != batch->bh[0]->b_size)
+		jbd2_block_tag_csum_flush(j, batch, sequence);
+
+	batch->tag[batch->nr] = tag;
+	batch->bh[batch->nr++] = bh;
+	if (batch->nr == JBD2_TAG_CSUM_BATCH)
+		jbd2_block_tag_csum_flush(j, batch, sequence);
 }
 /*
  * jbd2_journal_commit_transaction
@@ -367,6 +410,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	u64 commit_time;
 	char *tagp = NULL;
 	journal_block_tag_t *tag = NULL;
+	struct jbd2_tag_csum_batch csum_batch = { .nr = 0 };
 	int space_left = 0;
 	int first_tag = 0;
 	int tag_flag;
@@ -410,6 +454,25 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 		jbd_debug(3, "superblock not updated\n");
 	}
 
+	/*
+	 * Keep new fast commits out while we commit and wait for a running
+	 * one to finish: the fast commit area is reset once the transaction
+	 * it belongs to reaches the log.
+	 */
+	write_lock(&journal->j_state_lock);
+	journal->j_flags |= JBD2_FULL_COMMIT_ONGOING;
+	while (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+		DEFINE_WAIT(wait);
+
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		write_unlock(&journal->j_state_lock);
+		schedule();
+		write_lock(&journal->j_state_lock);
+		finish_wait(&journal->j_fc_wait, &wait);
+	}
+	write_unlock(&journal->j_state_lock);
+
 	J_ASSERT(journal->j_running_transaction != NULL);
 	J_ASSERT(journal->j_committing_transaction == NULL);
 
@@ -676,7 +739,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 		tag = (journal_block_tag_t *) tagp;
 		write_tag_block(journal, tag, jh2bh(jh)->b_blocknr);
 		tag->t_flags = cpu_to_be16(tag_flag);
-		jbd2_block_tag_csum_set(journal, tag, wbuf[bufs],
+		jbd2_block_tag_csum_set(journal, &csum_batch, tag, wbuf[bufs],
 					commit_transaction->t_tid);
 		tagp += tag_bytes;
 		space_left -= tag_bytes;
@@ -704,6 +767,8 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 
 			tag->t_flags |= cpu_to_be16(JBD2_FLAG_LAST_TAG);
 start_journal_io:
+			jbd2_block_tag_csum_flush(journal, &csum_batch,
+						  commit_transaction->t_tid);
 			if (descriptor)
 				jbd2_descriptor_block_csum_set(journal,
 							descriptor);
@@ -1119,6 +1184,9 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 
 	if (journal->j_commit_callback)
 		journal->j_commit_callback(journal, commit_transaction);
+	if (journal->j_fc_cleanup_callback)
+		journal->j_fc_cleanup_callback(journal,
+					       commit_transaction->t_tid);
 
 	trace_jbd2_end_commit(journal, commit_transaction);
 	jbd_debug(1, "JBD2: commit %d complete, head %d\n",
@@ -1133,9 +1201,12 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 		__jbd2_journal_drop_transaction(journal, commit_transaction);
 		jbd2_journal_free_transaction(commit_transaction);
 	}
+	journal->j_flags &= ~JBD2_FULL_COMMIT_ONGOING;
+	journal->j_fc_off = 0;
 	spin_unlock(&journal->j_list_lock);
 	write_unlock(&journal->j_state_lock);
 	wake_up(&journal->j_wait_done_commit);
+	wake_up(&journal->j_fc_wait);
 
 	/*
 	 * Calculate overall stats
@@ -762,6 +762,95 @@ int jbd2_complete_transaction(journal_t *journal, tid_t tid)
 }
 EXPORT_SYMBOL(jbd2_complete_transaction);
 
+/*
+ * Start a fast commit.  If there's an ongoing fast or full commit wait for
+ * it to complete.  Returns 0 if a new fast commit was started.  Returns
+ * -EALREADY if the fast commit was not started because of an ongoing or
+ * completed commit, in which case the caller should check whether @tid
+ * still needs committing.  Returns -EINVAL if @tid is not the running
+ * transaction and the caller must fall back to a full commit.
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	if (unlikely(is_journal_aborted(journal)))
+		return -EIO;
+
+	write_lock(&journal->j_state_lock);
+	if (tid_geq(journal->j_commit_sequence, tid)) {
+		write_unlock(&journal->j_state_lock);
+		return -EALREADY;
+	}
+
+	if (journal->j_flags & (JBD2_FULL_COMMIT_ONGOING |
+				JBD2_FAST_COMMIT_ONGOING)) {
+		DEFINE_WAIT(wait);
+
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		write_unlock(&journal->j_state_lock);
+		schedule();
+		finish_wait(&journal->j_fc_wait, &wait);
+		return -EALREADY;
+	}
+
+	if (!journal->j_running_transaction ||
+	    journal->j_running_transaction->t_tid != tid) {
+		write_unlock(&journal->j_state_lock);
+		return -EINVAL;
+	}
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+
+	/*
+	 * An empty log is not recovered at all, so make sure the superblock
+	 * no longer claims so before anything lands in the fast commit area.
+	 */
+	if (journal->j_flags & JBD2_FLUSHED) {
+		int ret;
+
+		mutex_lock_io(&journal->j_checkpoint_mutex);
+		ret = jbd2_journal_update_sb_log_tail(journal,
+						journal->j_tail_sequence,
+						journal->j_tail,
+						REQ_SYNC | REQ_FUA);
+		mutex_unlock(&journal->j_checkpoint_mutex);
+		if (ret) {
+			jbd2_fc_end_commit(journal);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+
+/*
+ * Stop a fast commit.  Any full commit or fast commit waiting for this one
+ * is allowed to proceed.
+ */
+int jbd2_fc_end_commit(journal_t *journal)
+{
+	write_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
+
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+
+/*
+ * Stop a fast commit that could not be completed and commit @tid the slow
+ * way instead.
+ */
+int jbd2_fc_end_commit_fallback(journal_t *journal, tid_t tid)
+{
+	jbd2_fc_end_commit(journal);
+
+	return jbd2_complete_transaction(journal, tid);
+}
+EXPORT_SYMBOL(jbd2_fc_end_commit_fallback);
+
 /*
  * Log buffer allocation routines:
  */
@@ -816,6 +905,70 @@ int jbd2_journal_bmap(journal_t *journal, unsigned long blocknr,
 	return err;
 }
 
+/*
+ * Get the next free block of the fast commit area.  Only valid between
+ * jbd2_fc_begin_commit() and jbd2_fc_end_commit().
+ */
+int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bh_out)
+{
+	unsigned long long pblock;
+	unsigned long blocknr;
+	struct buffer_head *bh;
+	int fc_off;
+	int ret;
+
+	*bh_out = NULL;
+
+	if (journal->j_fc_first + journal->j_fc_off >= journal->j_fc_last)
+		return -ENOSPC;
+
+	fc_off = journal->j_fc_off;
+	blocknr = journal->j_fc_first + fc_off;
+	journal->j_fc_off++;
+
+	ret = jbd2_journal_bmap(journal, blocknr, &pblock);
+	if (ret)
+		return ret;
+
+	bh = __getblk(journal->j_dev, pblock, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+
+	journal->j_fc_wbuf[fc_off] = bh;
+	*bh_out = bh;
+
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_get_buf);
+
+/*
+ * Wait on the last @num_blks fast commit buffers handed out by
+ * jbd2_fc_get_buf() and release them.
+ */
+int jbd2_fc_wait_bufs(journal_t *journal, int num_blks)
+{
+	struct buffer_head *bh;
+	int i, ret = 0;
+
+	if (WARN_ON_ONCE(num_blks > journal->j_fc_off))
+		return -EINVAL;
+
+	for (i = journal->j_fc_off - 1; i >= journal->j_fc_off - num_blks;
+	     i--) {
+		bh = journal->j_fc_wbuf[i];
+		if (!bh)
+			continue;
+		wait_on_buffer(bh);
+		if (unlikely(!buffer_uptodate(bh)))
+			ret = -EIO;
+		put_bh(bh);
+		journal->j_fc_wbuf[i] = NULL;
+	}
+
+	return ret;
+}
+EXPORT_SYMBOL(jbd2_fc_wait_bufs);
+
 /*
  * We play buffer_head aliasing tricks to write data/metadata blocks to
  * the journal without copying their contents, but for journal
@@ -1140,6 +1293,7 @@ static journal_t *journal_init_common(struct block_device *bdev,
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
 	init_waitqueue_head(&journal->j_wait_reserved);
+	init_waitqueue_head(&journal->j_fc_wait);
 	mutex_init(&journal->j_abort_mutex);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
@@ -1306,6 +1460,8 @@ static int journal_reset(journal_t *journal)
 
 	first = be32_to_cpu(sb->s_first);
 	last = be32_to_cpu(sb->s_maxlen);
+	if (jbd2_has_feature_fast_commit(journal))
+		last -= jbd2_journal_get_num_fc_blks(sb);
 	if (first + JBD2_MIN_JOURNAL_BLOCKS > last + 1) {
 		printk(KERN_ERR "JBD2: Journal too short (blocks %llu-%llu).\n",
 		       first, last);
@@ -1644,6 +1800,47 @@ static int journal_get_superblock(journal_t *journal)
 	return err;
 }
 
+/*
+ * Carve the fast commit area out of the end of the log and set up the
+ * fast commit buffer array.
+ */
+static int jbd2_journal_alloc_fc_wbuf(journal_t *journal, int num_fc_blks)
+{
+	if (journal->j_fc_wbuf && journal->j_fc_wbufsize == num_fc_blks)
+		return 0;
+
+	kfree(journal->j_fc_wbuf);
+	journal->j_fc_wbuf = kcalloc(num_fc_blks, sizeof(struct buffer_head *),
+				     GFP_KERNEL);
+	if (!journal->j_fc_wbuf) {
+		journal->j_fc_wbufsize = 0;
+		return -ENOMEM;
+	}
+	journal->j_fc_wbufsize = num_fc_blks;
+	return 0;
+}
+
+static int jbd2_journal_initialize_fast_commit(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long num_fc_blks;
+
+	num_fc_blks = jbd2_journal_get_num_fc_blks(sb);
+	if (journal->j_last < journal->j_first + num_fc_blks +
+			      JBD2_MIN_JOURNAL_BLOCKS)
+		return -ENOSPC;
+
+	if (jbd2_journal_alloc_fc_wbuf(journal, num_fc_blks))
+		return -ENOMEM;
+
+	journal->j_fc_last = journal->j_last;
+	journal->j_last = journal->j_fc_last - num_fc_blks;
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_off = 0;
+
+	return 0;
+}
+
 /*
  * Load the on-disk journal superblock and read the key fields into the
  * journal_t.
@@ -1666,6 +1863,15 @@ static int load_superblock(journal_t *journal)
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
+	if (jbd2_has_feature_fast_commit(journal)) {
+		err = jbd2_journal_initialize_fast_commit(journal);
+		if (err) {
+			printk(KERN_ERR "JBD2: cannot set up fast commit "
+			       "area on %s: %d\n", journal->j_devname, err);
+			return err;
+		}
+	}
+
 	return 0;
 }
 
@@ -1810,12 +2016,59 @@ int jbd2_journal_destroy(journal_t *journal)
 	if (journal->j_chksum_driver)
 		crypto_free_shash(journal->j_chksum_driver);
 	kfree(journal->j_wbuf);
+	kfree(journal->j_fc_wbuf);
 	kfree(journal);
 
 	return err;
 }
 
 
+/*
+ * Reserve the fast commit area at the end of an empty log.  Returns 0 on
+ * success.
+ */
+static int jbd2_journal_reserve_fast_commit(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long num_fc_blks = JBD2_DEFAULT_FAST_COMMIT_BLOCKS;
+	int err;
+
+	err = jbd2_journal_alloc_fc_wbuf(journal, num_fc_blks);
+	if (err)
+		goto out_warn;
+
+	err = -EBUSY;
+	write_lock(&journal->j_state_lock);
+	spin_lock(&journal->j_list_lock);
+	if (journal->j_running_transaction ||
+	    journal->j_committing_transaction ||
+	    journal->j_checkpoint_transactions ||
+	    journal->j_head != journal->j_tail)
+		goto out;
+
+	err = -ENOSPC;
+	if (journal->j_last < journal->j_first + num_fc_blks +
+			      JBD2_MIN_JOURNAL_BLOCKS ||
+	    journal->j_head >= journal->j_last - num_fc_blks)
+		goto out;
+
+	sb->s_num_fc_blks = cpu_to_be32(num_fc_blks);
+	journal->j_fc_last = journal->j_last;
+	journal->j_last = journal->j_fc_last - num_fc_blks;
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_off = 0;
+	journal->j_free = journal->j_last - journal->j_first;
+	err = 0;
+out:
+	spin_unlock(&journal->j_list_lock);
+	write_unlock(&journal->j_state_lock);
+out_warn:
+	if (err)
+		printk(KERN_WARNING "JBD2: cannot reserve fast commit area "
+		       "on %s: %d\n", journal->j_devname, err);
+	return err;
+}
+
 /**
  *int jbd2_journal_check_used_features () - Check if features specified are used.
  * @journal: Journal to check.
@@ -1903,6 +2156,7 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 #define COMPAT_FEATURE_ON(f) \
 		((compat & (f)) && !(sb->s_feature_compat & cpu_to_be32(f)))
 	journal_superblock_t *sb;
+	bool fc_on;
 
 	if (jbd2_journal_check_used_features(journal, compat, ro, incompat))
 		return 1;
@@ -1926,6 +2180,14 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 
 	sb = journal->j_superblock;
 
+	/*
+	 * The fast commit area is taken from the end of the log, so it can
+	 * only be reserved while the log is empty.
+	 */
+	fc_on = INCOMPAT_FEATURE_ON(JBD2_FEATURE_INCOMPAT_FAST_COMMIT);
+	if (fc_on && jbd2_journal_reserve_fast_commit(journal))
+		return 0;
+
 	/* Load the checksum driver if necessary */
 	if ((journal->j_chksum_driver == NULL) &&
 	    INCOMPAT_FEATURE_ON(JBD2_FEATURE_INCOMPAT_CSUM_V3)) {
@@ -1962,6 +2224,21 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 	journal->j_revoke_records_per_block =
 				journal_revoke_records_per_block(journal);
 
+	/*
+	 * Recovery must know about the fast commit area before the first
+	 * fast commit lands in it, so write the superblock out now rather
+	 * than with the next log tail update.
+	 */
+	if (fc_on) {
+		mutex_lock_io(&journal->j_checkpoint_mutex);
+		lock_buffer(journal->j_sb_buffer);
+		if (jbd2_write_superblock(journal, REQ_SYNC | REQ_FUA)) {
+			mutex_unlock(&journal->j_checkpoint_mutex);
+			return 0;
+		}
+		mutex_unlock(&journal->j_checkpoint_mutex);
+	}
+
 	return 1;
 #undef COMPAT_FEATURE_ON
 #undef INCOMPAT_FEATURE_ON
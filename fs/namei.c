@@ -2988,7 +2988,8 @@ static struct dentry *atomic_open(struct nameidata *nd, struct dentry *dentry,
 /*
  * Look up and maybe create and open the last component.
  *
- * Must be called with parent locked (exclusive in O_CREAT case).
+ * Must be called with parent locked (exclusive in O_CREAT case, unless the
+ * parent has IOP_PAR_CREATE and @par_create is set).
  *
  * Returns 0 on success, that is, if
  *  the file was successfully atomically created (if necessary) and opened, or
@@ -3000,9 +3001,36 @@ static struct dentry *atomic_open(struct nameidata *nd, struct dentry *dentry,
  *
  * An error code is returned on failure.
  */
+/*
+ * Directories with IOP_PAR_CREATE only have their i_rwsem taken shared for
+ * open(O_CREAT), so opens racing to create the same name serialize on the
+ * dentry instead.  The filesystem keeps its own directory consistent.
+ */
+static void d_lock_par_create(struct dentry *dentry)
+{
+	spin_lock(&dentry->d_lock);
+	while (dentry->d_flags & DCACHE_PAR_CREATE) {
+		spin_unlock(&dentry->d_lock);
+		wait_var_event(&dentry->d_flags,
+			       !(READ_ONCE(dentry->d_flags) & DCACHE_PAR_CREATE));
+		spin_lock(&dentry->d_lock);
+	}
+	dentry->d_flags |= DCACHE_PAR_CREATE;
+	spin_unlock(&dentry->d_lock);
+}
+
+static void d_unlock_par_create(struct dentry *dentry)
+{
+	spin_lock(&dentry->d_lock);
+	dentry->d_flags &= ~DCACHE_PAR_CREATE;
+	spin_unlock(&dentry->d_lock);
+	smp_mb();
+	wake_up_var(&dentry->d_flags);
+}
+
 static struct dentry *lookup_open(struct nameidata *nd, struct file *file,
 				  const struct open_flags *op,
-				  bool got_write)
+				  bool got_write, bool par_create)
 {
 	struct dentry *dir = nd->path.dentry;
 	struct inode *dir_inode = dir->d_inode;
@@ -3084,25 +3112,37 @@ static struct dentry *lookup_open(struct nameidata *nd, struct file *file,
 		}
 	}
 
-	/* Negative dentry, just create the file */
+	/*
+	 * Negative dentry, just create the file.  With the parent only held
+	 * shared, whoever gets the dentry first creates it; the others see
+	 * it positive and open the new file (or fail O_EXCL) instead.
+	 */
+	par_create &= !dentry->d_inode && (open_flag & O_CREAT);
+	if (par_create)
+		d_lock_par_create(dentry);
 	if (!dentry->d_inode && (open_flag & O_CREAT)) {
 		file->f_mode |= FMODE_CREATED;
 		audit_inode_child(dir_inode, dentry, AUDIT_TYPE_CHILD_CREATE);
 		if (!dir_inode->i_op->create) {
 			error = -EACCES;
-			goto out_dput;
+			goto out_unlock;
 		}
 		error = dir_inode->i_op->create(dir_inode, dentry, mode,
 						open_flag & O_EXCL);
 		if (error)
-			goto out_dput;
+			goto out_unlock;
 	}
+	if (par_create)
+		d_unlock_par_create(dentry);
 	if (unlikely(create_error) && !dentry->d_inode) {
 		error = create_error;
 		goto out_dput;
 	}
 	return dentry;
 
+out_unlock:
+	if (par_create)
+		d_unlock_par_create(dentry);
 out_dput:
 	dput(dentry);
 	return ERR_PTR(error);
@@ -3114,6 +3154,7 @@ static const char *open_last_lookups(struct nameidata *nd,
 	struct dentry *dir = nd->path.dentry;
 	int open_flag = op->open_flag;
 	bool got_write = false;
+	bool par_create = false;
 	unsigned seq;
 	struct inode *inode;
 	struct dentry *dentry;
@@ -3163,13 +3204,15 @@ static const char *open_last_lookups(struct nameidata *nd,
 		 */
 	}
 	if (open_flag & O_CREAT)
+		par_create = dir->d_inode->i_opflags & IOP_PAR_CREATE;
+	if ((open_flag & O_CREAT) && !par_create)
 		inode_lock(dir->d_inode);
 	else
 		inode_lock_shared(dir->d_inode);
-	dentry = lookup_open(nd, file, op, got_write);
+	dentry = lookup_open(nd, file, op, got_write, par_create);
 	if (!IS_ERR(dentry) && (file->f_mode & FMODE_CREATED))
 		fsnotify_create(dir->d_inode, dentry);
-	if (open_flag & O_CREAT)
+	if ((open_flag & O_CREAT) && !par_create)
 		inode_unlock(dir->d_inode);
 	else
 		inode_unlock_shared(dir->d_inode);
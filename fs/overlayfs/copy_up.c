@@ -18,10 +18,19 @@
 #include <linux/fdtable.h>
 #include <linux/ratelimit.h>
 #include <linux/exportfs.h>
+#include <linux/workqueue.h>
 #include "overlayfs.h"
 
 #define OVL_COPY_UP_CHUNK_SIZE (1 << 20)
 
+/* Smallest part of a file worth handing to a copy up worker */
+#define OVL_COPY_UP_WORKER_MIN (16 * OVL_COPY_UP_CHUNK_SIZE)
+
+static unsigned int ovl_copy_up_workers = 1;
+module_param_named(copy_up_workers, ovl_copy_up_workers, uint, 0644);
+MODULE_PARM_DESC(copy_up_workers,
+		 "Number of threads copying up the data of a large file");
+
 static int ovl_ccup_set(const char *buf, const struct kernel_param *param)
 {
 	pr_warn("\"check_copy_up\" module option is obsolete\n");
@@ -128,42 +137,35 @@ int ovl_copy_xattr(struct dentry *old, struct dentry *new)
 	return error;
 }
 
-static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
-{
+struct ovl_copy_data {
 	struct file *old_file;
 	struct file *new_file;
-	loff_t old_pos = 0;
-	loff_t new_pos = 0;
-	loff_t cloned;
+	bool skip_hole;
+	/* Set on error, to stop the other copy up workers */
+	bool abort;
+};
+
+struct ovl_copy_data_work {
+	struct work_struct work;
+	struct ovl_copy_data *cd;
+	loff_t pos;
+	loff_t len;
+	int error;
+};
+
+/* Copy @len bytes at @pos of the lower file to the same place in upper */
+static int ovl_copy_data_range(struct ovl_copy_data *cd, loff_t pos,
+			       loff_t len)
+{
+	struct file *old_file = cd->old_file;
+	struct file *new_file = cd->new_file;
+	loff_t old_pos = pos;
+	loff_t new_pos = pos;
 	loff_t data_pos = -1;
 	loff_t hole_len;
-	bool skip_hole = false;
+	bool skip_hole = cd->skip_hole;
 	int error = 0;
 
-	if (len == 0)
-		return 0;
-
-	old_file = ovl_path_open(old, O_LARGEFILE | O_RDONLY);
-	if (IS_ERR(old_file))
-		return PTR_ERR(old_file);
-
-	new_file = ovl_path_open(new, O_LARGEFILE | O_WRONLY);
-	if (IS_ERR(new_file)) {
-		error = PTR_ERR(new_file);
-		goto out_fput;
-	}
-
-	/* Try to use clone_file_range to clone up within the same fs */
-	cloned = do_clone_file_range(old_file, 0, new_file, 0, len, 0);
-	if (cloned == len)
-		goto out;
-	/* Couldn't clone, so now we try to copy the data */
-
-	/* Check if lower fs supports seek operation */
-	if (old_file->f_mode & FMODE_LSEEK &&
-	    old_file->f_op->llseek)
-		skip_hole = true;
-
 	while (len) {
 		size_t this_len = OVL_COPY_UP_CHUNK_SIZE;
 		long bytes;
@@ -176,6 +178,9 @@ static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
 			break;
 		}
 
+		if (READ_ONCE(cd->abort))
+			break;
+
 		/*
 		 * Fill zero for hole will cost unnecessary disk space
 		 * and meanwhile slow down the copy-up speed, so we do
@@ -196,6 +201,8 @@ static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
 			data_pos = vfs_llseek(old_file, old_pos, SEEK_DATA);
 			if (data_pos > old_pos) {
 				hole_len = data_pos - old_pos;
+				if (hole_len >= len)
+					break;
 				len -= hole_len;
 				old_pos = new_pos = data_pos;
 				continue;
@@ -217,6 +224,101 @@ static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
 
 		len -= bytes;
 	}
+
+	if (error)
+		WRITE_ONCE(cd->abort, true);
+	return error;
+}
+
+static void ovl_copy_data_workfn(struct work_struct *work)
+{
+	struct ovl_copy_data_work *w = container_of(work, typeof(*w), work);
+
+	w->error = ovl_copy_data_range(w->cd, w->pos, w->len);
+}
+
+/*
+ * With copy_up_workers > 1, a large file is split into that many parts,
+ * all but the first of which are copied by workqueue threads while the
+ * caller copies the first. The files were opened with the mounter's
+ * credentials, and the caller keeps write access to the upper fs until
+ * every worker is done, so the workers need nothing else from it.
+ */
+static int ovl_copy_data(struct ovl_copy_data *cd, loff_t len)
+{
+	struct ovl_copy_data_work *works = NULL;
+	unsigned int nr = ovl_copy_up_workers;
+	unsigned int i, queued = 0;
+	loff_t part, pos;
+	int error;
+
+	if (nr > 1)
+		nr = min_t(loff_t, nr, div_u64(len, OVL_COPY_UP_WORKER_MIN));
+	if (nr > 1)
+		works = kcalloc(nr - 1, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		return ovl_copy_data_range(cd, 0, len);
+
+	part = round_up(div_u64(len, nr), OVL_COPY_UP_CHUNK_SIZE);
+	for (i = 0, pos = part; i < nr - 1 && pos < len; i++, pos += part) {
+		struct ovl_copy_data_work *w = &works[i];
+
+		INIT_WORK(&w->work, ovl_copy_data_workfn);
+		w->cd = cd;
+		w->pos = pos;
+		w->len = min(part, len - pos);
+		queue_work(system_unbound_wq, &w->work);
+		queued++;
+	}
+
+	error = ovl_copy_data_range(cd, 0, min(part, len));
+
+	for (i = 0; i < queued; i++) {
+		flush_work(&works[i].work);
+		if (!error)
+			error = works[i].error;
+	}
+	kfree(works);
+
+	return error;
+}
+
+static int ovl_copy_up_data(struct path *old, struct path *new, loff_t len)
+{
+	struct ovl_copy_data cd = { };
+	struct file *old_file;
+	struct file *new_file;
+	loff_t cloned;
+	int error = 0;
+
+	if (len == 0)
+		return 0;
+
+	old_file = ovl_path_open(old, O_LARGEFILE | O_RDONLY);
+	if (IS_ERR(old_file))
+		return PTR_ERR(old_file);
+
+	new_file = ovl_path_open(new, O_LARGEFILE | O_WRONLY);
+	if (IS_ERR(new_file)) {
+		error = PTR_ERR(new_file);
+		goto out_fput;
+	}
+
+	/* Try to use clone_file_range to clone up within the same fs */
+	cloned = do_clone_file_range(old_file, 0, new_file, 0, len, 0);
+	if (cloned == len)
+		goto out;
+	/* Couldn't clone, so now we try to copy the data */
+
+	cd.old_file = old_file;
+	cd.new_file = new_file;
+
+	/* Check if lower fs supports seek operation */
+	if (old_file->f_mode & FMODE_LSEEK &&
+	    old_file->f_op->llseek)
+		cd.skip_hole = true;
+
+	error = ovl_copy_data(&cd, len);
 out:
 	if (!error)
 		error = vfs_fsync(new_file, 0);
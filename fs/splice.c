@@ -33,6 +33,7 @@
 #include <linux/security.h>
 #include <linux/gfp.h>
 #include <linux/socket.h>
+#include <linux/net.h>
 #include <linux/compat.h>
 #include <linux/sched/signal.h>
 
@@ -1053,6 +1054,98 @@ static int direct_splice_actor(struct pipe_inode_info *pipe,
  *    can splice directly through a process-private pipe.
  *
  */
+static bool splice_direct_from_pagecache(struct file *in)
+{
+	struct inode *inode = file_inode(in);
+
+	return in->f_op->splice_read == generic_file_splice_read &&
+	       (inode->i_sb->s_type->fs_flags & FS_PAGECACHE_SENDFILE) &&
+	       !(in->f_flags & O_DIRECT) && !IS_DAX(inode);
+}
+
+/*
+ * Hand uptodate page cache pages of @in straight to the socket behind @out,
+ * up to PIPE_DEF_BUFFERS pages per lookup, without bouncing them through
+ * the internal pipe of splice_direct_to_actor().  Stops at the first page
+ * that isn't cached and uptodate, returning 0 if nothing was sent so that
+ * the caller falls back to the pipe, which also takes care of reading the
+ * data in.
+ */
+static long splice_pagecache_to_socket(struct file *in, loff_t *ppos,
+				       struct socket *sock, struct file *out,
+				       size_t len, unsigned int flags)
+{
+	struct address_space *mapping = in->f_mapping;
+	struct inode *inode = mapping->host;
+	struct page *pages[PIPE_DEF_BUFFERS];
+	int msg_flags = (out->f_flags & O_NONBLOCK) ? MSG_DONTWAIT : 0;
+	loff_t pos = *ppos;
+	long sent = 0;
+	bool done = false;
+
+	while (len && !done) {
+		loff_t isize = i_size_read(inode);
+		unsigned int nr, i;
+
+		if (pos >= isize)
+			break;
+		if (len > isize - pos)
+			len = isize - pos;
+
+		nr = min_t(size_t, DIV_ROUND_UP(offset_in_page(pos) + len,
+						PAGE_SIZE), PIPE_DEF_BUFFERS);
+		nr = find_get_pages_contig(mapping, pos >> PAGE_SHIFT, nr, pages);
+		if (!nr)
+			break;
+
+		for (i = 0; i < nr && !done; i++) {
+			struct page *page = pages[i];
+			unsigned int offset = offset_in_page(pos);
+			size_t chunk = min_t(size_t, len, PAGE_SIZE - offset);
+			int more = msg_flags;
+			int ret;
+
+			if (!PageUptodate(page)) {
+				done = true;
+				break;
+			}
+
+			if (flags & SPLICE_F_MORE)
+				more |= MSG_MORE;
+			if (len > chunk)
+				more |= MSG_SENDPAGE_NOTLAST;
+
+			ret = kernel_sendpage(sock, page, offset, chunk, more);
+			if (ret <= 0) {
+				if (!sent)
+					sent = ret;
+				done = true;
+				break;
+			}
+
+			mark_page_accessed(page);
+			sent += ret;
+			pos += ret;
+			len -= ret;
+			if (ret < chunk)
+				done = true;
+		}
+
+		for (i = 0; i < nr; i++)
+			put_page(pages[i]);
+
+		if (fatal_signal_pending(current))
+			break;
+		cond_resched();
+	}
+
+	if (sent > 0) {
+		*ppos = pos;
+		file_accessed(in);
+	}
+	return sent;
+}
+
 long do_splice_direct(struct file *in, loff_t *ppos, struct file *out,
 		      loff_t *opos, size_t len, unsigned int flags)
 {
@@ -1076,6 +1169,20 @@ long do_splice_direct(struct file *in, loff_t *ppos, struct file *out,
 	if (unlikely(ret < 0))
 		return ret;
 
+	if (splice_direct_from_pagecache(in)) {
+		struct socket *sock;
+		int err;
+
+		sock = sock_from_file(out, &err);
+
+		if (sock) {
+			ret = splice_pagecache_to_socket(in, ppos, sock, out,
+							 len, flags);
+			if (ret)
+				return ret;
+		}
+	}
+
 	ret = splice_direct_to_actor(in, &sd, direct_splice_actor);
 	if (ret > 0)
 		*ppos = sd.pos;
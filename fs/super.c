@@ -162,9 +162,27 @@ static void destroy_super_work(struct work_struct *work)
 
 	for (i = 0; i < SB_FREEZE_LEVELS; i++)
 		percpu_free_rwsem(&s->s_writers.rw_sem[i]);
+	percpu_counter_destroy(&s->s_nr_dentry_negative);
 	kfree(s);
 }
 
+/*
+ * Queued when the superblock holds more unused negative dentries than
+ * sysctl_negative_dentry_limit allows.
+ */
+static void super_negative_dentry_work(struct work_struct *work)
+{
+	struct super_block *sb = container_of(work, struct super_block,
+					      s_negative_dentry_work);
+
+	/* Going through umount or remount, try again after the next dput */
+	if (!trylock_super(sb))
+		return;
+
+	prune_negative_dentries(sb);
+	up_read(&sb->s_umount);
+}
+
 static void destroy_super_rcu(struct rcu_head *head)
 {
 	struct super_block *s = container_of(head, struct super_block, rcu);
@@ -273,6 +291,9 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags,
 		goto fail;
 	if (list_lru_init_memcg(&s->s_inode_lru, &s->s_shrink))
 		goto fail;
+	if (percpu_counter_init(&s->s_nr_dentry_negative, 0, GFP_KERNEL))
+		goto fail;
+	INIT_WORK(&s->s_negative_dentry_work, super_negative_dentry_work);
 	return s;
 
 fail:
@@ -333,6 +354,7 @@ void deactivate_locked_super(struct super_block *s)
 		cleancache_invalidate_fs(s);
 		unregister_shrinker(&s->s_shrink);
 		fs->kill_sb(s);
+		cancel_work_sync(&s->s_negative_dentry_work);
 
 		/*
 		 * Since list_lru_destroy() may sleep, we cannot call it from
@@ -628,6 +628,14 @@ xfs_vm_readahead(
 	iomap_readahead(rac, &xfs_read_iomap_ops);
 }
 
+STATIC int
+xfs_vm_readpage_thp(
+	struct file		*unused,
+	struct page		*page)
+{
+	return iomap_readpage_thp(page, &xfs_read_iomap_ops);
+}
+
 static int
 xfs_iomap_swapfile_activate(
 	struct swap_info_struct		*sis,
@@ -642,6 +650,7 @@ xfs_iomap_swapfile_activate(
 const struct address_space_operations xfs_address_space_operations = {
 	.readpage		= xfs_vm_readpage,
 	.readahead		= xfs_vm_readahead,
+	.readpage_thp		= xfs_vm_readpage_thp,
 	.writepage		= xfs_vm_writepage,
 	.writepages		= xfs_vm_writepages,
 	.set_page_dirty		= iomap_set_page_dirty,
@@ -235,7 +235,8 @@ struct xfs_cil_ctx {
 	xfs_lsn_t		commit_lsn;	/* chkpt commit record lsn */
 	struct xlog_ticket	*ticket;	/* chkpt ticket */
 	int			nvecs;		/* number of regions */
-	int			space_used;	/* aggregate size of regions */
+	atomic_t		space_used;	/* aggregate size of regions */
+	atomic_t		order_id;	/* commit order of items */
 	struct list_head	busy_extents;	/* busy extents in chkpt */
 	struct xfs_log_vec	*lv_chain;	/* logvecs being pushed */
 	struct list_head	iclog_entry;
@@ -259,10 +260,27 @@ struct xfs_cil_ctx {
  * the commit LSN to be determined as well. This should make synchronous
  * operations almost as efficient as the old logging methods.
  */
+/*
+ * Per-cpu CIL state.  Transaction commits only update the structure of the
+ * CPU they run on and the push folds all of them into the context being
+ * pushed while holding xc_ctx_lock exclusively.
+ */
+struct xlog_cil_pcp {
+	int32_t			space_used;	/* not yet in ctx->space_used */
+	int32_t			space_total;	/* committed in this context */
+	uint32_t		space_reserved;	/* stolen for the ctx ticket */
+	int			nvecs;
+	struct list_head	busy_extents;
+	struct list_head	log_items;
+};
+
+/* xc_flags */
+#define XLOG_CIL_EMPTY		1
+
 struct xfs_cil {
 	struct xlog		*xc_log;
-	struct list_head	xc_cil;
-	spinlock_t		xc_cil_lock;
+	unsigned long		xc_flags;
+	struct xlog_cil_pcp __percpu *xc_pcp;
 
 	struct rw_semaphore	xc_ctx_lock ____cacheline_aligned_in_smp;
 	struct xfs_cil_ctx	*xc_ctx;
@@ -392,6 +410,7 @@ struct xlog {
 	uint			l_flags;
 	uint			l_quotaoffs_flag; /* XFS_DQ_*, for QUOTAOFFs */
 	struct list_head	*l_buf_cancel_table;
+	struct xlog_recover_pass2 *l_recover_pass2; /* parallel pass 2 */
 	int			l_iclog_hsize;  /* size of iclog header */
 	int			l_iclog_heads;  /* # of iclog header sectors */
 	uint			l_sectBBsize;   /* sector size in BBs (2^n) */
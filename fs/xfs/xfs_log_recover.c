@@ -25,6 +25,7 @@
 #include "xfs_icache.h"
 #include "xfs_error.h"
 #include "xfs_buf_item.h"
+#include "xfs_pwork.h"
 
 #define BLK_AVG(blk1, blk2)	((blk1+blk2) >> 1)
 
@@ -1957,7 +1958,7 @@ xlog_buf_readahead(
 }
 
 STATIC int
-xlog_recover_items_pass2(
+xlog_recover_items_list_pass2(
 	struct xlog                     *log,
 	struct xlog_recover             *trans,
 	struct list_head                *buffer_list,
@@ -1980,6 +1981,204 @@ xlog_recover_items_pass2(
 	return error;
 }
 
+/*
+ * Parallel pass 2 replay
+ *
+ * A buffer, inode or dquot item replays into a single metadata buffer and
+ * only has to be ordered against other items touching that buffer.  As a
+ * buffer never spans AGs, a batch made up of such items only is split by AG
+ * and the per-AG lists are replayed concurrently, each worker queueing its
+ * buffers on a private delwri list.  The synchronous buffer reads are what
+ * makes replay slow, so this mostly buys overlapping I/O.  Anything else in
+ * the batch (buffer cancellations, intents, inode fork owner changes...)
+ * makes it replay in log order on the calling thread as before.
+ */
+struct xlog_recover_pwork {
+	struct xfs_pwork	pwork;
+	struct xlog		*log;
+	struct xlog_recover	*trans;
+	struct list_head	item_list;
+	struct list_head	buffer_list;
+};
+
+struct xlog_recover_pass2 {
+	struct xfs_pwork_ctl	pctl;
+	unsigned int		nr_work;
+	struct xlog_recover_pwork work[];
+};
+
+/*
+ * Return the AG that @item replays into, or NULLAGNUMBER if it has to be
+ * replayed in log order with everything else.
+ */
+STATIC xfs_agnumber_t
+xlog_recover_item_agno(
+	struct xlog			*log,
+	struct xlog_recover_item	*item)
+{
+	struct xfs_buf_log_format	*buf_f;
+	xfs_daddr_t			blkno;
+	uint				fields;
+
+	switch (ITEM_TYPE(item)) {
+	case XFS_LI_BUF:
+		buf_f = item->ri_buf[0].i_addr;
+		/* cancellations update the shared cancel table */
+		if (buf_f->blf_flags & XFS_BLF_CANCEL)
+			return NULLAGNUMBER;
+		blkno = buf_f->blf_blkno;
+		break;
+	case XFS_LI_INODE:
+		if (item->ri_buf[0].i_len == sizeof(struct xfs_inode_log_format)) {
+			struct xfs_inode_log_format	*in_f;
+
+			in_f = item->ri_buf[0].i_addr;
+			blkno = in_f->ilf_blkno;
+			fields = in_f->ilf_fields;
+		} else {
+			struct xfs_inode_log_format_32	*in_f;
+
+			in_f = item->ri_buf[0].i_addr;
+			blkno = in_f->ilf_blkno;
+			fields = in_f->ilf_fields;
+		}
+		/* owner changes rewrite bmbt blocks anywhere in the fs */
+		if (fields & (XFS_ILOG_DOWNER | XFS_ILOG_AOWNER))
+			return NULLAGNUMBER;
+		break;
+	case XFS_LI_DQUOT:
+		blkno = ((struct xfs_dq_logformat *)
+				item->ri_buf[0].i_addr)->qlf_blkno;
+		break;
+	default:
+		return NULLAGNUMBER;
+	}
+
+	return xfs_daddr_to_agno(log->l_mp, blkno);
+}
+
+static int
+xlog_recover_pass2_work(
+	struct xfs_mount		*mp,
+	struct xfs_pwork		*pwork)
+{
+	struct xlog_recover_pwork	*rpw;
+
+	rpw = container_of(pwork, struct xlog_recover_pwork, pwork);
+	if (xfs_pwork_want_abort(pwork))
+		return 0;
+
+	return xlog_recover_items_list_pass2(rpw->log, rpw->trans,
+			&rpw->buffer_list, &rpw->item_list);
+}
+
+STATIC int
+xlog_recover_items_pass2(
+	struct xlog                     *log,
+	struct xlog_recover             *trans,
+	struct list_head                *buffer_list,
+	struct list_head                *item_list)
+{
+	struct xlog_recover_pass2	*rp2 = log->l_recover_pass2;
+	struct xlog_recover_pwork	*rpw;
+	struct xlog_recover_item	*item, *n;
+	xfs_agnumber_t			agno, first_agno = NULLAGNUMBER;
+	bool				one_ag = true;
+	unsigned int			i;
+
+	if (!rp2)
+		goto serial;
+
+	list_for_each_entry(item, item_list, ri_list) {
+		agno = xlog_recover_item_agno(log, item);
+		if (agno == NULLAGNUMBER)
+			goto serial;
+		if (first_agno == NULLAGNUMBER)
+			first_agno = agno;
+		else if (agno != first_agno)
+			one_ag = false;
+	}
+	if (one_ag)
+		goto serial;
+
+	/* Items of one AG stay in log order on the same worker. */
+	list_for_each_entry_safe(item, n, item_list, ri_list) {
+		agno = xlog_recover_item_agno(log, item);
+		rpw = &rp2->work[agno % rp2->nr_work];
+		list_move_tail(&item->ri_list, &rpw->item_list);
+	}
+
+	for (i = 0; i < rp2->nr_work; i++) {
+		rpw = &rp2->work[i];
+		if (list_empty(&rpw->item_list))
+			continue;
+		rpw->trans = trans;
+		xfs_pwork_queue(&rp2->pctl, &rpw->pwork);
+	}
+	xfs_pwork_poll(&rp2->pctl);
+
+	for (i = 0; i < rp2->nr_work; i++) {
+		rpw = &rp2->work[i];
+		list_splice_tail_init(&rpw->item_list, item_list);
+		list_splice_tail_init(&rpw->buffer_list, buffer_list);
+	}
+	return rp2->pctl.error;
+
+serial:
+	return xlog_recover_items_list_pass2(log, trans, buffer_list,
+			item_list);
+}
+
+/*
+ * Set up parallel pass 2 replay if the data device looks like it can take
+ * it.  This is an optimisation only, so failing to set it up is not fatal.
+ */
+STATIC void
+xlog_recover_pass2_init(
+	struct xlog			*log)
+{
+	struct xfs_mount		*mp = log->l_mp;
+	struct xlog_recover_pass2	*rp2;
+	unsigned int			nr_work, i;
+
+	nr_work = xfs_pwork_guess_datadev_parallelism(mp);
+	if (!nr_work)
+		nr_work = num_online_cpus();
+	nr_work = min_t(unsigned int, nr_work, mp->m_sb.sb_agcount);
+	if (nr_work < 2)
+		return;
+
+	rp2 = kmem_zalloc(struct_size(rp2, work, nr_work), KM_MAYFAIL);
+	if (!rp2)
+		return;
+	if (xfs_pwork_init(mp, &rp2->pctl, xlog_recover_pass2_work,
+			"xfs_logrecover", nr_work)) {
+		kmem_free(rp2);
+		return;
+	}
+
+	rp2->nr_work = nr_work;
+	for (i = 0; i < nr_work; i++) {
+		rp2->work[i].log = log;
+		INIT_LIST_HEAD(&rp2->work[i].item_list);
+		INIT_LIST_HEAD(&rp2->work[i].buffer_list);
+	}
+	log->l_recover_pass2 = rp2;
+}
+
+STATIC void
+xlog_recover_pass2_destroy(
+	struct xlog			*log)
+{
+	struct xlog_recover_pass2	*rp2 = log->l_recover_pass2;
+
+	if (!rp2)
+		return;
+	xfs_pwork_destroy(&rp2->pctl);
+	kmem_free(rp2);
+	log->l_recover_pass2 = NULL;
+}
+
 /*
  * Perform the transaction.
  *
@@ -3273,8 +3472,10 @@ xlog_do_log_recovery(
 	 * Then do a second pass to actually recover the items in the log.
 	 * When it is complete free the table of buf cancel items.
 	 */
+	xlog_recover_pass2_init(log);
 	error = xlog_do_recovery_pass(log, head_blk, tail_blk,
 				      XLOG_RECOVER_PASS2, NULL);
+	xlog_recover_pass2_destroy(log);
 #ifdef DEBUG
 	if (!error) {
 		int	i;
@@ -200,6 +200,8 @@ struct vgic_redist_region {
 	struct list_head list;
 };
 
+struct vgic_translation_cache_set;
+
 struct vgic_dist {
 	bool			in_kernel;
 	bool			ready;
@@ -253,8 +255,9 @@ struct vgic_dist {
 	struct list_head	lpi_list_head;
 	int			lpi_list_count;
 
-	/* LPI translation cache */
-	struct list_head	lpi_translation_cache;
+	/* LPI translation cache, hashed into sets of LRU lists */
+	struct vgic_translation_cache_set *lpi_translation_cache;
+	unsigned int		lpi_translation_cache_sets;
 
 	/* used by vgic-debug */
 	struct vgic_state_iter *iter;
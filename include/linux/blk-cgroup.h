@@ -139,6 +139,14 @@ struct blkcg_gq {
 	u64				last_delay;
 	int				last_use;
 
+	/*
+	 * Writeback throttling: tracked writes issued in the current wbt
+	 * window and whether the last window saw this blkg as one of the
+	 * dominant writers on the queue.
+	 */
+	atomic_t			wbt_nr_ios;
+	bool				wbt_noisy;
+
 	struct rcu_head			rcu_head;
 };
 
@@ -437,6 +437,7 @@ int blk_mq_alloc_tag_set(struct blk_mq_tag_set *set);
 void blk_mq_free_tag_set(struct blk_mq_tag_set *set);
 
 void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule);
+void blk_mq_free_plug_rqs(struct blk_plug *plug);
 
 void blk_mq_free_request(struct request *rq);
 
@@ -500,6 +501,28 @@ void blk_mq_start_request(struct request *rq);
 void blk_mq_end_request(struct request *rq, blk_status_t error);
 void __blk_mq_end_request(struct request *rq, blk_status_t error);
 
+/**
+ * struct io_comp_batch - requests completed successfully in one pass
+ * @req_list: completed requests, linked through their queuelist
+ * @need_ts: some request needs a completion timestamp
+ * @complete: driver callback that finishes the batch, usually by calling
+ *	blk_mq_end_request_batch() after its own per-request teardown
+ */
+struct io_comp_batch {
+	struct list_head req_list;
+	bool need_ts;
+	void (*complete)(struct io_comp_batch *);
+};
+
+#define DEFINE_IO_COMP_BATCH(name)					\
+	struct io_comp_batch name = {					\
+		.req_list = LIST_HEAD_INIT(name.req_list),		\
+	}
+
+bool blk_mq_add_to_batch(struct request *rq, struct io_comp_batch *iob,
+			 void (*complete)(struct io_comp_batch *));
+void blk_mq_end_request_batch(struct io_comp_batch *iob);
+
 void blk_mq_requeue_request(struct request *rq, bool kick_requeue_list);
 void blk_mq_kick_requeue_list(struct request_queue *q);
 void blk_mq_delay_kick_requeue_list(struct request_queue *q, unsigned long msecs);
@@ -360,6 +360,12 @@ enum req_flag_bits {
 	/* for driver use */
 	__REQ_DRV,
 	__REQ_SWAP,		/* swapping request. */
+
+	/* block layer internal, see block/blk-zoned.c */
+	__REQ_ZONE_WPLUG,	/* write owned by a zone write plug */
+	__REQ_ZONE_APPEND_EMU,	/* zone append emulated with a regular write */
+	__REQ_ALLOC_CACHE,	/* bio comes from a bio_set per-cpu cache */
+
 	__REQ_NR_BITS,		/* stops here */
 };
 
@@ -385,6 +391,10 @@ enum req_flag_bits {
 #define REQ_DRV			(1ULL << __REQ_DRV)
 #define REQ_SWAP		(1ULL << __REQ_SWAP)
 
+#define REQ_ZONE_WPLUG		(1ULL << __REQ_ZONE_WPLUG)
+#define REQ_ZONE_APPEND_EMU	(1ULL << __REQ_ZONE_APPEND_EMU)
+#define REQ_ALLOC_CACHE		(1ULL << __REQ_ALLOC_CACHE)
+
 #define REQ_FAILFAST_MASK \
 	(REQ_FAILFAST_DEV | REQ_FAILFAST_TRANSPORT | REQ_FAILFAST_DRIVER)
 
@@ -452,6 +452,13 @@ struct cgroup {
 	struct cgroup_rstat_cpu __percpu *rstat_cpu;
 	struct list_head rstat_css_list;
 
+	/*
+	 * CPUs on which the updated tree below this cgroup may be non-empty
+	 * and jiffies of the last flush, see cgroup_rstat_flush_hold().
+	 */
+	cpumask_var_t rstat_pending_cpus;
+	unsigned long rstat_flush_time;
+
 	/* cgroup basic resource statistics */
 	struct cgroup_base_stat last_bstat;
 	struct cgroup_base_stat bstat;
@@ -37,6 +37,8 @@ static inline u32 crc32_le_combine(u32 crc1, u32 crc2, size_t len2)
 }
 
 u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len);
+void __crc32c_le_multi(u32 *crc, unsigned char const * const *p, size_t len,
+		       unsigned int nr);
 
 /**
  * __crc32c_le_combine - Combine two crc32c check values into one. For two
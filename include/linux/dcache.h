@@ -68,6 +68,8 @@ struct dentry_stat_t {
 	long dummy;		/* Reserved for future use */
 };
 extern struct dentry_stat_t dentry_stat;
+extern unsigned long sysctl_negative_dentry_limit;
+extern unsigned long negative_dentry_trimmed;
 
 /*
  * Try to keep struct dentry aligned on 64 byte cachelines (this will
@@ -215,6 +217,7 @@ struct dentry_operations {
 #define DCACHE_FALLTHRU			0x01000000 /* Fall through to lower layer */
 #define DCACHE_ENCRYPTED_NAME		0x02000000 /* Encrypted name (dir key was unavailable) */
 #define DCACHE_OP_REAL			0x04000000
+#define DCACHE_PAR_CREATE		0x08000000 /* being created (with parent locked shared) */
 
 #define DCACHE_PAR_LOOKUP		0x10000000 /* being looked up (with parent locked shared) */
 #define DCACHE_DENTRY_CURSOR		0x20000000
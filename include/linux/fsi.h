@@ -24,6 +24,10 @@ extern int fsi_device_read(struct fsi_device *dev, uint32_t addr,
 extern int fsi_device_write(struct fsi_device *dev, uint32_t addr,
 		const void *val, size_t size);
 extern int fsi_device_peek(struct fsi_device *dev, void *val);
+extern int fsi_device_read_fifo(struct fsi_device *dev, uint32_t addr,
+		__be32 *val, size_t count);
+extern int fsi_device_write_fifo(struct fsi_device *dev, uint32_t addr,
+		const __be32 *val, size_t count);
 
 struct fsi_device_id {
 	u8	engine_type;
@@ -67,6 +71,10 @@ extern int fsi_slave_read(struct fsi_slave *slave, uint32_t addr,
 		void *val, size_t size);
 extern int fsi_slave_write(struct fsi_slave *slave, uint32_t addr,
 		const void *val, size_t size);
+extern int fsi_slave_read_fifo(struct fsi_slave *slave, uint32_t addr,
+		__be32 *val, size_t count);
+extern int fsi_slave_write_fifo(struct fsi_slave *slave, uint32_t addr,
+		const __be32 *val, size_t count);
 
 extern struct bus_type fsi_bus_type;
 extern const struct device_type fsi_cdev_type;
@@ -93,6 +93,19 @@ enum hrtimer_restart {
 #define HRTIMER_STATE_INACTIVE	0x00
 #define HRTIMER_STATE_ENQUEUED	0x01
 
+/*
+ * With CONFIG_HRTIMER_BATCH_EXPIRY expired timers are detached from their
+ * base in batches of HRTIMER_EXPIRY_BATCH under a single lock hold and
+ * their callbacks are run without retaking the lock for each of them.
+ * hrtimer::batch_state is HRTIMER_BATCH_NONE for timers outside of a
+ * batch, the slot number + 1 in hrtimer_clock_base::batch[] for timers
+ * waiting for their callback and HRTIMER_BATCH_RUNNING while the callback
+ * is executed.  A batched timer is considered to be running its callback.
+ */
+#define HRTIMER_EXPIRY_BATCH	16
+#define HRTIMER_BATCH_NONE	0x00
+#define HRTIMER_BATCH_RUNNING	0xff
+
 /**
  * struct hrtimer - the basic hrtimer structure
  * @node:	timerqueue node, which also manages node.expires,
@@ -111,6 +124,7 @@ enum hrtimer_restart {
  * @is_soft:	Set if hrtimer will be expired in soft interrupt context.
  * @is_hard:	Set if hrtimer will be expired in hard interrupt context
  *		even on RT.
+ * @batch_state: batched expiry state (See HRTIMER_BATCH_* above)
  *
  * The hrtimer structure must be initialized by hrtimer_init()
  */
@@ -123,6 +137,9 @@ struct hrtimer {
 	u8				is_rel;
 	u8				is_soft;
 	u8				is_hard;
+#ifdef CONFIG_HRTIMER_BATCH_EXPIRY
+	u8				batch_state;
+#endif
 };
 
 /**
@@ -154,6 +171,7 @@ struct hrtimer_sleeper {
  * @active:		red black tree root node for the active timers
  * @get_time:		function to retrieve the current time of the clock
  * @offset:		offset of this clock to the monotonic base
+ * @batch:		expired timers waiting for their callback to be run
  */
 struct hrtimer_clock_base {
 	struct hrtimer_cpu_base	*cpu_base;
@@ -164,6 +182,9 @@ struct hrtimer_clock_base {
 	struct timerqueue_head	active;
 	ktime_t			(*get_time)(void);
 	ktime_t			offset;
+#ifdef CONFIG_HRTIMER_BATCH_EXPIRY
+	struct hrtimer		*batch[HRTIMER_EXPIRY_BATCH];
+#endif
 } __hrtimer_clock_base_align;
 
 enum  hrtimer_base_type {
@@ -474,9 +495,18 @@ static inline bool hrtimer_is_queued(struct hrtimer *timer)
  * Helper function to check, whether the timer is running the callback
  * function
  */
+static inline bool hrtimer_is_batched(const struct hrtimer *timer)
+{
+#ifdef CONFIG_HRTIMER_BATCH_EXPIRY
+	return READ_ONCE(timer->batch_state) != HRTIMER_BATCH_NONE;
+#else
+	return false;
+#endif
+}
+
 static inline int hrtimer_callback_running(struct hrtimer *timer)
 {
-	return timer->base->running == timer;
+	return timer->base->running == timer || hrtimer_is_batched(timer);
 }
 
 /* Forward a hrtimer so it expires after now: */
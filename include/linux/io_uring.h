@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef _LINUX_IO_URING_H
+#define _LINUX_IO_URING_H
+
+#include <linux/types.h>
+#include <linux/uio.h>
+
+struct file;
+
+/* issue_flags passed to ->uring_cmd() */
+enum io_uring_cmd_flags {
+	/* must not block, return -EAGAIN to get retried from io-wq */
+	IO_URING_F_NONBLOCK		= 1,
+};
+
+/* largest command payload IORING_OP_URING_CMD copies in for the driver */
+#define IO_URING_CMD_MAX_LEN		80
+
+struct io_uring_cmd {
+	struct file	*file;
+	/* kernel copy of the command, valid until io_uring_cmd_done() */
+	const void	*cmd;
+	/* where userspace keeps the command, for writing back results */
+	void __user	*ucmd;
+	/* callback to defer completions to task context */
+	void (*task_work_cb)(struct io_uring_cmd *ioucmd);
+	u32		cmd_op;
+	u32		cmd_len;
+	u32		flags;
+	/* available inline for free use by the driver */
+	u8		pdu[32];
+};
+
+#if defined(CONFIG_IO_URING)
+int io_uring_cmd_import_fixed(u64 ubuf, unsigned long len, int rw,
+			      struct iov_iter *iter,
+			      struct io_uring_cmd *ioucmd);
+void io_uring_cmd_done(struct io_uring_cmd *ioucmd, ssize_t ret);
+void io_uring_cmd_complete_in_task(struct io_uring_cmd *ioucmd,
+			void (*task_work_cb)(struct io_uring_cmd *));
+#else
+static inline int io_uring_cmd_import_fixed(u64 ubuf, unsigned long len,
+			int rw, struct iov_iter *iter,
+			struct io_uring_cmd *ioucmd)
+{
+	return -EOPNOTSUPP;
+}
+static inline void io_uring_cmd_done(struct io_uring_cmd *ioucmd,
+				     ssize_t ret)
+{
+}
+static inline void io_uring_cmd_complete_in_task(struct io_uring_cmd *ioucmd,
+			void (*task_work_cb)(struct io_uring_cmd *))
+{
+}
+#endif
+
+#endif
@@ -307,6 +307,9 @@ extern int arch_within_optimized_kprobe(struct optimized_kprobe *op,
 
 extern void opt_pre_handler(struct kprobe *p, struct pt_regs *regs);
 
+void *alloc_optinsn_page(void);
+void free_optinsn_page(void *page);
+
 DEFINE_INSN_CACHE_OPS(optinsn);
 
 #ifdef CONFIG_SYSCTL
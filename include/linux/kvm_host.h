@@ -286,6 +286,11 @@ struct kvm_vcpu {
 	unsigned int halt_poll_ns;
 	bool valid_wakeup;
 
+	/* log2 histogram of recent block times, see halt_poll_ns_coverage */
+#define KVM_HALT_HIST_BUCKETS	32
+	u16 halt_hist[KVM_HALT_HIST_BUCKETS];
+	u16 halt_hist_count;
+
 #ifdef CONFIG_HAS_IOMEM
 	int mmio_needed;
 	int mmio_read_completed;
@@ -1280,6 +1285,7 @@ extern unsigned int halt_poll_ns;
 extern unsigned int halt_poll_ns_grow;
 extern unsigned int halt_poll_ns_grow_start;
 extern unsigned int halt_poll_ns_shrink;
+extern unsigned int halt_poll_ns_coverage;
 
 struct kvm_device {
 	const struct kvm_device_ops *ops;
@@ -78,7 +78,7 @@ struct page {
 		struct {	/* Page cache and anonymous pages */
 			/**
 			 * @lru: Pageout list, eg. active_list protected by
-			 * pgdat->lru_lock.  Sometimes used as a generic list
+			 * lruvec->lru_lock.  Sometimes used as a generic list
 			 * by the page owner.
 			 */
 			struct list_head lru;
@@ -95,10 +95,20 @@ struct page {
 		};
 		struct {	/* page_pool used by netstack */
 			/**
-			 * @dma_addr: might require a 64-bit value even on
-			 * 32-bit architectures.
+			 * @pp_magic: magic value to avoid recycling non
+			 * page_pool allocated pages.
 			 */
-			dma_addr_t dma_addr;
+			unsigned long pp_magic;
+			struct page_pool *pp;
+			/* @mapping must stay NULL, @index holds pfmemalloc */
+			unsigned long _pp_mapping_pad;
+			unsigned long _pp_index_pad;
+			/**
+			 * @dma_addr: stored shifted by PAGE_SHIFT on 32-bit
+			 * architectures with 64-bit DMA addresses, see
+			 * page_pool_get_dma_addr().
+			 */
+			unsigned long dma_addr;
 		};
 		struct {	/* slab, slob and slub */
 			union {
@@ -367,6 +377,19 @@ struct vm_area_struct {
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
 	struct vm_userfaultfd_ctx vm_userfaultfd_ctx;
+#ifdef CONFIG_PER_VMA_LOCK
+	/*
+	 * Lets page faults run against this VMA without mmap_lock. A writer
+	 * holding mmap_lock for write marks the VMA by setting vm_lock_seq to
+	 * mm->mm_lock_seq; the mark is dropped for all VMAs of the mm at once
+	 * when mmap_lock is released.
+	 */
+	struct rw_semaphore vm_lock;
+	int vm_lock_seq;
+	/* Unlinked from the mm, only kept around for RCU readers */
+	bool vm_detached;
+	struct rcu_head vm_rcu;
+#endif
 } __randomize_layout;
 
 struct core_thread {
@@ -441,6 +464,13 @@ struct mm_struct {
 					     * counters
 					     */
 		struct rw_semaphore mmap_lock;
+#ifdef CONFIG_PER_VMA_LOCK
+		/*
+		 * Bumped on every mmap_lock write unlock, see
+		 * vm_area_struct::vm_lock_seq.
+		 */
+		int mm_lock_seq;
+#endif
 
 		struct list_head mmlist; /* List of maybe swapped mm's.	These
 					  * are globally strung together off
@@ -536,6 +566,10 @@ struct mm_struct {
 		struct uprobes_state uprobes_state;
 #ifdef CONFIG_HUGETLB_PAGE
 		atomic_long_t hugetlb_usage;
+#endif
+#ifdef CONFIG_FUTEX
+		/* hash for private futexes, see futex_hash_prctl() */
+		struct futex_private_hash *futex_phash;
 #endif
 		struct work_struct async_put_work;
 	} __randomize_layout;
@@ -564,6 +598,31 @@ static inline cpumask_t *mm_cpumask(struct mm_struct *mm)
 	return (struct cpumask *)&mm->cpu_bitmap;
 }
 
+#ifdef CONFIG_MEMBARRIER
+/*
+ * CPUs that may be running this mm, kept by the scheduler for private
+ * expedited membarrier. It follows mm_cpumask at the end of mm_struct.
+ */
+static inline cpumask_t *mm_membarrier_cpumask(struct mm_struct *mm)
+{
+	unsigned long cpu_bitmap = (unsigned long)mm;
+
+	cpu_bitmap += offsetof(struct mm_struct, cpu_bitmap);
+	cpu_bitmap += cpumask_size();
+	return (struct cpumask *)cpu_bitmap;
+}
+
+static inline void mm_init_membarrier_cpumask(struct mm_struct *mm)
+{
+	/* dup_mm() keeps the registration, so start from every CPU */
+	cpumask_setall(mm_membarrier_cpumask(mm));
+}
+#else
+static inline void mm_init_membarrier_cpumask(struct mm_struct *mm)
+{
+}
+#endif
+
 struct mmu_gather;
 extern void tlb_gather_mmu(struct mmu_gather *tlb, struct mm_struct *mm,
 				unsigned long start, unsigned long end);
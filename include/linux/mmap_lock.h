@@ -6,9 +6,30 @@
 #define MMAP_LOCK_INITIALIZER(name) \
 	.mmap_lock = __RWSEM_INITIALIZER((name).mmap_lock),
 
+#ifdef CONFIG_PER_VMA_LOCK
+static inline void mm_lock_seq_init(struct mm_struct *mm)
+{
+	mm->mm_lock_seq = 0;
+}
+
+/*
+ * Drop the write marks of all VMAs of @mm; must be called before the
+ * mmap_lock write side is released or downgraded.
+ */
+static inline void vma_end_write_all(struct mm_struct *mm)
+{
+	/* Pairs with the READ_ONCE() in vma_start_read() */
+	WRITE_ONCE(mm->mm_lock_seq, mm->mm_lock_seq + 1);
+}
+#else
+static inline void mm_lock_seq_init(struct mm_struct *mm) {}
+static inline void vma_end_write_all(struct mm_struct *mm) {}
+#endif
+
 static inline void mmap_init_lock(struct mm_struct *mm)
 {
 	init_rwsem(&mm->mmap_lock);
+	mm_lock_seq_init(mm);
 }
 
 static inline void mmap_write_lock(struct mm_struct *mm)
@@ -33,11 +54,13 @@ static inline bool mmap_write_trylock(struct mm_struct *mm)
 
 static inline void mmap_write_unlock(struct mm_struct *mm)
 {
+	vma_end_write_all(mm);
 	up_write(&mm->mmap_lock);
 }
 
 static inline void mmap_write_downgrade(struct mm_struct *mm)
 {
+	vma_end_write_all(mm);
 	downgrade_write(&mm->mmap_lock);
 }
 
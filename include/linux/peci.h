@@ -7,6 +7,8 @@
 #include <linux/device.h>
 #include <linux/mutex.h>
 #include <linux/peci-ioctl.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 #define PECI_NAME_SIZE   32
 
@@ -28,6 +30,9 @@ struct peci_board_info {
  * @xfer: low-level transfer function pointer of the adapter
  * @cmd_mask: mask for supportable PECI commands
  * @use_dma: flag for indicating that adapter uses DMA
+ * @queue_lock: spinlock protecting @queue
+ * @queue: asynchronous requests waiting to be issued
+ * @queue_work: work item issuing queued requests back-to-back
  *
  * Each PECI adapter can communicate with one or more PECI client children.
  * These make a small bus, sharing a single wired PECI connection.
@@ -44,6 +49,33 @@ struct peci_adapter {
 					struct peci_xfer_msg *msg);
 	u32			cmd_mask;
 	bool			use_dma;
+	spinlock_t		queue_lock; /* protects queue */
+	struct list_head	queue;
+	struct work_struct	queue_work;
+};
+
+struct peci_request;
+
+/**
+ * struct peci_request - represent an asynchronous PECI command
+ * @cmd: PECI command to issue
+ * @vmsg: pointer to the PECI message, same format as for peci_command()
+ * @complete: called once @status and @vmsg have been filled in. Called from
+ *	process context without the adapter's bus_lock held, so it may sleep
+ *	and submit further requests.
+ * @context: private data for the submitter
+ * @status: zero on success, else a negative error code
+ * @node: entry in the adapter's request queue, owned by the PECI core
+ *
+ * The request and its message must stay valid until @complete is called.
+ */
+struct peci_request {
+	enum peci_cmd		cmd;
+	void			*vmsg;
+	void			(*complete)(struct peci_request *req);
+	void			*context;
+	int			status;
+	struct list_head	node;
 };
 
 static inline struct peci_adapter *to_peci_adapter(void *d)
@@ -145,6 +177,9 @@ int  peci_for_each_dev(void *data, int (*fn)(struct device *, void *));
 struct peci_xfer_msg *peci_get_xfer_msg(u8 tx_len, u8 rx_len);
 void peci_put_xfer_msg(struct peci_xfer_msg *msg);
 int  peci_command(struct peci_adapter *adpater, enum peci_cmd cmd, void *vmsg);
+int  peci_command_async(struct peci_adapter *adapter, struct peci_request *req);
+int  peci_command_batch(struct peci_adapter *adapter,
+			struct peci_request *reqs, uint num);
 int  peci_get_cpu_id(struct peci_adapter *adapter, u8 addr, u32 *cpu_id);
 
 #endif /* __LINUX_PECI_H */
@@ -79,6 +79,9 @@ struct psi_group_cpu {
 	/* Time of last task change in this group (rq_clock) */
 	u64 state_start;
 
+	/* Time spent in monitored states since the poller was last kicked */
+	u32 poll_pending;
+
 	/* 2nd cacheline updated by the aggregator */
 
 	/* Delta detection against the sampling buckets */
@@ -165,6 +168,8 @@ struct psi_group {
 	u32 nr_triggers[NR_PSI_STATES - 1];
 	u32 poll_states;
 	u64 poll_min_period;
+	/* Per-CPU monitored stall time that wakes the poller */
+	u32 poll_kick_threshold;
 
 	/* Total stall times at the start of monitor activation */
 	u64 polling_total[NR_PSI_STATES - 1];
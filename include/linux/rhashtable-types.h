@@ -77,6 +77,10 @@ struct rhashtable_params {
  * @mutex: Mutex to protect current/future table swapping
  * @lock: Spin lock to protect walker list
  * @nelems: Number of elements in table
+ * @rehashes: Number of completed rehashes, protected by @mutex
+ * @rehash_ns: Total time spent rehashing, protected by @mutex
+ * @rehash_max_ns: Longest rehash, protected by @mutex
+ * @insert_retries: Insertions retried while the table was resized
  */
 struct rhashtable {
 	struct bucket_table __rcu	*tbl;
@@ -88,6 +92,33 @@ struct rhashtable {
 	struct mutex                    mutex;
 	spinlock_t			lock;
 	atomic_t			nelems;
+	u64				rehashes;
+	u64				rehash_ns;
+	u64				rehash_max_ns;
+	atomic_long_t			insert_retries;
+};
+
+#define RHT_STATS_CHAIN_MAX	8
+
+/**
+ * struct rhashtable_stats - Hash table statistics
+ * @size: Number of buckets in the current table
+ * @nelems: Number of elements in table
+ * @rehashes: Number of completed rehashes
+ * @rehash_ns: Total time spent rehashing
+ * @rehash_max_ns: Longest rehash
+ * @insert_retries: Insertions retried while the table was resized
+ * @chain_hist: Number of buckets of the current table by chain length,
+ *	the last slot counting all chains of RHT_STATS_CHAIN_MAX or more
+ */
+struct rhashtable_stats {
+	unsigned int			size;
+	unsigned int			nelems;
+	u64				rehashes;
+	u64				rehash_ns;
+	u64				rehash_max_ns;
+	unsigned long			insert_retries;
+	unsigned long			chain_hist[RHT_STATS_CHAIN_MAX + 1];
 };
 
 /**
@@ -414,6 +414,22 @@ int __sbitmap_queue_get(struct sbitmap_queue *sbq);
 int __sbitmap_queue_get_shallow(struct sbitmap_queue *sbq,
 				unsigned int shallow_depth);
 
+/**
+ * __sbitmap_queue_get_batch() - Try to allocate a batch of free bits from a
+ * &struct sbitmap_queue with preemption already disabled.
+ * @sbq: Bitmap queue to allocate from.
+ * @nr_tags: Number of bits to try to allocate, at most BITS_PER_LONG - 1.
+ * @offset: Output parameter; bit number of the first bit of the batch.
+ *
+ * All bits come from a single word, starting at its first free bit. Not
+ * supported for round-robin bitmaps.
+ *
+ * Return: Mask of the allocated bits, relative to @offset, or 0 if none
+ * could be allocated.
+ */
+unsigned long __sbitmap_queue_get_batch(struct sbitmap_queue *sbq, int nr_tags,
+					unsigned int *offset);
+
 /**
  * sbitmap_queue_get() - Try to allocate a free bit from a &struct
  * sbitmap_queue.
@@ -487,6 +503,19 @@ void sbitmap_queue_min_shallow_depth(struct sbitmap_queue *sbq,
 void sbitmap_queue_clear(struct sbitmap_queue *sbq, unsigned int nr,
 			 unsigned int cpu);
 
+/**
+ * sbitmap_queue_clear_batch() - Free a batch of allocated bits from a
+ * &struct sbitmap_queue.
+ * @sbq: Bitmap queue to free from.
+ * @offset: Value to subtract from each entry of @tags to get a bit number.
+ * @tags: Bits to free, plus @offset.
+ * @nr_tags: Number of entries in @tags, at least one.
+ *
+ * Bits in the same word are cleared with a single atomic operation.
+ */
+void sbitmap_queue_clear_batch(struct sbitmap_queue *sbq, int offset,
+			       int *tags, int nr_tags);
+
 static inline int sbq_index_inc(int index)
 {
 	return (index + 1) & (SBQ_WAIT_QUEUES - 1);
@@ -23,6 +23,8 @@ extern const struct cpumask *housekeeping_cpumask(enum hk_flags flags);
 extern bool housekeeping_enabled(enum hk_flags flags);
 extern void housekeeping_affine(struct task_struct *t, enum hk_flags flags);
 extern bool housekeeping_test_cpu(int cpu, enum hk_flags flags);
+extern bool housekeeping_cpu_isolated(int cpu);
+extern int housekeeping_update_isolated(const struct cpumask *mask);
 extern void __init housekeeping_init(void);
 
 #else
@@ -45,6 +47,11 @@ static inline bool housekeeping_enabled(enum hk_flags flags)
 static inline void housekeeping_affine(struct task_struct *t,
 				       enum hk_flags flags) { }
 static inline void housekeeping_init(void) { }
+
+static inline int housekeeping_update_isolated(const struct cpumask *mask)
+{
+	return cpumask_empty(mask) ? 0 : -EOPNOTSUPP;
+}
 #endif /* CONFIG_CPU_ISOLATION */
 
 static inline bool housekeeping_cpu(int cpu, enum hk_flags flags)
@@ -56,4 +63,19 @@ static inline bool housekeeping_cpu(int cpu, enum hk_flags flags)
 	return true;
 }
 
+/*
+ * cpu_is_isolated - should per-CPU housekeeping work stay off @cpu
+ *
+ * True for CPUs outside the boot time domain or nohz_full housekeeping
+ * masks as well as for CPUs isolated at runtime through cpuset.
+ */
+static inline bool cpu_is_isolated(int cpu)
+{
+#ifdef CONFIG_CPU_ISOLATION
+	if (static_branch_unlikely(&housekeeping_overridden))
+		return housekeeping_cpu_isolated(cpu);
+#endif
+	return false;
+}
+
 #endif /* _LINUX_SCHED_ISOLATION_H */
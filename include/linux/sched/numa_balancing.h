@@ -7,7 +7,9 @@
  * implements memory access pattern based NUMA-balancing:
  */
 
+#include <linux/jump_label.h>
 #include <linux/sched.h>
+#include <linux/types.h>
 
 #define TNF_MIGRATED	0x01
 #define TNF_NO_GROUP	0x02
@@ -44,4 +46,32 @@ static inline bool should_numa_migrate_memory(struct task_struct *p,
 }
 #endif
 
+#ifdef CONFIG_NUMA_BALANCING_HW_SAMPLING
+DECLARE_STATIC_KEY_FALSE(numa_sample_key);
+
+extern void numa_sample_add(phys_addr_t paddr);
+extern void numa_sample_source_register(void);
+extern void numa_sample_source_unregister(void);
+
+/* Is a hardware sampling source standing in for the PROT_NONE scanner? */
+static inline bool numa_sample_active(void)
+{
+	return static_branch_unlikely(&numa_sample_key);
+}
+#else
+static inline void numa_sample_add(phys_addr_t paddr)
+{
+}
+static inline void numa_sample_source_register(void)
+{
+}
+static inline void numa_sample_source_unregister(void)
+{
+}
+static inline bool numa_sample_active(void)
+{
+	return false;
+}
+#endif
+
 #endif /* _LINUX_SCHED_NUMA_BALANCING_H */
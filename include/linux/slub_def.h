@@ -36,6 +36,10 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	ALLOC_CPU_ARRAY,	/* Allocation from cpu array */
+	FREE_CPU_ARRAY,		/* Free to cpu array */
+	CPU_ARRAY_REFILL,	/* Refill cpu array from slabs */
+	CPU_ARRAY_FLUSH,	/* Return cpu array objects to slabs */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
@@ -50,6 +54,16 @@ struct kmem_cache_cpu {
 #endif
 };
 
+/*
+ * Per cpu stack of free objects for caches created with SLAB_CPU_ARRAY.
+ * Objects in here are free as far as the debug and sanitizer hooks are
+ * concerned, but still counted as in use by their slabs.
+ */
+struct kmem_cache_array {
+	unsigned int count;
+	void *objects[];
+};
+
 #ifdef CONFIG_SLUB_CPU_PARTIAL
 #define slub_percpu_partial(c)		((c)->partial)
 
@@ -81,6 +95,8 @@ struct kmem_cache_order_objects {
  */
 struct kmem_cache {
 	struct kmem_cache_cpu __percpu *cpu_slab;
+	struct kmem_cache_array __percpu *cpu_array;
+	unsigned int cpu_array_size;	/* Capacity of each cpu array */
 	/* Used for retrieving partial slabs, etc. */
 	slab_flags_t flags;
 	unsigned long min_partial;
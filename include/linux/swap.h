@@ -360,7 +360,7 @@ extern void lru_cache_add_active_or_unevictable(struct page *page,
 extern unsigned long zone_reclaimable_pages(struct zone *zone);
 extern unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 					gfp_t gfp_mask, nodemask_t *mask);
-extern int __isolate_lru_page(struct page *page, isolate_mode_t mode);
+extern int __isolate_lru_page_prepare(struct page *page, isolate_mode_t mode);
 extern unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 						  unsigned long nr_pages,
 						  gfp_t gfp_mask,
@@ -392,8 +392,21 @@ extern void kswapd_stop(int nid);
 
 #include <linux/blk_types.h> /* for bio_end_io_t */
 
+/*
+ * Collects the reads of a swap readahead window, so that pages in
+ * adjacent swap slots are read with one bio instead of one bio each.
+ */
+struct swap_read_batch {
+	struct bio *bio;
+	struct block_device *bdev;
+	unsigned int nr_pages;		/* expected size of the window */
+};
+
 /* linux/mm/page_io.c */
 extern int swap_readpage(struct page *page, bool do_poll);
+extern int swap_readpage_batch(struct page *page,
+			       struct swap_read_batch *batch);
+extern void swap_read_batch_submit(struct swap_read_batch *batch);
 extern int swap_writepage(struct page *page, struct writeback_control *wbc);
 extern void end_swap_bio_write(struct bio *bio);
 extern int __swap_writepage(struct page *page, struct writeback_control *wbc,
@@ -69,6 +69,11 @@ struct udp_sock {
 #define UDPLITE_RECV_CC  0x4		/* set via udplite setsocktopt        */
 	__u8		 pcflag;        /* marks socket as UDP-Lite if > 0    */
 	__u8		 unused[3];
+	/*
+	 * Connected sockets only: node and hash in udp_table->hash4.
+	 */
+	struct hlist_node udp_hash4_node;
+	u32		 udp_hash4;
 	/*
 	 * For encapsulation sockets.
 	 */
@@ -131,7 +136,16 @@ static inline void udp_cmsg_recv(struct msghdr *msg, struct sock *sk,
 
 static inline bool udp_unexpected_gso(struct sock *sk, struct sk_buff *skb)
 {
-	return !udp_sk(sk)->gro_enabled && skb_is_gso(skb) &&
+	if (!skb_is_gso(skb))
+		return false;
+
+	/* fraglist GRO packets keep every segment's headers around and are
+	 * only meant for forwarding, no socket can consume them as is
+	 */
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_FRAGLIST)
+		return true;
+
+	return !udp_sk(sk)->gro_enabled &&
 	       skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4;
 }
 
@@ -53,6 +53,10 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		NUMA_HINT_FAULTS,
 		NUMA_HINT_FAULTS_LOCAL,
 		NUMA_PAGE_MIGRATE,
+#ifdef CONFIG_NUMA_BALANCING_HW_SAMPLING
+		NUMA_HW_SAMPLES,
+		NUMA_HW_SAMPLES_REMOTE,
+#endif
 #endif
 #ifdef CONFIG_MIGRATION
 		PGMIGRATE_SUCCESS, PGMIGRATE_FAIL,
@@ -41,6 +41,7 @@ struct notifier_block;		/* in notifier.h */
  * vfree_atomic().
  */
 #define VM_FLUSH_RESET_PERMS	0x00000100      /* Reset direct map and flush TLB on unmap */
+#define VM_ALLOW_HUGE_VMAP	0x00000200      /* Allow for PMD mappings, see vmalloc_huge() */
 
 /* bits [20..32] reserved for arch specific ioremap internals */
 
@@ -109,6 +110,7 @@ extern void *vzalloc_node(unsigned long size, int node);
 extern void *vmalloc_32(unsigned long size);
 extern void *vmalloc_32_user(unsigned long size);
 extern void *__vmalloc(unsigned long size, gfp_t gfp_mask);
+extern void *vmalloc_huge(unsigned long size, gfp_t gfp_mask);
 extern void *__vmalloc_node_range(unsigned long size, unsigned long align,
 			unsigned long start, unsigned long end, gfp_t gfp_mask,
 			pgprot_t prot, unsigned long vm_flags, int node,
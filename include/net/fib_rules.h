@@ -45,6 +45,8 @@ struct fib_rule {
 	struct rcu_head		rcu;
 };
 
+struct fib_rules_index;
+
 struct fib_lookup_arg {
 	void			*lookup_ptr;
 	const void		*lookup_data;
@@ -92,6 +94,7 @@ struct fib_rules_ops {
 	int			nlgroup;
 	const struct nla_policy	*policy;
 	struct list_head	rules_list;
+	struct fib_rules_index __rcu *index;
 	struct module		*owner;
 	struct net		*fro_net;
 	struct rcu_head		rcu;
@@ -89,6 +89,14 @@ enum flow_offload_tuple_dir {
 	FLOW_OFFLOAD_DIR_MAX = IP_CT_DIR_MAX
 };
 
+enum flow_offload_xmit_type {
+	FLOW_OFFLOAD_XMIT_NEIGH		= 0,	/* neigh_xmit() via dst_cache */
+	FLOW_OFFLOAD_XMIT_DIRECT,		/* dev_queue_xmit() via out */
+};
+
+/* VLAN tags, outermost first */
+#define NF_FLOW_TABLE_ENCAP_MAX		2
+
 struct flow_offload_tuple {
 	union {
 		struct in_addr		src_v4;
@@ -107,11 +115,24 @@ struct flow_offload_tuple {
 
 	u8				l3proto;
 	u8				l4proto;
+	struct {
+		u16			id;
+		__be16			proto;
+	} encap[NF_FLOW_TABLE_ENCAP_MAX];
+
+	/* All members above are keys for lookups, see flow_offload_hash(). */
 	u8				dir;
+	u8				xmit_type;
+	u8				encap_num;
 
 	u16				mtu;
 
 	struct dst_entry		*dst_cache;
+	struct {
+		int			ifidx;
+		u8			h_source[ETH_ALEN];
+		u8			h_dest[ETH_ALEN];
+	} out;
 };
 
 struct flow_offload_tuple_rhash {
@@ -155,6 +176,20 @@ static inline __s32 nf_flow_timeout_delta(unsigned int timeout)
 struct nf_flow_route {
 	struct {
 		struct dst_entry	*dst;
+		struct {
+			int		ifindex;
+			struct {
+				u16	id;
+				__be16	proto;
+			} encap[NF_FLOW_TABLE_ENCAP_MAX];
+			u8		num_encaps;
+		} in;
+		struct {
+			int		ifindex;
+			u8		h_source[ETH_ALEN];
+			u8		h_dest[ETH_ALEN];
+		} out;
+		enum flow_offload_xmit_type xmit_type;
 	} tuple[FLOW_OFFLOAD_DIR_MAX];
 };
 
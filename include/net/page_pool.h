@@ -152,6 +152,7 @@ struct page_pool *page_pool_create(const struct page_pool_params *params);
 void page_pool_destroy(struct page_pool *pool);
 void page_pool_use_xdp_mem(struct page_pool *pool, void (*disconnect)(void *));
 void page_pool_release_page(struct page_pool *pool, struct page *page);
+bool page_pool_return_skb_page(struct page *page);
 #else
 static inline void page_pool_destroy(struct page_pool *pool)
 {
@@ -189,9 +190,32 @@ static inline void page_pool_recycle_direct(struct page_pool *pool,
 	page_pool_put_full_page(pool, page, true);
 }
 
+/* page->dma_addr is an unsigned long, so on 32-bit architectures with
+ * 64-bit DMA the page aligned address is stored shifted by PAGE_SHIFT.
+ */
+#define PAGE_POOL_32BIT_ARCH_WITH_64BIT_DMA	\
+		(sizeof(dma_addr_t) > sizeof(unsigned long))
+
 static inline dma_addr_t page_pool_get_dma_addr(struct page *page)
 {
-	return page->dma_addr;
+	dma_addr_t ret = page->dma_addr;
+
+	if (PAGE_POOL_32BIT_ARCH_WITH_64BIT_DMA)
+		ret <<= PAGE_SHIFT;
+
+	return ret;
+}
+
+/* Returns true if @addr cannot be represented in page->dma_addr */
+static inline bool page_pool_set_dma_addr(struct page *page, dma_addr_t addr)
+{
+	if (PAGE_POOL_32BIT_ARCH_WITH_64BIT_DMA) {
+		page->dma_addr = addr >> PAGE_SHIFT;
+		return addr != (dma_addr_t)page->dma_addr << PAGE_SHIFT;
+	}
+
+	page->dma_addr = addr;
+	return false;
 }
 
 static inline bool is_page_pool_compiled_in(void)
@@ -156,11 +156,22 @@ struct fastopen_queue {
 	struct tcp_fastopen_context __rcu *ctx; /* cipher context for cookie */
 };
 
+/* Per-cpu FIFO of established children, used instead of the shared
+ * rskq_accept_head/tail list when net.ipv4.tcp_percpu_accept is set.
+ */
+struct request_sock_cpu_queue {
+	spinlock_t		lock;
+	struct request_sock	*head;
+	struct request_sock	*tail;
+};
+
 /** struct request_sock_queue - queue of request_socks
  *
  * @rskq_accept_head - FIFO head of established children
  * @rskq_accept_tail - FIFO tail of established children
  * @rskq_defer_accept - User waits for some data after accept()
+ * @rskq_percpu - per-cpu accept queues, or NULL
+ * @rskq_percpu_len - number of children in the per-cpu accept queues
  *
  */
 struct request_sock_queue {
@@ -176,15 +187,26 @@ struct request_sock_queue {
 	struct fastopen_queue	fastopenq;  /* Check max_qlen != 0 to determine
 					     * if TFO is enabled.
 					     */
+
+	struct request_sock_cpu_queue __percpu *rskq_percpu;
+	atomic_t		rskq_percpu_len;
 };
 
-void reqsk_queue_alloc(struct request_sock_queue *queue);
+void reqsk_queue_alloc(struct request_sock_queue *queue, bool percpu);
+void reqsk_queue_free(struct request_sock_queue *queue);
+void reqsk_queue_add_percpu(struct request_sock_queue *queue,
+			    struct request_sock *req, struct sock *parent);
+struct request_sock *reqsk_queue_remove_percpu(struct request_sock_queue *queue,
+					       struct sock *parent);
 
 void reqsk_fastopen_remove(struct sock *sk, struct request_sock *req,
 			   bool reset);
 
 static inline bool reqsk_queue_empty(const struct request_sock_queue *queue)
 {
+	if (queue->rskq_percpu)
+		return !atomic_read(&queue->rskq_percpu_len);
+
 	return READ_ONCE(queue->rskq_accept_head) == NULL;
 }
 
@@ -193,6 +215,9 @@ static inline struct request_sock *reqsk_queue_remove(struct request_sock_queue
 {
 	struct request_sock *req;
 
+	if (queue->rskq_percpu)
+		return reqsk_queue_remove_percpu(queue, parent);
+
 	spin_lock_bh(&queue->rskq_lock);
 	req = queue->rskq_accept_head;
 	if (req) {
@@ -139,6 +139,9 @@ struct tls_sw_context_tx {
 	spinlock_t encrypt_compl_lock;
 	int async_notify;
 	u8 async_capable:1;
+	/* encrypted records held back by sendmsg, see tls_tx_batch() */
+	u8 tx_batch:1;
+	u8 tx_batched;
 
 #define BIT_TX_SCHEDULED	0
 #define BIT_TX_CLOSING		1
@@ -153,6 +156,7 @@ struct tls_sw_context_rx {
 	void (*saved_data_ready)(struct sock *sk);
 
 	struct sk_buff *recv_pkt;
+	u8 tail;	/* TLS 1.3 content type of a zero-copy decrypt */
 	u8 control;
 	u8 async_capable:1;
 	u8 decrypted:1;
@@ -233,6 +237,7 @@ struct tls_context {
 
 	u8 tx_conf:3;
 	u8 rx_conf:3;
+	u8 rx_no_pad:1;	/* TLS 1.3: peer sends no padding, try zero-copy */
 
 	int (*push_pending_record)(struct sock *sk, int flags);
 	void (*sk_write_space)(struct sock *sk);
@@ -37,6 +37,10 @@ struct xdp_umem {
 	bool zc;
 	spinlock_t xsk_tx_list_lock;
 	struct list_head xsk_tx_list;
+	/* Owner of the pinned pages when this umem shares them with
+	 * another netdev or queue id, NULL for the original umem.
+	 */
+	struct xdp_umem *parent;
 };
 
 struct xsk_map {
@@ -73,6 +77,9 @@ struct xdp_sock {
 	struct list_head map_list;
 	/* Protects map_list */
 	spinlock_t map_list_lock;
+	/* Fill and completion rings, handed over to the umem on bind */
+	struct xsk_queue *fq_tmp;
+	struct xsk_queue *cq_tmp;
 };
 
 #ifdef CONFIG_XDP_SOCKETS
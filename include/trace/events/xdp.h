@@ -86,9 +86,10 @@ struct _bpf_dtab_netdev {
 };
 #endif /* __DEVMAP_OBJ_TYPE */
 
+/* tgt is NULL for broadcast redirects, which have no single target */
 #define devmap_ifindex(tgt, map)				\
 	(((map->map_type == BPF_MAP_TYPE_DEVMAP ||	\
-		  map->map_type == BPF_MAP_TYPE_DEVMAP_HASH)) ? \
+		  map->map_type == BPF_MAP_TYPE_DEVMAP_HASH)) && tgt ? \
 	  ((struct _bpf_dtab_netdev *)tgt)->dev->ifindex : 0)
 
 DECLARE_EVENT_CLASS(xdp_redirect_template,
@@ -51,6 +51,36 @@ struct aspeed_lpc_ctrl_mapping {
 	__u32	size;
 };
 
+/* Flash preload states */
+#define ASPEED_LPC_CTRL_PRELOAD_NONE	0
+#define ASPEED_LPC_CTRL_PRELOAD_RUNNING	1
+#define ASPEED_LPC_CTRL_PRELOAD_DONE	2
+#define ASPEED_LPC_CTRL_PRELOAD_FAILED	3
+
+/*
+ * When the device tree asks for it, the driver copies the host flash
+ * into the reserved memory region at probe time. Once the copy has
+ * completed, ASPEED_LPC_CTRL_IOCTL_MAP requests for the flash window that
+ * fall within the copied range are served from that memory instead. The
+ * device becomes readable (POLLIN) when the preload finishes.
+ *
+ * state: One of the ASPEED_LPC_CTRL_PRELOAD_* values.
+ *
+ * error: Negative errno if state is ASPEED_LPC_CTRL_PRELOAD_FAILED,
+ * zero otherwise.
+ *
+ * size: Number of bytes of flash copied into memory so far.
+ *
+ * reserved: Zeroed.
+ */
+
+struct aspeed_lpc_ctrl_preload {
+	__u32	state;
+	__s32	error;
+	__u32	size;
+	__u32	reserved;
+};
+
 #define __ASPEED_LPC_CTRL_IOCTL_MAGIC	0xb2
 
 #define ASPEED_LPC_CTRL_IOCTL_GET_SIZE	_IOWR(__ASPEED_LPC_CTRL_IOCTL_MAGIC, \
@@ -59,4 +89,7 @@ struct aspeed_lpc_ctrl_mapping {
 #define ASPEED_LPC_CTRL_IOCTL_MAP	_IOW(__ASPEED_LPC_CTRL_IOCTL_MAGIC, \
 		0x01, struct aspeed_lpc_ctrl_mapping)
 
+#define ASPEED_LPC_CTRL_IOCTL_GET_PRELOAD _IOR(__ASPEED_LPC_CTRL_IOCTL_MAGIC, \
+		0x02, struct aspeed_lpc_ctrl_preload)
+
 #endif /* _UAPI_LINUX_ASPEED_LPC_CTRL_H */
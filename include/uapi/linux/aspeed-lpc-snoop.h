@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0+ WITH Linux-syscall-note */
+/*
+ * Copyright 2020 Google Inc
+ *
+ * Layout of the timestamped POST code ring exported through mmap() on
+ * /dev/aspeed-lpc-snoopN.
+ */
+
+#ifndef _UAPI_LINUX_ASPEED_LPC_SNOOP_H
+#define _UAPI_LINUX_ASPEED_LPC_SNOOP_H
+
+#include <linux/types.h>
+
+#define ASPEED_LPC_SNOOP_RING_MAGIC	0x534e4f50	/* "SNOP" */
+
+/*
+ * aspeed_lpc_snoop_record
+ *
+ * timestamp: CLOCK_MONOTONIC time in ns at which the code was snooped
+ *
+ * code: POST code byte written by the host
+ */
+struct aspeed_lpc_snoop_record {
+	__u64 timestamp;
+	__u8 code;
+	__u8 reserved[7];
+};
+
+/*
+ * aspeed_lpc_snoop_ring
+ *
+ * The mapping starts with this header, followed by nr_records records
+ * (a power of two). The kernel never blocks on the ring: once full it
+ * overwrites the oldest record.
+ *
+ * magic: ASPEED_LPC_SNOOP_RING_MAGIC
+ *
+ * nr_records: number of records in the ring
+ *
+ * head: total number of records ever written; the latest record lives
+ *       at index (head - 1) % nr_records. Read head, then issue a read
+ *       barrier before reading records. A consumer that falls more than
+ *       nr_records behind has lost the difference.
+ *
+ * fifo_dropped: number of codes discarded from the read() FIFO because
+ *               no reader drained it in time
+ */
+struct aspeed_lpc_snoop_ring {
+	__u32 magic;
+	__u32 nr_records;
+	__u64 head;
+	__u64 fifo_dropped;
+	__u64 reserved;
+	struct aspeed_lpc_snoop_record records[];
+};
+
+#endif /* _UAPI_LINUX_ASPEED_LPC_SNOOP_H */
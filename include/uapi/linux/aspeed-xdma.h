@@ -9,6 +9,11 @@
 
 #define __ASPEED_XDMA_IOCTL_MAGIC	0xb7
 #define ASPEED_XDMA_IOCTL_RESET		_IO(__ASPEED_XDMA_IOCTL_MAGIC, 0)
+#define ASPEED_XDMA_IOCTL_SUBMIT	\
+	_IOW(__ASPEED_XDMA_IOCTL_MAGIC, 1, struct aspeed_xdma_batch)
+
+/* Maximum number of segments accepted by one ASPEED_XDMA_IOCTL_SUBMIT */
+#define ASPEED_XDMA_MAX_SEGMENTS	63
 
 /*
  * aspeed_xdma_direction
@@ -39,4 +44,43 @@ struct aspeed_xdma_op {
 	__u32 direction;
 };
 
+/*
+ * aspeed_xdma_segment
+ *
+ * host_addr: the DMA address on the host side
+ *
+ * len: the size of the segment in bytes
+ *
+ * bmc_offset: offset of the segment within the client's mmap'd BMC buffer
+ */
+struct aspeed_xdma_segment {
+	__u64 host_addr;
+	__u32 len;
+	__u32 bmc_offset;
+};
+
+/*
+ * aspeed_xdma_batch
+ *
+ * Queues all segments into the engine command ring at once; a single
+ * completion is signalled once the last one has been transferred.
+ *
+ * segments: user pointer to an array of struct aspeed_xdma_segment
+ *
+ * num_segments: number of entries in segments, at most
+ *               ASPEED_XDMA_MAX_SEGMENTS
+ *
+ * direction: direction shared by every segment; see
+ *            enum aspeed_xdma_direction
+ *
+ * eventfd: eventfd signalled on completion, or -1 to rely on poll() only
+ */
+struct aspeed_xdma_batch {
+	__u64 segments;
+	__u32 num_segments;
+	__u32 direction;
+	__s32 eventfd;
+	__u32 reserved;
+};
+
 #endif /* _UAPI_LINUX_ASPEED_XDMA_H_ */
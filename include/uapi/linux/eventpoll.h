@@ -18,6 +18,7 @@
 /* For O_CLOEXEC */
 #include <linux/fcntl.h>
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /* Flags for epoll_create1.  */
 #define EPOLL_CLOEXEC O_CLOEXEC
@@ -79,6 +80,46 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/*
+ * User ring: set up with EPIOCSETUPRING on an epoll instance that has no
+ * items yet, then mmap()ed from the epoll fd.  The mapping starts with the
+ * header and the item array (header_length bytes), followed by the index
+ * ring (index_length bytes, a power of two number of __u32 entries).
+ *
+ * Only EPOLLET items are accepted.  When an item becomes ready the kernel
+ * ORs the events into items[n].ready_events and, if they were zero, stores
+ * n + 1 into the index ring at tail and advances tail.  Userspace consumes
+ * an entry at head by waiting for it to become non-zero, zeroing it, then
+ * taking the events with an atomic exchange of ready_events against zero,
+ * and finally advancing head.  An item removed with EPOLL_CTL_DEL while
+ * still queued reports EPOLLREMOVED.  epoll_wait() may be called with a
+ * NULL event array, it then waits for the ring to be non-empty and returns
+ * the number of queued entries.
+ */
+#define EPOLL_USERPOLL_HEADER_MAGIC	0xeb01eb01
+#define EPOLL_USERPOLL_HEADER_SIZE	128
+
+#define EPOLLREMOVED	((__force __poll_t)(1U << 27))
+
+struct epoll_uitem {
+	__poll_t ready_events;
+	__poll_t events;
+	__u64 data;
+};
+
+struct epoll_uheader {
+	__u32 magic;		/* EPOLL_USERPOLL_HEADER_MAGIC */
+	__u32 header_length;	/* length of the header and items */
+	__u32 index_length;	/* length of the index ring */
+	__u32 max_items_nr;	/* number of items */
+	__u32 head;		/* updated by userspace */
+	__u32 tail;		/* updated by the kernel */
+	__u32 padding[26];	/* pad to EPOLL_USERPOLL_HEADER_SIZE */
+	struct epoll_uitem items[];
+};
+
+#define EPIOCSETUPRING	_IOW(0x8A, 0x10, __u32)
+
 #ifdef CONFIG_PM_SLEEP
 static inline void ep_take_care_of_epollwakeup(struct epoll_event *epev)
 {
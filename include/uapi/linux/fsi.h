@@ -55,4 +55,22 @@ struct scom_access {
 #define FSI_SCOM_WRITE	_IOWR('s', 0x02, struct scom_access)
 #define FSI_SCOM_RESET	_IOW('s', 0x03, __u32)
 
+/*
+ * /dev/sbefifo mmap interface
+ *
+ * Large chip-ops can be run without copying through read()/write(): mmap()
+ * a buffer from the device (offset 0), place the command in it and ring the
+ * doorbell. The response is written straight into the mapping. Offsets and
+ * lengths are in bytes and must be multiples of 4; the command and response
+ * areas may overlap since the command is fully sent first.
+ */
+struct sbefifo_doorbell {
+	__u32	cmd_offset;	/* Offset of the command in the mapping */
+	__u32	cmd_len;	/* Command length */
+	__u32	resp_offset;	/* Offset of the response in the mapping */
+	__u32	resp_len;	/* In: room for the response, out: its length */
+};
+
+#define FSI_SBEFIFO_DOORBELL	_IOWR('s', 0x10, struct sbefifo_doorbell)
+
 #endif /* _UAPI_LINUX_FSI_H */
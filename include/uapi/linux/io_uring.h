@@ -22,6 +22,10 @@ struct io_uring_sqe {
 	union {
 		__u64	off;	/* offset into file */
 		__u64	addr2;
+		struct {
+			__u32	cmd_op;
+			__u32	__pad1;
+		};
 	};
 	union {
 		__u64	addr;	/* pointer to buffer or iovecs */
@@ -41,6 +45,7 @@ struct io_uring_sqe {
 		__u32		statx_flags;
 		__u32		fadvise_advice;
 		__u32		splice_flags;
+		__u32		uring_cmd_flags;
 	};
 	__u64	user_data;	/* data to be passed back at completion time */
 	union {
@@ -54,7 +59,14 @@ struct io_uring_sqe {
 			} __attribute__((packed));
 			/* personality to use, if used */
 			__u16	personality;
-			__s32	splice_fd_in;
+			union {
+				__s32	splice_fd_in;
+				/*
+				 * openat/accept: install into fixed file
+				 * slot file_index - 1 instead of an fd
+				 */
+				__u32	file_index;
+			};
 		};
 		__u64	__pad2[3];
 	};
@@ -93,7 +105,7 @@ enum {
 #define IORING_SETUP_SQ_AFF	(1U << 2)	/* sq_thread_cpu is valid */
 #define IORING_SETUP_CQSIZE	(1U << 3)	/* app defines CQ size */
 #define IORING_SETUP_CLAMP	(1U << 4)	/* clamp SQ/CQ ring sizes */
-#define IORING_SETUP_ATTACH_WQ	(1U << 5)	/* attach to existing wq */
+#define IORING_SETUP_ATTACH_WQ	(1U << 5)	/* attach to existing wq and SQ thread */
 
 enum {
 	IORING_OP_NOP,
@@ -130,16 +142,50 @@ enum {
 	IORING_OP_PROVIDE_BUFFERS,
 	IORING_OP_REMOVE_BUFFERS,
 	IORING_OP_TEE,
+	IORING_OP_SEND_ZC,
+	IORING_OP_URING_CMD,
 
 	/* this goes last, obviously */
 	IORING_OP_LAST,
 };
 
+/*
+ * sqe->uring_cmd_flags
+ *
+ * IORING_URING_CMD_FIXED	Use the registered buffer at sqe->buf_index
+ *				for the data transfer of the command
+ *
+ * For IORING_OP_URING_CMD, sqe->addr points to the driver specific command
+ * and sqe->len is its size. The command is copied when the SQE is consumed,
+ * but drivers may write results back to it, so it must stay valid until the
+ * CQE has been posted.
+ */
+#define IORING_URING_CMD_FIXED	(1U << 0)
+
 /*
  * sqe->fsync_flags
  */
 #define IORING_FSYNC_DATASYNC	(1U << 0)
 
+/*
+ * POLL_ADD flags. Note that since sqe->poll_events is the flag space, the
+ * command flags for POLL_ADD are stored in sqe->len.
+ *
+ * IORING_POLL_ADD_MULTI	Multishot poll. Sets IORING_CQE_F_MORE if
+ *				the poll handler will continue to report
+ *				CQEs on behalf of the same SQE.
+ */
+#define IORING_POLL_ADD_MULTI	(1U << 0)
+
+/*
+ * ACCEPT flags, stored in sqe->ioprio
+ *
+ * IORING_ACCEPT_MULTISHOT	Post a CQE for every accepted connection,
+ *				with IORING_CQE_F_MORE set while the request
+ *				stays armed.
+ */
+#define IORING_ACCEPT_MULTISHOT	(1U << 0)
+
 /*
  * sqe->timeout_flags
  */
@@ -164,8 +210,21 @@ struct io_uring_cqe {
  * cqe->flags
  *
  * IORING_CQE_F_BUFFER	If set, the upper 16 bits are the buffer ID
+ * IORING_CQE_F_MORE	If set, parent SQE will generate more CQE entries
+ * IORING_CQE_F_NOTIF	Notification CQE of a zero-copy send, the buffer may
+ *			be reused
  */
 #define IORING_CQE_F_BUFFER		(1U << 0)
+#define IORING_CQE_F_MORE		(1U << 1)
+#define IORING_CQE_F_NOTIF		(1U << 2)
+
+/*
+ * cqe->res for IORING_CQE_F_NOTIF
+ *
+ * IORING_NOTIF_USAGE_ZC_COPIED	The data was copied rather than sent out
+ *				from the registered buffer
+ */
+#define IORING_NOTIF_USAGE_ZC_COPIED	(1U << 31)
 
 enum {
 	IORING_CQE_BUFFER_SHIFT		= 16,
@@ -264,6 +323,9 @@ struct io_uring_params {
 #define IORING_REGISTER_PROBE		8
 #define IORING_REGISTER_PERSONALITY	9
 #define IORING_UNREGISTER_PERSONALITY	10
+#define IORING_REGISTER_PBUF_RING	11
+#define IORING_UNREGISTER_PBUF_RING	12
+#define IORING_REGISTER_IOWQ_MAX_WORKERS	13
 
 struct io_uring_files_update {
 	__u32 offset;
@@ -271,6 +333,39 @@ struct io_uring_files_update {
 	__aligned_u64 /* __s32 * */ fds;
 };
 
+struct io_uring_buf {
+	__u64	addr;
+	__u32	len;
+	__u16	bid;
+	__u16	resv;
+};
+
+/*
+ * Ring of provided buffers, shared with the kernel. The application fills
+ * entries and publishes them by storing the new tail with release
+ * semantics. The tail overlays the resv field of the first entry.
+ */
+struct io_uring_buf_ring {
+	union {
+		struct {
+			__u64	resv1;
+			__u32	resv2;
+			__u16	resv3;
+			__u16	tail;
+		};
+		struct io_uring_buf	bufs[0];
+	};
+};
+
+/* argument for IORING_(UN)REGISTER_PBUF_RING */
+struct io_uring_buf_reg {
+	__u64	ring_addr;
+	__u32	ring_entries;
+	__u16	bgid;
+	__u16	pad;
+	__u64	resv[3];
+};
+
 #define IO_URING_OP_SUPPORTED	(1U << 0)
 
 struct io_uring_probe_op {
@@ -37,6 +37,14 @@
  * mode. This is bitmask for mode param in jtag_mode for ioctl JTAG_SIOCMODE
  */
 #define  JTAG_XFER_SW_MODE 0
+/*
+ * JTAG_XFER_HW_STREAM_MODE: JTAG hardware streaming mode. Or'ed with
+ * JTAG_XFER_HW_MODE, intermediate chunks of a long SIR/SDR shift are fed to
+ * the shift engine back to back and only the final chunk waits for
+ * completion. This is bitmask for mode param in jtag_mode for ioctl
+ * JTAG_SIOCMODE
+ */
+#define  JTAG_XFER_HW_STREAM_MODE 2
 
 /**
  * enum jtag_endstate:
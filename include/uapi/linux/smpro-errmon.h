@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0+ WITH Linux-syscall-note */
+/* Copyright (c) 2020, Ampere Computing LLC */
+
+#ifndef _UAPI_LINUX_SMPRO_ERRMON_H_
+#define _UAPI_LINUX_SMPRO_ERRMON_H_
+
+#include <linux/types.h>
+
+#define SMPRO_ERRMON_DATA_LEN		48
+
+/*
+ * smpro_errmon_type
+ *
+ * One entry per SMpro 48-byte RAS error queue, same order as the
+ * errors_* sysfs attributes.
+ */
+enum smpro_errmon_type {
+	SMPRO_ERRMON_CORE_CE = 0,
+	SMPRO_ERRMON_CORE_UE,
+	SMPRO_ERRMON_MEM_CE,
+	SMPRO_ERRMON_MEM_UE,
+	SMPRO_ERRMON_PCIE_CE,
+	SMPRO_ERRMON_PCIE_UE,
+	SMPRO_ERRMON_OTHER_CE,
+	SMPRO_ERRMON_OTHER_UE,
+};
+
+/*
+ * smpro_errmon_record
+ *
+ * Fixed-size record returned by read() on /dev/smpro-errmon. A read
+ * always returns a whole number of records.
+ *
+ * timestamp: CLOCK_MONOTONIC time in ns at which the record was fetched
+ *
+ * type: the error queue the record came from; see enum smpro_errmon_type
+ *
+ * len: number of valid bytes in data
+ *
+ * dropped: number of records discarded since the previous record because
+ *          the kernel buffer was full
+ *
+ * data: raw error data in the layout described in the Altra SoC BMC
+ *       Interface specification
+ */
+struct smpro_errmon_record {
+	__u64 timestamp;
+	__u8 type;
+	__u8 len;
+	__u16 dropped;
+	__u32 reserved;
+	__u8 data[SMPRO_ERRMON_DATA_LEN];
+};
+
+#endif /* _UAPI_LINUX_SMPRO_ERRMON_H_ */
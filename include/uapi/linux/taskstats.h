@@ -183,7 +183,9 @@ struct taskstats {
 
 enum {
 	TASKSTATS_CMD_UNSPEC = 0,	/* Reserved */
-	TASKSTATS_CMD_GET,		/* user->kernel request/get-response */
+	TASKSTATS_CMD_GET,		/* user->kernel request/get-response,
+					 * NLM_F_DUMP returns TASKSTATS_TYPE_AGGR_PID
+					 * for every task in the pid namespace */
 	TASKSTATS_CMD_NEW,		/* kernel->user event */
 	__TASKSTATS_CMD_MAX,
 };
@@ -27,7 +27,7 @@
 #include <linux/capability.h>
 #include <trace/events/xdp.h>
 
-#include <linux/netdevice.h>   /* netif_receive_skb_core */
+#include <linux/netdevice.h>   /* napi_gro_receive */
 #include <linux/etherdevice.h> /* eth_type_trans */
 
 /* General idea: XDP packets getting XDP redirected to another CPU,
@@ -64,6 +64,9 @@ struct bpf_cpu_map_entry {
 	struct task_struct *kthread;
 	struct work_struct kthread_stop_wq;
 
+	/* GRO context of the kthread, never scheduled as a real NAPI */
+	struct napi_struct napi;
+
 	atomic_t refcnt; /* Control when this struct can be free'ed */
 	struct rcu_head rcu;
 };
@@ -155,9 +158,11 @@ static struct sk_buff *cpu_map_build_skb(struct bpf_cpu_map_entry *rcpu,
 					 struct xdp_frame *xdpf,
 					 struct sk_buff *skb)
 {
+	struct skb_shared_info *sinfo = xdp_get_shared_info_from_frame(xdpf);
 	unsigned int hard_start_headroom;
 	unsigned int frame_size;
 	void *pkt_data_start;
+	u8 nr_frags;
 
 	/* Part of headroom was reserved to xdpf */
 	hard_start_headroom = sizeof(struct xdp_frame) +  xdpf->headroom;
@@ -167,6 +172,10 @@ static struct sk_buff *cpu_map_build_skb(struct bpf_cpu_map_entry *rcpu,
 	 */
 	frame_size = xdpf->frame_sz;
 
+	/* build_skb_around() resets nr_frags of the shared info */
+	if (unlikely(xdp_frame_has_frags(xdpf)))
+		nr_frags = sinfo->nr_frags;
+
 	pkt_data_start = xdpf->data - hard_start_headroom;
 	skb = build_skb_around(skb, pkt_data_start, frame_size);
 	if (unlikely(!skb))
@@ -177,6 +186,11 @@ static struct sk_buff *cpu_map_build_skb(struct bpf_cpu_map_entry *rcpu,
 	if (xdpf->metasize)
 		skb_metadata_set(skb, xdpf->metasize);
 
+	if (unlikely(xdp_frame_has_frags(xdpf)))
+		xdp_update_skb_shared_info(skb, nr_frags,
+					   sinfo->xdp_frags_size,
+					   nr_frags * xdpf->frame_sz);
+
 	/* Essential SKB info: protocol and skb->dev */
 	skb->protocol = eth_type_trans(skb, xdpf->dev_rx);
 
@@ -238,6 +252,7 @@ static int cpu_map_kthread_run(void *data)
 		void *frames[CPUMAP_BATCH];
 		void *skbs[CPUMAP_BATCH];
 		gfp_t gfp = __GFP_ZERO | GFP_ATOMIC;
+		bool empty;
 		int i, n, m;
 
 		/* Release CPU reschedule checks */
@@ -283,7 +298,6 @@ static int cpu_map_kthread_run(void *data)
 		for (i = 0; i < n; i++) {
 			struct xdp_frame *xdpf = frames[i];
 			struct sk_buff *skb = skbs[i];
-			int ret;
 
 			skb = cpu_map_build_skb(rcpu, xdpf, skb);
 			if (!skb) {
@@ -291,11 +305,19 @@ static int cpu_map_kthread_run(void *data)
 				continue;
 			}
 
-			/* Inject into network stack */
-			ret = netif_receive_skb_core(skb);
-			if (ret == NET_RX_DROP)
+			/* Inject into network stack, aggregating flows the
+			 * way the RX path of the receiving device would
+			 */
+			if (napi_gro_receive(&rcpu->napi, skb) == GRO_DROP)
 				drops++;
 		}
+
+		/* Keep packets that may still merge while more frames are
+		 * queued, but don't hold anything once the queue drained.
+		 */
+		empty = __ptr_ring_empty(rcpu->queue);
+		napi_gro_flush_normal(&rcpu->napi, !empty);
+
 		/* Feedback loop via tracepoint */
 		trace_xdp_cpumap_kthread(rcpu->map_id, n, drops, sched);
 
@@ -345,6 +367,7 @@ static struct bpf_cpu_map_entry *__cpu_map_entry_alloc(u32 qsize, u32 cpu,
 	rcpu->cpu    = cpu;
 	rcpu->map_id = map_id;
 	rcpu->qsize  = qsize;
+	napi_gro_init(&rcpu->napi);
 
 	/* Setup kthread */
 	rcpu->kthread = kthread_create_on_node(cpu_map_kthread_run, rcpu, numa,
@@ -512,6 +512,110 @@ int dev_map_enqueue(struct bpf_dtab_netdev *dst, struct xdp_buff *xdp,
 	return __xdp_enqueue(dev, xdp, dev_rx);
 }
 
+/* Iterate over the entries of a DEVMAP or DEVMAP_HASH, under RCU */
+static struct bpf_dtab_netdev *dev_map_next_dst(struct bpf_dtab *dtab,
+						struct bpf_dtab_netdev *dst,
+						u32 *pos)
+{
+	struct hlist_node *node = NULL;
+
+	if (dtab->map.map_type == BPF_MAP_TYPE_DEVMAP) {
+		while (*pos < dtab->map.max_entries) {
+			dst = READ_ONCE(dtab->netdev_map[(*pos)++]);
+			if (dst)
+				return dst;
+		}
+		return NULL;
+	}
+
+	if (dst)
+		node = rcu_dereference_raw(hlist_next_rcu(&dst->index_hlist));
+	while (!node && *pos < dtab->n_buckets)
+		node = rcu_dereference_raw(hlist_first_rcu(dev_map_index_hash(dtab,
+								(*pos)++)));
+
+	return hlist_entry_safe(node, struct bpf_dtab_netdev, index_hlist);
+}
+
+#define dev_map_for_each_dst(dtab, dst, pos)				\
+	for (pos = 0, dst = dev_map_next_dst(dtab, NULL, &pos); dst;	\
+	     dst = dev_map_next_dst(dtab, dst, &pos))
+
+static bool is_valid_dst(struct bpf_dtab_netdev *dst, unsigned int len,
+			 int exclude_ifindex)
+{
+	if (dst->dev->ifindex == exclude_ifindex)
+		return false;
+
+	if (!dst->dev->netdev_ops->ndo_xdp_xmit)
+		return false;
+
+	return !xdp_ok_fwd_dev(dst->dev, len);
+}
+
+/* Hand one copy of a broadcast frame to @dst, running its devmap program
+ * first if it has one.
+ */
+static void dev_map_enqueue_frame(struct bpf_dtab_netdev *dst,
+				  struct xdp_frame *xdpf,
+				  struct net_device *dev_rx)
+{
+	struct xdp_rxq_info rxq = { .dev = dev_rx, .mem = xdpf->mem };
+	struct xdp_buff xdp, *res;
+
+	if (dst->xdp_prog) {
+		xdp_convert_frame_to_buff(xdpf, &xdp);
+		xdp.rxq = &rxq;
+		res = dev_map_run_prog(dst->dev, &xdp, dst->xdp_prog);
+		if (!res)
+			return;
+		xdpf = xdp_convert_buff_to_frame(res);
+		if (unlikely(!xdpf)) {
+			xdp_return_buff(res);
+			return;
+		}
+	}
+
+	bq_enqueue(dst->dev, xdpf, dev_rx);
+}
+
+int dev_map_enqueue_multi(struct xdp_buff *xdp, struct net_device *dev_rx,
+			  struct bpf_map *map, bool exclude_ingress)
+{
+	struct bpf_dtab *dtab = container_of(map, struct bpf_dtab, map);
+	int exclude_ifindex = exclude_ingress ? dev_rx->ifindex : 0;
+	struct bpf_dtab_netdev *dst, *last_dst = NULL;
+	unsigned int len = xdp->data_end - xdp->data;
+	struct xdp_frame *xdpf, *nxdpf;
+	u32 pos;
+
+	xdpf = xdp_convert_buff_to_frame(xdp);
+	if (unlikely(!xdpf))
+		return -EOVERFLOW;
+
+	dev_map_for_each_dst(dtab, dst, pos) {
+		if (!is_valid_dst(dst, len, exclude_ifindex))
+			continue;
+
+		/* only n-1 clones are needed, the last device gets xdpf */
+		if (last_dst) {
+			/* on error the driver still owns and frees xdpf */
+			nxdpf = xdpf_clone(xdpf);
+			if (unlikely(!nxdpf))
+				return -ENOMEM;
+			dev_map_enqueue_frame(last_dst, nxdpf, dev_rx);
+		}
+		last_dst = dst;
+	}
+
+	if (last_dst)
+		dev_map_enqueue_frame(last_dst, xdpf, dev_rx);
+	else
+		xdp_return_frame_rx_napi(xdpf);
+
+	return 0;
+}
+
 int dev_map_generic_redirect(struct bpf_dtab_netdev *dst, struct sk_buff *skb,
 			     struct bpf_prog *xdp_prog)
 {
@@ -526,6 +630,43 @@ int dev_map_generic_redirect(struct bpf_dtab_netdev *dst, struct sk_buff *skb,
 	return 0;
 }
 
+int dev_map_redirect_multi(struct net_device *dev, struct sk_buff *skb,
+			   struct bpf_prog *xdp_prog, struct bpf_map *map,
+			   bool exclude_ingress)
+{
+	struct bpf_dtab *dtab = container_of(map, struct bpf_dtab, map);
+	int exclude_ifindex = exclude_ingress ? dev->ifindex : 0;
+	struct bpf_dtab_netdev *dst, *last_dst = NULL;
+	struct sk_buff *nskb;
+	u32 pos;
+	int err;
+
+	dev_map_for_each_dst(dtab, dst, pos) {
+		if (dst->dev->ifindex == exclude_ifindex ||
+		    xdp_ok_fwd_dev(dst->dev, skb->len))
+			continue;
+
+		if (last_dst) {
+			nskb = skb_clone(skb, GFP_ATOMIC);
+			if (unlikely(!nskb))
+				return -ENOMEM;
+			err = dev_map_generic_redirect(last_dst, nskb, xdp_prog);
+			if (unlikely(err)) {
+				kfree_skb(nskb);
+				return err;
+			}
+		}
+		last_dst = dst;
+	}
+
+	if (!last_dst) {
+		consume_skb(skb);
+		return 0;
+	}
+
+	return dev_map_generic_redirect(last_dst, skb, xdp_prog);
+}
+
 static void *dev_map_lookup_elem(struct bpf_map *map, void *key)
 {
 	struct bpf_dtab_netdev *obj = __dev_map_lookup_elem(map, *(u32 *)key);
@@ -85,6 +85,13 @@ struct bucket {
 	};
 };
 
+/* Preallocated elements living on one NUMA node, see prealloc_init() */
+struct htab_node_pool {
+	void *elems;
+	u32 nr_elems;
+	struct pcpu_freelist freelist;
+};
+
 struct bpf_htab {
 	struct bpf_map map;
 	struct bucket *buckets;
@@ -93,6 +100,7 @@ struct bpf_htab {
 		struct pcpu_freelist freelist;
 		struct bpf_lru lru;
 	};
+	struct htab_node_pool *node_pools;	/* indexed by node id */
 	struct htab_elem *__percpu *extra_elems;
 	atomic_t count;	/* number of elements in this hashtable */
 	u32 n_buckets;	/* number of hash buckets */
@@ -246,6 +254,132 @@ static struct htab_elem *prealloc_lru_pop(struct bpf_htab *htab, void *key,
 	return NULL;
 }
 
+/*
+ * A plain preallocated map that was not bound to a node gets one pool of
+ * elements per node, sized by the number of CPUs there.  Each pool is
+ * allocated on its node and handed out to the CPUs of that node first,
+ * and freed elements return to the pool they came from.  An element is
+ * then usually local to the CPU that inserted it, which in the common
+ * case of RSS steered flows is also the CPU that looks it up.
+ */
+static bool htab_use_node_pools(const struct bpf_htab *htab)
+{
+	return !htab_is_percpu(htab) && !htab_is_lru(htab) &&
+	       htab->map.numa_node == NUMA_NO_NODE &&
+	       num_possible_nodes() > 1;
+}
+
+static u32 htab_node_cpus(int nid)
+{
+	u32 nr = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (cpu_to_node(cpu) == nid)
+			nr++;
+	return nr;
+}
+
+static void htab_free_node_pools(struct bpf_htab *htab)
+{
+	int nid;
+
+	for_each_node(nid) {
+		struct htab_node_pool *pool = &htab->node_pools[nid];
+
+		bpf_map_area_free(pool->elems);
+		pcpu_freelist_destroy(&pool->freelist);
+	}
+	kfree(htab->node_pools);
+	htab->node_pools = NULL;
+}
+
+static int prealloc_init_node_pools(struct bpf_htab *htab, u32 num_entries)
+{
+	u32 nr_cpus = num_possible_cpus(), done = 0;
+	int nid;
+
+	htab->node_pools = kcalloc(nr_node_ids, sizeof(*htab->node_pools),
+				   GFP_USER | __GFP_NOWARN);
+	if (!htab->node_pools)
+		return -ENOMEM;
+
+	for_each_node(nid) {
+		struct htab_node_pool *pool = &htab->node_pools[nid];
+		u32 nr;
+
+		nr = DIV_ROUND_UP_ULL((u64)num_entries * htab_node_cpus(nid),
+				      nr_cpus);
+		nr = min(nr, num_entries - done);
+		if (!nr)
+			continue;
+
+		pool->elems = bpf_map_area_alloc((u64)htab->elem_size * nr, nid);
+		if (!pool->elems || pcpu_freelist_init(&pool->freelist))
+			goto free_pools;
+		pcpu_freelist_populate_node(&pool->freelist, nid,
+					    pool->elems +
+					    offsetof(struct htab_elem, fnode),
+					    htab->elem_size, nr);
+		pool->nr_elems = nr;
+		done += nr;
+		cond_resched();
+	}
+
+	return 0;
+
+free_pools:
+	htab_free_node_pools(htab);
+	return -ENOMEM;
+}
+
+static struct htab_elem *__htab_freelist_pop(struct bpf_htab *htab)
+{
+	struct pcpu_freelist_node *l;
+	int nid, start;
+
+	if (!htab->node_pools) {
+		l = __pcpu_freelist_pop(&htab->freelist);
+		goto out;
+	}
+
+	start = nid = numa_node_id();
+	do {
+		struct htab_node_pool *pool = &htab->node_pools[nid];
+
+		if (pool->nr_elems) {
+			l = __pcpu_freelist_pop(&pool->freelist);
+			if (l)
+				goto out;
+		}
+		nid = next_node_in(nid, node_possible_map);
+	} while (nid != start);
+	return NULL;
+out:
+	return l ? container_of(l, struct htab_elem, fnode) : NULL;
+}
+
+static void __htab_freelist_push(struct bpf_htab *htab, struct htab_elem *l)
+{
+	int nid;
+
+	if (!htab->node_pools) {
+		__pcpu_freelist_push(&htab->freelist, &l->fnode);
+		return;
+	}
+
+	for_each_node(nid) {
+		struct htab_node_pool *pool = &htab->node_pools[nid];
+		void *end = pool->elems + (u64)pool->nr_elems * htab->elem_size;
+
+		if ((void *)l >= pool->elems && (void *)l < end) {
+			__pcpu_freelist_push(&pool->freelist, &l->fnode);
+			return;
+		}
+	}
+	WARN_ON_ONCE(1);
+}
+
 static int prealloc_init(struct bpf_htab *htab)
 {
 	u32 num_entries = htab->map.max_entries;
@@ -254,6 +388,9 @@ static int prealloc_init(struct bpf_htab *htab)
 	if (!htab_is_percpu(htab) && !htab_is_lru(htab))
 		num_entries += num_possible_cpus();
 
+	if (htab_use_node_pools(htab))
+		return prealloc_init_node_pools(htab, num_entries);
+
 	htab->elems = bpf_map_area_alloc(htab->elem_size * num_entries,
 					 htab->map.numa_node);
 	if (!htab->elems)
@@ -306,6 +443,11 @@ static int prealloc_init(struct bpf_htab *htab)
 
 static void prealloc_destroy(struct bpf_htab *htab)
 {
+	if (htab->node_pools) {
+		htab_free_node_pools(htab);
+		return;
+	}
+
 	htab_free_elems(htab);
 
 	if (htab_is_lru(htab))
@@ -317,7 +459,7 @@ static void prealloc_destroy(struct bpf_htab *htab)
 static int alloc_extra_elems(struct bpf_htab *htab)
 {
 	struct htab_elem *__percpu *pptr, *l_new;
-	struct pcpu_freelist_node *l;
+	unsigned long flags;
 	int cpu;
 
 	pptr = __alloc_percpu_gfp(sizeof(struct htab_elem *), 8,
@@ -326,11 +468,12 @@ static int alloc_extra_elems(struct bpf_htab *htab)
 		return -ENOMEM;
 
 	for_each_possible_cpu(cpu) {
-		l = pcpu_freelist_pop(&htab->freelist);
+		local_irq_save(flags);
+		l_new = __htab_freelist_pop(htab);
+		local_irq_restore(flags);
 		/* pop will succeed, since prealloc_init()
 		 * preallocated extra num_possible_cpus elements
 		 */
-		l_new = container_of(l, struct htab_elem, fnode);
 		*per_cpu_ptr(pptr, cpu) = l_new;
 	}
 	htab->extra_elems = pptr;
@@ -795,7 +938,7 @@ static void free_htab_elem(struct bpf_htab *htab, struct htab_elem *l)
 	htab_put_fd_value(htab, l);
 
 	if (htab_is_prealloc(htab)) {
-		__pcpu_freelist_push(&htab->freelist, &l->fnode);
+		__htab_freelist_push(htab, l);
 	} else {
 		atomic_dec(&htab->count);
 		l->htab = htab;
@@ -847,12 +990,9 @@ static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
 			htab_put_fd_value(htab, old_elem);
 			*pl_new = old_elem;
 		} else {
-			struct pcpu_freelist_node *l;
-
-			l = __pcpu_freelist_pop(&htab->freelist);
-			if (!l)
+			l_new = __htab_freelist_pop(htab);
+			if (!l_new)
 				return ERR_PTR(-E2BIG);
-			l_new = container_of(l, struct htab_elem, fnode);
 		}
 	} else {
 		if (atomic_inc_return(&htab->count) > htab->map.max_entries)
@@ -100,24 +100,45 @@ void pcpu_freelist_push(struct pcpu_freelist *s,
 
 void pcpu_freelist_populate(struct pcpu_freelist *s, void *buf, u32 elem_size,
 			    u32 nr_elems)
+{
+	pcpu_freelist_populate_node(s, NUMA_NO_NODE, buf, elem_size, nr_elems);
+}
+
+static bool pcpu_freelist_cpu_on_node(int cpu, int nid)
+{
+	return nid == NUMA_NO_NODE || cpu_to_node(cpu) == nid;
+}
+
+/* Spread the elements over the lists of the CPUs of @nid only */
+void pcpu_freelist_populate_node(struct pcpu_freelist *s, int nid, void *buf,
+				 u32 elem_size, u32 nr_elems)
 {
 	struct pcpu_freelist_head *head;
-	int i, cpu, pcpu_entries;
+	int i, cpu, pcpu_entries, nr_cpus = 0;
+
+	for_each_possible_cpu(cpu)
+		if (pcpu_freelist_cpu_on_node(cpu, nid))
+			nr_cpus++;
+	if (!nr_cpus) {
+		nid = NUMA_NO_NODE;
+		nr_cpus = num_possible_cpus();
+	}
 
-	pcpu_entries = nr_elems / num_possible_cpus() + 1;
+	pcpu_entries = nr_elems / nr_cpus + 1;
 	i = 0;
 
 	for_each_possible_cpu(cpu) {
-again:
+		if (!pcpu_freelist_cpu_on_node(cpu, nid))
+			continue;
 		head = per_cpu_ptr(s->freelist, cpu);
-		/* No locking required as this is not visible yet. */
-		pcpu_freelist_push_node(head, buf);
-		i++;
-		buf += elem_size;
-		if (i == nr_elems)
-			break;
-		if (i % pcpu_entries)
-			goto again;
+		do {
+			if (i == nr_elems)
+				return;
+			/* No locking required as this is not visible yet. */
+			pcpu_freelist_push_node(head, buf);
+			i++;
+			buf += elem_size;
+		} while (i % pcpu_entries);
 	}
 }
 
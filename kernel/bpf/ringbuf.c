@@ -10,7 +10,7 @@
 #include <linux/poll.h>
 #include <uapi/linux/btf.h>
 
-#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE)
+#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE | BPF_F_RINGBUF_PERCPU)
 
 /* non-mmap()'able part of bpf_ringbuf (everything up to consumer page) */
 #define RINGBUF_PGOFF \
@@ -29,12 +29,16 @@
 #define RINGBUF_MAX_DATA_SZ \
 	(((1ULL << 24) - RINGBUF_POS_PAGES - RINGBUF_PGOFF) * PAGE_SIZE)
 
+struct bpf_ringbuf_map;
+
 struct bpf_ringbuf {
 	wait_queue_head_t waitq;
 	struct irq_work work;
 	u64 mask;
 	struct page **pages;
 	int nr_pages;
+	/* map owning this ring, set only for per-CPU ring buffers */
+	struct bpf_ringbuf_map *owner;
 	spinlock_t spinlock ____cacheline_aligned_in_smp;
 	/* Consumer and producer counters are put into separate pages to allow
 	 * mapping consumer page as r/w, but restrict producer page to r/o.
@@ -46,10 +50,19 @@ struct bpf_ringbuf {
 	char data[] __aligned(PAGE_SIZE);
 };
 
+/* With BPF_F_RINGBUF_PERCPU every possible CPU gets its own ring, so
+ * producers on different CPUs never share a spinlock or a producer
+ * position. The rings are mmap()'ed back to back through the single map
+ * fd, in possible CPU order, and all of them wake up the same waitq so
+ * that one poll()/epoll registration covers the whole map.
+ */
 struct bpf_ringbuf_map {
 	struct bpf_map map;
 	struct bpf_map_memory memory;
 	struct bpf_ringbuf *rb;
+	struct bpf_ringbuf **percpu_rb;
+	wait_queue_head_t waitq;
+	unsigned long wakeup_pending;
 };
 
 /* 8-byte ring buffer record header structure */
@@ -124,8 +137,20 @@ static struct bpf_ringbuf *bpf_ringbuf_area_alloc(size_t data_sz, int numa_node)
 static void bpf_ringbuf_notify(struct irq_work *work)
 {
 	struct bpf_ringbuf *rb = container_of(work, struct bpf_ringbuf, work);
+	struct bpf_ringbuf_map *rb_map = rb->owner;
 
-	wake_up_all(&rb->waitq);
+	if (!rb_map) {
+		wake_up_all(&rb->waitq);
+		return;
+	}
+
+	/* clear the bit before waking up the consumer, so that a record
+	 * committed after the consumer has looked at its ring queues a new
+	 * wakeup instead of relying on this one
+	 */
+	clear_bit(0, &rb_map->wakeup_pending);
+	smp_mb__after_atomic();
+	wake_up_all(&rb_map->waitq);
 }
 
 static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
@@ -147,6 +172,59 @@ static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
 	return rb;
 }
 
+static void bpf_ringbuf_free(struct bpf_ringbuf *rb)
+{
+	/* copy pages pointer and nr_pages to local variable, as we are going
+	 * to unmap rb itself with vunmap() below
+	 */
+	struct page **pages = rb->pages;
+	int i, nr_pages = rb->nr_pages;
+
+	vunmap(rb);
+	for (i = 0; i < nr_pages; i++)
+		__free_page(pages[i]);
+	kvfree(pages);
+}
+
+static void ringbuf_map_free_percpu(struct bpf_ringbuf_map *rb_map)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (rb_map->percpu_rb[cpu])
+			bpf_ringbuf_free(rb_map->percpu_rb[cpu]);
+	kvfree(rb_map->percpu_rb);
+}
+
+static int ringbuf_map_alloc_percpu(struct bpf_ringbuf_map *rb_map)
+{
+	struct bpf_ringbuf *rb;
+	int cpu, node;
+
+	rb_map->percpu_rb = kvcalloc(nr_cpu_ids, sizeof(*rb_map->percpu_rb),
+				     GFP_USER);
+	if (!rb_map->percpu_rb)
+		return -ENOMEM;
+
+	init_waitqueue_head(&rb_map->waitq);
+
+	for_each_possible_cpu(cpu) {
+		node = rb_map->map.numa_node;
+		if (node == NUMA_NO_NODE)
+			node = cpu_to_node(cpu);
+
+		rb = bpf_ringbuf_alloc(rb_map->map.max_entries, node);
+		if (IS_ERR(rb)) {
+			ringbuf_map_free_percpu(rb_map);
+			return PTR_ERR(rb);
+		}
+		rb->owner = rb_map;
+		rb_map->percpu_rb[cpu] = rb;
+	}
+
+	return 0;
+}
+
 static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 {
 	struct bpf_ringbuf_map *rb_map;
@@ -173,13 +251,22 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 
 	bpf_map_init_from_attr(&rb_map->map, attr);
 
-	cost = sizeof(struct bpf_ringbuf_map) +
-	       sizeof(struct bpf_ringbuf) +
-	       attr->max_entries;
+	cost = sizeof(struct bpf_ringbuf) + attr->max_entries;
+	if (attr->map_flags & BPF_F_RINGBUF_PERCPU)
+		cost = cost * num_possible_cpus() +
+		       nr_cpu_ids * sizeof(*rb_map->percpu_rb);
+	cost += sizeof(struct bpf_ringbuf_map);
 	err = bpf_map_charge_init(&rb_map->map.memory, cost);
 	if (err)
 		goto err_free_map;
 
+	if (attr->map_flags & BPF_F_RINGBUF_PERCPU) {
+		err = ringbuf_map_alloc_percpu(rb_map);
+		if (err)
+			goto err_uncharge;
+		return &rb_map->map;
+	}
+
 	rb_map->rb = bpf_ringbuf_alloc(attr->max_entries, rb_map->map.numa_node);
 	if (IS_ERR(rb_map->rb)) {
 		err = PTR_ERR(rb_map->rb);
@@ -195,20 +282,6 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 	return ERR_PTR(err);
 }
 
-static void bpf_ringbuf_free(struct bpf_ringbuf *rb)
-{
-	/* copy pages pointer and nr_pages to local variable, as we are going
-	 * to unmap rb itself with vunmap() below
-	 */
-	struct page **pages = rb->pages;
-	int i, nr_pages = rb->nr_pages;
-
-	vunmap(rb);
-	for (i = 0; i < nr_pages; i++)
-		__free_page(pages[i]);
-	kvfree(pages);
-}
-
 static void ringbuf_map_free(struct bpf_map *map)
 {
 	struct bpf_ringbuf_map *rb_map;
@@ -221,7 +294,10 @@ static void ringbuf_map_free(struct bpf_map *map)
 	synchronize_rcu();
 
 	rb_map = container_of(map, struct bpf_ringbuf_map, map);
-	bpf_ringbuf_free(rb_map->rb);
+	if (rb_map->percpu_rb)
+		ringbuf_map_free_percpu(rb_map);
+	else
+		bpf_ringbuf_free(rb_map->rb);
 	kfree(rb_map);
 }
 
@@ -255,19 +331,45 @@ static size_t bpf_ringbuf_mmap_page_cnt(const struct bpf_ringbuf *rb)
 	return RINGBUF_POS_PAGES + 2 * data_pages;
 }
 
+/* In per-CPU mode the n-th possible CPU's ring starts at page offset
+ * n * bpf_ringbuf_mmap_page_cnt(), and a single mmap() can't span rings.
+ */
+static struct bpf_ringbuf *
+ringbuf_map_mmap_ring(struct bpf_ringbuf_map *rb_map, unsigned long *pgoff)
+{
+	unsigned long idx, page_cnt;
+	int cpu;
+
+	if (!rb_map->percpu_rb)
+		return rb_map->rb;
+
+	page_cnt = bpf_ringbuf_mmap_page_cnt(rb_map->percpu_rb[0]);
+	idx = *pgoff / page_cnt;
+	*pgoff -= idx * page_cnt;
+
+	for_each_possible_cpu(cpu)
+		if (!idx--)
+			return rb_map->percpu_rb[cpu];
+	return NULL;
+}
+
 static int ringbuf_map_mmap(struct bpf_map *map, struct vm_area_struct *vma)
 {
 	struct bpf_ringbuf_map *rb_map;
+	unsigned long pgoff = vma->vm_pgoff;
+	struct bpf_ringbuf *rb;
 	size_t mmap_sz;
 
 	rb_map = container_of(map, struct bpf_ringbuf_map, map);
-	mmap_sz = bpf_ringbuf_mmap_page_cnt(rb_map->rb) << PAGE_SHIFT;
+	rb = ringbuf_map_mmap_ring(rb_map, &pgoff);
+	if (!rb)
+		return -EINVAL;
+	mmap_sz = bpf_ringbuf_mmap_page_cnt(rb) << PAGE_SHIFT;
 
-	if (vma->vm_pgoff * PAGE_SIZE + (vma->vm_end - vma->vm_start) > mmap_sz)
+	if (pgoff * PAGE_SIZE + (vma->vm_end - vma->vm_start) > mmap_sz)
 		return -EINVAL;
 
-	return remap_vmalloc_range(vma, rb_map->rb,
-				   vma->vm_pgoff + RINGBUF_PGOFF);
+	return remap_vmalloc_range(vma, rb, pgoff + RINGBUF_PGOFF);
 }
 
 static unsigned long ringbuf_avail_data_sz(struct bpf_ringbuf *rb)
@@ -279,15 +381,31 @@ static unsigned long ringbuf_avail_data_sz(struct bpf_ringbuf *rb)
 	return prod_pos - cons_pos;
 }
 
+static bool ringbuf_map_has_data(struct bpf_ringbuf_map *rb_map)
+{
+	int cpu;
+
+	if (!rb_map->percpu_rb)
+		return ringbuf_avail_data_sz(rb_map->rb);
+
+	for_each_possible_cpu(cpu)
+		if (ringbuf_avail_data_sz(rb_map->percpu_rb[cpu]))
+			return true;
+	return false;
+}
+
 static __poll_t ringbuf_map_poll(struct bpf_map *map, struct file *filp,
 				 struct poll_table_struct *pts)
 {
 	struct bpf_ringbuf_map *rb_map;
 
 	rb_map = container_of(map, struct bpf_ringbuf_map, map);
-	poll_wait(filp, &rb_map->rb->waitq, pts);
+	if (rb_map->percpu_rb)
+		poll_wait(filp, &rb_map->waitq, pts);
+	else
+		poll_wait(filp, &rb_map->rb->waitq, pts);
 
-	if (ringbuf_avail_data_sz(rb_map->rb))
+	if (ringbuf_map_has_data(rb_map))
 		return EPOLLIN | EPOLLRDNORM;
 	return 0;
 }
@@ -327,6 +445,19 @@ bpf_ringbuf_restore_from_rec(struct bpf_ringbuf_hdr *hdr)
 	return (void*)((addr & PAGE_MASK) - off);
 }
 
+/* Ring a BPF program running on this CPU produces into. Programs may
+ * migrate, but any ring is fine to use as each one has its own lock.
+ */
+static struct bpf_ringbuf *bpf_ringbuf_map_rb(struct bpf_map *map)
+{
+	struct bpf_ringbuf_map *rb_map;
+
+	rb_map = container_of(map, struct bpf_ringbuf_map, map);
+	if (rb_map->percpu_rb)
+		return rb_map->percpu_rb[raw_smp_processor_id()];
+	return rb_map->rb;
+}
+
 static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 {
 	unsigned long cons_pos, prod_pos, new_prod_pos, flags;
@@ -372,13 +503,11 @@ static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 
 BPF_CALL_3(bpf_ringbuf_reserve, struct bpf_map *, map, u64, size, u64, flags)
 {
-	struct bpf_ringbuf_map *rb_map;
-
 	if (unlikely(flags))
 		return 0;
 
-	rb_map = container_of(map, struct bpf_ringbuf_map, map);
-	return (unsigned long)__bpf_ringbuf_reserve(rb_map->rb, size);
+	return (unsigned long)__bpf_ringbuf_reserve(bpf_ringbuf_map_rb(map),
+						    size);
 }
 
 const struct bpf_func_proto bpf_ringbuf_reserve_proto = {
@@ -411,10 +540,17 @@ static void bpf_ringbuf_commit(void *sample, u64 flags, bool discard)
 	rec_pos = (void *)hdr - (void *)rb->data;
 	cons_pos = smp_load_acquire(&rb->consumer_pos) & rb->mask;
 
-	if (flags & BPF_RB_FORCE_WAKEUP)
-		irq_work_queue(&rb->work);
-	else if (cons_pos == rec_pos && !(flags & BPF_RB_NO_WAKEUP))
-		irq_work_queue(&rb->work);
+	if (!(flags & BPF_RB_FORCE_WAKEUP) &&
+	    (cons_pos != rec_pos || (flags & BPF_RB_NO_WAKEUP)))
+		return;
+
+	/* per-CPU rings share one waitq, so a single pending wakeup from any
+	 * CPU is enough to make the consumer drain all of them
+	 */
+	if (rb->owner && test_and_set_bit(0, &rb->owner->wakeup_pending))
+		return;
+
+	irq_work_queue(&rb->work);
 }
 
 BPF_CALL_2(bpf_ringbuf_submit, void *, sample, u64, flags)
@@ -446,14 +582,12 @@ const struct bpf_func_proto bpf_ringbuf_discard_proto = {
 BPF_CALL_4(bpf_ringbuf_output, struct bpf_map *, map, void *, data, u64, size,
 	   u64, flags)
 {
-	struct bpf_ringbuf_map *rb_map;
 	void *rec;
 
 	if (unlikely(flags & ~(BPF_RB_NO_WAKEUP | BPF_RB_FORCE_WAKEUP)))
 		return -EINVAL;
 
-	rb_map = container_of(map, struct bpf_ringbuf_map, map);
-	rec = __bpf_ringbuf_reserve(rb_map->rb, size);
+	rec = __bpf_ringbuf_reserve(bpf_ringbuf_map_rb(map), size);
 	if (!rec)
 		return -EAGAIN;
 
@@ -475,7 +609,8 @@ BPF_CALL_2(bpf_ringbuf_query, struct bpf_map *, map, u64, flags)
 {
 	struct bpf_ringbuf *rb;
 
-	rb = container_of(map, struct bpf_ringbuf_map, map)->rb;
+	/* per-CPU ring buffers report on the current CPU's ring */
+	rb = bpf_ringbuf_map_rb(map);
 
 	switch (flags) {
 	case BPF_RB_AVAIL_DATA:
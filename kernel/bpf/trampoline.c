@@ -210,9 +210,13 @@ static int bpf_trampoline_update(struct bpf_trampoline *tr)
 	 * updates to trampoline would change the code from underneath the
 	 * preempted task. Hence wait for tasks to voluntarily schedule or go
 	 * to userspace.
+	 * No task can be inside an image that was never attached, though, so
+	 * the first attach to a function doesn't need to wait. This is what
+	 * keeps attaching a program to thousands of functions from taking a
+	 * tasks RCU grace period per function.
 	 */
-
-	synchronize_rcu_tasks();
+	if (tr->image_live)
+		synchronize_rcu_tasks();
 
 	err = arch_prepare_bpf_trampoline(new_image, new_image + PAGE_SIZE / 2,
 					  &tr->func.model, flags, tprogs,
@@ -228,6 +232,7 @@ static int bpf_trampoline_update(struct bpf_trampoline *tr)
 		err = register_fentry(tr, new_image);
 	if (err)
 		goto out;
+	tr->image_live = true;
 	tr->selector++;
 out:
 	kfree(tprogs);
@@ -331,6 +336,14 @@ int bpf_trampoline_unlink_prog(struct bpf_prog *prog)
 	return err;
 }
 
+static void bpf_trampoline_free_rcu(struct rcu_head *rcu)
+{
+	struct bpf_trampoline *tr = container_of(rcu, struct bpf_trampoline, rcu);
+
+	bpf_jit_free_exec(tr->image);
+	kfree(tr);
+}
+
 void bpf_trampoline_put(struct bpf_trampoline *tr)
 {
 	if (!tr)
@@ -344,11 +357,11 @@ void bpf_trampoline_put(struct bpf_trampoline *tr)
 	if (WARN_ON_ONCE(!hlist_empty(&tr->progs_hlist[BPF_TRAMP_FEXIT])))
 		goto out;
 	bpf_image_ksym_del(&tr->ksym);
-	/* wait for tasks to get out of trampoline before freeing it */
-	synchronize_rcu_tasks();
-	bpf_jit_free_exec(tr->image);
 	hlist_del(&tr->hlist);
-	kfree(tr);
+	/* wait for tasks to get out of trampoline before freeing it, without
+	 * making every detach of a multi-function tracer wait in turn
+	 */
+	call_rcu_tasks(&tr->rcu, bpf_trampoline_free_rcu);
 out:
 	mutex_unlock(&trampoline_mutex);
 }
@@ -215,6 +215,7 @@ typedef enum {
 	CS_SCHED_LOAD_BALANCE,
 	CS_SPREAD_PAGE,
 	CS_SPREAD_SLAB,
+	CS_CPU_ISOLATED,
 } cpuset_flagbits_t;
 
 /* convenient tests for these bits */
@@ -258,6 +259,11 @@ static inline int is_spread_slab(const struct cpuset *cs)
 	return test_bit(CS_SPREAD_SLAB, &cs->flags);
 }
 
+static inline int is_cpu_isolated(const struct cpuset *cs)
+{
+	return test_bit(CS_CPU_ISOLATED, &cs->flags);
+}
+
 static inline int is_partition_root(const struct cpuset *cs)
 {
 	return cs->partition_root_state > 0;
@@ -1015,6 +1021,36 @@ static void rebuild_sched_domains_locked(void)
 }
 #endif /* CONFIG_SMP */
 
+/*
+ * Collect the effective CPUs of all cpusets marked cpu_isolated and hand
+ * them to the housekeeping code, which then keeps per-CPU chores (vmstat
+ * folding, LRU pagevec drains, unbound housekeeping work) off them.
+ *
+ * Call with cpuset_rwsem held.
+ */
+static int update_isolated_cpus(void)
+{
+	struct cgroup_subsys_state *pos_css;
+	cpumask_var_t isolated;
+	struct cpuset *cs;
+	int ret;
+
+	if (!zalloc_cpumask_var(&isolated, GFP_KERNEL))
+		return -ENOMEM;
+
+	rcu_read_lock();
+	cpuset_for_each_descendant_pre(cs, pos_css, &top_cpuset) {
+		if (is_cpu_isolated(cs))
+			cpumask_or(isolated, isolated, cs->effective_cpus);
+	}
+	rcu_read_unlock();
+
+	ret = housekeeping_update_isolated(isolated);
+	free_cpumask_var(isolated);
+
+	return ret;
+}
+
 void rebuild_sched_domains(void)
 {
 	get_online_cpus();
@@ -1555,6 +1591,8 @@ static int update_cpumask(struct cpuset *cs, struct cpuset *trialcs,
 		if (parent->child_ecpus_count)
 			update_sibling_cpumasks(parent, cs, &tmp);
 	}
+
+	update_isolated_cpus();
 	return 0;
 }
 
@@ -1877,6 +1915,8 @@ static int update_flag(cpuset_flagbits_t bit, struct cpuset *cs,
 	struct cpuset *trialcs;
 	int balance_flag_changed;
 	int spread_flag_changed;
+	int isolated_flag_changed;
+	unsigned long old_flags;
 	int err;
 
 	trialcs = alloc_trial_cpuset(cs);
@@ -1898,10 +1938,23 @@ static int update_flag(cpuset_flagbits_t bit, struct cpuset *cs,
 	spread_flag_changed = ((is_spread_slab(cs) != is_spread_slab(trialcs))
 			|| (is_spread_page(cs) != is_spread_page(trialcs)));
 
+	isolated_flag_changed = (is_cpu_isolated(cs) != is_cpu_isolated(trialcs));
+
 	spin_lock_irq(&callback_lock);
+	old_flags = cs->flags;
 	cs->flags = trialcs->flags;
 	spin_unlock_irq(&callback_lock);
 
+	if (isolated_flag_changed) {
+		err = update_isolated_cpus();
+		if (err < 0) {
+			spin_lock_irq(&callback_lock);
+			cs->flags = old_flags;
+			spin_unlock_irq(&callback_lock);
+			goto out;
+		}
+	}
+
 	if (!cpumask_empty(trialcs->cpus_allowed) && balance_flag_changed)
 		rebuild_sched_domains_locked();
 
@@ -1995,6 +2048,7 @@ static int update_prstate(struct cpuset *cs, int val)
 		update_sibling_cpumasks(parent, cs, &tmp);
 
 	rebuild_sched_domains_locked();
+	update_isolated_cpus();
 out:
 	free_cpumasks(NULL, &tmp);
 	return err;
@@ -2250,6 +2304,7 @@ typedef enum {
 	FILE_MEMORY_PRESSURE,
 	FILE_SPREAD_PAGE,
 	FILE_SPREAD_SLAB,
+	FILE_CPU_ISOLATED,
 } cpuset_filetype_t;
 
 static int cpuset_write_u64(struct cgroup_subsys_state *css, struct cftype *cft,
@@ -2291,6 +2346,9 @@ static int cpuset_write_u64(struct cgroup_subsys_state *css, struct cftype *cft,
 	case FILE_SPREAD_SLAB:
 		retval = update_flag(CS_SPREAD_SLAB, cs, val);
 		break;
+	case FILE_CPU_ISOLATED:
+		retval = update_flag(CS_CPU_ISOLATED, cs, val);
+		break;
 	default:
 		retval = -EINVAL;
 		break;
@@ -2458,6 +2516,8 @@ static u64 cpuset_read_u64(struct cgroup_subsys_state *css, struct cftype *cft)
 		return is_spread_page(cs);
 	case FILE_SPREAD_SLAB:
 		return is_spread_slab(cs);
+	case FILE_CPU_ISOLATED:
+		return is_cpu_isolated(cs);
 	default:
 		BUG();
 	}
@@ -2593,6 +2653,13 @@ static struct cftype legacy_files[] = {
 		.private = FILE_SCHED_LOAD_BALANCE,
 	},
 
+	{
+		.name = "cpu_isolated",
+		.read_u64 = cpuset_read_u64,
+		.write_u64 = cpuset_write_u64,
+		.private = FILE_CPU_ISOLATED,
+	},
+
 	{
 		.name = "sched_relax_domain_level",
 		.read_s64 = cpuset_read_s64,
@@ -2681,6 +2748,14 @@ static struct cftype dfl_files[] = {
 		.flags = CFTYPE_NOT_ON_ROOT,
 	},
 
+	{
+		.name = "cpus.isolated",
+		.read_u64 = cpuset_read_u64,
+		.write_u64 = cpuset_write_u64,
+		.private = FILE_CPU_ISOLATED,
+		.flags = CFTYPE_NOT_ON_ROOT,
+	},
+
 	{
 		.name = "cpus.subpartitions",
 		.seq_show = cpuset_common_seq_show,
@@ -2815,6 +2890,9 @@ static void cpuset_css_offline(struct cgroup_subsys_state *css)
 	    is_sched_load_balance(cs))
 		update_flag(CS_SCHED_LOAD_BALANCE, cs, 0);
 
+	if (is_cpu_isolated(cs))
+		update_flag(CS_CPU_ISOLATED, cs, 0);
+
 	if (cs->use_parent_ecpus) {
 		struct cpuset *parent = parent_cs(cs);
 
@@ -3208,6 +3286,12 @@ static void cpuset_hotplug_workfn(struct work_struct *work)
 		rebuild_sched_domains();
 	}
 
+	if (cpus_updated) {
+		percpu_down_write(&cpuset_rwsem);
+		update_isolated_cpus();
+		percpu_up_write(&cpuset_rwsem);
+	}
+
 	free_cpumasks(NULL, ptmp);
 }
 
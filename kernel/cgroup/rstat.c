@@ -6,6 +6,13 @@
 static DEFINE_SPINLOCK(cgroup_rstat_lock);
 static DEFINE_PER_CPU(raw_spinlock_t, cgroup_rstat_cpu_lock);
 
+/*
+ * Stat readers may be served stats which are up to this many milliseconds
+ * old instead of flushing every time, see cgroup_rstat_flush_hold().
+ */
+static unsigned int cgroup_rstat_staleness_ms;
+core_param(cgroup_rstat_staleness_ms, cgroup_rstat_staleness_ms, uint, 0644);
+
 static void cgroup_base_stat_flush(struct cgroup *cgrp, int cpu);
 
 static struct cgroup_rstat_cpu *cgroup_rstat_cpu(struct cgroup *cgrp, int cpu)
@@ -60,6 +67,7 @@ void cgroup_rstat_updated(struct cgroup *cgrp, int cpu)
 
 		rstatc->updated_next = prstatc->updated_children;
 		prstatc->updated_children = cgrp;
+		cpumask_set_cpu(cpu, parent->rstat_pending_cpus);
 	}
 
 	raw_spin_unlock_irqrestore(cpu_lock, flags);
@@ -146,15 +154,23 @@ static void cgroup_rstat_flush_locked(struct cgroup *cgrp, bool may_sleep)
 
 	lockdep_assert_held(&cgroup_rstat_lock);
 
-	for_each_possible_cpu(cpu) {
+	/*
+	 * Only visit the CPUs which have something queued below @cgrp.
+	 * Updates racing with the iteration are picked up by the next
+	 * flush, same as updates on CPUs which were already visited.
+	 */
+	for_each_cpu(cpu, cgrp->rstat_pending_cpus) {
 		raw_spinlock_t *cpu_lock = per_cpu_ptr(&cgroup_rstat_cpu_lock,
 						       cpu);
 		struct cgroup *pos = NULL;
 
 		raw_spin_lock(cpu_lock);
+		cpumask_clear_cpu(cpu, cgrp->rstat_pending_cpus);
 		while ((pos = cgroup_rstat_cpu_pop_updated(pos, cgrp, cpu))) {
 			struct cgroup_subsys_state *css;
 
+			/* popping leaves @pos with an empty updated tree */
+			cpumask_clear_cpu(cpu, pos->rstat_pending_cpus);
 			cgroup_base_stat_flush(pos, cpu);
 
 			rcu_read_lock();
@@ -174,6 +190,18 @@ static void cgroup_rstat_flush_locked(struct cgroup *cgrp, bool may_sleep)
 			spin_lock_irq(&cgroup_rstat_lock);
 		}
 	}
+
+	WRITE_ONCE(cgrp->rstat_flush_time, jiffies);
+}
+
+/* whether @cgrp was flushed recently enough for cgroup_rstat_staleness_ms */
+static bool cgroup_rstat_fresh(struct cgroup *cgrp)
+{
+	unsigned int staleness_ms = READ_ONCE(cgroup_rstat_staleness_ms);
+
+	return staleness_ms &&
+	       time_before(jiffies, READ_ONCE(cgrp->rstat_flush_time) +
+				    msecs_to_jiffies(staleness_ms));
 }
 
 /**
@@ -213,12 +241,31 @@ void cgroup_rstat_flush_irqsafe(struct cgroup *cgrp)
 	spin_unlock_irqrestore(&cgroup_rstat_lock, flags);
 }
 
+/**
+ * cgroup_rstat_flush_ratelimited - flush stats in @cgrp's subtree for reading
+ * @cgrp: target cgroup
+ *
+ * Same as cgroup_rstat_flush() unless @cgrp was flushed within the last
+ * cgroup_rstat_staleness_ms, in which case the slightly stale stats are
+ * left as they are.  Meant for stat file readers, so that frequent
+ * scraping of many cgroups doesn't pile up on cgroup_rstat_lock.
+ *
+ * This function may block.
+ */
+void cgroup_rstat_flush_ratelimited(struct cgroup *cgrp)
+{
+	if (!cgroup_rstat_fresh(cgrp))
+		cgroup_rstat_flush(cgrp);
+}
+
 /**
  * cgroup_rstat_flush_begin - flush stats in @cgrp's subtree and hold
  * @cgrp: target cgroup
  *
  * Flush stats in @cgrp's subtree and prevent further flushes.  Must be
- * paired with cgroup_rstat_flush_release().
+ * paired with cgroup_rstat_flush_release().  As for
+ * cgroup_rstat_flush_ratelimited(), the flush is skipped if @cgrp was
+ * flushed within the last cgroup_rstat_staleness_ms.
  *
  * This function may block.
  */
@@ -227,7 +274,8 @@ void cgroup_rstat_flush_hold(struct cgroup *cgrp)
 {
 	might_sleep();
 	spin_lock_irq(&cgroup_rstat_lock);
-	cgroup_rstat_flush_locked(cgrp, true);
+	if (!cgroup_rstat_fresh(cgrp))
+		cgroup_rstat_flush_locked(cgrp, true);
 }
 
 /**
@@ -243,11 +291,18 @@ int cgroup_rstat_init(struct cgroup *cgrp)
 {
 	int cpu;
 
+	/* the root cgrp is initialized twice, see cgroup_rstat_boot() */
+	if (!cpumask_available(cgrp->rstat_pending_cpus) &&
+	    !zalloc_cpumask_var(&cgrp->rstat_pending_cpus, GFP_KERNEL))
+		return -ENOMEM;
+
 	/* the root cgrp has rstat_cpu preallocated */
 	if (!cgrp->rstat_cpu) {
 		cgrp->rstat_cpu = alloc_percpu(struct cgroup_rstat_cpu);
-		if (!cgrp->rstat_cpu)
+		if (!cgrp->rstat_cpu) {
+			free_cpumask_var(cgrp->rstat_pending_cpus);
 			return -ENOMEM;
+		}
 	}
 
 	/* ->updated_children list is self terminated */
@@ -278,6 +333,7 @@ void cgroup_rstat_exit(struct cgroup *cgrp)
 
 	free_percpu(cgrp->rstat_cpu);
 	cgrp->rstat_cpu = NULL;
+	free_cpumask_var(cgrp->rstat_pending_cpus);
 }
 
 void __init cgroup_rstat_boot(void)
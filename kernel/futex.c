@@ -54,6 +54,7 @@
 #include <linux/hugetlb.h>
 #include <linux/freezer.h>
 #include <linux/memblock.h>
+#include <linux/prctl.h>
 #include <linux/fault-inject.h>
 #include <linux/refcount.h>
 
@@ -267,6 +268,17 @@ static struct {
 #define futex_queues   (__futex_data.queues)
 #define futex_hashsize (__futex_data.hashsize)
 
+/*
+ * A process can ask for a hash of its own for PTHREAD_PROCESS_PRIVATE
+ * futexes, see futex_hash_prctl().  It is allocated on the node of the
+ * requesting task and is never resized, so its buckets stay valid until
+ * the mm goes away.
+ */
+struct futex_private_hash {
+	unsigned long			hashsize;
+	struct futex_hash_bucket	queues[];
+};
+
 
 /*
  * Fault injections for futexes.
@@ -373,13 +385,22 @@ static inline int hb_waiters_pending(struct futex_hash_bucket *hb)
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket in the global hash, or in the private hash of
+ * the mm for private keys if the process has set one up.
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
 	u32 hash = jhash2((u32 *)key, offsetof(typeof(*key), both.offset) / 4,
 			  key->both.offset);
 
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))) {
+		struct futex_private_hash *fph;
+
+		fph = READ_ONCE(key->private.mm->futex_phash);
+		if (fph)
+			return &fph->queues[hash & (fph->hashsize - 1)];
+	}
+
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
@@ -4081,6 +4102,80 @@ static void __init futex_detect_cmpxchg(void)
 #endif
 }
 
+static void futex_hash_bucket_init(struct futex_hash_bucket *hb)
+{
+	atomic_set(&hb->waiters, 0);
+	plist_head_init(&hb->chain);
+	spin_lock_init(&hb->lock);
+}
+
+static int futex_hash_set_slots(unsigned long slots)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_private_hash *fph;
+	unsigned long i;
+
+	if (!is_power_of_2(slots) || slots < 2 || slots > futex_hashsize)
+		return -EINVAL;
+
+	/*
+	 * Keys hash differently once the private hash is in place.  Only
+	 * allow setting it up while no other task can be waiting on or
+	 * waking a private futex of @mm, which covers the usual case of
+	 * doing so at startup before the thread pool is created.
+	 */
+	if (mm->futex_phash || atomic_read(&mm->mm_users) != 1)
+		return -EBUSY;
+
+	fph = kvzalloc_node(struct_size(fph, queues, slots), GFP_KERNEL_ACCOUNT,
+			    numa_node_id());
+	if (!fph)
+		return -ENOMEM;
+
+	fph->hashsize = slots;
+	for (i = 0; i < slots; i++)
+		futex_hash_bucket_init(&fph->queues[i]);
+
+	WRITE_ONCE(mm->futex_phash, fph);
+	return 0;
+}
+
+/**
+ * futex_hash_prctl - Handle PR_FUTEX_HASH
+ * @cmd:	PR_FUTEX_HASH_SET_SLOTS or PR_FUTEX_HASH_GET_SLOTS
+ * @arg:	Number of hash buckets for PR_FUTEX_HASH_SET_SLOTS
+ *
+ * Processes running many threads which contend on private futexes can
+ * set up a hash of their own, sized for their thread count, so that the
+ * buckets are neither shared with other processes nor remote to the
+ * node the process runs on.
+ *
+ * Return: 0 or the number of private hash buckets on success, negative
+ * error code otherwise.
+ */
+int futex_hash_prctl(unsigned long cmd, unsigned long arg)
+{
+	struct futex_private_hash *fph;
+
+	switch (cmd) {
+	case PR_FUTEX_HASH_SET_SLOTS:
+		return futex_hash_set_slots(arg);
+	case PR_FUTEX_HASH_GET_SLOTS:
+		if (arg)
+			return -EINVAL;
+		fph = READ_ONCE(current->mm->futex_phash);
+		return fph ? fph->hashsize : 0;
+	}
+
+	return -EINVAL;
+}
+
+void futex_hash_free(struct mm_struct *mm)
+{
+	kvfree(mm->futex_phash);
+	mm->futex_phash = NULL;
+}
+
 static int __init futex_init(void)
 {
 	unsigned int futex_shift;
@@ -4101,11 +4196,8 @@ static int __init futex_init(void)
 
 	futex_detect_cmpxchg();
 
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	for (i = 0; i < futex_hashsize; i++)
+		futex_hash_bucket_init(&futex_queues[i]);
 
 	return 0;
 }
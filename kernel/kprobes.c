@@ -296,11 +296,25 @@ bool __is_insn_slot_addr(struct kprobe_insn_cache *c, unsigned long addr)
 }
 
 #ifdef CONFIG_OPTPROBES
+/*
+ * Architectures which patch a relative branch to the optprobe buffer may
+ * need it allocated closer to kernel text than the kprobe insn slots.
+ */
+void __weak *alloc_optinsn_page(void)
+{
+	return alloc_insn_page();
+}
+
+void __weak free_optinsn_page(void *page)
+{
+	free_insn_page(page);
+}
+
 /* For optimized_kprobe buffer */
 struct kprobe_insn_cache kprobe_optinsn_slots = {
 	.mutex = __MUTEX_INITIALIZER(kprobe_optinsn_slots.mutex),
-	.alloc = alloc_insn_page,
-	.free = free_insn_page,
+	.alloc = alloc_optinsn_page,
+	.free = free_optinsn_page,
 	.pages = LIST_HEAD_INIT(kprobe_optinsn_slots.pages),
 	/* .insn_size is initialized later */
 	.nr_garbage = 0,
@@ -71,4 +71,5 @@ __printf(1, 0) int vprintk_func(const char *fmt, va_list args) { return 0; }
 
 static inline void printk_safe_init(void) { }
 static inline bool printk_percpu_data_ready(void) { return false; }
+static inline void defer_console_output(void) { }
 #endif /* CONFIG_PRINTK */
@@ -42,6 +42,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
 #include <linux/sched/clock.h>
@@ -1976,6 +1977,69 @@ int vprintk_store(int facility, int level,
 			  dict, dictlen, text, text_len);
 }
 
+/*
+ * Console output is normally left to printk_kthread so that a printk()
+ * storm does not stall the CPUs which happen to print on slow consoles.
+ */
+static struct task_struct *printk_kthread;
+static DECLARE_WAIT_QUEUE_HEAD(printk_kthread_wait);
+
+static bool printk_offload = true;
+module_param_named(offload, printk_offload, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(offload, "print to consoles from a dedicated kthread");
+
+/*
+ * Messages are printed synchronously by the caller when they might be the
+ * last ones to make it out: until the kthread is up, while the system goes
+ * down and when oopsing or panicking.
+ */
+static bool printk_offload_console(void)
+{
+	return printk_offload && READ_ONCE(printk_kthread) &&
+	       system_state == SYSTEM_RUNNING && !oops_in_progress &&
+	       atomic_read(&panic_cpu) == PANIC_CPU_INVALID;
+}
+
+static bool printk_kthread_should_print(void)
+{
+	unsigned long flags;
+	bool pending;
+
+	logbuf_lock_irqsave(flags);
+	pending = !console_suspended && console_seq != log_next_seq;
+	logbuf_unlock_irqrestore(flags);
+
+	return pending;
+}
+
+static int printk_kthread_func(void *unused)
+{
+	for (;;) {
+		wait_event_interruptible(printk_kthread_wait,
+					 printk_kthread_should_print());
+		/* console_lock() allows console_unlock() to reschedule */
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(tsk)) {
+		pr_err("failed to start the printing kthread, printing synchronously\n");
+		return PTR_ERR(tsk);
+	}
+
+	WRITE_ONCE(printk_kthread, tsk);
+	return 0;
+}
+late_initcall(printk_kthread_init);
+
 asmlinkage int vprintk_emit(int facility, int level,
 			    const char *dict, size_t dictlen,
 			    const char *fmt, va_list args)
@@ -2005,7 +2069,10 @@ asmlinkage int vprintk_emit(int facility, int level,
 	logbuf_unlock_irqrestore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched && pending_output) {
+	if (!in_sched && pending_output && printk_offload_console()) {
+		/* printk_kthread is woken from irq_work, we may hold any lock */
+		defer_console_output();
+	} else if (!in_sched && pending_output) {
 		/*
 		 * Disable preemption to avoid being preempted while holding
 		 * console_sem which would prevent anyone from printing to
@@ -2105,6 +2172,8 @@ static void call_console_drivers(const char *ext_text, size_t ext_len,
 static size_t msg_print_text(const struct printk_log *msg, bool syslog,
 			     bool time, char *buf, size_t size) { return 0; }
 static bool suppress_message_printing(int level) { return false; }
+#define printk_kthread		NULL
+static bool printk_offload_console(void) { return false; }
 
 #endif /* CONFIG_PRINTK */
 
@@ -2396,6 +2465,17 @@ void console_unlock(void)
 		return;
 	}
 
+	/*
+	 * Leave the output to printk_kthread rather than flushing whatever
+	 * has piled up from the context of an arbitrary console_lock() user.
+	 */
+	if (printk_offload_console() && current != printk_kthread) {
+		console_locked = 0;
+		up_console_sem();
+		defer_console_output();
+		return;
+	}
+
 	/*
 	 * Console drivers are called with interrupts disabled, so
 	 * @console_may_schedule should be cleared before; however, we may
@@ -3012,8 +3092,10 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
+		if (printk_offload_console())
+			wake_up_interruptible(&printk_kthread_wait);
 		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		else if (console_trylock())
 			console_unlock();
 	}
 
@@ -478,9 +478,28 @@ void wake_q_add_safe(struct wake_q_head *head, struct task_struct *task)
 		put_task_struct(task);
 }
 
+#ifdef CONFIG_SMP
+static DEFINE_PER_CPU(cpumask_var_t, ttwu_batch_mask);
+static DEFINE_PER_CPU(bool, ttwu_batching);
+
+static bool ttwu_batch_begin(void);
+static void ttwu_batch_end(void);
+#else
+static inline bool ttwu_batch_begin(void) { return false; }
+static inline void ttwu_batch_end(void) { }
+#endif
+
 void wake_up_q(struct wake_q_head *head)
 {
 	struct wake_q_node *node = head->first;
+	bool batch;
+
+	/*
+	 * With more than one task to wake, defer the wakelist IPIs until all
+	 * of them are queued so that each target CPU is kicked only once.
+	 */
+	batch = node != WAKE_Q_TAIL && node->next != WAKE_Q_TAIL &&
+		ttwu_batch_begin();
 
 	while (node != WAKE_Q_TAIL) {
 		struct task_struct *task;
@@ -498,6 +517,9 @@ void wake_up_q(struct wake_q_head *head)
 		wake_up_process(task);
 		put_task_struct(task);
 	}
+
+	if (batch)
+		ttwu_batch_end();
 }
 
 /*
@@ -1369,6 +1391,290 @@ static inline void uclamp_fork(struct task_struct *p) { }
 static inline void init_uclamp(void) { }
 #endif /* CONFIG_UCLAMP_TASK */
 
+#ifdef CONFIG_SCHED_CORE
+
+DEFINE_STATIC_KEY_FALSE(__sched_core_enabled);
+static DEFINE_MUTEX(sched_core_mutex);
+
+/*
+ * Core scheduling is turned on when the first cookie is created and stays
+ * on; until then none of the hooks below are reached.
+ */
+void sched_core_get(void)
+{
+	int cpu;
+
+	if (static_branch_likely(&__sched_core_enabled))
+		return;
+
+	mutex_lock(&sched_core_mutex);
+	if (!static_key_enabled(&__sched_core_enabled)) {
+		static_branch_enable(&__sched_core_enabled);
+		/* Make every CPU publish what it is running */
+		for_each_online_cpu(cpu)
+			resched_cpu(cpu);
+	}
+	mutex_unlock(&sched_core_mutex);
+}
+
+void sched_core_enqueue(struct rq *rq, struct task_struct *p)
+{
+	struct rb_node **node = &rq->core_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct task_struct *node_task;
+
+	while (*node) {
+		node_task = container_of(*node, struct task_struct, core_node);
+		parent = *node;
+
+		if (p->core_cookie < node_task->core_cookie)
+			node = &parent->rb_left;
+		else
+			node = &parent->rb_right;
+	}
+
+	rb_link_node(&p->core_node, parent, node);
+	rb_insert_color(&p->core_node, &rq->core_tree);
+}
+
+void sched_core_dequeue(struct rq *rq, struct task_struct *p)
+{
+	rb_erase(&p->core_node, &rq->core_tree);
+	RB_CLEAR_NODE(&p->core_node);
+}
+
+/*
+ * Find the first queued fair task with @cookie that can run right away.
+ * RT and DL tasks are not picked out of order.
+ */
+static struct task_struct *sched_core_find(struct rq *rq, unsigned long cookie)
+{
+	struct rb_node *node = rq->core_tree.rb_node;
+	struct rb_node *first = NULL;
+	int loops = sysctl_sched_nr_migrate;
+	struct task_struct *p;
+
+	while (node) {
+		p = container_of(node, struct task_struct, core_node);
+
+		if (cookie < p->core_cookie) {
+			node = node->rb_left;
+		} else if (cookie > p->core_cookie) {
+			node = node->rb_right;
+		} else {
+			first = node;
+			node = node->rb_left;
+		}
+	}
+
+	for (node = first; node && loops--; node = rb_next(node)) {
+		p = container_of(node, struct task_struct, core_node);
+		if (p->core_cookie != cookie)
+			break;
+		if (p->sched_class == &fair_sched_class && !task_cfs_throttled(p))
+			return p;
+	}
+
+	return NULL;
+}
+
+/* All siblings of a core serialize task selection on a single lock */
+static inline raw_spinlock_t *sched_core_lock(int cpu)
+{
+	return &cpu_rq(cpumask_first(cpu_smt_mask(cpu)))->core_lock;
+}
+
+static inline unsigned int sched_core_prio(struct task_struct *p)
+{
+	if (dl_task(p))
+		return 2;
+	if (rt_task(p))
+		return 1;
+	return 0;
+}
+
+/*
+ * A force idled sibling gets the core once it waits for a higher class
+ * task, or has been waiting for a whole latency period.
+ */
+static bool sched_core_owed(struct rq *srq, unsigned int prio, u64 now)
+{
+	if (srq->core_wait_prio != prio)
+		return srq->core_wait_prio > prio;
+
+	return now - srq->core_wait_start >= sysctl_sched_latency;
+}
+
+/*
+ * Called with rq->lock held once the scheduling classes have picked @next.
+ * Each CPU publishes the cookie it is about to run under the core lock, so
+ * that siblings never both decide to run tasks of different cookies. If
+ * @next doesn't fit with what the siblings run, run a fitting fair task of
+ * this rq instead, or force this CPU idle until the siblings move on.
+ */
+static struct task_struct *sched_core_pick(struct rq *rq,
+					   struct task_struct *next)
+{
+	raw_spinlock_t *lock = sched_core_lock(cpu_of(rq));
+	unsigned long need = 0, cookie = next->core_cookie;
+	unsigned int prio = sched_core_prio(next);
+	bool conflict = false, owed = false;
+	bool win = true, mixed = false;
+	bool kick = false, idle;
+	struct task_struct *alt;
+	int i, cpu = cpu_of(rq);
+	u64 now = local_clock();
+
+	raw_spin_lock(lock);
+
+	if (is_idle_task(next) || next->sched_class == &stop_sched_class)
+		goto publish;
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+		unsigned long c;
+
+		if (i == cpu)
+			continue;
+
+		if (!srq->core_idle && srq->core_cookie != cookie) {
+			c = srq->core_cookie;
+			conflict = true;
+			if (prio <= srq->core_prio)
+				win = false;
+		} else if (srq->core_wait && srq->core_wait_cookie != cookie &&
+			   sched_core_owed(srq, prio, now)) {
+			c = srq->core_wait_cookie;
+			owed = true;
+		} else {
+			continue;
+		}
+
+		if (need && need != c)
+			mixed = true;
+		need = c;
+	}
+
+	if (!conflict && !owed)
+		goto publish;
+
+	/* @next outranks what the siblings run: idle and make them yield */
+	if (win && !owed) {
+		kick = true;
+		goto force_idle;
+	}
+
+	alt = mixed ? NULL : sched_core_find(rq, need);
+	if (alt) {
+		next->sched_class->put_prev_task(rq, next);
+		alt->sched_class->set_next_task(rq, alt, true);
+		next = alt;
+		cookie = next->core_cookie;
+		prio = sched_core_prio(next);
+		goto publish;
+	}
+
+force_idle:
+	if (!rq->core_wait || rq->core_wait_cookie != cookie)
+		rq->core_wait_start = now;
+	rq->core_wait = true;
+	rq->core_wait_cookie = cookie;
+	rq->core_wait_prio = prio;
+	rq->core_forceidle_count++;
+
+	next->sched_class->put_prev_task(rq, next);
+	next = pick_next_task_idle(rq);
+	cookie = 0;
+	prio = 0;
+	goto unlock;
+
+publish:
+	rq->core_wait = false;
+unlock:
+	idle = is_idle_task(next) || next->sched_class == &stop_sched_class;
+	if (rq->core_idle != idle || rq->core_cookie != cookie) {
+		/* Force idled siblings may fit in now */
+		for_each_cpu(i, cpu_smt_mask(cpu)) {
+			if (i != cpu && cpu_rq(i)->core_wait)
+				kick = true;
+		}
+	}
+	rq->core_idle = idle;
+	rq->core_cookie = cookie;
+	rq->core_prio = prio;
+
+	raw_spin_unlock(lock);
+
+	if (kick)
+		irq_work_queue(&rq->core_kick_work);
+
+	return next;
+}
+
+/* Make the siblings re-run sched_core_pick() */
+static void sched_core_kick_fn(struct irq_work *work)
+{
+	struct rq *rq = container_of(work, struct rq, core_kick_work);
+	int i, cpu = cpu_of(rq);
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		if (i != cpu)
+			resched_cpu(i);
+	}
+}
+
+/* Give the core to a sibling that has been force idled long enough */
+static void sched_core_tick(struct rq *rq)
+{
+	raw_spinlock_t *lock = sched_core_lock(cpu_of(rq));
+	struct task_struct *curr = rq->curr;
+	unsigned int prio = sched_core_prio(curr);
+	int i, cpu = cpu_of(rq);
+	u64 now = local_clock();
+
+	if (is_idle_task(curr))
+		return;
+
+	raw_spin_lock(lock);
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (i != cpu && srq->core_wait &&
+		    srq->core_wait_cookie != curr->core_cookie &&
+		    sched_core_owed(srq, prio, now)) {
+			resched_curr(rq);
+			break;
+		}
+	}
+	raw_spin_unlock(lock);
+}
+
+static void sched_core_cpu_starting(unsigned int cpu)
+{
+	raw_spinlock_t *lock = sched_core_lock(cpu);
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+
+	/* Drop whatever was published before this CPU went down */
+	raw_spin_lock_irqsave(lock, flags);
+	rq->core_idle = true;
+	rq->core_wait = false;
+	raw_spin_unlock_irqrestore(lock, flags);
+}
+
+#else /* !CONFIG_SCHED_CORE */
+
+static inline struct task_struct *sched_core_pick(struct rq *rq,
+						  struct task_struct *next)
+{
+	return next;
+}
+
+static inline void sched_core_tick(struct rq *rq) { }
+static inline void sched_core_cpu_starting(unsigned int cpu) { }
+
+#endif /* CONFIG_SCHED_CORE */
+
 static inline void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	if (!(flags & ENQUEUE_NOCLOCK))
@@ -1381,6 +1687,9 @@ static inline void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 
 	uclamp_rq_inc(rq, p);
 	p->sched_class->enqueue_task(rq, p, flags);
+
+	if (sched_core_enabled(rq))
+		sched_core_enqueue(rq, p);
 }
 
 static inline void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
@@ -1393,6 +1702,9 @@ static inline void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 		psi_dequeue(p, flags & DEQUEUE_SLEEP);
 	}
 
+	if (sched_core_enabled(rq) && sched_core_enqueued(p))
+		sched_core_dequeue(rq, p);
+
 	uclamp_rq_dec(rq, p);
 	p->sched_class->dequeue_task(rq, p, flags);
 }
@@ -2411,9 +2723,59 @@ static void __ttwu_queue_wakelist(struct task_struct *p, int cpu, int wake_flags
 	p->sched_remote_wakeup = !!(wake_flags & WF_MIGRATED);
 
 	WRITE_ONCE(rq->ttwu_pending, 1);
+
+	if (in_task() && __this_cpu_read(ttwu_batching)) {
+		if (__smp_call_single_queue_noipi(cpu, &p->wake_entry.llist))
+			__cpumask_set_cpu(cpu, this_cpu_cpumask_var_ptr(ttwu_batch_mask));
+		return;
+	}
+
 	__smp_call_single_queue(cpu, &p->wake_entry.llist);
 }
 
+/*
+ * ttwu_batch_begin - start collecting wakelist IPIs on this CPU
+ *
+ * Returns true, with preemption disabled, if batching was started; the
+ * caller must then call ttwu_batch_end() to send the pending IPIs.
+ */
+static bool ttwu_batch_begin(void)
+{
+	if (!sched_feat(TTWU_QUEUE) || !sched_feat(TTWU_QUEUE_BATCH))
+		return false;
+
+	preempt_disable();
+	if (__this_cpu_read(ttwu_batching)) {
+		preempt_enable();
+		return false;
+	}
+	__this_cpu_write(ttwu_batching, true);
+
+	return true;
+}
+
+static void ttwu_batch_end(void)
+{
+	struct cpumask *mask = this_cpu_cpumask_var_ptr(ttwu_batch_mask);
+	int cpu;
+
+	__this_cpu_write(ttwu_batching, false);
+
+	for_each_cpu(cpu, mask) {
+		if (set_nr_if_polling(cpu_rq(cpu)->idle)) {
+			trace_sched_wake_idle_without_ipi(cpu);
+			__cpumask_clear_cpu(cpu, mask);
+		}
+	}
+
+	if (!cpumask_empty(mask)) {
+		arch_send_call_function_ipi_mask(mask);
+		cpumask_clear(mask);
+	}
+
+	preempt_enable();
+}
+
 void wake_up_if_idle(int cpu)
 {
 	struct rq *rq = cpu_rq(cpu);
@@ -2443,13 +2805,28 @@ bool cpus_share_cache(int this_cpu, int that_cpu)
 	return per_cpu(sd_llc_id, this_cpu) == per_cpu(sd_llc_id, that_cpu);
 }
 
+static inline bool cpus_share_cluster(int this_cpu, int that_cpu)
+{
+	return per_cpu(sd_cluster_id, this_cpu) == per_cpu(sd_cluster_id, that_cpu);
+}
+
 static inline bool ttwu_queue_cond(int cpu, int wake_flags)
 {
+	int this_cpu = smp_processor_id();
+
 	/*
 	 * If the CPU does not share cache, then queue the task on the
 	 * remote rqs wakelist to avoid accessing remote data.
 	 */
-	if (!cpus_share_cache(smp_processor_id(), cpu))
+	if (!cpus_share_cache(this_cpu, cpu))
+		return true;
+
+	/*
+	 * When the LLC spans many clusters, bouncing the remote rq->lock
+	 * and runqueue lines across the mesh is nearly as costly as going
+	 * across an LLC boundary, so treat the cluster as the boundary.
+	 */
+	if (sched_feat(TTWU_QUEUE_CLUSTER) && !cpus_share_cluster(this_cpu, cpu))
 		return true;
 
 	/*
@@ -2858,6 +3235,9 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 #endif
 
 	RB_CLEAR_NODE(&p->dl.rb_node);
+#ifdef CONFIG_SCHED_CORE
+	RB_CLEAR_NODE(&p->core_node);
+#endif
 	init_dl_task_timer(&p->dl);
 	init_dl_inactive_task_timer(&p->dl);
 	__dl_clear_params(p);
@@ -3001,6 +3381,7 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 	unsigned long flags;
 
 	__sched_fork(clone_flags, p);
+	sched_core_fork(p);
 	/*
 	 * We mark the process as NEW here. This guarantees that
 	 * nobody will actually run it, and a signal or other external
@@ -3026,6 +3407,9 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 		} else if (PRIO_TO_NICE(p->static_prio) < 0)
 			p->static_prio = NICE_TO_PRIO(0);
 
+		if (p->se.latency_nice < DEFAULT_LATENCY_NICE)
+			p->se.latency_nice = DEFAULT_LATENCY_NICE;
+
 		p->prio = p->normal_prio = __normal_prio(p);
 		set_load_weight(p, false);
 
@@ -3403,6 +3787,7 @@ static struct rq *finish_task_switch(struct task_struct *prev)
 		membarrier_mm_sync_core_before_usermode(mm);
 		mmdrop(mm);
 	}
+	membarrier_mark_cpu(rq, current->mm);
 	if (unlikely(prev_state == TASK_DEAD)) {
 		if (prev->sched_class->task_dead)
 			prev->sched_class->task_dead(prev);
@@ -3778,6 +4163,8 @@ void scheduler_tick(void)
 	curr->sched_class->task_tick(rq, curr, 0);
 	calc_global_load_tick(rq);
 	psi_task_tick(rq);
+	if (sched_core_enabled(rq))
+		sched_core_tick(rq);
 
 	rq_unlock(rq, &rf);
 
@@ -4273,6 +4660,8 @@ static void __sched notrace __schedule(bool preempt)
 	}
 
 	next = pick_next_task(rq, prev, &rf);
+	if (sched_core_enabled(rq))
+		next = sched_core_pick(rq, next);
 	clear_tsk_need_resched(prev);
 	clear_preempt_need_resched();
 
@@ -4940,6 +5329,13 @@ static void __setscheduler_params(struct task_struct *p,
 	set_load_weight(p, true);
 }
 
+static void __setscheduler_latency(struct task_struct *p,
+				   const struct sched_attr *attr)
+{
+	if (attr->sched_flags & SCHED_FLAG_LATENCY_NICE)
+		p->se.latency_nice = attr->sched_latency_nice;
+}
+
 /* Actually do priority change: must hold pi & rq lock. */
 static void __setscheduler(struct rq *rq, struct task_struct *p,
 			   const struct sched_attr *attr, bool keep_boost)
@@ -5016,6 +5412,12 @@ static int __sched_setscheduler(struct task_struct *p,
 	if (attr->sched_flags & ~(SCHED_FLAG_ALL | SCHED_FLAG_SUGOV))
 		return -EINVAL;
 
+	if (attr->sched_flags & SCHED_FLAG_LATENCY_NICE) {
+		if (attr->sched_latency_nice > MAX_LATENCY_NICE ||
+		    attr->sched_latency_nice < MIN_LATENCY_NICE)
+			return -EINVAL;
+	}
+
 	/*
 	 * Valid priorities for SCHED_FIFO and SCHED_RR are
 	 * 1..MAX_USER_RT_PRIO-1, valid priority for SCHED_NORMAL,
@@ -5038,6 +5440,11 @@ static int __sched_setscheduler(struct task_struct *p,
 				return -EPERM;
 		}
 
+		/* Can't make the task more latency sensitive: */
+		if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+		    attr->sched_latency_nice < p->se.latency_nice)
+			return -EPERM;
+
 		if (rt_policy(policy)) {
 			unsigned long rlim_rtprio =
 					task_rlimit(p, RLIMIT_RTPRIO);
@@ -5129,6 +5536,9 @@ static int __sched_setscheduler(struct task_struct *p,
 			goto change;
 		if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP)
 			goto change;
+		if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+		    attr->sched_latency_nice != p->se.latency_nice)
+			goto change;
 
 		p->sched_reset_on_fork = reset_on_fork;
 		retval = 0;
@@ -5214,6 +5624,7 @@ static int __sched_setscheduler(struct task_struct *p,
 
 	__setscheduler(rq, p, attr, pi);
 	__setscheduler_uclamp(p, attr);
+	__setscheduler_latency(p, attr);
 
 	if (queued) {
 		/*
@@ -5377,6 +5788,10 @@ static int sched_copy_attr(struct sched_attr __user *uattr, struct sched_attr *a
 	    size < SCHED_ATTR_SIZE_VER1)
 		return -EINVAL;
 
+	if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+	    size < SCHED_ATTR_SIZE_VER2)
+		return -EINVAL;
+
 	/*
 	 * XXX: Do we want to be lenient like existing syscalls; or do we want
 	 * to be strict and return an error on out-of-bounds values?
@@ -5611,6 +6026,8 @@ SYSCALL_DEFINE4(sched_getattr, pid_t, pid, struct sched_attr __user *, uattr,
 	kattr.sched_util_max = p->uclamp_req[UCLAMP_MAX].value;
 #endif
 
+	kattr.sched_latency_nice = p->se.latency_nice;
+
 	rcu_read_unlock();
 
 	return sched_attr_copy_to_user(uattr, &kattr, usize);
@@ -6702,6 +7119,7 @@ static void sched_rq_cpu_starting(unsigned int cpu)
 
 int sched_cpu_starting(unsigned int cpu)
 {
+	sched_core_cpu_starting(cpu);
 	sched_rq_cpu_starting(cpu);
 	sched_tick_start(cpu);
 	return 0;
@@ -6834,6 +7252,10 @@ void __init sched_init(void)
 			cpumask_size(), GFP_KERNEL, cpu_to_node(i));
 		per_cpu(select_idle_mask, i) = (cpumask_var_t)kzalloc_node(
 			cpumask_size(), GFP_KERNEL, cpu_to_node(i));
+#ifdef CONFIG_SMP
+		per_cpu(ttwu_batch_mask, i) = (cpumask_var_t)kzalloc_node(
+			cpumask_size(), GFP_KERNEL, cpu_to_node(i));
+#endif
 	}
 #endif /* CONFIG_CPUMASK_OFFSTACK */
 
@@ -6924,6 +7346,12 @@ void __init sched_init(void)
 #endif /* CONFIG_SMP */
 		hrtick_rq_init(rq);
 		atomic_set(&rq->nr_iowait, 0);
+
+#ifdef CONFIG_SCHED_CORE
+		rq->core_tree = RB_ROOT;
+		raw_spin_lock_init(&rq->core_lock);
+		init_irq_work(&rq->core_kick_work, sched_core_kick_fn);
+#endif
 	}
 
 	set_load_weight(&init_task, false);
@@ -7610,6 +8038,21 @@ static u64 cpu_shares_read_u64(struct cgroup_subsys_state *css,
 	return (u64) scale_load_down(tg->shares);
 }
 
+static s64 cpu_latency_nice_read_s64(struct cgroup_subsys_state *css,
+				     struct cftype *cft)
+{
+	return css_tg(css)->latency_nice;
+}
+
+static int cpu_latency_nice_write_s64(struct cgroup_subsys_state *css,
+				      struct cftype *cft, s64 latency_nice)
+{
+	if (latency_nice < MIN_LATENCY_NICE || latency_nice > MAX_LATENCY_NICE)
+		return -ERANGE;
+
+	return sched_group_set_latency(css_tg(css), latency_nice);
+}
+
 #ifdef CONFIG_CFS_BANDWIDTH
 static DEFINE_MUTEX(cfs_constraints_mutex);
 
@@ -7620,7 +8063,8 @@ static const u64 max_cfs_runtime = MAX_BW * NSEC_PER_USEC;
 
 static int __cfs_schedulable(struct task_group *tg, u64 period, u64 runtime);
 
-static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota,
+				u64 burst)
 {
 	int i, ret = 0, runtime_enabled, runtime_was_enabled;
 	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
@@ -7650,6 +8094,14 @@ static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
 	if (quota != RUNTIME_INF && quota > max_cfs_runtime)
 		return -EINVAL;
 
+	/*
+	 * Unused quota may accumulate up to burst, which is bounded by the
+	 * quota itself and, together with it, by the same overflow limit.
+	 */
+	if (quota != RUNTIME_INF && (burst > quota ||
+				     burst + quota > max_cfs_runtime))
+		return -EINVAL;
+
 	/*
 	 * Prevent race between setting of cfs_rq->runtime_enabled and
 	 * unthrottle_offline_cfs_rqs().
@@ -7671,7 +8123,10 @@ static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
 	raw_spin_lock_irq(&cfs_b->lock);
 	cfs_b->period = ns_to_ktime(period);
 	cfs_b->quota = quota;
+	cfs_b->burst = burst;
 
+	/* Start over with a single period's worth of runtime */
+	cfs_b->runtime = 0;
 	__refill_cfs_bandwidth_runtime(cfs_b);
 
 	/* Restart the period timer (if active) to handle new period expiry: */
@@ -7704,9 +8159,10 @@ static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
 
 static int tg_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
 {
-	u64 quota, period;
+	u64 quota, period, burst;
 
 	period = ktime_to_ns(tg->cfs_bandwidth.period);
+	burst = tg->cfs_bandwidth.burst;
 	if (cfs_quota_us < 0)
 		quota = RUNTIME_INF;
 	else if ((u64)cfs_quota_us <= U64_MAX / NSEC_PER_USEC)
@@ -7714,7 +8170,7 @@ static int tg_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
 	else
 		return -EINVAL;
 
-	return tg_set_cfs_bandwidth(tg, period, quota);
+	return tg_set_cfs_bandwidth(tg, period, quota, burst);
 }
 
 static long tg_get_cfs_quota(struct task_group *tg)
@@ -7732,15 +8188,16 @@ static long tg_get_cfs_quota(struct task_group *tg)
 
 static int tg_set_cfs_period(struct task_group *tg, long cfs_period_us)
 {
-	u64 quota, period;
+	u64 quota, period, burst;
 
 	if ((u64)cfs_period_us > U64_MAX / NSEC_PER_USEC)
 		return -EINVAL;
 
 	period = (u64)cfs_period_us * NSEC_PER_USEC;
 	quota = tg->cfs_bandwidth.quota;
+	burst = tg->cfs_bandwidth.burst;
 
-	return tg_set_cfs_bandwidth(tg, period, quota);
+	return tg_set_cfs_bandwidth(tg, period, quota, burst);
 }
 
 static long tg_get_cfs_period(struct task_group *tg)
@@ -7753,6 +8210,30 @@ static long tg_get_cfs_period(struct task_group *tg)
 	return cfs_period_us;
 }
 
+static int tg_set_cfs_burst(struct task_group *tg, long cfs_burst_us)
+{
+	u64 quota, period, burst;
+
+	if ((u64)cfs_burst_us > U64_MAX / NSEC_PER_USEC)
+		return -EINVAL;
+
+	burst = (u64)cfs_burst_us * NSEC_PER_USEC;
+	period = ktime_to_ns(tg->cfs_bandwidth.period);
+	quota = tg->cfs_bandwidth.quota;
+
+	return tg_set_cfs_bandwidth(tg, period, quota, burst);
+}
+
+static long tg_get_cfs_burst(struct task_group *tg)
+{
+	u64 burst_us;
+
+	burst_us = tg->cfs_bandwidth.burst;
+	do_div(burst_us, NSEC_PER_USEC);
+
+	return burst_us;
+}
+
 static s64 cpu_cfs_quota_read_s64(struct cgroup_subsys_state *css,
 				  struct cftype *cft)
 {
@@ -7777,6 +8258,18 @@ static int cpu_cfs_period_write_u64(struct cgroup_subsys_state *css,
 	return tg_set_cfs_period(css_tg(css), cfs_period_us);
 }
 
+static u64 cpu_cfs_burst_read_u64(struct cgroup_subsys_state *css,
+				  struct cftype *cft)
+{
+	return tg_get_cfs_burst(css_tg(css));
+}
+
+static int cpu_cfs_burst_write_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cftype, u64 cfs_burst_us)
+{
+	return tg_set_cfs_burst(css_tg(css), cfs_burst_us);
+}
+
 struct cfs_schedulable_data {
 	struct task_group *tg;
 	u64 period, quota;
@@ -7917,6 +8410,11 @@ static struct cftype cpu_legacy_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency.nice",
+		.read_s64 = cpu_latency_nice_read_s64,
+		.write_s64 = cpu_latency_nice_write_s64,
+	},
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
@@ -7929,6 +8427,11 @@ static struct cftype cpu_legacy_files[] = {
 		.read_u64 = cpu_cfs_period_read_u64,
 		.write_u64 = cpu_cfs_period_write_u64,
 	},
+	{
+		.name = "cfs_burst_us",
+		.read_u64 = cpu_cfs_burst_read_u64,
+		.write_u64 = cpu_cfs_burst_write_u64,
+	},
 	{
 		.name = "stat",
 		.seq_show = cpu_cfs_stat_show,
@@ -8094,12 +8597,13 @@ static ssize_t cpu_max_write(struct kernfs_open_file *of,
 {
 	struct task_group *tg = css_tg(of_css(of));
 	u64 period = tg_get_cfs_period(tg);
+	u64 burst = tg->cfs_bandwidth.burst;
 	u64 quota;
 	int ret;
 
 	ret = cpu_period_quota_parse(buf, &period, &quota);
 	if (!ret)
-		ret = tg_set_cfs_bandwidth(tg, period, quota);
+		ret = tg_set_cfs_bandwidth(tg, period, quota, burst);
 	return ret ?: nbytes;
 }
 #endif
@@ -8118,6 +8622,12 @@ static struct cftype cpu_files[] = {
 		.read_s64 = cpu_weight_nice_read_s64,
 		.write_s64 = cpu_weight_nice_write_s64,
 	},
+	{
+		.name = "latency.nice",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_s64 = cpu_latency_nice_read_s64,
+		.write_s64 = cpu_latency_nice_write_s64,
+	},
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
@@ -8126,6 +8636,12 @@ static struct cftype cpu_files[] = {
 		.seq_show = cpu_max_show,
 		.write = cpu_max_write,
 	},
+	{
+		.name = "max.burst",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_cfs_burst_read_u64,
+		.write_u64 = cpu_cfs_burst_write_u64,
+	},
 #endif
 #ifdef CONFIG_UCLAMP_TASK_GROUP
 	{
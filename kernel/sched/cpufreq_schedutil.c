@@ -39,6 +39,7 @@ struct sugov_policy {
 	struct			kthread_worker worker;
 	struct task_struct	*thread;
 	bool			work_in_progress;
+	u64			transition_cost_ns;
 
 	bool			limits_changed;
 	bool			need_freq_update;
@@ -66,6 +67,29 @@ static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
 
 /************************ Governor internals ***********************/
 
+/*
+ * On platforms that can't fast switch, each frequency change is done by the
+ * sugov kthread and may take a long time (e.g. a PCC mailbox round trip).
+ * Stretch the rate limit so that the kthread never spends more than about a
+ * quarter of a CPU on frequency changes, whatever the tunable says.
+ */
+static s64 sugov_update_delay(struct sugov_policy *sg_policy)
+{
+	u64 cost = READ_ONCE(sg_policy->transition_cost_ns);
+
+	return max_t(s64, sg_policy->freq_update_delay_ns, cost * 4);
+}
+
+static void sugov_update_transition_cost(struct sugov_policy *sg_policy,
+					 u64 delta_ns)
+{
+	u64 cost = sg_policy->transition_cost_ns;
+
+	/* Running average over ~4 transitions */
+	cost = cost - (cost >> 2) + (delta_ns >> 2);
+	WRITE_ONCE(sg_policy->transition_cost_ns, cost);
+}
+
 static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
 {
 	s64 delta_ns;
@@ -96,7 +120,7 @@ static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
 
 	delta_ns = time - sg_policy->last_freq_update_time;
 
-	return delta_ns >= sg_policy->freq_update_delay_ns;
+	return delta_ns >= sugov_update_delay(sg_policy);
 }
 
 static bool sugov_update_next_freq(struct sugov_policy *sg_policy, u64 time,
@@ -551,6 +575,7 @@ static void sugov_work(struct kthread_work *work)
 	struct sugov_policy *sg_policy = container_of(work, struct sugov_policy, work);
 	unsigned int freq;
 	unsigned long flags;
+	u64 start;
 
 	/*
 	 * Hold sg_policy->update_lock shortly to handle the case where:
@@ -568,7 +593,9 @@ static void sugov_work(struct kthread_work *work)
 	raw_spin_unlock_irqrestore(&sg_policy->update_lock, flags);
 
 	mutex_lock(&sg_policy->work_lock);
+	start = local_clock();
 	__cpufreq_driver_target(sg_policy->policy, freq, CPUFREQ_RELATION_L);
+	sugov_update_transition_cost(sg_policy, local_clock() - start);
 	mutex_unlock(&sg_policy->work_lock);
 }
 
@@ -839,6 +866,7 @@ static int sugov_start(struct cpufreq_policy *policy)
 	sg_policy->last_freq_update_time	= 0;
 	sg_policy->next_freq			= 0;
 	sg_policy->work_in_progress		= false;
+	sg_policy->transition_cost_ns		= 0;
 	sg_policy->limits_changed		= false;
 	sg_policy->need_freq_update		= false;
 	sg_policy->cached_raw_freq		= 0;
@@ -643,6 +643,9 @@ do {									\
 	SEQ_printf(m, "  .%-30s: %ld\n", "curr->pid", (long)(task_pid_nr(rq->curr)));
 	PN(clock);
 	PN(clock_task);
+#ifdef CONFIG_SCHED_CORE
+	P(core_forceidle_count);
+#endif
 #undef P
 #undef PN
 
@@ -2910,6 +2910,10 @@ static void task_tick_numa(struct rq *rq, struct task_struct *curr)
 	if ((curr->flags & (PF_EXITING | PF_KTHREAD)) || work->next != work)
 		return;
 
+	/* Hardware access sampling places memory without hinting faults */
+	if (numa_sample_active())
+		return;
+
 	/*
 	 * Using runtime rather than walltime has the dual advantage that
 	 * we (mostly) drive the selection from busy threads and that the
@@ -3771,6 +3775,41 @@ static void detach_entity_load_avg(struct cfs_rq *cfs_rq, struct sched_entity *s
 #define UPDATE_TG	0x1
 #define SKIP_AGE_LOAD	0x2
 #define DO_ATTACH	0x4
+#define LAZY_UPDATE	0x8
+
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * Enqueue and dequeue resync the PELT signals of every ancestor of the
+ * task even though, for an ancestor already on the rq, only its
+ * runnable count changes. When nothing is pending propagation and both
+ * the group entity and its cfs_rq were synced less than a PELT period
+ * ago, skipping the resync misattributes less than one period worth of
+ * runnable time. Leave it to the tick or to update_blocked_averages().
+ *
+ * The root cfs_rq is always updated, it drives schedutil.
+ */
+static inline bool load_avg_update_deferrable(u64 now, struct cfs_rq *cfs_rq,
+					      struct sched_entity *se)
+{
+	if (!sched_feat(LAZY_GROUP_PELT))
+		return false;
+
+	if (cfs_rq == &rq_of(cfs_rq)->cfs || entity_is_task(se))
+		return false;
+
+	if (cfs_rq->removed.nr || cfs_rq->propagate || group_cfs_rq(se)->propagate)
+		return false;
+
+	return now - cfs_rq->avg.last_update_time < 1024 * 1024 &&
+	       now - se->avg.last_update_time < 1024 * 1024;
+}
+#else
+static inline bool load_avg_update_deferrable(u64 now, struct cfs_rq *cfs_rq,
+					      struct sched_entity *se)
+{
+	return false;
+}
+#endif
 
 /* Update task and its cfs_rq load average */
 static inline void update_load_avg(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
@@ -3778,6 +3817,9 @@ static inline void update_load_avg(struct cfs_rq *cfs_rq, struct sched_entity *s
 	u64 now = cfs_rq_clock_pelt(cfs_rq);
 	int decayed;
 
+	if ((flags & LAZY_UPDATE) && load_avg_update_deferrable(now, cfs_rq, se))
+		return;
+
 	/*
 	 * Track task load average for carrying it to new CPU after migrated, and
 	 * track group sched_entity load average for task_h_load calc in migration
@@ -4051,6 +4093,7 @@ static inline void update_misfit_status(struct task_struct *p, struct rq *rq)
 #define UPDATE_TG	0x0
 #define SKIP_AGE_LOAD	0x0
 #define DO_ATTACH	0x0
+#define LAZY_UPDATE	0x0
 
 static inline void update_load_avg(struct cfs_rq *cfs_rq, struct sched_entity *se, int not_used1)
 {
@@ -4580,16 +4623,18 @@ static inline u64 sched_cfs_bandwidth_slice(void)
 }
 
 /*
- * Replenish runtime according to assigned quota. We use sched_clock_cpu
- * directly instead of rq->clock to avoid adding additional synchronization
- * around rq->lock.
+ * Replenish runtime according to assigned quota. Runtime left unused in
+ * the previous period is carried over, up to burst on top of the quota.
  *
  * requires cfs_b->lock
  */
 void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b)
 {
-	if (cfs_b->quota != RUNTIME_INF)
-		cfs_b->runtime = cfs_b->quota;
+	if (unlikely(cfs_b->quota == RUNTIME_INF))
+		return;
+
+	cfs_b->runtime += cfs_b->quota;
+	cfs_b->runtime = min(cfs_b->runtime, cfs_b->quota + cfs_b->burst);
 }
 
 static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
@@ -5199,6 +5244,7 @@ static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
 			if (new < max_cfs_quota_period) {
 				cfs_b->period = ns_to_ktime(new);
 				cfs_b->quota *= 2;
+				cfs_b->burst *= 2;
 
 				pr_warn_ratelimited(
 	"cfs_period_timer[cpu%d]: period too short, scaling up (new cfs_period_us = %lld, cfs_quota_us = %lld)\n",
@@ -5369,6 +5415,13 @@ static inline void unthrottle_offline_cfs_rqs(struct rq *rq) {}
 
 #endif /* CONFIG_CFS_BANDWIDTH */
 
+#ifdef CONFIG_SCHED_CORE
+bool task_cfs_throttled(struct task_struct *p)
+{
+	return throttled_hierarchy(cfs_rq_of(&p->se));
+}
+#endif
+
 /**************************************************
  * CFS operations on tasks:
  */
@@ -5501,7 +5554,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 
-		update_load_avg(cfs_rq, se, UPDATE_TG);
+		update_load_avg(cfs_rq, se, UPDATE_TG | LAZY_UPDATE);
 		se_update_runnable(se);
 		update_cfs_group(se);
 
@@ -5605,7 +5658,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 
-		update_load_avg(cfs_rq, se, UPDATE_TG);
+		update_load_avg(cfs_rq, se, UPDATE_TG | LAZY_UPDATE);
 		se_update_runnable(se);
 		update_cfs_group(se);
 
@@ -6040,6 +6093,9 @@ static int select_idle_core(struct task_struct *p, struct sched_domain *sd, int
 		return -1;
 
 	cpumask_and(cpus, sched_domain_span(sd), p->cpus_ptr);
+	/* a core can only be idle if one of its CPUs is in the idle mask */
+	if (sched_feat(SIS_IDLE_MASK) && sd->shared)
+		cpumask_and(cpus, cpus, sds_idle_cpus(sd->shared));
 
 	for_each_cpu_wrap(core, cpus, target) {
 		bool idle = true;
@@ -6135,11 +6191,27 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 			nr = 4;
 	}
 
+	/*
+	 * Latency sensitive tasks would rather run on the first idle CPU
+	 * found than wait for a long scan: cut the depth by up to 16x.
+	 */
+	if (p->se.latency_nice < 0)
+		nr = max(nr >> DIV_ROUND_UP(-p->se.latency_nice, 5), min(nr, 4));
+
 	time = cpu_clock(this);
 
 	cpumask_and(cpus, sched_domain_span(sd), p->cpus_ptr);
+	/*
+	 * Only visit CPUs that went idle since they last ran something, the
+	 * bitmap walk skips busy CPUs a word at a time. CPUs running only
+	 * SCHED_IDLE tasks are not in the mask and are not found this way.
+	 */
+	if (sched_feat(SIS_IDLE_MASK) && sd->shared)
+		cpumask_and(cpus, cpus, sds_idle_cpus(sd->shared));
 
+	schedstat_inc(this_rq()->sis_search);
 	for_each_cpu_wrap(cpu, cpus, target) {
+		schedstat_inc(this_rq()->sis_scanned);
 		if (!--nr)
 			return -1;
 		if (available_idle_cpu(cpu) || sched_idle_cpu(cpu))
@@ -6152,6 +6224,60 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 	return cpu;
 }
 
+/*
+ * Track which CPUs of the LLC are idle so that select_idle_cpu() and
+ * select_idle_core() only need to look at those. Called with the rq lock
+ * held when the idle task is picked and put.
+ */
+void update_idle_cpumask(struct rq *rq, bool idle)
+{
+	struct sched_domain_shared *sds;
+	struct cpumask *mask;
+	int cpu = cpu_of(rq);
+
+	if (!sched_feat(SIS_IDLE_MASK))
+		return;
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, cpu));
+	if (sds) {
+		mask = sds_idle_cpus(sds);
+		/* avoid dirtying the shared cacheline when nothing changes */
+		if (cpumask_test_cpu(cpu, mask) != idle) {
+			if (idle)
+				cpumask_set_cpu(cpu, mask);
+			else
+				cpumask_clear_cpu(cpu, mask);
+		}
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Scan the cluster (CPUs sharing L2 or a mesh stop below the LLC) of the
+ * target for an idle CPU. Clusters are only a handful of CPUs wide, so this
+ * is cheap and keeps the wakee close to the waker's cache.
+ */
+static int select_idle_cluster(struct task_struct *p, int target)
+{
+	struct cpumask *cpus = this_cpu_cpumask_var_ptr(select_idle_mask);
+	struct sched_domain *sd;
+	int cpu;
+
+	sd = rcu_dereference(per_cpu(sd_cluster, target));
+	if (!sd)
+		return -1;
+
+	cpumask_and(cpus, sched_domain_span(sd), p->cpus_ptr);
+
+	for_each_cpu_wrap(cpu, cpus, target) {
+		if (available_idle_cpu(cpu) || sched_idle_cpu(cpu))
+			return cpu;
+	}
+
+	return -1;
+}
+
 /*
  * Scan the asym_capacity domain for idle CPUs; pick the first idle one on which
  * the task fits. If no CPU is big enough, but there are idle ones, try to
@@ -6259,9 +6385,21 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	if (!sd)
 		return target;
 
-	i = select_idle_core(p, sd, target);
-	if ((unsigned)i < nr_cpumask_bits)
-		return i;
+	if (sched_feat(SIS_CLUSTER)) {
+		i = select_idle_cluster(p, target);
+		if ((unsigned)i < nr_cpumask_bits)
+			return i;
+	}
+
+	/*
+	 * Looking for a fully idle core walks the whole LLC; don't make
+	 * latency sensitive tasks pay for that.
+	 */
+	if (p->se.latency_nice >= 0) {
+		i = select_idle_core(p, sd, target);
+		if ((unsigned)i < nr_cpumask_bits)
+			return i;
+	}
 
 	i = select_idle_cpu(p, sd, target);
 	if ((unsigned)i < nr_cpumask_bits)
@@ -6819,6 +6957,16 @@ static unsigned long wakeup_gran(struct sched_entity *se)
 	return calc_delta_fair(gran, se);
 }
 
+/*
+ * Latency nice shifts an entity's position for wakeup preemption by up to
+ * one sched_latency period, without changing its share of CPU time.
+ */
+static inline long latency_offset(struct sched_entity *se)
+{
+	return (long)se->latency_nice *
+	       (long)(sysctl_sched_latency / LATENCY_NICE_WIDTH);
+}
+
 /*
  * Should 'se' preempt 'curr'.
  *
@@ -6838,6 +6986,7 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 {
 	s64 gran, vdiff = curr->vruntime - se->vruntime;
 
+	vdiff += latency_offset(curr) - latency_offset(se);
 	if (vdiff <= 0)
 		return -1;
 
@@ -7415,6 +7564,37 @@ static int task_hot(struct task_struct *p, struct lb_env *env)
 }
 
 #ifdef CONFIG_NUMA_BALANCING
+/*
+ * A task is considered memory bound on @nid when at least 3/4 of its
+ * recent NUMA hinting faults hit memory on that node.
+ */
+static bool task_numa_memory_bound(struct task_struct *p, int nid)
+{
+	unsigned long total = p->total_numa_faults;
+
+	return total && task_faults(p, nid) * 4 >= total * 3;
+}
+
+/*
+ * Is the imbalance left to fix small enough, at most about two tasks
+ * worth, that it is not worth breaking a task's memory locality for it?
+ */
+static bool numa_imbalance_tolerable(struct lb_env *env)
+{
+	unsigned int nr = max(env->src_rq->cfs.h_nr_running, 1U);
+
+	switch (env->migration_type) {
+	case migrate_load:
+		return env->imbalance * nr <= 2 * cpu_load(env->src_rq);
+	case migrate_util:
+		return env->imbalance * nr <= 2 * cpu_util(env->src_cpu);
+	case migrate_task:
+		return env->imbalance <= 2;
+	default:
+		return false;
+	}
+}
+
 /*
  * Returns 1, if task migration degrades locality
  * Returns 0, if task migration improves locality i.e migration preferred.
@@ -7442,8 +7622,18 @@ static int migrate_degrades_locality(struct task_struct *p, struct lb_env *env)
 	if (src_nid == p->numa_preferred_nid) {
 		if (env->src_rq->nr_running > env->src_rq->nr_preferred_running)
 			return 1;
-		else
-			return -1;
+
+		/*
+		 * Even when every task here prefers this node, keep the
+		 * memory bound ones on it while the imbalance is small. A
+		 * persistent imbalance still gets fixed once the balancer
+		 * has failed more than cache_nice_tries times.
+		 */
+		if (task_numa_memory_bound(p, src_nid) &&
+		    numa_imbalance_tolerable(env))
+			return 1;
+
+		return -1;
 	}
 
 	/* Encourage migration to the preferred node. */
@@ -11050,6 +11240,7 @@ void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
 	se->my_q = cfs_rq;
 	/* guarantee group entities always have weight */
 	update_load_set(&se->load, NICE_0_LOAD);
+	se->latency_nice = tg->latency_nice;
 	se->parent = parent;
 }
 
@@ -11087,6 +11278,38 @@ int sched_group_set_shares(struct task_group *tg, unsigned long shares)
 		rq_unlock_irqrestore(rq, &rf);
 	}
 
+done:
+	mutex_unlock(&shares_mutex);
+	return 0;
+}
+
+int sched_group_set_latency(struct task_group *tg, int latency_nice)
+{
+	int i;
+
+	/*
+	 * We can't change the latency nice of the root cgroup.
+	 */
+	if (!tg->se[0])
+		return -EINVAL;
+
+	if (latency_nice < MIN_LATENCY_NICE || latency_nice > MAX_LATENCY_NICE)
+		return -EINVAL;
+
+	mutex_lock(&shares_mutex);
+	if (tg->latency_nice == latency_nice)
+		goto done;
+
+	tg->latency_nice = latency_nice;
+	for_each_possible_cpu(i) {
+		struct rq *rq = cpu_rq(i);
+		struct rq_flags rf;
+
+		rq_lock_irqsave(rq, &rf);
+		tg->se[i]->latency_nice = latency_nice;
+		rq_unlock_irqrestore(rq, &rf);
+	}
+
 done:
 	mutex_unlock(&shares_mutex);
 	return 0;
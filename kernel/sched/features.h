@@ -51,11 +51,32 @@ SCHED_FEAT(NONTASK_CAPACITY, true)
  */
 SCHED_FEAT(TTWU_QUEUE, true)
 
+/*
+ * Also queue remote wakeups between CPUs of the same LLC that sit in
+ * different clusters, for systems where the LLC spans a whole socket.
+ */
+SCHED_FEAT(TTWU_QUEUE_CLUSTER, true)
+
+/*
+ * Let wake_up_q() queue all its remote wakeups first and then send the
+ * IPIs in one go, instead of one IPI per woken task.
+ */
+SCHED_FEAT(TTWU_QUEUE_BATCH, true)
+
 /*
  * When doing wakeups, attempt to limit superfluous scans of the LLC domain.
  */
 SCHED_FEAT(SIS_AVG_CPU, false)
 SCHED_FEAT(SIS_PROP, true)
+/*
+ * Look for an idle CPU in the target's cluster before scanning the
+ * whole LLC.
+ */
+SCHED_FEAT(SIS_CLUSTER, true)
+/*
+ * Restrict the LLC scans to CPUs found in the per-LLC idle CPU mask.
+ */
+SCHED_FEAT(SIS_IDLE_MASK, true)
 
 /*
  * Issue a WARN when we do multiple update_rq_clock() calls
@@ -90,3 +111,9 @@ SCHED_FEAT(WA_BIAS, true)
  */
 SCHED_FEAT(UTIL_EST, true)
 SCHED_FEAT(UTIL_EST_FASTUP, true)
+
+/*
+ * Defer the PELT resync of already enqueued ancestors on enqueue and
+ * dequeue when it was done less than a PELT period ago.
+ */
+SCHED_FEAT(LAZY_GROUP_PELT, true)
@@ -14,6 +14,9 @@ EXPORT_SYMBOL_GPL(housekeeping_overridden);
 static cpumask_var_t housekeeping_mask;
 static unsigned int housekeeping_flags;
 
+/* CPUs isolated at runtime through cpuset, on top of the boot time masks */
+static struct cpumask housekeeping_isolated;
+
 bool housekeeping_enabled(enum hk_flags flags)
 {
 	return !!(housekeeping_flags & flags);
@@ -32,6 +35,14 @@ int housekeeping_any_cpu(enum hk_flags flags)
 
 			return cpumask_any_and(housekeeping_mask, cpu_online_mask);
 		}
+
+		cpu = smp_processor_id();
+		if (cpumask_test_cpu(cpu, &housekeeping_isolated)) {
+			for_each_online_cpu(cpu) {
+				if (!cpumask_test_cpu(cpu, &housekeeping_isolated))
+					return cpu;
+			}
+		}
 	}
 	return smp_processor_id();
 }
@@ -63,6 +74,39 @@ bool housekeeping_test_cpu(int cpu, enum hk_flags flags)
 }
 EXPORT_SYMBOL_GPL(housekeeping_test_cpu);
 
+bool housekeeping_cpu_isolated(int cpu)
+{
+	if ((housekeeping_flags & (HK_FLAG_DOMAIN | HK_FLAG_TICK)) &&
+	    !cpumask_test_cpu(cpu, housekeeping_mask))
+		return true;
+
+	return cpumask_test_cpu(cpu, &housekeeping_isolated);
+}
+EXPORT_SYMBOL_GPL(housekeeping_cpu_isolated);
+
+/**
+ * housekeeping_update_isolated - set the CPUs isolated at runtime
+ * @mask: CPUs that should no longer run per-CPU housekeeping chores
+ *
+ * Called by cpuset with its lock held whenever the set of isolated
+ * cpusets or their CPUs change. Per-CPU work such as vmstat folding and
+ * LRU pagevec batching is then kept off these CPUs; see cpu_is_isolated().
+ *
+ * Returns -EINVAL if @mask would leave no online CPU for housekeeping.
+ */
+int housekeeping_update_isolated(const struct cpumask *mask)
+{
+	if (cpumask_subset(cpu_online_mask, mask))
+		return -EINVAL;
+
+	if (!cpumask_empty(mask))
+		static_branch_enable(&housekeeping_overridden);
+
+	cpumask_copy(&housekeeping_isolated, mask);
+
+	return 0;
+}
+
 void __init housekeeping_init(void)
 {
 	if (!housekeeping_flags)
@@ -161,7 +161,25 @@ static int membarrier_private_expedited(int flags)
 
 	cpus_read_lock();
 	rcu_read_lock();
-	for_each_online_cpu(cpu) {
+	/*
+	 * Only CPUs that ran @mm since the last call can be running it.
+	 * Drop the ones that no longer do from the mm's cpumask, then look
+	 * at them again: a CPU switching to @mm meanwhile either sees its
+	 * bit cleared and sets it, or is seen running @mm here (see
+	 * membarrier_mark_cpu()).
+	 */
+	cpumask_and(tmpmask, mm_membarrier_cpumask(mm), cpu_online_mask);
+	for_each_cpu(cpu, tmpmask) {
+		struct task_struct *p;
+
+		p = rcu_dereference(cpu_rq(cpu)->curr);
+		if (!p || p->mm != mm)
+			cpumask_clear_cpu(cpu, mm_membarrier_cpumask(mm));
+	}
+
+	smp_mb();	/* Clear the mask before reading rq->curr again. */
+
+	for_each_cpu(cpu, tmpmask) {
 		struct task_struct *p;
 
 		/*
@@ -172,11 +190,17 @@ static int membarrier_private_expedited(int flags)
 		 * thread. Therefore, we can skip this CPU from the
 		 * iteration.
 		 */
-		if (cpu == raw_smp_processor_id())
+		if (cpu == raw_smp_processor_id()) {
+			__cpumask_clear_cpu(cpu, tmpmask);
 			continue;
+		}
 		p = rcu_dereference(cpu_rq(cpu)->curr);
-		if (p && p->mm == mm)
-			__cpumask_set_cpu(cpu, tmpmask);
+		if (p && p->mm == mm) {
+			if (!cpumask_test_cpu(cpu, mm_membarrier_cpumask(mm)))
+				cpumask_set_cpu(cpu, mm_membarrier_cpumask(mm));
+		} else {
+			__cpumask_clear_cpu(cpu, tmpmask);
+		}
 	}
 	rcu_read_unlock();
 
@@ -196,6 +196,7 @@ static void group_init(struct psi_group *group)
 	memset(group->nr_triggers, 0, sizeof(group->nr_triggers));
 	group->poll_states = 0;
 	group->poll_min_period = U32_MAX;
+	group->poll_kick_threshold = U32_MAX;
 	memset(group->polling_total, 0, sizeof(group->polling_total));
 	group->polling_next_update = ULLONG_MAX;
 	group->polling_until = 0;
@@ -623,8 +624,8 @@ static void psi_poll_work(struct kthread_work *work)
 	mutex_unlock(&group->trigger_lock);
 }
 
-static void record_times(struct psi_group_cpu *groupc, int cpu,
-			 bool memstall_tick)
+static u32 record_times(struct psi_group_cpu *groupc, int cpu,
+			bool memstall_tick)
 {
 	u32 delta;
 	u64 now;
@@ -667,6 +668,30 @@ static void record_times(struct psi_group_cpu *groupc, int cpu,
 
 	if (groupc->state_mask & (1 << PSI_NONIDLE))
 		groupc->times[PSI_NONIDLE] += delta;
+
+	return delta;
+}
+
+/*
+ * Waking the poller means aggregating every CPU of the group, so only do
+ * it once this CPU alone has spent a tenth of the smallest trigger
+ * threshold in monitored states. A trigger can't fire before then: its
+ * growth is a weighted average of the per-CPU stall times. Once polling,
+ * the poller reschedules itself for the duration of the window.
+ */
+static bool psi_poll_account(struct psi_group *group,
+			     struct psi_group_cpu *groupc,
+			     u32 state_mask, u32 delta)
+{
+	if (!(state_mask & READ_ONCE(group->poll_states)))
+		return false;
+
+	groupc->poll_pending += delta;
+	if (groupc->poll_pending < READ_ONCE(group->poll_kick_threshold))
+		return false;
+
+	groupc->poll_pending = 0;
+	return true;
 }
 
 static void psi_group_change(struct psi_group *group, int cpu,
@@ -677,6 +702,8 @@ static void psi_group_change(struct psi_group *group, int cpu,
 	u32 state_mask = 0;
 	unsigned int t, m;
 	enum psi_states s;
+	bool kick;
+	u32 delta;
 
 	groupc = per_cpu_ptr(group->pcpu, cpu);
 
@@ -690,7 +717,8 @@ static void psi_group_change(struct psi_group *group, int cpu,
 	 */
 	write_seqcount_begin(&groupc->seq);
 
-	record_times(groupc, cpu, false);
+	delta = record_times(groupc, cpu, false);
+	kick = psi_poll_account(group, groupc, groupc->state_mask, delta);
 
 	for (t = 0, m = clear; m; m &= ~(1 << t), t++) {
 		if (!(m & (1 << t)))
@@ -718,7 +746,7 @@ static void psi_group_change(struct psi_group *group, int cpu,
 
 	write_seqcount_end(&groupc->seq);
 
-	if (state_mask & group->poll_states)
+	if (kick)
 		psi_schedule_poll_work(group, 1);
 
 	if (wake_clock && !delayed_work_pending(&group->avgs_work))
@@ -842,11 +870,17 @@ void psi_memstall_tick(struct task_struct *task, int cpu)
 
 	while ((group = iterate_groups(task, &iter))) {
 		struct psi_group_cpu *groupc;
+		bool kick;
+		u32 delta;
 
 		groupc = per_cpu_ptr(group->pcpu, cpu);
 		write_seqcount_begin(&groupc->seq);
-		record_times(groupc, cpu, true);
+		delta = record_times(groupc, cpu, true);
+		kick = psi_poll_account(group, groupc, groupc->state_mask, delta);
 		write_seqcount_end(&groupc->seq);
+
+		if (kick)
+			psi_schedule_poll_work(group, 1);
 	}
 }
 
@@ -1120,8 +1154,11 @@ struct psi_trigger *psi_trigger_create(struct psi_group *group,
 	list_add(&t->node, &group->triggers);
 	group->poll_min_period = min(group->poll_min_period,
 		div_u64(t->win.size, UPDATES_PER_WINDOW));
+	WRITE_ONCE(group->poll_kick_threshold, min_t(u64,
+		group->poll_kick_threshold,
+		div_u64(t->threshold, UPDATES_PER_WINDOW)));
 	group->nr_triggers[t->state]++;
-	group->poll_states |= (1 << t->state);
+	WRITE_ONCE(group->poll_states, group->poll_states | (1 << t->state));
 
 	mutex_unlock(&group->trigger_lock);
 
@@ -1148,16 +1185,22 @@ static void psi_trigger_destroy(struct kref *ref)
 	if (!list_empty(&t->node)) {
 		struct psi_trigger *tmp;
 		u64 period = ULLONG_MAX;
+		u64 kick = U32_MAX;
 
 		list_del(&t->node);
 		group->nr_triggers[t->state]--;
 		if (!group->nr_triggers[t->state])
-			group->poll_states &= ~(1 << t->state);
+			WRITE_ONCE(group->poll_states,
+				   group->poll_states & ~(1 << t->state));
 		/* reset min update period for the remaining triggers */
-		list_for_each_entry(tmp, &group->triggers, node)
+		list_for_each_entry(tmp, &group->triggers, node) {
 			period = min(period, div_u64(tmp->win.size,
 					UPDATES_PER_WINDOW));
+			kick = min(kick, div_u64(tmp->threshold,
+					UPDATES_PER_WINDOW));
+		}
 		group->poll_min_period = period;
+		WRITE_ONCE(group->poll_kick_threshold, kick);
 		/* Destroy poll_kworker when the last trigger is destroyed */
 		if (group->poll_states == 0) {
 			group->polling_until = 0;
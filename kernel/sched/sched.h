@@ -345,6 +345,7 @@ struct cfs_bandwidth {
 	ktime_t			period;
 	u64			quota;
 	u64			runtime;
+	u64			burst;
 	s64			hierarchical_quota;
 
 	u8			idle;
@@ -371,6 +372,8 @@ struct task_group {
 	/* runqueue "owned" by this group on each CPU */
 	struct cfs_rq		**cfs_rq;
 	unsigned long		shares;
+	/* latency nice of this group's entities */
+	int			latency_nice;
 
 #ifdef	CONFIG_SMP
 	/*
@@ -480,6 +483,7 @@ extern void sched_move_task(struct task_struct *tsk);
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
+extern int sched_group_set_latency(struct task_group *tg, int latency_nice);
 
 #ifdef CONFIG_SMP
 extern void set_task_rq_fair(struct sched_entity *se,
@@ -866,6 +870,14 @@ struct uclamp_rq {
 DECLARE_STATIC_KEY_FALSE(sched_uclamp_used);
 #endif /* CONFIG_UCLAMP_TASK */
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Run delay histogram buckets: bucket 0 counts delays below 1us, bucket
+ * i counts delays in [2^(i-1), 2^i) us and the last one everything above.
+ */
+#define RQ_LAT_NR_BUCKETS	24
+#endif
+
 /*
  * This is the main, per-CPU runqueue data structure.
  *
@@ -1023,12 +1035,44 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int		ttwu_count;
 	unsigned int		ttwu_local;
+
+	/* select_idle_cpu() stats */
+	unsigned int		sis_search;
+	unsigned int		sis_scanned;
+
+	/* log2 histogram of run delays, see /proc/sched_rq_latency */
+	unsigned long		run_delay_hist[RQ_LAT_NR_BUCKETS];
 #endif
 
 #ifdef CONFIG_CPU_IDLE
 	/* Must be inspected within a rcu lock section */
 	struct cpuidle_state	*idle_state;
 #endif
+
+#ifdef CONFIG_SCHED_CORE
+	/* Queued tasks, ordered by cookie */
+	struct rb_root		core_tree;
+
+	/*
+	 * Serializes task selection across the SMT core; only the lock of
+	 * the first sibling is used, see sched_core_lock().
+	 */
+	raw_spinlock_t		core_lock;
+
+	/* What this CPU runs, as seen by its siblings; under core_lock */
+	unsigned long		core_cookie;
+	unsigned int		core_prio;
+	bool			core_idle;
+
+	/* Forced idle waiting for a sibling to make room for a task */
+	bool			core_wait;
+	unsigned int		core_wait_prio;
+	unsigned long		core_wait_cookie;
+	u64			core_wait_start;
+
+	struct irq_work		core_kick_work;
+	unsigned int		core_forceidle_count;
+#endif
 };
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -1070,6 +1114,12 @@ static inline void update_idle_core(struct rq *rq)
 static inline void update_idle_core(struct rq *rq) { }
 #endif
 
+#ifdef CONFIG_SMP
+extern void update_idle_cpumask(struct rq *rq, bool idle);
+#else
+static inline void update_idle_cpumask(struct rq *rq, bool idle) { }
+#endif
+
 DECLARE_PER_CPU_SHARED_ALIGNED(struct rq, runqueues);
 
 #define cpu_rq(cpu)		(&per_cpu(runqueues, (cpu)))
@@ -1078,6 +1128,30 @@ DECLARE_PER_CPU_SHARED_ALIGNED(struct rq, runqueues);
 #define cpu_curr(cpu)		(cpu_rq(cpu)->curr)
 #define raw_rq()		raw_cpu_ptr(&runqueues)
 
+#ifdef CONFIG_SCHED_CORE
+DECLARE_STATIC_KEY_FALSE(__sched_core_enabled);
+
+static inline bool sched_core_enabled(struct rq *rq)
+{
+	return static_branch_unlikely(&__sched_core_enabled);
+}
+
+static inline bool sched_core_enqueued(struct task_struct *p)
+{
+	return !RB_EMPTY_NODE(&p->core_node);
+}
+
+extern void sched_core_enqueue(struct rq *rq, struct task_struct *p);
+extern void sched_core_dequeue(struct rq *rq, struct task_struct *p);
+extern void sched_core_get(void);
+extern bool task_cfs_throttled(struct task_struct *p);
+#else
+static inline bool sched_core_enabled(struct rq *rq)
+{
+	return false;
+}
+#endif
+
 extern void update_rq_clock(struct rq *rq);
 
 static inline u64 __rq_clock_broken(struct rq *rq)
@@ -1421,6 +1495,8 @@ DECLARE_PER_CPU(struct sched_domain __rcu *, sd_llc);
 DECLARE_PER_CPU(int, sd_llc_size);
 DECLARE_PER_CPU(int, sd_llc_id);
 DECLARE_PER_CPU(struct sched_domain_shared __rcu *, sd_llc_shared);
+DECLARE_PER_CPU(struct sched_domain __rcu *, sd_cluster);
+DECLARE_PER_CPU(int, sd_cluster_id);
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_numa);
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_asym_packing);
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_asym_cpucapacity);
@@ -2569,12 +2645,34 @@ static inline void membarrier_switch_mm(struct rq *rq,
 
 	WRITE_ONCE(rq->membarrier_state, membarrier_state);
 }
+
+/*
+ * Called after the barrier that follows the store to rq->curr: either we
+ * see our CPU in @mm's membarrier cpumask, or membarrier_private_expedited()
+ * sees @mm in rq->curr after it cleared the CPU from the mask.
+ */
+static inline void membarrier_mark_cpu(struct rq *rq, struct mm_struct *mm)
+{
+	int cpu = cpu_of(rq);
+
+	if (!mm || !(READ_ONCE(rq->membarrier_state) &
+		     (MEMBARRIER_STATE_PRIVATE_EXPEDITED |
+		      MEMBARRIER_STATE_PRIVATE_EXPEDITED_SYNC_CORE)))
+		return;
+
+	if (!cpumask_test_cpu(cpu, mm_membarrier_cpumask(mm)))
+		cpumask_set_cpu(cpu, mm_membarrier_cpumask(mm));
+}
 #else
 static inline void membarrier_switch_mm(struct rq *rq,
 					struct mm_struct *prev_mm,
 					struct mm_struct *next_mm)
 {
 }
+
+static inline void membarrier_mark_cpu(struct rq *rq, struct mm_struct *mm)
+{
+}
 #endif
 
 #ifdef CONFIG_SMP
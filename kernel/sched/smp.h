@@ -7,3 +7,4 @@
 extern void sched_ttwu_pending(void *arg);
 
 extern void send_call_function_single_ipi(int cpu);
+extern bool __smp_call_single_queue_noipi(int cpu, struct llist_node *node);
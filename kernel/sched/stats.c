@@ -10,7 +10,7 @@
  * Bump this up when changing the output format or the meaning of an existing
  * format, so that tools can adapt (or abort)
  */
-#define SCHEDSTAT_VERSION 15
+#define SCHEDSTAT_VERSION 16
 
 static int show_schedstat(struct seq_file *seq, void *v)
 {
@@ -30,12 +30,13 @@ static int show_schedstat(struct seq_file *seq, void *v)
 
 		/* runqueue-specific stats */
 		seq_printf(seq,
-		    "cpu%d %u 0 %u %u %u %u %llu %llu %lu",
+		    "cpu%d %u 0 %u %u %u %u %llu %llu %lu %u %u",
 		    cpu, rq->yld_count,
 		    rq->sched_count, rq->sched_goidle,
 		    rq->ttwu_count, rq->ttwu_local,
 		    rq->rq_cpu_time,
-		    rq->rq_sched_info.run_delay, rq->rq_sched_info.pcount);
+		    rq->rq_sched_info.run_delay, rq->rq_sched_info.pcount,
+		    rq->sis_search, rq->sis_scanned);
 
 		seq_printf(seq, "\n");
 
@@ -120,9 +121,48 @@ static const struct seq_operations schedstat_sops = {
 	.show  = show_schedstat,
 };
 
+/*
+ * /proc/sched_rq_latency: per-CPU log2 histogram of the time tasks spent
+ * waiting on the runqueue before getting the CPU. The header lists the
+ * lower bound of each bucket in (2^10 ns) units.
+ */
+#define RQ_LATENCY_VERSION 1
+
+static int show_rq_latency(struct seq_file *seq, void *v)
+{
+	int cpu, i;
+
+	if (v == (void *)1) {
+		seq_printf(seq, "version %d\n", RQ_LATENCY_VERSION);
+		seq_puts(seq, "buckets_us 0");
+		for (i = 1; i < RQ_LAT_NR_BUCKETS; i++)
+			seq_printf(seq, " %lu", 1UL << (i - 1));
+		seq_putc(seq, '\n');
+	} else {
+		struct rq *rq;
+
+		cpu = (unsigned long)(v - 2);
+		rq = cpu_rq(cpu);
+
+		seq_printf(seq, "cpu%d", cpu);
+		for (i = 0; i < RQ_LAT_NR_BUCKETS; i++)
+			seq_printf(seq, " %lu", READ_ONCE(rq->run_delay_hist[i]));
+		seq_putc(seq, '\n');
+	}
+	return 0;
+}
+
+static const struct seq_operations rq_latency_sops = {
+	.start = schedstat_start,
+	.next  = schedstat_next,
+	.stop  = schedstat_stop,
+	.show  = show_rq_latency,
+};
+
 static int __init proc_schedstat_init(void)
 {
 	proc_create_seq("schedstat", 0, NULL, &schedstat_sops);
+	proc_create_seq("sched_rq_latency", 0, NULL, &rq_latency_sops);
 	return 0;
 }
 subsys_initcall(proc_schedstat_init);
@@ -5,12 +5,24 @@
 /*
  * Expects runqueue lock to be held for atomicity of update
  */
+static inline unsigned int rq_lat_bucket(unsigned long long delta)
+{
+	/* Close enough to microseconds, and avoids a division. */
+	unsigned long long us = delta >> 10;
+
+	if (!us)
+		return 0;
+
+	return min_t(unsigned int, ilog2(us) + 1, RQ_LAT_NR_BUCKETS - 1);
+}
+
 static inline void
 rq_sched_info_arrive(struct rq *rq, unsigned long long delta)
 {
 	if (rq) {
 		rq->rq_sched_info.run_delay += delta;
 		rq->rq_sched_info.pcount++;
+		rq->run_delay_hist[rq_lat_bucket(delta)]++;
 	}
 }
 
@@ -146,10 +146,20 @@ void __smp_call_single_queue(int cpu, struct llist_node *node)
 	 * locking and barrier primitives. Generic code isn't really
 	 * equipped to do the right thing...
 	 */
-	if (llist_add(node, &per_cpu(call_single_queue, cpu)))
+	if (__smp_call_single_queue_noipi(cpu, node))
 		send_call_function_single_ipi(cpu);
 }
 
+/*
+ * Like __smp_call_single_queue() but leave the IPI to the caller, which
+ * must send it if this returns true (the queue was empty). The scheduler
+ * uses this to coalesce the IPIs of a batch of remote wakeups.
+ */
+bool __smp_call_single_queue_noipi(int cpu, struct llist_node *node)
+{
+	return llist_add(node, &per_cpu(call_single_queue, cpu));
+}
+
 /*
  * Insert a previously allocated call_single_data_t element
  * for execution on the given CPU. data must already have
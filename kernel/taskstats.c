@@ -551,6 +551,59 @@ static int taskstats_user_cmd(struct sk_buff *skb, struct genl_info *info)
 		return -EINVAL;
 }
 
+/*
+ * Walk the caller's pid namespace and emit one TASKSTATS_TYPE_AGGR_PID
+ * message per task, so that statistics for all tasks can be collected
+ * with a single dump instead of one request per pid. cb->args[0] holds
+ * the pid to resume from.
+ */
+static int taskstats_user_dumpit(struct sk_buff *skb,
+				 struct netlink_callback *cb)
+{
+	struct pid_namespace *pid_ns = task_active_pid_ns(current);
+	struct user_namespace *user_ns = current_user_ns();
+	struct taskstats *stats;
+	struct task_struct *tsk;
+	struct pid *pid;
+	void *reply;
+	u32 nr;
+
+	for (nr = cb->args[0]; ; nr++) {
+		rcu_read_lock();
+		pid = find_ge_pid(nr, pid_ns);
+		if (!pid) {
+			rcu_read_unlock();
+			break;
+		}
+		nr = pid_nr_ns(pid, pid_ns);
+		tsk = pid_task(pid, PIDTYPE_PID);
+		if (tsk)
+			get_task_struct(tsk);
+		rcu_read_unlock();
+		if (!tsk)
+			continue;
+
+		reply = genlmsg_put(skb, NETLINK_CB(cb->skb).portid,
+				    cb->nlh->nlmsg_seq, &family, NLM_F_MULTI,
+				    TASKSTATS_CMD_NEW);
+		stats = reply ? mk_reply(skb, TASKSTATS_TYPE_PID, nr) : NULL;
+		if (!stats) {
+			/* Out of room, resume from this task next time */
+			if (reply)
+				genlmsg_cancel(skb, reply);
+			put_task_struct(tsk);
+			break;
+		}
+
+		fill_stats(user_ns, pid_ns, tsk, stats);
+		put_task_struct(tsk);
+		genlmsg_end(skb, reply);
+	}
+
+	cb->args[0] = nr;
+	return skb->len;
+}
+
 static struct taskstats *taskstats_tgid_alloc(struct task_struct *tsk)
 {
 	struct signal_struct *sig = tsk->signal;
@@ -649,6 +702,7 @@ static const struct genl_ops taskstats_ops[] = {
 		.cmd		= TASKSTATS_CMD_GET,
 		.validate = GENL_DONT_VALIDATE_STRICT | GENL_DONT_VALIDATE_DUMP,
 		.doit		= taskstats_user_cmd,
+		.dumpit		= taskstats_user_dumpit,
 		/* policy enforced later */
 		.flags		= GENL_ADMIN_PERM | GENL_CMD_CAP_HASPOL,
 	},
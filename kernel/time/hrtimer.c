@@ -1012,6 +1012,36 @@ static void __remove_hrtimer(struct hrtimer *timer,
 /*
  * remove hrtimer, called with base lock held
  */
+#ifdef CONFIG_HRTIMER_BATCH_EXPIRY
+/*
+ * Take back a timer which was detached for batched expiry but whose
+ * callback has not been invoked yet, as if it was still enqueued.  That is
+ * only possible on the CPU which runs the batch: it is either executing a
+ * callback of the same batch or has interrupted the expiry, so it cannot
+ * race with hrtimer_run_batch().  Other CPUs treat batched timers as
+ * running their callback.
+ */
+static bool hrtimer_drop_batched(struct hrtimer *timer,
+				 struct hrtimer_clock_base *base)
+{
+	u8 slot = timer->batch_state;
+
+	if (slot == HRTIMER_BATCH_NONE || slot == HRTIMER_BATCH_RUNNING ||
+	    base->cpu_base != this_cpu_ptr(&hrtimer_bases))
+		return false;
+
+	base->batch[slot - 1] = NULL;
+	WRITE_ONCE(timer->batch_state, HRTIMER_BATCH_NONE);
+	return true;
+}
+#else
+static inline bool hrtimer_drop_batched(struct hrtimer *timer,
+					struct hrtimer_clock_base *base)
+{
+	return false;
+}
+#endif
+
 static inline int
 remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base, bool restart)
 {
@@ -1088,6 +1118,7 @@ static int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 	struct hrtimer_clock_base *new_base;
 
 	/* Remove an active timer from the queue: */
+	hrtimer_drop_batched(timer, base);
 	remove_hrtimer(timer, base, true);
 
 	if (mode & HRTIMER_MODE_REL)
@@ -1152,6 +1183,7 @@ int hrtimer_try_to_cancel(struct hrtimer *timer)
 {
 	struct hrtimer_clock_base *base;
 	unsigned long flags;
+	bool batched;
 	int ret = -1;
 
 	/*
@@ -1165,8 +1197,9 @@ int hrtimer_try_to_cancel(struct hrtimer *timer)
 
 	base = lock_hrtimer_base(timer, &flags);
 
+	batched = hrtimer_drop_batched(timer, base);
 	if (!hrtimer_callback_running(timer))
-		ret = remove_hrtimer(timer, base, false);
+		ret = remove_hrtimer(timer, base, false) || batched;
 
 	unlock_hrtimer_base(timer, &flags);
 
@@ -1446,7 +1479,7 @@ bool hrtimer_active(const struct hrtimer *timer)
 		seq = raw_read_seqcount_begin(&base->seq);
 
 		if (timer->state != HRTIMER_STATE_INACTIVE ||
-		    base->running == timer)
+		    base->running == timer || hrtimer_is_batched(timer))
 			return true;
 
 	} while (read_seqcount_retry(&base->seq, seq) ||
@@ -1549,6 +1582,123 @@ static void __run_hrtimer(struct hrtimer_cpu_base *cpu_base,
 	base->running = NULL;
 }
 
+#ifdef CONFIG_HRTIMER_BATCH_EXPIRY
+/*
+ * Detach up to HRTIMER_EXPIRY_BATCH timers of @base which expired at
+ * @basenow.  They stay active and count as running their callback until
+ * hrtimer_run_batch() is done with them.
+ */
+static int hrtimer_collect_batch(struct hrtimer_clock_base *base,
+				 ktime_t basenow)
+{
+	struct timerqueue_node *node;
+	int nr = 0;
+
+	lockdep_assert_held(&base->cpu_base->lock);
+
+	while (nr < HRTIMER_EXPIRY_BATCH &&
+	       (node = timerqueue_getnext(&base->active))) {
+		struct hrtimer *timer = container_of(node, struct hrtimer, node);
+
+		/* See the softexpires comment in __hrtimer_run_queues() */
+		if (basenow < hrtimer_get_softexpires_tv64(timer))
+			break;
+
+		debug_deactivate(timer);
+		base->batch[nr] = timer;
+		timer->batch_state = ++nr;
+
+		/* Same as the ->running assignment in __run_hrtimer() */
+		raw_write_seqcount_barrier(&base->seq);
+
+		__remove_hrtimer(timer, base, HRTIMER_STATE_INACTIVE, 0);
+
+		if (IS_ENABLED(CONFIG_TIME_LOW_RES))
+			timer->is_rel = false;
+	}
+
+	return nr;
+}
+
+/*
+ * Run the callbacks of the @nr timers collected by hrtimer_collect_batch().
+ * The lock is only retaken for timers which have to be restarted.
+ */
+static void hrtimer_run_batch(struct hrtimer_cpu_base *cpu_base,
+			      struct hrtimer_clock_base *base, ktime_t *now,
+			      unsigned long flags, int nr)
+	__must_hold(&cpu_base->lock)
+{
+	enum hrtimer_restart (*fn)(struct hrtimer *);
+	unsigned long irqflags;
+	bool expires_in_hardirq;
+	struct hrtimer *timer;
+	int i, restart;
+
+	raw_spin_unlock_irqrestore(&cpu_base->lock, flags);
+
+	for (i = 0; i < nr; i++) {
+		/*
+		 * An interrupt on this CPU may take the timer back, see
+		 * hrtimer_drop_batched(), so claim it with interrupts off.
+		 */
+		local_irq_save(irqflags);
+		timer = base->batch[i];
+		if (timer) {
+			base->batch[i] = NULL;
+			WRITE_ONCE(timer->batch_state, HRTIMER_BATCH_RUNNING);
+		}
+		local_irq_restore(irqflags);
+
+		if (!timer)
+			continue;
+
+		fn = timer->function;
+		trace_hrtimer_expire_entry(timer, now);
+		expires_in_hardirq = lockdep_hrtimer_enter(timer);
+
+		restart = fn(timer);
+
+		lockdep_hrtimer_exit(expires_in_hardirq);
+		trace_hrtimer_expire_exit(timer);
+
+		if (restart == HRTIMER_NORESTART) {
+			/*
+			 * Nothing is left to do with the timer.  Order the
+			 * callback before the timer can be seen inactive.
+			 */
+			smp_store_release(&timer->batch_state,
+					  HRTIMER_BATCH_NONE);
+			continue;
+		}
+
+		/* See the restart handling in __run_hrtimer() */
+		raw_spin_lock_irq(&cpu_base->lock);
+		if (!(timer->state & HRTIMER_STATE_ENQUEUED))
+			enqueue_hrtimer(timer, base, HRTIMER_MODE_ABS);
+		raw_write_seqcount_barrier(&base->seq);
+		WRITE_ONCE(timer->batch_state, HRTIMER_BATCH_NONE);
+		raw_spin_unlock_irqrestore(&cpu_base->lock, flags);
+	}
+
+	raw_spin_lock_irq(&cpu_base->lock);
+}
+
+static void __hrtimer_run_queues(struct hrtimer_cpu_base *cpu_base, ktime_t now,
+				 unsigned long flags, unsigned int active_mask)
+{
+	struct hrtimer_clock_base *base;
+	unsigned int active = cpu_base->active_bases & active_mask;
+
+	for_each_active_base(base, cpu_base, active) {
+		ktime_t basenow = ktime_add(now, base->offset);
+		int nr;
+
+		while ((nr = hrtimer_collect_batch(base, basenow)))
+			hrtimer_run_batch(cpu_base, base, &basenow, flags, nr);
+	}
+}
+#else
 static void __hrtimer_run_queues(struct hrtimer_cpu_base *cpu_base, ktime_t now,
 				 unsigned long flags, unsigned int active_mask)
 {
@@ -1587,6 +1737,7 @@ static void __hrtimer_run_queues(struct hrtimer_cpu_base *cpu_base, ktime_t now,
 		}
 	}
 }
+#endif
 
 static __latent_entropy void hrtimer_run_softirq(struct softirq_action *h)
 {
@@ -5470,10 +5470,15 @@ static void __init set_ftrace_early_graph(char *buf, int enable)
 					  "traceable\n", func);
 	}
 
-	if (enable)
+	if (enable) {
 		ftrace_graph_hash = hash;
-	else
+		if (!ftrace_hash_empty(hash))
+			static_branch_enable(&ftrace_graph_filter_enabled);
+	} else {
 		ftrace_graph_notrace_hash = hash;
+		if (!ftrace_hash_empty(hash))
+			static_branch_enable(&ftrace_graph_notrace_enabled);
+	}
 }
 #endif /* CONFIG_FUNCTION_GRAPH_TRACER */
 
@@ -5592,6 +5597,8 @@ static DEFINE_MUTEX(graph_lock);
 
 struct ftrace_hash __rcu *ftrace_graph_hash = EMPTY_HASH;
 struct ftrace_hash __rcu *ftrace_graph_notrace_hash = EMPTY_HASH;
+DEFINE_STATIC_KEY_FALSE(ftrace_graph_filter_enabled);
+DEFINE_STATIC_KEY_FALSE(ftrace_graph_notrace_enabled);
 
 enum graph_filter_type {
 	GRAPH_FILTER_NOTRACE	= 0,
@@ -5822,6 +5829,7 @@ ftrace_graph_release(struct inode *inode, struct file *file)
 {
 	struct ftrace_graph_data *fgd;
 	struct ftrace_hash *old_hash, *new_hash;
+	struct static_key_false *key;
 	struct trace_parser *parser;
 	int ret = 0;
 
@@ -5854,6 +5862,19 @@ ftrace_graph_release(struct inode *inode, struct file *file)
 
 		mutex_lock(&graph_lock);
 
+		if (fgd->type == GRAPH_FILTER_FUNCTION)
+			key = &ftrace_graph_filter_enabled;
+		else
+			key = &ftrace_graph_notrace_enabled;
+
+		/*
+		 * With the key off the hash is treated as empty, so turn it
+		 * on before publishing a non-empty hash, and off only after
+		 * publishing an empty one.
+		 */
+		if (!ftrace_hash_empty(new_hash))
+			static_branch_enable(key);
+
 		if (fgd->type == GRAPH_FILTER_FUNCTION) {
 			old_hash = rcu_dereference_protected(ftrace_graph_hash,
 					lockdep_is_held(&graph_lock));
@@ -5864,6 +5885,9 @@ ftrace_graph_release(struct inode *inode, struct file *file)
 			rcu_assign_pointer(ftrace_graph_notrace_hash, new_hash);
 		}
 
+		if (ftrace_hash_empty(new_hash))
+			static_branch_disable(key);
+
 		mutex_unlock(&graph_lock);
 
 		/*
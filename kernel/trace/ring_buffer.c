@@ -435,6 +435,12 @@ enum {
 	RB_CTX_MAX
 };
 
+/*
+ * Number of pages handed back by ring_buffer_free_read_page() that are kept
+ * for reuse: enough for a splice that fills a default sized pipe.
+ */
+#define RB_FREE_READ_PAGES	16
+
 /*
  * head_page == tail_page && head == tail then buffer is empty.
  */
@@ -446,7 +452,8 @@ struct ring_buffer_per_cpu {
 	raw_spinlock_t			reader_lock;	/* serialize readers */
 	arch_spinlock_t			lock;
 	struct lock_class_key		lock_key;
-	struct buffer_data_page		*free_page;
+	struct buffer_data_page		*free_pages[RB_FREE_READ_PAGES];
+	int				nr_free_pages;
 	unsigned long			nr_pages;
 	unsigned int			current_context;
 	struct list_head		*pages;
@@ -1349,6 +1356,10 @@ static void rb_free_cpu_buffer(struct ring_buffer_per_cpu *cpu_buffer)
 {
 	struct list_head *head = cpu_buffer->pages;
 	struct buffer_page *bpage, *tmp;
+	int i;
+
+	for (i = 0; i < cpu_buffer->nr_free_pages; i++)
+		free_page((unsigned long)cpu_buffer->free_pages[i]);
 
 	free_buffer_page(cpu_buffer->reader_page);
 
@@ -4696,10 +4707,8 @@ void *ring_buffer_alloc_read_page(struct trace_buffer *buffer, int cpu)
 	local_irq_save(flags);
 	arch_spin_lock(&cpu_buffer->lock);
 
-	if (cpu_buffer->free_page) {
-		bpage = cpu_buffer->free_page;
-		cpu_buffer->free_page = NULL;
-	}
+	if (cpu_buffer->nr_free_pages)
+		bpage = cpu_buffer->free_pages[--cpu_buffer->nr_free_pages];
 
 	arch_spin_unlock(&cpu_buffer->lock);
 	local_irq_restore(flags);
@@ -4743,8 +4752,8 @@ void ring_buffer_free_read_page(struct trace_buffer *buffer, int cpu, void *data
 	local_irq_save(flags);
 	arch_spin_lock(&cpu_buffer->lock);
 
-	if (!cpu_buffer->free_page) {
-		cpu_buffer->free_page = bpage;
+	if (cpu_buffer->nr_free_pages < RB_FREE_READ_PAGES) {
+		cpu_buffer->free_pages[cpu_buffer->nr_free_pages++] = bpage;
 		bpage = NULL;
 	}
 
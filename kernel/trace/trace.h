@@ -991,12 +991,22 @@ extern void __trace_graph_return(struct trace_array *tr,
 extern struct ftrace_hash __rcu *ftrace_graph_hash;
 extern struct ftrace_hash __rcu *ftrace_graph_notrace_hash;
 
+/*
+ * Enabled while set_graph_function and set_graph_notrace are non-empty,
+ * so that graph tracing without them doesn't touch the hashes at all.
+ */
+DECLARE_STATIC_KEY_FALSE(ftrace_graph_filter_enabled);
+DECLARE_STATIC_KEY_FALSE(ftrace_graph_notrace_enabled);
+
 static inline int ftrace_graph_addr(struct ftrace_graph_ent *trace)
 {
 	unsigned long addr = trace->func;
 	int ret = 0;
 	struct ftrace_hash *hash;
 
+	if (!static_branch_unlikely(&ftrace_graph_filter_enabled))
+		return 1;
+
 	preempt_disable_notrace();
 
 	/*
@@ -1050,6 +1060,9 @@ static inline int ftrace_graph_notrace_addr(unsigned long addr)
 	int ret = 0;
 	struct ftrace_hash *notrace_hash;
 
+	if (!static_branch_unlikely(&ftrace_graph_notrace_enabled))
+		return 0;
+
 	preempt_disable_notrace();
 
 	/*
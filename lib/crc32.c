@@ -31,6 +31,7 @@
 #include <linux/module.h>
 #include <linux/types.h>
 #include <linux/sched.h>
+#include <asm/unaligned.h>
 #include "crc32defs.h"
 
 #if CRC_LE_BITS > 8
@@ -209,6 +210,80 @@ EXPORT_SYMBOL(__crc32c_le);
 u32 __pure crc32_le_base(u32, unsigned char const *, size_t) __alias(crc32_le);
 u32 __pure __crc32c_le_base(u32, unsigned char const *, size_t) __alias(__crc32c_le);
 
+#if CRC_LE_BITS == 64 && defined(__LITTLE_ENDIAN)
+#define SLICE8_LO(q)	(t7[(q) & 255] ^ t6[((q) >> 8) & 255] ^ \
+			 t5[((q) >> 16) & 255] ^ t4[(q) >> 24])
+#define SLICE8_HI(q)	(t3[(q) & 255] ^ t2[((q) >> 8) & 255] ^ \
+			 t1[((q) >> 16) & 255] ^ t0[(q) >> 24])
+
+/*
+ * Slicing-by-8 over two independent streams at once. Each step of
+ * crc32_body() depends on the result of the one before it; interleaving
+ * two streams gives the CPU a second dependency chain to work on while
+ * the table loads of the first are in flight.
+ */
+static void crc32c_body_x2(u32 *crc, unsigned char const * const *p,
+			   size_t len)
+{
+	const u32 (*tab)[256] = (const u32 (*)[256])crc32ctable_le;
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+	const u32 *t4 = tab[4], *t5 = tab[5], *t6 = tab[6], *t7 = tab[7];
+	unsigned char const *p0 = p[0], *p1 = p[1];
+	u32 c0 = crc[0], c1 = crc[1];
+	u32 q0, q1;
+
+	for (; len >= 8; len -= 8, p0 += 8, p1 += 8) {
+		q0 = c0 ^ get_unaligned_le32(p0);
+		q1 = c1 ^ get_unaligned_le32(p1);
+		c0 = SLICE8_LO(q0);
+		c1 = SLICE8_LO(q1);
+		q0 = get_unaligned_le32(p0 + 4);
+		q1 = get_unaligned_le32(p1 + 4);
+		c0 ^= SLICE8_HI(q0);
+		c1 ^= SLICE8_HI(q1);
+	}
+
+	for (; len; len--) {
+		c0 = t0[(c0 ^ *p0++) & 255] ^ (c0 >> 8);
+		c1 = t0[(c1 ^ *p1++) & 255] ^ (c1 >> 8);
+	}
+
+	crc[0] = c0;
+	crc[1] = c1;
+}
+#undef SLICE8_LO
+#undef SLICE8_HI
+#endif
+
+/**
+ * __crc32c_le_multi() - Calculate the CRC32C of several buffers
+ * @crc: on entry, the seed of each buffer; on return, its CRC32C
+ * @p: the @nr buffers, each @len bytes long
+ * @len: length of each buffer
+ * @nr: number of buffers
+ *
+ * Equivalent to calling __crc32c_le() on each buffer in turn, but the
+ * streams are independent, so an implementation can interleave them to
+ * hide the latency of the CRC computation. Architectures with CRC
+ * instructions override this.
+ */
+void __weak __crc32c_le_multi(u32 *crc, unsigned char const * const *p,
+			      size_t len, unsigned int nr)
+{
+	unsigned int i = 0;
+
+#if CRC_LE_BITS == 64 && defined(__LITTLE_ENDIAN)
+	for (; i + 2 <= nr; i += 2)
+		crc32c_body_x2(crc + i, p + i, len);
+#endif
+	for (; i < nr; i++)
+		crc[i] = __crc32c_le(crc[i], p[i], len);
+}
+EXPORT_SYMBOL(__crc32c_le_multi);
+
+void __crc32c_le_multi_base(u32 *, unsigned char const * const *, size_t,
+			    unsigned int) __alias(__crc32c_le_multi);
+
 /*
  * This multiplies the polynomials x and y modulo the given modulus.
  * This follows the "little-endian" CRC convention that the lsbit
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * RAID6 recovery using ARM SVE, based on recov_neon_inner.c
+ */
+
+#include <arm_sve.h>
+
+/*
+ * The 32 byte multiplier tables hold the products of the low nibble in
+ * the first 16 bytes and of the high nibble in the last 16 bytes.
+ * svld1rq replicates each half into every 128-bit segment, and since
+ * the indices are always below 16, svtbl only ever selects from the
+ * first segment regardless of the vector length.
+ */
+static inline svuint8_t sve_gf_mul(svbool_t pg, svuint8_t v, svuint8_t lo,
+				   svuint8_t hi)
+{
+	svuint8_t vl = svtbl_u8(lo, svand_n_u8_x(pg, v, 0x0f));
+	svuint8_t vh = svtbl_u8(hi, svlsr_n_u8_x(pg, v, 4));
+
+	return sveor_u8_x(pg, vl, vh);
+}
+
+void __raid6_2data_recov_sve(int bytes, uint8_t *p, uint8_t *q, uint8_t *dp,
+			     uint8_t *dq, const uint8_t *pbmul,
+			     const uint8_t *qmul)
+{
+	svbool_t all = svptrue_b8();
+	svuint8_t qm0 = svld1rq_u8(all, qmul);
+	svuint8_t qm1 = svld1rq_u8(all, qmul + 16);
+	svuint8_t pm0 = svld1rq_u8(all, pbmul);
+	svuint8_t pm1 = svld1rq_u8(all, pbmul + 16);
+	int32_t d, nsize = svcntb();
+
+	/*
+	 * while ( bytes-- ) {
+	 *	uint8_t px, qx, db;
+	 *
+	 *	px	  = *p ^ *dp;
+	 *	qx	  = qmul[*q ^ *dq];
+	 *	*dq++ = db = pbmul[px] ^ qx;
+	 *	*dp++ = db ^ px;
+	 *	p++; q++;
+	 * }
+	 */
+	for (d = 0; d < bytes; d += nsize) {
+		svbool_t pg = svwhilelt_b8_s32(d, bytes);
+		svuint8_t px, qx, db;
+
+		px = sveor_u8_x(pg, svld1_u8(pg, &p[d]), svld1_u8(pg, &dp[d]));
+		qx = sveor_u8_x(pg, svld1_u8(pg, &q[d]), svld1_u8(pg, &dq[d]));
+
+		qx = sve_gf_mul(pg, qx, qm0, qm1);
+		db = sveor_u8_x(pg, sve_gf_mul(pg, px, pm0, pm1), qx);
+
+		svst1_u8(pg, &dq[d], db);
+		svst1_u8(pg, &dp[d], sveor_u8_x(pg, db, px));
+	}
+}
+
+void __raid6_datap_recov_sve(int bytes, uint8_t *p, uint8_t *q, uint8_t *dq,
+			     const uint8_t *qmul)
+{
+	svbool_t all = svptrue_b8();
+	svuint8_t qm0 = svld1rq_u8(all, qmul);
+	svuint8_t qm1 = svld1rq_u8(all, qmul + 16);
+	int32_t d, nsize = svcntb();
+
+	/*
+	 * while (bytes--) {
+	 *	*p++ ^= *dq = qmul[*q ^ *dq];
+	 *	q++; dq++;
+	 * }
+	 */
+	for (d = 0; d < bytes; d += nsize) {
+		svbool_t pg = svwhilelt_b8_s32(d, bytes);
+		svuint8_t vx;
+
+		vx = sveor_u8_x(pg, svld1_u8(pg, &q[d]), svld1_u8(pg, &dq[d]));
+		vx = sve_gf_mul(pg, vx, qm0, qm1);
+
+		svst1_u8(pg, &dq[d], vx);
+		svst1_u8(pg, &p[d], sveor_u8_x(pg, vx, svld1_u8(pg, &p[d])));
+	}
+}
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * linux/lib/raid6/sve_inner.c - RAID6 syndrome calculation using ARM SVE
+ *
+ * Vector length agnostic version of neon.uc. Each pass handles one (x1)
+ * or two (x2) full SVE vectors per data disk; the loads and stores are
+ * predicated, so any multiple of the vector length is handled, as well
+ * as a trailing partial vector.
+ */
+
+#include <arm_sve.h>
+
+/*
+ * Multiply each byte of v by {02} in GF(2^8): shift left by one and
+ * reduce with the polynomial 0x11d where the top bit was set.
+ */
+static inline svuint8_t sve_gf_mul2(svbool_t pg, svuint8_t v)
+{
+	svbool_t top = svcmplt_n_s8(pg, svreinterpret_s8_u8(v), 0);
+
+	v = svlsl_n_u8_x(pg, v, 1);
+	return sveor_n_u8_m(top, v, 0x1d);
+}
+
+void raid6_sve1_gen_syndrome_real(int disks, unsigned long bytes, void **ptrs)
+{
+	uint8_t **dptr = (uint8_t **)ptrs;
+	uint8_t *p, *q;
+	uint64_t d, nsize = svcntb();
+	int z, z0;
+	svbool_t pg;
+	svuint8_t wd, wp, wq;
+
+	z0 = disks - 3;		/* Highest data disk */
+	p = dptr[z0+1];		/* XOR parity */
+	q = dptr[z0+2];		/* RS syndrome */
+
+	for (d = 0; d < bytes; d += nsize) {
+		pg = svwhilelt_b8_u64(d, bytes);
+		wq = wp = svld1_u8(pg, &dptr[z0][d]);
+		for (z = z0-1; z >= 0; z--) {
+			wd = svld1_u8(pg, &dptr[z][d]);
+			wp = sveor_u8_x(pg, wp, wd);
+			wq = sveor_u8_x(pg, sve_gf_mul2(pg, wq), wd);
+		}
+		svst1_u8(pg, &p[d], wp);
+		svst1_u8(pg, &q[d], wq);
+	}
+}
+
+void raid6_sve1_xor_syndrome_real(int disks, int start, int stop,
+				  unsigned long bytes, void **ptrs)
+{
+	uint8_t **dptr = (uint8_t **)ptrs;
+	uint8_t *p, *q;
+	uint64_t d, nsize = svcntb();
+	int z, z0;
+	svbool_t pg;
+	svuint8_t wd, wp, wq;
+
+	z0 = stop;		/* P/Q right side optimization */
+	p = dptr[disks-2];	/* XOR parity */
+	q = dptr[disks-1];	/* RS syndrome */
+
+	for (d = 0; d < bytes; d += nsize) {
+		pg = svwhilelt_b8_u64(d, bytes);
+		wq = svld1_u8(pg, &dptr[z0][d]);
+		wp = sveor_u8_x(pg, svld1_u8(pg, &p[d]), wq);
+
+		/* P/Q data pages */
+		for (z = z0-1; z >= start; z--) {
+			wd = svld1_u8(pg, &dptr[z][d]);
+			wp = sveor_u8_x(pg, wp, wd);
+			wq = sveor_u8_x(pg, sve_gf_mul2(pg, wq), wd);
+		}
+		/* P/Q left side optimization */
+		for (z = start-1; z >= 0; z--)
+			wq = sve_gf_mul2(pg, wq);
+
+		wq = sveor_u8_x(pg, wq, svld1_u8(pg, &q[d]));
+		svst1_u8(pg, &p[d], wp);
+		svst1_u8(pg, &q[d], wq);
+	}
+}
+
+void raid6_sve2_gen_syndrome_real(int disks, unsigned long bytes, void **ptrs)
+{
+	uint8_t **dptr = (uint8_t **)ptrs;
+	uint8_t *p, *q;
+	uint64_t d, nsize = svcntb();
+	int z, z0;
+	svbool_t pg0, pg1;
+	svuint8_t wd0, wp0, wq0, wd1, wp1, wq1;
+
+	z0 = disks - 3;		/* Highest data disk */
+	p = dptr[z0+1];		/* XOR parity */
+	q = dptr[z0+2];		/* RS syndrome */
+
+	for (d = 0; d < bytes; d += 2 * nsize) {
+		pg0 = svwhilelt_b8_u64(d, bytes);
+		pg1 = svwhilelt_b8_u64(d + nsize, bytes);
+		wq0 = wp0 = svld1_u8(pg0, &dptr[z0][d]);
+		wq1 = wp1 = svld1_u8(pg1, &dptr[z0][d + nsize]);
+		for (z = z0-1; z >= 0; z--) {
+			wd0 = svld1_u8(pg0, &dptr[z][d]);
+			wd1 = svld1_u8(pg1, &dptr[z][d + nsize]);
+			wp0 = sveor_u8_x(pg0, wp0, wd0);
+			wp1 = sveor_u8_x(pg1, wp1, wd1);
+			wq0 = sveor_u8_x(pg0, sve_gf_mul2(pg0, wq0), wd0);
+			wq1 = sveor_u8_x(pg1, sve_gf_mul2(pg1, wq1), wd1);
+		}
+		svst1_u8(pg0, &p[d], wp0);
+		svst1_u8(pg1, &p[d + nsize], wp1);
+		svst1_u8(pg0, &q[d], wq0);
+		svst1_u8(pg1, &q[d + nsize], wq1);
+	}
+}
+
+void raid6_sve2_xor_syndrome_real(int disks, int start, int stop,
+				  unsigned long bytes, void **ptrs)
+{
+	uint8_t **dptr = (uint8_t **)ptrs;
+	uint8_t *p, *q;
+	uint64_t d, nsize = svcntb();
+	int z, z0;
+	svbool_t pg0, pg1;
+	svuint8_t wd0, wp0, wq0, wd1, wp1, wq1;
+
+	z0 = stop;		/* P/Q right side optimization */
+	p = dptr[disks-2];	/* XOR parity */
+	q = dptr[disks-1];	/* RS syndrome */
+
+	for (d = 0; d < bytes; d += 2 * nsize) {
+		pg0 = svwhilelt_b8_u64(d, bytes);
+		pg1 = svwhilelt_b8_u64(d + nsize, bytes);
+		wq0 = svld1_u8(pg0, &dptr[z0][d]);
+		wq1 = svld1_u8(pg1, &dptr[z0][d + nsize]);
+		wp0 = sveor_u8_x(pg0, svld1_u8(pg0, &p[d]), wq0);
+		wp1 = sveor_u8_x(pg1, svld1_u8(pg1, &p[d + nsize]), wq1);
+
+		/* P/Q data pages */
+		for (z = z0-1; z >= start; z--) {
+			wd0 = svld1_u8(pg0, &dptr[z][d]);
+			wd1 = svld1_u8(pg1, &dptr[z][d + nsize]);
+			wp0 = sveor_u8_x(pg0, wp0, wd0);
+			wp1 = sveor_u8_x(pg1, wp1, wd1);
+			wq0 = sveor_u8_x(pg0, sve_gf_mul2(pg0, wq0), wd0);
+			wq1 = sveor_u8_x(pg1, sve_gf_mul2(pg1, wq1), wd1);
+		}
+		/* P/Q left side optimization */
+		for (z = start-1; z >= 0; z--) {
+			wq0 = sve_gf_mul2(pg0, wq0);
+			wq1 = sve_gf_mul2(pg1, wq1);
+		}
+
+		wq0 = sveor_u8_x(pg0, wq0, svld1_u8(pg0, &q[d]));
+		wq1 = sveor_u8_x(pg1, wq1, svld1_u8(pg1, &q[d + nsize]));
+		svst1_u8(pg0, &p[d], wp0);
+		svst1_u8(pg1, &p[d + nsize], wp1);
+		svst1_u8(pg0, &q[d], wq0);
+		svst1_u8(pg1, &q[d + nsize], wq1);
+	}
+}
@@ -25,10 +25,18 @@
 #include <linux/rhashtable.h>
 #include <linux/err.h>
 #include <linux/export.h>
+#include <linux/cpumask.h>
+#include <linux/ktime.h>
 
 #define HASH_DEFAULT_SIZE	64UL
 #define HASH_MIN_SIZE		4U
 
+/*
+ * Tables of at least this many buckets are rehashed by up to one worker per
+ * online CPU, each of them moving at least this many chains.
+ */
+#define RHT_PARALLEL_REHASH_MIN	(1U << 16)
+
 union nested_table {
 	union nested_table __rcu *table;
 	struct rhash_lock_head __rcu *bucket;
@@ -222,10 +230,10 @@ static struct bucket_table *rhashtable_last_table(struct rhashtable *ht,
 }
 
 static int rhashtable_rehash_one(struct rhashtable *ht,
+				 struct bucket_table *old_tbl,
 				 struct rhash_lock_head __rcu **bkt,
 				 unsigned int old_hash)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl = rhashtable_last_table(ht, old_tbl);
 	int err = -EAGAIN;
 	struct rhash_head *head, *next, *entry;
@@ -272,9 +280,9 @@ static int rhashtable_rehash_one(struct rhashtable *ht,
 }
 
 static int rhashtable_rehash_chain(struct rhashtable *ht,
-				    unsigned int old_hash)
+				   struct bucket_table *old_tbl,
+				   unsigned int old_hash)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct rhash_lock_head __rcu **bkt = rht_bucket_var(old_tbl, old_hash);
 	int err;
 
@@ -282,7 +290,7 @@ static int rhashtable_rehash_chain(struct rhashtable *ht,
 		return 0;
 	rht_lock(old_tbl, bkt);
 
-	while (!(err = rhashtable_rehash_one(ht, bkt, old_hash)))
+	while (!(err = rhashtable_rehash_one(ht, old_tbl, bkt, old_hash)))
 		;
 
 	if (err == -ENOENT)
@@ -309,24 +317,112 @@ static int rhashtable_rehash_attach(struct rhashtable *ht,
 	return 0;
 }
 
+struct rhashtable_rehash_work {
+	struct work_struct work;
+	struct rhashtable *ht;
+	struct bucket_table *old_tbl;
+	unsigned int start;
+	unsigned int end;
+	int err;
+};
+
+/*
+ * Moves the chains [start, end) of old_tbl. Chains are independent, each
+ * one being moved under its own bucket lock, so ranges of them can be moved
+ * concurrently. This may run without ht->mutex, which the caller holds on
+ * our behalf and which keeps old_tbl alive; RCU covers the lookups of the
+ * future tables.
+ */
+static int rhashtable_rehash_range(struct rhashtable *ht,
+				   struct bucket_table *old_tbl,
+				   unsigned int start, unsigned int end)
+{
+	unsigned int old_hash;
+	int err;
+
+	for (old_hash = start; old_hash < end; old_hash++) {
+		rcu_read_lock();
+		err = rhashtable_rehash_chain(ht, old_tbl, old_hash);
+		rcu_read_unlock();
+		if (err)
+			return err;
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static void rhashtable_rehash_range_work(struct work_struct *work)
+{
+	struct rhashtable_rehash_work *rw =
+		container_of(work, struct rhashtable_rehash_work, work);
+
+	rw->err = rhashtable_rehash_range(rw->ht, rw->old_tbl, rw->start,
+					  rw->end);
+}
+
+static int rhashtable_rehash_parallel(struct rhashtable *ht,
+				      struct bucket_table *old_tbl)
+{
+	struct rhashtable_rehash_work *rw;
+	unsigned int nr, chunk, i;
+	int err;
+
+	nr = min(num_online_cpus(), old_tbl->size / RHT_PARALLEL_REHASH_MIN);
+	if (nr < 2)
+		goto serial;
+
+	rw = kcalloc(nr, sizeof(*rw), GFP_KERNEL | __GFP_NOWARN);
+	if (!rw)
+		goto serial;
+
+	chunk = old_tbl->size / nr;
+	for (i = 0; i < nr; i++) {
+		rw[i].ht = ht;
+		rw[i].old_tbl = old_tbl;
+		rw[i].start = i * chunk;
+		rw[i].end = i == nr - 1 ? old_tbl->size : (i + 1) * chunk;
+		INIT_WORK(&rw[i].work, rhashtable_rehash_range_work);
+		/* The first range is moved by this worker */
+		if (i)
+			queue_work(system_unbound_wq, &rw[i].work);
+	}
+
+	err = rhashtable_rehash_range(ht, old_tbl, rw[0].start, rw[0].end);
+	for (i = 1; i < nr; i++) {
+		flush_work(&rw[i].work);
+		err = err ?: rw[i].err;
+	}
+	kfree(rw);
+
+	return err;
+
+serial:
+	return rhashtable_rehash_range(ht, old_tbl, 0, old_tbl->size);
+}
+
 static int rhashtable_rehash_table(struct rhashtable *ht)
 {
 	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl;
 	struct rhashtable_walker *walker;
-	unsigned int old_hash;
+	u64 start, delta;
 	int err;
 
 	new_tbl = rht_dereference(old_tbl->future_tbl, ht);
 	if (!new_tbl)
 		return 0;
 
-	for (old_hash = 0; old_hash < old_tbl->size; old_hash++) {
-		err = rhashtable_rehash_chain(ht, old_hash);
-		if (err)
-			return err;
-		cond_resched();
-	}
+	start = ktime_get_ns();
+	err = rhashtable_rehash_parallel(ht, old_tbl);
+	if (err)
+		return err;
+
+	delta = ktime_get_ns() - start;
+	ht->rehashes++;
+	ht->rehash_ns += delta;
+	if (delta > ht->rehash_max_ns)
+		ht->rehash_max_ns = delta;
 
 	/* Publish the new table pointer. */
 	rcu_assign_pointer(ht->tbl, new_tbl);
@@ -631,11 +727,15 @@ void *rhashtable_insert_slow(struct rhashtable *ht, const void *key,
 {
 	void *data;
 
-	do {
+	for (;;) {
 		rcu_read_lock();
 		data = rhashtable_try_insert(ht, key, obj);
 		rcu_read_unlock();
-	} while (PTR_ERR(data) == -EAGAIN);
+
+		if (PTR_ERR(data) != -EAGAIN)
+			break;
+		atomic_long_inc(&ht->insert_retries);
+	}
 
 	return data;
 }
@@ -1171,6 +1271,53 @@ void rhashtable_destroy(struct rhashtable *ht)
 }
 EXPORT_SYMBOL_GPL(rhashtable_destroy);
 
+/**
+ * rhashtable_get_stats - Report hash table statistics
+ * @ht:		the hash table
+ * @stats:	filled in with the statistics of @ht
+ *
+ * The chain length histogram covers the current table only, not a table
+ * being rehashed into. Walking it holds off rehashing, so this is meant
+ * for diagnostics rather than for fast paths.
+ *
+ * This function may only be called from process context.
+ */
+void rhashtable_get_stats(struct rhashtable *ht,
+			  struct rhashtable_stats *stats)
+{
+	struct bucket_table *tbl;
+	struct rhash_head *pos;
+	unsigned int hash, len;
+
+	memset(stats, 0, sizeof(*stats));
+
+	mutex_lock(&ht->mutex);
+	tbl = rht_dereference(ht->tbl, ht);
+
+	stats->size = tbl->size;
+	stats->nelems = atomic_read(&ht->nelems);
+	stats->rehashes = ht->rehashes;
+	stats->rehash_ns = ht->rehash_ns;
+	stats->rehash_max_ns = ht->rehash_max_ns;
+	stats->insert_retries = atomic_long_read(&ht->insert_retries);
+
+	/* The mutex keeps tbl from being freed by a rehash */
+	for (hash = 0; hash < tbl->size; hash++) {
+		len = 0;
+		rcu_read_lock();
+		rht_for_each_rcu(pos, tbl, hash)
+			len++;
+		rcu_read_unlock();
+
+		stats->chain_hist[min_t(unsigned int, len,
+					RHT_STATS_CHAIN_MAX)]++;
+		if (!(hash % 1024))
+			cond_resched();
+	}
+	mutex_unlock(&ht->mutex);
+}
+EXPORT_SYMBOL_GPL(rhashtable_get_stats);
+
 struct rhash_lock_head __rcu **__rht_bucket_nested(
 	const struct bucket_table *tbl, unsigned int hash)
 {
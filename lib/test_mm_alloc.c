@@ -0,0 +1,373 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Test module for per-CPU throughput analysis of the page allocator
+ * and the slab bulk interfaces.
+ *
+ * Every selected CPU runs the same test cases at the same time, so the
+ * per-CPU results show how the allocators scale with the number of CPUs
+ * hitting them. Results are reported in the kernel log and the module
+ * always fails to load, like test_vmalloc.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/rwsem.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+
+#define __param(type, name, init, msg)		\
+	static type name = init;				\
+	module_param(name, type, 0444);			\
+	MODULE_PARM_DESC(name, msg)				\
+
+__param(bool, single_cpu_test, false,
+	"Use single first online CPU to run tests");
+
+__param(int, nr_cpus, 0,
+	"Number of online CPUs to run tests on, 0 for all of them");
+
+__param(int, test_repeat_count, 1,
+	"Set test repeat counter");
+
+__param(int, test_loop_count, 100000,
+	"Set test loop counter");
+
+__param(int, batch_size, 64,
+	"Number of objects allocated before they are freed in batched tests");
+
+__param(int, page_order, 3,
+	"Allocation order used by the high order page test");
+
+__param(int, object_size, 256,
+	"Object size used by the slab tests");
+
+__param(int, run_test_mask, INT_MAX,
+	"Set tests specified in the mask.\n\n"
+		"\t\tid: 1,   name: page_alloc_test\n"
+		"\t\tid: 2,   name: page_alloc_batch_test\n"
+		"\t\tid: 4,   name: page_alloc_order_test\n"
+		"\t\tid: 8,   name: kmem_cache_alloc_test\n"
+		"\t\tid: 16,  name: kmem_cache_alloc_bulk_test\n"
+		/* Add a new test case description here. */
+);
+
+#define MAX_BATCH_SIZE	1024
+
+static cpumask_t cpus_run_test_mask = CPU_MASK_NONE;
+static struct kmem_cache *test_cache;
+
+/*
+ * Read write semaphore for synchronization of setup
+ * phase that is done in main thread and workers.
+ */
+static DECLARE_RWSEM(prepare_for_test_rwsem);
+
+/*
+ * Completion tracking for worker threads.
+ */
+static DECLARE_COMPLETION(test_all_done_comp);
+static atomic_t test_n_undone = ATOMIC_INIT(0);
+
+static inline void
+test_report_one_done(void)
+{
+	if (atomic_dec_and_test(&test_n_undone))
+		complete(&test_all_done_comp);
+}
+
+static int page_alloc_test(void **batch)
+{
+	struct page *page;
+	int i;
+
+	for (i = 0; i < test_loop_count; i++) {
+		page = alloc_page(GFP_KERNEL);
+		if (!page)
+			return -1;
+
+		__free_page(page);
+	}
+
+	return 0;
+}
+
+/*
+ * Allocating a batch before freeing it drains and refills the per-CPU
+ * page lists, rather than recycling the same hot page over and over.
+ */
+static int page_alloc_batch_test(void **batch)
+{
+	struct page **pages = (struct page **)batch;
+	int i, j, ret = 0;
+
+	for (i = 0; i < test_loop_count; i += batch_size) {
+		for (j = 0; j < batch_size; j++) {
+			pages[j] = alloc_page(GFP_KERNEL);
+			if (!pages[j]) {
+				ret = -1;
+				break;
+			}
+		}
+
+		while (j--)
+			__free_page(pages[j]);
+
+		if (ret)
+			break;
+	}
+
+	return ret;
+}
+
+static int page_alloc_order_test(void **batch)
+{
+	struct page *page;
+	int i;
+
+	for (i = 0; i < test_loop_count; i++) {
+		page = alloc_pages(GFP_KERNEL | __GFP_NOWARN, page_order);
+		if (!page)
+			return -1;
+
+		__free_pages(page, page_order);
+	}
+
+	return 0;
+}
+
+static int kmem_cache_alloc_test(void **batch)
+{
+	void *obj;
+	int i;
+
+	for (i = 0; i < test_loop_count; i++) {
+		obj = kmem_cache_alloc(test_cache, GFP_KERNEL);
+		if (!obj)
+			return -1;
+
+		kmem_cache_free(test_cache, obj);
+	}
+
+	return 0;
+}
+
+static int kmem_cache_alloc_bulk_test(void **batch)
+{
+	int i;
+
+	for (i = 0; i < test_loop_count; i += batch_size) {
+		if (!kmem_cache_alloc_bulk(test_cache, GFP_KERNEL,
+					   batch_size, batch))
+			return -1;
+
+		kmem_cache_free_bulk(test_cache, batch_size, batch);
+	}
+
+	return 0;
+}
+
+struct test_case_desc {
+	const char *test_name;
+	int (*test_func)(void **batch);
+};
+
+static struct test_case_desc test_case_array[] = {
+	{ "page_alloc_test", page_alloc_test },
+	{ "page_alloc_batch_test", page_alloc_batch_test },
+	{ "page_alloc_order_test", page_alloc_order_test },
+	{ "kmem_cache_alloc_test", kmem_cache_alloc_test },
+	{ "kmem_cache_alloc_bulk_test", kmem_cache_alloc_bulk_test },
+	/* Add a new test case here. */
+};
+
+struct test_case_data {
+	int test_failed;
+	int test_passed;
+	u64 time;
+};
+
+/* Split it to get rid of: WARNING: line over 80 characters */
+static struct test_case_data
+	per_cpu_test_data[NR_CPUS][ARRAY_SIZE(test_case_array)];
+
+static struct test_driver {
+	struct task_struct *task;
+	int cpu;
+} per_cpu_test_driver[NR_CPUS];
+
+static int test_func(void *private)
+{
+	struct test_driver *t = private;
+	void **batch;
+	int i, j;
+	ktime_t kt;
+	u64 delta;
+
+	if (set_cpus_allowed_ptr(current, cpumask_of(t->cpu)) < 0)
+		pr_err("Failed to set affinity to %d CPU\n", t->cpu);
+
+	batch = kmalloc_array(batch_size, sizeof(*batch), GFP_KERNEL);
+
+	/*
+	 * Block until initialization is done.
+	 */
+	down_read(&prepare_for_test_rwsem);
+
+	for (i = 0; i < ARRAY_SIZE(test_case_array); i++) {
+		/*
+		 * Skip tests if run_test_mask has been specified.
+		 */
+		if (!((run_test_mask & (1 << i)) >> i))
+			continue;
+
+		kt = ktime_get();
+		for (j = 0; j < test_repeat_count; j++) {
+			if (batch && !test_case_array[i].test_func(batch))
+				per_cpu_test_data[t->cpu][i].test_passed++;
+			else
+				per_cpu_test_data[t->cpu][i].test_failed++;
+		}
+
+		/*
+		 * Take an average time that test took.
+		 */
+		delta = (u64) ktime_us_delta(ktime_get(), kt);
+		do_div(delta, (u32) test_repeat_count);
+
+		per_cpu_test_data[t->cpu][i].time = delta;
+	}
+
+	up_read(&prepare_for_test_rwsem);
+	kfree(batch);
+	test_report_one_done();
+
+	/*
+	 * Wait for the kthread_stop() call.
+	 */
+	while (!kthread_should_stop())
+		msleep(10);
+
+	return 0;
+}
+
+static void
+init_test_configuration(void)
+{
+	int cpu, n = 0;
+
+	/*
+	 * Reset all data of all CPUs.
+	 */
+	memset(per_cpu_test_data, 0, sizeof(per_cpu_test_data));
+
+	if (single_cpu_test)
+		nr_cpus = 1;
+
+	for_each_online_cpu(cpu) {
+		if (nr_cpus > 0 && n++ == nr_cpus)
+			break;
+		cpumask_set_cpu(cpu, &cpus_run_test_mask);
+	}
+
+	if (test_repeat_count <= 0)
+		test_repeat_count = 1;
+
+	if (test_loop_count <= 0)
+		test_loop_count = 1;
+
+	batch_size = clamp(batch_size, 1, MAX_BATCH_SIZE);
+	page_order = clamp(page_order, 0, MAX_ORDER - 1);
+}
+
+static void do_concurrent_test(void)
+{
+	int cpu, ret;
+
+	/*
+	 * Set some basic configurations plus sanity check.
+	 */
+	init_test_configuration();
+
+	/*
+	 * Put on hold all workers.
+	 */
+	down_write(&prepare_for_test_rwsem);
+
+	for_each_cpu(cpu, &cpus_run_test_mask) {
+		struct test_driver *t = &per_cpu_test_driver[cpu];
+
+		t->cpu = cpu;
+		t->task = kthread_run(test_func, t, "mm_alloc_test/%d", cpu);
+
+		if (!IS_ERR(t->task))
+			/* Success. */
+			atomic_inc(&test_n_undone);
+		else
+			pr_err("Failed to start kthread for %d CPU\n", cpu);
+	}
+
+	/*
+	 * Now let the workers do their job.
+	 */
+	up_write(&prepare_for_test_rwsem);
+
+	/*
+	 * Sleep quiet until all workers are done with 1 second
+	 * interval, to stay clear of the hung task detector.
+	 */
+	do {
+		ret = wait_for_completion_timeout(&test_all_done_comp, HZ);
+	} while (!ret);
+
+	for_each_cpu(cpu, &cpus_run_test_mask) {
+		struct test_driver *t = &per_cpu_test_driver[cpu];
+		int i;
+
+		if (!IS_ERR(t->task))
+			kthread_stop(t->task);
+
+		for (i = 0; i < ARRAY_SIZE(test_case_array); i++) {
+			struct test_case_data *d = &per_cpu_test_data[cpu][i];
+
+			if (!((run_test_mask & (1 << i)) >> i))
+				continue;
+
+			pr_info(
+				"CPU%d: %s passed: %d failed: %d repeat: %d loops: %d avg: %llu usec (%llu ops/sec)\n",
+				cpu, test_case_array[i].test_name,
+				d->test_passed, d->test_failed,
+				test_repeat_count, test_loop_count, d->time,
+				div64_u64((u64)test_loop_count * USEC_PER_SEC,
+					  d->time ?: 1));
+		}
+	}
+}
+
+static int mm_alloc_test_init(void)
+{
+	test_cache = kmem_cache_create("test_mm_alloc", object_size, 0, 0,
+				       NULL);
+	if (!test_cache)
+		return -ENOMEM;
+
+	do_concurrent_test();
+
+	kmem_cache_destroy(test_cache);
+	return -EAGAIN; /* Fail will directly unload the module */
+}
+
+static void mm_alloc_test_exit(void)
+{
+}
+
+module_init(mm_alloc_test_init)
+module_exit(mm_alloc_test_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("page and slab allocator test module");
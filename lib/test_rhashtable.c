@@ -205,6 +205,25 @@ static void test_bucket_stats(struct rhashtable *ht, unsigned int entries)
 		pr_warn("Test failed: Total count mismatch ^^^");
 }
 
+static void test_rht_stats(struct rhashtable *ht)
+{
+	struct rhashtable_stats stats;
+	unsigned long buckets = 0;
+	int i;
+
+	rhashtable_get_stats(ht, &stats);
+	for (i = 0; i <= RHT_STATS_CHAIN_MAX; i++)
+		buckets += stats.chain_hist[i];
+
+	pr_info("  Table stats: size=%u, nelems=%u, rehashes=%llu, rehash-max=%llu ns, insert-retries=%lu, empty-buckets=%lu\n",
+		stats.size, stats.nelems, stats.rehashes, stats.rehash_max_ns,
+		stats.insert_retries, stats.chain_hist[0]);
+
+	if (buckets != stats.size)
+		pr_warn("Test failed: chain histogram covers %lu of %u buckets\n",
+			buckets, stats.size);
+}
+
 static s64 __init test_rhashtable(struct rhashtable *ht, struct test_obj *array,
 				  unsigned int entries)
 {
@@ -235,6 +254,7 @@ static s64 __init test_rhashtable(struct rhashtable *ht, struct test_obj *array,
 			insert_retries);
 
 	test_bucket_stats(ht, entries);
+	test_rht_stats(ht);
 	rcu_read_lock();
 	test_rht_lookup(ht, array, entries);
 	rcu_read_unlock();
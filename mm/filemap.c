@@ -101,8 +101,8 @@
  *    ->swap_lock		(try_to_unmap_one)
  *    ->private_lock		(try_to_unmap_one)
  *    ->i_pages lock		(try_to_unmap_one)
- *    ->pgdat->lru_lock		(follow_page->mark_page_accessed)
- *    ->pgdat->lru_lock		(check_pte_range->isolate_lru_page)
+ *    ->lruvec->lru_lock	(follow_page->mark_page_accessed)
+ *    ->lruvec->lru_lock	(check_pte_range->isolate_lru_page)
  *    ->private_lock		(page_remove_rmap->set_page_dirty)
  *    ->i_pages lock		(page_remove_rmap->set_page_dirty)
  *    bdi.wb->list_lock		(page_remove_rmap->set_page_dirty)
@@ -937,6 +937,81 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
 
+#ifdef CONFIG_READ_ONLY_THP_FOR_FS
+/*
+ * Add a locked THP to the page cache and the LRU, covering HPAGE_PMD_NR
+ * indices from @index. Shadow entries in the range are dropped, any page
+ * already present fails the insertion with -EEXIST.
+ */
+int add_to_page_cache_thp(struct page *page, struct address_space *mapping,
+			  pgoff_t index, gfp_t gfp_mask)
+{
+	XA_STATE_ORDER(xas, &mapping->i_pages, index, HPAGE_PMD_ORDER);
+	unsigned long i, nr = HPAGE_PMD_NR;
+	int error;
+
+	VM_BUG_ON_PAGE(!PageLocked(page), page);
+	VM_BUG_ON_PAGE(!PageTransHuge(page), page);
+	VM_BUG_ON_PAGE(index & (nr - 1), page);
+	mapping_set_update(&xas, mapping);
+
+	page_ref_add(page, nr);
+	page->mapping = mapping;
+	page->index = index;
+
+	error = mem_cgroup_charge(page, current->mm, gfp_mask);
+	if (error) {
+		count_vm_event(THP_FILE_FALLBACK);
+		count_vm_event(THP_FILE_FALLBACK_CHARGE);
+		goto error;
+	}
+
+	do {
+		XA_STATE(scan, &mapping->i_pages, index);
+		unsigned long shadows = 0;
+		void *entry;
+
+		xas_lock_irq(&xas);
+		xas_for_each(&scan, entry, index + nr - 1) {
+			if (!xa_is_value(entry)) {
+				xas_set_err(&xas, -EEXIST);
+				goto unlock;
+			}
+			shadows++;
+		}
+		xas_create_range(&xas);
+		if (xas_error(&xas))
+			goto unlock;
+		for (i = 0; i < nr; i++) {
+			if (i)
+				xas_next(&xas);
+			xas_store(&xas, page);
+		}
+		mapping->nrexceptional -= shadows;
+		mapping->nrpages += nr;
+		__mod_lruvec_page_state(page, NR_FILE_PAGES, nr);
+		__inc_node_page_state(page, NR_FILE_THPS);
+		filemap_nr_thps_inc(mapping);
+unlock:
+		xas_unlock_irq(&xas);
+	} while (xas_nomem(&xas, gfp_mask & GFP_RECLAIM_MASK));
+
+	if (xas_error(&xas)) {
+		error = xas_error(&xas);
+		goto error;
+	}
+
+	count_vm_event(THP_FILE_ALLOC);
+	trace_mm_filemap_add_to_page_cache(page);
+	lru_cache_add(page);
+	return 0;
+error:
+	page->mapping = NULL;
+	page_ref_sub(page, nr);
+	return error;
+}
+#endif
+
 #ifdef CONFIG_NUMA
 struct page *__page_cache_alloc(gfp_t gfp)
 {
@@ -987,30 +1062,13 @@ void __init pagecache_init(void)
 	page_writeback_init();
 }
 
-/* This has the same layout as wait_bit_key - see fs/cachefiles/rdwr.c */
-struct wait_page_key {
-	struct page *page;
-	int bit_nr;
-	int page_match;
-};
-
-struct wait_page_queue {
-	struct page *page;
-	int bit_nr;
-	wait_queue_entry_t wait;
-};
-
 static int wake_page_function(wait_queue_entry_t *wait, unsigned mode, int sync, void *arg)
 {
 	struct wait_page_key *key = arg;
 	struct wait_page_queue *wait_page
 		= container_of(wait, struct wait_page_queue, wait);
 
-	if (wait_page->page != key->page)
-	       return 0;
-	key->page_match = 1;
-
-	if (wait_page->bit_nr != key->bit_nr)
+	if (!wake_page_match(wait_page, key))
 		return 0;
 
 	/*
@@ -1207,6 +1265,44 @@ int wait_on_page_bit_killable(struct page *page, int bit_nr)
 }
 EXPORT_SYMBOL(wait_on_page_bit_killable);
 
+static int __wait_on_page_locked_async(struct page *page,
+				       struct wait_page_queue *wait, bool set)
+{
+	struct wait_queue_head *q = page_waitqueue(page);
+	int ret = 0;
+
+	wait->page = page;
+	wait->bit_nr = PG_locked;
+
+	spin_lock_irq(&q->lock);
+	__add_wait_queue_entry_tail(q, &wait->wait);
+	SetPageWaiters(page);
+	if (set)
+		ret = !trylock_page(page);
+	else
+		ret = PageLocked(page);
+	/*
+	 * If we were successful now, we know we're still on the
+	 * waitqueue as we're still under the lock. This means it's
+	 * safe to remove and return success, we know the callback
+	 * isn't going to trigger.
+	 */
+	if (!ret)
+		__remove_wait_queue(q, &wait->wait);
+	else
+		ret = -EIOCBQUEUED;
+	spin_unlock_irq(&q->lock);
+	return ret;
+}
+
+static int wait_on_page_locked_async(struct page *page,
+				     struct wait_page_queue *wait)
+{
+	if (!PageLocked(page))
+		return 0;
+	return __wait_on_page_locked_async(compound_head(page), wait, false);
+}
+
 /**
  * put_and_wait_on_page_locked - Drop a reference and wait for it to be unlocked
  * @page: The page to wait for.
@@ -1360,6 +1456,11 @@ void __lock_page(struct page *__page)
 }
 EXPORT_SYMBOL(__lock_page);
 
+int __lock_page_async(struct page *page, struct wait_page_queue *wait)
+{
+	return __wait_on_page_locked_async(page, wait, true);
+}
+
 int __lock_page_killable(struct page *__page)
 {
 	struct page *page = compound_head(__page);
@@ -1972,6 +2073,28 @@ static void shrink_readahead_size_eio(struct file_ra_state *ra)
 	ra->ra_pages /= 4;
 }
 
+/*
+ * ->readpage only handles small pages. A THP that readahead failed to read
+ * is split under the page lock before the retry, so that just the subpage
+ * is read again. Returns -EAGAIN if the THP was truncated meanwhile.
+ */
+static int filemap_split_for_readpage(struct page *page)
+{
+	if (!PageTransCompound(page))
+		return 0;
+	if (!compound_head(page)->mapping)
+		return -EAGAIN;
+	return split_huge_page(page) ? -EIO : 0;
+}
+
+static unsigned int filemap_get_batch(struct address_space *mapping,
+		pgoff_t index, pgoff_t last_index, struct page **pages)
+{
+	unsigned int nr = clamp_t(pgoff_t, last_index - index, 1, PAGEVEC_SIZE);
+
+	return find_get_pages_contig(mapping, index, nr, pages);
+}
+
 /**
  * generic_file_buffered_read - generic file read routine
  * @iocb:	the iocb to read
@@ -2001,6 +2124,10 @@ ssize_t generic_file_buffered_read(struct kiocb *iocb,
 	pgoff_t prev_index;
 	unsigned long offset;      /* offset into pagecache page */
 	unsigned int prev_offset;
+	/* pages[cur..nr_pages) hold the indices from batch_index + cur on */
+	struct page *pages[PAGEVEC_SIZE];
+	unsigned int cur = 0, nr_pages = 0;
+	pgoff_t batch_index = 0;
 	int error = 0;
 
 	if (unlikely(*ppos >= inode->i_sb->s_maxbytes))
@@ -2026,16 +2153,32 @@ ssize_t generic_file_buffered_read(struct kiocb *iocb,
 			goto out;
 		}
 
-		page = find_get_page(mapping, index);
-		if (!page) {
-			if (iocb->ki_flags & (IOCB_NOWAIT | IOCB_NOIO))
-				goto would_block;
-			page_cache_sync_readahead(mapping,
-					ra, filp,
-					index, last_index - index);
-			page = find_get_page(mapping, index);
-			if (unlikely(page == NULL))
-				goto no_cached_page;
+		/*
+		 * Look pages up a batch at a time: a sequential read from the
+		 * page cache then walks the xarray once per batch instead of
+		 * once per page.
+		 */
+		if (cur < nr_pages && batch_index + cur == index) {
+			page = pages[cur++];
+		} else {
+			while (cur < nr_pages)
+				put_page(pages[cur++]);
+			batch_index = index;
+			cur = 0;
+			nr_pages = filemap_get_batch(mapping, index,
+						     last_index, pages);
+			if (!nr_pages) {
+				if (iocb->ki_flags & (IOCB_NOWAIT | IOCB_NOIO))
+					goto would_block;
+				page_cache_sync_readahead(mapping,
+						ra, filp,
+						index, last_index - index);
+				nr_pages = filemap_get_batch(mapping, index,
+							     last_index, pages);
+				if (unlikely(!nr_pages))
+					goto no_cached_page;
+			}
+			page = pages[cur++];
 		}
 		if (PageReadahead(page)) {
 			if (iocb->ki_flags & IOCB_NOIO) {
@@ -2047,17 +2190,25 @@ ssize_t generic_file_buffered_read(struct kiocb *iocb,
 					index, last_index - index);
 		}
 		if (!PageUptodate(page)) {
-			if (iocb->ki_flags & IOCB_NOWAIT) {
-				put_page(page);
-				goto would_block;
-			}
-
 			/*
 			 * See comment in do_read_cache_page on why
 			 * wait_on_page_locked is used to avoid unnecessarily
 			 * serialisations and why it's safe.
 			 */
-			error = wait_on_page_locked_killable(page);
+			if (iocb->ki_flags & IOCB_WAITQ) {
+				if (written) {
+					put_page(page);
+					goto out;
+				}
+				error = wait_on_page_locked_async(page,
+								iocb->ki_waitq);
+			} else {
+				if (iocb->ki_flags & IOCB_NOWAIT) {
+					put_page(page);
+					goto would_block;
+				}
+				error = wait_on_page_locked_killable(page);
+			}
 			if (unlikely(error))
 				goto readpage_error;
 			if (PageUptodate(page))
@@ -2145,7 +2296,16 @@ ssize_t generic_file_buffered_read(struct kiocb *iocb,
 
 page_not_up_to_date:
 		/* Get exclusive access to the page ... */
-		error = lock_page_killable(page);
+		if (iocb->ki_flags & IOCB_WAITQ) {
+			/* a queued callback must not race with our return */
+			if (written) {
+				put_page(page);
+				goto out;
+			}
+			error = lock_page_async(page, iocb->ki_waitq);
+		} else {
+			error = lock_page_killable(page);
+		}
 		if (unlikely(error))
 			goto readpage_error;
 
@@ -2169,6 +2329,16 @@ ssize_t generic_file_buffered_read(struct kiocb *iocb,
 			put_page(page);
 			goto would_block;
 		}
+		error = filemap_split_for_readpage(page);
+		if (unlikely(error)) {
+			unlock_page(page);
+			if (error == -EAGAIN) {
+				put_page(page);
+				error = 0;
+				goto find_page;
+			}
+			goto readpage_error;
+		}
 		/*
 		 * A previous I/O error may have been due to temporary
 		 * failures, eg. multipath errors.
@@ -2188,7 +2358,15 @@ ssize_t generic_file_buffered_read(struct kiocb *iocb,
 		}
 
 		if (!PageUptodate(page)) {
-			error = lock_page_killable(page);
+			if (iocb->ki_flags & IOCB_WAITQ) {
+				if (written) {
+					put_page(page);
+					goto out;
+				}
+				error = lock_page_async(page, iocb->ki_waitq);
+			} else {
+				error = lock_page_killable(page);
+			}
 			if (unlikely(error))
 				goto readpage_error;
 			if (!PageUptodate(page)) {
@@ -2241,6 +2419,9 @@ ssize_t generic_file_buffered_read(struct kiocb *iocb,
 would_block:
 	error = -EAGAIN;
 out:
+	while (cur < nr_pages)
+		put_page(pages[cur++]);
+
 	ra->prev_pos = prev_index;
 	ra->prev_pos <<= PAGE_SHIFT;
 	ra->prev_pos |= prev_offset;
@@ -2268,6 +2449,11 @@ EXPORT_SYMBOL_GPL(generic_file_buffered_read);
  * can be read, -EAGAIN shall be returned.  When readahead would be
  * triggered, a partial, possibly empty read shall be returned.
  *
+ * The IOCB_WAITQ flag in iocb->ki_flags indicates that, rather than
+ * sleeping on a locked page, iocb->ki_waitq shall be queued on it and
+ * -EIOCBQUEUED returned. The caller retries the read once the callback
+ * fires. If some data was already copied, a short read is returned.
+ *
  * Return:
  * * number of bytes copied, even for partial reads
  * * negative error code (or 0 if IOCB_NOIO) if nothing was read
@@ -2568,6 +2754,16 @@ vm_fault_t filemap_fault(struct vm_fault *vmf)
 	 * because there really aren't any performance issues here
 	 * and we need to check for errors.
 	 */
+	error = filemap_split_for_readpage(page);
+	if (unlikely(error)) {
+		unlock_page(page);
+		if (fpin)
+			goto out_retry;
+		put_page(page);
+		if (error == -EAGAIN)
+			goto retry_find;
+		return VM_FAULT_SIGBUS;
+	}
 	ClearPageError(page);
 	fpin = maybe_unlock_mmap_for_io(vmf, fpin);
 	error = mapping->a_ops->readpage(file, page);
@@ -29,6 +29,7 @@
 #include <linux/numa.h>
 #include <linux/llist.h>
 #include <linux/cma.h>
+#include <linux/padata.h>
 
 #include <asm/page.h>
 #include <asm/tlb.h>
@@ -2536,33 +2537,163 @@ static void __init prep_compound_huge_page(struct page *page,
 		prep_compound_page(page, order);
 }
 
-/* Put bootmem huge pages into the standard lists after mem_map is up */
+/* Runs a boot time job on all CPUs if padata is available */
+static void __init hugetlb_boot_job(struct padata_mt_job *job)
+{
+#ifdef CONFIG_PADATA
+	padata_do_multithreaded(job);
+#else
+	job->thread_fn(job->start, job->start + job->size, job->fn_arg);
+#endif
+}
+
+static void __init gather_bootmem_prealloc_page(struct huge_bootmem_page *m)
+{
+	struct page *page = virt_to_page(m);
+	struct hstate *h = m->hstate;
+
+	WARN_ON(page_count(page) != 1);
+	prep_compound_huge_page(page, h->order);
+	WARN_ON(PageReserved(page));
+	prep_new_huge_page(h, page, page_to_nid(page));
+	put_page(page); /* free it into the hugepage allocator */
+
+	/*
+	 * If we had gigantic hugepages allocated at boot time, we need
+	 * to restore the 'stolen' pages to totalram_pages in order to
+	 * fix confusing memory reports from free(1) and another
+	 * side-effects, like CommitLimit going negative.
+	 */
+	if (hstate_is_gigantic(h))
+		adjust_managed_page_count(page, 1 << h->order);
+	cond_resched();
+}
+
+static void __init gather_bootmem_prealloc_chunk(unsigned long start,
+						 unsigned long end, void *arg)
+{
+	struct huge_bootmem_page **pages = arg;
+	unsigned long i;
+
+	for (i = start; i < end; i++)
+		gather_bootmem_prealloc_page(pages[i]);
+}
+
+/*
+ * Put bootmem huge pages into the standard lists after mem_map is up.
+ *
+ * Initialising the struct pages of a gigantic page dominates the cost, so
+ * the pages are handed out to all CPUs. The list lives in the pages being
+ * freed, so collect it into an array first.
+ */
 static void __init gather_bootmem_prealloc(void)
 {
-	struct huge_bootmem_page *m;
+	struct huge_bootmem_page *m, *tmp, **pages;
+	unsigned long nr = 0;
 
-	list_for_each_entry(m, &huge_boot_pages, list) {
-		struct page *page = virt_to_page(m);
-		struct hstate *h = m->hstate;
+	list_for_each_entry(m, &huge_boot_pages, list)
+		nr++;
+	if (!nr)
+		return;
 
-		WARN_ON(page_count(page) != 1);
-		prep_compound_huge_page(page, h->order);
-		WARN_ON(PageReserved(page));
-		prep_new_huge_page(h, page, page_to_nid(page));
-		put_page(page); /* free it into the hugepage allocator */
+	pages = kvmalloc_array(nr, sizeof(*pages), GFP_KERNEL);
+	if (!pages) {
+		list_for_each_entry_safe(m, tmp, &huge_boot_pages, list)
+			gather_bootmem_prealloc_page(m);
+	} else {
+		struct padata_mt_job job = {
+			.thread_fn   = gather_bootmem_prealloc_chunk,
+			.fn_arg      = pages,
+			.start       = 0,
+			.size        = nr,
+			.align       = 1,
+			.min_chunk   = 1,
+			.max_threads = num_online_cpus(),
+		};
+
+		nr = 0;
+		list_for_each_entry(m, &huge_boot_pages, list)
+			pages[nr++] = m;
+		hugetlb_boot_job(&job);
+		kvfree(pages);
+	}
+	INIT_LIST_HEAD(&huge_boot_pages);
+}
+
+struct hugetlb_boot_alloc {
+	struct hstate *h;
+	int *nids;
+	unsigned long *nr;	/* in: pages wanted, out: pages allocated */
+};
 
-		/*
-		 * If we had gigantic hugepages allocated at boot time, we need
-		 * to restore the 'stolen' pages to totalram_pages in order to
-		 * fix confusing memory reports from free(1) and another
-		 * side-effects, like CommitLimit going negative.
-		 */
-		if (hstate_is_gigantic(h))
-			adjust_managed_page_count(page, 1 << h->order);
-		cond_resched();
+static void __init hugetlb_alloc_node_pages(unsigned long start,
+					    unsigned long end, void *arg)
+{
+	struct hugetlb_boot_alloc *ba = arg;
+	struct hstate *h = ba->h;
+	gfp_t gfp_mask = htlb_alloc_mask(h) | __GFP_THISNODE;
+	unsigned long n, i;
+
+	for (n = start; n < end; n++) {
+		for (i = 0; i < ba->nr[n]; i++) {
+			struct page *page;
+
+			page = alloc_fresh_huge_page(h, gfp_mask, ba->nids[n],
+						&node_states[N_MEMORY], NULL);
+			if (!page)
+				break;
+			put_page(page); /* free it into the hugepage allocator */
+			cond_resched();
+		}
+		ba->nr[n] = i;
 	}
 }
 
+/*
+ * Spread @count boot time huge pages evenly over the nodes with memory and
+ * allocate them from one thread per node. Returns the number of pages
+ * allocated; whatever a short node could not provide is left to the
+ * caller's interleaved allocation.
+ */
+static unsigned long __init hugetlb_alloc_pages_parallel(struct hstate *h,
+							 unsigned long count)
+{
+	struct hugetlb_boot_alloc ba = { .h = h };
+	int nr_nodes = num_node_state(N_MEMORY);
+	unsigned long done = 0;
+	int nid, n = 0;
+
+	if (nr_nodes < 2 || count < nr_nodes)
+		return 0;
+
+	ba.nids = kcalloc(nr_nodes, sizeof(*ba.nids), GFP_KERNEL);
+	ba.nr = kcalloc(nr_nodes, sizeof(*ba.nr), GFP_KERNEL);
+	if (ba.nids && ba.nr) {
+		struct padata_mt_job job = {
+			.thread_fn   = hugetlb_alloc_node_pages,
+			.fn_arg      = &ba,
+			.start       = 0,
+			.size        = nr_nodes,
+			.align       = 1,
+			.min_chunk   = 1,
+			.max_threads = nr_nodes,
+		};
+
+		for_each_node_state(nid, N_MEMORY) {
+			ba.nids[n] = nid;
+			ba.nr[n] = count / nr_nodes + (n < count % nr_nodes);
+			n++;
+		}
+		hugetlb_boot_job(&job);
+		for (n = 0; n < nr_nodes; n++)
+			done += ba.nr[n];
+	}
+
+	kfree(ba.nr);
+	kfree(ba.nids);
+	return done;
+}
+
 static void __init hugetlb_hstate_alloc_pages(struct hstate *h)
 {
 	unsigned long i;
@@ -2586,7 +2717,11 @@ static void __init hugetlb_hstate_alloc_pages(struct hstate *h)
 	if (node_alloc_noretry)
 		nodes_clear(*node_alloc_noretry);
 
-	for (i = 0; i < h->max_huge_pages; ++i) {
+	i = 0;
+	if (!hstate_is_gigantic(h))
+		i = hugetlb_alloc_pages_parallel(h, h->max_huge_pages);
+
+	for (; i < h->max_huge_pages; ++i) {
 		if (hstate_is_gigantic(h)) {
 			if (hugetlb_cma_size) {
 				pr_warn_once("HugeTLB: hugetlb_cma is enabled, skip boot time allocation\n");
@@ -54,6 +54,10 @@ void force_page_cache_readahead(struct address_space *, struct file *,
 void __do_page_cache_readahead(struct address_space *, struct file *,
 		pgoff_t index, unsigned long nr_to_read,
 		unsigned long lookahead_size);
+#ifdef CONFIG_READ_ONLY_THP_FOR_FS
+int add_to_page_cache_thp(struct page *page, struct address_space *mapping,
+			  pgoff_t index, gfp_t gfp_mask);
+#endif
 
 /*
  * Submit IO for the read-ahead request in file_ra_state.
@@ -243,6 +247,7 @@ struct compact_control {
 	bool contended;			/* Signal lock or sched contention */
 	bool rescan;			/* Rescanning the same pageblock */
 	bool alloc_contig;		/* alloc_contig_range allocation */
+	bool proactive_compaction;	/* kcompactd proactive compaction */
 };
 
 /*
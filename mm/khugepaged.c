@@ -56,14 +56,18 @@ enum scan_result {
 #define CREATE_TRACE_POINTS
 #include <trace/events/huge_memory.h>
 
-static struct task_struct *khugepaged_thread __read_mostly;
 static DEFINE_MUTEX(khugepaged_mutex);
+static int khugepaged_nr_workers;
 
 /* default scan 8*512 pte (or vmas) every 30 second */
 static unsigned int khugepaged_pages_to_scan __read_mostly;
-static unsigned int khugepaged_pages_collapsed;
+static atomic_t khugepaged_pages_collapsed;
+static atomic64_t khugepaged_collapse_time_us;
+static atomic64_t khugepaged_collapse_time_max_us;
 static unsigned int khugepaged_full_scans;
 static unsigned int khugepaged_scan_sleep_millisecs __read_mostly = 10000;
+/* scan interval while any mm asked for expedited collapse */
+static unsigned int khugepaged_prio_scan_sleep_millisecs __read_mostly = 1000;
 /* during fragmentation poll the hugepage allocator once every minute */
 static unsigned int khugepaged_alloc_sleep_millisecs __read_mostly = 60000;
 static unsigned long khugepaged_sleep_expire;
@@ -85,16 +89,24 @@ static struct kmem_cache *mm_slot_cache __read_mostly;
 
 #define MAX_PTE_MAPPED_THP 8
 
+struct khugepaged_worker;
+
 /**
  * struct mm_slot - hash lookup from mm to mm_slot
  * @hash: hash collision list
- * @mm_node: khugepaged scan list headed in khugepaged_scan.mm_head
+ * @mm_node: khugepaged scan list headed in khugepaged_scan.mm_head or
+ *	khugepaged_scan.prio_head
  * @mm: the mm that this information is valid for
+ * @worker: the worker currently scanning this mm, if any
+ * @full_scans: value of khugepaged_full_scans when this mm was last
+ *	scanned to the end
  */
 struct mm_slot {
 	struct hlist_node hash;
 	struct list_head mm_node;
 	struct mm_struct *mm;
+	struct khugepaged_worker *worker;
+	unsigned int full_scans;
 
 	/* pte-mapped THP in this mm */
 	int nr_pte_mapped_thp;
@@ -102,23 +114,47 @@ struct mm_slot {
 };
 
 /**
- * struct khugepaged_scan - cursor for scanning
+ * struct khugepaged_scan - lists of mms to scan
  * @mm_head: the head of the mm list to scan
- * @mm_slot: the current mm_slot we are scanning
- * @address: the next address inside that to be scanned
+ * @prio_head: mms that asked for expedited collapse with
+ *	PR_SET_THP_COLLAPSE_PRIO
  *
- * There is only the one khugepaged_scan instance of this cursor structure.
+ * Workers take the first mm_slot that no other worker is scanning and
+ * move it to the tail once they have scanned it to the end.
  */
 struct khugepaged_scan {
 	struct list_head mm_head;
-	struct mm_slot *mm_slot;
-	unsigned long address;
+	struct list_head prio_head;
 };
 
 static struct khugepaged_scan khugepaged_scan = {
 	.mm_head = LIST_HEAD_INIT(khugepaged_scan.mm_head),
+	.prio_head = LIST_HEAD_INIT(khugepaged_scan.prio_head),
+};
+
+/**
+ * struct khugepaged_worker - per-node khugepaged thread
+ * @thread: the kthread, bound to the CPUs of @nid
+ * @nid: the node this worker was started for
+ * @mm_slot: the mm_slot this worker is scanning, protected by
+ *	khugepaged_mm_lock
+ * @address: the next address inside @mm_slot to be scanned
+ * @prio_turn: whether the next mm is taken from the priority list
+ * @last_target_node: last node a hugepage was allocated from
+ * @node_load: per-node page counts of the range being scanned
+ */
+struct khugepaged_worker {
+	struct task_struct *thread;
+	int nid;
+	struct mm_slot *mm_slot;
+	unsigned long address;
+	bool prio_turn;
+	int last_target_node;
+	int node_load[MAX_NUMNODES];
 };
 
+static struct khugepaged_worker *khugepaged_workers[MAX_NUMNODES];
+
 #ifdef CONFIG_SYSFS
 static ssize_t scan_sleep_millisecs_show(struct kobject *kobj,
 					 struct kobj_attribute *attr,
@@ -176,6 +212,34 @@ static struct kobj_attribute alloc_sleep_millisecs_attr =
 	__ATTR(alloc_sleep_millisecs, 0644, alloc_sleep_millisecs_show,
 	       alloc_sleep_millisecs_store);
 
+static ssize_t prio_scan_sleep_millisecs_show(struct kobject *kobj,
+					      struct kobj_attribute *attr,
+					      char *buf)
+{
+	return sprintf(buf, "%u\n", khugepaged_prio_scan_sleep_millisecs);
+}
+
+static ssize_t prio_scan_sleep_millisecs_store(struct kobject *kobj,
+					       struct kobj_attribute *attr,
+					       const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = kstrtoul(buf, 10, &msecs);
+	if (err || msecs > UINT_MAX)
+		return -EINVAL;
+
+	khugepaged_prio_scan_sleep_millisecs = msecs;
+	khugepaged_sleep_expire = 0;
+	wake_up_interruptible(&khugepaged_wait);
+
+	return count;
+}
+static struct kobj_attribute prio_scan_sleep_millisecs_attr =
+	__ATTR(prio_scan_sleep_millisecs, 0644, prio_scan_sleep_millisecs_show,
+	       prio_scan_sleep_millisecs_store);
+
 static ssize_t pages_to_scan_show(struct kobject *kobj,
 				  struct kobj_attribute *attr,
 				  char *buf)
@@ -205,11 +269,31 @@ static ssize_t pages_collapsed_show(struct kobject *kobj,
 				    struct kobj_attribute *attr,
 				    char *buf)
 {
-	return sprintf(buf, "%u\n", khugepaged_pages_collapsed);
+	return sprintf(buf, "%u\n", atomic_read(&khugepaged_pages_collapsed));
 }
 static struct kobj_attribute pages_collapsed_attr =
 	__ATTR_RO(pages_collapsed);
 
+static ssize_t collapse_time_us_show(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     char *buf)
+{
+	return sprintf(buf, "%lld\n",
+		       atomic64_read(&khugepaged_collapse_time_us));
+}
+static struct kobj_attribute collapse_time_us_attr =
+	__ATTR_RO(collapse_time_us);
+
+static ssize_t collapse_time_max_us_show(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 char *buf)
+{
+	return sprintf(buf, "%lld\n",
+		       atomic64_read(&khugepaged_collapse_time_max_us));
+}
+static struct kobj_attribute collapse_time_max_us_attr =
+	__ATTR_RO(collapse_time_max_us);
+
 static ssize_t full_scans_show(struct kobject *kobj,
 			       struct kobj_attribute *attr,
 			       char *buf)
@@ -330,8 +414,11 @@ static struct attribute *khugepaged_attr[] = {
 	&khugepaged_max_ptes_shared_attr.attr,
 	&pages_to_scan_attr.attr,
 	&pages_collapsed_attr.attr,
+	&collapse_time_us_attr.attr,
+	&collapse_time_max_us_attr.attr,
 	&full_scans_attr.attr,
 	&scan_sleep_millisecs_attr.attr,
+	&prio_scan_sleep_millisecs_attr.attr,
 	&alloc_sleep_millisecs_attr.attr,
 	NULL,
 };
@@ -437,6 +524,19 @@ static inline int khugepaged_test_exit(struct mm_struct *mm)
 	return atomic_read(&mm->mm_users) == 0 || !mmget_still_valid(mm);
 }
 
+static struct list_head *khugepaged_slot_list(struct mm_struct *mm)
+{
+	if (test_bit(MMF_THP_COLLAPSE_PRIO, &mm->flags))
+		return &khugepaged_scan.prio_head;
+	return &khugepaged_scan.mm_head;
+}
+
+static int khugepaged_has_mms(void)
+{
+	return !list_empty(&khugepaged_scan.mm_head) ||
+		!list_empty(&khugepaged_scan.prio_head);
+}
+
 static bool hugepage_vma_check(struct vm_area_struct *vma,
 			       unsigned long vm_flags)
 {
@@ -478,11 +578,12 @@ int __khugepaged_enter(struct mm_struct *mm)
 	spin_lock(&khugepaged_mm_lock);
 	insert_to_mm_slots_hash(mm, mm_slot);
 	/*
-	 * Insert just behind the scanning cursor, to let the area settle
-	 * down a little.
+	 * Insert at the tail, behind the mms being scanned, to let the area
+	 * settle down a little.
 	 */
-	wakeup = list_empty(&khugepaged_scan.mm_head);
-	list_add_tail(&mm_slot->mm_node, &khugepaged_scan.mm_head);
+	wakeup = !khugepaged_has_mms();
+	mm_slot->full_scans = khugepaged_full_scans - 1;
+	list_add_tail(&mm_slot->mm_node, khugepaged_slot_list(mm));
 	spin_unlock(&khugepaged_mm_lock);
 
 	mmgrab(mm);
@@ -519,7 +620,7 @@ void __khugepaged_exit(struct mm_struct *mm)
 
 	spin_lock(&khugepaged_mm_lock);
 	mm_slot = get_mm_slot(mm);
-	if (mm_slot && khugepaged_scan.mm_slot != mm_slot) {
+	if (mm_slot && !mm_slot->worker) {
 		hash_del(&mm_slot->hash);
 		list_del(&mm_slot->mm_node);
 		free = 1;
@@ -787,10 +888,9 @@ static void khugepaged_alloc_sleep(void)
 	remove_wait_queue(&khugepaged_wait, &wait);
 }
 
-static int khugepaged_node_load[MAX_NUMNODES];
-
-static bool khugepaged_scan_abort(int nid)
+static bool khugepaged_scan_abort(struct khugepaged_worker *worker, int nid)
 {
+	int *node_load = worker->node_load;
 	int i;
 
 	/*
@@ -801,11 +901,11 @@ static bool khugepaged_scan_abort(int nid)
 		return false;
 
 	/* If there is a count for this node already, it must be acceptable */
-	if (khugepaged_node_load[nid])
+	if (node_load[nid])
 		return false;
 
 	for (i = 0; i < MAX_NUMNODES; i++) {
-		if (!khugepaged_node_load[i])
+		if (!node_load[i])
 			continue;
 		if (node_distance(nid, i) > node_reclaim_distance)
 			return true;
@@ -820,28 +920,28 @@ static inline gfp_t alloc_hugepage_khugepaged_gfpmask(void)
 }
 
 #ifdef CONFIG_NUMA
-static int khugepaged_find_target_node(void)
+static int khugepaged_find_target_node(struct khugepaged_worker *worker)
 {
-	static int last_khugepaged_target_node = NUMA_NO_NODE;
+	int *node_load = worker->node_load;
 	int nid, target_node = 0, max_value = 0;
 
 	/* find first node with max normal pages hit */
 	for (nid = 0; nid < MAX_NUMNODES; nid++)
-		if (khugepaged_node_load[nid] > max_value) {
-			max_value = khugepaged_node_load[nid];
+		if (node_load[nid] > max_value) {
+			max_value = node_load[nid];
 			target_node = nid;
 		}
 
 	/* do some balance if several nodes have the same hit record */
-	if (target_node <= last_khugepaged_target_node)
-		for (nid = last_khugepaged_target_node + 1; nid < MAX_NUMNODES;
+	if (target_node <= worker->last_target_node)
+		for (nid = worker->last_target_node + 1; nid < MAX_NUMNODES;
 				nid++)
-			if (max_value == khugepaged_node_load[nid]) {
+			if (max_value == node_load[nid]) {
 				target_node = nid;
 				break;
 			}
 
-	last_khugepaged_target_node = target_node;
+	worker->last_target_node = target_node;
 	return target_node;
 }
 
@@ -879,7 +979,7 @@ khugepaged_alloc_page(struct page **hpage, gfp_t gfp, int node)
 	return *hpage;
 }
 #else
-static int khugepaged_find_target_node(void)
+static int khugepaged_find_target_node(struct khugepaged_worker *worker)
 {
 	return 0;
 }
@@ -947,6 +1047,23 @@ khugepaged_alloc_page(struct page **hpage, gfp_t gfp, int node)
 }
 #endif
 
+static void khugepaged_account_collapse(ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	s64 max = atomic64_read(&khugepaged_collapse_time_max_us);
+
+	atomic_inc(&khugepaged_pages_collapsed);
+	atomic64_add(us, &khugepaged_collapse_time_us);
+	while (us > max) {
+		s64 old = atomic64_cmpxchg(&khugepaged_collapse_time_max_us,
+					   max, us);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
 /*
  * If mmap_lock temporarily dropped, revalidate vma
  * before taking mmap_lock.
@@ -1057,6 +1174,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 	int isolated = 0, result = 0;
 	struct vm_area_struct *vma;
 	struct mmu_notifier_range range;
+	ktime_t start = ktime_get();
 	gfp_t gfp;
 
 	VM_BUG_ON(address & ~HPAGE_PMD_MASK);
@@ -1122,6 +1240,8 @@ static void collapse_huge_page(struct mm_struct *mm,
 	if (mm_find_pmd(mm, address) != pmd)
 		goto out;
 
+	/* Lockless faults must not see the pmd while it is collapsed */
+	vma_start_write(vma);
 	anon_vma_lock_write(vma->anon_vma);
 
 	mmu_notifier_range_init(&range, MMU_NOTIFY_CLEAR, 0, NULL, mm,
@@ -1196,7 +1316,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 
 	*hpage = NULL;
 
-	khugepaged_pages_collapsed++;
+	khugepaged_account_collapse(start);
 	result = SCAN_SUCCEED;
 out_up_write:
 	mmap_write_unlock(mm);
@@ -1209,7 +1329,8 @@ static void collapse_huge_page(struct mm_struct *mm,
 	goto out_up_write;
 }
 
-static int khugepaged_scan_pmd(struct mm_struct *mm,
+static int khugepaged_scan_pmd(struct khugepaged_worker *worker,
+			       struct mm_struct *mm,
 			       struct vm_area_struct *vma,
 			       unsigned long address,
 			       struct page **hpage)
@@ -1232,7 +1353,7 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 		goto out;
 	}
 
-	memset(khugepaged_node_load, 0, sizeof(khugepaged_node_load));
+	memset(worker->node_load, 0, sizeof(worker->node_load));
 	pte = pte_offset_map_lock(mm, pmd, address, &ptl);
 	for (_address = address, _pte = pte; _pte < pte+HPAGE_PMD_NR;
 	     _pte++, _address += PAGE_SIZE) {
@@ -1299,16 +1420,16 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 
 		/*
 		 * Record which node the original page is from and save this
-		 * information to khugepaged_node_load[].
+		 * information to worker->node_load[].
 		 * Khupaged will allocate hugepage from the node has the max
 		 * hit record.
 		 */
 		node = page_to_nid(page);
-		if (khugepaged_scan_abort(node)) {
+		if (khugepaged_scan_abort(worker, node)) {
 			result = SCAN_SCAN_ABORT;
 			goto out_unmap;
 		}
-		khugepaged_node_load[node]++;
+		worker->node_load[node]++;
 		if (!PageLRU(page)) {
 			result = SCAN_PAGE_LRU;
 			goto out_unmap;
@@ -1359,7 +1480,7 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 out_unmap:
 	pte_unmap_unlock(pte, ptl);
 	if (ret) {
-		node = khugepaged_find_target_node();
+		node = khugepaged_find_target_node(worker);
 		/* collapse_huge_page will return with the mmap_lock released */
 		collapse_huge_page(mm, address, hpage, node,
 				referenced, unmapped);
@@ -1393,6 +1514,67 @@ static void collect_mm_slot(struct mm_slot *mm_slot)
 	}
 }
 
+static struct mm_slot *khugepaged_first_idle_slot(struct list_head *head)
+{
+	struct mm_slot *mm_slot;
+
+	list_for_each_entry(mm_slot, head, mm_node)
+		if (!mm_slot->worker)
+			return mm_slot;
+	return NULL;
+}
+
+/*
+ * Hand the next mm nobody else is scanning to @worker. Returns true if
+ * that started a new pass over the regular mm list.
+ */
+static bool khugepaged_claim_mm_slot(struct khugepaged_worker *worker)
+{
+	struct mm_slot *mm_slot = NULL;
+	bool wrapped = false;
+
+	lockdep_assert_held(&khugepaged_mm_lock);
+
+	/* Alternate between the lists so priority mms can't starve the rest */
+	worker->prio_turn = !worker->prio_turn;
+	if (worker->prio_turn)
+		mm_slot = khugepaged_first_idle_slot(&khugepaged_scan.prio_head);
+	if (!mm_slot) {
+		mm_slot = khugepaged_first_idle_slot(&khugepaged_scan.mm_head);
+		if (mm_slot && mm_slot->full_scans == khugepaged_full_scans) {
+			khugepaged_full_scans++;
+			wrapped = true;
+		}
+	}
+	if (!mm_slot)
+		mm_slot = khugepaged_first_idle_slot(&khugepaged_scan.prio_head);
+	if (!mm_slot)
+		return false;
+
+	mm_slot->worker = worker;
+	worker->mm_slot = mm_slot;
+	worker->address = 0;
+	return wrapped;
+}
+
+static void khugepaged_release_mm_slot(struct khugepaged_worker *worker)
+{
+	struct mm_slot *mm_slot = worker->mm_slot;
+
+	lockdep_assert_held(&khugepaged_mm_lock);
+
+	/*
+	 * Make sure that if mm_users is reaching zero while khugepaged runs
+	 * here, khugepaged_exit will find mm_slot not claimed by a worker.
+	 */
+	worker->mm_slot = NULL;
+	mm_slot->worker = NULL;
+	mm_slot->full_scans = khugepaged_full_scans;
+	list_move_tail(&mm_slot->mm_node, khugepaged_slot_list(mm_slot->mm));
+
+	collect_mm_slot(mm_slot);
+}
+
 #ifdef CONFIG_SHMEM
 /*
  * Notify khugepaged that given addr of the mm is pte-mapped THP. Then
@@ -1625,6 +1807,7 @@ static void collapse_file(struct mm_struct *mm,
 		struct page **hpage, int node)
 {
 	struct address_space *mapping = file->f_mapping;
+	ktime_t collapse_start = ktime_get();
 	gfp_t gfp;
 	struct page *new_page;
 	pgoff_t index, end = start + HPAGE_PMD_NR;
@@ -1902,7 +2085,7 @@ static void collapse_file(struct mm_struct *mm,
 		retract_page_tables(mapping, start);
 		*hpage = NULL;
 
-		khugepaged_pages_collapsed++;
+		khugepaged_account_collapse(collapse_start);
 	} else {
 		struct page *page;
 
@@ -1952,8 +2135,9 @@ static void collapse_file(struct mm_struct *mm,
 	/* TODO: tracepoints */
 }
 
-static void khugepaged_scan_file(struct mm_struct *mm,
-		struct file *file, pgoff_t start, struct page **hpage)
+static void khugepaged_scan_file(struct khugepaged_worker *worker,
+		struct mm_struct *mm, struct file *file, pgoff_t start,
+		struct page **hpage)
 {
 	struct page *page = NULL;
 	struct address_space *mapping = file->f_mapping;
@@ -1964,7 +2148,7 @@ static void khugepaged_scan_file(struct mm_struct *mm,
 
 	present = 0;
 	swap = 0;
-	memset(khugepaged_node_load, 0, sizeof(khugepaged_node_load));
+	memset(worker->node_load, 0, sizeof(worker->node_load));
 	rcu_read_lock();
 	xas_for_each(&xas, page, start + HPAGE_PMD_NR - 1) {
 		if (xas_retry(&xas, page))
@@ -1984,11 +2168,11 @@ static void khugepaged_scan_file(struct mm_struct *mm,
 		}
 
 		node = page_to_nid(page);
-		if (khugepaged_scan_abort(node)) {
+		if (khugepaged_scan_abort(worker, node)) {
 			result = SCAN_SCAN_ABORT;
 			break;
 		}
-		khugepaged_node_load[node]++;
+		worker->node_load[node]++;
 
 		if (!PageLRU(page)) {
 			result = SCAN_PAGE_LRU;
@@ -2020,7 +2204,7 @@ static void khugepaged_scan_file(struct mm_struct *mm,
 		if (present < HPAGE_PMD_NR - khugepaged_max_ptes_none) {
 			result = SCAN_EXCEED_NONE_PTE;
 		} else {
-			node = khugepaged_find_target_node();
+			node = khugepaged_find_target_node(worker);
 			collapse_file(mm, file, start, hpage, node);
 		}
 	}
@@ -2028,8 +2212,9 @@ static void khugepaged_scan_file(struct mm_struct *mm,
 	/* TODO: tracepoints */
 }
 #else
-static void khugepaged_scan_file(struct mm_struct *mm,
-		struct file *file, pgoff_t start, struct page **hpage)
+static void khugepaged_scan_file(struct khugepaged_worker *worker,
+		struct mm_struct *mm, struct file *file, pgoff_t start,
+		struct page **hpage)
 {
 	BUILD_BUG();
 }
@@ -2040,12 +2225,13 @@ static int khugepaged_collapse_pte_mapped_thps(struct mm_slot *mm_slot)
 }
 #endif
 
-static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
+static unsigned int khugepaged_scan_mm_slot(struct khugepaged_worker *worker,
+					    unsigned int pages,
 					    struct page **hpage)
 	__releases(&khugepaged_mm_lock)
 	__acquires(&khugepaged_mm_lock)
 {
-	struct mm_slot *mm_slot;
+	struct mm_slot *mm_slot = worker->mm_slot;
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
 	int progress = 0;
@@ -2053,14 +2239,6 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 	VM_BUG_ON(!pages);
 	lockdep_assert_held(&khugepaged_mm_lock);
 
-	if (khugepaged_scan.mm_slot)
-		mm_slot = khugepaged_scan.mm_slot;
-	else {
-		mm_slot = list_entry(khugepaged_scan.mm_head.next,
-				     struct mm_slot, mm_node);
-		khugepaged_scan.address = 0;
-		khugepaged_scan.mm_slot = mm_slot;
-	}
 	spin_unlock(&khugepaged_mm_lock);
 	khugepaged_collapse_pte_mapped_thps(mm_slot);
 
@@ -2073,7 +2251,7 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 	if (unlikely(!mmap_read_trylock(mm)))
 		goto breakouterloop_mmap_lock;
 	if (likely(!khugepaged_test_exit(mm)))
-		vma = find_vma(mm, khugepaged_scan.address);
+		vma = find_vma(mm, worker->address);
 
 	progress++;
 	for (; vma; vma = vma->vm_next) {
@@ -2093,39 +2271,38 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 		hend = vma->vm_end & HPAGE_PMD_MASK;
 		if (hstart >= hend)
 			goto skip;
-		if (khugepaged_scan.address > hend)
+		if (worker->address > hend)
 			goto skip;
-		if (khugepaged_scan.address < hstart)
-			khugepaged_scan.address = hstart;
-		VM_BUG_ON(khugepaged_scan.address & ~HPAGE_PMD_MASK);
+		if (worker->address < hstart)
+			worker->address = hstart;
+		VM_BUG_ON(worker->address & ~HPAGE_PMD_MASK);
 		if (shmem_file(vma->vm_file) && !shmem_huge_enabled(vma))
 			goto skip;
 
-		while (khugepaged_scan.address < hend) {
+		while (worker->address < hend) {
 			int ret;
 			cond_resched();
 			if (unlikely(khugepaged_test_exit(mm)))
 				goto breakouterloop;
 
-			VM_BUG_ON(khugepaged_scan.address < hstart ||
-				  khugepaged_scan.address + HPAGE_PMD_SIZE >
-				  hend);
+			VM_BUG_ON(worker->address < hstart ||
+				  worker->address + HPAGE_PMD_SIZE > hend);
 			if (IS_ENABLED(CONFIG_SHMEM) && vma->vm_file) {
 				struct file *file = get_file(vma->vm_file);
 				pgoff_t pgoff = linear_page_index(vma,
-						khugepaged_scan.address);
+						worker->address);
 
 				mmap_read_unlock(mm);
 				ret = 1;
-				khugepaged_scan_file(mm, file, pgoff, hpage);
+				khugepaged_scan_file(worker, mm, file, pgoff,
+						     hpage);
 				fput(file);
 			} else {
-				ret = khugepaged_scan_pmd(mm, vma,
-						khugepaged_scan.address,
-						hpage);
+				ret = khugepaged_scan_pmd(worker, mm, vma,
+						worker->address, hpage);
 			}
 			/* move to next address */
-			khugepaged_scan.address += HPAGE_PMD_SIZE;
+			worker->address += HPAGE_PMD_SIZE;
 			progress += HPAGE_PMD_NR;
 			if (ret)
 				/* we released mmap_lock so break loop */
@@ -2139,51 +2316,33 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 breakouterloop_mmap_lock:
 
 	spin_lock(&khugepaged_mm_lock);
-	VM_BUG_ON(khugepaged_scan.mm_slot != mm_slot);
+	VM_BUG_ON(worker->mm_slot != mm_slot);
 	/*
 	 * Release the current mm_slot if this mm is about to die, or
 	 * if we scanned all vmas of this mm.
 	 */
-	if (khugepaged_test_exit(mm) || !vma) {
-		/*
-		 * Make sure that if mm_users is reaching zero while
-		 * khugepaged runs here, khugepaged_exit will find
-		 * mm_slot not pointing to the exiting mm.
-		 */
-		if (mm_slot->mm_node.next != &khugepaged_scan.mm_head) {
-			khugepaged_scan.mm_slot = list_entry(
-				mm_slot->mm_node.next,
-				struct mm_slot, mm_node);
-			khugepaged_scan.address = 0;
-		} else {
-			khugepaged_scan.mm_slot = NULL;
-			khugepaged_full_scans++;
-		}
-
-		collect_mm_slot(mm_slot);
-	}
+	if (khugepaged_test_exit(mm) || !vma)
+		khugepaged_release_mm_slot(worker);
 
 	return progress;
 }
 
 static int khugepaged_has_work(void)
 {
-	return !list_empty(&khugepaged_scan.mm_head) &&
-		khugepaged_enabled();
+	return khugepaged_has_mms() && khugepaged_enabled();
 }
 
 static int khugepaged_wait_event(void)
 {
-	return !list_empty(&khugepaged_scan.mm_head) ||
-		kthread_should_stop();
+	return khugepaged_has_mms() || kthread_should_stop();
 }
 
-static void khugepaged_do_scan(void)
+static void khugepaged_do_scan(struct khugepaged_worker *worker)
 {
 	struct page *hpage = NULL;
-	unsigned int progress = 0, pass_through_head = 0;
+	unsigned int progress = 0;
 	unsigned int pages = khugepaged_pages_to_scan;
-	bool wait = true;
+	bool wait = true, wrapped = false;
 
 	barrier(); /* write khugepaged_pages_to_scan to local stack */
 
@@ -2199,11 +2358,12 @@ static void khugepaged_do_scan(void)
 			break;
 
 		spin_lock(&khugepaged_mm_lock);
-		if (!khugepaged_scan.mm_slot)
-			pass_through_head++;
-		if (khugepaged_has_work() &&
-		    pass_through_head < 2)
-			progress += khugepaged_scan_mm_slot(pages - progress,
+		/* Stop once the regular list has been gone through in full */
+		if (!worker->mm_slot && khugepaged_has_work())
+			wrapped = khugepaged_claim_mm_slot(worker);
+		if (worker->mm_slot && !wrapped)
+			progress += khugepaged_scan_mm_slot(worker,
+							    pages - progress,
 							    &hpage);
 		else
 			progress = pages;
@@ -2223,8 +2383,10 @@ static bool khugepaged_should_wakeup(void)
 static void khugepaged_wait_work(void)
 {
 	if (khugepaged_has_work()) {
-		const unsigned long scan_sleep_jiffies =
-			msecs_to_jiffies(khugepaged_scan_sleep_millisecs);
+		const unsigned long scan_sleep_jiffies = msecs_to_jiffies(
+			list_empty(&khugepaged_scan.prio_head) ?
+			khugepaged_scan_sleep_millisecs :
+			khugepaged_prio_scan_sleep_millisecs);
 
 		if (!scan_sleep_jiffies)
 			return;
@@ -2240,23 +2402,21 @@ static void khugepaged_wait_work(void)
 		wait_event_freezable(khugepaged_wait, khugepaged_wait_event());
 }
 
-static int khugepaged(void *none)
+static int khugepaged(void *data)
 {
-	struct mm_slot *mm_slot;
+	struct khugepaged_worker *worker = data;
 
 	set_freezable();
 	set_user_nice(current, MAX_NICE);
 
 	while (!kthread_should_stop()) {
-		khugepaged_do_scan();
+		khugepaged_do_scan(worker);
 		khugepaged_wait_work();
 	}
 
 	spin_lock(&khugepaged_mm_lock);
-	mm_slot = khugepaged_scan.mm_slot;
-	khugepaged_scan.mm_slot = NULL;
-	if (mm_slot)
-		collect_mm_slot(mm_slot);
+	if (worker->mm_slot)
+		khugepaged_release_mm_slot(worker);
 	spin_unlock(&khugepaged_mm_lock);
 	return 0;
 }
@@ -2305,29 +2465,91 @@ static void set_recommended_min_free_kbytes(void)
 	setup_per_zone_wmarks();
 }
 
+/*
+ * One worker is started for each node with memory, bound to that node's
+ * CPUs. On single node systems the only worker keeps the "khugepaged"
+ * name.
+ */
+static int khugepaged_start_worker(int nid)
+{
+	const struct cpumask *cpumask = cpumask_of_node(nid);
+	struct khugepaged_worker *worker;
+
+	lockdep_assert_held(&khugepaged_mutex);
+
+	if (khugepaged_workers[nid])
+		return 0;
+
+	worker = kzalloc_node(sizeof(*worker), GFP_KERNEL, nid);
+	if (!worker)
+		return -ENOMEM;
+
+	worker->nid = nid;
+	worker->last_target_node = NUMA_NO_NODE;
+	if (num_node_state(N_MEMORY) > 1)
+		worker->thread = kthread_create_on_node(khugepaged, worker, nid,
+							"khugepaged%d", nid);
+	else
+		worker->thread = kthread_create(khugepaged, worker,
+						"khugepaged");
+	if (IS_ERR(worker->thread)) {
+		int err = PTR_ERR(worker->thread);
+
+		pr_err("khugepaged: kthread_run(khugepaged%d) failed\n", nid);
+		kfree(worker);
+		return err;
+	}
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(worker->thread, cpumask);
+
+	khugepaged_workers[nid] = worker;
+	khugepaged_nr_workers++;
+	wake_up_process(worker->thread);
+
+	return 0;
+}
+
+static void khugepaged_stop_workers(void)
+{
+	int nid;
+
+	lockdep_assert_held(&khugepaged_mutex);
+
+	for_each_node(nid) {
+		struct khugepaged_worker *worker = khugepaged_workers[nid];
+
+		if (!worker)
+			continue;
+
+		kthread_stop(worker->thread);
+		khugepaged_workers[nid] = NULL;
+		khugepaged_nr_workers--;
+		kfree(worker);
+	}
+}
+
 int start_stop_khugepaged(void)
 {
 	int err = 0;
+	int nid;
 
 	mutex_lock(&khugepaged_mutex);
 	if (khugepaged_enabled()) {
-		if (!khugepaged_thread)
-			khugepaged_thread = kthread_run(khugepaged, NULL,
-							"khugepaged");
-		if (IS_ERR(khugepaged_thread)) {
-			pr_err("khugepaged: kthread_run(khugepaged) failed\n");
-			err = PTR_ERR(khugepaged_thread);
-			khugepaged_thread = NULL;
-			goto fail;
+		for_each_node_state(nid, N_MEMORY) {
+			err = khugepaged_start_worker(nid);
+			if (err)
+				break;
 		}
+		if (!khugepaged_nr_workers)
+			goto fail;
 
-		if (!list_empty(&khugepaged_scan.mm_head))
+		if (khugepaged_has_mms())
 			wake_up_interruptible(&khugepaged_wait);
 
 		set_recommended_min_free_kbytes();
-	} else if (khugepaged_thread) {
-		kthread_stop(khugepaged_thread);
-		khugepaged_thread = NULL;
+	} else {
+		khugepaged_stop_workers();
 	}
 fail:
 	mutex_unlock(&khugepaged_mutex);
@@ -2337,7 +2559,40 @@ int start_stop_khugepaged(void)
 void khugepaged_min_free_kbytes_update(void)
 {
 	mutex_lock(&khugepaged_mutex);
-	if (khugepaged_enabled() && khugepaged_thread)
+	if (khugepaged_enabled() && khugepaged_nr_workers)
 		set_recommended_min_free_kbytes();
 	mutex_unlock(&khugepaged_mutex);
 }
+
+/*
+ * PR_SET_THP_COLLAPSE_PRIO: have khugepaged scan @mm ahead of the other
+ * mms and with the shorter prio_scan_sleep_millisecs interval.
+ */
+int khugepaged_set_priority(struct mm_struct *mm, bool prio)
+{
+	struct mm_slot *mm_slot;
+
+	if (prio)
+		set_bit(MMF_THP_COLLAPSE_PRIO, &mm->flags);
+	else
+		clear_bit(MMF_THP_COLLAPSE_PRIO, &mm->flags);
+
+	spin_lock(&khugepaged_mm_lock);
+	mm_slot = get_mm_slot(mm);
+	/* A slot being scanned is requeued when its worker releases it */
+	if (mm_slot && !mm_slot->worker) {
+		if (prio)
+			list_move(&mm_slot->mm_node, &khugepaged_scan.prio_head);
+		else
+			list_move_tail(&mm_slot->mm_node,
+				       &khugepaged_scan.mm_head);
+	}
+	spin_unlock(&khugepaged_mm_lock);
+
+	if (prio) {
+		khugepaged_sleep_expire = 0;
+		wake_up_interruptible(&khugepaged_wait);
+	}
+
+	return 0;
+}
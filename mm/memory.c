@@ -692,6 +692,44 @@ struct page *vm_normal_page_pmd(struct vm_area_struct *vma, unsigned long addr,
  * covered by this vma.
  */
 
+/*
+ * Write protect a present pte for COW in the parent and return the pte
+ * to install in the child.
+ */
+static inline pte_t
+copy_present_pte(struct mm_struct *src_mm, pte_t *src_pte,
+		unsigned long vm_flags, unsigned long addr)
+{
+	pte_t pte = *src_pte;
+
+	/*
+	 * If it's a COW mapping, write protect it both
+	 * in the parent and the child
+	 */
+	if (is_cow_mapping(vm_flags) && pte_write(pte)) {
+		ptep_set_wrprotect(src_mm, addr, src_pte);
+		pte = pte_wrprotect(pte);
+	}
+
+	/*
+	 * If it's a shared mapping, mark it clean in
+	 * the child
+	 */
+	if (vm_flags & VM_SHARED)
+		pte = pte_mkclean(pte);
+	pte = pte_mkold(pte);
+
+	/*
+	 * Make sure the _PAGE_UFFD_WP bit is cleared if the new VMA
+	 * does not have the VM_UFFD_WP, which means that the uffd
+	 * fork event is not enabled.
+	 */
+	if (!(vm_flags & VM_UFFD_WP))
+		pte = pte_clear_uffd_wp(pte);
+
+	return pte;
+}
+
 static inline unsigned long
 copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pte_t *dst_pte, pte_t *src_pte, struct vm_area_struct *vma,
@@ -772,31 +810,7 @@ copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		goto out_set_pte;
 	}
 
-	/*
-	 * If it's a COW mapping, write protect it both
-	 * in the parent and the child
-	 */
-	if (is_cow_mapping(vm_flags) && pte_write(pte)) {
-		ptep_set_wrprotect(src_mm, addr, src_pte);
-		pte = pte_wrprotect(pte);
-	}
-
-	/*
-	 * If it's a shared mapping, mark it clean in
-	 * the child
-	 */
-	if (vm_flags & VM_SHARED)
-		pte = pte_mkclean(pte);
-	pte = pte_mkold(pte);
-
-	/*
-	 * Make sure the _PAGE_UFFD_WP bit is cleared if the new VMA
-	 * does not have the VM_UFFD_WP, which means that the uffd
-	 * fork event is not enabled.
-	 */
-	if (!(vm_flags & VM_UFFD_WP))
-		pte = pte_clear_uffd_wp(pte);
-
+	pte = copy_present_pte(src_mm, src_pte, vm_flags, addr);
 	page = vm_normal_page(vma, addr, pte);
 	if (page) {
 		get_page(page);
@@ -809,6 +823,56 @@ copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 	return 0;
 }
 
+/*
+ * Copy the present ptes from @src_pte that map consecutive subpages of
+ * the same compound page, as a PTE-mapped THP leaves behind. The page
+ * references for the whole run are taken with a single atomic on the
+ * head page instead of one per pte; the mapcount stays per subpage.
+ * Returns the number of ptes copied, or 0 if @src_pte doesn't start
+ * such a run and copy_one_pte() should handle it.
+ */
+static int copy_compound_ptes(struct mm_struct *dst_mm,
+		struct mm_struct *src_mm, pte_t *dst_pte, pte_t *src_pte,
+		struct vm_area_struct *vma, unsigned long addr,
+		unsigned long end, int *rss)
+{
+	pte_t pte = *src_pte;
+	struct page *page, *head;
+	unsigned long max_nr;
+	int nr, i;
+
+	/* Every pte of these needs its own vm_normal_page() check */
+	if (!pte_present(pte) || (vma->vm_flags & (VM_PFNMAP | VM_MIXEDMAP)))
+		return 0;
+
+	page = vm_normal_page(vma, addr, pte);
+	if (!page || !PageCompound(page))
+		return 0;
+
+	head = compound_head(page);
+	max_nr = min((end - addr) >> PAGE_SHIFT,
+		     compound_nr(head) - (unsigned long)(page - head));
+	for (nr = 1; nr < max_nr; nr++) {
+		pte_t next = src_pte[nr];
+
+		if (!pte_present(next) || pte_pfn(next) != pte_pfn(pte) + nr)
+			break;
+	}
+	if (nr == 1)
+		return 0;
+
+	page_ref_add(head, nr);
+	for (i = 0; i < nr; i++, addr += PAGE_SIZE) {
+		page_dup_rmap(page + i, false);
+		set_pte_at(dst_mm, addr, dst_pte + i,
+			   copy_present_pte(src_mm, src_pte + i,
+					    vma->vm_flags, addr));
+	}
+	rss[mm_counter(head)] += nr;
+
+	return nr;
+}
+
 static int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		   pmd_t *dst_pmd, pmd_t *src_pmd, struct vm_area_struct *vma,
 		   unsigned long addr, unsigned long end)
@@ -819,6 +883,7 @@ static int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 	int progress = 0;
 	int rss[NR_MM_COUNTERS];
 	swp_entry_t entry = (swp_entry_t){0};
+	int nr;
 
 again:
 	init_rss_vec(rss);
@@ -848,6 +913,15 @@ static int copy_pte_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 			progress++;
 			continue;
 		}
+		nr = copy_compound_ptes(dst_mm, src_mm, dst_pte, src_pte,
+					vma, addr, end, rss);
+		if (nr) {
+			progress += 8 * nr;
+			dst_pte += nr - 1;
+			src_pte += nr - 1;
+			addr += (nr - 1) * PAGE_SIZE;
+			continue;
+		}
 		entry.val = copy_one_pte(dst_mm, src_mm, dst_pte, src_pte,
 							vma, addr, rss);
 		if (entry.val)
@@ -3109,6 +3183,15 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	if (!pte_unmap_same(vma->vm_mm, vmf->pmd, vmf->pte, vmf->orig_pte))
 		goto out;
 
+	/*
+	 * Swapin and migration to RAM may need to drop mmap_lock, have them
+	 * retried with it held.
+	 */
+	if (vmf->flags & FAULT_FLAG_VMA_LOCK) {
+		ret = VM_FAULT_RETRY;
+		goto out;
+	}
+
 	entry = pte_to_swp_entry(vmf->orig_pte);
 	if (unlikely(non_swap_entry(entry))) {
 		if (is_migration_entry(entry)) {
@@ -3160,9 +3243,7 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 				 * XXX: Move to lru_cache_add() when it
 				 * supports new vs putback
 				 */
-				spin_lock_irq(&page_pgdat(page)->lru_lock);
 				lru_note_cost_page(page);
-				spin_unlock_irq(&page_pgdat(page)->lru_lock);
 
 				lru_cache_add(page);
 				swap_readpage(page, true);
@@ -4422,6 +4503,65 @@ vm_fault_t handle_mm_fault(struct vm_area_struct *vma, unsigned long address,
 }
 EXPORT_SYMBOL_GPL(handle_mm_fault);
 
+#ifdef CONFIG_PER_VMA_LOCK
+/*
+ * Look up and read-lock the VMA covering @address without mmap_lock.
+ *
+ * The rbtree is walked locklessly, which may miss a VMA while the tree is
+ * being rebalanced but never loops, and VMAs are freed by RCU. Returns NULL
+ * whenever the VMA cannot be used safely, in which case the caller has to
+ * fall back to mmap_lock.
+ *
+ * Only anonymous VMAs that already have an anon_vma are handled: setting
+ * one up looks at the neighbouring VMAs, and stack expansion and
+ * userfaultfd both rely on mmap_lock.
+ */
+struct vm_area_struct *lock_vma_under_rcu(struct mm_struct *mm,
+					  unsigned long address)
+{
+	struct vm_area_struct *vma = NULL;
+	struct rb_node *node;
+
+	rcu_read_lock();
+	node = READ_ONCE(mm->mm_rb.rb_node);
+	while (node) {
+		struct vm_area_struct *tmp;
+
+		tmp = rb_entry(node, struct vm_area_struct, vm_rb);
+		if (READ_ONCE(tmp->vm_end) > address) {
+			vma = tmp;
+			if (READ_ONCE(tmp->vm_start) <= address)
+				break;
+			node = READ_ONCE(node->rb_left);
+		} else {
+			node = READ_ONCE(node->rb_right);
+		}
+	}
+
+	if (!vma || !vma_start_read(vma))
+		goto inval;
+
+	/* Writers are excluded now, recheck what the walk raced with */
+	if (unlikely(vma->vm_detached || address < vma->vm_start ||
+		     address >= vma->vm_end))
+		goto inval_end_read;
+
+	if (!vma_is_anonymous(vma) || !vma->anon_vma ||
+	    userfaultfd_armed(vma) ||
+	    (vma->vm_flags & (VM_GROWSDOWN | VM_GROWSUP)))
+		goto inval_end_read;
+
+	rcu_read_unlock();
+	return vma;
+
+inval_end_read:
+	vma_end_read(vma);
+inval:
+	rcu_read_unlock();
+	return NULL;
+}
+#endif /* CONFIG_PER_VMA_LOCK */
+
 #ifndef __PAGETABLE_P4D_FOLDED
 /*
  * Allocate p4d page table.
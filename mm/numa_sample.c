@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * NUMA placement driven by hardware memory access samples.
+ *
+ * Automatic NUMA balancing normally learns about remote accesses by
+ * periodically unmapping ranges of a task's address space (PROT_NONE)
+ * and taking a hinting fault on the next touch. That costs a fault and
+ * a TLB flush for every sampled page, whether or not it is misplaced.
+ *
+ * A hardware sampling source (such as the Arm Statistical Profiling
+ * Extension) can report the physical address of a sampled load or store
+ * instead. Samples are queued per CPU from the source's interrupt handler
+ * and drained from a per-CPU work item, which migrates private anonymous
+ * pages towards the node that keeps accessing them. While at least one
+ * source is registered the PROT_NONE scanner is left idle.
+ */
+#include <linux/mm.h>
+#include <linux/mempolicy.h>
+#include <linux/migrate.h>
+#include <linux/percpu.h>
+#include <linux/rmap.h>
+#include <linux/sched/numa_balancing.h>
+#include <linux/vmstat.h>
+#include <linux/workqueue.h>
+
+#define NUMA_SAMPLE_BATCH	512
+
+/*
+ * Two batches so that the interrupt handler can keep filling one while
+ * the work item migrates pages out of the other.
+ */
+struct numa_sample_buf {
+	unsigned long pfns[2][NUMA_SAMPLE_BATCH];
+	unsigned int nr[2];
+	unsigned int active;
+	int cpu;
+	struct work_struct work;
+};
+
+static DEFINE_PER_CPU(struct numa_sample_buf, numa_sample_bufs);
+
+DEFINE_STATIC_KEY_FALSE(numa_sample_key);
+EXPORT_SYMBOL_GPL(numa_sample_key);
+
+static DEFINE_MUTEX(numa_sample_lock);
+static int numa_sample_sources;
+
+static bool numa_sample_rmap_one(struct page *page, struct vm_area_struct *vma,
+				 unsigned long addr, void *arg)
+{
+	bool *allowed = arg;
+
+	/*
+	 * Memory placed by an explicit VMA policy stays where the policy
+	 * put it, just like mpol_misplaced() refuses to move it without
+	 * MPOL_F_MOF.
+	 */
+	if (vma->vm_policy || !vma_migratable(vma))
+		*allowed = false;
+
+	return *allowed;
+}
+
+static bool numa_sample_migratable(struct page *page)
+{
+	bool allowed = true;
+	struct rmap_walk_control rwc = {
+		.rmap_one = numa_sample_rmap_one,
+		.arg = &allowed,
+		.anon_lock = page_lock_anon_vma_read,
+	};
+
+	rmap_walk(page, &rwc);
+
+	return allowed;
+}
+
+static void numa_sample_page(unsigned long pfn, int cpu)
+{
+	int nid = cpu_to_node(cpu);
+	struct page *page;
+	int last_cpupid;
+
+	page = pfn_to_online_page(pfn);
+	if (!page || page_to_nid(page) == nid)
+		return;
+
+	count_vm_numa_event(NUMA_HW_SAMPLES_REMOTE);
+
+	/* Unlocked checks first, so most samples cost no atomic op */
+	if (!PageLRU(page) || !PageAnon(page) || PageCompound(page))
+		return;
+
+	if (!get_page_unless_zero(page))
+		return;
+
+	/*
+	 * Only private pages: shared ones would bounce between the nodes of
+	 * their users, and with a single mapping migrate_misplaced_page()
+	 * does not need the vma.
+	 */
+	if (!PageAnon(page) || PageKsm(page) || PageCompound(page) ||
+	    page_mapcount(page) != 1)
+		goto out_put;
+
+	/*
+	 * Use the same two-stage filter as should_numa_migrate_memory():
+	 * a page is only moved once two consecutive samples came from the
+	 * destination node, which filters out one-off accesses.
+	 */
+	last_cpupid = page_cpupid_xchg_last(page, cpu_pid_to_cpupid(cpu, 0));
+	if (cpupid_pid_unset(last_cpupid) || cpupid_to_nid(last_cpupid) != nid)
+		goto out_put;
+
+	if (!numa_sample_migratable(page))
+		goto out_put;
+
+	/* Consumes our reference */
+	migrate_misplaced_page(page, NULL, nid);
+	return;
+
+out_put:
+	put_page(page);
+}
+
+static void numa_sample_work(struct work_struct *work)
+{
+	struct numa_sample_buf *buf = container_of(work, struct numa_sample_buf,
+						   work);
+	unsigned int idx, i;
+
+	local_irq_disable();
+	idx = buf->active;
+	buf->active ^= 1;
+	local_irq_enable();
+
+	for (i = 0; i < buf->nr[idx]; i++) {
+		numa_sample_page(buf->pfns[idx][i], buf->cpu);
+		cond_resched();
+	}
+
+	buf->nr[idx] = 0;
+}
+
+/**
+ * numa_sample_add - report a sampled memory access
+ * @paddr: physical address accessed by the current CPU
+ *
+ * Called by a hardware sampling source with interrupts disabled, on the
+ * CPU that performed the access.
+ */
+void numa_sample_add(phys_addr_t paddr)
+{
+	struct numa_sample_buf *buf = this_cpu_ptr(&numa_sample_bufs);
+	unsigned int idx = buf->active;
+
+	count_vm_numa_event(NUMA_HW_SAMPLES);
+
+	if (buf->nr[idx] >= NUMA_SAMPLE_BATCH)
+		return;
+
+	buf->pfns[idx][buf->nr[idx]++] = PHYS_PFN(paddr);
+	if (buf->nr[idx] == 1)
+		queue_work_on(buf->cpu, system_wq, &buf->work);
+}
+EXPORT_SYMBOL_GPL(numa_sample_add);
+
+/**
+ * numa_sample_source_register - announce a hardware sampling source
+ *
+ * The PROT_NONE hinting scanner is idle while at least one source is
+ * registered. Must be paired with numa_sample_source_unregister().
+ */
+void numa_sample_source_register(void)
+{
+	mutex_lock(&numa_sample_lock);
+	if (!numa_sample_sources++)
+		static_branch_enable(&numa_sample_key);
+	mutex_unlock(&numa_sample_lock);
+}
+EXPORT_SYMBOL_GPL(numa_sample_source_register);
+
+void numa_sample_source_unregister(void)
+{
+	int cpu;
+
+	mutex_lock(&numa_sample_lock);
+	if (!--numa_sample_sources) {
+		static_branch_disable(&numa_sample_key);
+		for_each_possible_cpu(cpu)
+			flush_work(&per_cpu(numa_sample_bufs, cpu).work);
+	}
+	mutex_unlock(&numa_sample_lock);
+}
+EXPORT_SYMBOL_GPL(numa_sample_source_unregister);
+
+static int __init numa_sample_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct numa_sample_buf *buf = &per_cpu(numa_sample_bufs, cpu);
+
+		buf->cpu = cpu;
+		INIT_WORK(&buf->work, numa_sample_work);
+	}
+
+	return 0;
+}
+early_initcall(numa_sample_init);
@@ -263,6 +263,31 @@ int swap_writepage(struct page *page, struct writeback_control *wbc)
 	return ret;
 }
 
+static void end_swap_bio_read_batch(struct bio *bio)
+{
+	struct bio_vec *bvec;
+	struct bvec_iter_all iter_all;
+
+	if (bio->bi_status)
+		pr_alert("Read-error on swap-device (%u:%u:%llu)\n",
+			 MAJOR(bio_dev(bio)), MINOR(bio_dev(bio)),
+			 (unsigned long long)bio->bi_iter.bi_sector);
+
+	bio_for_each_segment_all(bvec, bio, iter_all) {
+		struct page *page = bvec->bv_page;
+
+		if (bio->bi_status) {
+			SetPageError(page);
+			ClearPageUptodate(page);
+		} else {
+			SetPageUptodate(page);
+			swap_slot_free_notify(page);
+		}
+		unlock_page(page);
+	}
+	bio_put(bio);
+}
+
 static sector_t swap_page_sector(struct page *page)
 {
 	return (sector_t)__page_file_index(page) << (PAGE_SHIFT - 9);
@@ -350,7 +375,64 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 	return ret;
 }
 
-int swap_readpage(struct page *page, bool synchronous)
+/*
+ * Add @page to the bio being built in @batch, or start a new one if the
+ * page isn't on the same device right after the pages already queued.
+ */
+static int swap_read_batch_add(struct swap_read_batch *batch,
+			       struct page *page)
+{
+	struct bio *bio = batch->bio;
+	struct block_device *bdev;
+	sector_t sector;
+
+	sector = map_swap_page(page, &bdev) << (PAGE_SHIFT - 9);
+
+	if (bio && (batch->bdev != bdev || bio_end_sector(bio) != sector ||
+		    !bio_add_page(bio, page, PAGE_SIZE, 0))) {
+		swap_read_batch_submit(batch);
+		bio = NULL;
+	}
+
+	if (!bio) {
+		bio = bio_alloc(GFP_KERNEL, clamp_t(unsigned int,
+				batch->nr_pages, 1, BIO_MAX_PAGES));
+		if (!bio) {
+			unlock_page(page);
+			return -ENOMEM;
+		}
+		bio->bi_iter.bi_sector = sector;
+		bio_set_dev(bio, bdev);
+		bio->bi_end_io = end_swap_bio_read_batch;
+		bio_set_op_attrs(bio, REQ_OP_READ, 0);
+		bio_add_page(bio, page, PAGE_SIZE, 0);
+		batch->bio = bio;
+		batch->bdev = bdev;
+	}
+
+	count_vm_event(PSWPIN);
+	return 0;
+}
+
+/**
+ * swap_read_batch_submit - submit the reads collected in a batch
+ * @batch: the batch passed to swap_readpage_batch()
+ */
+void swap_read_batch_submit(struct swap_read_batch *batch)
+{
+	unsigned long pflags;
+
+	if (!batch->bio)
+		return;
+
+	psi_memstall_enter(&pflags);
+	submit_bio(batch->bio);
+	psi_memstall_leave(&pflags);
+	batch->bio = NULL;
+}
+
+static int __swap_readpage(struct page *page, bool synchronous,
+			   struct swap_read_batch *batch)
 {
 	struct bio *bio;
 	int ret = 0;
@@ -397,6 +479,11 @@ int swap_readpage(struct page *page, bool synchronous)
 		goto out;
 	}
 
+	if (batch) {
+		ret = swap_read_batch_add(batch, page);
+		goto out;
+	}
+
 	ret = 0;
 	bio = get_swap_bio(GFP_KERNEL, page, end_swap_bio_read);
 	if (bio == NULL) {
@@ -434,6 +521,25 @@ int swap_readpage(struct page *page, bool synchronous)
 	return ret;
 }
 
+int swap_readpage(struct page *page, bool synchronous)
+{
+	return __swap_readpage(page, synchronous, NULL);
+}
+
+/**
+ * swap_readpage_batch - start reading a swap cache page as part of a batch
+ * @page: locked swap cache page
+ * @batch: the batch collecting the reads
+ *
+ * Like swap_readpage(page, false), except that block device reads are
+ * merged into @batch->bio while they are contiguous on disk. The caller
+ * must call swap_read_batch_submit() once done adding pages.
+ */
+int swap_readpage_batch(struct page *page, struct swap_read_batch *batch)
+{
+	return __swap_readpage(page, false, batch);
+}
+
 int swap_set_page_dirty(struct page *page)
 {
 	struct swap_info_struct *sis = page_swap_info(page);
@@ -157,6 +157,69 @@ static void read_pages(struct readahead_control *rac, struct list_head *pages,
 		rac->_index++;
 }
 
+#ifdef CONFIG_READ_ONLY_THP_FOR_FS
+/*
+ * Like the read-only file THPs that khugepaged collapses, THPs are only
+ * read ahead for files nobody has open for writing, and do_dentry_open()
+ * drops them once somebody does. Returns the index up to which THPs may
+ * be used, which excludes a partial one at EOF, or 0 if none may.
+ */
+static pgoff_t ra_thp_end(struct address_space *mapping)
+{
+	struct inode *inode = mapping->host;
+
+	if (!transparent_hugepage_file_readahead() ||
+	    !mapping->a_ops->readpage_thp || !S_ISREG(inode->i_mode))
+		return 0;
+	if (inode_is_open_for_write(inode))
+		return 0;
+	return i_size_read(inode) >> PAGE_SHIFT;
+}
+
+static int page_cache_read_thp(struct address_space *mapping,
+		struct file *file, pgoff_t index, gfp_t gfp_mask)
+{
+	struct page *page;
+	int err;
+
+	/* Not worth compacting for: fall back to small pages instead */
+	page = alloc_pages((gfp_mask | __GFP_COMP) & ~__GFP_DIRECT_RECLAIM,
+			   HPAGE_PMD_ORDER);
+	if (!page) {
+		count_vm_event(THP_FILE_FALLBACK);
+		return -ENOMEM;
+	}
+	prep_transhuge_page(page);
+
+	__SetPageLocked(page);
+	err = add_to_page_cache_thp(page, mapping, index, gfp_mask);
+	if (err) {
+		__ClearPageLocked(page);
+		put_page(page);
+		return err;
+	}
+
+	err = mapping->a_ops->readpage_thp(file, page);
+	if (err) {
+		delete_from_page_cache(page);
+		unlock_page(page);
+	}
+	put_page(page);
+	return err;
+}
+#else
+static inline pgoff_t ra_thp_end(struct address_space *mapping)
+{
+	return 0;
+}
+
+static inline int page_cache_read_thp(struct address_space *mapping,
+		struct file *file, pgoff_t index, gfp_t gfp_mask)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 /**
  * page_cache_readahead_unbounded - Start unchecked readahead.
  * @mapping: File address space.
@@ -184,6 +247,7 @@ void page_cache_readahead_unbounded(struct address_space *mapping,
 		.file = file,
 		._index = index,
 	};
+	pgoff_t thp_end = ra_thp_end(mapping);
 	unsigned long i;
 
 	/*
@@ -206,6 +270,25 @@ void page_cache_readahead_unbounded(struct address_space *mapping,
 
 		BUG_ON(index + i != rac._index + rac._nr_pages);
 
+		/*
+		 * Read a whole PMD sized range as one THP if it is aligned,
+		 * fits the window and doesn't hold the PG_readahead mark,
+		 * which can't be set on a compound page.
+		 */
+		if (thp_end && index + i + HPAGE_PMD_NR <= thp_end &&
+		    !((index + i) & (HPAGE_PMD_NR - 1)) &&
+		    nr_to_read - i >= HPAGE_PMD_NR &&
+		    (nr_to_read - lookahead_size < i ||
+		     nr_to_read - lookahead_size >= i + HPAGE_PMD_NR)) {
+			read_pages(&rac, &page_pool, false);
+			if (!page_cache_read_thp(mapping, file, index + i,
+						 gfp_mask)) {
+				rac._index += HPAGE_PMD_NR;
+				i += HPAGE_PMD_NR - 1;
+				continue;
+			}
+		}
+
 		if (page && !xa_is_value(page)) {
 			/*
 			 * Page already present?  Kick off the current batch
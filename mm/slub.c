@@ -1474,6 +1474,22 @@ static __always_inline bool slab_free_hook(struct kmem_cache *s, void *x)
 	return kasan_slab_free(s, x, _RET_IP_);
 }
 
+static __always_inline void slab_init_on_free(struct kmem_cache *s,
+					      void *object)
+{
+	int rsize;
+
+	if (!slab_want_init_on_free(s))
+		return;
+
+	/*
+	 * Clear the object and the metadata, but don't touch the redzone.
+	 */
+	memset(object, 0, s->object_size);
+	rsize = (s->flags & SLAB_RED_ZONE) ? s->red_left_pad : 0;
+	memset((char *)object + s->inuse, 0, s->size - s->inuse - rsize);
+}
+
 static inline bool slab_free_freelist_hook(struct kmem_cache *s,
 					   void **head, void **tail)
 {
@@ -1481,7 +1497,6 @@ static inline bool slab_free_freelist_hook(struct kmem_cache *s,
 	void *object;
 	void *next = *head;
 	void *old_tail = *tail ? *tail : *head;
-	int rsize;
 
 	/* Head and tail of the reconstructed freelist */
 	*head = NULL;
@@ -1491,18 +1506,8 @@ static inline bool slab_free_freelist_hook(struct kmem_cache *s,
 		object = next;
 		next = get_freepointer(s, object);
 
-		if (slab_want_init_on_free(s)) {
-			/*
-			 * Clear the object and the metadata, but don't touch
-			 * the redzone.
-			 */
-			memset(object, 0, s->object_size);
-			rsize = (s->flags & SLAB_RED_ZONE) ? s->red_left_pad
-							   : 0;
-			memset((char *)object + s->inuse, 0,
-			       s->size - s->inuse - rsize);
+		slab_init_on_free(s, object);
 
-		}
 		/* If object's reuse doesn't have to be delayed */
 		if (!slab_free_hook(s, object)) {
 			/* Move object to the new freelist */
@@ -1878,6 +1883,10 @@ static inline void *acquire_slab(struct kmem_cache *s,
 
 static void put_cpu_partial(struct kmem_cache *s, struct page *page, int drain);
 static inline bool pfmemalloc_match(struct page *page, gfp_t gfpflags);
+static void *cpu_array_alloc(struct kmem_cache *s, gfp_t gfpflags);
+static void cpu_array_free(struct kmem_cache *s, void *x);
+static void cpu_array_flush(struct kmem_cache *s, struct kmem_cache_array *ca,
+			    unsigned int nr);
 
 /*
  * Try to allocate a partial slab from a specific node.
@@ -2373,6 +2382,13 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	if (s->cpu_array) {
+		struct kmem_cache_array *ca = per_cpu_ptr(s->cpu_array, cpu);
+
+		if (ca->count)
+			cpu_array_flush(s, ca, ca->count);
+	}
+
 	if (c->page)
 		flush_slab(s, c);
 
@@ -2391,6 +2407,9 @@ static bool has_cpu_slab(int cpu, void *info)
 	struct kmem_cache *s = info;
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	if (s->cpu_array && per_cpu_ptr(s->cpu_array, cpu)->count)
+		return true;
+
 	return c->page || slub_percpu_partial(c);
 }
 
@@ -2748,6 +2767,12 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 	s = slab_pre_alloc_hook(s, gfpflags);
 	if (!s)
 		return NULL;
+
+	if (s->cpu_array && node == NUMA_NO_NODE) {
+		object = cpu_array_alloc(s, gfpflags);
+		if (likely(object))
+			goto out;
+	}
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -2816,6 +2841,7 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 		stat(s, ALLOC_FASTPATH);
 	}
 
+out:
 	maybe_wipe_obj_freeptr(s, object);
 
 	if (unlikely(slab_want_init_on_alloc(gfpflags, s)) && object)
@@ -3085,7 +3111,10 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 	s = cache_from_obj(s, x);
 	if (!s)
 		return;
-	slab_free(s, virt_to_head_page(x), x, NULL, 1, _RET_IP_);
+	if (s->cpu_array)
+		cpu_array_free(s, x);
+	else
+		slab_free(s, virt_to_head_page(x), x, NULL, 1, _RET_IP_);
 	trace_kmem_cache_free(_RET_IP_, x);
 }
 EXPORT_SYMBOL(kmem_cache_free);
@@ -3199,23 +3228,19 @@ void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
 }
 EXPORT_SYMBOL(kmem_cache_free_bulk);
 
-/* Note that interrupts must be enabled when calling this function. */
-int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
-			  void **p)
+/*
+ * Take up to @size objects off the cpu slab, refilling it from the partial
+ * lists or the page allocator as needed, without running any of the
+ * allocation hooks. Must be called with interrupts disabled, which
+ * protects against PREEMPT and interrupt handlers invoking the normal
+ * fastpath. Returns the number of objects stored in @p.
+ */
+static int __kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags,
+				   size_t size, void **p)
 {
 	struct kmem_cache_cpu *c;
 	int i;
 
-	/* memcg and kmem_cache debug support */
-	s = slab_pre_alloc_hook(s, flags);
-	if (unlikely(!s))
-		return false;
-	/*
-	 * Drain objects in the per cpu slab, while disabling local
-	 * IRQs, which protects against PREEMPT and interrupts
-	 * handlers invoking normal fastpath.
-	 */
-	local_irq_disable();
 	c = this_cpu_ptr(s->cpu_slab);
 
 	for (i = 0; i < size; i++) {
@@ -3238,7 +3263,7 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 			p[i] = ___slab_alloc(s, flags, NUMA_NO_NODE,
 					    _RET_IP_, c);
 			if (unlikely(!p[i]))
-				goto error;
+				return i;
 
 			c = this_cpu_ptr(s->cpu_slab);
 			maybe_wipe_obj_freeptr(s, p[i]);
@@ -3250,7 +3275,26 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 		maybe_wipe_obj_freeptr(s, p[i]);
 	}
 	c->tid = next_tid(c->tid);
+
+	return i;
+}
+
+/* Note that interrupts must be enabled when calling this function. */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	int i;
+
+	/* memcg and kmem_cache debug support */
+	s = slab_pre_alloc_hook(s, flags);
+	if (unlikely(!s))
+		return false;
+
+	local_irq_disable();
+	i = __kmem_cache_alloc_bulk(s, flags, size, p);
 	local_irq_enable();
+	if (unlikely(i < size))
+		goto error;
 
 	/* Clear memory outside IRQ disabled fastpath loop */
 	if (unlikely(slab_want_init_on_alloc(flags, s))) {
@@ -3264,13 +3308,97 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 	slab_post_alloc_hook(s, flags, size, p);
 	return i;
 error:
-	local_irq_enable();
 	slab_post_alloc_hook(s, flags, i, p);
 	__kmem_cache_free_bulk(s, i, p);
 	return 0;
 }
 EXPORT_SYMBOL(kmem_cache_alloc_bulk);
 
+/*
+ * Per cpu object arrays (SLAB_CPU_ARRAY).
+ *
+ * Caches whose objects are routinely freed on a different cpu than they
+ * were allocated on (skbs, dentries, files) keep hitting __slab_free() and
+ * the node list_lock, because the freed object rarely belongs to the
+ * freeing cpu's slab. For such caches kmem_cache_free() pushes the object
+ * onto a small per cpu stack instead, and allocations pop from it. The
+ * stack is refilled in bulk from the cpu slab when empty, and the oldest
+ * half is returned to the slabs in bulk when full.
+ *
+ * All operations run with interrupts disabled, like the bulk interfaces.
+ */
+static void cpu_array_flush(struct kmem_cache *s, struct kmem_cache_array *ca,
+			    unsigned int nr)
+{
+	size_t size = nr;
+
+	do {
+		struct detached_freelist df;
+
+		size = build_detached_freelist(s, size, ca->objects, &df);
+		if (!df.page)
+			continue;
+
+		do_slab_free(df.s, df.page, df.freelist, df.tail, df.cnt,
+			     _RET_IP_);
+	} while (size);
+
+	ca->count -= nr;
+	memmove(ca->objects, ca->objects + nr, ca->count * sizeof(void *));
+	stat(s, CPU_ARRAY_FLUSH);
+}
+
+static void *cpu_array_alloc(struct kmem_cache *s, gfp_t gfpflags)
+{
+	struct kmem_cache_array *ca;
+	unsigned long flags;
+	void *object = NULL;
+
+	local_irq_save(flags);
+	ca = this_cpu_ptr(s->cpu_array);
+	if (unlikely(!ca->count)) {
+		/*
+		 * Don't let a new slab allocation enable interrupts: we
+		 * could migrate and refill another cpu's array. If the
+		 * refill fails, the caller falls back to the regular path,
+		 * which may block.
+		 */
+		ca->count = __kmem_cache_alloc_bulk(s,
+				(gfpflags & ~__GFP_DIRECT_RECLAIM) | __GFP_NOWARN,
+				s->cpu_array_size / 2, ca->objects);
+		stat(s, CPU_ARRAY_REFILL);
+	}
+	if (likely(ca->count)) {
+		object = ca->objects[--ca->count];
+		stat(s, ALLOC_CPU_ARRAY);
+	}
+	local_irq_restore(flags);
+
+	return object;
+}
+
+static void cpu_array_free(struct kmem_cache *s, void *x)
+{
+	struct kmem_cache_array *ca;
+	unsigned long flags;
+
+	/*
+	 * The object is free as far as the hooks are concerned from here
+	 * on; flushing it back to its slab later bypasses them.
+	 */
+	slab_init_on_free(s, x);
+	if (slab_free_hook(s, x))
+		return;
+
+	local_irq_save(flags);
+	ca = this_cpu_ptr(s->cpu_array);
+	if (unlikely(ca->count == s->cpu_array_size))
+		cpu_array_flush(s, ca, s->cpu_array_size / 2);
+	ca->objects[ca->count++] = x;
+	stat(s, FREE_CPU_ARRAY);
+	local_irq_restore(flags);
+}
+
 
 /*
  * Object placement in a slab is made very easy because we always start at
@@ -3426,6 +3554,31 @@ static inline int alloc_kmem_cache_cpus(struct kmem_cache *s)
 
 	init_kmem_cache_cpus(s);
 
+	/*
+	 * Debugging needs every free to reach free_debug_processing(), so
+	 * debug caches run without object arrays.
+	 */
+	if ((s->flags & SLAB_CPU_ARRAY) && !kmem_cache_debug(s)) {
+		/* Same sizing as SLAB's per cpu array caches */
+		if (s->size > PAGE_SIZE)
+			s->cpu_array_size = 8;
+		else if (s->size > 1024)
+			s->cpu_array_size = 24;
+		else if (s->size > 256)
+			s->cpu_array_size = 54;
+		else
+			s->cpu_array_size = 120;
+
+		s->cpu_array = __alloc_percpu(sizeof(struct kmem_cache_array) +
+					      s->cpu_array_size * sizeof(void *),
+					      sizeof(void *));
+		if (!s->cpu_array) {
+			free_percpu(s->cpu_slab);
+			s->cpu_slab = NULL;
+			return 0;
+		}
+	}
+
 	return 1;
 }
 
@@ -3491,6 +3644,7 @@ static void free_kmem_cache_nodes(struct kmem_cache *s)
 void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
+	free_percpu(s->cpu_array);
 	free_percpu(s->cpu_slab);
 	free_kmem_cache_nodes(s);
 }
@@ -5091,6 +5245,12 @@ static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(cpu_partial);
 
+static ssize_t cpu_array_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%u\n", s->cpu_array ? s->cpu_array_size : 0);
+}
+SLAB_ATTR_RO(cpu_array);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -5497,6 +5657,10 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(ALLOC_CPU_ARRAY, alloc_cpu_array);
+STAT_ATTR(FREE_CPU_ARRAY, free_cpu_array);
+STAT_ATTR(CPU_ARRAY_REFILL, cpu_array_refill);
+STAT_ATTR(CPU_ARRAY_FLUSH, cpu_array_flush);
 #endif	/* CONFIG_SLUB_STATS */
 
 static struct attribute *slab_attrs[] = {
@@ -5506,6 +5670,7 @@ static struct attribute *slab_attrs[] = {
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
+	&cpu_array_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -5563,6 +5728,10 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&alloc_cpu_array_attr.attr,
+	&free_cpu_array_attr.attr,
+	&cpu_array_refill_attr.attr,
+	&cpu_array_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -88,6 +88,25 @@ PLIST_HEAD(swap_active_head);
 static struct plist_head *swap_avail_heads;
 static DEFINE_SPINLOCK(swap_avail_lock);
 
+/*
+ * Bumped under swap_avail_lock whenever a device is added to or removed
+ * from the avail lists, which invalidates every CPU's swap_cpu_cache.
+ */
+static unsigned long swap_avail_gen;
+
+/*
+ * The device a CPU last allocated slots from. The per-cpu slot cache is
+ * refilled straight from it without taking swap_avail_lock or requeueing
+ * the device, so CPUs that picked different devices of equal priority
+ * only meet on their own si->lock.
+ */
+struct swap_cpu_cache {
+	struct swap_info_struct *si;
+	unsigned long gen;
+	int node;
+};
+static DEFINE_PER_CPU(struct swap_cpu_cache, swap_cpu_cache);
+
 struct swap_info_struct *swap_info[MAX_SWAPFILES];
 
 static DEFINE_MUTEX(swapon_mutex);
@@ -655,6 +674,7 @@ static void __del_from_avail_list(struct swap_info_struct *p)
 
 	for_each_node(nid)
 		plist_del(&p->avail_lists[nid], &swap_avail_heads[nid]);
+	WRITE_ONCE(swap_avail_gen, swap_avail_gen + 1);
 }
 
 static void del_from_avail_list(struct swap_info_struct *p)
@@ -690,6 +710,7 @@ static void add_to_avail_list(struct swap_info_struct *p)
 		WARN_ON(!plist_node_empty(&p->avail_lists[nid]));
 		plist_add(&p->avail_lists[nid], &swap_avail_heads[nid]);
 	}
+	WRITE_ONCE(swap_avail_gen, swap_avail_gen + 1);
 	spin_unlock(&swap_avail_lock);
 }
 
@@ -1029,10 +1050,52 @@ static unsigned long scan_swap_map(struct swap_info_struct *si,
 
 }
 
+/*
+ * Allocate from the device this CPU used last time, as long as the set of
+ * available devices hasn't changed since. swap_info_structs are never
+ * freed once they have been swapped on, so a stale pointer is harmless.
+ */
+static int get_swap_pages_cpu(int n_goal, swp_entry_t swp_entries[])
+{
+	struct swap_cpu_cache *cache;
+	struct swap_info_struct *si;
+	unsigned long gen;
+	int node, n_ret = 0;
+
+	cache = get_cpu_ptr(&swap_cpu_cache);
+	si = cache->si;
+	gen = cache->gen;
+	node = cache->node;
+	put_cpu_ptr(&swap_cpu_cache);
+
+	if (!si || gen != READ_ONCE(swap_avail_gen) || node != numa_node_id())
+		return 0;
+
+	spin_lock(&si->lock);
+	if (si->highest_bit && (si->flags & SWP_WRITEOK))
+		n_ret = scan_swap_map_slots(si, SWAP_HAS_CACHE, n_goal,
+					    swp_entries);
+	spin_unlock(&si->lock);
+
+	return n_ret;
+}
+
+static void set_swap_cpu_cache(struct swap_info_struct *si,
+			       unsigned long gen, int node)
+{
+	struct swap_cpu_cache *cache = get_cpu_ptr(&swap_cpu_cache);
+
+	cache->si = si;
+	cache->gen = gen;
+	cache->node = node;
+	put_cpu_ptr(&swap_cpu_cache);
+}
+
 int get_swap_pages(int n_goal, swp_entry_t swp_entries[], int entry_size)
 {
 	unsigned long size = swap_entry_size(entry_size);
 	struct swap_info_struct *si, *next;
+	unsigned long gen;
 	long avail_pgs;
 	int n_ret = 0;
 	int node;
@@ -1048,10 +1111,17 @@ int get_swap_pages(int n_goal, swp_entry_t swp_entries[], int entry_size)
 
 	atomic_long_sub(n_goal * size, &nr_swap_pages);
 
+	if (size == 1) {
+		n_ret = get_swap_pages_cpu(n_goal, swp_entries);
+		if (n_ret)
+			goto check_out;
+	}
+
 	spin_lock(&swap_avail_lock);
 
 start_over:
 	node = numa_node_id();
+	gen = swap_avail_gen;
 	plist_for_each_entry_safe(si, next, &swap_avail_heads[node], avail_lists[node]) {
 		/* requeue si to after same-priority siblings */
 		plist_requeue(&si->avail_lists[node], &swap_avail_heads[node]);
@@ -1080,6 +1150,8 @@ int get_swap_pages(int n_goal, swp_entry_t swp_entries[], int entry_size)
 			n_ret = scan_swap_map_slots(si, SWAP_HAS_CACHE,
 						    n_goal, swp_entries);
 		spin_unlock(&si->lock);
+		if (n_ret && size == 1)
+			set_swap_cpu_cache(si, gen, node);
 		if (n_ret || size == SWAPFILE_CLUSTER)
 			goto check_out;
 		pr_debug("scan_swap_map of si %d failed to find offset\n",
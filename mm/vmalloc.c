@@ -35,6 +35,7 @@
 #include <linux/bitops.h>
 #include <linux/rbtree_augmented.h>
 #include <linux/overflow.h>
+#include <linux/io.h>
 
 #include <linux/uaccess.h>
 #include <asm/tlbflush.h>
@@ -218,9 +219,33 @@ static int vmap_pte_range(pmd_t *pmd, unsigned long addr,
 	return 0;
 }
 
+/*
+ * Map a whole PMD with one block entry if the pages backing it come from
+ * a single naturally aligned allocation of at least PMD size.
+ */
+static int vmap_try_huge_pmd(pmd_t *pmd, unsigned long addr,
+		unsigned long end, pgprot_t prot, struct page **pages, int *nr,
+		unsigned int page_shift)
+{
+	if (page_shift < PMD_SHIFT)
+		return 0;
+
+	if (end - addr != PMD_SIZE || !IS_ALIGNED(addr, PMD_SIZE))
+		return 0;
+
+	if (pmd_present(*pmd) && !pmd_free_pte_page(pmd, addr))
+		return 0;
+
+	if (!pmd_set_huge(pmd, page_to_phys(pages[*nr]), prot))
+		return 0;
+
+	*nr += PMD_SIZE >> PAGE_SHIFT;
+	return 1;
+}
+
 static int vmap_pmd_range(pud_t *pud, unsigned long addr,
 		unsigned long end, pgprot_t prot, struct page **pages, int *nr,
-		pgtbl_mod_mask *mask)
+		pgtbl_mod_mask *mask, unsigned int page_shift)
 {
 	pmd_t *pmd;
 	unsigned long next;
@@ -230,6 +255,13 @@ static int vmap_pmd_range(pud_t *pud, unsigned long addr,
 		return -ENOMEM;
 	do {
 		next = pmd_addr_end(addr, end);
+
+		if (vmap_try_huge_pmd(pmd, addr, next, prot, pages, nr,
+				      page_shift)) {
+			*mask |= PGTBL_PMD_MODIFIED;
+			continue;
+		}
+
 		if (vmap_pte_range(pmd, addr, next, prot, pages, nr, mask))
 			return -ENOMEM;
 	} while (pmd++, addr = next, addr != end);
@@ -238,7 +270,7 @@ static int vmap_pmd_range(pud_t *pud, unsigned long addr,
 
 static int vmap_pud_range(p4d_t *p4d, unsigned long addr,
 		unsigned long end, pgprot_t prot, struct page **pages, int *nr,
-		pgtbl_mod_mask *mask)
+		pgtbl_mod_mask *mask, unsigned int page_shift)
 {
 	pud_t *pud;
 	unsigned long next;
@@ -248,7 +280,8 @@ static int vmap_pud_range(p4d_t *p4d, unsigned long addr,
 		return -ENOMEM;
 	do {
 		next = pud_addr_end(addr, end);
-		if (vmap_pmd_range(pud, addr, next, prot, pages, nr, mask))
+		if (vmap_pmd_range(pud, addr, next, prot, pages, nr, mask,
+				   page_shift))
 			return -ENOMEM;
 	} while (pud++, addr = next, addr != end);
 	return 0;
@@ -256,7 +289,7 @@ static int vmap_pud_range(p4d_t *p4d, unsigned long addr,
 
 static int vmap_p4d_range(pgd_t *pgd, unsigned long addr,
 		unsigned long end, pgprot_t prot, struct page **pages, int *nr,
-		pgtbl_mod_mask *mask)
+		pgtbl_mod_mask *mask, unsigned int page_shift)
 {
 	p4d_t *p4d;
 	unsigned long next;
@@ -266,32 +299,20 @@ static int vmap_p4d_range(pgd_t *pgd, unsigned long addr,
 		return -ENOMEM;
 	do {
 		next = p4d_addr_end(addr, end);
-		if (vmap_pud_range(p4d, addr, next, prot, pages, nr, mask))
+		if (vmap_pud_range(p4d, addr, next, prot, pages, nr, mask,
+				   page_shift))
 			return -ENOMEM;
 	} while (p4d++, addr = next, addr != end);
 	return 0;
 }
 
-/**
- * map_kernel_range_noflush - map kernel VM area with the specified pages
- * @addr: start of the VM area to map
- * @size: size of the VM area to map
- * @prot: page protection flags to use
- * @pages: pages to map
- *
- * Map PFN_UP(@size) pages at @addr.  The VM area @addr and @size specify should
- * have been allocated using get_vm_area() and its friends.
- *
- * NOTE:
- * This function does NOT do any cache flushing.  The caller is responsible for
- * calling flush_cache_vmap() on to-be-mapped areas before calling this
- * function.
- *
- * RETURNS:
- * 0 on success, -errno on failure.
+/*
+ * @pages holds every PAGE_SIZE page of the range; with a @page_shift above
+ * PAGE_SHIFT, each run of 1 << (@page_shift - PAGE_SHIFT) of them must be
+ * one physically contiguous, naturally aligned chunk.
  */
-int map_kernel_range_noflush(unsigned long addr, unsigned long size,
-			     pgprot_t prot, struct page **pages)
+static int vmap_pages_range_noflush(unsigned long addr, unsigned long size,
+		pgprot_t prot, struct page **pages, unsigned int page_shift)
 {
 	unsigned long start = addr;
 	unsigned long end = addr + size;
@@ -307,7 +328,8 @@ int map_kernel_range_noflush(unsigned long addr, unsigned long size,
 		next = pgd_addr_end(addr, end);
 		if (pgd_bad(*pgd))
 			mask |= PGTBL_PGD_MODIFIED;
-		err = vmap_p4d_range(pgd, addr, next, prot, pages, &nr, &mask);
+		err = vmap_p4d_range(pgd, addr, next, prot, pages, &nr, &mask,
+				     page_shift);
 		if (err)
 			return err;
 	} while (pgd++, addr = next, addr != end);
@@ -318,6 +340,30 @@ int map_kernel_range_noflush(unsigned long addr, unsigned long size,
 	return 0;
 }
 
+/**
+ * map_kernel_range_noflush - map kernel VM area with the specified pages
+ * @addr: start of the VM area to map
+ * @size: size of the VM area to map
+ * @prot: page protection flags to use
+ * @pages: pages to map
+ *
+ * Map PFN_UP(@size) pages at @addr.  The VM area @addr and @size specify should
+ * have been allocated using get_vm_area() and its friends.
+ *
+ * NOTE:
+ * This function does NOT do any cache flushing.  The caller is responsible for
+ * calling flush_cache_vmap() on to-be-mapped areas before calling this
+ * function.
+ *
+ * RETURNS:
+ * 0 on success, -errno on failure.
+ */
+int map_kernel_range_noflush(unsigned long addr, unsigned long size,
+			     pgprot_t prot, struct page **pages)
+{
+	return vmap_pages_range_noflush(addr, size, prot, pages, PAGE_SHIFT);
+}
+
 int map_kernel_range(unsigned long start, unsigned long size, pgprot_t prot,
 		struct page **pages)
 {
@@ -372,17 +418,20 @@ struct page *vmalloc_to_page(const void *vmalloc_addr)
 	/*
 	 * Don't dereference bad PUD or PMD (below) entries. This will also
 	 * identify huge mappings, which we may encounter on architectures
-	 * that define CONFIG_HAVE_ARCH_HUGE_VMAP=y. Such regions will be
-	 * identified as vmalloc addresses by is_vmalloc_addr(), but are
-	 * not [unambiguously] associated with a struct page, so there is
-	 * no correct value to return for them.
+	 * that define CONFIG_HAVE_ARCH_HUGE_VMAP=y. Those made by ioremap()
+	 * are not [unambiguously] associated with a struct page, but those
+	 * made by vmalloc_huge() are, so resolve PMD leaves.
 	 */
 	WARN_ON_ONCE(pud_bad(*pud));
 	if (pud_none(*pud) || pud_bad(*pud))
 		return NULL;
 	pmd = pmd_offset(pud, addr);
+	if (pmd_none(*pmd))
+		return NULL;
+	if (pmd_leaf(*pmd))
+		return pmd_page(*pmd) + ((addr & ~PMD_MASK) >> PAGE_SHIFT);
 	WARN_ON_ONCE(pmd_bad(*pmd));
-	if (pmd_none(*pmd) || pmd_bad(*pmd))
+	if (pmd_bad(*pmd))
 		return NULL;
 
 	ptep = pte_offset_map(pmd, addr);
@@ -486,6 +535,17 @@ static unsigned long lazy_max_pages(void);
 
 static atomic_long_t nr_vmalloc_pages;
 
+/* Whether vmalloc_huge() may map with PMD block entries */
+static bool vmap_allow_huge __ro_after_init = true;
+static bool vmap_pmd_capable __ro_after_init;
+
+static int __init set_nohugevmalloc(char *str)
+{
+	vmap_allow_huge = false;
+	return 0;
+}
+early_param("nohugevmalloc", set_nohugevmalloc);
+
 unsigned long vmalloc_nr_pages(void)
 {
 	return atomic_long_read(&nr_vmalloc_pages);
@@ -2039,6 +2099,11 @@ void __init vmalloc_init(void)
 	 */
 	vmap_init_free_space();
 	vmap_initialized = true;
+
+#ifdef CONFIG_HAVE_ARCH_HUGE_VMAP
+	/* Same requirement as huge ioremap() mappings */
+	vmap_pmd_capable = arch_ioremap_pmd_supported();
+#endif
 }
 
 /**
@@ -2440,10 +2505,13 @@ void *vmap(struct page **pages, unsigned int count,
 EXPORT_SYMBOL(vmap);
 
 static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
-				 pgprot_t prot, int node)
+				 pgprot_t prot, unsigned int page_shift,
+				 int node)
 {
+	unsigned int page_order = page_shift - PAGE_SHIFT;
 	struct page **pages;
-	unsigned int nr_pages, array_size, i;
+	unsigned int nr_pages, array_size, i, j;
+	int err;
 	const gfp_t nested_gfp = (gfp_mask & GFP_RECLAIM_MASK) | __GFP_ZERO;
 	const gfp_t alloc_mask = gfp_mask | __GFP_NOWARN;
 	const gfp_t highmem_mask = (gfp_mask & (GFP_DMA | GFP_DMA32)) ?
@@ -2470,10 +2538,23 @@ static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
 	area->pages = pages;
 	area->nr_pages = nr_pages;
 
-	for (i = 0; i < area->nr_pages; i++) {
+	for (i = 0; i < area->nr_pages; i += 1U << page_order) {
 		struct page *page;
 
-		if (node == NUMA_NO_NODE)
+		if (page_order) {
+			/* Don't try hard, the caller falls back to small pages */
+			gfp_t huge_mask = alloc_mask | highmem_mask |
+					  __GFP_NORETRY;
+
+			if (node == NUMA_NO_NODE)
+				page = alloc_pages(huge_mask, page_order);
+			else
+				page = alloc_pages_node(node, huge_mask,
+							page_order);
+			/* Each page is freed on its own by __vunmap() */
+			if (page)
+				split_page(page, page_order);
+		} else if (node == NUMA_NO_NODE)
 			page = alloc_page(alloc_mask|highmem_mask);
 		else
 			page = alloc_pages_node(node, alloc_mask|highmem_mask, 0);
@@ -2482,16 +2563,24 @@ static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
 			/* Successfully allocated i pages, free them in __vunmap() */
 			area->nr_pages = i;
 			atomic_long_add(area->nr_pages, &nr_vmalloc_pages);
+			if (page_order) {
+				__vfree(area->addr);
+				return NULL;
+			}
 			goto fail;
 		}
-		area->pages[i] = page;
+		for (j = 0; j < 1U << page_order; j++)
+			area->pages[i + j] = page + j;
 		if (gfpflags_allow_blocking(gfp_mask))
 			cond_resched();
 	}
 	atomic_long_add(area->nr_pages, &nr_vmalloc_pages);
 
-	if (map_kernel_range((unsigned long)area->addr, get_vm_area_size(area),
-			prot, pages) < 0)
+	err = vmap_pages_range_noflush((unsigned long)area->addr,
+			get_vm_area_size(area), prot, pages, page_shift);
+	flush_cache_vmap((unsigned long)area->addr,
+			 (unsigned long)area->addr + get_vm_area_size(area));
+	if (err < 0)
 		goto fail;
 
 	return area->addr;
@@ -2530,19 +2619,41 @@ void *__vmalloc_node_range(unsigned long size, unsigned long align,
 	struct vm_struct *area;
 	void *addr;
 	unsigned long real_size = size;
+	unsigned long real_align = align;
+	unsigned int shift = PAGE_SHIFT;
 
 	size = PAGE_ALIGN(size);
 	if (!size || (size >> PAGE_SHIFT) > totalram_pages())
 		goto fail;
 
-	area = __get_vm_area_node(real_size, align, VM_ALLOC | VM_UNINITIALIZED |
+	/*
+	 * Pages are split and freed one by one, which doesn't go with kmem
+	 * accounting, and set_memory_*() can't change a block mapping.
+	 */
+	if (vmap_allow_huge && vmap_pmd_capable &&
+	    (vm_flags & VM_ALLOW_HUGE_VMAP) &&
+	    !(vm_flags & VM_FLUSH_RESET_PERMS) &&
+	    !(gfp_mask & __GFP_ACCOUNT) && size >= PMD_SIZE) {
+		shift = PMD_SHIFT;
+		size = ALIGN(real_size, PMD_SIZE);
+		align = max(real_align, PMD_SIZE);
+	}
+
+again:
+	area = __get_vm_area_node(size, align, VM_ALLOC | VM_UNINITIALIZED |
 				vm_flags, start, end, node, gfp_mask, caller);
-	if (!area)
+	if (!area) {
+		if (shift > PAGE_SHIFT)
+			goto fallback;
 		goto fail;
+	}
 
-	addr = __vmalloc_area_node(area, gfp_mask, prot, node);
-	if (!addr)
+	addr = __vmalloc_area_node(area, gfp_mask, prot, shift, node);
+	if (!addr) {
+		if (shift > PAGE_SHIFT)
+			goto fallback;
 		return NULL;
+	}
 
 	/*
 	 * In this function, newly allocated vm_struct has VM_UNINITIALIZED
@@ -2555,6 +2666,12 @@ void *__vmalloc_node_range(unsigned long size, unsigned long align,
 
 	return addr;
 
+fallback:
+	shift = PAGE_SHIFT;
+	size = PAGE_ALIGN(real_size);
+	align = real_align;
+	goto again;
+
 fail:
 	warn_alloc(gfp_mask, NULL,
 			  "vmalloc: allocation failure: %lu bytes", real_size);
@@ -2602,6 +2719,27 @@ void *__vmalloc(unsigned long size, gfp_t gfp_mask)
 }
 EXPORT_SYMBOL(__vmalloc);
 
+/**
+ * vmalloc_huge - allocate virtually contiguous memory, maybe PMD mapped
+ * @size:	    allocation size
+ * @gfp_mask:	    flags for the page level allocator
+ *
+ * Like __vmalloc(), but allocations of at least PMD_SIZE are rounded up to
+ * whole PMDs and mapped with block entries where the architecture allows,
+ * which saves TLB entries for large tables. Falls back to small pages if
+ * no PMD sized pages can be had. The memory must not be passed to
+ * set_memory_*().
+ *
+ * Return: pointer to the allocated memory or %NULL on error
+ */
+void *vmalloc_huge(unsigned long size, gfp_t gfp_mask)
+{
+	return __vmalloc_node_range(size, 1, VMALLOC_START, VMALLOC_END,
+				    gfp_mask, PAGE_KERNEL, VM_ALLOW_HUGE_VMAP,
+				    NUMA_NO_NODE, __builtin_return_address(0));
+}
+EXPORT_SYMBOL_GPL(vmalloc_huge);
+
 /**
  * vmalloc - allocate virtually contiguous memory
  * @size:    allocation size
@@ -22,6 +22,7 @@
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
 #include <linux/sched.h>
+#include <linux/sched/isolation.h>
 #include <linux/math64.h>
 #include <linux/writeback.h>
 #include <linux/compaction.h>
@@ -1074,6 +1075,24 @@ static int __fragmentation_index(unsigned int order, struct contig_page_info *in
 	return 1000 - div_u64( (1000+(div_u64(info->free_pages * 1000ULL, requested))), info->free_blocks_total);
 }
 
+/*
+ * Calculates external fragmentation within a zone wrt the given order.
+ * It is defined as the percentage of pages found in blocks of size
+ * less than 1 << order. It returns values in range [0, 100].
+ */
+unsigned int extfrag_for_order(struct zone *zone, unsigned int order)
+{
+	struct contig_page_info info;
+
+	fill_contig_page_info(zone, order, &info);
+	if (info.free_pages == 0)
+		return 0;
+
+	return div_u64((info.free_pages -
+			(info.free_blocks_suitable << order)) * 100,
+			info.free_pages);
+}
+
 /* Same as __fragmentation index but allocs contig_page_info on stack */
 int fragmentation_index(struct zone *zone, unsigned int order)
 {
@@ -1230,6 +1249,10 @@ const char * const vmstat_text[] = {
 	"numa_hint_faults",
 	"numa_hint_faults_local",
 	"numa_pages_migrated",
+#ifdef CONFIG_NUMA_BALANCING_HW_SAMPLING
+	"numa_hw_samples",
+	"numa_hw_samples_remote",
+#endif
 #endif
 #ifdef CONFIG_MIGRATION
 	"pgmigrate_success",
@@ -1816,11 +1839,13 @@ int vmstat_refresh(struct ctl_table *table, int write,
 
 static void vmstat_update(struct work_struct *w)
 {
-	if (refresh_cpu_vm_stats(true)) {
+	if (refresh_cpu_vm_stats(true) &&
+	    !cpu_is_isolated(smp_processor_id())) {
 		/*
 		 * Counters were updated so we expect more updates
 		 * to occur in the future. Keep on running the
-		 * update worker thread.
+		 * update worker thread, unless this CPU is isolated
+		 * and must not be interrupted by it.
 		 */
 		queue_delayed_work_on(smp_processor_id(), mm_percpu_wq,
 				this_cpu_ptr(&vmstat_work),
@@ -1874,7 +1899,12 @@ void quiet_vmstat(void)
 	if (system_state != SYSTEM_RUNNING)
 		return;
 
-	if (!delayed_work_pending(this_cpu_ptr(&vmstat_work)))
+	/*
+	 * Isolated CPUs never have the worker queued, so this is the only
+	 * place their differentials get folded.
+	 */
+	if (!delayed_work_pending(this_cpu_ptr(&vmstat_work)) &&
+	    !cpu_is_isolated(smp_processor_id()))
 		return;
 
 	if (!need_update(smp_processor_id()))
@@ -1908,6 +1938,13 @@ static void vmstat_shepherd(struct work_struct *w)
 	for_each_online_cpu(cpu) {
 		struct delayed_work *dw = &per_cpu(vmstat_work, cpu);
 
+		/*
+		 * Leave isolated CPUs alone; they fold their differentials
+		 * themselves via quiet_vmstat() when the tick stops.
+		 */
+		if (cpu_is_isolated(cpu))
+			continue;
+
 		if (!delayed_work_pending(dw) && need_update(cpu))
 			queue_delayed_work_on(cpu, mm_percpu_wq, dw, 0);
 	}
@@ -141,6 +141,28 @@ struct net_device *br_fdb_find_port(const struct net_device *br_dev,
 }
 EXPORT_SYMBOL_GPL(br_fdb_find_port);
 
+/* Same as br_fdb_find_port() for callers in the packet path.  Local
+ * entries are skipped, the caller must hold rcu_read_lock().
+ */
+struct net_device *br_fdb_find_port_rcu(const struct net_device *br_dev,
+					const unsigned char *addr,
+					__u16 vid)
+{
+	struct net_bridge_fdb_entry *f;
+	struct net_bridge *br;
+
+	if (!netif_is_bridge_master(br_dev))
+		return NULL;
+
+	br = netdev_priv(br_dev);
+	f = br_fdb_find_rcu(br, addr, vid);
+	if (!f || !f->dst || test_bit(BR_FDB_LOCAL, &f->flags))
+		return NULL;
+
+	return f->dst->dev;
+}
+EXPORT_SYMBOL_GPL(br_fdb_find_port_rcu);
+
 struct net_bridge_fdb_entry *br_fdb_find_rcu(struct net_bridge *br,
 					     const unsigned char *addr,
 					     __u16 vid)
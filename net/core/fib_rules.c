@@ -10,6 +10,7 @@
 #include <linux/slab.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/jhash.h>
 #include <net/net_namespace.h>
 #include <net/sock.h>
 #include <net/fib_rules.h>
@@ -169,10 +170,14 @@ fib_rules_register(const struct fib_rules_ops *tmpl, struct net *net)
 }
 EXPORT_SYMBOL_GPL(fib_rules_register);
 
+static void fib_rules_index_drop(struct fib_rules_ops *ops);
+
 static void fib_rules_cleanup_ops(struct fib_rules_ops *ops)
 {
 	struct fib_rule *rule, *tmp;
 
+	fib_rules_index_drop(ops);
+
 	list_for_each_entry_safe(rule, tmp, &ops->rules_list, list) {
 		list_del_rcu(&rule->list);
 		if (ops->delete)
@@ -242,6 +247,253 @@ static int nla_put_port_range(struct sk_buff *skb, int attrtype,
 	return nla_put(skb, attrtype, sizeof(*range), range);
 }
 
+/*
+ * Lookup index
+ *
+ * Rules that can only ever match one input interface, or one exact
+ * firewall mark, are grouped by that key.  A lookup then only considers
+ * the group for the flow's iif, the group for its mark and the rules
+ * that fit neither, merged back into list order.  Everything else about
+ * matching is unchanged, the index merely skips rules that cannot match.
+ *
+ * The index is an immutable snapshot built under RTNL whenever the rule
+ * list or the interface indexes of its rules change.  It is dropped
+ * before the rules it points to can be freed.
+ */
+#define FIB_RULES_INDEX_MIN	16
+
+enum {
+	FIB_RULE_KEY_NONE,
+	FIB_RULE_KEY_IIF,
+	FIB_RULE_KEY_MARK,
+};
+
+struct fib_rule_ent {
+	struct fib_rule		*rule;
+	unsigned int		seq;	/* position in rules_list */
+};
+
+struct fib_rule_run {
+	struct fib_rule_run	*next;
+	u32			key;
+	u8			type;
+	unsigned int		nr;
+	struct fib_rule_ent	*ents;
+};
+
+struct fib_rules_index {
+	struct rcu_head		rcu;
+	struct fib_rule_run	wild;
+	struct fib_rule_ent	*ents;
+	unsigned int		hmask;
+	struct fib_rule_run	*hash[];
+};
+
+struct fib_rule_cursor {
+	const struct fib_rule_ent *pos;
+	const struct fib_rule_ent *end;
+};
+
+static u8 fib_rule_key(const struct fib_rule *rule, u32 *key)
+{
+	if (rule->flags & FIB_RULE_INVERT)
+		return FIB_RULE_KEY_NONE;
+
+	if (rule->iifindex) {
+		*key = rule->iifindex;
+		return FIB_RULE_KEY_IIF;
+	}
+	if (rule->mark_mask == 0xFFFFFFFF) {
+		*key = rule->mark;
+		return FIB_RULE_KEY_MARK;
+	}
+	return FIB_RULE_KEY_NONE;
+}
+
+static struct fib_rule_run *fib_rules_index_find(const struct fib_rules_index *idx,
+						 u8 type, u32 key)
+{
+	struct fib_rule_run *run;
+
+	run = idx->hash[jhash_2words(key, type, 0) & idx->hmask];
+	for (; run; run = run->next)
+		if (run->key == key && run->type == type)
+			return run;
+	return NULL;
+}
+
+static void fib_rules_index_free(struct fib_rules_index *idx)
+{
+	struct fib_rule_run *run, *next;
+	unsigned int i;
+
+	for (i = 0; i <= idx->hmask; i++) {
+		for (run = idx->hash[i]; run; run = next) {
+			next = run->next;
+			kfree(run);
+		}
+	}
+	kvfree(idx->ents);
+	kvfree(idx);
+}
+
+static void fib_rules_index_free_rcu(struct rcu_head *head)
+{
+	fib_rules_index_free(container_of(head, struct fib_rules_index, rcu));
+}
+
+static struct fib_rules_index *fib_rules_index_build(struct fib_rules_ops *ops)
+{
+	unsigned int nr = 0, nr_keyed = 0, hsize, i, seq;
+	struct fib_rules_index *idx;
+	struct fib_rule_run *run;
+	struct fib_rule_ent *ent;
+	struct fib_rule *rule;
+	u32 key;
+	u8 type;
+
+	list_for_each_entry(rule, &ops->rules_list, list) {
+		nr++;
+		if (fib_rule_key(rule, &key) != FIB_RULE_KEY_NONE)
+			nr_keyed++;
+	}
+	if (nr < FIB_RULES_INDEX_MIN || !nr_keyed)
+		return NULL;
+
+	hsize = roundup_pow_of_two(nr_keyed);
+	idx = kvzalloc(struct_size(idx, hash, hsize), GFP_KERNEL);
+	if (!idx)
+		return NULL;
+	idx->hmask = hsize - 1;
+
+	idx->ents = kvmalloc_array(nr, sizeof(*idx->ents), GFP_KERNEL);
+	if (!idx->ents)
+		goto err;
+
+	/* Size the runs first so each gets a contiguous slice of ents */
+	list_for_each_entry(rule, &ops->rules_list, list) {
+		type = fib_rule_key(rule, &key);
+		if (type == FIB_RULE_KEY_NONE) {
+			idx->wild.nr++;
+			continue;
+		}
+		run = fib_rules_index_find(idx, type, key);
+		if (!run) {
+			unsigned int h = jhash_2words(key, type, 0) & idx->hmask;
+
+			run = kzalloc(sizeof(*run), GFP_KERNEL);
+			if (!run)
+				goto err;
+			run->key = key;
+			run->type = type;
+			run->next = idx->hash[h];
+			idx->hash[h] = run;
+		}
+		run->nr++;
+	}
+
+	ent = idx->ents;
+	idx->wild.ents = ent;
+	ent += idx->wild.nr;
+	idx->wild.nr = 0;
+	for (i = 0; i < hsize; i++) {
+		for (run = idx->hash[i]; run; run = run->next) {
+			run->ents = ent;
+			ent += run->nr;
+			run->nr = 0;
+		}
+	}
+
+	seq = 0;
+	list_for_each_entry(rule, &ops->rules_list, list) {
+		type = fib_rule_key(rule, &key);
+		if (type == FIB_RULE_KEY_NONE)
+			run = &idx->wild;
+		else
+			run = fib_rules_index_find(idx, type, key);
+		ent = &run->ents[run->nr++];
+		ent->rule = rule;
+		ent->seq = seq++;
+	}
+
+	return idx;
+
+err:
+	fib_rules_index_free(idx);
+	return NULL;
+}
+
+/* Must be called with RTNL held after every change to the rule list */
+static void fib_rules_index_update(struct fib_rules_ops *ops)
+{
+	struct fib_rules_index *old = rtnl_dereference(ops->index);
+
+	rcu_assign_pointer(ops->index, fib_rules_index_build(ops));
+	if (old)
+		call_rcu(&old->rcu, fib_rules_index_free_rcu);
+}
+
+static void fib_rules_index_drop(struct fib_rules_ops *ops)
+{
+	struct fib_rules_index *old = rcu_dereference_protected(ops->index, 1);
+
+	RCU_INIT_POINTER(ops->index, NULL);
+	if (old)
+		call_rcu(&old->rcu, fib_rules_index_free_rcu);
+}
+
+static void fib_rule_cursor_init(struct fib_rule_cursor *c,
+				 const struct fib_rule_run *run)
+{
+	c->pos = run->ents;
+	c->end = run->ents + run->nr;
+}
+
+static int fib_rules_index_cursors(const struct fib_rules_index *idx,
+				   const struct flowi *fl,
+				   struct fib_rule_cursor *c)
+{
+	const struct fib_rule_run *run;
+	int n = 0;
+
+	fib_rule_cursor_init(&c[n++], &idx->wild);
+
+	run = fib_rules_index_find(idx, FIB_RULE_KEY_IIF, fl->flowi_iif);
+	if (run)
+		fib_rule_cursor_init(&c[n++], run);
+
+	run = fib_rules_index_find(idx, FIB_RULE_KEY_MARK, fl->flowi_mark);
+	if (run)
+		fib_rule_cursor_init(&c[n++], run);
+
+	return n;
+}
+
+/* The next candidate in list order */
+static struct fib_rule *fib_rule_cursor_next(struct fib_rule_cursor *c, int n)
+{
+	struct fib_rule_cursor *best = NULL;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (c[i].pos == c[i].end)
+			continue;
+		if (!best || c[i].pos->seq < best->pos->seq)
+			best = &c[i];
+	}
+	return best ? (best->pos++)->rule : NULL;
+}
+
+/* Continue with the first candidate at or after a goto target */
+static void fib_rule_cursor_seek(struct fib_rule_cursor *c, int n, u32 pref)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		while (c[i].pos != c[i].end && c[i].pos->rule->pref < pref)
+			c[i].pos++;
+}
+
 static int fib_rule_match(struct fib_rule *rule, struct fib_rules_ops *ops,
 			  struct flowi *fl, int flags,
 			  struct fib_lookup_arg *arg)
@@ -272,14 +524,64 @@ static int fib_rule_match(struct fib_rule *rule, struct fib_rules_ops *ops,
 	return (rule->flags & FIB_RULE_INVERT) ? !ret : ret;
 }
 
+static int fib_rules_index_lookup(struct fib_rules_ops *ops,
+				  const struct fib_rules_index *idx,
+				  struct flowi *fl, int flags,
+				  struct fib_lookup_arg *arg)
+{
+	struct fib_rule_cursor cursor[3];
+	struct fib_rule *rule;
+	int n, err;
+
+	n = fib_rules_index_cursors(idx, fl, cursor);
+
+	while ((rule = fib_rule_cursor_next(cursor, n))) {
+		if (!fib_rule_match(rule, ops, fl, flags, arg))
+			continue;
+
+		if (rule->action == FR_ACT_GOTO) {
+			struct fib_rule *target;
+
+			target = rcu_dereference(rule->ctarget);
+			if (target)
+				fib_rule_cursor_seek(cursor, n, target->pref);
+			continue;
+		} else if (rule->action == FR_ACT_NOP)
+			continue;
+		else
+			err = ops->action(rule, fl, flags, arg);
+
+		if (!err && ops->suppress && ops->suppress(rule, arg))
+			continue;
+
+		if (err != -EAGAIN) {
+			if ((arg->flags & FIB_LOOKUP_NOREF) ||
+			    likely(refcount_inc_not_zero(&rule->refcnt))) {
+				arg->rule = rule;
+				return err;
+			}
+			break;
+		}
+	}
+
+	return -ESRCH;
+}
+
 int fib_rules_lookup(struct fib_rules_ops *ops, struct flowi *fl,
 		     int flags, struct fib_lookup_arg *arg)
 {
+	const struct fib_rules_index *idx;
 	struct fib_rule *rule;
 	int err;
 
 	rcu_read_lock();
 
+	idx = rcu_dereference(ops->index);
+	if (idx) {
+		err = fib_rules_index_lookup(ops, idx, fl, flags, arg);
+		goto out;
+	}
+
 	list_for_each_entry_rcu(rule, &ops->rules_list, list) {
 jumped:
 		if (!fib_rule_match(rule, ops, fl, flags, arg))
@@ -822,6 +1124,7 @@ int fib_nl_newrule(struct sk_buff *skb, struct nlmsghdr *nlh,
 	if (rule->tun_id)
 		ip_tunnel_need_metadata();
 
+	fib_rules_index_update(ops);
 	notify_rule_change(RTM_NEWRULE, rule, ops, nlh, NETLINK_CB(skb).portid);
 	flush_route_cache(ops);
 	rules_ops_put(ops);
@@ -919,6 +1222,7 @@ int fib_nl_delrule(struct sk_buff *skb, struct nlmsghdr *nlh,
 		}
 	}
 
+	fib_rules_index_update(ops);
 	call_fib_rule_notifiers(net, FIB_EVENT_RULE_DEL, rule, ops,
 				NULL);
 	notify_rule_change(RTM_DELRULE, rule, ops, nlh,
@@ -1167,30 +1471,39 @@ static void notify_rule_change(int event, struct fib_rule *rule,
 		rtnl_set_sk_err(net, ops->nlgroup, err);
 }
 
-static void attach_rules(struct list_head *rules, struct net_device *dev)
+/* Returns true if an iifindex changed, the lookup index depends on those */
+static bool attach_rules(struct list_head *rules, struct net_device *dev)
 {
 	struct fib_rule *rule;
+	bool changed = false;
 
 	list_for_each_entry(rule, rules, list) {
 		if (rule->iifindex == -1 &&
-		    strcmp(dev->name, rule->iifname) == 0)
+		    strcmp(dev->name, rule->iifname) == 0) {
 			rule->iifindex = dev->ifindex;
+			changed = true;
+		}
 		if (rule->oifindex == -1 &&
 		    strcmp(dev->name, rule->oifname) == 0)
 			rule->oifindex = dev->ifindex;
 	}
+	return changed;
 }
 
-static void detach_rules(struct list_head *rules, struct net_device *dev)
+static bool detach_rules(struct list_head *rules, struct net_device *dev)
 {
 	struct fib_rule *rule;
+	bool changed = false;
 
 	list_for_each_entry(rule, rules, list) {
-		if (rule->iifindex == dev->ifindex)
+		if (rule->iifindex == dev->ifindex) {
 			rule->iifindex = -1;
+			changed = true;
+		}
 		if (rule->oifindex == dev->ifindex)
 			rule->oifindex = -1;
 	}
+	return changed;
 }
 
 
@@ -1205,20 +1518,27 @@ static int fib_rules_event(struct notifier_block *this, unsigned long event,
 
 	switch (event) {
 	case NETDEV_REGISTER:
-		list_for_each_entry(ops, &net->rules_ops, list)
-			attach_rules(&ops->rules_list, dev);
+		list_for_each_entry(ops, &net->rules_ops, list) {
+			if (attach_rules(&ops->rules_list, dev))
+				fib_rules_index_update(ops);
+		}
 		break;
 
 	case NETDEV_CHANGENAME:
 		list_for_each_entry(ops, &net->rules_ops, list) {
-			detach_rules(&ops->rules_list, dev);
-			attach_rules(&ops->rules_list, dev);
+			bool changed;
+
+			changed = detach_rules(&ops->rules_list, dev);
+			if (attach_rules(&ops->rules_list, dev) || changed)
+				fib_rules_index_update(ops);
 		}
 		break;
 
 	case NETDEV_UNREGISTER:
-		list_for_each_entry(ops, &net->rules_ops, list)
-			detach_rules(&ops->rules_list, dev);
+		list_for_each_entry(ops, &net->rules_ops, list) {
+			if (detach_rules(&ops->rules_list, dev))
+				fib_rules_index_update(ops);
+		}
 		break;
 	}
 
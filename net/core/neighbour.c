@@ -218,18 +218,28 @@ bool neigh_remove_one(struct neighbour *ndel, struct neigh_table *tbl)
 	return false;
 }
 
+/* Entries looked at by one pass of forced gc with tbl->lock held */
+#define NEIGH_FORCED_GC_BATCH	128
+
+/*
+ * Look at up to NEIGH_FORCED_GC_BATCH entries from the head of the gc list.
+ * Entries that have to stay are moved to the tail, so the next pass starts
+ * where this one stopped instead of walking the same busy entries again.
+ */
 static int neigh_forced_gc(struct neigh_table *tbl)
 {
 	int max_clean = atomic_read(&tbl->gc_entries) - tbl->gc_thresh2;
 	unsigned long tref = jiffies - 5 * HZ;
+	int budget = NEIGH_FORCED_GC_BATCH;
 	struct neighbour *n, *tmp;
 	int shrunk = 0;
 
-	NEIGH_CACHE_STAT_INC(tbl, forced_gc_runs);
-
 	write_lock_bh(&tbl->lock);
 
 	list_for_each_entry_safe(n, tmp, &tbl->gc_list, gc_list) {
+		if (shrunk >= max_clean || !budget--)
+			break;
+
 		if (refcount_read(&n->refcnt) == 1) {
 			bool remove = false;
 
@@ -239,11 +249,12 @@ static int neigh_forced_gc(struct neigh_table *tbl)
 				remove = true;
 			write_unlock(&n->lock);
 
-			if (remove && neigh_remove_one(n, tbl))
+			if (remove && neigh_remove_one(n, tbl)) {
 				shrunk++;
-			if (shrunk >= max_clean)
-				break;
+				continue;
+			}
 		}
+		list_move_tail(&n->gc_list, &tbl->gc_list);
 	}
 
 	tbl->last_flush = jiffies;
@@ -253,6 +264,26 @@ static int neigh_forced_gc(struct neigh_table *tbl)
 	return shrunk;
 }
 
+/*
+ * Bring the table back to gc_thresh2 from process context, one batch at a
+ * time, once it is above that.  Allocations only run a single batch
+ * themselves, and only when the table is full.
+ */
+static void neigh_forced_gc_work(struct work_struct *work)
+{
+	struct neigh_table *tbl = container_of(work, struct neigh_table,
+					       forced_gc_work);
+	int passes = atomic_read(&tbl->gc_entries) / NEIGH_FORCED_GC_BATCH + 1;
+
+	NEIGH_CACHE_STAT_INC(tbl, forced_gc_runs);
+
+	while (passes-- &&
+	       atomic_read(&tbl->gc_entries) > tbl->gc_thresh2) {
+		neigh_forced_gc(tbl);
+		cond_resched();
+	}
+}
+
 static void neigh_add_timer(struct neighbour *n, unsigned long when)
 {
 	neigh_hold(n);
@@ -383,11 +414,14 @@ static struct neighbour *neigh_alloc(struct neigh_table *tbl,
 		goto do_alloc;
 
 	entries = atomic_inc_return(&tbl->gc_entries) - 1;
-	if (entries >= tbl->gc_thresh3 ||
-	    (entries >= tbl->gc_thresh2 &&
-	     time_after(now, tbl->last_flush + 5 * HZ))) {
-		if (!neigh_forced_gc(tbl) &&
-		    entries >= tbl->gc_thresh3) {
+	if (entries >= tbl->gc_thresh2 &&
+	    time_after(now, tbl->last_flush + 5 * HZ))
+		queue_work(system_power_efficient_wq, &tbl->forced_gc_work);
+	if (entries >= tbl->gc_thresh3) {
+		NEIGH_CACHE_STAT_INC(tbl, forced_gc_runs);
+		if (!neigh_forced_gc(tbl)) {
+			queue_work(system_power_efficient_wq,
+				   &tbl->forced_gc_work);
 			net_info_ratelimited("%s: neighbor table overflow!\n",
 					     tbl->id);
 			NEIGH_CACHE_STAT_INC(tbl, table_fulls);
@@ -1713,6 +1747,7 @@ void neigh_table_init(int index, struct neigh_table *tbl)
 	INIT_DEFERRABLE_WORK(&tbl->gc_work, neigh_periodic_work);
 	queue_delayed_work(system_power_efficient_wq, &tbl->gc_work,
 			tbl->parms.reachable_time);
+	INIT_WORK(&tbl->forced_gc_work, neigh_forced_gc_work);
 	timer_setup(&tbl->proxy_timer, neigh_proxy_process, 0);
 	skb_queue_head_init_class(&tbl->proxy_queue,
 			&neigh_table_proxy_queue_class);
@@ -1729,6 +1764,7 @@ int neigh_table_clear(int index, struct neigh_table *tbl)
 	neigh_tables[index] = NULL;
 	/* It is not clean... Fix it to unload IPv6 module safely */
 	cancel_delayed_work_sync(&tbl->gc_work);
+	cancel_work_sync(&tbl->forced_gc_work);
 	del_timer_sync(&tbl->proxy_timer);
 	pneigh_queue_purge(&tbl->proxy_queue);
 	neigh_ifdown(tbl, NULL);
@@ -31,8 +31,10 @@
  * Note : Dont forget somaxconn that may limit backlog too.
  */
 
-void reqsk_queue_alloc(struct request_sock_queue *queue)
+void reqsk_queue_alloc(struct request_sock_queue *queue, bool percpu)
 {
+	int cpu;
+
 	spin_lock_init(&queue->rskq_lock);
 
 	spin_lock_init(&queue->fastopenq.lock);
@@ -41,6 +43,108 @@ void reqsk_queue_alloc(struct request_sock_queue *queue)
 	queue->fastopenq.qlen = 0;
 
 	queue->rskq_accept_head = NULL;
+
+	/* The queues of a previous listen() can be reused, they are empty.
+	 * Failing the allocation is not fatal, the shared queue is used.
+	 */
+	if (!percpu)
+		reqsk_queue_free(queue);
+	else if (!queue->rskq_percpu)
+		queue->rskq_percpu = alloc_percpu(struct request_sock_cpu_queue);
+
+	if (!queue->rskq_percpu)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct request_sock_cpu_queue *q;
+
+		q = per_cpu_ptr(queue->rskq_percpu, cpu);
+		spin_lock_init(&q->lock);
+		q->head = NULL;
+		q->tail = NULL;
+	}
+	atomic_set(&queue->rskq_percpu_len, 0);
+}
+
+/* Called when the listener is destroyed, or on listen() without per-cpu
+ * queues.  Children still in flight hold a reference on the listener, so
+ * none of them can be using the queues anymore.
+ */
+void reqsk_queue_free(struct request_sock_queue *queue)
+{
+	free_percpu(queue->rskq_percpu);
+	queue->rskq_percpu = NULL;
+}
+
+/* Queue @req on the accept queue of the cpu that completed the handshake.
+ * The listener backlog is derived from the atomic count, as the per-cpu
+ * locks do not serialize updates of sk_ack_backlog.
+ */
+void reqsk_queue_add_percpu(struct request_sock_queue *queue,
+			    struct request_sock *req, struct sock *parent)
+{
+	struct request_sock_cpu_queue *q = this_cpu_ptr(queue->rskq_percpu);
+
+	req->dl_next = NULL;
+	if (q->head == NULL)
+		WRITE_ONCE(q->head, req);
+	else
+		q->tail->dl_next = req;
+	q->tail = req;
+	WRITE_ONCE(parent->sk_ack_backlog,
+		   atomic_inc_return(&queue->rskq_percpu_len));
+}
+
+static struct request_sock *reqsk_cpu_queue_pop(struct request_sock_queue *queue,
+						struct sock *parent, int cpu)
+{
+	struct request_sock_cpu_queue *q = per_cpu_ptr(queue->rskq_percpu, cpu);
+	struct request_sock *req;
+
+	if (!READ_ONCE(q->head))
+		return NULL;
+
+	spin_lock(&q->lock);
+	req = q->head;
+	if (req) {
+		WRITE_ONCE(q->head, req->dl_next);
+		if (q->head == NULL)
+			q->tail = NULL;
+		WRITE_ONCE(parent->sk_ack_backlog,
+			   atomic_dec_return(&queue->rskq_percpu_len));
+	}
+	spin_unlock(&q->lock);
+	return req;
+}
+
+/* Take a child from the local cpu queue first, so that the accepting
+ * thread keeps using the cache lines the softirq that queued it dirtied,
+ * then from the other cpus in round robin order.
+ */
+struct request_sock *reqsk_queue_remove_percpu(struct request_sock_queue *queue,
+					       struct sock *parent)
+{
+	struct request_sock *req = NULL;
+	int this_cpu, cpu;
+
+	if (!atomic_read(&queue->rskq_percpu_len))
+		return NULL;
+	/* Pairs with atomic_inc_return() in reqsk_queue_add_percpu() */
+	smp_rmb();
+
+	local_bh_disable();
+	this_cpu = smp_processor_id();
+	req = reqsk_cpu_queue_pop(queue, parent, this_cpu);
+	for (cpu = cpumask_next(this_cpu, cpu_possible_mask); !req;
+	     cpu = cpumask_next(cpu, cpu_possible_mask)) {
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_possible_mask);
+		if (cpu == this_cpu)
+			break;
+		req = reqsk_cpu_queue_pop(queue, parent, cpu);
+	}
+	local_bh_enable();
+	return req;
 }
 
 /*
@@ -566,7 +566,7 @@ static void sk_psock_destroy_deferred(struct work_struct *gc)
 
 	/* No sk_callback_lock since already detached. */
 
-	/* Parser has been stopped */
+	/* Parser has been stopped, verdict only mode has no strparser */
 	if (psock->progs.skb_parser)
 		strp_done(&psock->parser.strp);
 
@@ -603,6 +603,8 @@ void sk_psock_drop(struct sock *sk, struct sk_psock *psock)
 	rcu_assign_sk_user_data(sk, NULL);
 	if (psock->progs.skb_parser)
 		sk_psock_stop_strp(sk, psock);
+	else if (psock->progs.skb_verdict)
+		sk_psock_stop_verdict(sk, psock);
 	write_unlock_bh(&sk->sk_callback_lock);
 	sk_psock_clear_state(psock, SK_PSOCK_TX_ENABLED);
 
@@ -684,6 +686,36 @@ static struct sk_psock *sk_psock_from_strp(struct strparser *strp)
 	return container_of(parser, struct sk_psock, parser);
 }
 
+/* Nothing queued for the backlog, so we may deliver out of line. */
+static bool sk_psock_backlog_empty(struct sk_psock *psock)
+{
+	return !psock->work_state.skb && skb_queue_empty(&psock->ingress_skb);
+}
+
+/* Deliver to the ingress queue of another socket right away instead of
+ * going through its backlog work.  That needs the same conditions as
+ * the receive path of that socket: its lock held and not owned by a
+ * user.  Only a trylock is done, two sockets redirecting to each other
+ * would deadlock otherwise.
+ */
+static bool sk_psock_skb_ingress_other(struct sk_psock *psock_other,
+				       struct sk_buff *skb)
+{
+	struct sock *sk_other = psock_other->sk;
+	bool done = false;
+
+	if (!spin_trylock(&sk_other->sk_lock.slock))
+		return false;
+
+	if (!sock_owned_by_user(sk_other) &&
+	    sk_psock_backlog_empty(psock_other) &&
+	    sk_psock_skb_ingress(psock_other, skb) > 0)
+		done = true;
+
+	spin_unlock(&sk_other->sk_lock.slock);
+	return done;
+}
+
 static void sk_psock_skb_redirect(struct sk_buff *skb)
 {
 	struct sk_psock *psock_other;
@@ -707,6 +739,8 @@ static void sk_psock_skb_redirect(struct sk_buff *skb)
 	    (ingress &&
 	     atomic_read(&sk_other->sk_rmem_alloc) <=
 	     sk_other->sk_rcvbuf)) {
+		if (ingress && sk_psock_skb_ingress_other(psock_other, skb))
+			return;
 		if (!ingress)
 			skb_set_owner_w(skb, sk_other);
 		skb_queue_tail(&psock_other->ingress_skb, skb);
@@ -763,6 +797,14 @@ static void sk_psock_verdict_apply(struct sk_psock *psock,
 		    sk_other->sk_rcvbuf) {
 			struct tcp_skb_cb *tcp = TCP_SKB_CB(skb);
 
+			/* We run in the receive path of our own socket, so
+			 * unless older data is still queued there is no
+			 * need for a trip through the backlog.
+			 */
+			if (sk_psock_backlog_empty(psock) &&
+			    sk_psock_skb_ingress(psock, skb) > 0)
+				break;
+
 			tcp->bpf.flags |= BPF_F_INGRESS;
 			skb_queue_tail(&psock->ingress_skb, skb);
 			schedule_work(&psock->work);
@@ -885,6 +927,98 @@ void sk_psock_start_strp(struct sock *sk, struct sk_psock *psock)
 	parser->enabled = true;
 }
 
+/* Verdict only mode: no stream parser, the verdict program sees every
+ * skb as TCP received it.
+ */
+static int sk_psock_verdict_recv(read_descriptor_t *desc, struct sk_buff *skb,
+				 unsigned int offset, size_t orig_len)
+{
+	struct sock *sk = (struct sock *)desc->arg.data;
+	struct sk_psock *psock;
+	struct bpf_prog *prog;
+	int ret = __SK_DROP;
+	int len = orig_len;
+
+	/* clone here so sk_eat_skb() in tcp_read_sock does not drop our data */
+	skb = skb_clone(skb, GFP_ATOMIC);
+	if (!skb) {
+		desc->error = -ENOMEM;
+		return 0;
+	}
+	if (offset && !pskb_pull(skb, offset)) {
+		kfree_skb(skb);
+		desc->error = -ENOMEM;
+		return 0;
+	}
+
+	rcu_read_lock();
+	psock = sk_psock(sk);
+	if (unlikely(!psock)) {
+		len = 0;
+		kfree_skb(skb);
+		goto out;
+	}
+	prog = READ_ONCE(psock->progs.skb_verdict);
+	if (likely(prog)) {
+		tcp_skb_bpf_redirect_clear(skb);
+		ret = sk_psock_bpf_run(psock, prog, skb);
+		ret = sk_psock_map_verd(ret, tcp_skb_bpf_redirect_fetch(skb));
+	}
+	sk_psock_verdict_apply(psock, skb, ret);
+out:
+	rcu_read_unlock();
+	return len;
+}
+
+static void sk_psock_verdict_data_ready(struct sock *sk)
+{
+	struct socket *sock = sk->sk_socket;
+	read_descriptor_t desc;
+
+	if (unlikely(!sock || !sock->ops || !sock->ops->read_sock ||
+		     tls_sw_has_ctx_rx(sk))) {
+		struct sk_psock *psock;
+
+		rcu_read_lock();
+		psock = sk_psock(sk);
+		if (likely(psock))
+			psock->parser.saved_data_ready(sk);
+		rcu_read_unlock();
+		return;
+	}
+
+	desc.arg.data = sk;
+	desc.error = 0;
+	desc.count = 1;
+
+	sock->ops->read_sock(sk, &desc, sk_psock_verdict_recv);
+}
+
+void sk_psock_start_verdict(struct sock *sk, struct sk_psock *psock)
+{
+	struct sk_psock_parser *parser = &psock->parser;
+
+	if (parser->enabled)
+		return;
+
+	parser->saved_data_ready = sk->sk_data_ready;
+	sk->sk_data_ready = sk_psock_verdict_data_ready;
+	sk->sk_write_space = sk_psock_write_space;
+	parser->enabled = true;
+}
+
+void sk_psock_stop_verdict(struct sock *sk, struct sk_psock *psock)
+{
+	struct sk_psock_parser *parser = &psock->parser;
+
+	if (!parser->enabled)
+		return;
+
+	sk->sk_data_ready = parser->saved_data_ready;
+	parser->saved_data_ready = NULL;
+	parser->enabled = false;
+}
+
 void sk_psock_stop_strp(struct sock *sk, struct sk_psock *psock)
 {
 	struct sk_psock_parser *parser = &psock->parser;
@@ -158,7 +158,7 @@ static void xdp_rxq_info_init(struct xdp_rxq_info *xdp_rxq)
 
 /* Returns 0 on success, negative on failure */
 int xdp_rxq_info_reg(struct xdp_rxq_info *xdp_rxq,
-		     struct net_device *dev, u32 queue_index)
+		     struct net_device *dev, u32 queue_index, unsigned int napi_id)
 {
 	if (xdp_rxq->reg_state == REG_STATE_UNUSED) {
 		WARN(1, "Driver promised not to register this");
@@ -179,6 +179,7 @@ int xdp_rxq_info_reg(struct xdp_rxq_info *xdp_rxq,
 	xdp_rxq_info_init(xdp_rxq);
 	xdp_rxq->dev = dev;
 	xdp_rxq->queue_index = queue_index;
+	xdp_rxq->napi_id = napi_id;
 
 	xdp_rxq->reg_state = REG_STATE_REGISTERED;
 	return 0;
@@ -339,7 +340,7 @@ EXPORT_SYMBOL_GPL(xdp_rxq_info_reg_mem_model);
  * MEM_TYPE_XSK_BUFF_POOL memory type, so it's explicitly not part of
  * the switch-statement.
  */
-static void __xdp_return(void *data, struct xdp_mem_info *mem, bool napi_direct)
+void __xdp_return(void *data, struct xdp_mem_info *mem, bool napi_direct)
 {
 	struct xdp_mem_allocator *xa;
 	struct page *page;
@@ -368,20 +369,44 @@ static void __xdp_return(void *data, struct xdp_mem_info *mem, bool napi_direct)
 	}
 }
 
+static void __xdp_return_frags(struct skb_shared_info *sinfo,
+			       struct xdp_mem_info *mem, bool napi_direct)
+{
+	int i;
+
+	for (i = 0; i < sinfo->nr_frags; i++) {
+		struct page *page = skb_frag_page(&sinfo->frags[i]);
+
+		__xdp_return(page_address(page), mem, napi_direct);
+	}
+}
+
 void xdp_return_frame(struct xdp_frame *xdpf)
 {
+	if (unlikely(xdp_frame_has_frags(xdpf)))
+		__xdp_return_frags(xdp_get_shared_info_from_frame(xdpf),
+				   &xdpf->mem, false);
+
 	__xdp_return(xdpf->data, &xdpf->mem, false);
 }
 EXPORT_SYMBOL_GPL(xdp_return_frame);
 
 void xdp_return_frame_rx_napi(struct xdp_frame *xdpf)
 {
+	if (unlikely(xdp_frame_has_frags(xdpf)))
+		__xdp_return_frags(xdp_get_shared_info_from_frame(xdpf),
+				   &xdpf->mem, true);
+
 	__xdp_return(xdpf->data, &xdpf->mem, true);
 }
 EXPORT_SYMBOL_GPL(xdp_return_frame_rx_napi);
 
 void xdp_return_buff(struct xdp_buff *xdp)
 {
+	if (unlikely(xdp_buff_has_frags(xdp)))
+		__xdp_return_frags(xdp_get_shared_info_from_buff(xdp),
+				   &xdp->rxq->mem, true);
+
 	__xdp_return(xdp->data, &xdp->rxq->mem, true);
 }
 
@@ -470,6 +495,38 @@ struct xdp_frame *xdp_convert_zc_to_xdp_frame(struct xdp_buff *xdp)
 }
 EXPORT_SYMBOL_GPL(xdp_convert_zc_to_xdp_frame);
 
+/* Copy a linear xdp_frame, including its headroom, into a new
+ * MEM_TYPE_PAGE_ORDER0 frame, e.g. to send it out of several devices.
+ */
+struct xdp_frame *xdpf_clone(struct xdp_frame *xdpf)
+{
+	unsigned int headroom, totalsize;
+	struct xdp_frame *nxdpf;
+	struct page *page;
+	void *addr;
+
+	headroom = xdpf->headroom + sizeof(*xdpf);
+	totalsize = headroom + xdpf->len;
+
+	if (unlikely(totalsize > PAGE_SIZE))
+		return NULL;
+	page = dev_alloc_page();
+	if (!page)
+		return NULL;
+	addr = page_to_virt(page);
+
+	memcpy(addr, xdpf, totalsize);
+
+	nxdpf = addr;
+	nxdpf->data = addr + headroom;
+	nxdpf->frame_sz = PAGE_SIZE;
+	nxdpf->mem.type = MEM_TYPE_PAGE_ORDER0;
+	nxdpf->mem.id = 0;
+
+	return nxdpf;
+}
+EXPORT_SYMBOL_GPL(xdpf_clone);
+
 /* Used by XDP_WARN macro, to avoid inlining WARN() in fast-path */
 void xdp_warn(const char *msg, const char *func, const int line)
 {
@@ -5,6 +5,7 @@
 #include <crypto/authenc.h>
 #include <linux/err.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <net/ip.h>
 #include <net/xfrm.h>
 #include <net/esp.h>
@@ -35,6 +36,15 @@ struct esp_output_extra {
 
 #define ESP_SKB_CB(__skb) ((struct esp_skb_cb *)&((__skb)->cb[0]))
 
+/*
+ * A sync AEAD is done with its request by the time crypto_aead_encrypt()
+ * or crypto_aead_decrypt() returns, so while BHs are off the request can
+ * live in a per-CPU buffer rather than in a kmalloc() per packet.
+ */
+#define ESP_SCRATCH_SIZE	2048
+
+static void __percpu *esp_scratch;
+
 /*
  * Allocate an AEAD request structure with extra space for SG and IV.
  *
@@ -62,9 +72,25 @@ static void *esp_alloc_tmp(struct crypto_aead *aead, int nfrags, int extralen)
 
 	len += sizeof(struct scatterlist) * nfrags;
 
+	if (len <= ESP_SCRATCH_SIZE &&
+	    !(crypto_aead_alg(aead)->base.cra_flags & CRYPTO_ALG_ASYNC)) {
+		local_bh_disable();
+		return this_cpu_ptr(esp_scratch);
+	}
+
 	return kmalloc(len, GFP_ATOMIC);
 }
 
+static void esp_free_tmp(void *tmp)
+{
+	if (tmp == raw_cpu_ptr(esp_scratch)) {
+		local_bh_enable();
+		return;
+	}
+
+	kfree(tmp);
+}
+
 static inline void *esp_tmp_extra(void *tmp)
 {
 	return PTR_ALIGN(tmp, __alignof__(struct esp_output_extra));
@@ -649,7 +675,7 @@ int esp_output_tail(struct xfrm_state *x, struct sk_buff *skb, struct esp_info *
 		err = esp_output_tail_tcp(x, skb);
 
 error_free:
-	kfree(tmp);
+	esp_free_tmp(tmp);
 error:
 	return err;
 }
@@ -760,7 +786,7 @@ int esp_input_done2(struct sk_buff *skb, int err)
 	int ihl;
 
 	if (!xo || (xo && !(xo->flags & CRYPTO_DONE)))
-		kfree(ESP_SKB_CB(skb)->tmp);
+		esp_free_tmp(ESP_SKB_CB(skb)->tmp);
 
 	if (unlikely(err))
 		goto out;
@@ -949,7 +975,7 @@ static int esp_input(struct xfrm_state *x, struct sk_buff *skb)
 	sg_init_table(sg, nfrags);
 	err = skb_to_sgvec(skb, sg, 0, skb->len);
 	if (unlikely(err < 0)) {
-		kfree(tmp);
+		esp_free_tmp(tmp);
 		goto out;
 	}
 
@@ -1223,13 +1249,19 @@ static struct xfrm4_protocol esp4_protocol = {
 
 static int __init esp4_init(void)
 {
+	esp_scratch = __alloc_percpu(ESP_SCRATCH_SIZE, ARCH_KMALLOC_MINALIGN);
+	if (!esp_scratch)
+		return -ENOMEM;
+
 	if (xfrm_register_type(&esp_type, AF_INET) < 0) {
 		pr_info("%s: can't add xfrm type\n", __func__);
+		free_percpu(esp_scratch);
 		return -EAGAIN;
 	}
 	if (xfrm4_protocol_register(&esp4_protocol, IPPROTO_ESP) < 0) {
 		pr_info("%s: can't add protocol\n", __func__);
 		xfrm_unregister_type(&esp_type, AF_INET);
+		free_percpu(esp_scratch);
 		return -EAGAIN;
 	}
 	return 0;
@@ -1240,6 +1272,7 @@ static void __exit esp4_fini(void)
 	if (xfrm4_protocol_deregister(&esp4_protocol, IPPROTO_ESP) < 0)
 		pr_info("%s: can't remove protocol\n", __func__);
 	xfrm_unregister_type(&esp_type, AF_INET);
+	free_percpu(esp_scratch);
 }
 
 module_init(esp4_init);
@@ -921,7 +921,8 @@ int inet_csk_listen_start(struct sock *sk, int backlog)
 	struct inet_sock *inet = inet_sk(sk);
 	int err = -EADDRINUSE;
 
-	reqsk_queue_alloc(&icsk->icsk_accept_queue);
+	reqsk_queue_alloc(&icsk->icsk_accept_queue,
+			  READ_ONCE(sock_net(sk)->ipv4.sysctl_tcp_percpu_accept));
 
 	sk->sk_ack_backlog = 0;
 	inet_csk_delack_init(sk);
@@ -976,11 +977,18 @@ struct sock *inet_csk_reqsk_queue_add(struct sock *sk,
 				      struct sock *child)
 {
 	struct request_sock_queue *queue = &inet_csk(sk)->icsk_accept_queue;
+	spinlock_t *lock = &queue->rskq_lock;
 
-	spin_lock(&queue->rskq_lock);
+	if (queue->rskq_percpu)
+		lock = &this_cpu_ptr(queue->rskq_percpu)->lock;
+
+	spin_lock(lock);
 	if (unlikely(sk->sk_state != TCP_LISTEN)) {
 		inet_child_forget(sk, req, child);
 		child = NULL;
+	} else if (queue->rskq_percpu) {
+		req->sk = child;
+		reqsk_queue_add_percpu(queue, req, sk);
 	} else {
 		req->sk = child;
 		req->dl_next = NULL;
@@ -991,7 +999,7 @@ struct sock *inet_csk_reqsk_queue_add(struct sock *sk,
 		queue->rskq_accept_tail = req;
 		sk_acceptq_added(sk);
 	}
-	spin_unlock(&queue->rskq_lock);
+	spin_unlock(lock);
 	return child;
 }
 EXPORT_SYMBOL(inet_csk_reqsk_queue_add);
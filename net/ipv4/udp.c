@@ -445,6 +445,42 @@ static struct sock *udp4_lib_lookup2(struct net *net,
 	return result;
 }
 
+/* called with rcu_read_lock()
+ *
+ * An exact match on the 4-tuple of a connected socket.  The chain is
+ * walked without its lock, so a socket rehashed under us may end the walk
+ * early: callers fall back to the secondary hash, which still has it.
+ */
+static struct sock *udp4_lib_lookup4(struct net *net,
+				     __be32 saddr, __be16 sport,
+				     __be32 daddr, unsigned int hnum,
+				     int dif, int sdif,
+				     struct udp_table *udptable)
+{
+	struct udp_hslot *hslot4;
+	struct udp_sock *up;
+	struct sock *sk;
+	u32 hash;
+
+	hash = udp_ehashfn(net, daddr, hnum, saddr, sport);
+	hslot4 = udp_hashslot4(udptable, hash);
+
+	hlist_for_each_entry_rcu(up, &hslot4->head, udp_hash4_node) {
+		sk = (struct sock *)up;
+
+		if (up->udp_hash4 == hash &&
+		    sk->sk_family == PF_INET &&
+		    net_eq(sock_net(sk), net) &&
+		    up->udp_port_hash == hnum &&
+		    sk->sk_rcv_saddr == daddr &&
+		    sk->sk_daddr == saddr &&
+		    inet_sk(sk)->inet_dport == sport &&
+		    udp_sk_bound_dev_eq(net, sk->sk_bound_dev_if, dif, sdif))
+			return sk;
+	}
+	return NULL;
+}
+
 /* UDP is nearly always wildcards out the wazoo, it makes no sense to try
  * harder than this. -DaveM
  */
@@ -461,6 +497,14 @@ struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 	slot2 = hash2 & udptable->mask;
 	hslot2 = &udptable->hash2[slot2];
 
+	/* A connected socket outscores anything else in the chain */
+	if (udp_lookup_hash4(hslot2)) {
+		result = udp4_lib_lookup4(net, saddr, sport, daddr, hnum,
+					  dif, sdif, udptable);
+		if (result)
+			return result;
+	}
+
 	result = udp4_lib_lookup2(net, saddr, sport,
 				  daddr, hnum, dif, sdif,
 				  hslot2, skb);
@@ -1853,6 +1897,24 @@ int udp_pre_connect(struct sock *sk, struct sockaddr *uaddr, int addr_len)
 }
 EXPORT_SYMBOL(udp_pre_connect);
 
+int udp_connect(struct sock *sk, struct sockaddr *uaddr, int addr_len)
+{
+	struct inet_sock *inet = inet_sk(sk);
+	int res;
+
+	lock_sock(sk);
+	res = __ip4_datagram_connect(sk, uaddr, addr_len);
+	if (!res && sk_hashed(sk) && inet->inet_rcv_saddr)
+		udp_lib_hash4(sk, udp_ehashfn(sock_net(sk),
+					      inet->inet_rcv_saddr,
+					      inet->inet_num,
+					      inet->inet_daddr,
+					      inet->inet_dport));
+	release_sock(sk);
+	return res;
+}
+EXPORT_SYMBOL(udp_connect);
+
 int __udp_disconnect(struct sock *sk, int flags)
 {
 	struct inet_sock *inet = inet_sk(sk);
@@ -1884,6 +1946,7 @@ EXPORT_SYMBOL(__udp_disconnect);
 int udp_disconnect(struct sock *sk, int flags)
 {
 	lock_sock(sk);
+	udp_lib_unhash4(sk);
 	__udp_disconnect(sk, flags);
 	release_sock(sk);
 	return 0;
@@ -1892,6 +1955,8 @@ EXPORT_SYMBOL(udp_disconnect);
 
 void udp_lib_unhash(struct sock *sk)
 {
+	udp_lib_unhash4(sk);
+
 	if (sk_hashed(sk)) {
 		struct udp_table *udptable = sk->sk_prot->h.udp_table;
 		struct udp_hslot *hslot, *hslot2;
@@ -1918,6 +1983,44 @@ void udp_lib_unhash(struct sock *sk)
 }
 EXPORT_SYMBOL(udp_lib_unhash);
 
+/*
+ * Add a connected socket to the 4-tuple hash, or move it there after a
+ * new connect().  @hash is computed by the address family.
+ */
+void udp_lib_hash4(struct sock *sk, u32 hash)
+{
+	struct udp_table *udptable = sk->sk_prot->h.udp_table;
+	struct udp_sock *up = udp_sk(sk);
+	struct udp_hslot *hslot4;
+
+	udp_lib_unhash4(sk);
+
+	hslot4 = udp_hashslot4(udptable, hash);
+	spin_lock_bh(&hslot4->lock);
+	up->udp_hash4 = hash;
+	hlist_add_head_rcu(&up->udp_hash4_node, &hslot4->head);
+	hslot4->count++;
+	spin_unlock_bh(&hslot4->lock);
+}
+EXPORT_SYMBOL(udp_lib_hash4);
+
+void udp_lib_unhash4(struct sock *sk)
+{
+	struct udp_table *udptable = sk->sk_prot->h.udp_table;
+	struct udp_sock *up = udp_sk(sk);
+	struct udp_hslot *hslot4;
+
+	if (hlist_unhashed(&up->udp_hash4_node))
+		return;
+
+	hslot4 = udp_hashslot4(udptable, up->udp_hash4);
+	spin_lock_bh(&hslot4->lock);
+	hlist_del_init_rcu(&up->udp_hash4_node);
+	hslot4->count--;
+	spin_unlock_bh(&hslot4->lock);
+}
+EXPORT_SYMBOL(udp_lib_unhash4);
+
 /*
  * inet_rcv_saddr was changed, we must rehash secondary hash
  */
@@ -2431,6 +2534,10 @@ static struct sock *__udp4_lib_demux_lookup(struct net *net,
 	const __portpair ports = INET_COMBINED_PORTS(rmt_port, hnum);
 	struct sock *sk;
 
+	if (udp_lookup_hash4(hslot2))
+		return udp4_lib_lookup4(net, rmt_addr, rmt_port, loc_addr,
+					hnum, dif, sdif, &udp_table);
+
 	udp_portaddr_for_each_entry_rcu(sk, &hslot2->head) {
 		if (INET_MATCH(sk, net, acookie, rmt_addr,
 			       loc_addr, ports, dif, sdif))
@@ -2781,6 +2888,7 @@ int udp_abort(struct sock *sk, int err)
 
 	sk->sk_err = err;
 	sk->sk_error_report(sk);
+	udp_lib_unhash4(sk);
 	__udp_disconnect(sk, 0);
 
 	release_sock(sk);
@@ -2794,7 +2902,7 @@ struct proto udp_prot = {
 	.owner			= THIS_MODULE,
 	.close			= udp_lib_close,
 	.pre_connect		= udp_pre_connect,
-	.connect		= ip4_datagram_connect,
+	.connect		= udp_connect,
 	.disconnect		= udp_disconnect,
 	.ioctl			= udp_ioctl,
 	.init			= udp_init_sock,
@@ -3018,7 +3126,7 @@ void __init udp_table_init(struct udp_table *table, const char *name)
 	unsigned int i;
 
 	table->hash = alloc_large_system_hash(name,
-					      2 * sizeof(struct udp_hslot),
+					      3 * sizeof(struct udp_hslot),
 					      uhash_entries,
 					      21, /* one slot per 2 MB */
 					      0,
@@ -3028,6 +3136,7 @@ void __init udp_table_init(struct udp_table *table, const char *name)
 					      64 * 1024);
 
 	table->hash2 = table->hash + (table->mask + 1);
+	table->hash4 = table->hash2 + (table->mask + 1);
 	for (i = 0; i <= table->mask; i++) {
 		INIT_HLIST_HEAD(&table->hash[i].head);
 		table->hash[i].count = 0;
@@ -3038,6 +3147,11 @@ void __init udp_table_init(struct udp_table *table, const char *name)
 		table->hash2[i].count = 0;
 		spin_lock_init(&table->hash2[i].lock);
 	}
+	for (i = 0; i <= table->mask; i++) {
+		INIT_HLIST_HEAD(&table->hash4[i].head);
+		table->hash4[i].count = 0;
+		spin_lock_init(&table->hash4[i].lock);
+	}
 }
 
 u32 udp_flow_hashrnd(void)
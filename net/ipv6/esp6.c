@@ -17,6 +17,7 @@
 #include <crypto/authenc.h>
 #include <linux/err.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <net/ip.h>
 #include <net/xfrm.h>
 #include <net/esp.h>
@@ -51,6 +52,15 @@ struct esp_output_extra {
 
 #define ESP_SKB_CB(__skb) ((struct esp_skb_cb *)&((__skb)->cb[0]))
 
+/*
+ * A sync AEAD is done with its request by the time crypto_aead_encrypt()
+ * or crypto_aead_decrypt() returns, so while BHs are off the request can
+ * live in a per-CPU buffer rather than in a kmalloc() per packet.
+ */
+#define ESP_SCRATCH_SIZE	2048
+
+static void __percpu *esp_scratch;
+
 /*
  * Allocate an AEAD request structure with extra space for SG and IV.
  *
@@ -79,9 +89,25 @@ static void *esp_alloc_tmp(struct crypto_aead *aead, int nfrags, int seqihlen)
 
 	len += sizeof(struct scatterlist) * nfrags;
 
+	if (len <= ESP_SCRATCH_SIZE &&
+	    !(crypto_aead_alg(aead)->base.cra_flags & CRYPTO_ALG_ASYNC)) {
+		local_bh_disable();
+		return this_cpu_ptr(esp_scratch);
+	}
+
 	return kmalloc(len, GFP_ATOMIC);
 }
 
+static void esp_free_tmp(void *tmp)
+{
+	if (tmp == raw_cpu_ptr(esp_scratch)) {
+		local_bh_enable();
+		return;
+	}
+
+	kfree(tmp);
+}
+
 static inline void *esp_tmp_extra(void *tmp)
 {
 	return PTR_ALIGN(tmp, __alignof__(struct esp_output_extra));
@@ -684,7 +710,7 @@ int esp6_output_tail(struct xfrm_state *x, struct sk_buff *skb, struct esp_info
 		err = esp_output_tail_tcp(x, skb);
 
 error_free:
-	kfree(tmp);
+	esp_free_tmp(tmp);
 error:
 	return err;
 }
@@ -794,7 +820,7 @@ int esp6_input_done2(struct sk_buff *skb, int err)
 	int hdr_len = skb_network_header_len(skb);
 
 	if (!xo || (xo && !(xo->flags & CRYPTO_DONE)))
-		kfree(ESP_SKB_CB(skb)->tmp);
+		esp_free_tmp(ESP_SKB_CB(skb)->tmp);
 
 	if (unlikely(err))
 		goto out;
@@ -989,7 +1015,7 @@ static int esp6_input(struct xfrm_state *x, struct sk_buff *skb)
 	sg_init_table(sg, nfrags);
 	ret = skb_to_sgvec(skb, sg, 0, skb->len);
 	if (unlikely(ret < 0)) {
-		kfree(tmp);
+		esp_free_tmp(tmp);
 		goto out;
 	}
 
@@ -1269,13 +1295,19 @@ static struct xfrm6_protocol esp6_protocol = {
 
 static int __init esp6_init(void)
 {
+	esp_scratch = __alloc_percpu(ESP_SCRATCH_SIZE, ARCH_KMALLOC_MINALIGN);
+	if (!esp_scratch)
+		return -ENOMEM;
+
 	if (xfrm_register_type(&esp6_type, AF_INET6) < 0) {
 		pr_info("%s: can't add xfrm type\n", __func__);
+		free_percpu(esp_scratch);
 		return -EAGAIN;
 	}
 	if (xfrm6_protocol_register(&esp6_protocol, IPPROTO_ESP) < 0) {
 		pr_info("%s: can't add protocol\n", __func__);
 		xfrm_unregister_type(&esp6_type, AF_INET6);
+		free_percpu(esp_scratch);
 		return -EAGAIN;
 	}
 
@@ -1287,6 +1319,7 @@ static void __exit esp6_fini(void)
 	if (xfrm6_protocol_deregister(&esp6_protocol, IPPROTO_ESP) < 0)
 		pr_info("%s: can't remove protocol\n", __func__);
 	xfrm_unregister_type(&esp6_type, AF_INET6);
+	free_percpu(esp_scratch);
 }
 
 module_init(esp6_init);
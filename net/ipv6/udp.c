@@ -98,6 +98,25 @@ void udp_v6_rehash(struct sock *sk)
 	udp_lib_rehash(sk, new_hash);
 }
 
+int udpv6_connect(struct sock *sk, struct sockaddr *uaddr, int addr_len)
+{
+	int res;
+
+	lock_sock(sk);
+	res = __ip6_datagram_connect(sk, uaddr, addr_len);
+	/* v4-mapped peers are looked up by IPv4 through the secondary hash */
+	if (!res && sk_hashed(sk) &&
+	    !ipv6_addr_v4mapped(&sk->sk_v6_daddr) &&
+	    !ipv6_addr_any(&sk->sk_v6_rcv_saddr))
+		udp_lib_hash4(sk, udp6_ehashfn(sock_net(sk),
+					       &sk->sk_v6_rcv_saddr,
+					       inet_sk(sk)->inet_num,
+					       &sk->sk_v6_daddr,
+					       inet_sk(sk)->inet_dport));
+	release_sock(sk);
+	return res;
+}
+
 static int compute_score(struct sock *sk, struct net *net,
 			 const struct in6_addr *saddr, __be16 sport,
 			 const struct in6_addr *daddr, unsigned short hnum,
@@ -178,6 +197,36 @@ static struct sock *udp6_lib_lookup2(struct net *net,
 	return result;
 }
 
+/* called with rcu_read_lock(), see udp4_lib_lookup4() */
+static struct sock *udp6_lib_lookup4(struct net *net,
+		const struct in6_addr *saddr, __be16 sport,
+		const struct in6_addr *daddr, unsigned int hnum,
+		int dif, int sdif, struct udp_table *udptable)
+{
+	struct udp_hslot *hslot4;
+	struct udp_sock *up;
+	struct sock *sk;
+	u32 hash;
+
+	hash = udp6_ehashfn(net, daddr, hnum, saddr, sport);
+	hslot4 = udp_hashslot4(udptable, hash);
+
+	hlist_for_each_entry_rcu(up, &hslot4->head, udp_hash4_node) {
+		sk = (struct sock *)up;
+
+		if (up->udp_hash4 == hash &&
+		    sk->sk_family == PF_INET6 &&
+		    net_eq(sock_net(sk), net) &&
+		    up->udp_port_hash == hnum &&
+		    ipv6_addr_equal(&sk->sk_v6_rcv_saddr, daddr) &&
+		    ipv6_addr_equal(&sk->sk_v6_daddr, saddr) &&
+		    inet_sk(sk)->inet_dport == sport &&
+		    udp_sk_bound_dev_eq(net, sk->sk_bound_dev_if, dif, sdif))
+			return sk;
+	}
+	return NULL;
+}
+
 /* rcu_read_lock() must be held */
 struct sock *__udp6_lib_lookup(struct net *net,
 			       const struct in6_addr *saddr, __be16 sport,
@@ -194,6 +243,13 @@ struct sock *__udp6_lib_lookup(struct net *net,
 	slot2 = hash2 & udptable->mask;
 	hslot2 = &udptable->hash2[slot2];
 
+	if (udp_lookup_hash4(hslot2)) {
+		result = udp6_lib_lookup4(net, saddr, sport, daddr, hnum,
+					  dif, sdif, udptable);
+		if (result)
+			return result;
+	}
+
 	result = udp6_lib_lookup2(net, saddr, sport,
 				  daddr, hnum, dif, sdif,
 				  hslot2, skb);
@@ -964,6 +1020,10 @@ static struct sock *__udp6_lib_demux_lookup(struct net *net,
 	const __portpair ports = INET_COMBINED_PORTS(rmt_port, hnum);
 	struct sock *sk;
 
+	if (udp_lookup_hash4(hslot2))
+		return udp6_lib_lookup4(net, rmt_addr, rmt_port, loc_addr,
+					hnum, dif, sdif, &udp_table);
+
 	udp_portaddr_for_each_entry_rcu(sk, &hslot2->head) {
 		if (sk->sk_state == TCP_ESTABLISHED &&
 		    INET6_MATCH(sk, net, rmt_addr, loc_addr, ports, dif, sdif))
@@ -1661,7 +1721,7 @@ struct proto udpv6_prot = {
 	.owner			= THIS_MODULE,
 	.close			= udp_lib_close,
 	.pre_connect		= udpv6_pre_connect,
-	.connect		= ip6_datagram_connect,
+	.connect		= udpv6_connect,
 	.disconnect		= udp_disconnect,
 	.ioctl			= udp_ioctl,
 	.init			= udp_init_sock,
@@ -67,6 +67,7 @@ EXPORT_SYMBOL_GPL(nf_conntrack_hash);
 struct conntrack_gc_work {
 	struct delayed_work	dwork;
 	u32			last_bucket;
+	u32			id;	/* scans buckets id, id + n, id + 2n, ... */
 	bool			exiting;
 	bool			early_drop;
 	long			next_gc_run;
@@ -82,8 +83,12 @@ static __read_mostly bool nf_conntrack_locks_all;
 #define GC_MAX_SCAN_JIFFIES	(16u * HZ)
 /* desired ratio of entries found to be expired */
 #define GC_EVICT_RATIO	50u
+/* upper bound of gc workers scanning the table in parallel */
+#define GC_MAX_WORKERS	8u
 
-static struct conntrack_gc_work conntrack_gc_work;
+static struct conntrack_gc_work conntrack_gc_work[GC_MAX_WORKERS];
+static unsigned int conntrack_gc_workers __read_mostly = 1;
+static struct workqueue_struct *conntrack_gc_wq __read_mostly;
 
 void nf_conntrack_lock(spinlock_t *lock) __acquires(lock)
 {
@@ -1367,7 +1372,9 @@ static void gc_worker(struct work_struct *work)
 
 	gc_work = container_of(work, struct conntrack_gc_work, dwork.work);
 
-	goal = nf_conntrack_htable_size / GC_MAX_BUCKETS_DIV;
+	/* Each worker only looks at its own share of the buckets. */
+	goal = nf_conntrack_htable_size / GC_MAX_BUCKETS_DIV /
+	       conntrack_gc_workers;
 	i = gc_work->last_bucket;
 	if (gc_work->early_drop)
 		nf_conntrack_max95 = nf_conntrack_max / 100u * 95u;
@@ -1379,12 +1386,18 @@ static void gc_worker(struct work_struct *work)
 		unsigned int hashsz;
 		struct nf_conn *tmp;
 
-		i++;
+		i += conntrack_gc_workers;
 		rcu_read_lock();
 
 		nf_conntrack_get_ht(&ct_hash, &hashsz);
-		if (i >= hashsz)
-			i = 0;
+		if (i >= hashsz) {
+			i = gc_work->id;
+			/* table shrunk below the number of workers */
+			if (unlikely(i >= hashsz)) {
+				rcu_read_unlock();
+				break;
+			}
+		}
 
 		hlist_nulls_for_each_entry_rcu(h, n, &ct_hash[i], hnnode) {
 			struct net *net;
@@ -1468,17 +1481,29 @@ static void gc_worker(struct work_struct *work)
 
 	next_run = gc_work->next_gc_run;
 	gc_work->last_bucket = i;
-	gc_work->early_drop = false;
-	queue_delayed_work(system_power_efficient_wq, &gc_work->dwork, next_run);
+	WRITE_ONCE(gc_work->early_drop, false);
+	queue_delayed_work(conntrack_gc_wq, &gc_work->dwork, next_run);
 }
 
-static void conntrack_gc_work_init(struct conntrack_gc_work *gc_work)
+static void conntrack_gc_work_init(struct conntrack_gc_work *gc_work, u32 id)
 {
 	INIT_DEFERRABLE_WORK(&gc_work->dwork, gc_worker);
+	gc_work->id = id;
+	gc_work->last_bucket = id;
 	gc_work->next_gc_run = HZ;
 	gc_work->exiting = false;
 }
 
+/* Table is full: make every worker evict non-assured entries. */
+static void conntrack_gc_request_early_drop(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < conntrack_gc_workers; i++)
+		if (!READ_ONCE(conntrack_gc_work[i].early_drop))
+			WRITE_ONCE(conntrack_gc_work[i].early_drop, true);
+}
+
 static struct nf_conn *
 __nf_conntrack_alloc(struct net *net,
 		     const struct nf_conntrack_zone *zone,
@@ -1494,8 +1519,7 @@ __nf_conntrack_alloc(struct net *net,
 	if (nf_conntrack_max &&
 	    unlikely(atomic_read(&net->ct.count) > nf_conntrack_max)) {
 		if (!early_drop(net, hash)) {
-			if (!conntrack_gc_work.early_drop)
-				conntrack_gc_work.early_drop = true;
+			conntrack_gc_request_early_drop();
 			atomic_dec(&net->ct.count);
 			net_warn_ratelimited("nf_conntrack: table full, dropping packet\n");
 			return ERR_PTR(-ENOMEM);
@@ -2396,14 +2420,21 @@ static int kill_all(struct nf_conn *i, void *data)
 
 void nf_conntrack_cleanup_start(void)
 {
-	conntrack_gc_work.exiting = true;
+	unsigned int i;
+
+	for (i = 0; i < conntrack_gc_workers; i++)
+		conntrack_gc_work[i].exiting = true;
 	RCU_INIT_POINTER(ip_ct_attach, NULL);
 }
 
 void nf_conntrack_cleanup_end(void)
 {
+	unsigned int i;
+
 	RCU_INIT_POINTER(nf_ct_hook, NULL);
-	cancel_delayed_work_sync(&conntrack_gc_work.dwork);
+	for (i = 0; i < conntrack_gc_workers; i++)
+		cancel_delayed_work_sync(&conntrack_gc_work[i].dwork);
+	destroy_workqueue(conntrack_gc_wq);
 	kvfree(nf_conntrack_hash);
 
 	nf_conntrack_proto_fini();
@@ -2677,11 +2708,26 @@ int nf_conntrack_init_start(void)
 	if (ret < 0)
 		goto err_proto;
 
-	conntrack_gc_work_init(&conntrack_gc_work);
-	queue_delayed_work(system_power_efficient_wq, &conntrack_gc_work.dwork, HZ);
+	/* Unbound, so that the workers really run on different cpus. */
+	conntrack_gc_wq = alloc_workqueue("nf_conntrack_gc",
+					  WQ_UNBOUND | WQ_POWER_EFFICIENT, 0);
+	if (!conntrack_gc_wq) {
+		ret = -ENOMEM;
+		goto err_gc_wq;
+	}
+
+	/* leave at least half of the cpus to packet processing */
+	conntrack_gc_workers = clamp(num_online_cpus() / 2, 1u, GC_MAX_WORKERS);
+	for (i = 0; i < conntrack_gc_workers; i++) {
+		conntrack_gc_work_init(&conntrack_gc_work[i], i);
+		queue_delayed_work(conntrack_gc_wq, &conntrack_gc_work[i].dwork,
+				   HZ);
+	}
 
 	return 0;
 
+err_gc_wq:
+	nf_conntrack_proto_fini();
 err_proto:
 	nf_conntrack_seqadj_fini();
 err_seqadj:
@@ -81,6 +81,7 @@ static int flow_offload_fill_route(struct flow_offload *flow,
 	struct flow_offload_tuple *flow_tuple = &flow->tuplehash[dir].tuple;
 	struct dst_entry *other_dst = route->tuple[!dir].dst;
 	struct dst_entry *dst = route->tuple[dir].dst;
+	int i;
 
 	if (!dst_hold_safe(route->tuple[dir].dst))
 		return -1;
@@ -94,7 +95,22 @@ static int flow_offload_fill_route(struct flow_offload *flow,
 		break;
 	}
 
-	flow_tuple->iifidx = other_dst->dev->ifindex;
+	flow_tuple->iifidx = route->tuple[dir].in.ifindex ?:
+			     other_dst->dev->ifindex;
+	for (i = 0; i < route->tuple[dir].in.num_encaps; i++) {
+		flow_tuple->encap[i].id = route->tuple[dir].in.encap[i].id;
+		flow_tuple->encap[i].proto = route->tuple[dir].in.encap[i].proto;
+	}
+	flow_tuple->encap_num = route->tuple[dir].in.num_encaps;
+
+	flow_tuple->xmit_type = route->tuple[dir].xmit_type;
+	if (flow_tuple->xmit_type == FLOW_OFFLOAD_XMIT_DIRECT) {
+		memcpy(flow_tuple->out.h_source, route->tuple[dir].out.h_source,
+		       ETH_ALEN);
+		memcpy(flow_tuple->out.h_dest, route->tuple[dir].out.h_dest,
+		       ETH_ALEN);
+		flow_tuple->out.ifidx = route->tuple[dir].out.ifindex;
+	}
 	flow_tuple->dst_cache = dst;
 
 	return 0;
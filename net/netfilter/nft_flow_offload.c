@@ -6,9 +6,12 @@
 #include <linux/netfilter.h>
 #include <linux/workqueue.h>
 #include <linux/spinlock.h>
+#include <linux/if_bridge.h>
+#include <linux/if_vlan.h>
 #include <linux/netfilter/nf_conntrack_common.h>
 #include <linux/netfilter/nf_tables.h>
 #include <net/ip.h> /* for ipv4 options. */
+#include <net/neighbour.h>
 #include <net/netfilter/nf_tables.h>
 #include <net/netfilter/nf_tables_core.h>
 #include <net/netfilter/nf_conntrack_core.h>
@@ -19,10 +22,136 @@ struct nft_flow_offload {
 	struct nft_flowtable	*flowtable;
 };
 
+/* upper bound of stacked devices walked to find the real device */
+#define NFT_FLOW_PATH_MAX	4
+
+struct nft_forward_info {
+	const struct net_device	*outdev;
+	struct {
+		u16		id;
+		__be16		proto;
+	} encap[NF_FLOW_TABLE_ENCAP_MAX];
+	u8			num_encaps;
+	u8			h_source[ETH_ALEN];
+	u8			h_dest[ETH_ALEN];
+};
+
+/*
+ * Walk from the route output device down to the ethernet device the
+ * packet really leaves on, through VLAN devices and bridges that do not
+ * filter VLANs.  Returns false if the path is anything else, then the
+ * flow keeps going through neigh_xmit() on the route output device.
+ */
+static bool nft_dev_forward_path(struct dst_entry *dst, const void *daddr,
+				 struct nft_forward_info *info)
+{
+	struct net_device *dev = dst->dev;
+	struct neighbour *n;
+	int i, depth;
+	u8 nud_state;
+
+	if (!(dev->flags & IFF_UP) || dev->type != ARPHRD_ETHER ||
+	    dst_xfrm(dst))
+		return false;
+
+	n = dst_neigh_lookup(dst, daddr);
+	if (!n)
+		return false;
+
+	read_lock_bh(&n->lock);
+	nud_state = n->nud_state;
+	ether_addr_copy(info->h_dest, n->ha);
+	read_unlock_bh(&n->lock);
+	neigh_release(n);
+
+	if (!(nud_state & NUD_VALID))
+		return false;
+
+	ether_addr_copy(info->h_source, dev->dev_addr);
+
+	for (depth = 0; depth < NFT_FLOW_PATH_MAX; depth++) {
+		if (is_vlan_dev(dev)) {
+			if (info->num_encaps >= NF_FLOW_TABLE_ENCAP_MAX)
+				return false;
+			info->encap[info->num_encaps].id = vlan_dev_vlan_id(dev);
+			info->encap[info->num_encaps].proto =
+				vlan_dev_vlan_proto(dev);
+			info->num_encaps++;
+			dev = vlan_dev_real_dev(dev);
+		} else if (netif_is_bridge_master(dev)) {
+			if (br_vlan_enabled(dev))
+				return false;
+			dev = br_fdb_find_port_rcu(dev, info->h_dest, 0);
+			if (!dev)
+				return false;
+		} else {
+			break;
+		}
+	}
+
+	if (depth == NFT_FLOW_PATH_MAX || dev->type != ARPHRD_ETHER ||
+	    netif_is_bridge_master(dev) || is_vlan_dev(dev))
+		return false;
+
+	/* Found while walking top down, store outermost first. */
+	for (i = 0; i < info->num_encaps / 2; i++)
+		swap(info->encap[i], info->encap[info->num_encaps - 1 - i]);
+
+	info->outdev = dev;
+	return true;
+}
+
+static bool nft_flowtable_find_dev(const struct net_device *dev,
+				   struct nft_flowtable *ft)
+{
+	struct nft_hook *hook;
+
+	list_for_each_entry_rcu(hook, &ft->hook_list, list) {
+		if (hook->ops.dev == dev)
+			return true;
+	}
+
+	return false;
+}
+
+static void nft_flow_route_direct(const struct nf_conn *ct,
+				  struct nf_flow_route *route,
+				  enum ip_conntrack_dir dir,
+				  struct nft_flowtable *ft)
+{
+	struct nft_forward_info info = {};
+	int i;
+
+	if (!nft_dev_forward_path(route->tuple[dir].dst,
+				  &ct->tuplehash[!dir].tuple.src.u3, &info))
+		return;
+
+	/* Packets in the other direction come in through the same path, but
+	 * are only seen on the real device if the flowtable hooks it.
+	 * Otherwise keep using the route devices as before.
+	 */
+	if (!nft_flowtable_find_dev(info.outdev, ft))
+		return;
+
+	route->tuple[dir].xmit_type = FLOW_OFFLOAD_XMIT_DIRECT;
+	route->tuple[dir].out.ifindex = info.outdev->ifindex;
+	ether_addr_copy(route->tuple[dir].out.h_source, info.h_source);
+	ether_addr_copy(route->tuple[dir].out.h_dest, info.h_dest);
+
+	/* The tags pushed on xmit are the ones popped from the replies. */
+	route->tuple[!dir].in.ifindex = info.outdev->ifindex;
+	for (i = 0; i < info.num_encaps; i++) {
+		route->tuple[!dir].in.encap[i].id = info.encap[i].id;
+		route->tuple[!dir].in.encap[i].proto = info.encap[i].proto;
+	}
+	route->tuple[!dir].in.num_encaps = info.num_encaps;
+}
+
 static int nft_flow_route(const struct nft_pktinfo *pkt,
 			  const struct nf_conn *ct,
 			  struct nf_flow_route *route,
-			  enum ip_conntrack_dir dir)
+			  enum ip_conntrack_dir dir,
+			  struct nft_flowtable *ft)
 {
 	struct dst_entry *this_dst = skb_dst(pkt->skb);
 	struct dst_entry *other_dst = NULL;
@@ -47,6 +176,13 @@ static int nft_flow_route(const struct nft_pktinfo *pkt,
 	route->tuple[dir].dst		= this_dst;
 	route->tuple[!dir].dst		= other_dst;
 
+	/* Hardware offload only knows how to do plain routing. */
+	if (nf_flowtable_hw_offload(&ft->data))
+		return 0;
+
+	nft_flow_route_direct(ct, route, dir, ft);
+	nft_flow_route_direct(ct, route, !dir, ft);
+
 	return 0;
 }
 
@@ -75,7 +211,7 @@ static void nft_flow_offload_eval(const struct nft_expr *expr,
 	struct nf_flowtable *flowtable = &priv->flowtable->data;
 	struct tcphdr _tcph, *tcph = NULL;
 	enum ip_conntrack_info ctinfo;
-	struct nf_flow_route route;
+	struct nf_flow_route route = {};
 	struct flow_offload *flow;
 	enum ip_conntrack_dir dir;
 	struct nf_conn *ct;
@@ -112,7 +248,7 @@ static void nft_flow_offload_eval(const struct nft_expr *expr,
 		goto out;
 
 	dir = CTINFO2DIR(ctinfo);
-	if (nft_flow_route(pkt, ct, &route, dir) < 0)
+	if (nft_flow_route(pkt, ct, &route, dir, priv->flowtable) < 0)
 		goto err_flow_route;
 
 	flow = flow_offload_alloc(ct);
@@ -1289,6 +1289,7 @@ xprt_request_enqueue_transmit(struct rpc_task *task)
 		INIT_LIST_HEAD(&req->rq_xmit2);
 		trace_xprt_enq_xmit(task, 4);
 out:
+		atomic_long_inc(&xprt->xmit_queuelen);
 		set_bit(RPC_TASK_NEED_XMIT, &task->tk_runstate);
 		spin_unlock(&xprt->queue_lock);
 	}
@@ -1308,6 +1309,7 @@ xprt_request_dequeue_transmit_locked(struct rpc_task *task)
 
 	if (!test_and_clear_bit(RPC_TASK_NEED_XMIT, &task->tk_runstate))
 		return;
+	atomic_long_dec(&req->rq_xprt->xmit_queuelen);
 	if (!list_empty(&req->rq_xmit)) {
 		list_del(&req->rq_xmit);
 		if (!list_empty(&req->rq_xmit2)) {
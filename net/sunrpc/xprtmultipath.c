@@ -10,6 +10,7 @@
 #include <linux/types.h>
 #include <linux/kref.h>
 #include <linux/list.h>
+#include <linux/moduleparam.h>
 #include <linux/rcupdate.h>
 #include <linux/rculist.h>
 #include <linux/slab.h>
@@ -24,8 +25,14 @@ typedef struct rpc_xprt *(*xprt_switch_find_xprt_t)(struct rpc_xprt_switch *xps,
 
 static const struct rpc_xprt_iter_ops rpc_xprt_iter_singular;
 static const struct rpc_xprt_iter_ops rpc_xprt_iter_roundrobin;
+static const struct rpc_xprt_iter_ops rpc_xprt_iter_cpu;
 static const struct rpc_xprt_iter_ops rpc_xprt_iter_listall;
 
+static bool xprt_switch_cpu_affine __read_mostly;
+module_param_named(xprt_cpu_affine, xprt_switch_cpu_affine, bool, 0644);
+MODULE_PARM_DESC(xprt_cpu_affine,
+		 "Prefer a transport chosen by the submitting CPU over round-robin");
+
 static void xprt_switch_add_xprt_locked(struct rpc_xprt_switch *xps,
 		struct rpc_xprt *xprt)
 {
@@ -169,11 +176,17 @@ void xprt_switch_put(struct rpc_xprt_switch *xps)
  * @xps: pointer to struct rpc_xprt_switch
  *
  * Sets a round-robin default policy for iterators acting on xps.
+ * If the xprt_cpu_affine parameter is set, the CPU-affine variant
+ * is used instead.
  */
 void rpc_xprt_switch_set_roundrobin(struct rpc_xprt_switch *xps)
 {
-	if (READ_ONCE(xps->xps_iter_ops) != &rpc_xprt_iter_roundrobin)
-		WRITE_ONCE(xps->xps_iter_ops, &rpc_xprt_iter_roundrobin);
+	const struct rpc_xprt_iter_ops *ops = &rpc_xprt_iter_roundrobin;
+
+	if (READ_ONCE(xprt_switch_cpu_affine))
+		ops = &rpc_xprt_iter_cpu;
+	if (READ_ONCE(xps->xps_iter_ops) != ops)
+		WRITE_ONCE(xps->xps_iter_ops, ops);
 }
 
 static
@@ -358,6 +371,45 @@ struct rpc_xprt *xprt_iter_next_entry_roundrobin(struct rpc_xprt_iter *xpi)
 			xprt_switch_find_next_entry_roundrobin);
 }
 
+/*
+ * Map the submitting CPU onto one of the active transports. Contiguous
+ * ranges of CPU ids, which usually share a NUMA node, map onto the same
+ * transport, so that a request is queued, sent and completed on a
+ * socket whose lock and buffers stay local to that set of CPUs. Fall
+ * back to round-robin once that transport is busier than the average.
+ */
+static
+struct rpc_xprt *xprt_switch_find_next_entry_cpu(struct rpc_xprt_switch *xps,
+		const struct rpc_xprt *cur)
+{
+	struct list_head *head = &xps->xps_xprt_list;
+	unsigned long xps_queuelen;
+	unsigned int nactive, n;
+	struct rpc_xprt *pos;
+
+	nactive = READ_ONCE(xps->xps_nactive);
+	if (nactive < 2)
+		return xprt_switch_find_next_entry_roundrobin(xps, cur);
+
+	n = raw_smp_processor_id() * nactive / nr_cpu_ids;
+	xps_queuelen = atomic_long_read(&xps->xps_queuelen);
+	list_for_each_entry_rcu(pos, head, xprt_switch) {
+		if (!xprt_is_active(pos) || n-- != 0)
+			continue;
+		if (atomic_long_read(&pos->queuelen) * nactive <= xps_queuelen)
+			return pos;
+		return xprt_switch_find_next_entry_roundrobin(xps, pos);
+	}
+	return xprt_switch_find_next_entry_roundrobin(xps, cur);
+}
+
+static
+struct rpc_xprt *xprt_iter_next_entry_cpu(struct rpc_xprt_iter *xpi)
+{
+	return xprt_iter_next_entry_multiple(xpi,
+			xprt_switch_find_next_entry_cpu);
+}
+
 static
 struct rpc_xprt *xprt_switch_find_next_entry_all(struct rpc_xprt_switch *xps,
 		const struct rpc_xprt *cur)
@@ -532,6 +584,14 @@ const struct rpc_xprt_iter_ops rpc_xprt_iter_roundrobin = {
 	.xpi_next = xprt_iter_next_entry_roundrobin,
 };
 
+/* Policy for CPU-affine selection of entries in the rpc_xprt_switch */
+static
+const struct rpc_xprt_iter_ops rpc_xprt_iter_cpu = {
+	.xpi_rewind = xprt_iter_default_rewind,
+	.xpi_xprt = xprt_iter_current_entry,
+	.xpi_next = xprt_iter_next_entry_cpu,
+};
+
 /* Policy for once-through iteration of entries in the rpc_xprt_switch */
 static
 const struct rpc_xprt_iter_ops rpc_xprt_iter_listall = {
@@ -1020,6 +1020,7 @@ static int xs_tcp_send_request(struct rpc_rqst *req)
 	 * to cope with writespace callbacks arriving _after_ we have
 	 * called sendmsg(). */
 	req->rq_xtime = ktime_get();
+	tcp_sock_set_cork(transport->inet, true);
 	while (1) {
 		status = xprt_sock_sendmsg(transport->sock, &msg, xdr,
 					   transport->xmit.offset, rm, &sent);
@@ -1034,6 +1035,14 @@ static int xs_tcp_send_request(struct rpc_rqst *req)
 		if (likely(req->rq_bytes_sent >= msglen)) {
 			req->rq_xmit_bytes_sent += transport->xmit.offset;
 			transport->xmit.offset = 0;
+			/*
+			 * xprt_transmit() sends everything that is queued
+			 * while it holds the transport. Keep the socket
+			 * corked until the last of those requests so that
+			 * they are coalesced into full segments.
+			 */
+			if (atomic_long_read(&xprt->xmit_queuelen) == 1)
+				tcp_sock_set_cork(transport->inet, false);
 			return 0;
 		}
 
@@ -1065,6 +1074,9 @@ static int xs_tcp_send_request(struct rpc_rqst *req)
 		vm_wait = false;
 	}
 
+	/* Don't leave a partial record sitting behind the cork */
+	tcp_sock_set_cork(transport->inet, false);
+
 	switch (status) {
 	case -ENOTSOCK:
 		status = -ENOTCONN;
@@ -401,6 +401,13 @@ int tls_tx_records(struct sock *sk, int flags)
 			else
 				tx_flags = flags;
 
+			/* Let TCP coalesce a run of records, pushing only
+			 * after the last one.
+			 */
+			if (!list_is_last(&rec->list, &ctx->tx_list) &&
+			    READ_ONCE(tmp->tx_ready))
+				tx_flags |= MSG_SENDPAGE_NOTLAST;
+
 			msg_en = &rec->msg_encrypted;
 			rc = tls_push_sg(sk, tls_ctx,
 					 &msg_en->sg.data[msg_en->sg.curr],
@@ -663,6 +670,33 @@ static void tls_merge_open_record(struct sock *sk, struct tls_rec *to,
 	kfree(from);
 }
 
+/* Upper bound of encrypted records sendmsg holds back before pushing */
+#define TLS_TX_BATCH_MAX	8
+
+/* With a synchronous cipher every record used to be handed to TCP right
+ * after it was encrypted.  While sendmsg is still filling records, keep
+ * them on tx_list instead and push the whole batch at once from
+ * tls_tx_batch_flush().
+ */
+static bool tls_tx_batch(struct tls_sw_context_tx *ctx)
+{
+	if (!ctx->tx_batch || ctx->tx_batched >= TLS_TX_BATCH_MAX)
+		return false;
+
+	ctx->tx_batched++;
+	return true;
+}
+
+static int tls_tx_batch_flush(struct sock *sk, struct tls_sw_context_tx *ctx,
+			      int flags)
+{
+	if (!ctx->tx_batched)
+		return 0;
+
+	ctx->tx_batched = 0;
+	return tls_tx_records(sk, flags);
+}
+
 static int tls_push_record(struct sock *sk, int flags,
 			   unsigned char record_type)
 {
@@ -779,6 +813,11 @@ static int tls_push_record(struct sock *sk, int flags,
 		ctx->open_rec = tmp;
 	}
 
+	if (tls_tx_batch(ctx))
+		return 0;
+
+	/* This sends the held back records as well. */
+	ctx->tx_batched = 0;
 	return tls_tx_records(sk, flags);
 }
 
@@ -934,6 +973,7 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	int orig_size;
 	int ret = 0;
 	int pending;
+	int err;
 
 	if (msg->msg_flags & ~(MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL))
 		return -EOPNOTSUPP;
@@ -941,6 +981,9 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	mutex_lock(&tls_ctx->tx_lock);
 	lock_sock(sk);
 
+	/* Only worth it if records are encrypted in line. */
+	ctx->tx_batch = !async_capable;
+
 	if (unlikely(msg->msg_controllen)) {
 		ret = tls_proccess_cmsg(sk, msg, &record_type);
 		if (ret) {
@@ -1084,6 +1127,8 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 wait_for_sndbuf:
 		set_bit(SOCK_NOSPACE, &sk->sk_socket->flags);
 wait_for_memory:
+		/* Held back records are what is filling the send buffer. */
+		tls_tx_batch_flush(sk, ctx, msg->msg_flags);
 		ret = sk_stream_wait_memory(sk, &timeo);
 		if (ret) {
 trim_sgl:
@@ -1128,6 +1173,10 @@ int tls_sw_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 	}
 
 send_end:
+	ctx->tx_batch = 0;
+	err = tls_tx_batch_flush(sk, ctx, msg->msg_flags);
+	if (!ret && err < 0 && err != -EAGAIN)
+		ret = err;
 	ret = sk_stream_error(sk, msg->msg_flags, ret);
 
 	release_sock(sk);
@@ -1411,7 +1460,8 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 
 	if (*zc && (out_iov || out_sg)) {
 		if (out_iov)
-			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1;
+			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1 +
+				  prot->tail_size;
 		else
 			n_sgout = sg_nents(out_sg);
 		n_sgin = skb_nsg(skb, rxm->offset + prot->prepend_size,
@@ -1495,11 +1545,22 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 			sg_set_buf(&sgout[0], aad, prot->aad_size);
 
 			*chunk = 0;
-			err = tls_setup_from_iter(sk, out_iov, data_len,
+			err = tls_setup_from_iter(sk, out_iov,
+						  data_len - prot->tail_size,
 						  &pages, chunk, &sgout[1],
-						  (n_sgout - 1));
+						  (n_sgout - 1 - prot->tail_size));
 			if (err < 0)
 				goto fallback_to_reg_recv;
+
+			/* TLS 1.3 content type goes to ctx->tail, not to
+			 * the user.
+			 */
+			if (prot->tail_size) {
+				sg_unmark_end(&sgout[pages]);
+				sg_set_buf(&sgout[pages + 1], &ctx->tail,
+					   prot->tail_size);
+				sg_mark_end(&sgout[pages + 1]);
+			}
 		} else if (out_sg) {
 			memcpy(sgout, out_sg, n_sgout * sizeof(*sgout));
 		} else {
@@ -1548,6 +1609,23 @@ static int decrypt_skb_update(struct sock *sk, struct sk_buff *skb,
 		if (!ctx->decrypted) {
 			err = decrypt_internal(sk, skb, dest, NULL, chunk, zc,
 					       async);
+			/* A TLS 1.3 record decrypted into the user buffer
+			 * turned out not to be an unpadded data record, the
+			 * ciphertext is still intact so decrypt it again in
+			 * place.
+			 */
+			if (!err && *zc && prot->tail_size &&
+			    ctx->tail != TLS_RECORD_TYPE_DATA) {
+				TLS_INC_STATS(sock_net(sk),
+					      LINUX_MIB_TLSDECRYPTRETRY);
+				if (!ctx->tail)
+					TLS_INC_STATS(sock_net(sk),
+						      LINUX_MIB_TLSRXNOPADVIOL);
+				iov_iter_revert(dest, *chunk);
+				*zc = false;
+				err = decrypt_internal(sk, skb, dest, NULL,
+						       chunk, zc, async);
+			}
 			if (err < 0) {
 				if (err == -EINPROGRESS)
 					tls_advance_record_sn(sk, prot,
@@ -1561,9 +1639,15 @@ static int decrypt_skb_update(struct sock *sk, struct sk_buff *skb,
 			*zc = false;
 		}
 
-		pad = padding_length(ctx, prot, skb);
-		if (pad < 0)
-			return pad;
+		if (*zc && prot->tail_size) {
+			/* plaintext is in the user buffer, skb is untouched */
+			ctx->control = ctx->tail;
+			pad = 0;
+		} else {
+			pad = padding_length(ctx, prot, skb);
+			if (pad < 0)
+				return pad;
+		}
 
 		rxm->full_len -= pad;
 		rxm->offset += prot->prepend_size;
@@ -1807,7 +1891,7 @@ int tls_sw_recvmsg(struct sock *sk,
 
 		if (to_decrypt <= len && !is_kvec && !is_peek &&
 		    ctx->control == TLS_RECORD_TYPE_DATA &&
-		    prot->version != TLS_1_3_VERSION &&
+		    (prot->version != TLS_1_3_VERSION || tls_ctx->rx_no_pad) &&
 		    !bpf_strp_enabled)
 			zc = true;
 
@@ -151,6 +151,19 @@ int xdp_umem_assign_dev(struct xdp_umem *umem, struct net_device *dev,
 	return err;
 }
 
+/* A shared umem has to run in the same mode as the one it was cloned from */
+int xdp_umem_assign_dev_shared(struct xdp_umem *umem, struct xdp_umem *from,
+			       struct net_device *dev, u16 queue_id)
+{
+	u16 flags;
+
+	flags = from->zc ? XDP_ZEROCOPY : XDP_COPY;
+	if (from->flags & XDP_UMEM_USES_NEED_WAKEUP)
+		flags |= XDP_USE_NEED_WAKEUP;
+
+	return xdp_umem_assign_dev(umem, dev, queue_id, flags);
+}
+
 void xdp_umem_clear_dev(struct xdp_umem *umem)
 {
 	struct netdev_bpf bpf;
@@ -201,8 +214,6 @@ static void xdp_umem_release(struct xdp_umem *umem)
 	xdp_umem_clear_dev(umem);
 	rtnl_unlock();
 
-	ida_simple_remove(&umem_ida, umem->id);
-
 	if (umem->fq) {
 		xskq_destroy(umem->fq);
 		umem->fq = NULL;
@@ -214,9 +225,14 @@ static void xdp_umem_release(struct xdp_umem *umem)
 	}
 
 	xp_destroy(umem->pool);
-	xdp_umem_unpin_pages(umem);
 
-	xdp_umem_unaccount_pages(umem);
+	if (umem->parent) {
+		xdp_put_umem(umem->parent);
+	} else {
+		ida_simple_remove(&umem_ida, umem->id);
+		xdp_umem_unpin_pages(umem);
+		xdp_umem_unaccount_pages(umem);
+	}
 	kfree(umem);
 }
 
@@ -413,7 +429,50 @@ struct xdp_umem *xdp_umem_create(struct xdp_umem_reg *mr)
 	return umem;
 }
 
-bool xdp_umem_validate_queues(struct xdp_umem *umem)
+/* Create a umem that shares the pinned pages of @from, for use on another
+ * netdev or queue id.  It gets its own buffer pool, and with that its own
+ * DMA mappings, fill ring and completion ring.
+ */
+struct xdp_umem *xdp_umem_create_shared(struct xdp_umem *from)
+{
+	struct xdp_umem *parent = from->parent ?: from;
+	struct xdp_umem *umem;
+	u32 chunks;
+
+	umem = kzalloc(sizeof(*umem), GFP_KERNEL);
+	if (!umem)
+		return ERR_PTR(-ENOMEM);
+
+	umem->id = parent->id;
+	umem->size = parent->size;
+	umem->headroom = parent->headroom;
+	umem->chunk_size = parent->chunk_size;
+	umem->npgs = parent->npgs;
+	umem->pgs = parent->pgs;
+	umem->flags = parent->flags & XDP_UMEM_UNALIGNED_CHUNK_FLAG;
+	INIT_LIST_HEAD(&umem->xsk_tx_list);
+	spin_lock_init(&umem->xsk_tx_list_lock);
+
+	refcount_set(&umem->users, 1);
+
+	chunks = (u32)div_u64(umem->size, umem->chunk_size);
+	umem->pool = xp_create(umem->pgs, umem->npgs, chunks, umem->chunk_size,
+			       umem->headroom, umem->size,
+			       umem->flags & XDP_UMEM_UNALIGNED_CHUNK_FLAG);
+	if (!umem->pool) {
+		kfree(umem);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	xdp_get_umem(parent);
+	umem->parent = parent;
+	return umem;
+}
+
+void xdp_umem_assign_queues(struct xdp_umem *umem, struct xsk_queue *fq,
+			    struct xsk_queue *cq)
 {
-	return umem->fq && umem->cq;
+	umem->fq = fq;
+	umem->cq = cq;
+	xp_set_fq(umem->pool, fq);
 }
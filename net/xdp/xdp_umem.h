@@ -10,12 +10,16 @@
 
 int xdp_umem_assign_dev(struct xdp_umem *umem, struct net_device *dev,
 			u16 queue_id, u16 flags);
+int xdp_umem_assign_dev_shared(struct xdp_umem *umem, struct xdp_umem *from,
+			       struct net_device *dev, u16 queue_id);
 void xdp_umem_clear_dev(struct xdp_umem *umem);
-bool xdp_umem_validate_queues(struct xdp_umem *umem);
+void xdp_umem_assign_queues(struct xdp_umem *umem, struct xsk_queue *fq,
+			    struct xsk_queue *cq);
 void xdp_get_umem(struct xdp_umem *umem);
 void xdp_put_umem(struct xdp_umem *umem);
 void xdp_add_sk_umem(struct xdp_umem *umem, struct xdp_sock *xs);
 void xdp_del_sk_umem(struct xdp_umem *umem, struct xdp_sock *xs);
 struct xdp_umem *xdp_umem_create(struct xdp_umem_reg *mr);
+struct xdp_umem *xdp_umem_create_shared(struct xdp_umem *from);
 
 #endif /* XDP_UMEM_H_ */
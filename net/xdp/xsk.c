@@ -23,6 +23,7 @@
 #include <linux/netdevice.h>
 #include <linux/rculist.h>
 #include <net/xdp_sock_drv.h>
+#include <net/busy_poll.h>
 #include <net/xdp.h>
 
 #include "xsk_queue.h"
@@ -198,6 +199,7 @@ static int xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp,
 	if (xs->dev != xdp->rxq->dev || xs->queue_id != xdp->rxq->queue_index)
 		return -EINVAL;
 
+	sk_mark_napi_id_once_xdp(&xs->sk, xdp);
 	len = xdp->data_end - xdp->data;
 
 	return xdp->rxq->mem.type == MEM_TYPE_XSK_BUFF_POOL ?
@@ -422,20 +424,71 @@ static int __xsk_sendmsg(struct sock *sk)
 	return xs->zc ? xsk_zc_xmit(xs) : xsk_generic_xmit(sk);
 }
 
+static bool xsk_no_wakeup(struct sock *sk)
+{
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	/* Prefer busy-polling, skip the wakeup. */
+	return READ_ONCE(sk->sk_prefer_busy_poll) && READ_ONCE(sk->sk_ll_usec) &&
+		READ_ONCE(sk->sk_napi_id) >= MIN_NAPI_ID;
+#else
+	return false;
+#endif
+}
+
 static int xsk_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len)
 {
 	bool need_wait = !(m->msg_flags & MSG_DONTWAIT);
 	struct sock *sk = sock->sk;
 	struct xdp_sock *xs = xdp_sk(sk);
+	struct xdp_umem *umem;
 
 	if (unlikely(!xsk_is_bound(xs)))
 		return -ENXIO;
 	if (unlikely(need_wait))
 		return -EOPNOTSUPP;
 
+	if (sk_can_busy_loop(sk))
+		sk_busy_loop(sk, 1); /* only support non-blocking sockets */
+
+	/* Copy mode needs the syscall to push the frames out */
+	if (xs->zc && xsk_no_wakeup(sk))
+		return 0;
+
+	umem = xs->umem;
+	if (xsk_umem_uses_need_wakeup(umem) &&
+	    !(umem->need_wakeup & XDP_WAKEUP_TX))
+		return 0;
+
 	return __xsk_sendmsg(sk);
 }
 
+static int xsk_recvmsg(struct socket *sock, struct msghdr *m, size_t len,
+		       int flags)
+{
+	bool need_wait = !(flags & MSG_DONTWAIT);
+	struct sock *sk = sock->sk;
+	struct xdp_sock *xs = xdp_sk(sk);
+
+	if (unlikely(!xsk_is_bound(xs)))
+		return -ENXIO;
+	if (unlikely(!(xs->dev->flags & IFF_UP)))
+		return -ENETDOWN;
+	if (unlikely(!xs->rx))
+		return -ENOBUFS;
+	if (unlikely(need_wait))
+		return -EOPNOTSUPP;
+
+	if (sk_can_busy_loop(sk))
+		sk_busy_loop(sk, 1); /* only support non-blocking sockets */
+
+	if (xsk_no_wakeup(sk))
+		return 0;
+
+	if (xs->zc && (xs->umem->need_wakeup & XDP_WAKEUP_RX))
+		return xsk_wakeup(xs, XDP_WAKEUP_RX);
+	return 0;
+}
+
 static __poll_t xsk_poll(struct file *file, struct socket *sock,
 			     struct poll_table_struct *wait)
 {
@@ -450,11 +503,13 @@ static __poll_t xsk_poll(struct file *file, struct socket *sock,
 	umem = xs->umem;
 
 	if (umem->need_wakeup) {
-		if (xs->zc)
-			xsk_wakeup(xs, umem->need_wakeup);
-		else
+		if (xs->zc) {
+			if (!xsk_no_wakeup(sk))
+				xsk_wakeup(xs, umem->need_wakeup);
+		} else {
 			/* Poll needs to drive Tx also in copy mode */
 			__xsk_sendmsg(sk);
+		}
 	}
 
 	if (xs->rx && !xskq_prod_is_empty(xs->rx))
@@ -570,6 +625,8 @@ static int xsk_release(struct socket *sock)
 
 	xskq_destroy(xs->rx);
 	xskq_destroy(xs->tx);
+	xskq_destroy(xs->fq_tmp);
+	xskq_destroy(xs->cq_tmp);
 
 	sock_orphan(sk);
 	sock->sk = NULL;
@@ -638,6 +695,7 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 
 	if (flags & XDP_SHARED_UMEM) {
 		struct xdp_sock *umem_xs;
+		struct xdp_umem *umem;
 		struct socket *sock;
 
 		if ((flags & XDP_COPY) || (flags & XDP_ZEROCOPY) ||
@@ -666,19 +724,54 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 			goto out_unlock;
 		}
 		if (umem_xs->dev != dev || umem_xs->queue_id != qid) {
+			/* Share the umem with another netdev or queue id.
+			 * This needs a fill and completion ring of its own.
+			 */
+			if (!xs->fq_tmp || !xs->cq_tmp) {
+				err = -EINVAL;
+				sockfd_put(sock);
+				goto out_unlock;
+			}
+
+			umem = xdp_umem_create_shared(umem_xs->umem);
+			if (IS_ERR(umem)) {
+				err = PTR_ERR(umem);
+				sockfd_put(sock);
+				goto out_unlock;
+			}
+
+			xdp_umem_assign_queues(umem, xs->fq_tmp, xs->cq_tmp);
+			xs->fq_tmp = NULL;
+			xs->cq_tmp = NULL;
+
+			err = xdp_umem_assign_dev_shared(umem, umem_xs->umem,
+							 dev, qid);
+			if (err) {
+				xdp_put_umem(umem);
+				sockfd_put(sock);
+				goto out_unlock;
+			}
+		} else if (xs->fq_tmp || xs->cq_tmp) {
+			/* Same queue, the rings of umem_xs are used. */
 			err = -EINVAL;
 			sockfd_put(sock);
 			goto out_unlock;
+		} else {
+			umem = umem_xs->umem;
+			xdp_get_umem(umem);
 		}
 
-		xdp_get_umem(umem_xs->umem);
-		WRITE_ONCE(xs->umem, umem_xs->umem);
+		WRITE_ONCE(xs->umem, umem);
 		sockfd_put(sock);
-	} else if (!xs->umem || !xdp_umem_validate_queues(xs->umem)) {
+	} else if (!xs->umem || !xs->fq_tmp || !xs->cq_tmp) {
 		err = -EINVAL;
 		goto out_unlock;
 	} else {
 		/* This xsk has its own umem. */
+		xdp_umem_assign_queues(xs->umem, xs->fq_tmp, xs->cq_tmp);
+		xs->fq_tmp = NULL;
+		xs->cq_tmp = NULL;
+
 		err = xdp_umem_assign_dev(xs->umem, dev, qid, flags);
 		if (err)
 			goto out_unlock;
@@ -793,16 +886,10 @@ static int xsk_setsockopt(struct socket *sock, int level, int optname,
 			mutex_unlock(&xs->mutex);
 			return -EBUSY;
 		}
-		if (!xs->umem) {
-			mutex_unlock(&xs->mutex);
-			return -EINVAL;
-		}
 
-		q = (optname == XDP_UMEM_FILL_RING) ? &xs->umem->fq :
-			&xs->umem->cq;
+		q = (optname == XDP_UMEM_FILL_RING) ? &xs->fq_tmp :
+			&xs->cq_tmp;
 		err = xsk_init_queue(entries, q, true);
-		if (optname == XDP_UMEM_FILL_RING)
-			xp_set_fq(xs->umem->pool, *q);
 		mutex_unlock(&xs->mutex);
 		return err;
 	}
@@ -949,7 +1036,6 @@ static int xsk_mmap(struct file *file, struct socket *sock,
 	unsigned long size = vma->vm_end - vma->vm_start;
 	struct xdp_sock *xs = xdp_sk(sock->sk);
 	struct xsk_queue *q = NULL;
-	struct xdp_umem *umem;
 	unsigned long pfn;
 	struct page *qpg;
 
@@ -960,17 +1046,10 @@ static int xsk_mmap(struct file *file, struct socket *sock,
 		q = READ_ONCE(xs->rx);
 	} else if (offset == XDP_PGOFF_TX_RING) {
 		q = READ_ONCE(xs->tx);
-	} else {
-		umem = READ_ONCE(xs->umem);
-		if (!umem)
-			return -EINVAL;
-
-		/* Matches the smp_wmb() in XDP_UMEM_REG */
-		smp_rmb();
-		if (offset == XDP_UMEM_PGOFF_FILL_RING)
-			q = READ_ONCE(umem->fq);
-		else if (offset == XDP_UMEM_PGOFF_COMPLETION_RING)
-			q = READ_ONCE(umem->cq);
+	} else if (offset == XDP_UMEM_PGOFF_FILL_RING) {
+		q = READ_ONCE(xs->fq_tmp);
+	} else if (offset == XDP_UMEM_PGOFF_COMPLETION_RING) {
+		q = READ_ONCE(xs->cq_tmp);
 	}
 
 	if (!q)
@@ -1041,7 +1120,7 @@ static const struct proto_ops xsk_proto_ops = {
 	.setsockopt	= xsk_setsockopt,
 	.getsockopt	= xsk_getsockopt,
 	.sendmsg	= xsk_sendmsg,
-	.recvmsg	= sock_no_recvmsg,
+	.recvmsg	= xsk_recvmsg,
 	.mmap		= xsk_mmap,
 	.sendpage	= sock_no_sendpage,
 };
@@ -60,6 +60,7 @@ struct xsk_buff_pool *xp_create(struct page **pages, u32 nr_pages, u32 chunks,
 		xskb = &pool->heads[i];
 		xskb->pool = pool;
 		xskb->xdp.frame_sz = chunk_size - headroom;
+		xskb->xdp.flags = 0;
 		pool->free_heads[i] = xskb;
 	}
 
@@ -238,4 +238,8 @@ struct prctl_mm_map {
 #define PR_SET_IO_FLUSHER		57
 #define PR_GET_IO_FLUSHER		58
 
+/* Ask khugepaged to collapse this mm's huge pages ahead of others */
+#define PR_SET_THP_COLLAPSE_PRIO	59
+#define PR_GET_THP_COLLAPSE_PRIO	60
+
 #endif /* _LINUX_PRCTL_H */
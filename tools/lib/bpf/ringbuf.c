@@ -33,6 +33,8 @@ struct ring {
 	unsigned long *producer_pos;
 	unsigned long mask;
 	int map_fd;
+	/* number of rings, starting with this one, that share map_fd */
+	int map_ring_cnt;
 };
 
 struct ring_buffer {
@@ -55,16 +57,58 @@ static void ringbuf_unmap_ring(struct ring_buffer *rb, struct ring *r)
 	}
 }
 
-/* Add extra RINGBUF maps to this ring buffer manager */
+static int ringbuf_map_ring(struct ring_buffer *rb, struct ring *r,
+			    int map_fd, __u32 max_entries, off_t off)
+{
+	void *tmp;
+	int err;
+
+	r->mask = max_entries - 1;
+
+	/* Map writable consumer page */
+	tmp = mmap(NULL, rb->page_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   map_fd, off);
+	if (tmp == MAP_FAILED) {
+		err = -errno;
+		pr_warn("ringbuf: failed to mmap consumer page for map fd=%d: %d\n",
+			map_fd, err);
+		return err;
+	}
+	r->consumer_pos = tmp;
+
+	/* Map read-only producer page and data pages. We map twice as big
+	 * data size to allow simple reading of samples that wrap around the
+	 * end of a ring buffer. See kernel implementation for details.
+	 * */
+	tmp = mmap(NULL, rb->page_size + 2 * max_entries, PROT_READ,
+		   MAP_SHARED, map_fd, off + rb->page_size);
+	if (tmp == MAP_FAILED) {
+		err = -errno;
+		ringbuf_unmap_ring(rb, r);
+		pr_warn("ringbuf: failed to mmap data pages for map fd=%d: %d\n",
+			map_fd, err);
+		return err;
+	}
+	r->producer_pos = tmp;
+	r->data = tmp + rb->page_size;
+
+	return 0;
+}
+
+/* Add extra RINGBUF maps to this ring buffer manager. A map created with
+ * BPF_F_RINGBUF_PERCPU contributes one ring per possible CPU, laid out back
+ * to back in the map's mmap() space, but is still polled through its one fd.
+ */
 int ring_buffer__add(struct ring_buffer *rb, int map_fd,
 		     ring_buffer_sample_fn sample_cb, void *ctx)
 {
 	struct bpf_map_info info;
 	__u32 len = sizeof(info);
+	int i, err, nr_rings = 1;
 	struct epoll_event *e;
 	struct ring *r;
+	off_t ring_sz;
 	void *tmp;
-	int err;
 
 	memset(&info, 0, sizeof(info));
 
@@ -82,50 +126,41 @@ int ring_buffer__add(struct ring_buffer *rb, int map_fd,
 		return -EINVAL;
 	}
 
-	tmp = reallocarray(rb->rings, rb->ring_cnt + 1, sizeof(*rb->rings));
+	if (info.map_flags & BPF_F_RINGBUF_PERCPU) {
+		nr_rings = libbpf_num_possible_cpus();
+		if (nr_rings < 0)
+			return nr_rings;
+	}
+
+	tmp = reallocarray(rb->rings, rb->ring_cnt + nr_rings,
+			   sizeof(*rb->rings));
 	if (!tmp)
 		return -ENOMEM;
 	rb->rings = tmp;
 
-	tmp = reallocarray(rb->events, rb->ring_cnt + 1, sizeof(*rb->events));
+	tmp = reallocarray(rb->events, rb->ring_cnt + nr_rings,
+			   sizeof(*rb->events));
 	if (!tmp)
 		return -ENOMEM;
 	rb->events = tmp;
 
-	r = &rb->rings[rb->ring_cnt];
-	memset(r, 0, sizeof(*r));
+	/* consumer page, producer page and double-mapped data pages */
+	ring_sz = 2 * rb->page_size + 2 * (off_t)info.max_entries;
 
-	r->map_fd = map_fd;
-	r->sample_cb = sample_cb;
-	r->ctx = ctx;
-	r->mask = info.max_entries - 1;
+	for (i = 0; i < nr_rings; i++) {
+		r = &rb->rings[rb->ring_cnt + i];
+		memset(r, 0, sizeof(*r));
 
-	/* Map writable consumer page */
-	tmp = mmap(NULL, rb->page_size, PROT_READ | PROT_WRITE, MAP_SHARED,
-		   map_fd, 0);
-	if (tmp == MAP_FAILED) {
-		err = -errno;
-		pr_warn("ringbuf: failed to mmap consumer page for map fd=%d: %d\n",
-			map_fd, err);
-		return err;
-	}
-	r->consumer_pos = tmp;
+		r->map_fd = map_fd;
+		r->sample_cb = sample_cb;
+		r->ctx = ctx;
 
-	/* Map read-only producer page and data pages. We map twice as big
-	 * data size to allow simple reading of samples that wrap around the
-	 * end of a ring buffer. See kernel implementation for details.
-	 * */
-	tmp = mmap(NULL, rb->page_size + 2 * info.max_entries, PROT_READ,
-		   MAP_SHARED, map_fd, rb->page_size);
-	if (tmp == MAP_FAILED) {
-		err = -errno;
-		ringbuf_unmap_ring(rb, r);
-		pr_warn("ringbuf: failed to mmap data pages for map fd=%d: %d\n",
-			map_fd, err);
-		return err;
+		err = ringbuf_map_ring(rb, r, map_fd, info.max_entries,
+				       i * ring_sz);
+		if (err)
+			goto err_unmap;
 	}
-	r->producer_pos = tmp;
-	r->data = tmp + rb->page_size;
+	rb->rings[rb->ring_cnt].map_ring_cnt = nr_rings;
 
 	e = &rb->events[rb->ring_cnt];
 	memset(e, 0, sizeof(*e));
@@ -134,14 +169,18 @@ int ring_buffer__add(struct ring_buffer *rb, int map_fd,
 	e->data.fd = rb->ring_cnt;
 	if (epoll_ctl(rb->epoll_fd, EPOLL_CTL_ADD, map_fd, e) < 0) {
 		err = -errno;
-		ringbuf_unmap_ring(rb, r);
 		pr_warn("ringbuf: failed to epoll add map fd=%d: %d\n",
 			map_fd, err);
-		return err;
+		goto err_unmap;
 	}
 
-	rb->ring_cnt++;
+	rb->ring_cnt += nr_rings;
 	return 0;
+
+err_unmap:
+	while (i--)
+		ringbuf_unmap_ring(rb, &rb->rings[rb->ring_cnt + i]);
+	return err;
 }
 
 void ring_buffer__free(struct ring_buffer *rb)
@@ -278,10 +317,13 @@ int ring_buffer__poll(struct ring_buffer *rb, int timeout_ms)
 	for (i = 0; i < cnt; i++) {
 		__u32 ring_id = rb->events[i].data.fd;
 		struct ring *ring = &rb->rings[ring_id];
+		int j;
 
-		err = ringbuf_process_ring(ring);
-		if (err < 0)
-			return err;
+		for (j = 0; j < ring->map_ring_cnt; j++) {
+			err = ringbuf_process_ring(&ring[j]);
+			if (err < 0)
+				return err;
+		}
 		res += cnt;
 	}
 	return cnt < 0 ? -errno : res;
@@ -45,6 +45,10 @@ int bench_epoll_wait(int argc, const char **argv);
 int bench_epoll_ctl(int argc, const char **argv);
 int bench_synthesize(int argc, const char **argv);
 int bench_kallsyms_parse(int argc, const char **argv);
+int bench_mm_fault(int argc, const char **argv);
+int bench_mm_mmap(int argc, const char **argv);
+int bench_io_uring_nop(int argc, const char **argv);
+int bench_io_uring_read(int argc, const char **argv);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
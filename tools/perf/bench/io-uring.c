@@ -0,0 +1,571 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io-uring: Measure io_uring submission and completion cost.
+ *
+ * Each thread sets up its own ring and keeps it filled with either NOP
+ * requests, which only exercise io_uring itself, or small O_DIRECT reads
+ * from a block device, preferably null_blk, which add the blk-mq cost of
+ * an I/O that never touches hardware. Completions are reaped with
+ * interrupts (the default), busy polling (IORING_SETUP_IOPOLL) or a
+ * kernel SQ polling thread (IORING_SETUP_SQPOLL).
+ *
+ * The ring is driven through the raw system calls, so that the run does
+ * not depend on liburing.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <asm/barrier.h>
+#include <linux/compiler.h>
+#include <linux/io_uring.h>
+#include <linux/kernel.h>
+#include <internal/cpumap.h>
+#include <perf/cpumap.h>
+
+#include "../perf-sys.h"
+#include "../util/cloexec.h"
+#include "../util/stat.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+
+#ifdef __alpha__
+# ifndef __NR_io_uring_setup
+#  define __NR_io_uring_setup		535
+# endif
+# ifndef __NR_io_uring_enter
+#  define __NR_io_uring_enter		536
+# endif
+# ifndef __NR_io_uring_register
+#  define __NR_io_uring_register	537
+# endif
+#else
+# ifndef __NR_io_uring_setup
+#  define __NR_io_uring_setup		425
+# endif
+# ifndef __NR_io_uring_enter
+#  define __NR_io_uring_enter		426
+# endif
+# ifndef __NR_io_uring_register
+#  define __NR_io_uring_register	427
+# endif
+#endif
+
+enum workload {
+	WORKLOAD_NOP,
+	WORKLOAD_READ,
+};
+
+enum ring_mode {
+	MODE_IRQ,
+	MODE_POLL,
+	MODE_SQPOLL,
+};
+
+static unsigned int nthreads = 1;
+static unsigned int nsecs    = 5;
+static unsigned int depth    = 32;
+static unsigned int batch    = 8;
+static unsigned int bs       = 4096;
+static const char *mode_str  = "irq";
+static const char *filename  = "/dev/nullb0";
+static bool done, silent, noaffinity;
+
+static enum workload workload;
+static enum ring_mode mode;
+static off_t file_size;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct ring {
+	int fd;
+	unsigned int entries;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_flags, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+};
+
+struct worker {
+	int tid;
+	int fd;
+	pthread_t thread;
+	struct ring ring;
+	void *bufs;
+	off_t offset;
+	unsigned long ops;
+	u64 cycles;
+	bool has_cycles;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads, each with its own ring"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_UINTEGER('d', "depth",   &depth,    "Specify the number of requests kept in flight"),
+	OPT_UINTEGER('b', "batch",   &batch,    "Specify the number of completions waited for per io_uring_enter()"),
+	OPT_STRING(  'm', "mode",    &mode_str, "irq", "Specify the completion mode: irq, poll or sqpoll"),
+	OPT_STRING(  'f', "file",    &filename, "/dev/nullb0", "Specify the device read from (read only)"),
+	OPT_UINTEGER('B', "bs",      &bs,       "Specify the read size in bytes (read only)"),
+	OPT_BOOLEAN( 'n', "noaffinity", &noaffinity, "Disables CPU affinity"),
+	OPT_BOOLEAN( 'S', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_io_uring_nop_usage[] = {
+	"perf bench io uring-nop <options>",
+	NULL
+};
+
+static const char * const bench_io_uring_read_usage[] = {
+	"perf bench io uring-read <options>",
+	NULL
+};
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned int to_submit,
+			  unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned int opcode, void *arg,
+			     unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_setup(struct ring *r)
+{
+	struct io_uring_params p;
+	void *sq, *cq;
+
+	memset(&p, 0, sizeof(p));
+	if (mode == MODE_POLL)
+		p.flags |= IORING_SETUP_IOPOLL;
+	else if (mode == MODE_SQPOLL)
+		p.flags |= IORING_SETUP_SQPOLL;
+
+	r->fd = io_uring_setup(depth, &p);
+	if (r->fd < 0)
+		err(EXIT_FAILURE, "io_uring_setup");
+
+	sq = mmap(NULL, p.sq_off.array + p.sq_entries * sizeof(__u32),
+		  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		  r->fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+
+	r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+		       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		       r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+
+	cq = mmap(NULL, p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe),
+		  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		  r->fd, IORING_OFF_CQ_RING);
+	if (cq == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+
+	r->entries = p.sq_entries;
+	r->sq_head = sq + p.sq_off.head;
+	r->sq_tail = sq + p.sq_off.tail;
+	r->sq_mask = sq + p.sq_off.ring_mask;
+	r->sq_flags = sq + p.sq_off.flags;
+	r->sq_array = sq + p.sq_off.array;
+	r->cq_head = cq + p.cq_off.head;
+	r->cq_tail = cq + p.cq_off.tail;
+	r->cq_mask = cq + p.cq_off.ring_mask;
+	r->cqes = cq + p.cq_off.cqes;
+}
+
+static void prep_sqe(struct worker *w, unsigned int idx)
+{
+	struct io_uring_sqe *sqe = &w->ring.sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = idx;
+
+	if (workload == WORKLOAD_NOP) {
+		sqe->opcode = IORING_OP_NOP;
+		return;
+	}
+
+	/* The device is registered as fixed file 0, SQPOLL requires it */
+	sqe->opcode = IORING_OP_READ;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->fd = 0;
+	sqe->addr = (unsigned long)w->bufs + (unsigned long)idx * bs;
+	sqe->len = bs;
+	sqe->off = w->offset;
+
+	w->offset += bs;
+	if (w->offset + bs > file_size)
+		w->offset = 0;
+}
+
+/*
+ * Fill the SQ ring up to depth, without reusing an SQE the kernel has
+ * not consumed yet, and return the number of new entries.
+ */
+static unsigned int fill_sq(struct worker *w, unsigned int inflight)
+{
+	struct ring *r = &w->ring;
+	unsigned int mask = *r->sq_mask;
+	unsigned int head = smp_load_acquire(r->sq_head);
+	unsigned int tail = *r->sq_tail;
+	unsigned int n = 0;
+
+	while (inflight + n < depth && tail - head < r->entries) {
+		unsigned int idx = tail & mask;
+
+		prep_sqe(w, idx);
+		r->sq_array[idx] = idx;
+		tail++;
+		n++;
+	}
+
+	if (n)
+		smp_store_release(r->sq_tail, tail);
+
+	return n;
+}
+
+static unsigned int reap_cq(struct worker *w)
+{
+	struct ring *r = &w->ring;
+	unsigned int mask = *r->cq_mask;
+	unsigned int head = *r->cq_head;
+	unsigned int tail = smp_load_acquire(r->cq_tail);
+	unsigned int n = 0;
+
+	while (head != tail) {
+		struct io_uring_cqe *cqe = &r->cqes[head & mask];
+
+		if (cqe->res < 0) {
+			errno = -cqe->res;
+			err(EXIT_FAILURE, "io_uring completion");
+		}
+		head++;
+		n++;
+	}
+
+	if (n)
+		smp_store_release(r->cq_head, head);
+
+	return n;
+}
+
+static int open_cycles(void)
+{
+	struct perf_event_attr attr = {
+		.type		= PERF_TYPE_HARDWARE,
+		.config		= PERF_COUNT_HW_CPU_CYCLES,
+	};
+
+	/* Count this thread only: the SQPOLL thread is not included */
+	return sys_perf_event_open(&attr, 0, -1, -1,
+				   perf_event_open_cloexec_flag());
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	struct ring *r = &w->ring;
+	unsigned long ops = 0; /* avoid cacheline bouncing */
+	unsigned int inflight = 0;
+	u64 start = 0, end = 0;
+	int cycles_fd;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	cycles_fd = open_cycles();
+	if (cycles_fd >= 0 && read(cycles_fd, &start, sizeof(start)) != sizeof(start))
+		cycles_fd = -1;
+
+	do {
+		unsigned int to_submit = fill_sq(w, inflight);
+		unsigned int flags = 0, wait = 0;
+		int ret;
+
+		inflight += to_submit;
+
+		if (mode == MODE_SQPOLL) {
+			/* Only enter the kernel to wake the thread or to wait */
+			if (READ_ONCE(*r->sq_flags) & IORING_SQ_NEED_WAKEUP)
+				flags |= IORING_ENTER_SQ_WAKEUP;
+			if (inflight == depth) {
+				flags |= IORING_ENTER_GETEVENTS;
+				wait = 1;
+			}
+			to_submit = 0;
+		} else {
+			flags = IORING_ENTER_GETEVENTS;
+			wait = min(batch, inflight);
+		}
+
+		if (flags) {
+			ret = io_uring_enter(r->fd, to_submit, wait, flags);
+			if (ret < 0 && errno != EINTR)
+				err(EXIT_FAILURE, "io_uring_enter");
+		}
+
+		ret = reap_cq(w);
+		inflight -= ret;
+		ops += ret;
+	} while (!done);
+
+	if (cycles_fd >= 0) {
+		if (read(cycles_fd, &end, sizeof(end)) == sizeof(end)) {
+			w->cycles = end - start;
+			w->has_cycles = true;
+		}
+		close(cycles_fd);
+	}
+
+	w->ops = ops;
+	return NULL;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&bench__end, NULL);
+	timersub(&bench__end, &bench__start, &bench__runtime);
+}
+
+static int parse_mode(const char *str)
+{
+	if (!strcmp(str, "irq"))
+		mode = MODE_IRQ;
+	else if (!strcmp(str, "poll"))
+		mode = MODE_POLL;
+	else if (!strcmp(str, "sqpoll"))
+		mode = MODE_SQPOLL;
+	else
+		return -1;
+
+	return 0;
+}
+
+static void worker_setup(struct worker *w)
+{
+	int ret;
+
+	ring_setup(&w->ring);
+
+	if (workload == WORKLOAD_NOP)
+		return;
+
+	w->fd = open(filename, O_RDONLY | O_DIRECT);
+	if (w->fd < 0)
+		err(EXIT_FAILURE, "open %s", filename);
+
+	ret = io_uring_register(w->ring.fd, IORING_REGISTER_FILES, &w->fd, 1);
+	if (ret < 0)
+		err(EXIT_FAILURE, "io_uring_register");
+
+	ret = posix_memalign(&w->bufs, 4096, (size_t)w->ring.entries * bs);
+	if (ret) {
+		errno = ret;
+		err(EXIT_FAILURE, "posix_memalign");
+	}
+
+	/* Spread the threads over the device */
+	w->offset = (file_size / bs / nthreads) * bs * w->tid;
+}
+
+static void print_summary(unsigned long total)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld ops/sec per thread (+- %.2f%%), %ld ops/sec in total, total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       total, (int)bench__runtime.tv_sec);
+}
+
+static int bench_io_uring(int argc, const char **argv,
+			  const char * const *usage)
+{
+	int ret = 0;
+	cpu_set_t cpuset;
+	struct sigaction act;
+	unsigned int i;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+	struct perf_cpu_map *cpu;
+	unsigned long total = 0;
+
+	argc = parse_options(argc, argv, options, usage, 0);
+	if (argc || parse_mode(mode_str) || !depth || !nthreads) {
+		usage_with_options(usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (batch > depth)
+		batch = depth;
+	if (!batch)
+		batch = 1;
+
+	if (workload == WORKLOAD_NOP && mode == MODE_POLL) {
+		fprintf(stderr, "Polled completions need a device, use uring-read\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (workload == WORKLOAD_READ) {
+		int fd = open(filename, O_RDONLY);
+
+		/* Don't fail 'perf bench all' on machines without null_blk */
+		if (fd < 0 && errno == ENOENT) {
+			fprintf(stderr, "%s not found, load null_blk or use --file\n",
+				filename);
+			return 0;
+		}
+		if (fd < 0)
+			err(EXIT_FAILURE, "open %s", filename);
+		file_size = lseek(fd, 0, SEEK_END);
+		close(fd);
+
+		if (!bs || bs % 512 || file_size < (off_t)bs) {
+			fprintf(stderr, "Invalid block size %u for %s\n", bs, filename);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	cpu = perf_cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	memset(&act, 0, sizeof(act));
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	if (workload == WORKLOAD_NOP)
+		printf("Run summary [PID %d]: %d threads, each with %d NOPs in flight (%s) for %d secs.\n\n",
+		       getpid(), nthreads, depth, mode_str, nsecs);
+	else
+		printf("Run summary [PID %d]: %d threads, each with %d %u byte reads from %s in flight (%s) for %d secs.\n\n",
+		       getpid(), nthreads, depth, bs, filename, mode_str, nsecs);
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		worker[i].fd = -1;
+		worker_setup(&worker[i]);
+
+		if (!noaffinity) {
+			CPU_ZERO(&cpuset);
+			CPU_SET(cpu->map[i % cpu->nr], &cpuset);
+
+			ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset);
+			if (ret)
+				err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+		}
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	gettimeofday(&bench__start, NULL);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		struct worker *w = &worker[i];
+		unsigned long t = bench__runtime.tv_sec > 0 ?
+			w->ops / bench__runtime.tv_sec : 0;
+
+		update_stats(&throughput_stats, t);
+		total += t;
+		if (!silent) {
+			if (w->has_cycles && w->ops)
+				printf("[thread %3d] %ld ops/sec [ %.1f cycles/op ]\n",
+				       w->tid, t, (double)w->cycles / w->ops);
+			else
+				printf("[thread %3d] %ld ops/sec\n", w->tid, t);
+		}
+
+		close(w->ring.fd);
+		if (w->fd >= 0)
+			close(w->fd);
+		free(w->bufs);
+	}
+
+	print_summary(total);
+
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
+
+int bench_io_uring_nop(int argc, const char **argv)
+{
+	workload = WORKLOAD_NOP;
+	return bench_io_uring(argc, argv, bench_io_uring_nop_usage);
+}
+
+int bench_io_uring_read(int argc, const char **argv)
+{
+	workload = WORKLOAD_READ;
+	return bench_io_uring(argc, argv, bench_io_uring_read_usage);
+}
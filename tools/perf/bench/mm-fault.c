@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * mm-fault: Concurrently fault in and unmap private memory regions.
+ *
+ * Each thread repeatedly maps a region of its own, writes to every page of
+ * it and unmaps it again, so that the run measures page fault and zap
+ * scalability of the anonymous, page cache (file) and THP paths while all
+ * threads share a single mm.
+ */
+
+/* For the CLR_() macros */
+#include <string.h>
+#include <pthread.h>
+
+#include <err.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <internal/cpumap.h>
+#include <perf/cpumap.h>
+
+#include "../util/stat.h"
+#include "../util/string2.h"
+#include <subcmd/parse-options.h>
+#include "bench.h"
+
+#define THP_SIZE	(2UL << 20)
+
+enum fault_type {
+	FAULT_ANON,
+	FAULT_FILE,
+	FAULT_THP,
+};
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 10;
+static const char *size_str  = "64MB";
+static const char *type_str  = "anon";
+static bool done, silent, noaffinity;
+
+static enum fault_type type;
+static size_t size, page_size;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	int fd;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_STRING(  's', "size",    &size_str, "64MB", "Specify the size of the region mapped by each thread"),
+	OPT_STRING(  'T', "type",    &type_str, "anon", "Specify the memory type: anon, file or thp"),
+	OPT_BOOLEAN( 'n', "noaffinity", &noaffinity, "Disables CPU affinity"),
+	OPT_BOOLEAN( 'S', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_mm_fault_usage[] = {
+	"perf bench mm fault <options>",
+	NULL
+};
+
+static void *map_region(struct worker *w, void **base, size_t *len)
+{
+	unsigned long addr;
+	void *p;
+
+	switch (type) {
+	case FAULT_FILE:
+		*len = size;
+		p = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+		break;
+	case FAULT_THP:
+		/* Over-allocate so that the region can be huge page aligned */
+		*len = size + THP_SIZE;
+		p = mmap(NULL, *len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		break;
+	case FAULT_ANON:
+	default:
+		*len = size;
+		p = mmap(NULL, *len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		break;
+	}
+
+	if (p == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+
+	*base = p;
+	if (type != FAULT_THP)
+		return p;
+
+	addr = ((unsigned long)p + THP_SIZE - 1) & ~(THP_SIZE - 1);
+	if (madvise((void *)addr, size, MADV_HUGEPAGE))
+		err(EXIT_FAILURE, "madvise");
+
+	return (void *)addr;
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	unsigned long ops = 0; /* avoid cacheline bouncing */
+	size_t off, len;
+	char *p;
+	void *base;
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		p = map_region(w, &base, &len);
+
+		for (off = 0; off < size; off += page_size)
+			p[off] = 1;
+
+		if (munmap(base, len))
+			err(EXIT_FAILURE, "munmap");
+
+		/* Count base pages, so that the results are comparable */
+		ops += size / page_size;
+	} while (!done);
+
+	w->ops = ops;
+	return NULL;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&bench__end, NULL);
+	timersub(&bench__end, &bench__start, &bench__runtime);
+}
+
+static int parse_type(const char *str)
+{
+	if (!strcmp(str, "anon"))
+		type = FAULT_ANON;
+	else if (!strcmp(str, "file"))
+		type = FAULT_FILE;
+	else if (!strcmp(str, "thp"))
+		type = FAULT_THP;
+	else
+		return -1;
+
+	return 0;
+}
+
+static int open_file(void)
+{
+	FILE *f = tmpfile();
+	int fd;
+
+	if (!f)
+		err(EXIT_FAILURE, "tmpfile");
+
+	fd = dup(fileno(f));
+	fclose(f);
+	if (fd < 0)
+		err(EXIT_FAILURE, "dup");
+
+	if (ftruncate(fd, size))
+		err(EXIT_FAILURE, "ftruncate");
+
+	return fd;
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld pages/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int)bench__runtime.tv_sec);
+}
+
+int bench_mm_fault(int argc, const char **argv)
+{
+	int ret = 0;
+	cpu_set_t cpuset;
+	struct sigaction act;
+	unsigned int i;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+	struct perf_cpu_map *cpu;
+
+	argc = parse_options(argc, argv, options, bench_mm_fault_usage, 0);
+	if (argc || parse_type(type_str)) {
+		usage_with_options(bench_mm_fault_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	size = (size_t)perf_atoll((char *)size_str);
+	if ((s64)size <= 0 || size < page_size) {
+		fprintf(stderr, "Invalid size: %s\n", size_str);
+		exit(EXIT_FAILURE);
+	}
+	size &= ~(page_size - 1);
+
+	cpu = perf_cpu_map__new(NULL);
+	if (!cpu)
+		goto errmem;
+
+	memset(&act, 0, sizeof(act));
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = cpu->nr;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		goto errmem;
+
+	printf("Run summary [PID %d]: %d threads, each faulting %s of %s memory for %d secs.\n\n",
+	       getpid(), nthreads, size_str, type_str, nsecs);
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		worker[i].fd = type == FAULT_FILE ? open_file() : -1;
+
+		if (!noaffinity) {
+			CPU_ZERO(&cpuset);
+			CPU_SET(cpu->map[i % cpu->nr], &cpuset);
+
+			ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset);
+			if (ret)
+				err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+		}
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	gettimeofday(&bench__start, NULL);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = bench__runtime.tv_sec > 0 ?
+			worker[i].ops / bench__runtime.tv_sec : 0;
+
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %3d] %ld pages/sec\n", worker[i].tid, t);
+
+		if (worker[i].fd >= 0)
+			close(worker[i].fd);
+	}
+
+	print_summary();
+
+	free(worker);
+	free(cpu);
+	return ret;
+errmem:
+	err(EXIT_FAILURE, "calloc");
+}
@@ -15,6 +15,8 @@
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
  *  epoll ... Event poll performance
+ *  mm    ... Memory management scalability
+ *  io    ... io_uring and block layer overhead
  */
 #include <subcmd/parse-options.h>
 #include "builtin.h"
@@ -76,6 +78,20 @@ static struct bench epoll_benchmarks[] = {
 };
 #endif // HAVE_EVENTFD_SUPPORT
 
+static struct bench mm_benchmarks[] = {
+	{ "fault",	"Benchmark for concurrent page faults",		bench_mm_fault		},
+	{ "mmap",	"Benchmark for concurrent mmap()/munmap()",	bench_mm_mmap		},
+	{ "all",	"Run all mm benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench io_benchmarks[] = {
+	{ "uring-nop",	"Benchmark io_uring NOP submission and completion", bench_io_uring_nop	},
+	{ "uring-read",	"Benchmark io_uring O_DIRECT reads from a (null) block device", bench_io_uring_read },
+	{ "all",	"Run all io benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 static struct bench internals_benchmarks[] = {
 	{ "synthesize", "Benchmark perf event synthesis",	bench_synthesize	},
 	{ "kallsyms-parse", "Benchmark kallsyms parsing",	bench_kallsyms_parse	},
@@ -98,6 +114,8 @@ static struct collection collections[] = {
 #ifdef HAVE_EVENTFD_SUPPORT
 	{"epoll",       "Epoll stressing benchmarks",                   epoll_benchmarks        },
 #endif
+	{ "mm",		"Memory management scalability benchmarks",	mm_benchmarks		},
+	{ "io",		"io_uring and block layer benchmarks",		io_benchmarks		},
 	{ "internals",	"Perf-internals benchmarks",			internals_benchmarks	},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
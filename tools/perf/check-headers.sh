@@ -12,6 +12,7 @@ include/uapi/linux/fscrypt.h
 include/uapi/linux/kcmp.h
 include/uapi/linux/kvm.h
 include/uapi/linux/in.h
+include/uapi/linux/io_uring.h
 include/uapi/linux/mount.h
 include/uapi/linux/openat2.h
 include/uapi/linux/perf_event.h
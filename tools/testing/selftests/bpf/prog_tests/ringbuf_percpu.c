@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0
+#define _GNU_SOURCE
+#include <test_progs.h>
+#include <sched.h>
+#include "test_ringbuf_percpu.skel.h"
+
+#define SAMPLES_PER_CPU 8
+
+static int duration = 0;
+
+struct sample {
+	int pid;
+	int seq;
+	long value;
+};
+
+static int process_sample(void *ctx, void *data, size_t len)
+{
+	long *seen = ctx;
+	struct sample *s = data;
+
+	CHECK(s->value != 42, "sample_value", "exp %ld, got %ld\n",
+	      42L, s->value);
+	(*seen)++;
+	return 0;
+}
+
+void test_ringbuf_percpu(void)
+{
+	int i, j, err, nr_cpus, triggered = 0;
+	struct test_ringbuf_percpu *skel;
+	struct ring_buffer *ringbuf = NULL;
+	cpu_set_t cpuset, old_cpuset;
+	long seen = 0;
+
+	skel = test_ringbuf_percpu__open_and_load();
+	if (CHECK(!skel, "skel_open_load", "skeleton open&load failed\n"))
+		return;
+
+	skel->bss->pid = getpid();
+	skel->bss->value = 42;
+
+	ringbuf = ring_buffer__new(bpf_map__fd(skel->maps.ringbuf),
+				   process_sample, &seen, NULL);
+	if (CHECK(!ringbuf, "ringbuf_create", "failed to create ringbuf\n"))
+		goto cleanup;
+
+	err = test_ringbuf_percpu__attach(skel);
+	if (CHECK(err, "skel_attach", "skeleton attachment failed: %d\n", err))
+		goto cleanup;
+
+	nr_cpus = libbpf_num_possible_cpus();
+	if (CHECK(nr_cpus < 0, "nr_cpus", "failed: %d\n", nr_cpus))
+		goto cleanup;
+
+	/* produce into every ring we can get scheduled on */
+	CHECK_FAIL(sched_getaffinity(0, sizeof(old_cpuset), &old_cpuset));
+	for (i = 0; i < nr_cpus; i++) {
+		CPU_ZERO(&cpuset);
+		CPU_SET(i, &cpuset);
+		if (sched_setaffinity(0, sizeof(cpuset), &cpuset))
+			continue;
+		for (j = 0; j < SAMPLES_PER_CPU; j++)
+			syscall(__NR_getpgid);
+		triggered += SAMPLES_PER_CPU;
+	}
+	sched_setaffinity(0, sizeof(old_cpuset), &old_cpuset);
+
+	/* one fd covers all per-CPU rings, a single poll drains them all */
+	err = ring_buffer__poll(ringbuf, -1);
+	if (CHECK(err < 0, "poll_res", "poll failed: %d\n", err))
+		goto cleanup;
+
+	err = ring_buffer__consume(ringbuf);
+	if (CHECK(err < 0, "consume_res", "consume failed: %d\n", err))
+		goto cleanup;
+
+	CHECK(seen != triggered, "seen", "exp %d, got %ld\n", triggered, seen);
+	CHECK(skel->bss->dropped != 0, "err_dropped", "exp %ld, got %ld\n",
+	      0L, skel->bss->dropped);
+	CHECK(skel->bss->total != triggered, "err_total", "exp %d, got %ld\n",
+	      triggered, skel->bss->total);
+
+cleanup:
+	ring_buffer__free(ringbuf);
+	test_ringbuf_percpu__destroy(skel);
+}
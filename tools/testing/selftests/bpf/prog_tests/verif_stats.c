@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <test_progs.h>
+#include "test_enable_stats.skel.h"
+
+void test_verif_stats(void)
+{
+	struct test_enable_stats *skel;
+	struct bpf_prog_info info;
+	__u32 info_len = sizeof(info);
+	int err, prog_fd;
+	int duration = 0;
+
+	skel = test_enable_stats__open_and_load();
+	if (CHECK(!skel, "skel_open_and_load", "skeleton open/load failed\n"))
+		return;
+
+	prog_fd = bpf_program__fd(skel->progs.test_enable_stats);
+	memset(&info, 0, info_len);
+	err = bpf_obj_get_info_by_fd(prog_fd, &info, &info_len);
+	if (CHECK(err, "get_prog_info",
+		  "failed to get bpf_prog_info for fd %d\n", prog_fd))
+		goto cleanup;
+
+	CHECK(info.verified_insns == 0, "verified_insns",
+	      "no verified insns reported\n");
+	CHECK(info.verified_peak_states > info.verified_total_states,
+	      "verified_states", "peak %u > total %u\n",
+	      info.verified_peak_states, info.verified_total_states);
+
+cleanup:
+	test_enable_stats__destroy(skel);
+}
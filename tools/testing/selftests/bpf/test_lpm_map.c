@@ -780,6 +780,62 @@ static void test_lpm_multi_thread(void)
 	close(map_fd);
 }
 
+static void test_lpm_batch_ops(void)
+{
+	struct lpm_key4 {
+		__u32 prefixlen;
+		__u8 data[4];
+	} keys[64], out_keys[64];
+	__u32 values[64], out_values[64], count, batch;
+	const int n = ARRAY_SIZE(keys);
+	struct lpm_key4 key;
+	int map_fd, i, err;
+
+	DECLARE_LIBBPF_OPTS(bpf_map_batch_opts, opts,
+		.elem_flags = 0,
+		.flags = 0,
+	);
+
+	map_fd = bpf_create_map(BPF_MAP_TYPE_LPM_TRIE, sizeof(key),
+				sizeof(values[0]), n, BPF_F_NO_PREALLOC);
+	assert(map_fd >= 0);
+
+	/* 10.i.0.0/16, with a 10.0.0.0/8 covering all of them */
+	for (i = 0; i < n; i++) {
+		keys[i].prefixlen = i ? 16 : 8;
+		keys[i].data[0] = 10;
+		keys[i].data[1] = i;
+		keys[i].data[2] = 0;
+		keys[i].data[3] = 0;
+		values[i] = i;
+	}
+
+	count = n;
+	err = bpf_map_update_batch(map_fd, keys, values, &count, &opts);
+	assert(!err && count == n);
+
+	/* every key comes back with its own value, not its parent's */
+	count = n;
+	memset(out_keys, 0, sizeof(out_keys));
+	err = bpf_map_lookup_batch(map_fd, NULL, &batch, out_keys, out_values,
+				   &count, &opts);
+	assert((!err || errno == ENOENT) && count == n);
+	for (i = 0; i < n; i++) {
+		assert(out_keys[i].data[0] == 10);
+		assert(out_keys[i].prefixlen ==
+		       (out_keys[i].data[1] ? 16 : 8));
+		assert(out_values[i] == out_keys[i].data[1]);
+	}
+
+	count = n;
+	err = bpf_map_delete_batch(map_fd, keys, &count, &opts);
+	assert(!err && count == n);
+	assert(bpf_map_get_next_key(map_fd, NULL, &key) == -1 &&
+	       errno == ENOENT);
+
+	close(map_fd);
+}
+
 int main(void)
 {
 	int i;
@@ -798,6 +854,7 @@ int main(void)
 	test_lpm_delete();
 	test_lpm_get_next_key();
 	test_lpm_multi_thread();
+	test_lpm_batch_ops();
 
 	printf("test_lpm: OK\n");
 	return 0;
@@ -228,10 +228,39 @@ fib_rule4_test()
 	fi
 }
 
+# enough rules for the kernel to build its lookup index
+fib_rule4_many_test()
+{
+	local i
+
+	# reuses the table $RTABLE route set up by fib_rule4_test
+	for i in $(seq 1 32); do
+		$IP rule add fwmark $((0x1000 + i)) table $((RTABLE + i))
+		$IP rule add iif lo fwmark $((0x2000 + i)) table $((RTABLE + i))
+	done
+
+	match="fwmark 0x64"
+	getmatch="mark 0x64"
+	fib_rule4_test_match_n_redirect "$match" "$getmatch" "fwmark redirect with many rules"
+
+	ip netns exec testns sysctl -w net.ipv4.ip_forward=1
+	ip netns exec testns sysctl -w net.ipv4.conf.$DEV.rp_filter=0
+	match="from $SRC_IP iif $DEV"
+	fib_rule4_test_match_n_redirect "$match" "$match" "iif redirect with many rules"
+	ip netns exec testns sysctl -w net.ipv4.ip_forward=0
+
+	for i in $(seq 1 32); do
+		$IP rule del fwmark $((0x1000 + i)) table $((RTABLE + i))
+		$IP rule del iif lo fwmark $((0x2000 + i)) table $((RTABLE + i))
+	done
+}
+
 run_fibrule_tests()
 {
 	log_section "IPv4 fib rule"
 	fib_rule4_test
+	log_section "IPv4 fib rule with many rules"
+	fib_rule4_many_test
 	log_section "IPv6 fib rule"
 	fib_rule6_test
 }
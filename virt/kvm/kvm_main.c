@@ -89,6 +89,15 @@ unsigned int halt_poll_ns_shrink;
 module_param(halt_poll_ns_shrink, uint, 0644);
 EXPORT_SYMBOL_GPL(halt_poll_ns_shrink);
 
+/*
+ * If set, size the per-vcpu halt_poll_ns from a histogram of its recent
+ * block times, polling just long enough to catch this percentage of its
+ * wakeups, instead of growing and shrinking it.
+ */
+unsigned int halt_poll_ns_coverage;
+module_param(halt_poll_ns_coverage, uint, 0644);
+EXPORT_SYMBOL_GPL(halt_poll_ns_coverage);
+
 /*
  * Ordering of locks:
  *
@@ -2664,6 +2673,56 @@ static void shrink_halt_poll_ns(struct kvm_vcpu *vcpu)
 	trace_kvm_halt_poll_ns_shrink(vcpu->vcpu_id, val, old);
 }
 
+/* Number of wakeups after which the block time histogram is halved */
+#define KVM_HALT_HIST_WINDOW	64
+
+static void update_halt_poll_hist(struct kvm_vcpu *vcpu, u64 block_ns,
+				  unsigned int coverage)
+{
+	unsigned int old, val = 0, max = vcpu->kvm->max_halt_poll_ns;
+	unsigned int i, sum = 0, target;
+
+	/* Bucket i counts block times in [2^i, 2^(i + 1)) ns */
+	i = block_ns ? ilog2(block_ns) : 0;
+	vcpu->halt_hist[min_t(unsigned int, i, KVM_HALT_HIST_BUCKETS - 1)]++;
+
+	/* Age the history, so that it follows changes in the guest's load */
+	if (++vcpu->halt_hist_count >= KVM_HALT_HIST_WINDOW) {
+		vcpu->halt_hist_count = 0;
+		for (i = 0; i < KVM_HALT_HIST_BUCKETS; i++) {
+			vcpu->halt_hist[i] >>= 1;
+			vcpu->halt_hist_count += vcpu->halt_hist[i];
+		}
+	}
+
+	/*
+	 * Poll up to the end of the smallest bucket that takes in the target
+	 * share of wakeups. If most of them only come after max_halt_poll_ns,
+	 * polling would just burn the CPU, so don't.
+	 */
+	target = DIV_ROUND_UP(vcpu->halt_hist_count * min(coverage, 100U), 100);
+	for (i = 0; i < KVM_HALT_HIST_BUCKETS - 1; i++) {
+		if (1U << (i + 1) > max)
+			break;
+
+		sum += vcpu->halt_hist[i];
+		if (sum >= target) {
+			val = 1U << (i + 1);
+			break;
+		}
+	}
+
+	old = vcpu->halt_poll_ns;
+	if (val == old)
+		return;
+
+	vcpu->halt_poll_ns = val;
+	if (val > old)
+		trace_kvm_halt_poll_ns_grow(vcpu->vcpu_id, val, old);
+	else
+		trace_kvm_halt_poll_ns_shrink(vcpu->vcpu_id, val, old);
+}
+
 static int kvm_vcpu_check_block(struct kvm_vcpu *vcpu)
 {
 	int ret = -EINTR;
@@ -2747,7 +2806,11 @@ void kvm_vcpu_block(struct kvm_vcpu *vcpu)
 		if (!vcpu_valid_wakeup(vcpu)) {
 			shrink_halt_poll_ns(vcpu);
 		} else if (vcpu->kvm->max_halt_poll_ns) {
-			if (block_ns <= vcpu->halt_poll_ns)
+			unsigned int coverage = READ_ONCE(halt_poll_ns_coverage);
+
+			if (coverage)
+				update_halt_poll_hist(vcpu, block_ns, coverage);
+			else if (block_ns <= vcpu->halt_poll_ns)
 				;
 			/* we had a long block, shrink polling */
 			else if (vcpu->halt_poll_ns &&